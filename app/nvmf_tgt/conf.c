@@ -49,6 +49,7 @@
 #include "spdk/conf.h"
 #include "spdk/log.h"
 #include "spdk/bdev.h"
+#include "spdk/io_channel.h"
 
 #define MAX_LISTEN_ADDRESSES 255
 #define MAX_HOSTS 255
@@ -85,6 +86,16 @@ struct spdk_nvmf_probe_ctx {
 #define SPDK_NVMF_CONFIG_MAX_IO_SIZE_MIN 4096
 #define SPDK_NVMF_CONFIG_MAX_IO_SIZE_MAX 131072
 
+#define SPDK_NVMF_CONFIG_SRQ_DEPTH_DEFAULT 0
+#define SPDK_NVMF_CONFIG_SRQ_DEPTH_MAX 65536
+
+#define SPDK_NVMF_CONFIG_CQ_DEPTH_DEFAULT 0
+#define SPDK_NVMF_CONFIG_CQ_DEPTH_MAX 65536
+
+#define SPDK_NVMF_CONFIG_SESSION_DATA_BUFS_MAX 65536
+
+#define SPDK_NVMF_CONFIG_DATA_BUF_POOL_SIZE_MAX 262144
+
 struct spdk_nvmf_tgt_conf g_spdk_nvmf_tgt_conf;
 
 static int
@@ -159,8 +170,14 @@ spdk_nvmf_parse_nvmf_tgt(void)
 	int max_queues_per_sess;
 	int in_capsule_data_size;
 	int max_io_size;
+	int srq_depth;
+	int cq_depth;
+	int sess_data_bufs;
+	int small_data_bufs;
+	int large_data_bufs;
 	int acceptor_lcore;
 	int acceptor_poll_rate;
+	char *val;
 	int rc;
 
 	sp = spdk_conf_find_section(NULL, "Nvmf");
@@ -203,6 +220,41 @@ spdk_nvmf_parse_nvmf_tgt(void)
 	max_io_size = nvmf_max(max_io_size, SPDK_NVMF_CONFIG_MAX_IO_SIZE_MIN);
 	max_io_size = nvmf_min(max_io_size, SPDK_NVMF_CONFIG_MAX_IO_SIZE_MAX);
 
+	srq_depth = spdk_conf_section_get_intval(sp, "SharedReceiveQueueDepth");
+	if (srq_depth < 0) {
+		srq_depth = SPDK_NVMF_CONFIG_SRQ_DEPTH_DEFAULT;
+	} else if (srq_depth > 0) {
+		/* Must hold at least one full queue */
+		srq_depth = nvmf_max(srq_depth, max_queue_depth);
+		srq_depth = nvmf_min(srq_depth, SPDK_NVMF_CONFIG_SRQ_DEPTH_MAX);
+	}
+
+	cq_depth = spdk_conf_section_get_intval(sp, "SharedCompletionQueueDepth");
+	if (cq_depth < 0) {
+		cq_depth = SPDK_NVMF_CONFIG_CQ_DEPTH_DEFAULT;
+	} else if (cq_depth > 0) {
+		/* Must hold the send and receive completions of at least one full queue */
+		cq_depth = nvmf_max(cq_depth, max_queue_depth * 2);
+		cq_depth = nvmf_min(cq_depth, SPDK_NVMF_CONFIG_CQ_DEPTH_MAX);
+	}
+	g_spdk_nvmf_tgt_conf.poll_groups = (cq_depth > 0);
+
+	sess_data_bufs = spdk_conf_section_get_intval(sp, "SessionDataBuffers");
+	if (sess_data_bufs <= 0) {
+		/* One full queue worth */
+		sess_data_bufs = max_queue_depth;
+	}
+	sess_data_bufs = nvmf_min(sess_data_bufs, SPDK_NVMF_CONFIG_SESSION_DATA_BUFS_MAX);
+
+	/* 0 lets the RDMA transport size the pools from MaxQueueDepth */
+	small_data_bufs = spdk_conf_section_get_intval(sp, "SmallDataBufferPoolSize");
+	small_data_bufs = nvmf_max(small_data_bufs, 0);
+	small_data_bufs = nvmf_min(small_data_bufs, SPDK_NVMF_CONFIG_DATA_BUF_POOL_SIZE_MAX);
+
+	large_data_bufs = spdk_conf_section_get_intval(sp, "LargeDataBufferPoolSize");
+	large_data_bufs = nvmf_max(large_data_bufs, 0);
+	large_data_bufs = nvmf_min(large_data_bufs, SPDK_NVMF_CONFIG_DATA_BUF_POOL_SIZE_MAX);
+
 	acceptor_lcore = spdk_conf_section_get_intval(sp, "AcceptorCore");
 	if (acceptor_lcore < 0) {
 		acceptor_lcore = rte_lcore_id();
@@ -215,7 +267,20 @@ spdk_nvmf_parse_nvmf_tgt(void)
 	}
 	g_spdk_nvmf_tgt_conf.acceptor_poll_rate = acceptor_poll_rate;
 
-	rc = nvmf_tgt_init(max_queue_depth, max_queues_per_sess, in_capsule_data_size, max_io_size);
+	val = spdk_conf_section_get_val(sp, "ConnectionScheduler");
+	if (val == NULL || strcasecmp(val, "Subsystem") == 0) {
+		g_spdk_nvmf_tgt_conf.conn_sched = CONN_SCHED_SUBSYSTEM;
+	} else if (strcasecmp(val, "RoundRobin") == 0) {
+		g_spdk_nvmf_tgt_conf.conn_sched = CONN_SCHED_ROUND_ROBIN;
+	} else if (strcasecmp(val, "LeastLoaded") == 0) {
+		g_spdk_nvmf_tgt_conf.conn_sched = CONN_SCHED_LEAST_LOADED;
+	} else {
+		SPDK_ERRLOG("Unknown ConnectionScheduler %s\n", val);
+		return -1;
+	}
+
+	rc = nvmf_tgt_init(max_queue_depth, max_queues_per_sess, in_capsule_data_size, max_io_size,
+			   srq_depth, cq_depth, sess_data_bufs, small_data_bufs, large_data_bufs);
 	if (rc != 0) {
 		SPDK_ERRLOG("nvmf_tgt_init() failed\n");
 		return rc;
@@ -478,6 +543,16 @@ spdk_nvmf_parse_subsystem(struct spdk_conf_section *sp)
 		return -1;
 	}
 
+	ret = spdk_conf_section_get_intval(sp, "InCapsuleDataSize");
+	if (ret >= 0) {
+		if ((ret % 16) != 0) {
+			SPDK_ERRLOG("Subsystem %d: InCapsuleDataSize must be a multiple of 16\n", sp->num);
+			return -1;
+		}
+		subsystem->in_capsule_data_size = nvmf_min((uint32_t)ret,
+						   subsystem->in_capsule_data_size);
+	}
+
 	/* Parse Listen sections */
 	for (i = 0; i < MAX_LISTEN_ADDRESSES; i++) {
 		char *transport_name, *listen_addr;
@@ -582,6 +657,23 @@ spdk_nvmf_parse_subsystem(struct spdk_conf_section *sp)
 			return -1;
 		}
 
+		val = spdk_conf_section_get_val(sp, "Priority");
+		if (val != NULL && spdk_io_priority_parse(val, &app_subsys->io_priority) != 0) {
+			SPDK_ERRLOG("Subsystem %d: unknown Priority %s\n", sp->num, val);
+			return -1;
+		}
+
+		subsystem->dev.virt.write_stream = 0;
+		val = spdk_conf_section_get_val(sp, "WriteStream");
+		if (val != NULL) {
+			ret = (int)strtol(val, NULL, 10);
+			if (ret < 0 || ret > UINT16_MAX) {
+				SPDK_ERRLOG("Subsystem %d: invalid WriteStream %s\n", sp->num, val);
+				return -1;
+			}
+			subsystem->dev.virt.write_stream = ret;
+		}
+
 		subsystem->dev.virt.ns_count = 0;
 		snprintf(subsystem->dev.virt.sn, MAX_SN_LEN, "%s", sn);
 		subsystem->ops = &spdk_nvmf_virtual_ctrlr_ops;
@@ -35,6 +35,7 @@
 #include <stdio.h>
 
 #include "nvmf_tgt.h"
+#include "nvmf/session.h"
 #include "nvmf/subsystem.h"
 #include "nvmf/transport.h"
 #include "spdk/log.h"
@@ -165,6 +166,138 @@ spdk_rpc_get_nvmf_subsystems(struct spdk_jsonrpc_server_conn *conn,
 }
 SPDK_RPC_REGISTER("get_nvmf_subsystems", spdk_rpc_get_nvmf_subsystems)
 
+static void
+dump_nvmf_latency(struct spdk_json_write_ctx *w, const struct spdk_nvmf_latency_histogram *hist)
+{
+	uint64_t ticks_hz = spdk_get_ticks_hz();
+	uint64_t max_us;
+	int i;
+
+	spdk_json_write_array_begin(w);
+	for (i = 0; i < SPDK_NVMF_LATENCY_BUCKETS; i++) {
+		if (hist->bucket[i] == 0) {
+			continue;
+		}
+
+		/* Bucket i holds latencies of less than 2^i ticks */
+		if (i < 40) {
+			max_us = ((1ULL << i) * 1000000 + ticks_hz - 1) / ticks_hz;
+		} else {
+			max_us = ((1ULL << i) / ticks_hz) * 1000000;
+		}
+
+		spdk_json_write_object_begin(w);
+		spdk_json_write_name(w, "max_us");
+		spdk_json_write_uint64(w, max_us);
+		spdk_json_write_name(w, "count");
+		spdk_json_write_uint64(w, hist->bucket[i]);
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+}
+
+static void
+dump_nvmf_conn_stats(struct spdk_json_write_ctx *w, const struct nvmf_tgt_conn_stats *conn_stats)
+{
+	const struct spdk_nvmf_conn_stats *stats = &conn_stats->stats;
+
+	spdk_json_write_object_begin(w);
+
+	spdk_json_write_name(w, "session_id");
+	spdk_json_write_uint32(w, conn_stats->session_id);
+	spdk_json_write_name(w, "transport");
+	spdk_json_write_string(w, conn_stats->transport);
+	spdk_json_write_name(w, "type");
+	spdk_json_write_string(w, conn_stats->type == CONN_TYPE_AQ ? "admin" : "io");
+	spdk_json_write_name(w, "core");
+	spdk_json_write_uint32(w, conn_stats->lcore);
+
+	spdk_json_write_name(w, "capsules");
+	spdk_json_write_uint64(w, stats->capsules);
+	spdk_json_write_name(w, "in_capsule_writes");
+	spdk_json_write_uint64(w, stats->in_capsule_writes);
+	spdk_json_write_name(w, "transferred_writes");
+	spdk_json_write_uint64(w, stats->transferred_writes);
+	spdk_json_write_name(w, "host_to_ctrlr_bytes");
+	spdk_json_write_uint64(w, stats->host_to_ctrlr_bytes);
+	spdk_json_write_name(w, "ctrlr_to_host_bytes");
+	spdk_json_write_uint64(w, stats->ctrlr_to_host_bytes);
+	spdk_json_write_name(w, "pending_buf_waits");
+	spdk_json_write_uint64(w, stats->pending_buf_waits);
+	spdk_json_write_name(w, "pending_xfer_waits");
+	spdk_json_write_uint64(w, stats->pending_xfer_waits);
+	spdk_json_write_name(w, "queue_depth");
+	spdk_json_write_uint32(w, stats->queue_depth);
+	spdk_json_write_name(w, "peak_queue_depth");
+	spdk_json_write_uint32(w, stats->peak_queue_depth);
+
+	spdk_json_write_object_end(w);
+}
+
+static void
+dump_nvmf_subsystem_stats(struct spdk_json_write_ctx *w, struct nvmf_tgt_subsystem *tgt_subsystem)
+{
+	struct nvmf_tgt_stats	*stats;
+	uint32_t		i;
+
+	/* The subsystem has not published its statistics yet */
+	stats = nvmf_tgt_subsystem_get_stats(tgt_subsystem);
+	if (stats == NULL) {
+		return;
+	}
+
+	spdk_json_write_object_begin(w);
+
+	spdk_json_write_name(w, "nqn");
+	spdk_json_write_string(w, tgt_subsystem->subsystem->subnqn);
+
+	spdk_json_write_name(w, "connections");
+	spdk_json_write_array_begin(w);
+	for (i = 0; i < stats->num_conns; i++) {
+		dump_nvmf_conn_stats(w, &stats->conns[i]);
+	}
+	spdk_json_write_array_end(w);
+
+	spdk_json_write_name(w, "latency");
+	dump_nvmf_latency(w, &stats->latency);
+
+	spdk_json_write_object_end(w);
+
+	nvmf_tgt_stats_put(stats);
+}
+
+static void
+spdk_rpc_get_nvmf_stats(struct spdk_jsonrpc_server_conn *conn,
+			const struct spdk_json_val *params,
+			const struct spdk_json_val *id)
+{
+	struct spdk_json_write_ctx *w;
+	struct nvmf_tgt_subsystem	*tgt_subsystem;
+
+	if (params != NULL) {
+		spdk_jsonrpc_send_error_response(conn, id, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "get_nvmf_stats requires no parameters");
+		return;
+	}
+
+	if (id == NULL) {
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(conn, id);
+	spdk_json_write_array_begin(w);
+	tgt_subsystem = nvmf_tgt_subsystem_first();
+	while (tgt_subsystem) {
+		if (tgt_subsystem->subsystem->subtype == SPDK_NVMF_SUBTYPE_NVME) {
+			dump_nvmf_subsystem_stats(w, tgt_subsystem);
+		}
+		tgt_subsystem = nvmf_tgt_subsystem_next(tgt_subsystem);
+	}
+	spdk_json_write_array_end(w);
+	spdk_jsonrpc_end_result(conn, w);
+}
+SPDK_RPC_REGISTER("get_nvmf_stats", spdk_rpc_get_nvmf_stats)
+
 #define RPC_MAX_LISTEN_ADDRESSES 255
 #define RPC_MAX_HOSTS 255
 
@@ -31,7 +31,9 @@
  *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <assert.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -58,11 +60,119 @@
 #define SPDK_NVMF_BUILD_ETC "/usr/local/etc/nvmf"
 #define SPDK_NVMF_DEFAULT_CONFIG SPDK_NVMF_BUILD_ETC "/nvmf.conf"
 
+/* The application core mask is 64 bits wide */
+#define NVMF_TGT_MAX_LCORE 64
+
+/* How often each subsystem publishes the statistics of its connections */
+#define NVMF_TGT_STATS_PERIOD_US	(1000 * 1000)
+
 static struct spdk_poller *g_acceptor_poller = NULL;
 
+/* Pollers reaping the completion queues shared by the connections of each core */
+static struct spdk_poller *g_poll_group_pollers[NVMF_TGT_MAX_LCORE];
+
+/* Number of scheduled I/O queues per core and the next core for round-robin placement */
+static uint32_t g_conn_sched_load[NVMF_TGT_MAX_LCORE];
+static uint32_t g_conn_sched_next_lcore;
+
 static TAILQ_HEAD(, nvmf_tgt_subsystem) g_subsystems = TAILQ_HEAD_INITIALIZER(g_subsystems);
 static bool g_subsystems_shutdown;
 
+/* Protects the published statistics of each subsystem and their reference counts */
+static pthread_mutex_t g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void
+nvmf_tgt_stats_put(struct nvmf_tgt_stats *stats)
+{
+	bool last;
+
+	if (stats == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&g_stats_lock);
+	assert(stats->refcnt > 0);
+	last = (--stats->refcnt == 0);
+	pthread_mutex_unlock(&g_stats_lock);
+
+	if (last) {
+		free(stats);
+	}
+}
+
+struct nvmf_tgt_stats *
+nvmf_tgt_subsystem_get_stats(struct nvmf_tgt_subsystem *app_subsys)
+{
+	struct nvmf_tgt_stats *stats;
+
+	pthread_mutex_lock(&g_stats_lock);
+	stats = app_subsys->stats;
+	if (stats != NULL) {
+		stats->refcnt++;
+	}
+	pthread_mutex_unlock(&g_stats_lock);
+
+	return stats;
+}
+
+static void
+nvmf_tgt_subsystem_set_stats(struct nvmf_tgt_subsystem *app_subsys, struct nvmf_tgt_stats *stats)
+{
+	struct nvmf_tgt_stats *old;
+
+	pthread_mutex_lock(&g_stats_lock);
+	old = app_subsys->stats;
+	app_subsys->stats = stats;
+	pthread_mutex_unlock(&g_stats_lock);
+
+	nvmf_tgt_stats_put(old);
+}
+
+/*
+ * Copy the statistics of every connection of the subsystem. Runs on the
+ * subsystem's core, which owns its session and connection lists. The counters
+ * of I/O queues polled on other cores are read while they are being updated.
+ */
+static void
+subsystem_stats_poll(void *arg)
+{
+	struct nvmf_tgt_subsystem *app_subsys = arg;
+	struct spdk_nvmf_subsystem *subsystem = app_subsys->subsystem;
+	struct spdk_nvmf_session *session;
+	struct spdk_nvmf_conn *conn;
+	struct nvmf_tgt_conn_stats *conn_stats;
+	struct nvmf_tgt_stats *stats;
+	uint32_t num_conns = 0;
+
+	TAILQ_FOREACH(session, &subsystem->sessions, link) {
+		TAILQ_FOREACH(conn, &session->connections, link) {
+			num_conns++;
+		}
+	}
+
+	stats = calloc(1, sizeof(*stats) + num_conns * sizeof(stats->conns[0]));
+	if (stats == NULL) {
+		SPDK_ERRLOG("Unable to allocate statistics for subsystem %s\n", subsystem->subnqn);
+		return;
+	}
+
+	stats->refcnt = 1;
+	stats->latency = subsystem->closed_conn_latency;
+	TAILQ_FOREACH(session, &subsystem->sessions, link) {
+		TAILQ_FOREACH(conn, &session->connections, link) {
+			conn_stats = &stats->conns[stats->num_conns++];
+			conn_stats->session_id = session->id;
+			conn_stats->transport = conn->transport->name;
+			conn_stats->type = conn->type;
+			conn_stats->lcore = conn->scheduled ? conn->lcore : app_subsys->lcore;
+			conn_stats->stats = conn->stats;
+			spdk_nvmf_latency_histogram_merge(&stats->latency, &conn_stats->stats.latency);
+		}
+	}
+
+	nvmf_tgt_subsystem_set_stats(app_subsys, stats);
+}
+
 static void
 shutdown_complete(void)
 {
@@ -76,6 +186,7 @@ subsystem_delete_event(struct spdk_event *event)
 	struct spdk_nvmf_subsystem *subsystem = app_subsys->subsystem;
 
 	TAILQ_REMOVE(&g_subsystems, app_subsys, tailq);
+	nvmf_tgt_subsystem_set_stats(app_subsys, NULL);
 	free(app_subsys);
 
 	spdk_nvmf_delete_subsystem(subsystem);
@@ -87,7 +198,7 @@ subsystem_delete_event(struct spdk_event *event)
 }
 
 static void
-nvmf_tgt_delete_subsystem(struct nvmf_tgt_subsystem *app_subsys)
+nvmf_tgt_subsystem_stopped(struct nvmf_tgt_subsystem *app_subsys)
 {
 	struct spdk_nvmf_subsystem *subsystem = app_subsys->subsystem;
 	struct spdk_event *event;
@@ -101,15 +212,128 @@ nvmf_tgt_delete_subsystem(struct nvmf_tgt_subsystem *app_subsys)
 		}
 	}
 
+	spdk_poller_unregister(&app_subsys->stats_poller, NULL);
+
 	/*
 	 * Unregister the poller - this starts a chain of events that will eventually free
 	 * the subsystem's memory.
 	 */
-	event = spdk_event_allocate(spdk_app_get_current_core(), subsystem_delete_event,
+	event = spdk_event_allocate(app_subsys->delete_lcore, subsystem_delete_event,
 				    app_subsys, NULL, NULL);
 	spdk_poller_unregister(&app_subsys->poller, event);
 }
 
+static void
+conn_disconnect_event(struct spdk_event *event)
+{
+	struct spdk_nvmf_conn *conn = spdk_event_get_arg1(event);
+	struct nvmf_tgt_subsystem *app_subsys = spdk_event_get_arg2(event);
+
+	__sync_fetch_and_sub(&g_conn_sched_load[conn->lcore], 1);
+	spdk_nvmf_session_disconnect(conn);
+
+	app_subsys->num_scheduled_conns--;
+	if (app_subsys->deleting && app_subsys->num_scheduled_conns == 0) {
+		nvmf_tgt_subsystem_stopped(app_subsys);
+	}
+}
+
+static void
+conn_poller_stopped_event(struct spdk_event *event)
+{
+	struct spdk_nvmf_conn *conn = spdk_event_get_arg1(event);
+	struct nvmf_tgt_subsystem *app_subsys = spdk_event_get_arg2(event);
+	struct spdk_nvmf_subsystem *subsystem = app_subsys->subsystem;
+	int i;
+
+	for (i = 0; i < subsystem->dev.virt.ns_count; i++) {
+		spdk_put_io_channel(conn->ch[i]);
+		conn->ch[i] = NULL;
+	}
+
+	/* Hand the connection back to the core that owns its session */
+	event = spdk_event_allocate(app_subsys->lcore, conn_disconnect_event, conn, app_subsys, NULL);
+	spdk_event_call(event);
+}
+
+static void
+conn_stop_poller_event(struct spdk_event *event)
+{
+	struct spdk_nvmf_conn *conn = spdk_event_get_arg1(event);
+	struct nvmf_tgt_subsystem *app_subsys = spdk_event_get_arg2(event);
+	struct spdk_event *next;
+
+	/* The poller may already be gone if the transport reported an error. */
+	next = spdk_event_allocate(conn->lcore, conn_poller_stopped_event, conn, app_subsys, NULL);
+	spdk_poller_unregister(&conn->poller, next);
+}
+
+/*
+ * Tear down a scheduled I/O queue. Must be called on the core that owns the
+ * subsystem, which serializes the transport's disconnect notification, poll
+ * errors and subsystem deletion.
+ */
+static void
+nvmf_tgt_stop_conn(struct nvmf_tgt_subsystem *app_subsys, struct spdk_nvmf_conn *conn)
+{
+	struct spdk_event *event;
+
+	if (conn->stopping) {
+		return;
+	}
+	conn->stopping = true;
+
+	event = spdk_event_allocate(conn->lcore, conn_stop_poller_event, conn, app_subsys, NULL);
+	spdk_event_call(event);
+}
+
+static void
+conn_stop_event(struct spdk_event *event)
+{
+	struct spdk_nvmf_conn *conn = spdk_event_get_arg1(event);
+	struct nvmf_tgt_subsystem *app_subsys = spdk_event_get_arg2(event);
+
+	nvmf_tgt_stop_conn(app_subsys, conn);
+}
+
+static void
+subsystem_stop_event(struct spdk_event *event)
+{
+	struct nvmf_tgt_subsystem *app_subsys = spdk_event_get_arg1(event);
+	struct spdk_nvmf_subsystem *subsystem = app_subsys->subsystem;
+	struct spdk_nvmf_session *session;
+	struct spdk_nvmf_conn *conn;
+
+	app_subsys->deleting = true;
+
+	TAILQ_FOREACH(session, &subsystem->sessions, link) {
+		TAILQ_FOREACH(conn, &session->connections, link) {
+			if (conn->scheduled) {
+				nvmf_tgt_stop_conn(app_subsys, conn);
+			}
+		}
+	}
+
+	if (app_subsys->num_scheduled_conns == 0) {
+		nvmf_tgt_subsystem_stopped(app_subsys);
+	}
+}
+
+static void
+nvmf_tgt_delete_subsystem(struct nvmf_tgt_subsystem *app_subsys)
+{
+	struct spdk_event *event;
+
+	/*
+	 * I/O queues polled on other cores must be stopped before the sessions can be
+	 * destroyed. Do that on the core that owns the sessions; the subsystem itself is
+	 * freed back on this core.
+	 */
+	app_subsys->delete_lcore = spdk_app_get_current_core();
+	event = spdk_event_allocate(app_subsys->lcore, subsystem_stop_event, app_subsys, NULL, NULL);
+	spdk_event_call(event);
+}
+
 static void
 shutdown_subsystems(void)
 {
@@ -128,6 +352,36 @@ acceptor_poller_unregistered_event(struct spdk_event *event)
 	shutdown_subsystems();
 }
 
+static void
+poll_group_poll(void *arg)
+{
+	spdk_nvmf_poll_group_poll();
+}
+
+static void
+nvmf_tgt_start_poll_groups(void)
+{
+	uint64_t mask = spdk_app_get_core_mask();
+	uint32_t lcore;
+
+	for (lcore = 0; lcore < NVMF_TGT_MAX_LCORE; lcore++) {
+		if (((mask >> lcore) & 1ULL) != 0) {
+			spdk_poller_register(&g_poll_group_pollers[lcore], poll_group_poll, NULL,
+					     lcore, NULL, 0);
+		}
+	}
+}
+
+static void
+nvmf_tgt_stop_poll_groups(void)
+{
+	uint32_t lcore;
+
+	for (lcore = 0; lcore < NVMF_TGT_MAX_LCORE; lcore++) {
+		spdk_poller_unregister(&g_poll_group_pollers[lcore], NULL);
+	}
+}
+
 static void
 spdk_nvmf_shutdown_cb(void)
 {
@@ -137,6 +391,8 @@ spdk_nvmf_shutdown_cb(void)
 	fprintf(stdout, "   NVMF shutdown signal\n");
 	fprintf(stdout, "=========================\n");
 
+	nvmf_tgt_stop_poll_groups();
+
 	event = spdk_event_allocate(spdk_app_get_current_core(), acceptor_poller_unregistered_event,
 				    NULL, NULL, NULL);
 	spdk_poller_unregister(&g_acceptor_poller, event);
@@ -150,12 +406,114 @@ subsystem_poll(void *arg)
 	spdk_nvmf_subsystem_poll(app_subsys->subsystem);
 }
 
+static void
+conn_poll(void *arg)
+{
+	struct spdk_nvmf_conn *conn = arg;
+	struct nvmf_tgt_subsystem *app_subsys = conn->sess->subsys->cb_ctx;
+	struct spdk_event *event;
+
+	if (conn->transport->conn_poll(conn) < 0) {
+		SPDK_ERRLOG("Transport poll failed for conn %p; closing connection\n", conn);
+		spdk_poller_unregister(&conn->poller, NULL);
+		event = spdk_event_allocate(app_subsys->lcore, conn_stop_event, conn, app_subsys, NULL);
+		spdk_event_call(event);
+	}
+}
+
+static void
+conn_start_event(struct spdk_event *event)
+{
+	struct spdk_nvmf_conn *conn = spdk_event_get_arg1(event);
+	struct nvmf_tgt_subsystem *app_subsys = spdk_event_get_arg2(event);
+	struct spdk_nvmf_subsystem *subsystem = app_subsys->subsystem;
+	int i;
+
+	for (i = 0; i < subsystem->dev.virt.ns_count; i++) {
+		conn->ch[i] = spdk_bdev_get_io_channel(subsystem->dev.virt.ns_list[i],
+						       app_subsys->io_priority);
+		assert(conn->ch[i] != NULL);
+	}
+
+	spdk_poller_register(&conn->poller, conn_poll, conn, conn->lcore, NULL, 0);
+}
+
+static uint32_t
+nvmf_tgt_conn_select_lcore(void)
+{
+	uint64_t mask = spdk_app_get_core_mask();
+	uint32_t lcore, best;
+
+	if (g_spdk_nvmf_tgt_conf.conn_sched == CONN_SCHED_ROUND_ROBIN) {
+		do {
+			lcore = __sync_fetch_and_add(&g_conn_sched_next_lcore, 1) % NVMF_TGT_MAX_LCORE;
+		} while (((mask >> lcore) & 1ULL) == 0);
+
+		return lcore;
+	}
+
+	/* The load counters are updated from several cores, so this is a best effort choice. */
+	best = NVMF_TGT_MAX_LCORE;
+	for (lcore = 0; lcore < NVMF_TGT_MAX_LCORE; lcore++) {
+		if (((mask >> lcore) & 1ULL) == 0) {
+			continue;
+		}
+
+		if (best == NVMF_TGT_MAX_LCORE || g_conn_sched_load[lcore] < g_conn_sched_load[best]) {
+			best = lcore;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Move a newly connected I/O queue onto a core chosen by the connection scheduler.
+ * The admin queue and all session state stay on the subsystem's core; the I/O queue
+ * only comes back there, by event, to be disconnected.
+ */
+static void
+nvmf_tgt_schedule_conn(struct nvmf_tgt_subsystem *app_subsys, struct spdk_nvmf_conn *conn)
+{
+	struct spdk_nvmf_subsystem *subsystem = app_subsys->subsystem;
+	struct spdk_event *event;
+
+	/* Direct mode subsystems share one NVMe I/O queue pair, so they stay on one core. */
+	if (g_spdk_nvmf_tgt_conf.conn_sched == CONN_SCHED_SUBSYSTEM ||
+	    subsystem->subtype != SPDK_NVMF_SUBTYPE_NVME ||
+	    subsystem->mode != NVMF_SUBSYSTEM_MODE_VIRTUAL ||
+	    app_subsys->deleting) {
+		return;
+	}
+
+	/* Poll the queue where the transport reaps its completions, if it chose a core */
+	if (!conn->lcore_preferred) {
+		conn->lcore = nvmf_tgt_conn_select_lcore();
+	}
+	conn->scheduled = true;
+	app_subsys->num_scheduled_conns++;
+	__sync_fetch_and_add(&g_conn_sched_load[conn->lcore], 1);
+
+	SPDK_TRACELOG(SPDK_TRACE_NVMF, "conn %p of subsystem %s scheduled on lcore %u\n",
+		      conn, subsystem->subnqn, conn->lcore);
+
+	event = spdk_event_allocate(conn->lcore, conn_start_event, conn, app_subsys, NULL);
+	spdk_event_call(event);
+}
+
 static void
 connect_event(struct spdk_event *event)
 {
 	struct spdk_nvmf_request *req = spdk_event_get_arg1(event);
+	struct nvmf_tgt_subsystem *app_subsys = spdk_event_get_arg2(event);
+	struct spdk_nvmf_conn *conn = req->conn;
 
 	spdk_nvmf_handle_connect(req);
+
+	/* The session is only set if the connect succeeded */
+	if (conn->sess != NULL && conn->type == CONN_TYPE_IOQ) {
+		nvmf_tgt_schedule_conn(app_subsys, conn);
+	}
 }
 
 static void
@@ -165,7 +523,7 @@ connect_cb(void *cb_ctx, struct spdk_nvmf_request *req)
 	struct spdk_event *event;
 
 	/* Pass an event to the lcore that owns this subsystem */
-	event = spdk_event_allocate(app_subsys->lcore, connect_event, req, NULL, NULL);
+	event = spdk_event_allocate(app_subsys->lcore, connect_event, req, app_subsys, NULL);
 	spdk_event_call(event);
 }
 
@@ -173,8 +531,13 @@ static void
 disconnect_event(struct spdk_event *event)
 {
 	struct spdk_nvmf_conn *conn = spdk_event_get_arg1(event);
+	struct nvmf_tgt_subsystem *app_subsys = spdk_event_get_arg2(event);
 
-	spdk_nvmf_session_disconnect(conn);
+	if (conn->scheduled) {
+		nvmf_tgt_stop_conn(app_subsys, conn);
+	} else {
+		spdk_nvmf_session_disconnect(conn);
+	}
 }
 
 static void
@@ -183,8 +546,8 @@ disconnect_cb(void *cb_ctx, struct spdk_nvmf_conn *conn)
 	struct nvmf_tgt_subsystem *app_subsys = cb_ctx;
 	struct spdk_event *event;
 
-	/* Pass an event to the core that owns this connection */
-	event = spdk_event_allocate(app_subsys->lcore, disconnect_event, conn, NULL, NULL);
+	/* Pass an event to the core that owns this connection's session */
+	event = spdk_event_allocate(app_subsys->lcore, disconnect_event, conn, app_subsys, NULL);
 	spdk_event_call(event);
 }
 
@@ -202,13 +565,19 @@ nvmf_tgt_start_subsystem(struct spdk_event *event)
 	    subsystem->mode == NVMF_SUBSYSTEM_MODE_VIRTUAL) {
 		for (i = 0; i < subsystem->dev.virt.ns_count; i++) {
 			bdev = subsystem->dev.virt.ns_list[i];
-			ch = spdk_bdev_get_io_channel(bdev, SPDK_IO_PRIORITY_DEFAULT);
+			ch = spdk_bdev_get_io_channel(bdev, app_subsys->io_priority);
 			assert(ch != NULL);
 			subsystem->dev.virt.ch[i] = ch;
 		}
 	}
 
 	spdk_poller_register(&app_subsys->poller, subsystem_poll, app_subsys, lcore, NULL, 0);
+
+	if (subsystem->subtype == SPDK_NVMF_SUBTYPE_NVME) {
+		subsystem_stats_poll(app_subsys);
+		spdk_poller_register(&app_subsys->stats_poller, subsystem_stats_poll, app_subsys, lcore,
+				     NULL, NVMF_TGT_STATS_PERIOD_US);
+	}
 }
 
 struct nvmf_tgt_subsystem *
@@ -233,6 +602,8 @@ nvmf_tgt_create_subsystem(int num, const char *name, enum spdk_nvmf_subtype subt
 
 	app_subsys->subsystem = subsystem;
 	app_subsys->lcore = lcore;
+	subsystem->lcore = lcore;
+	app_subsys->io_priority = SPDK_IO_PRIORITY_DEFAULT;
 
 	SPDK_TRACELOG(SPDK_TRACE_NVMF, "allocated subsystem %p on lcore %u\n", subsystem, lcore);
 
@@ -336,6 +707,10 @@ spdk_nvmf_startup(spdk_event_t event)
 
 	SPDK_NOTICELOG("Acceptor running on core %u\n", g_spdk_nvmf_tgt_conf.acceptor_lcore);
 
+	if (g_spdk_nvmf_tgt_conf.poll_groups) {
+		nvmf_tgt_start_poll_groups();
+	}
+
 	if (getenv("MEMZONE_DUMP") != NULL) {
 		rte_memzone_dump(stdout);
 		fflush(stdout);
@@ -34,29 +34,84 @@
 #ifndef NVMF_TGT_H
 #define NVMF_TGT_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "spdk/nvmf_spec.h"
 #include "spdk/queue.h"
 
+#include "nvmf/session.h"
+
 struct rpc_listen_address {
 	char *transport;
 	char *traddr;
 	char *trsvcid;
 };
 
+enum nvmf_tgt_conn_sched {
+	/* Poll every connection on the core that owns its subsystem */
+	CONN_SCHED_SUBSYSTEM = 0,
+
+	/* Place each I/O queue on the next core in the application core mask */
+	CONN_SCHED_ROUND_ROBIN,
+
+	/* Place each I/O queue on the core with the fewest scheduled I/O queues */
+	CONN_SCHED_LEAST_LOADED,
+};
+
 struct spdk_nvmf_tgt_conf {
 	uint32_t acceptor_lcore;
 	uint32_t acceptor_poll_rate;
+	enum nvmf_tgt_conn_sched conn_sched;
+
+	/* Reap shared completion queues with a poller on every core */
+	bool poll_groups;
+};
+
+/* Statistics of one connection, copied on the core that owns its subsystem */
+struct nvmf_tgt_conn_stats {
+	uint32_t			session_id;
+	const char			*transport;
+	enum conn_type			type;
+	uint32_t			lcore;
+	struct spdk_nvmf_conn_stats	stats;
+};
+
+/*
+ * Snapshot of the statistics of a subsystem's connections. The sessions and
+ * connections may only be walked on the subsystem's core, so that core
+ * publishes a new snapshot periodically and readers on other cores hold a
+ * reference to the one they are using.
+ */
+struct nvmf_tgt_stats {
+	uint32_t				refcnt;
+
+	/* Latency of all I/O queue commands, including those of closed connections */
+	struct spdk_nvmf_latency_histogram	latency;
+
+	uint32_t				num_conns;
+	struct nvmf_tgt_conn_stats		conns[];
 };
 
 struct nvmf_tgt_subsystem {
 	struct spdk_nvmf_subsystem *subsystem;
 	struct spdk_poller *poller;
 
+	/* Publishes stats on lcore; stats is protected by the stats lock */
+	struct spdk_poller *stats_poller;
+	struct nvmf_tgt_stats *stats;
+
 	TAILQ_ENTRY(nvmf_tgt_subsystem) tailq;
 
 	uint32_t lcore;
+
+	/* I/O channel priority for the block devices of a virtual subsystem */
+	uint32_t io_priority;
+
+	/* I/O queues polled on their own cores; only touched on lcore */
+	uint32_t num_scheduled_conns;
+	bool deleting;
+	uint32_t delete_lcore;
 };
 
 extern struct spdk_nvmf_tgt_conf g_spdk_nvmf_tgt_conf;
@@ -67,6 +122,13 @@ nvmf_tgt_subsystem_first(void);
 struct nvmf_tgt_subsystem *
 nvmf_tgt_subsystem_next(struct nvmf_tgt_subsystem *subsystem);
 
+/* Returns a reference to the last published statistics of a subsystem, or NULL */
+struct nvmf_tgt_stats *
+nvmf_tgt_subsystem_get_stats(struct nvmf_tgt_subsystem *app_subsys);
+
+void
+nvmf_tgt_stats_put(struct nvmf_tgt_stats *stats);
+
 int spdk_nvmf_parse_conf(void);
 
 struct nvmf_tgt_subsystem *nvmf_tgt_create_subsystem(int num,
@@ -107,6 +107,8 @@ time test/nvmf/fio/fio.sh
 time test/nvmf/filesystem/filesystem.sh
 time test/nvmf/discovery/discovery.sh
 time test/nvmf/nvme_cli/nvme_cli.sh
+time test/nvmf/tcp/tcp.sh
+time test/nvmf/host_tcp/host_tcp.sh
 
 timing_exit nvmf
 
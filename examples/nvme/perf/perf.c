@@ -151,6 +151,9 @@ static uint32_t g_max_completions;
 
 static const char *g_core_mask;
 
+/* Remote controller to connect to instead of probing local controllers, or NULL */
+static const char *g_trid_str;
+
 static int g_aio_optind; /* Index of first AIO filename in argv */
 
 static void
@@ -644,6 +647,8 @@ static void usage(char *program_name)
 	printf("\t\t(default: 1)]\n");
 	printf("\t[-m max completions per poll]\n");
 	printf("\t\t(default: 0 - unlimited)\n");
+	printf("\t[-r remote NVMe over Fabrics controller to use instead of local controllers]\n");
+	printf("\t\t(e.g. 'trtype:TCP traddr:127.0.0.1 trsvcid:4420 subnqn:nqn...')\n");
 }
 
 static void
@@ -800,8 +805,9 @@ parse_args(int argc, char **argv)
 	g_rw_percentage = -1;
 	g_core_mask = NULL;
 	g_max_completions = 0;
+	g_trid_str = NULL;
 
-	while ((op = getopt(argc, argv, "c:lm:q:s:t:w:M:")) != -1) {
+	while ((op = getopt(argc, argv, "c:lm:q:r:s:t:w:M:")) != -1) {
 		switch (op) {
 		case 'c':
 			g_core_mask = optarg;
@@ -815,6 +821,9 @@ parse_args(int argc, char **argv)
 		case 'q':
 			g_queue_depth = atoi(optarg);
 			break;
+		case 'r':
+			g_trid_str = optarg;
+			break;
 		case 's':
 			g_io_size_bytes = atoi(optarg);
 			break;
@@ -991,8 +1000,29 @@ attach_cb(void *cb_ctx, struct spdk_pci_device *dev, struct spdk_nvme_ctrlr *ctr
 static int
 register_controllers(void)
 {
+	struct spdk_nvme_transport_id	trid;
+	struct spdk_nvme_ctrlr		*ctrlr;
+
 	printf("Initializing NVMe Controllers\n");
 
+	if (g_trid_str != NULL) {
+		if (spdk_nvme_transport_id_parse(&trid, g_trid_str) != 0) {
+			fprintf(stderr, "Invalid transport ID '%s'\n", g_trid_str);
+			return 1;
+		}
+
+		printf("Connecting to %s at %s:%s\n", trid.subnqn, trid.traddr, trid.trsvcid);
+		ctrlr = spdk_nvme_connect(&trid, NULL);
+		if (ctrlr == NULL) {
+			fprintf(stderr, "spdk_nvme_connect() failed\n");
+			return 1;
+		}
+		printf("Connected to %s\n", trid.subnqn);
+
+		register_ctrlr(ctrlr);
+		return 0;
+	}
+
 	if (spdk_nvme_probe(NULL, probe_cb, attach_cb, NULL) != 0) {
 		fprintf(stderr, "spdk_nvme_probe() failed\n");
 		return 1;
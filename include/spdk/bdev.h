@@ -95,6 +95,9 @@ struct spdk_bdev {
 	/** Represents maximum unmap block descriptor count */
 	uint32_t max_unmap_bdesc_count;
 
+	/** Number of write streams the backend can separate data into (0 = none) */
+	uint16_t max_write_streams;
+
 	/** generation value used by block device reset */
 	uint32_t gencnt;
 
@@ -133,6 +136,16 @@ struct spdk_bdev_fn_table {
 
 	/** Get an I/O channel for the specific bdev for the calling thread. */
 	struct spdk_io_channel *(*get_io_channel)(struct spdk_bdev *bdev, uint32_t priority);
+
+	/**
+	 * Optional: allocate a read buffer of the given size from memory owned by the device
+	 *  (for example, an NVMe controller memory buffer).  Return NULL to fall back to the
+	 *  blockdev layer's buffer pools.  The buffer is only used for I/O to this bdev.
+	 */
+	void *(*get_rbuf)(struct spdk_bdev *bdev, uint64_t size);
+
+	/** Release a buffer returned by get_rbuf. */
+	void (*put_rbuf)(struct spdk_bdev *bdev, void *buf, uint64_t size);
 };
 
 /** Blockdev I/O completion status */
@@ -159,6 +172,35 @@ enum spdk_bdev_reset_type {
 	SPDK_BDEV_RESET_SOFT,
 };
 
+/** Expected access frequency of the data of an I/O */
+enum spdk_bdev_access_freq {
+	SPDK_BDEV_ACCESS_FREQ_NONE = 0,			/**< no information */
+	SPDK_BDEV_ACCESS_FREQ_TYPICAL,			/**< typical reads and writes */
+	SPDK_BDEV_ACCESS_FREQ_INFREQ_WRITE_INFREQ_READ,
+	SPDK_BDEV_ACCESS_FREQ_INFREQ_WRITE_FREQ_READ,
+	SPDK_BDEV_ACCESS_FREQ_FREQ_WRITE_INFREQ_READ,
+	SPDK_BDEV_ACCESS_FREQ_FREQ_WRITE_FREQ_READ,
+	SPDK_BDEV_ACCESS_FREQ_ONE_TIME_READ,		/**< the data is read once, e.g. a backup */
+	SPDK_BDEV_ACCESS_FREQ_SPECULATIVE_READ,		/**< e.g. read ahead */
+	SPDK_BDEV_ACCESS_FREQ_OVERWRITTEN_SOON,		/**< the data will be overwritten soon */
+};
+
+/**
+ * Optional hints describing the data of an I/O.
+ *
+ * Hints are advisory; backends that cannot use a hint ignore it.
+ */
+struct spdk_bdev_io_hints {
+	/** See enum spdk_bdev_access_freq */
+	uint8_t access_freq;
+
+	/** The I/O is part of a larger sequential transfer */
+	bool sequential;
+
+	/** Write stream to place the data in, 1 to max_write_streams, or 0 for none */
+	uint16_t write_stream;
+};
+
 typedef spdk_event_fn spdk_bdev_io_completion_cb;
 typedef void (*spdk_bdev_io_get_rbuf_cb)(struct spdk_bdev_io *bdev_io);
 
@@ -195,11 +237,23 @@ struct spdk_bdev_io {
 			/** For single buffer cases, size of the data buffer. */
 			uint64_t nbytes;
 
+			/** For basic read case, use our own iovec element */
+			struct iovec iov;
+
+			/** For SG buffer cases, array of iovecs to transfer. */
+			struct iovec *iovs;
+
+			/** For SG buffer cases, number of iovecs in iovec array. */
+			int iovcnt;
+
 			/** Starting offset (in bytes) of the blockdev for this I/O. */
 			uint64_t offset;
 
 			/** Indicate whether the blockdev layer to put rbuf or not. */
 			bool put_rbuf;
+
+			/** Indicate whether the rbuf came from the bdev's get_rbuf function. */
+			bool rbuf_from_bdev;
 		} read;
 		struct {
 			/** For basic write case, use our own iovec element */
@@ -236,6 +290,9 @@ struct spdk_bdev_io {
 		} reset;
 	} u;
 
+	/** Hints for read and write I/O; zeroed when the caller provided none. */
+	struct spdk_bdev_io_hints hints;
+
 	/** User function that will be called when this completes */
 	spdk_bdev_io_completion_cb cb;
 
@@ -279,6 +336,10 @@ bool spdk_bdev_io_type_supported(struct spdk_bdev *bdev, enum spdk_bdev_io_type
 struct spdk_bdev_io *spdk_bdev_read(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 				    void *buf, uint64_t offset, uint64_t nbytes,
 				    spdk_bdev_io_completion_cb cb, void *cb_arg);
+struct spdk_bdev_io *spdk_bdev_readv(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+				     struct iovec *iov, int iovcnt,
+				     uint64_t offset, uint64_t nbytes,
+				     spdk_bdev_io_completion_cb cb, void *cb_arg);
 struct spdk_bdev_io *spdk_bdev_write(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 				     void *buf, uint64_t offset, uint64_t nbytes,
 				     spdk_bdev_io_completion_cb cb, void *cb_arg);
@@ -286,6 +347,24 @@ struct spdk_bdev_io *spdk_bdev_writev(struct spdk_bdev *bdev, struct spdk_io_cha
 				      struct iovec *iov, int iovcnt,
 				      uint64_t offset, uint64_t len,
 				      spdk_bdev_io_completion_cb cb, void *cb_arg);
+struct spdk_bdev_io *spdk_bdev_read_with_hints(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+		void *buf, uint64_t offset, uint64_t nbytes,
+		const struct spdk_bdev_io_hints *hints,
+		spdk_bdev_io_completion_cb cb, void *cb_arg);
+struct spdk_bdev_io *spdk_bdev_readv_with_hints(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+		struct iovec *iov, int iovcnt,
+		uint64_t offset, uint64_t nbytes,
+		const struct spdk_bdev_io_hints *hints,
+		spdk_bdev_io_completion_cb cb, void *cb_arg);
+struct spdk_bdev_io *spdk_bdev_write_with_hints(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+		void *buf, uint64_t offset, uint64_t nbytes,
+		const struct spdk_bdev_io_hints *hints,
+		spdk_bdev_io_completion_cb cb, void *cb_arg);
+struct spdk_bdev_io *spdk_bdev_writev_with_hints(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+		struct iovec *iov, int iovcnt,
+		uint64_t offset, uint64_t len,
+		const struct spdk_bdev_io_hints *hints,
+		spdk_bdev_io_completion_cb cb, void *cb_arg);
 struct spdk_bdev_io *spdk_bdev_unmap(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 				     struct spdk_scsi_unmap_bdesc *unmap_d,
 				     uint16_t bdesc_count,
@@ -0,0 +1,232 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/** \file
+ * T10 protection information (DIF/DIX) generation and verification
+ */
+
+#ifndef SPDK_DIF_H
+#define SPDK_DIF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/**
+ * Check flags.  The values match SPDK_NVME_IO_FLAGS_PRCHK_* so that NVMe I/O flags may be
+ *  passed through unchanged.
+ */
+#define SPDK_DIF_FLAGS_REFTAG_CHECK	(1U << 26)
+#define SPDK_DIF_FLAGS_APPTAG_CHECK	(1U << 27)
+#define SPDK_DIF_FLAGS_GUARD_CHECK	(1U << 28)
+
+/** Size of the protection information field in the metadata of each block. */
+#define SPDK_DIF_PI_SIZE		8
+
+/** Protection information types.  The values match enum spdk_nvme_pi_type. */
+enum spdk_dif_type {
+	SPDK_DIF_DISABLE	= 0,
+	SPDK_DIF_TYPE1		= 1,
+	SPDK_DIF_TYPE2		= 2,
+	SPDK_DIF_TYPE3		= 3,
+};
+
+/** Types of errors reported by verification. */
+enum spdk_dif_error_type {
+	SPDK_DIF_REFTAG_ERROR	= 0x1,
+	SPDK_DIF_APPTAG_ERROR	= 0x2,
+	SPDK_DIF_GUARD_ERROR	= 0x4,
+};
+
+/**
+ * \brief Description of how protection information is laid out and checked.
+ *
+ * Initialize with spdk_dif_ctx_init().
+ */
+struct spdk_dif_ctx {
+	/** Size of each block in the data buffer, including interleaved metadata */
+	uint32_t		block_size;
+
+	/** Size of the metadata of each block */
+	uint32_t		md_size;
+
+	/** Metadata is interleaved with the data (DIF) rather than in a separate buffer (DIX) */
+	bool			md_interleave;
+
+	/** Number of bytes of data and metadata covered by the guard; also the PI offset */
+	uint32_t		guard_interval;
+
+	enum spdk_dif_type	dif_type;
+
+	/** Combination of SPDK_DIF_FLAGS_* */
+	uint32_t		dif_flags;
+
+	/** Reference tag of the first block */
+	uint32_t		init_ref_tag;
+
+	uint16_t		app_tag;
+
+	/** Bits of the application tag compared by SPDK_DIF_FLAGS_APPTAG_CHECK */
+	uint16_t		apptag_mask;
+
+	/** Initial CRC value of the guard */
+	uint16_t		guard_seed;
+};
+
+/** \brief Location and contents of the first protection information mismatch. */
+struct spdk_dif_error {
+	enum spdk_dif_error_type	err_type;
+
+	/** Value computed from the context, or the guard computed from the data */
+	uint32_t			expected;
+
+	/** Value found in the protection information */
+	uint32_t			actual;
+
+	/** Index of the failing block, relative to the start of the buffer */
+	uint32_t			err_offset;
+};
+
+/**
+ * Initialize a DIF context.
+ *
+ * \param ctx Context to initialize.
+ * \param block_size Size of each block in the data buffer.  For interleaved metadata this is
+ * the extended block size, including md_size.
+ * \param md_size Size of the metadata of each block.  Must be at least SPDK_DIF_PI_SIZE.
+ * \param md_interleave true if metadata is interleaved with the data (DIF), or false if it
+ * is transferred in a separate buffer (DIX).
+ * \param dif_loc true if the protection information is in the first 8 bytes of the metadata,
+ * or false if it is in the last 8 bytes.  In the latter case the guard also covers the
+ * metadata preceding the protection information.
+ * \param dif_type Protection information type.
+ * \param dif_flags Combination of SPDK_DIF_FLAGS_* selecting the fields to generate and check.
+ * \param init_ref_tag Reference tag of the first block.  Type 1 and type 2 reference tags
+ * increment by one for each following block.
+ * \param apptag_mask Bits of the application tag to check.
+ * \param app_tag Application tag.
+ * \param guard_seed Initial CRC value of the guard, normally 0.
+ *
+ * \return 0 on success, or -EINVAL if the layout is invalid.
+ */
+int spdk_dif_ctx_init(struct spdk_dif_ctx *ctx, uint32_t block_size, uint32_t md_size,
+		      bool md_interleave, bool dif_loc, enum spdk_dif_type dif_type,
+		      uint32_t dif_flags, uint32_t init_ref_tag, uint16_t apptag_mask,
+		      uint16_t app_tag, uint16_t guard_seed);
+
+/**
+ * Generate protection information for blocks with interleaved metadata.
+ *
+ * The guard is only computed if SPDK_DIF_FLAGS_GUARD_CHECK is set, and is 0 otherwise.
+ *  Blocks may span iovec boundaries.
+ *
+ * \return 0 on success, or -EINVAL if the iovecs are shorter than num_blocks.
+ */
+int spdk_dif_generate(struct iovec *iovs, int iovcnt, uint32_t num_blocks,
+		      const struct spdk_dif_ctx *ctx);
+
+/**
+ * Verify the protection information of blocks with interleaved metadata.
+ *
+ * Checking is skipped for blocks whose application tag is 0xFFFF (type 1 and type 2), or
+ *  whose application tag is 0xFFFF and reference tag is 0xFFFFFFFF (type 3).
+ *
+ * \param err_blk Optional; filled in with the first mismatch.
+ *
+ * \return 0 on success, -EIO if a block failed verification, or -EINVAL if the iovecs are
+ * shorter than num_blocks.
+ */
+int spdk_dif_verify(struct iovec *iovs, int iovcnt, uint32_t num_blocks,
+		    const struct spdk_dif_ctx *ctx, struct spdk_dif_error *err_blk);
+
+/**
+ * Copy data-only blocks into blocks with interleaved metadata and generate their protection
+ *  information.
+ *
+ * Metadata bytes other than the protection information are left unchanged in dst_iovs.
+ *
+ * \param src_iovs Data of num_blocks blocks of (ctx->block_size - ctx->md_size) bytes.
+ * \param dst_iovs Buffer for num_blocks blocks of ctx->block_size bytes.
+ *
+ * \return 0 on success, or -EINVAL if either buffer is too short.
+ */
+int spdk_dif_insert(struct iovec *src_iovs, int src_iovcnt, struct iovec *dst_iovs,
+		    int dst_iovcnt, uint32_t num_blocks, const struct spdk_dif_ctx *ctx);
+
+/**
+ * Verify blocks with interleaved metadata and copy only their data.
+ *
+ * \param src_iovs Data of num_blocks blocks of ctx->block_size bytes.
+ * \param dst_iovs Buffer for num_blocks blocks of (ctx->block_size - ctx->md_size) bytes.
+ * \param err_blk Optional; filled in with the first mismatch.
+ *
+ * \return 0 on success, -EIO if a block failed verification, or -EINVAL if either buffer
+ * is too short.  Blocks preceding a failing block have been copied.
+ */
+int spdk_dif_strip(struct iovec *src_iovs, int src_iovcnt, struct iovec *dst_iovs,
+		   int dst_iovcnt, uint32_t num_blocks, const struct spdk_dif_ctx *ctx,
+		   struct spdk_dif_error *err_blk);
+
+/**
+ * Generate protection information into a separate metadata buffer.
+ *
+ * \param iovs Data of num_blocks blocks of ctx->block_size bytes.
+ * \param md_iov Metadata buffer of num_blocks * ctx->md_size bytes.
+ *
+ * \return 0 on success, or -EINVAL if either buffer is too short.
+ */
+int spdk_dix_generate(struct iovec *iovs, int iovcnt, struct iovec *md_iov,
+		      uint32_t num_blocks, const struct spdk_dif_ctx *ctx);
+
+/**
+ * Verify protection information in a separate metadata buffer.
+ *
+ * \param err_blk Optional; filled in with the first mismatch.
+ *
+ * \return 0 on success, -EIO if a block failed verification, or -EINVAL if either buffer
+ * is too short.
+ */
+int spdk_dix_verify(struct iovec *iovs, int iovcnt, struct iovec *md_iov,
+		    uint32_t num_blocks, const struct spdk_dif_ctx *ctx,
+		    struct spdk_dif_error *err_blk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPDK_DIF_H */
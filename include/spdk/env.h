@@ -121,10 +121,41 @@ int spdk_pci_enumerate(enum spdk_pci_device_type type,
 		       spdk_pci_enum_cb enum_cb,
 		       void *enum_ctx);
 
+/**
+ * Rescan the PCI bus so that devices added after initialization can be enumerated.
+ */
+int spdk_pci_scan(void);
+
 int spdk_pci_device_map_bar(struct spdk_pci_device *dev, uint32_t bar,
 			    void **mapped_addr, uint64_t *phys_addr, uint64_t *size);
 int spdk_pci_device_unmap_bar(struct spdk_pci_device *dev, uint32_t bar, void *addr);
 
+/**
+ * Enable MSI-X on the device and route interrupt vectors 0 through num_vectors - 1 to
+ *   eventfds.  Only supported for devices bound to vfio-pci.
+ * Return the number of vectors that were enabled, which may be less than requested,
+ *   or a negative errno on failure.
+ */
+int spdk_pci_device_enable_interrupts(struct spdk_pci_device *dev, uint32_t num_vectors);
+
+/**
+ * Disable the interrupts enabled by spdk_pci_device_enable_interrupts().
+ */
+void spdk_pci_device_disable_interrupts(struct spdk_pci_device *dev);
+
+/**
+ * Return the non-blocking eventfd signalled by the given interrupt vector, or -1 if
+ *   the vector has not been enabled.
+ */
+int spdk_pci_device_get_interrupt_fd(struct spdk_pci_device *dev, uint32_t vector);
+
+/**
+ * Mask or unmask one interrupt vector enabled by spdk_pci_device_enable_interrupts().
+ *   A masked vector no longer signals its eventfd.  Vectors start out unmasked.
+ * Return 0 on success or a negative errno on failure.
+ */
+int spdk_pci_device_mask_interrupt(struct spdk_pci_device *dev, uint32_t vector, bool mask);
+
 uint16_t spdk_pci_device_get_domain(struct spdk_pci_device *dev);
 uint8_t spdk_pci_device_get_bus(struct spdk_pci_device *dev);
 uint8_t spdk_pci_device_get_dev(struct spdk_pci_device *dev);
@@ -99,6 +99,12 @@ struct spdk_event {
 
 typedef void (*spdk_poller_fn)(void *arg);
 
+/**
+ * Called with enable set to true just before the reactor starts waiting on an interrupt
+ *  poller's file descriptor, and with enable set to false once it switches back to polling.
+ */
+typedef void (*spdk_poller_intr_fn)(void *arg, bool enable);
+
 /**
  * \brief A poller is a function that is repeatedly called on an lcore.
  */
@@ -232,6 +238,38 @@ void spdk_poller_register(struct spdk_poller **ppoller,
 			  struct spdk_event *complete,
 			  uint64_t period_microseconds);
 
+/**
+ * \brief Register a poller on the given lcore that can also be woken by an interrupt.
+ *
+ * \param intr_fd Non-blocking file descriptor (such as an eventfd) that becomes readable when
+ * the poller may have work to do.  Once every active poller on the lcore was registered this
+ * way and none of them has reported work for about a millisecond, the reactor stops polling
+ * and blocks until one of the file descriptors becomes readable, an event is sent to the lcore
+ * or a timed poller is due.  The reactor reads the file descriptor itself to clear it.
+ *
+ * The poller function must call spdk_poller_set_busy() whenever it finds work.  If interrupts
+ * are not available, the poller is simply polled like any other poller.
+ *
+ * \param intr_fn Optional function that enables the interrupt source only while the reactor
+ * waits on intr_fd, so that work found by polling does not raise interrupts too.  The reactor
+ * runs the poller once more after enabling it and before blocking.
+ */
+void spdk_poller_register_interrupt(struct spdk_poller **ppoller,
+				    spdk_poller_fn fn,
+				    void *arg,
+				    uint32_t lcore,
+				    struct spdk_event *complete,
+				    int intr_fd,
+				    spdk_poller_intr_fn intr_fn);
+
+/**
+ * \brief Report that the poller currently running on this lcore found work.
+ *
+ * Only pollers registered with spdk_poller_register_interrupt() need to call this; all other
+ * pollers are always considered busy.
+ */
+void spdk_poller_set_busy(void);
+
 /**
  * \brief Unregister a poller on the given lcore.
  */
@@ -43,7 +43,15 @@
 
 #include "spdk/queue.h"
 
+/*
+ * I/O channel priorities.  Lower values are more latency sensitive.  I/O devices that
+ *  support prioritization (for example, NVMe controllers using weighted round robin
+ *  arbitration) allocate separate resources for each priority.
+ */
+#define SPDK_IO_PRIORITY_URGENT		0
+#define SPDK_IO_PRIORITY_HIGH		50
 #define SPDK_IO_PRIORITY_DEFAULT	100
+#define SPDK_IO_PRIORITY_LOW		150
 
 struct spdk_io_channel;
 
@@ -96,7 +104,8 @@ void spdk_io_device_unregister(void *io_device);
  *  than creating a new I/O channel.
  *
  * The priority parameter allows callers to create different I/O channels to the same
- *  I/O device with varying priorities.  Currently this value must be set to
+ *  I/O device with varying priorities.  It must be between SPDK_IO_PRIORITY_URGENT and
+ *  SPDK_IO_PRIORITY_LOW; callers without special requirements should use
  *  SPDK_IO_PRIORITY_DEFAULT.
  *
  * The unique parameter allows callers to specify that an existing channel should not
@@ -108,6 +117,14 @@ void spdk_io_device_unregister(void *io_device);
 struct spdk_io_channel *spdk_get_io_channel(void *io_device, uint32_t priority, bool unique,
 		void *unique_ctx);
 
+/**
+ * \brief Converts a priority name (\"Urgent\", \"High\", \"Default\" or \"Low\") to
+ *  the matching SPDK_IO_PRIORITY value.
+ *
+ * Returns 0 on success or -1 if the name is not recognized.
+ */
+int spdk_io_priority_parse(const char *name, uint32_t *priority);
+
 /**
  * \brief Releases a reference to an I/O channel.
  *
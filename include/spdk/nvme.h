@@ -52,6 +52,9 @@ extern "C" {
 #define SPDK_NVME_DEFAULT_RETRY_COUNT	(4)
 extern int32_t		spdk_nvme_retry_count;
 
+/** Size of an NQN field, including the terminating NUL character. */
+#define SPDK_NVME_NQN_FIELD_SIZE	256
+
 
 
 /** \brief Opaque handle to a controller. Returned by \ref spdk_nvme_probe()'s attach_cb. */
@@ -77,6 +80,42 @@ struct spdk_nvme_ctrlr_opts {
 	 * Type of arbitration mechanism
 	 */
 	enum spdk_nvme_cc_ams arb_mechanism;
+	/**
+	 * Enable I/O completion queue interrupts (see spdk_nvme_qpair_get_interrupt_fd()).
+	 * Requires the device to be bound to vfio-pci.
+	 */
+	bool enable_interrupts;
+	/**
+	 * Host NQN presented to NVMe over Fabrics controllers in the Connect command.
+	 *  Ignored for PCIe controllers.
+	 */
+	char hostnqn[SPDK_NVME_NQN_FIELD_SIZE];
+};
+
+/**
+ * \brief NVMe transport type, as defined by the TRTYPE field of the NVMe over Fabrics
+ *  discovery log page entry.
+ */
+enum spdk_nvme_transport_type {
+	SPDK_NVME_TRANSPORT_PCIE	= 0,
+	SPDK_NVME_TRANSPORT_TCP		= 3,
+};
+
+#define SPDK_NVME_TRANSPORT_ID_TRADDR_MAX_LEN	256
+#define SPDK_NVME_TRANSPORT_ID_TRSVCID_MAX_LEN	32
+
+/**
+ * \brief Identifies a remote NVMe over Fabrics controller for spdk_nvme_connect().
+ */
+struct spdk_nvme_transport_id {
+	/** Transport type; only SPDK_NVME_TRANSPORT_TCP is currently supported. */
+	enum spdk_nvme_transport_type trtype;
+	/** Transport address, e.g. an IPv4 or IPv6 address or a host name. */
+	char traddr[SPDK_NVME_TRANSPORT_ID_TRADDR_MAX_LEN + 1];
+	/** Transport service identifier, e.g. the TCP port. */
+	char trsvcid[SPDK_NVME_TRANSPORT_ID_TRSVCID_MAX_LEN + 1];
+	/** NQN of the NVM subsystem to connect to. */
+	char subnqn[SPDK_NVME_NQN_FIELD_SIZE];
 };
 
 /**
@@ -119,11 +158,15 @@ typedef void (*spdk_nvme_remove_cb)(void *cb_ctx, struct spdk_nvme_ctrlr *ctrlr)
  * controller has been attached to the userspace driver.
  * \param remove_cb will be called for devices that were attached in a previous spdk_nvme_probe()
  * call but are no longer attached to the system. Optional; specify NULL if removal notices are not
- * desired.
+ * desired.  Passing a non-NULL remove_cb starts hotplug monitoring, see spdk_nvme_hotplug_poll().
  *
  * If called more than once, only devices that are not already attached to the SPDK NVMe driver
  * will be reported.
  *
+ * In a DPDK secondary process, this attaches to the controllers already initialized by the
+ * primary process instead of resetting them.  The primary process must call spdk_nvme_probe()
+ * first.  Hotplug monitoring is only performed in the primary process.
+ *
  * To stop using the the controller and release its associated resources,
  * call \ref spdk_nvme_detach with the spdk_nvme_ctrlr instance returned by this function.
  */
@@ -132,6 +175,88 @@ int spdk_nvme_probe(void *cb_ctx,
 		    spdk_nvme_attach_cb attach_cb,
 		    spdk_nvme_remove_cb remove_cb);
 
+/** \brief Opaque handle to an asynchronous probe started by spdk_nvme_probe_async(). */
+struct spdk_nvme_probe_ctx;
+
+/**
+ * \brief Start enumerating NVMe devices without waiting for them to initialize.
+ *
+ * The parameters are the same as for spdk_nvme_probe().  probe_cb is called for each device
+ * before this function returns; controller initialization is then driven by
+ * spdk_nvme_probe_poll_async(), which calls attach_cb as each controller becomes ready.
+ * All controllers found by one probe are initialized in parallel.
+ *
+ * \return probe context to pass to spdk_nvme_probe_poll_async(), or NULL on failure.
+ */
+struct spdk_nvme_probe_ctx *spdk_nvme_probe_async(void *cb_ctx,
+		spdk_nvme_probe_cb probe_cb,
+		spdk_nvme_attach_cb attach_cb,
+		spdk_nvme_remove_cb remove_cb);
+
+/**
+ * \brief Advance the initialization of the controllers found by spdk_nvme_probe_async().
+ *
+ * Each call performs at most one initialization step per controller and does not wait for
+ * controller state transitions, so it is suitable for calling from a poller.
+ *
+ * \return -EAGAIN while controllers are still initializing.  Otherwise the probe is complete,
+ * probe_ctx has been freed, and the return value is 0 on success or negative if any controller
+ * failed to attach.
+ */
+int spdk_nvme_probe_poll_async(struct spdk_nvme_probe_ctx *probe_ctx);
+
+/**
+ * \brief Process NVMe hotplug events without blocking.
+ *
+ * The first call starts monitoring kernel uevents for NVMe devices bound to uio or vfio-pci.
+ * Each call then reports controllers that have been physically removed to remove_cb, and
+ * attaches newly added devices through probe_cb and attach_cb, exactly as spdk_nvme_probe()
+ * would.  Initialization of added controllers is spread over subsequent calls, so this
+ * function is intended to be called periodically from a poller.
+ *
+ * A removed controller is marked as failed: new I/O is rejected, and outstanding I/O is
+ * completed with an error the next time its queue pair processes completions.  The user
+ * should stop using the controller and call spdk_nvme_detach() once its queue pairs are freed.
+ *
+ * \return 0 on success, negative errno if hotplug monitoring is not available.
+ */
+int spdk_nvme_hotplug_poll(void *cb_ctx,
+			   spdk_nvme_probe_cb probe_cb,
+			   spdk_nvme_attach_cb attach_cb,
+			   spdk_nvme_remove_cb remove_cb);
+
+/**
+ * \brief Parse a transport ID string into a struct spdk_nvme_transport_id.
+ *
+ * The string is a whitespace-separated list of key:value pairs, for example
+ *  "trtype:TCP traddr:192.168.0.10 trsvcid:4420 subnqn:nqn.2016-06.io.spdk:cnode1".
+ *  Keys are case-insensitive; trtype, traddr and trsvcid are required.
+ *
+ * \return 0 on success, -1 if the string could not be parsed.
+ */
+int spdk_nvme_transport_id_parse(struct spdk_nvme_transport_id *trid, const char *str);
+
+/**
+ * \brief Fill in the default controller options, e.g. before passing them to spdk_nvme_connect().
+ */
+void spdk_nvme_ctrlr_opts_set_defaults(struct spdk_nvme_ctrlr_opts *opts);
+
+/**
+ * \brief Connect to an NVMe over Fabrics controller and attach the userspace NVMe driver to it.
+ *
+ * This establishes the admin queue association with the remote controller and runs the
+ *  controller initialization sequence synchronously.  The returned controller is used with the
+ *  same spdk_nvme_ctrlr and spdk_nvme_qpair API as a PCIe controller, with these restrictions:
+ *  payloads must be contiguous buffers (no SGL callbacks or separate metadata), and
+ *  the controller can only be used by the process that connected it.
+ *
+ * \param opts Controller options, or NULL to use the defaults.
+ *
+ * \return the attached controller, or NULL on failure.  Call spdk_nvme_detach() to disconnect.
+ */
+struct spdk_nvme_ctrlr *spdk_nvme_connect(const struct spdk_nvme_transport_id *trid,
+		const struct spdk_nvme_ctrlr_opts *opts);
+
 /**
  * \brief Detaches specified device returned by \ref spdk_nvme_probe()'s attach_cb from the NVMe driver.
  *
@@ -155,6 +280,15 @@ int spdk_nvme_detach(struct spdk_nvme_ctrlr *ctrlr);
  */
 int spdk_nvme_ctrlr_reset(struct spdk_nvme_ctrlr *ctrlr);
 
+/**
+ * \brief Check whether the NVMe controller has failed.
+ *
+ * A controller fails when it cannot be reinitialized after a reset or when it is removed.
+ *  Commands submitted to a failed controller are rejected with -ENXIO, and outstanding
+ *  commands are completed with an aborted status.
+ */
+bool spdk_nvme_ctrlr_is_failed(struct spdk_nvme_ctrlr *ctrlr);
+
 /**
  * \brief Get the identify controller data as defined by the NVMe specification.
  *
@@ -174,6 +308,11 @@ union spdk_nvme_cap_register spdk_nvme_ctrlr_get_regs_cap(struct spdk_nvme_ctrlr
  */
 union spdk_nvme_vs_register spdk_nvme_ctrlr_get_regs_vs(struct spdk_nvme_ctrlr *ctrlr);
 
+/**
+ * \brief Get the NVMe controller CMBSZ (Controller Memory Buffer Size) register.
+ */
+union spdk_nvme_cmbsz_register spdk_nvme_ctrlr_get_regs_cmbsz(struct spdk_nvme_ctrlr *ctrlr);
+
 /**
  * \brief Get the number of namespaces for the given NVMe controller.
  *
@@ -236,6 +375,41 @@ void spdk_nvme_ctrlr_register_aer_callback(struct spdk_nvme_ctrlr *ctrlr,
  */
 struct spdk_nvme_qpair;
 
+/**
+ * Signature for the callback function invoked when a command has been outstanding
+ *  for longer than the timeout registered with spdk_nvme_ctrlr_register_timeout_callback().
+ *
+ * \param cb_arg Context specified by spdk_nvme_ctrlr_register_timeout_callback().
+ * \param ctrlr Controller the timed out command was submitted to.
+ * \param qpair I/O queue pair the command was submitted to, or NULL for an admin command.
+ * \param cid Command ID of the timed out command, suitable for spdk_nvme_ctrlr_cmd_abort().
+ *
+ * The callback is invoked at most once per command, from the thread that processes
+ *  completions for the queue pair.  It may abort the command with spdk_nvme_ctrlr_cmd_abort(),
+ *  reset the controller with spdk_nvme_ctrlr_reset(), or simply log the event.
+ */
+typedef void (*spdk_nvme_timeout_cb)(void *cb_arg,
+				     struct spdk_nvme_ctrlr *ctrlr,
+				     struct spdk_nvme_qpair *qpair,
+				     uint16_t cid);
+
+/**
+ * \brief Register for timeout callbacks on commands submitted to a controller.
+ *
+ * \param ctrlr NVMe controller to monitor.
+ * \param timeout_sec Timeout in seconds.  Values outside the range supported by the driver
+ * are clamped.  Pass 0 to disable timeout detection.
+ * \param cb_fn Function to call when a command times out, or NULL to disable timeout detection.
+ * \param cb_arg Context passed to cb_fn.
+ *
+ * Submission timestamps are only recorded while a callback is registered, so commands
+ *  submitted before registration are never reported as timed out.  Expired commands are
+ *  detected while completions are processed, so the queue pair (or the admin queue) must
+ *  continue to be polled for timeouts to be reported.
+ */
+void spdk_nvme_ctrlr_register_timeout_callback(struct spdk_nvme_ctrlr *ctrlr,
+		uint32_t timeout_sec, spdk_nvme_timeout_cb cb_fn, void *cb_arg);
+
 /**
  * \brief Allocate an I/O queue pair (submission and completion queue).
  *
@@ -249,11 +423,123 @@ struct spdk_nvme_qpair;
 struct spdk_nvme_qpair *spdk_nvme_ctrlr_alloc_io_qpair(struct spdk_nvme_ctrlr *ctrlr,
 		enum spdk_nvme_qprio qprio);
 
+/**
+ * \brief NVMe I/O queue pair initialization options.
+ *
+ * Use spdk_nvme_ctrlr_get_default_io_qpair_opts() to fill in the defaults before changing
+ * individual options.
+ */
+struct spdk_nvme_io_qpair_opts {
+	/**
+	 * Queue priority for weighted round robin arbitration.  If a different arbitration
+	 * method is in use, use 0.
+	 */
+	enum spdk_nvme_qprio qprio;
+
+	/**
+	 * Number of entries in the submission and completion queues.  Limited by the
+	 * maximum queue size reported by the controller.
+	 */
+	uint32_t io_queue_size;
+
+	/**
+	 * Maximum number of commands outstanding on the queue pair.  Further requests are
+	 * queued in software.  Limited to io_queue_size - 1.
+	 */
+	uint32_t io_queue_requests;
+
+	/**
+	 * Average completion latency target in microseconds for the adaptive queue depth
+	 * limiter, or 0 to disable it.  The limiter lowers the number of outstanding commands
+	 * while completions take longer than the target, and raises it again while they are
+	 * faster and the queue pair is using its full depth.
+	 */
+	uint32_t latency_target_us;
+};
+
+/**
+ * \brief Get the default options for I/O queue pairs of a controller.
+ */
+void spdk_nvme_ctrlr_get_default_io_qpair_opts(struct spdk_nvme_ctrlr *ctrlr,
+		struct spdk_nvme_io_qpair_opts *opts);
+
+/**
+ * \brief Allocate an I/O queue pair with the given options.
+ *
+ * Queue sizes outside the range supported by the controller are clamped.  See
+ * spdk_nvme_ctrlr_alloc_io_qpair().
+ */
+struct spdk_nvme_qpair *spdk_nvme_ctrlr_alloc_io_qpair_with_opts(struct spdk_nvme_ctrlr *ctrlr,
+		const struct spdk_nvme_io_qpair_opts *opts);
+
+/**
+ * \brief Queue depth statistics of an I/O queue pair.
+ */
+struct spdk_nvme_qpair_stats {
+	/** Number of commands that may currently be outstanding */
+	uint32_t depth_limit;
+
+	/** Number of commands that may be outstanding without the limiter (io_queue_requests) */
+	uint32_t max_depth;
+
+	/** Number of times the adaptive limiter raised depth_limit */
+	uint64_t depth_increases;
+
+	/** Number of times the adaptive limiter lowered depth_limit */
+	uint64_t depth_decreases;
+
+	/** Number of requests queued in software because depth_limit commands were outstanding */
+	uint64_t throttled_requests;
+
+	/** Average completion latency in microseconds over the limiter's last sampling window */
+	uint64_t avg_latency_us;
+};
+
+/**
+ * \brief Get the queue depth statistics of an I/O queue pair.
+ *
+ * Like other queue pair functions, this must be called from the thread using the queue pair.
+ * The statistics are reset when the queue pair is allocated.
+ */
+void spdk_nvme_qpair_get_stats(struct spdk_nvme_qpair *qpair,
+			       struct spdk_nvme_qpair_stats *stats);
+
 /**
  * \brief Free an I/O queue pair that was allocated by spdk_nvme_ctrlr_alloc_io_qpair().
  */
 int spdk_nvme_ctrlr_free_io_qpair(struct spdk_nvme_qpair *qpair);
 
+/**
+ * \brief Allocate an I/O data buffer from the controller memory buffer (CMB).
+ *
+ * \param ctrlr Controller to allocate the buffer from.
+ * \param size Size of the buffer in bytes.
+ *
+ * \return Page aligned buffer of at least \a size bytes, or NULL if the controller's CMB does
+ * not support both read and write data or has no space left.
+ *
+ * The buffer may be used as the payload of I/O commands submitted to this controller, letting
+ * the controller transfer data without a round trip through host memory.  It is device memory:
+ * CPU access is uncached and slow, so it is best suited to data moved by DMA.
+ *
+ * This function is thread safe.
+ */
+void *spdk_nvme_ctrlr_alloc_cmb_io_buffer(struct spdk_nvme_ctrlr *ctrlr, size_t size);
+
+/**
+ * \brief Free a buffer allocated by spdk_nvme_ctrlr_alloc_cmb_io_buffer().
+ *
+ * \param ctrlr Controller the buffer was allocated from.
+ * \param buf Buffer to free.
+ * \param size Size passed to spdk_nvme_ctrlr_alloc_cmb_io_buffer().
+ *
+ * Freed buffers are reused by later allocations of the same size.  CMB space is not returned
+ * to the controller until it is detached.
+ *
+ * This function is thread safe.
+ */
+void spdk_nvme_ctrlr_free_cmb_io_buffer(struct spdk_nvme_ctrlr *ctrlr, void *buf, size_t size);
+
 /**
  * \brief Send the given NVM I/O command to the NVMe controller.
  *
@@ -273,6 +559,31 @@ int spdk_nvme_ctrlr_cmd_io_raw(struct spdk_nvme_ctrlr *ctrlr,
 			       void *buf, uint32_t len,
 			       spdk_nvme_cmd_cb cb_fn, void *cb_arg);
 
+/**
+ * \brief Get the eventfd that is signalled when the controller posts a completion to a queue pair.
+ *
+ * \return A non-blocking file descriptor, or -1 if the controller was not attached with
+ * enable_interrupts set or no interrupt vector was available for this queue pair.
+ *
+ * The NVMe driver never reads the file descriptor; the caller drains it before waiting on it
+ *  and processes completions with spdk_nvme_qpair_process_completions() once it is readable.
+ *  The interrupt starts out masked; unmask it with spdk_nvme_qpair_mask_interrupt() only
+ *  while waiting on the file descriptor, so completions found by polling do not raise
+ *  interrupts as well.
+ */
+int spdk_nvme_qpair_get_interrupt_fd(struct spdk_nvme_qpair *qpair);
+
+/**
+ * \brief Mask or unmask the completion interrupt of a queue pair.
+ *
+ * \return 0 on success, or a negative errno if the queue pair has no interrupt
+ * (see spdk_nvme_qpair_get_interrupt_fd()) or it could not be changed.
+ *
+ * Completions posted while the interrupt is masked do not signal the file descriptor, so
+ *  check for completions once more after unmasking and before waiting.
+ */
+int spdk_nvme_qpair_mask_interrupt(struct spdk_nvme_qpair *qpair, bool mask);
+
 /**
  * \brief Process any outstanding completions for I/O submitted on a queue pair.
  *
@@ -336,6 +647,33 @@ int spdk_nvme_ctrlr_cmd_admin_raw(struct spdk_nvme_ctrlr *ctrlr,
  */
 int32_t spdk_nvme_ctrlr_process_admin_completions(struct spdk_nvme_ctrlr *ctrlr);
 
+/**
+ * \brief Abort a specific previously-submitted NVMe command.
+ *
+ * \param ctrlr NVMe controller to which the command was submitted.
+ * \param qpair NVMe queue pair to which the command was submitted.
+ *  For admin commands, pass NULL for the qpair.
+ * \param cid Command ID of the command to abort, as reported to spdk_nvme_timeout_cb.
+ * \param cb_fn Callback function to invoke when the abort has completed.
+ * \param cb_arg Argument to pass to the callback function.
+ *
+ * \return 0 if successfully submitted, ENOMEM if resources could not be allocated for this request
+ *
+ * The abort command is submitted on the admin queue; the aborted command itself still
+ *  completes (with an aborted status if the abort succeeded) through its own queue pair.
+ *
+ * This function is thread safe and can be called at any point while the controller is attached to
+ *  the SPDK NVMe driver.
+ *
+ * Call \ref spdk_nvme_ctrlr_process_admin_completions() to poll for completion
+ * of commands submitted through this function.
+ */
+int spdk_nvme_ctrlr_cmd_abort(struct spdk_nvme_ctrlr *ctrlr,
+			      struct spdk_nvme_qpair *qpair,
+			      uint16_t cid,
+			      spdk_nvme_cmd_cb cb_fn,
+			      void *cb_arg);
+
 
 /** \brief Opaque handle to a namespace. Obtained by calling spdk_nvme_ctrlr_get_ns(). */
 struct spdk_nvme_ns;
@@ -524,6 +862,144 @@ int spdk_nvme_ctrlr_format(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
 int spdk_nvme_ctrlr_update_firmware(struct spdk_nvme_ctrlr *ctrlr, void *payload, uint32_t size,
 				    int slot);
 
+/**
+ * \brief Attach the specified namespace to controllers without waiting for the command to complete.
+ *
+ * \param ctrlr NVMe controller to use for command submission.
+ * \param nsid Namespace identifier for namespace to attach.
+ * \param payload The pointer to the controller list.  It is copied before this function returns.
+ * \param cb_fn Callback function invoked when the command completes.
+ * \param cb_arg Argument passed to the callback function.
+ *
+ * \return 0 if successfully submitted, -ENOMEM if resources could not be allocated for this request
+ *
+ * Unlike spdk_nvme_ctrlr_attach_ns(), the controller is not reset when the command completes, so
+ *  the namespace becomes visible through this controller only after spdk_nvme_ctrlr_reset().
+ *
+ * This function is thread safe and can be called at any point after spdk_nvme_attach().
+ *
+ * Call \ref spdk_nvme_ctrlr_process_admin_completions() to poll for completion
+ * of commands submitted through this function.
+ */
+int spdk_nvme_ctrlr_attach_ns_async(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+				    struct spdk_nvme_ctrlr_list *payload,
+				    spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+
+/**
+ * \brief Detach the specified namespace from controllers without waiting for the command to
+ * complete.
+ *
+ * \param ctrlr NVMe controller to use for command submission.
+ * \param nsid Namespace ID to detach.
+ * \param payload The pointer to the controller list.  It is copied before this function returns.
+ * \param cb_fn Callback function invoked when the command completes.
+ * \param cb_arg Argument passed to the callback function.
+ *
+ * \return 0 if successfully submitted, -ENOMEM if resources could not be allocated for this request
+ *
+ * Unlike spdk_nvme_ctrlr_detach_ns(), the controller is not reset when the command completes.
+ *
+ * This function is thread safe and can be called at any point after spdk_nvme_attach().
+ *
+ * Call \ref spdk_nvme_ctrlr_process_admin_completions() to poll for completion
+ * of commands submitted through this function.
+ */
+int spdk_nvme_ctrlr_detach_ns_async(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+				    struct spdk_nvme_ctrlr_list *payload,
+				    spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+
+/**
+ * \brief Create a namespace without waiting for the command to complete.
+ *
+ * \param ctrlr NVMe controller to create namespace on.
+ * \param payload The pointer to the NVMe namespace data.  It is copied before this function returns.
+ * \param cb_fn Callback function invoked when the command completes.  Dword 0 of the completion
+ * holds the ID of the new namespace.
+ * \param cb_arg Argument passed to the callback function.
+ *
+ * \return 0 if successfully submitted, -ENOMEM if resources could not be allocated for this request
+ *
+ * Unlike spdk_nvme_ctrlr_create_ns(), the controller is not reset when the command completes.
+ *
+ * This function is thread safe and can be called at any point after spdk_nvme_attach().
+ *
+ * Call \ref spdk_nvme_ctrlr_process_admin_completions() to poll for completion
+ * of commands submitted through this function.
+ */
+int spdk_nvme_ctrlr_create_ns_async(struct spdk_nvme_ctrlr *ctrlr,
+				    struct spdk_nvme_ns_data *payload,
+				    spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+
+/**
+ * \brief Delete a namespace without waiting for the command to complete.
+ *
+ * \param ctrlr NVMe controller to delete namespace from.
+ * \param nsid The namespace identifier.
+ * \param cb_fn Callback function invoked when the command completes.
+ * \param cb_arg Argument passed to the callback function.
+ *
+ * \return 0 if successfully submitted, -ENOMEM if resources could not be allocated for this request
+ *
+ * Unlike spdk_nvme_ctrlr_delete_ns(), the controller is not reset when the command completes.
+ *
+ * This function is thread safe and can be called at any point after spdk_nvme_attach().
+ *
+ * Call \ref spdk_nvme_ctrlr_process_admin_completions() to poll for completion
+ * of commands submitted through this function.
+ */
+int spdk_nvme_ctrlr_delete_ns_async(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+				    spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+
+/**
+ * \brief Format NVM without waiting for the command to complete.
+ *
+ * \param ctrlr NVMe controller to format.
+ * \param nsid The namespace identifier.  May be SPDK_NVME_GLOBAL_NS_TAG to format all namespaces.
+ * \param format The format information for the command.
+ * \param cb_fn Callback function invoked when the command completes.
+ * \param cb_arg Argument passed to the callback function.
+ *
+ * \return 0 if successfully submitted, -ENOMEM if resources could not be allocated for this request
+ *
+ * Unlike spdk_nvme_ctrlr_format(), the controller is not reset when the command completes.
+ *
+ * This function is thread safe and can be called at any point after spdk_nvme_attach().
+ *
+ * Call \ref spdk_nvme_ctrlr_process_admin_completions() to poll for completion
+ * of commands submitted through this function.
+ */
+int spdk_nvme_ctrlr_format_async(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+				 struct spdk_nvme_format *format,
+				 spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+
+/**
+ * \brief Download a new firmware image and commit it to a slot without waiting for the commands
+ * to complete.
+ *
+ * \param payload The data buffer for the firmware image.  It must remain valid until the callback
+ * is invoked.
+ * \param size The data size will be downloaded.
+ * \param slot The slot that the firmware image will be committed to.
+ * \param cb_fn Callback function invoked with the completion of the commit command, or of the
+ * first download command that failed.
+ * \param cb_arg Argument passed to the callback function.
+ *
+ * \return 0 if successfully submitted, -ENOMEM if resources could not be allocated for this request,
+ * -EINVAL if the size is not multiple of 4.
+ *
+ * The image is downloaded in pieces of the controller's minimum page size, each submitted when
+ *  the previous one completes.  Unlike spdk_nvme_ctrlr_update_firmware(), the controller is not
+ *  reset afterwards, so the new image is activated by the next spdk_nvme_ctrlr_reset().
+ *
+ * This function is thread safe and can be called at any point after spdk_nvme_attach().
+ *
+ * Call \ref spdk_nvme_ctrlr_process_admin_completions() to poll for completion
+ * of commands submitted through this function.
+ */
+int spdk_nvme_ctrlr_update_firmware_async(struct spdk_nvme_ctrlr *ctrlr, void *payload,
+		uint32_t size, int slot,
+		spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+
 /**
  * \brief Get the identify namespace data as defined by the NVMe specification.
  *
@@ -615,6 +1091,11 @@ enum spdk_nvme_ns_flags {
 	SPDK_NVME_NS_EXTENDED_LBA_SUPPORTED	= 0x20, /**< The extended lba format is supported,
 							      metadata is transferred as a contiguous
 							      part of the logical block that it is associated with */
+	SPDK_NVME_NS_COMPARE_SUPPORTED		= 0x40, /**< The compare command is supported */
+	SPDK_NVME_NS_COMPARE_AND_WRITE_SUPPORTED	= 0x80, /**< The fused compare and write operation
+							      is supported */
+	SPDK_NVME_NS_STREAMS_SUPPORTED		= 0x100, /**< The streams directive is enabled and
+							       write streams may be used */
 };
 
 /**
@@ -627,6 +1108,17 @@ enum spdk_nvme_ns_flags {
  */
 uint32_t spdk_nvme_ns_get_flags(struct spdk_nvme_ns *ns);
 
+/**
+ * \brief Get the number of write streams that may be used with the given namespace.
+ *
+ * Stream identifiers passed to spdk_nvme_ns_cmd_write_with_hints() must be in the range
+ *  1 to the returned value.  0 is returned if the streams directive is not enabled.
+ *
+ * This function is thread safe and can be called at any point while the controller is attached to
+ *  the SPDK NVMe driver.
+ */
+uint16_t spdk_nvme_ns_get_max_write_streams(struct spdk_nvme_ns *ns);
+
 /**
  * Restart the SGL walk to the specified offset when the command has scattered payloads.
  *
@@ -722,6 +1214,68 @@ int spdk_nvme_ns_cmd_write_with_md(struct spdk_nvme_ns *ns, struct spdk_nvme_qpa
 				   void *cb_arg, uint32_t io_flags,
 				   uint16_t apptag_mask, uint16_t apptag);
 
+/**
+ * \brief Submits a write I/O with dataset management hints to the specified NVMe namespace.
+ *
+ * \param ns NVMe namespace to submit the write I/O
+ * \param qpair I/O queue pair to submit the request
+ * \param payload virtual address pointer to the data payload
+ * \param lba starting LBA to write the data
+ * \param lba_count length (in sectors) for the write operation
+ * \param cb_fn callback function to invoke when the I/O is completed
+ * \param cb_arg argument to pass to the callback function
+ * \param io_flags set flags, defined by the SPDK_NVME_IO_FLAGS_* entries
+ * 			in spdk/nvme_spec.h, for this I/O.
+ * \param dsm dataset management attributes, defined by the SPDK_NVME_IO_DSM_* entries
+ *	      in spdk/nvme_spec.h, or 0 for no hint.
+ * \param stream_id write stream the data belongs to, or 0 to not use a stream.
+ *
+ * \return 0 if successfully submitted, ENOMEM if an nvme_request
+ *	     structure cannot be allocated for the I/O request, EINVAL if stream_id
+ *	     exceeds spdk_nvme_ns_get_max_write_streams()
+ *
+ * The hints are advisory; controllers that do not implement them ignore them.
+ *
+ * The command is submitted to a qpair allocated by spdk_nvme_ctrlr_alloc_io_qpair().
+ * The user must ensure that only one thread submits I/O on a given qpair at any given time.
+ */
+int spdk_nvme_ns_cmd_write_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				      void *payload, uint64_t lba, uint32_t lba_count,
+				      spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				      uint8_t dsm, uint16_t stream_id);
+
+/**
+ * \brief Submits a scattered write I/O with dataset management hints to the specified
+ *        NVMe namespace.
+ *
+ * \param ns NVMe namespace to submit the write I/O
+ * \param qpair I/O queue pair to submit the request
+ * \param lba starting LBA to write the data
+ * \param lba_count length (in sectors) for the write operation
+ * \param cb_fn callback function to invoke when the I/O is completed
+ * \param cb_arg argument to pass to the callback function
+ * \param io_flags set flags, defined in nvme_spec.h, for this I/O
+ * \param reset_sgl_fn callback function to reset scattered payload
+ * \param next_sge_fn callback function to iterate each scattered
+ * payload memory segment
+ * \param dsm dataset management attributes, defined by the SPDK_NVME_IO_DSM_* entries
+ *	      in spdk/nvme_spec.h, or 0 for no hint.
+ * \param stream_id write stream the data belongs to, or 0 to not use a stream.
+ *
+ * \return 0 if successfully submitted, ENOMEM if an nvme_request
+ *	     structure cannot be allocated for the I/O request, EINVAL if stream_id
+ *	     exceeds spdk_nvme_ns_get_max_write_streams()
+ *
+ * The command is submitted to a qpair allocated by spdk_nvme_ctrlr_alloc_io_qpair().
+ * The user must ensure that only one thread submits I/O on a given qpair at any given time.
+ */
+int spdk_nvme_ns_cmd_writev_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				       uint64_t lba, uint32_t lba_count,
+				       spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				       spdk_nvme_req_reset_sgl_cb reset_sgl_fn,
+				       spdk_nvme_req_next_sge_cb next_sge_fn,
+				       uint8_t dsm, uint16_t stream_id);
+
 /**
  * \brief Submits a write zeroes I/O to the specified NVMe namespace.
  *
@@ -745,6 +1299,67 @@ int spdk_nvme_ns_cmd_write_zeroes(struct spdk_nvme_ns *ns, struct spdk_nvme_qpai
 				  spdk_nvme_cmd_cb cb_fn, void *cb_arg,
 				  uint32_t io_flags);
 
+/**
+ * \brief Submits a compare I/O to the specified NVMe namespace.
+ *
+ * \param ns NVMe namespace to submit the compare I/O
+ * \param qpair I/O queue pair to submit the request
+ * \param payload virtual address pointer to the data to compare against
+ * \param lba starting LBA to compare the data
+ * \param lba_count length (in sectors) for the compare operation
+ * \param cb_fn callback function to invoke when the I/O is completed
+ * \param cb_arg argument to pass to the callback function
+ * \param io_flags set flags, defined in nvme_spec.h, for this I/O
+ *
+ * \return 0 if successfully submitted, ENOMEM if an nvme_request
+ *	     structure cannot be allocated for the I/O request
+ *
+ * The command completes with SPDK_NVME_SC_COMPARE_FAILURE if the data on the media
+ *  differs from the payload.  It is only valid when spdk_nvme_ns_get_flags() reports
+ *  SPDK_NVME_NS_COMPARE_SUPPORTED.
+ *
+ * The command is submitted to a qpair allocated by spdk_nvme_ctrlr_alloc_io_qpair().
+ * The user must ensure that only one thread submits I/O on a given qpair at any given time.
+ */
+int spdk_nvme_ns_cmd_compare(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair, void *payload,
+			     uint64_t lba, uint32_t lba_count, spdk_nvme_cmd_cb cb_fn,
+			     void *cb_arg, uint32_t io_flags);
+
+/**
+ * \brief Submits a compare and write operation to the specified NVMe namespace.
+ *
+ * \param ns NVMe namespace to submit the operation
+ * \param qpair I/O queue pair to submit the request
+ * \param compare_payload virtual address pointer to the data expected on the media
+ * \param write_payload virtual address pointer to the data to write if the compare succeeds
+ * \param lba starting LBA of the operation
+ * \param lba_count length (in sectors) of the operation
+ * \param cb_fn callback function to invoke when the operation is completed
+ * \param cb_arg argument to pass to the callback function
+ * \param io_flags set flags, defined in nvme_spec.h, for this I/O
+ *
+ * \return 0 if successfully submitted, ENOMEM if an nvme_request
+ *	     structure cannot be allocated for the I/O request, EINVAL if lba_count
+ *	     exceeds the atomic compare and write unit of the controller
+ *
+ * The callback is invoked once for the whole operation.  If the data on the media
+ *  differs from compare_payload, nothing is written and the operation completes with
+ *  SPDK_NVME_SC_COMPARE_FAILURE.
+ *
+ * When spdk_nvme_ns_get_flags() reports SPDK_NVME_NS_COMPARE_AND_WRITE_SUPPORTED, a
+ *  fused Compare and Write is submitted and the controller performs the operation
+ *  atomically.  Otherwise the driver emulates it by comparing (or reading) the blocks
+ *  and then writing them, which is not atomic with respect to other writers; the
+ *  caller must serialize access to the blocks in that case.
+ *
+ * The command is submitted to a qpair allocated by spdk_nvme_ctrlr_alloc_io_qpair().
+ * The user must ensure that only one thread submits I/O on a given qpair at any given time.
+ */
+int spdk_nvme_ns_cmd_compare_and_write(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				       void *compare_payload, void *write_payload,
+				       uint64_t lba, uint32_t lba_count,
+				       spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags);
+
 /**
  * \brief Submits a read I/O to the specified NVMe namespace.
  *
@@ -821,6 +1436,60 @@ int spdk_nvme_ns_cmd_read_with_md(struct spdk_nvme_ns *ns, struct spdk_nvme_qpai
 				  void *cb_arg, uint32_t io_flags,
 				  uint16_t apptag_mask, uint16_t apptag);
 
+/**
+ * \brief Submits a read I/O with dataset management hints to the specified NVMe namespace.
+ *
+ * \param ns NVMe namespace to submit the read I/O
+ * \param qpair I/O queue pair to submit the request
+ * \param payload virtual address pointer to the data payload
+ * \param lba starting LBA to read the data
+ * \param lba_count length (in sectors) for the read operation
+ * \param cb_fn callback function to invoke when the I/O is completed
+ * \param cb_arg argument to pass to the callback function
+ * \param io_flags set flags, defined in nvme_spec.h, for this I/O
+ * \param dsm dataset management attributes, defined by the SPDK_NVME_IO_DSM_* entries
+ *	      in spdk/nvme_spec.h, or 0 for no hint.
+ *
+ * \return 0 if successfully submitted, ENOMEM if an nvme_request
+ *	     structure cannot be allocated for the I/O request
+ *
+ * The command is submitted to a qpair allocated by spdk_nvme_ctrlr_alloc_io_qpair().
+ * The user must ensure that only one thread submits I/O on a given qpair at any given time.
+ */
+int spdk_nvme_ns_cmd_read_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				     void *payload, uint64_t lba, uint32_t lba_count,
+				     spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				     uint8_t dsm);
+
+/**
+ * \brief Submits a scattered read I/O with dataset management hints to the specified
+ *        NVMe namespace.
+ *
+ * \param ns NVMe namespace to submit the read I/O
+ * \param qpair I/O queue pair to submit the request
+ * \param lba starting LBA to read the data
+ * \param lba_count length (in sectors) for the read operation
+ * \param cb_fn callback function to invoke when the I/O is completed
+ * \param cb_arg argument to pass to the callback function
+ * \param io_flags set flags, defined in nvme_spec.h, for this I/O
+ * \param reset_sgl_fn callback function to reset scattered payload
+ * \param next_sge_fn callback function to iterate each scattered
+ * payload memory segment
+ * \param dsm dataset management attributes, defined by the SPDK_NVME_IO_DSM_* entries
+ *	      in spdk/nvme_spec.h, or 0 for no hint.
+ *
+ * \return 0 if successfully submitted, ENOMEM if an nvme_request
+ *	     structure cannot be allocated for the I/O request
+ *
+ * The command is submitted to a qpair allocated by spdk_nvme_ctrlr_alloc_io_qpair().
+ * The user must ensure that only one thread submits I/O on a given qpair at any given time.
+ */
+int spdk_nvme_ns_cmd_readv_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				      uint64_t lba, uint32_t lba_count,
+				      spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				      spdk_nvme_req_reset_sgl_cb reset_sgl_fn,
+				      spdk_nvme_req_next_sge_cb next_sge_fn, uint8_t dsm);
+
 /**
  * \brief Submits a data set management request to the specified NVMe namespace. Data set
  *        management operations are designed to optimize interaction with the block
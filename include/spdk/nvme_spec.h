@@ -298,13 +298,15 @@ enum spdk_nvme_sgl_descriptor_type {
 	SPDK_NVME_SGL_TYPE_SEGMENT		= 0x2,
 	SPDK_NVME_SGL_TYPE_LAST_SEGMENT		= 0x3,
 	SPDK_NVME_SGL_TYPE_KEYED_DATA_BLOCK	= 0x4,
-	/* 0x5 - 0xE reserved */
+	SPDK_NVME_SGL_TYPE_TRANSPORT_DATA_BLOCK	= 0x5,
+	/* 0x6 - 0xE reserved */
 	SPDK_NVME_SGL_TYPE_VENDOR_SPECIFIC	= 0xF
 };
 
 enum spdk_nvme_sgl_descriptor_subtype {
 	SPDK_NVME_SGL_SUBTYPE_ADDRESS		= 0x0,
 	SPDK_NVME_SGL_SUBTYPE_OFFSET		= 0x1,
+	SPDK_NVME_SGL_SUBTYPE_TRANSPORT		= 0xA,
 };
 
 struct __attribute__((packed)) spdk_nvme_sgl_descriptor {
@@ -374,6 +376,15 @@ enum spdk_nvme_cc_ams {
 	SPDK_NVME_CC_AMS_VS		= 0x7,	/**< vendor specific */
 };
 
+/**
+ * Fused operation (FUSE) field of a command.
+ */
+enum spdk_nvme_cmd_fuse {
+	SPDK_NVME_CMD_FUSE_NONE		= 0x0,	/**< normal operation */
+	SPDK_NVME_CMD_FUSE_FIRST	= 0x1,	/**< first command of a fused operation */
+	SPDK_NVME_CMD_FUSE_SECOND	= 0x2,	/**< second command of a fused operation */
+};
+
 struct spdk_nvme_cmd {
 	/* dword 0 */
 	uint16_t opc	:  8;	/* opcode */
@@ -595,6 +606,8 @@ enum spdk_nvme_admin_opcode {
 	SPDK_NVME_OPC_NS_ATTACHMENT			= 0x15,
 
 	SPDK_NVME_OPC_KEEP_ALIVE			= 0x18,
+	SPDK_NVME_OPC_DIRECTIVE_SEND			= 0x19,
+	SPDK_NVME_OPC_DIRECTIVE_RECEIVE			= 0x1a,
 
 	SPDK_NVME_OPC_FORMAT_NVM			= 0x80,
 	SPDK_NVME_OPC_SECURITY_SEND			= 0x81,
@@ -826,7 +839,13 @@ struct __attribute__((packed)) spdk_nvme_ctrlr_data {
 		/* supports ns manage/ns attach commands */
 		uint16_t	ns_manage  : 1;
 
-		uint16_t	oacs_rsvd : 12;
+		/* supports device self-test command */
+		uint16_t	device_self_test : 1;
+
+		/* supports directive send/receive commands */
+		uint16_t	directives : 1;
+
+		uint16_t	oacs_rsvd : 10;
 	} oacs;
 
 	/** abort command limit */
@@ -951,7 +970,7 @@ struct __attribute__((packed)) spdk_nvme_ctrlr_data {
 		uint16_t	reserved: 10;
 	} oncs;
 
-	/** fused operation support */
+	/** fused operation support (bit 0: compare and write) */
 	uint16_t		fuses;
 
 	/** format nvm attributes */
@@ -1562,6 +1581,81 @@ SPDK_STATIC_ASSERT(sizeof(struct spdk_nvme_fw_commit) == 4, "Incorrect size");
 #define SPDK_NVME_IO_FLAGS_FORCE_UNIT_ACCESS (1U << 30)
 #define SPDK_NVME_IO_FLAGS_LIMITED_RETRY (1U << 31)
 
+/**
+ * Dataset management hints in CDW13 bits 7:0 of read and write commands.
+ */
+enum spdk_nvme_dsm_access_freq {
+	SPDK_NVME_DSM_ACCESS_FREQ_NONE			= 0x0,	/**< no information provided */
+	SPDK_NVME_DSM_ACCESS_FREQ_TYPICAL		= 0x1,	/**< typical reads and writes */
+	SPDK_NVME_DSM_ACCESS_FREQ_INFREQ_WRITE_INFREQ_READ	= 0x2,
+	SPDK_NVME_DSM_ACCESS_FREQ_INFREQ_WRITE_FREQ_READ	= 0x3,
+	SPDK_NVME_DSM_ACCESS_FREQ_FREQ_WRITE_INFREQ_READ	= 0x4,
+	SPDK_NVME_DSM_ACCESS_FREQ_FREQ_WRITE_FREQ_READ		= 0x5,
+	SPDK_NVME_DSM_ACCESS_FREQ_ONE_TIME_READ		= 0x6,	/**< e.g. a backup or scan */
+	SPDK_NVME_DSM_ACCESS_FREQ_SPECULATIVE_READ	= 0x7,	/**< e.g. read ahead */
+	SPDK_NVME_DSM_ACCESS_FREQ_OVERWRITTEN_SOON	= 0x8,	/**< the data will be overwritten soon */
+};
+#define SPDK_NVME_IO_DSM_ACCESS_FREQ_MASK	0xFU
+/** The command is part of a sequential read or write of multiple commands */
+#define SPDK_NVME_IO_DSM_SEQUENTIAL_REQUEST	(1U << 6)
+/** The data is not compressible */
+#define SPDK_NVME_IO_DSM_INCOMPRESSIBLE		(1U << 7)
+
+/**
+ * Directive types
+ */
+enum spdk_nvme_directive_type {
+	SPDK_NVME_DIRECTIVE_TYPE_IDENTIFY		= 0x0,
+	SPDK_NVME_DIRECTIVE_TYPE_STREAMS		= 0x1,
+};
+
+/**
+ * Directive operations of the Identify directive
+ */
+enum spdk_nvme_identify_directive_oper {
+	/** Directive Receive: return the supported and enabled directives */
+	SPDK_NVME_IDENTIFY_DIRECTIVE_RECEIVE_RETURN_PARAM	= 0x1,
+	/** Directive Send: enable or disable a directive */
+	SPDK_NVME_IDENTIFY_DIRECTIVE_SEND_ENABLE		= 0x1,
+};
+
+/**
+ * Directive operations of the Streams directive
+ */
+enum spdk_nvme_streams_directive_oper {
+	SPDK_NVME_STREAMS_DIRECTIVE_RECEIVE_RETURN_PARAM	= 0x1,
+	SPDK_NVME_STREAMS_DIRECTIVE_RECEIVE_GET_STATUS		= 0x2,
+	SPDK_NVME_STREAMS_DIRECTIVE_RECEIVE_ALLOCATE_RESOURCES	= 0x3,
+	SPDK_NVME_STREAMS_DIRECTIVE_SEND_RELEASE_ID		= 0x1,
+	SPDK_NVME_STREAMS_DIRECTIVE_SEND_RELEASE_RESOURCES	= 0x2,
+};
+
+/**
+ * Streams directive Return Parameters data structure
+ */
+struct spdk_nvme_streams_params {
+	/** max streams limit */
+	uint16_t	msl;
+	/** NVM subsystem streams available */
+	uint16_t	nssa;
+	/** NVM subsystem streams open */
+	uint16_t	nsso;
+	uint8_t		reserved6[10];
+	/** stream write size, in logical blocks */
+	uint32_t	sws;
+	/** stream granularity size, in units of sws */
+	uint16_t	sgs;
+	/** namespace streams allocated */
+	uint16_t	nsa;
+	/** namespace streams open */
+	uint16_t	nso;
+	uint8_t		reserved26[6];
+};
+SPDK_STATIC_ASSERT(sizeof(struct spdk_nvme_streams_params) == 32, "Incorrect size");
+
+/** Directive type (DTYPE) field of read and write commands, selecting the Streams directive */
+#define SPDK_NVME_IO_FLAGS_STREAMS_DIRECTIVE (1U << 20)
+
 #ifdef __cplusplus
 }
 #endif
@@ -175,6 +175,12 @@ struct spdk_scsi_dev {
 
 	int			num_ports;
 	struct spdk_scsi_port	port[SPDK_SCSI_DEV_MAX_PORTS];
+
+	/** I/O channel priority used for the LUNs of this device. */
+	uint32_t		io_priority;
+
+	/** Write stream the data written to the LUNs of this device is placed in (0 = none). */
+	uint16_t		write_stream;
 };
 
 /**
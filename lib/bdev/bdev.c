@@ -116,10 +116,24 @@ spdk_bdev_io_set_rbuf(struct spdk_bdev_io *bdev_io, void *buf)
 	assert(buf != NULL);
 	bdev_io->u.read.buf_unaligned = buf;
 	bdev_io->u.read.buf = (void *)((unsigned long)((char *)buf + 512) & ~511UL);
+	bdev_io->u.read.iov.iov_base = bdev_io->u.read.buf;
 	bdev_io->u.read.put_rbuf = true;
 	bdev_io->get_rbuf_cb(bdev_io);
 }
 
+/*
+ * Size of the rbuf backing a read of the given length, including room for alignment.
+ */
+static inline uint64_t
+spdk_bdev_rbuf_size(uint64_t length)
+{
+	if (length <= SPDK_BDEV_SMALL_RBUF_MAX_SIZE) {
+		return SPDK_BDEV_SMALL_RBUF_MAX_SIZE + 512;
+	} else {
+		return SPDK_BDEV_LARGE_RBUF_MAX_SIZE + 512;
+	}
+}
+
 static void
 spdk_bdev_io_put_rbuf(struct spdk_bdev_io *bdev_io)
 {
@@ -132,6 +146,11 @@ spdk_bdev_io_put_rbuf(struct spdk_bdev_io *bdev_io)
 	length = bdev_io->u.read.nbytes;
 	buf = bdev_io->u.read.buf_unaligned;
 
+	if (bdev_io->u.read.rbuf_from_bdev) {
+		bdev_io->bdev->fn_table->put_rbuf(bdev_io->bdev, buf, spdk_bdev_rbuf_size(length));
+		return;
+	}
+
 	if (length <= SPDK_BDEV_SMALL_RBUF_MAX_SIZE) {
 		pool = g_rbuf_small_pool;
 		tailq = &g_need_rbuf_small[rte_lcore_id()];
@@ -368,6 +387,15 @@ _spdk_bdev_io_get_rbuf(struct spdk_bdev_io *bdev_io)
 	int rc;
 	void *buf = NULL;
 
+	if (bdev_io->bdev->fn_table->get_rbuf != NULL) {
+		buf = bdev_io->bdev->fn_table->get_rbuf(bdev_io->bdev, spdk_bdev_rbuf_size(len));
+		if (buf != NULL) {
+			bdev_io->u.read.rbuf_from_bdev = true;
+			spdk_bdev_io_set_rbuf(bdev_io, buf);
+			return;
+		}
+	}
+
 	if (len <= SPDK_BDEV_SMALL_RBUF_MAX_SIZE) {
 		pool = g_rbuf_small_pool;
 		tailq = &g_need_rbuf_small[rte_lcore_id()];
@@ -465,9 +493,24 @@ spdk_bdev_io_init(struct spdk_bdev_io *bdev_io,
 	bdev_io->cb = cb;
 	bdev_io->gencnt = bdev->gencnt;
 	bdev_io->status = SPDK_BDEV_IO_STATUS_PENDING;
+	memset(&bdev_io->hints, 0, sizeof(bdev_io->hints));
 	TAILQ_INIT(&bdev_io->child_io);
 }
 
+static void
+spdk_bdev_io_set_hints(struct spdk_bdev_io *bdev_io, const struct spdk_bdev_io_hints *hints)
+{
+	if (hints == NULL) {
+		return;
+	}
+
+	bdev_io->hints = *hints;
+	if (bdev_io->hints.write_stream > bdev_io->bdev->max_write_streams) {
+		/* Not a usable stream on this bdev - write without one rather than fail. */
+		bdev_io->hints.write_stream = 0;
+	}
+}
+
 struct spdk_bdev_io *
 spdk_bdev_get_child_io(struct spdk_bdev_io *parent,
 		       struct spdk_bdev *bdev,
@@ -490,8 +533,13 @@ spdk_bdev_get_child_io(struct spdk_bdev_io *parent,
 
 	child->type = parent->type;
 	memcpy(&child->u, &parent->u, sizeof(child->u));
+	spdk_bdev_io_set_hints(child, &parent->hints);
 	if (child->type == SPDK_BDEV_IO_TYPE_READ) {
 		child->u.read.put_rbuf = false;
+		/* A single buffer read must follow the child's own rbuf, if it gets one */
+		if (parent->u.read.iovs == &parent->u.read.iov) {
+			child->u.read.iovs = &child->u.read.iov;
+		}
 	}
 	child->get_rbuf_cb = NULL;
 	child->parent = parent;
@@ -517,6 +565,15 @@ struct spdk_bdev_io *
 spdk_bdev_read(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 	       void *buf, uint64_t offset, uint64_t nbytes,
 	       spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	return spdk_bdev_read_with_hints(bdev, ch, buf, offset, nbytes, NULL, cb, cb_arg);
+}
+
+struct spdk_bdev_io *
+spdk_bdev_read_with_hints(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+			  void *buf, uint64_t offset, uint64_t nbytes,
+			  const struct spdk_bdev_io_hints *hints,
+			  spdk_bdev_io_completion_cb cb, void *cb_arg)
 {
 	struct spdk_bdev_io *bdev_io;
 	int rc;
@@ -547,8 +604,81 @@ spdk_bdev_read(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 	bdev_io->type = SPDK_BDEV_IO_TYPE_READ;
 	bdev_io->u.read.buf = buf;
 	bdev_io->u.read.nbytes = nbytes;
+	bdev_io->u.read.iov.iov_base = buf;
+	bdev_io->u.read.iov.iov_len = nbytes;
+	bdev_io->u.read.iovs = &bdev_io->u.read.iov;
+	bdev_io->u.read.iovcnt = 1;
 	bdev_io->u.read.offset = offset;
 	spdk_bdev_io_init(bdev_io, bdev, cb_arg, cb);
+	spdk_bdev_io_set_hints(bdev_io, hints);
+
+	rc = spdk_bdev_io_submit(bdev_io);
+	if (rc < 0) {
+		spdk_bdev_put_io(bdev_io);
+		return NULL;
+	}
+
+	return bdev_io;
+}
+
+struct spdk_bdev_io *
+spdk_bdev_readv(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+		struct iovec *iov, int iovcnt,
+		uint64_t offset, uint64_t nbytes,
+		spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	return spdk_bdev_readv_with_hints(bdev, ch, iov, iovcnt, offset, nbytes, NULL, cb, cb_arg);
+}
+
+/*
+ * Unlike spdk_bdev_read(), the caller always provides the buffers. An rbuf is never
+ *  allocated on its behalf.
+ */
+struct spdk_bdev_io *
+spdk_bdev_readv_with_hints(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+			   struct iovec *iov, int iovcnt,
+			   uint64_t offset, uint64_t nbytes,
+			   const struct spdk_bdev_io_hints *hints,
+			   spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct spdk_bdev_io *bdev_io;
+	int rc;
+
+	if (iovcnt < 1 || iov[0].iov_base == NULL) {
+		return NULL;
+	}
+
+	/* Return failure if nbytes is not a multiple of bdev->blocklen */
+	if (nbytes % bdev->blocklen) {
+		return NULL;
+	}
+
+	/* Return failure if offset + nbytes is less than offset; indicates there
+	 * has been an overflow and hence the offset has been wrapped around */
+	if ((offset + nbytes) < offset) {
+		return NULL;
+	}
+
+	/* Return failure if offset + nbytes exceeds the size of the blockdev */
+	if ((offset + nbytes) > (bdev->blockcnt * bdev->blocklen)) {
+		return NULL;
+	}
+
+	bdev_io = spdk_bdev_get_io();
+	if (!bdev_io) {
+		SPDK_ERRLOG("spdk_bdev_io memory allocation failed duing readv\n");
+		return NULL;
+	}
+
+	bdev_io->ch = ch;
+	bdev_io->type = SPDK_BDEV_IO_TYPE_READ;
+	bdev_io->u.read.buf = iov[0].iov_base;
+	bdev_io->u.read.nbytes = nbytes;
+	bdev_io->u.read.iovs = iov;
+	bdev_io->u.read.iovcnt = iovcnt;
+	bdev_io->u.read.offset = offset;
+	spdk_bdev_io_init(bdev_io, bdev, cb_arg, cb);
+	spdk_bdev_io_set_hints(bdev_io, hints);
 
 	rc = spdk_bdev_io_submit(bdev_io);
 	if (rc < 0) {
@@ -563,6 +693,15 @@ struct spdk_bdev_io *
 spdk_bdev_write(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 		void *buf, uint64_t offset, uint64_t nbytes,
 		spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	return spdk_bdev_write_with_hints(bdev, ch, buf, offset, nbytes, NULL, cb, cb_arg);
+}
+
+struct spdk_bdev_io *
+spdk_bdev_write_with_hints(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+			   void *buf, uint64_t offset, uint64_t nbytes,
+			   const struct spdk_bdev_io_hints *hints,
+			   spdk_bdev_io_completion_cb cb, void *cb_arg)
 {
 	struct spdk_bdev_io *bdev_io;
 	int rc;
@@ -598,6 +737,7 @@ spdk_bdev_write(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 	bdev_io->u.write.len = nbytes;
 	bdev_io->u.write.offset = offset;
 	spdk_bdev_io_init(bdev_io, bdev, cb_arg, cb);
+	spdk_bdev_io_set_hints(bdev_io, hints);
 
 	rc = spdk_bdev_io_submit(bdev_io);
 	if (rc < 0) {
@@ -613,6 +753,16 @@ spdk_bdev_writev(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 		 struct iovec *iov, int iovcnt,
 		 uint64_t offset, uint64_t len,
 		 spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	return spdk_bdev_writev_with_hints(bdev, ch, iov, iovcnt, offset, len, NULL, cb, cb_arg);
+}
+
+struct spdk_bdev_io *
+spdk_bdev_writev_with_hints(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+			    struct iovec *iov, int iovcnt,
+			    uint64_t offset, uint64_t len,
+			    const struct spdk_bdev_io_hints *hints,
+			    spdk_bdev_io_completion_cb cb, void *cb_arg)
 {
 	struct spdk_bdev_io *bdev_io;
 	int rc;
@@ -646,6 +796,7 @@ spdk_bdev_writev(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 	bdev_io->u.write.len = len;
 	bdev_io->u.write.offset = offset;
 	spdk_bdev_io_init(bdev_io, bdev, cb_arg, cb);
+	spdk_bdev_io_set_hints(bdev_io, hints);
 
 	rc = spdk_bdev_io_submit(bdev_io);
 	if (rc < 0) {
@@ -56,18 +56,39 @@ struct malloc_disk {
 	struct malloc_disk	*next;
 };
 
+/*
+ * Per I/O context. A scattered read or write issues one copy per iovec, all
+ *  through the copy task that follows this structure.
+ */
+struct malloc_task {
+	int				num_outstanding;
+	enum spdk_bdev_io_status	status;
+};
+
+static struct malloc_task *
+__malloc_task_from_copy_task(struct copy_task *ct)
+{
+	return (struct malloc_task *)((uintptr_t)ct - sizeof(struct malloc_task));
+}
+
+static struct copy_task *
+__copy_task_from_malloc_task(struct malloc_task *mt)
+{
+	return (struct copy_task *)((uintptr_t)mt + sizeof(struct malloc_task));
+}
+
 static void
 malloc_done(void *ref, int status)
 {
-	struct copy_task *cp_task = (struct copy_task *)ref;
-	enum spdk_bdev_io_status bdev_status;
+	struct malloc_task *task = __malloc_task_from_copy_task(ref);
 
 	if (status != 0) {
-		bdev_status = SPDK_BDEV_IO_STATUS_FAILED;
-	} else {
-		bdev_status = SPDK_BDEV_IO_STATUS_SUCCESS;
+		task->status = SPDK_BDEV_IO_STATUS_FAILED;
+	}
+
+	if (--task->num_outstanding == 0) {
+		spdk_bdev_io_complete(spdk_bdev_io_from_ctx(task), task->status);
 	}
-	spdk_bdev_io_complete(spdk_bdev_io_from_ctx(cp_task), bdev_status);
 }
 
 static struct malloc_disk *g_malloc_disk_head = NULL;
@@ -81,7 +102,7 @@ static void blockdev_malloc_get_spdk_running_config(FILE *fp);
 static int
 blockdev_malloc_get_ctx_size(void)
 {
-	return spdk_copy_module_get_max_ctx_size();
+	return sizeof(struct malloc_task) + spdk_copy_module_get_max_ctx_size();
 }
 
 SPDK_BDEV_MODULE_REGISTER(blockdev_malloc_initialize, blockdev_malloc_finish,
@@ -120,37 +141,68 @@ blockdev_malloc_destruct(struct spdk_bdev *bdev)
 	return 0;
 }
 
-static int64_t
-blockdev_malloc_read(struct malloc_disk *mdisk, struct spdk_io_channel *ch,
-		     struct copy_task *copy_req,
-		     void *buf, uint64_t nbytes, uint64_t offset)
+static void
+blockdev_malloc_readv(struct malloc_disk *mdisk, struct spdk_io_channel *ch,
+		      struct malloc_task *task,
+		      struct iovec *iov, int iovcnt, size_t len, uint64_t offset)
 {
-	SPDK_TRACELOG(SPDK_TRACE_MALLOC, "read %lu bytes from offset %#lx to %p\n",
-		      nbytes, offset, buf);
+	uint8_t *src = (uint8_t *)mdisk->malloc_buf + offset;
+	size_t copy_len;
+	int64_t res;
+	int i;
+
+	SPDK_TRACELOG(SPDK_TRACE_MALLOC, "read %lu bytes from offset %#lx to %d iovs\n",
+		      len, offset, iovcnt);
+
+	task->status = SPDK_BDEV_IO_STATUS_SUCCESS;
+	task->num_outstanding = iovcnt;
+
+	for (i = 0; i < iovcnt; i++) {
+		copy_len = iov[i].iov_len < len ? iov[i].iov_len : len;
+		res = spdk_copy_submit(__copy_task_from_malloc_task(task), ch, iov[i].iov_base,
+				       src, copy_len, malloc_done);
+		if (res != (int64_t)copy_len) {
+			malloc_done(__copy_task_from_malloc_task(task), -1);
+		}
 
-	return spdk_copy_submit(copy_req, ch, buf, mdisk->malloc_buf + offset,
-				nbytes, malloc_done);
+		src += copy_len;
+		len -= copy_len;
+	}
 }
 
-static int64_t
+static void
 blockdev_malloc_writev(struct malloc_disk *mdisk, struct spdk_io_channel *ch,
-		       struct copy_task *copy_req,
+		       struct malloc_task *task,
 		       struct iovec *iov, int iovcnt, size_t len, uint64_t offset)
 {
-	if ((iovcnt != 1) || (iov->iov_len != len))
-		return -1;
-
-	SPDK_TRACELOG(SPDK_TRACE_MALLOC, "wrote %lu bytes to offset %#lx from %p\n",
-		      iov->iov_len, offset, iov->iov_base);
+	uint8_t *dst = (uint8_t *)mdisk->malloc_buf + offset;
+	size_t copy_len;
+	int64_t res;
+	int i;
+
+	SPDK_TRACELOG(SPDK_TRACE_MALLOC, "wrote %lu bytes to offset %#lx from %d iovs\n",
+		      len, offset, iovcnt);
+
+	task->status = SPDK_BDEV_IO_STATUS_SUCCESS;
+	task->num_outstanding = iovcnt;
+
+	for (i = 0; i < iovcnt; i++) {
+		copy_len = iov[i].iov_len < len ? iov[i].iov_len : len;
+		res = spdk_copy_submit(__copy_task_from_malloc_task(task), ch, dst,
+				       iov[i].iov_base, copy_len, malloc_done);
+		if (res != (int64_t)copy_len) {
+			malloc_done(__copy_task_from_malloc_task(task), -1);
+		}
 
-	return spdk_copy_submit(copy_req, ch, mdisk->malloc_buf + offset,
-				iov->iov_base, len, malloc_done);
+		dst += copy_len;
+		len -= copy_len;
+	}
 }
 
 static int
 blockdev_malloc_unmap(struct malloc_disk *mdisk,
 		      struct spdk_io_channel *ch,
-		      struct copy_task *copy_req,
+		      struct malloc_task *task,
 		      struct spdk_scsi_unmap_bdesc *unmap_d,
 		      uint16_t bdesc_count)
 {
@@ -174,22 +226,26 @@ blockdev_malloc_unmap(struct malloc_disk *mdisk,
 		return -1;
 	}
 
-	return spdk_copy_submit_fill(copy_req, ch, mdisk->malloc_buf + offset, 0, byte_count, malloc_done);
+	task->status = SPDK_BDEV_IO_STATUS_SUCCESS;
+	task->num_outstanding = 1;
+
+	return spdk_copy_submit_fill(__copy_task_from_malloc_task(task), ch,
+				     mdisk->malloc_buf + offset, 0, byte_count, malloc_done);
 }
 
 static int64_t
-blockdev_malloc_flush(struct malloc_disk *mdisk, struct copy_task *copy_req,
+blockdev_malloc_flush(struct malloc_disk *mdisk, struct malloc_task *task,
 		      uint64_t offset, uint64_t nbytes)
 {
-	spdk_bdev_io_complete(spdk_bdev_io_from_ctx(copy_req), SPDK_BDEV_IO_STATUS_SUCCESS);
+	spdk_bdev_io_complete(spdk_bdev_io_from_ctx(task), SPDK_BDEV_IO_STATUS_SUCCESS);
 
 	return 0;
 }
 
 static int
-blockdev_malloc_reset(struct malloc_disk *mdisk, struct copy_task *copy_req)
+blockdev_malloc_reset(struct malloc_disk *mdisk, struct malloc_task *task)
 {
-	spdk_bdev_io_complete(spdk_bdev_io_from_ctx(copy_req), SPDK_BDEV_IO_STATUS_SUCCESS);
+	spdk_bdev_io_complete(spdk_bdev_io_from_ctx(task), SPDK_BDEV_IO_STATUS_SUCCESS);
 
 	return 0;
 }
@@ -201,41 +257,45 @@ static int _blockdev_malloc_submit_request(struct spdk_bdev_io *bdev_io)
 		if (bdev_io->u.read.buf == NULL) {
 			bdev_io->u.read.buf = ((struct malloc_disk *)bdev_io->ctx)->malloc_buf +
 					      bdev_io->u.read.offset;
+			bdev_io->u.read.iov.iov_base = bdev_io->u.read.buf;
 			spdk_bdev_io_complete(spdk_bdev_io_from_ctx(bdev_io->driver_ctx),
 					      SPDK_BDEV_IO_STATUS_SUCCESS);
 			return 0;
 		}
 
-		return blockdev_malloc_read((struct malloc_disk *)bdev_io->ctx,
-					    bdev_io->ch,
-					    (struct copy_task *)bdev_io->driver_ctx,
-					    bdev_io->u.read.buf,
-					    bdev_io->u.read.nbytes,
-					    bdev_io->u.read.offset);
+		blockdev_malloc_readv((struct malloc_disk *)bdev_io->ctx,
+				      bdev_io->ch,
+				      (struct malloc_task *)bdev_io->driver_ctx,
+				      bdev_io->u.read.iovs,
+				      bdev_io->u.read.iovcnt,
+				      bdev_io->u.read.nbytes,
+				      bdev_io->u.read.offset);
+		return 0;
 
 	case SPDK_BDEV_IO_TYPE_WRITE:
-		return blockdev_malloc_writev((struct malloc_disk *)bdev_io->ctx,
-					      bdev_io->ch,
-					      (struct copy_task *)bdev_io->driver_ctx,
-					      bdev_io->u.write.iovs,
-					      bdev_io->u.write.iovcnt,
-					      bdev_io->u.write.len,
-					      bdev_io->u.write.offset);
+		blockdev_malloc_writev((struct malloc_disk *)bdev_io->ctx,
+				       bdev_io->ch,
+				       (struct malloc_task *)bdev_io->driver_ctx,
+				       bdev_io->u.write.iovs,
+				       bdev_io->u.write.iovcnt,
+				       bdev_io->u.write.len,
+				       bdev_io->u.write.offset);
+		return 0;
 
 	case SPDK_BDEV_IO_TYPE_RESET:
 		return blockdev_malloc_reset((struct malloc_disk *)bdev_io->ctx,
-					     (struct copy_task *)bdev_io->driver_ctx);
+					     (struct malloc_task *)bdev_io->driver_ctx);
 
 	case SPDK_BDEV_IO_TYPE_FLUSH:
 		return blockdev_malloc_flush((struct malloc_disk *)bdev_io->ctx,
-					     (struct copy_task *)bdev_io->driver_ctx,
+					     (struct malloc_task *)bdev_io->driver_ctx,
 					     bdev_io->u.flush.offset,
 					     bdev_io->u.flush.length);
 
 	case SPDK_BDEV_IO_TYPE_UNMAP:
 		return blockdev_malloc_unmap((struct malloc_disk *)bdev_io->ctx,
 					     bdev_io->ch,
-					     (struct copy_task *)bdev_io->driver_ctx,
+					     (struct malloc_task *)bdev_io->driver_ctx,
 					     bdev_io->u.unmap.unmap_bdesc,
 					     bdev_io->u.unmap.bdesc_count);
 	default:
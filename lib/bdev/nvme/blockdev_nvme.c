@@ -35,7 +35,10 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <assert.h>
 #include <errno.h>
+#include <string.h>
+#include <strings.h>
 #include <sys/param.h>
 
 #include <pthread.h>
@@ -72,12 +75,37 @@ struct nvme_device {
 	TAILQ_ENTRY(nvme_device)	tailq;
 
 	int				id;
+
+	/** arbitration mechanism the controller was enabled with */
+	enum spdk_nvme_cc_ams		arb_mechanism;
+
+	/** timed poller that processes admin completions and asynchronous events */
+	struct spdk_poller		*adminq_poller;
 };
 
-struct nvme_blockdev {
-	struct spdk_bdev	disk;
+#define NVME_MAX_PATHS 4
+
+/** One controller through which a namespace can be reached */
+struct nvme_path {
 	struct spdk_nvme_ctrlr	*ctrlr;
 	struct spdk_nvme_ns	*ns;
+
+	/** The controller's transport only carries contiguous payloads */
+	bool			contig_payload;
+};
+
+struct nvme_blockdev {
+	struct spdk_bdev	disk;
+
+	/**
+	 * Namespaces reporting the same NGUID or EUI64 on several controllers are
+	 *  grouped into a single blockdev, with one path per controller.
+	 */
+	struct nvme_path	paths[NVME_MAX_PATHS];
+	uint32_t		num_paths;
+
+	/** Path a reset goes to: the last one an I/O failed on, or the next one in turn */
+	uint32_t		reset_path;
 	uint64_t		lba_start;
 	uint64_t		lba_end;
 	uint64_t		blocklen;
@@ -88,9 +116,43 @@ struct nvme_io_channel {
 	struct spdk_poller	*poller;
 };
 
+/**
+ * I/O channel of a blockdev with more than one path.  It holds a controller
+ *  I/O channel for each path along with the number of I/O outstanding on it.
+ */
+struct nvme_mp_io_channel {
+	struct spdk_io_channel	*path_ch[NVME_MAX_PATHS];
+	uint32_t		outstanding[NVME_MAX_PATHS];
+	uint32_t		next_path;
+};
+
+enum nvme_multipath_policy {
+	NVME_MULTIPATH_ROUND_ROBIN = 0,
+	NVME_MULTIPATH_LEAST_QUEUE_DEPTH = 1,
+};
+
 #define NVME_DEFAULT_MAX_UNMAP_BDESC_COUNT	1
 struct nvme_blockio {
-	int	reserved;
+	/** multipath channel the I/O was submitted on, or NULL for a single path blockdev */
+	struct nvme_mp_io_channel	*mp_ch;
+	uint32_t			path;
+	uint32_t			tried_paths;
+
+	/** array of iovecs to transfer. */
+	struct iovec			*iovs;
+
+	/** Number of iovecs in iovs array. */
+	int				iovcnt;
+
+	/** Current iovec position. */
+	int				iovpos;
+
+	/** Offset in current iovec. */
+	uint32_t			iov_offset;
+
+	/** Contiguous copy of a scattered payload for a path that needs one, or NULL */
+	void				*bounce_buf;
+	uint64_t			bounce_len;
 };
 
 enum data_direction {
@@ -106,6 +168,9 @@ struct nvme_bdf_whitelist {
 	char		name[MAX_NVME_NAME_LENGTH];
 };
 
+/* The admin queue only carries asynchronous events and management commands. */
+#define NVME_DEFAULT_ADMIN_POLL_PERIOD_US 100000
+
 #define NVME_MAX_BLOCKDEVS_PER_CONTROLLER 256
 #define NVME_MAX_CONTROLLERS 16
 #define NVME_MAX_BLOCKDEVS (NVME_MAX_BLOCKDEVS_PER_CONTROLLER * NVME_MAX_CONTROLLERS)
@@ -115,16 +180,27 @@ static int nvme_luns_per_ns = 1;
 static int nvme_controller_index = 0;
 static int LunSizeInMB = 0;
 static int num_controllers = -1;
+static enum spdk_nvme_cc_ams g_arb_mechanism = SPDK_NVME_CC_AMS_RR;
+static bool g_use_cmb_read_buffers = false;
+static bool g_enable_interrupts = false;
+static enum nvme_multipath_policy g_multipath_policy = NVME_MULTIPATH_ROUND_ROBIN;
+static int g_io_queue_size = 0;
+static int g_io_queue_requests = 0;
+static int g_latency_target_us = 0;
+static int g_admin_poll_period_us = NVME_DEFAULT_ADMIN_POLL_PERIOD_US;
+static struct spdk_nvme_transport_id g_nvme_trids[NVME_MAX_CONTROLLERS];
+static int g_num_nvme_trids = 0;
 
 static TAILQ_HEAD(, nvme_device)	g_nvme_devices = TAILQ_HEAD_INITIALIZER(g_nvme_devices);;
 
 static void nvme_ctrlr_initialize_blockdevs(struct spdk_nvme_ctrlr *ctrlr,
-		int bdev_per_ns, int ctrlr_id);
+		int bdev_per_ns, int ctrlr_id, bool contig_payload);
 static int nvme_library_init(void);
 static void nvme_library_fini(void);
-int nvme_queue_cmd(struct nvme_blockdev *bdev, struct spdk_nvme_qpair *qpair,
-		   struct nvme_blockio *bio,
-		   int direction, void *buf, uint64_t nbytes, uint64_t offset);
+int nvme_queue_cmd(struct nvme_blockdev *bdev, struct spdk_nvme_ns *ns,
+		   struct spdk_nvme_qpair *qpair, struct nvme_blockio *bio,
+		   int direction, struct iovec *iov, int iovcnt, uint64_t nbytes,
+		   uint64_t offset);
 
 static int
 nvme_get_ctx_size(void)
@@ -136,17 +212,16 @@ SPDK_BDEV_MODULE_REGISTER(nvme_library_init, NULL, blockdev_nvme_get_spdk_runnin
 			  nvme_get_ctx_size)
 
 static int64_t
-blockdev_nvme_read(struct nvme_blockdev *nbdev, struct spdk_io_channel *ch,
-		   struct nvme_blockio *bio,
-		   void *buf, uint64_t nbytes, uint64_t offset)
+blockdev_nvme_readv(struct nvme_blockdev *nbdev, struct spdk_nvme_ns *ns,
+		    struct spdk_nvme_qpair *qpair, struct nvme_blockio *bio,
+		    struct iovec *iov, int iovcnt, uint64_t nbytes, uint64_t offset)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
 	int64_t rc;
 
-	SPDK_TRACELOG(SPDK_TRACE_BDEV_NVME, "read %lu bytes with offset %#lx to %p\n",
-		      nbytes, offset, buf);
+	SPDK_TRACELOG(SPDK_TRACE_BDEV_NVME, "read %lu bytes with offset %#lx to %d iovs\n",
+		      nbytes, offset, iovcnt);
 
-	rc = nvme_queue_cmd(nbdev, nvme_ch->qpair, bio, BDEV_DISK_READ, buf, nbytes, offset);
+	rc = nvme_queue_cmd(nbdev, ns, qpair, bio, BDEV_DISK_READ, iov, iovcnt, nbytes, offset);
 	if (rc < 0)
 		return -1;
 
@@ -154,25 +229,20 @@ blockdev_nvme_read(struct nvme_blockdev *nbdev, struct spdk_io_channel *ch,
 }
 
 static int64_t
-blockdev_nvme_writev(struct nvme_blockdev *nbdev, struct spdk_io_channel *ch,
-		     struct nvme_blockio *bio,
+blockdev_nvme_writev(struct nvme_blockdev *nbdev, struct spdk_nvme_ns *ns,
+		     struct spdk_nvme_qpair *qpair, struct nvme_blockio *bio,
 		     struct iovec *iov, int iovcnt, size_t len, uint64_t offset)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
 	int64_t rc;
 
-	if ((iovcnt != 1) || (iov->iov_len != len))
-		return -1;
-
-	SPDK_TRACELOG(SPDK_TRACE_BDEV_NVME, "write %lu bytes with offset %#lx from %p\n",
-		      iov->iov_len, offset, iov->iov_base);
+	SPDK_TRACELOG(SPDK_TRACE_BDEV_NVME, "write %lu bytes with offset %#lx from %d iovs\n",
+		      len, offset, iovcnt);
 
-	rc = nvme_queue_cmd(nbdev, nvme_ch->qpair, bio, BDEV_DISK_WRITE, (void *)iov->iov_base,
-			    iov->iov_len, offset);
+	rc = nvme_queue_cmd(nbdev, ns, qpair, bio, BDEV_DISK_WRITE, iov, iovcnt, len, offset);
 	if (rc < 0)
 		return -1;
 
-	return iov->iov_len;
+	return len;
 }
 
 static void
@@ -180,7 +250,39 @@ blockdev_nvme_poll(void *arg)
 {
 	struct spdk_nvme_qpair *qpair = arg;
 
-	spdk_nvme_qpair_process_completions(qpair, 0);
+	if (spdk_nvme_qpair_process_completions(qpair, 0) > 0) {
+		spdk_poller_set_busy();
+	}
+}
+
+static void
+blockdev_nvme_poll_intr(void *arg, bool enable)
+{
+	struct spdk_nvme_qpair *qpair = arg;
+
+	spdk_nvme_qpair_mask_interrupt(qpair, !enable);
+}
+
+static void
+blockdev_nvme_poll_adminq(void *arg)
+{
+	struct spdk_nvme_ctrlr *ctrlr = arg;
+
+	spdk_nvme_ctrlr_process_admin_completions(ctrlr);
+}
+
+static void
+blockdev_nvme_aer_cb(void *arg, const struct spdk_nvme_cpl *cpl)
+{
+	struct nvme_device *dev = arg;
+
+	if (spdk_nvme_cpl_is_error(cpl)) {
+		SPDK_ERRLOG("Asynchronous event request failed on NVMe controller %d\n", dev->id);
+		return;
+	}
+
+	SPDK_NOTICELOG("Asynchronous event on NVMe controller %d: type %u info %u log page 0x%x\n",
+		       dev->id, cpl->cdw0 & 0x7, (cpl->cdw0 >> 8) & 0xff, (cpl->cdw0 >> 16) & 0xff);
 }
 
 static int
@@ -203,35 +305,153 @@ blockdev_nvme_reset(struct nvme_blockdev *nbdev, struct nvme_blockio *bio)
 {
 	int rc;
 	enum spdk_bdev_io_status status;
+	uint32_t path;
 
-	status = SPDK_BDEV_IO_STATUS_SUCCESS;
-	rc = spdk_nvme_ctrlr_reset(nbdev->ctrlr);
-	if (rc != 0) {
-		status = SPDK_BDEV_IO_STATUS_FAILED;
-	}
+	/*
+	 * Only one path of a multipath blockdev is reset at a time.  The I/O it aborts is
+	 *  retried on the other paths, which keep serving I/O during the reset.
+	 */
+	path = nbdev->reset_path % nbdev->num_paths;
+	rc = spdk_nvme_ctrlr_reset(nbdev->paths[path].ctrlr);
+	nbdev->reset_path = (path + 1) % nbdev->num_paths;
 
+	status = (rc == 0) ? SPDK_BDEV_IO_STATUS_SUCCESS : SPDK_BDEV_IO_STATUS_FAILED;
 	spdk_bdev_io_complete(spdk_bdev_io_from_ctx(bio), status);
 	return rc;
 }
 
 static int
-blockdev_nvme_unmap(struct nvme_blockdev *nbdev, struct spdk_io_channel *ch,
-		    struct nvme_blockio *bio,
+blockdev_nvme_unmap(struct nvme_blockdev *nbdev, struct spdk_nvme_ns *ns,
+		    struct spdk_nvme_qpair *qpair, struct nvme_blockio *bio,
 		    struct spdk_scsi_unmap_bdesc *umap_d,
 		    uint16_t bdesc_count);
 
-static void blockdev_nvme_get_rbuf_cb(struct spdk_bdev_io *bdev_io)
+static int
+blockdev_nvme_submit_on_path(struct spdk_bdev_io *bdev_io, uint32_t path)
+{
+	struct nvme_blockdev *nbdev = (struct nvme_blockdev *)bdev_io->ctx;
+	struct nvme_blockio *bio = (struct nvme_blockio *)bdev_io->driver_ctx;
+	struct spdk_nvme_ns *ns = nbdev->paths[path].ns;
+	struct nvme_io_channel *nvme_ch;
+	int64_t rc;
+
+	if (bio->mp_ch == NULL) {
+		nvme_ch = spdk_io_channel_get_ctx(bdev_io->ch);
+	} else {
+		nvme_ch = spdk_io_channel_get_ctx(bio->mp_ch->path_ch[path]);
+	}
+
+	bio->bounce_buf = NULL;
+
+	switch (bdev_io->type) {
+	case SPDK_BDEV_IO_TYPE_READ:
+		rc = blockdev_nvme_readv(nbdev, ns, nvme_ch->qpair, bio,
+					 bdev_io->u.read.iovs,
+					 bdev_io->u.read.iovcnt,
+					 bdev_io->u.read.nbytes,
+					 bdev_io->u.read.offset);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_WRITE:
+		rc = blockdev_nvme_writev(nbdev, ns, nvme_ch->qpair, bio,
+					  bdev_io->u.write.iovs,
+					  bdev_io->u.write.iovcnt,
+					  bdev_io->u.write.len,
+					  bdev_io->u.write.offset);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_UNMAP:
+		rc = blockdev_nvme_unmap(nbdev, ns, nvme_ch->qpair, bio,
+					 bdev_io->u.unmap.unmap_bdesc,
+					 bdev_io->u.unmap.bdesc_count);
+		break;
+
+	default:
+		return -1;
+	}
+
+	return rc < 0 ? -1 : 0;
+}
+
+/*
+ * Pick the path for the next attempt of an I/O, skipping paths it was already tried on
+ *  and paths whose controller has failed.  Returns -1 if no path is left.
+ */
+static int
+blockdev_nvme_select_path(struct nvme_blockdev *nbdev, struct nvme_blockio *bio)
+{
+	struct nvme_mp_io_channel *mp_ch = bio->mp_ch;
+	uint32_t i, path;
+	int selected = -1;
+
+	for (i = 0; i < nbdev->num_paths; i++) {
+		path = (mp_ch->next_path + i) % nbdev->num_paths;
+
+		if ((bio->tried_paths & (1U << path)) || mp_ch->path_ch[path] == NULL ||
+		    spdk_nvme_ctrlr_is_failed(nbdev->paths[path].ctrlr)) {
+			continue;
+		}
+
+		if (g_multipath_policy == NVME_MULTIPATH_ROUND_ROBIN) {
+			selected = path;
+			break;
+		}
+
+		/* Ties go to the first path in round robin order. */
+		if (selected < 0 || mp_ch->outstanding[path] < mp_ch->outstanding[selected]) {
+			selected = path;
+		}
+	}
+
+	if (selected >= 0) {
+		mp_ch->next_path = (selected + 1) % nbdev->num_paths;
+	}
+
+	return selected;
+}
+
+static int
+blockdev_nvme_submit_multipath(struct spdk_bdev_io *bdev_io)
+{
+	struct nvme_blockdev *nbdev = (struct nvme_blockdev *)bdev_io->ctx;
+	struct nvme_blockio *bio = (struct nvme_blockio *)bdev_io->driver_ctx;
+	int path;
+
+	while ((path = blockdev_nvme_select_path(nbdev, bio)) >= 0) {
+		bio->path = path;
+		bio->tried_paths |= 1U << path;
+		bio->mp_ch->outstanding[path]++;
+
+		if (blockdev_nvme_submit_on_path(bdev_io, path) == 0) {
+			return 0;
+		}
+
+		bio->mp_ch->outstanding[path]--;
+	}
+
+	return -1;
+}
+
+static int
+blockdev_nvme_submit_rw(struct spdk_bdev_io *bdev_io)
 {
-	int ret;
+	struct nvme_blockdev *nbdev = (struct nvme_blockdev *)bdev_io->ctx;
+	struct nvme_blockio *bio = (struct nvme_blockio *)bdev_io->driver_ctx;
 
-	ret = blockdev_nvme_read((struct nvme_blockdev *)bdev_io->ctx,
-				 bdev_io->ch,
-				 (struct nvme_blockio *)bdev_io->driver_ctx,
-				 bdev_io->u.read.buf,
-				 bdev_io->u.read.nbytes,
-				 bdev_io->u.read.offset);
+	if (nbdev->num_paths == 1) {
+		bio->mp_ch = NULL;
+		bio->path = 0;
+		return blockdev_nvme_submit_on_path(bdev_io, 0);
+	}
+
+	bio->mp_ch = spdk_io_channel_get_ctx(bdev_io->ch);
+	bio->tried_paths = 0;
+	return blockdev_nvme_submit_multipath(bdev_io);
+}
 
-	if (ret < 0) {
+static void blockdev_nvme_get_rbuf_cb(struct spdk_bdev_io *bdev_io)
+{
+	if (blockdev_nvme_submit_rw(bdev_io) < 0) {
 		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
 	}
 }
@@ -244,20 +464,8 @@ static int _blockdev_nvme_submit_request(struct spdk_bdev_io *bdev_io)
 		return 0;
 
 	case SPDK_BDEV_IO_TYPE_WRITE:
-		return blockdev_nvme_writev((struct nvme_blockdev *)bdev_io->ctx,
-					    bdev_io->ch,
-					    (struct nvme_blockio *)bdev_io->driver_ctx,
-					    bdev_io->u.write.iovs,
-					    bdev_io->u.write.iovcnt,
-					    bdev_io->u.write.len,
-					    bdev_io->u.write.offset);
-
 	case SPDK_BDEV_IO_TYPE_UNMAP:
-		return blockdev_nvme_unmap((struct nvme_blockdev *)bdev_io->ctx,
-					   bdev_io->ch,
-					   (struct nvme_blockio *)bdev_io->driver_ctx,
-					   bdev_io->u.unmap.unmap_bdesc,
-					   bdev_io->u.unmap.bdesc_count);
+		return blockdev_nvme_submit_rw(bdev_io);
 
 	case SPDK_BDEV_IO_TYPE_RESET:
 		return blockdev_nvme_reset((struct nvme_blockdev *)bdev_io->ctx,
@@ -287,6 +495,7 @@ blockdev_nvme_io_type_supported(struct spdk_bdev *bdev, enum spdk_bdev_io_type i
 {
 	struct nvme_blockdev *nbdev = (struct nvme_blockdev *)bdev;
 	const struct spdk_nvme_ctrlr_data *cdata;
+	uint32_t i;
 
 	switch (io_type) {
 	case SPDK_BDEV_IO_TYPE_READ:
@@ -296,28 +505,86 @@ blockdev_nvme_io_type_supported(struct spdk_bdev *bdev, enum spdk_bdev_io_type i
 		return true;
 
 	case SPDK_BDEV_IO_TYPE_UNMAP:
-		cdata = spdk_nvme_ctrlr_get_data(nbdev->ctrlr);
-		return cdata->oncs.dsm;
+		/* An unmap may be retried on any path, so every controller must support it. */
+		for (i = 0; i < nbdev->num_paths; i++) {
+			cdata = spdk_nvme_ctrlr_get_data(nbdev->paths[i].ctrlr);
+			if (!cdata->oncs.dsm) {
+				return false;
+			}
+		}
+		return true;
 
 	default:
 		return false;
 	}
 }
 
+static enum spdk_nvme_qprio
+blockdev_nvme_get_qprio(struct spdk_nvme_ctrlr *ctrlr, uint32_t priority)
+{
+	struct nvme_device *dev;
+
+	TAILQ_FOREACH(dev, &g_nvme_devices, tailq) {
+		if (dev->ctrlr == ctrlr) {
+			break;
+		}
+	}
+
+	/*
+	 * Round robin arbitration only accepts urgent queues, so every I/O channel
+	 *  priority shares the same arbitration class in that case.
+	 */
+	if (dev == NULL || dev->arb_mechanism != SPDK_NVME_CC_AMS_WRR) {
+		return SPDK_NVME_QPRIO_URGENT;
+	}
+
+	if (priority <= SPDK_IO_PRIORITY_URGENT) {
+		return SPDK_NVME_QPRIO_URGENT;
+	} else if (priority <= SPDK_IO_PRIORITY_HIGH) {
+		return SPDK_NVME_QPRIO_HIGH;
+	} else if (priority <= SPDK_IO_PRIORITY_DEFAULT) {
+		return SPDK_NVME_QPRIO_MEDIUM;
+	} else {
+		return SPDK_NVME_QPRIO_LOW;
+	}
+}
+
 static int
 blockdev_nvme_create_cb(void *io_device, uint32_t priority, void *ctx_buf, void *unique_ctx)
 {
 	struct spdk_nvme_ctrlr *ctrlr = io_device;
 	struct nvme_io_channel *ch = ctx_buf;
+	struct spdk_nvme_io_qpair_opts opts;
+	int intr_fd;
 
-	ch->qpair = spdk_nvme_ctrlr_alloc_io_qpair(ctrlr, 0);
+	/*
+	 * The I/O channel layer creates a separate channel for each priority, so each
+	 *  priority gets its own queue pair with the matching NVMe queue priority.
+	 */
+	spdk_nvme_ctrlr_get_default_io_qpair_opts(ctrlr, &opts);
+	opts.qprio = blockdev_nvme_get_qprio(ctrlr, priority);
+	if (g_io_queue_size > 0) {
+		opts.io_queue_size = g_io_queue_size;
+	}
+	if (g_io_queue_requests > 0) {
+		opts.io_queue_requests = g_io_queue_requests;
+	}
+	opts.latency_target_us = g_latency_target_us;
+	ch->qpair = spdk_nvme_ctrlr_alloc_io_qpair_with_opts(ctrlr, &opts);
 
 	if (ch->qpair == NULL) {
 		return -1;
 	}
 
-	spdk_poller_register(&ch->poller, blockdev_nvme_poll, ch->qpair,
-			     spdk_app_get_current_core(), NULL, 0);
+	intr_fd = spdk_nvme_qpair_get_interrupt_fd(ch->qpair);
+	if (intr_fd >= 0) {
+		spdk_poller_register_interrupt(&ch->poller, blockdev_nvme_poll, ch->qpair,
+					       spdk_app_get_current_core(), NULL, intr_fd,
+					       blockdev_nvme_poll_intr);
+	} else {
+		spdk_poller_register(&ch->poller, blockdev_nvme_poll, ch->qpair,
+				     spdk_app_get_current_core(), NULL, 0);
+	}
 	return 0;
 }
 
@@ -330,12 +597,79 @@ blockdev_nvme_destroy_cb(void *io_device, void *ctx_buf)
 	spdk_poller_unregister(&ch->poller, NULL);
 }
 
+static int
+blockdev_nvme_mp_create_cb(void *io_device, uint32_t priority, void *ctx_buf, void *unique_ctx)
+{
+	struct nvme_blockdev *nbdev = io_device;
+	struct nvme_mp_io_channel *ch = ctx_buf;
+	uint32_t i, num_channels = 0;
+
+	/*
+	 * A path whose controller cannot provide a queue pair is left without a
+	 *  channel and skipped, as long as at least one other path is usable.
+	 */
+	for (i = 0; i < nbdev->num_paths; i++) {
+		ch->path_ch[i] = spdk_get_io_channel(nbdev->paths[i].ctrlr, priority, false, NULL);
+		if (ch->path_ch[i] != NULL) {
+			num_channels++;
+		}
+	}
+
+	if (num_channels == 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+blockdev_nvme_mp_destroy_cb(void *io_device, void *ctx_buf)
+{
+	struct nvme_blockdev *nbdev = io_device;
+	struct nvme_mp_io_channel *ch = ctx_buf;
+	uint32_t i;
+
+	for (i = 0; i < nbdev->num_paths; i++) {
+		if (ch->path_ch[i] != NULL) {
+			spdk_put_io_channel(ch->path_ch[i]);
+		}
+	}
+}
+
 static struct spdk_io_channel *
 blockdev_nvme_get_io_channel(struct spdk_bdev *bdev, uint32_t priority)
 {
 	struct nvme_blockdev *nvme_bdev = (struct nvme_blockdev *)bdev;
 
-	return spdk_get_io_channel(nvme_bdev->ctrlr, priority, false, NULL);
+	if (nvme_bdev->num_paths > 1) {
+		return spdk_get_io_channel(nvme_bdev, priority, false, NULL);
+	}
+
+	return spdk_get_io_channel(nvme_bdev->paths[0].ctrlr, priority, false, NULL);
+}
+
+static void *
+blockdev_nvme_get_rbuf(struct spdk_bdev *bdev, uint64_t size)
+{
+	struct nvme_blockdev *nbdev = (struct nvme_blockdev *)bdev;
+
+	/*
+	 * A read buffer in one controller's memory buffer cannot follow the read
+	 *  to another path, so multipath blockdevs use host memory.
+	 */
+	if (!g_use_cmb_read_buffers || nbdev->num_paths > 1) {
+		return NULL;
+	}
+
+	return spdk_nvme_ctrlr_alloc_cmb_io_buffer(nbdev->paths[0].ctrlr, size);
+}
+
+static void
+blockdev_nvme_put_rbuf(struct spdk_bdev *bdev, void *buf, uint64_t size)
+{
+	struct nvme_blockdev *nbdev = (struct nvme_blockdev *)bdev;
+
+	spdk_nvme_ctrlr_free_cmb_io_buffer(nbdev->paths[0].ctrlr, buf, size);
 }
 
 static const struct spdk_bdev_fn_table nvmelib_fn_table = {
@@ -343,10 +677,13 @@ static const struct spdk_bdev_fn_table nvmelib_fn_table = {
 	.submit_request		= blockdev_nvme_submit_request,
 	.io_type_supported	= blockdev_nvme_io_type_supported,
 	.get_io_channel		= blockdev_nvme_get_io_channel,
+	.get_rbuf		= blockdev_nvme_get_rbuf,
+	.put_rbuf		= blockdev_nvme_put_rbuf,
 };
 
 struct nvme_probe_ctx {
 	int controllers_remaining;
+	enum spdk_nvme_cc_ams arb_mechanism;
 	int num_whitelist_controllers;
 	struct nvme_bdf_whitelist whitelist[NVME_MAX_CONTROLLERS];
 };
@@ -392,6 +729,9 @@ probe_cb(void *cb_ctx, struct spdk_pci_device *pci_dev, struct spdk_nvme_ctrlr_o
 		return false;
 	}
 
+	opts->arb_mechanism = ctx->arb_mechanism;
+	opts->enable_interrupts = g_enable_interrupts;
+
 	return true;
 }
 
@@ -410,12 +750,23 @@ attach_cb(void *cb_ctx, struct spdk_pci_device *pci_dev, struct spdk_nvme_ctrlr
 
 	dev->ctrlr = ctrlr;
 	dev->id = nvme_controller_index++;
+	dev->arb_mechanism = opts->arb_mechanism;
+	dev->adminq_poller = NULL;
 
-	nvme_ctrlr_initialize_blockdevs(dev->ctrlr, nvme_luns_per_ns, dev->id);
+	/* Fabrics controllers are attached without a PCI device */
+	nvme_ctrlr_initialize_blockdevs(dev->ctrlr, nvme_luns_per_ns, dev->id, pci_dev == NULL);
 	spdk_io_device_register(ctrlr, blockdev_nvme_create_cb, blockdev_nvme_destroy_cb,
 				sizeof(struct nvme_io_channel));
 	TAILQ_INSERT_TAIL(&g_nvme_devices, dev, tailq);
 
+	/*
+	 * Admin completions are processed by a timed poller of their own rather than by the
+	 *  I/O pollers, so asynchronous events and management commands never delay I/O.
+	 */
+	spdk_nvme_ctrlr_register_aer_callback(ctrlr, blockdev_nvme_aer_cb, dev);
+	spdk_poller_register(&dev->adminq_poller, blockdev_nvme_poll_adminq, ctrlr,
+			     spdk_app_get_current_core(), NULL, g_admin_poll_period_us);
+
 	if (ctx->controllers_remaining > 0) {
 		ctx->controllers_remaining--;
 	}
@@ -465,6 +816,56 @@ nvme_library_init(void)
 	 */
 	num_controllers = spdk_conf_section_get_intval(sp, "NumControllers");
 
+	val = spdk_conf_section_get_val(sp, "ArbitrationMechanism");
+	if (val != NULL) {
+		if (strcasecmp(val, "RR") == 0) {
+			g_arb_mechanism = SPDK_NVME_CC_AMS_RR;
+		} else if (strcasecmp(val, "WRR") == 0) {
+			g_arb_mechanism = SPDK_NVME_CC_AMS_WRR;
+		} else {
+			SPDK_ERRLOG("Invalid ArbitrationMechanism %s\n", val);
+			return -1;
+		}
+	}
+
+	val = spdk_conf_section_get_val(sp, "UseCmbReadBuffers");
+	if (val != NULL && !strcmp(val, "Yes")) {
+		g_use_cmb_read_buffers = true;
+	}
+
+	val = spdk_conf_section_get_val(sp, "InterruptMode");
+	if (val != NULL && !strcmp(val, "Yes")) {
+		g_enable_interrupts = true;
+	}
+
+	val = spdk_conf_section_get_val(sp, "MultipathPolicy");
+	if (val != NULL) {
+		if (strcasecmp(val, "RoundRobin") == 0) {
+			g_multipath_policy = NVME_MULTIPATH_ROUND_ROBIN;
+		} else if (strcasecmp(val, "LeastQueueDepth") == 0) {
+			g_multipath_policy = NVME_MULTIPATH_LEAST_QUEUE_DEPTH;
+		} else {
+			SPDK_ERRLOG("Invalid MultipathPolicy %s\n", val);
+			return -1;
+		}
+	}
+
+	g_io_queue_size = spdk_conf_section_get_intval(sp, "IoQueueSize");
+	if (g_io_queue_size < 0)
+		g_io_queue_size = 0;
+
+	g_io_queue_requests = spdk_conf_section_get_intval(sp, "IoQueueRequests");
+	if (g_io_queue_requests < 0)
+		g_io_queue_requests = 0;
+
+	g_latency_target_us = spdk_conf_section_get_intval(sp, "LatencyTargetUs");
+	if (g_latency_target_us < 0)
+		g_latency_target_us = 0;
+
+	g_admin_poll_period_us = spdk_conf_section_get_intval(sp, "AdminPollRate");
+	if (g_admin_poll_period_us <= 0)
+		g_admin_poll_period_us = NVME_DEFAULT_ADMIN_POLL_PERIOD_US;
+
 	/* Init the whitelist */
 	probe_ctx.num_whitelist_controllers = 0;
 
@@ -502,11 +903,68 @@ nvme_library_init(void)
 	}
 
 	probe_ctx.controllers_remaining = num_controllers;
+	probe_ctx.arb_mechanism = g_arb_mechanism;
 
-	if (spdk_nvme_probe(&probe_ctx, probe_cb, attach_cb, NULL)) {
+	rc = spdk_nvme_probe(&probe_ctx, probe_cb, attach_cb, NULL);
+	if (rc != 0 && probe_ctx.arb_mechanism == SPDK_NVME_CC_AMS_WRR) {
+		/*
+		 * Controllers that do not report WRR in CAP.AMS fail to enable.  Probe again with
+		 *  round robin; controllers attached by the first pass are skipped by the driver.
+		 */
+		SPDK_NOTICELOG("Retrying NVMe controllers without WRR support using round robin\n");
+		probe_ctx.arb_mechanism = SPDK_NVME_CC_AMS_RR;
+		rc = spdk_nvme_probe(&probe_ctx, probe_cb, attach_cb, NULL);
+	}
+	if (rc != 0) {
 		return -1;
 	}
 
+	/* Connect to the NVMe over Fabrics controllers listed by TransportID */
+	for (i = 0; ; i++) {
+		struct spdk_nvme_transport_id *trid;
+		struct spdk_nvme_ctrlr_opts opts;
+		struct spdk_nvme_ctrlr *ctrlr;
+
+		val = spdk_conf_section_get_nmval(sp, "TransportID", i, 0);
+		if (val == NULL) {
+			break;
+		}
+
+		if (g_num_nvme_trids == NVME_MAX_CONTROLLERS) {
+			SPDK_ERRLOG("Too many TransportID entries (max %d)\n", NVME_MAX_CONTROLLERS);
+			return -1;
+		}
+
+		trid = &g_nvme_trids[g_num_nvme_trids];
+		if (spdk_nvme_transport_id_parse(trid, val) != 0) {
+			SPDK_ERRLOG("Invalid TransportID: %s\n", val);
+			return -1;
+		}
+
+		spdk_nvme_ctrlr_opts_set_defaults(&opts);
+		ctrlr = spdk_nvme_connect(trid, &opts);
+		if (ctrlr == NULL) {
+			SPDK_ERRLOG("Could not connect to %s at %s:%s\n", trid->subnqn, trid->traddr,
+				    trid->trsvcid);
+			return -1;
+		}
+		g_num_nvme_trids++;
+
+		attach_cb(&probe_ctx, NULL, ctrlr, &opts);
+	}
+
+	/*
+	 * Paths are only known once every controller has been attached, so blockdevs
+	 *  spanning several controllers get their own I/O channels registered here.
+	 */
+	for (i = 0; i < blockdev_index_max; i++) {
+		if (g_blockdev[i].num_paths > 1) {
+			spdk_io_device_register(&g_blockdev[i], blockdev_nvme_mp_create_cb,
+						blockdev_nvme_mp_destroy_cb,
+						sizeof(struct nvme_mp_io_channel));
+		}
+	}
+
 	return 0;
 }
 
@@ -518,13 +976,71 @@ nvme_library_fini(void)
 	while (!TAILQ_EMPTY(&g_nvme_devices)) {
 		dev = TAILQ_FIRST(&g_nvme_devices);
 		TAILQ_REMOVE(&g_nvme_devices, dev, tailq);
+		spdk_poller_unregister(&dev->adminq_poller, NULL);
 		spdk_nvme_detach(dev->ctrlr);
 		free(dev);
 	}
 }
 
+static bool
+nvme_ns_same_identifier(struct spdk_nvme_ns *ns1, struct spdk_nvme_ns *ns2)
+{
+	const struct spdk_nvme_ns_data *nsdata1 = spdk_nvme_ns_get_data(ns1);
+	const struct spdk_nvme_ns_data *nsdata2 = spdk_nvme_ns_get_data(ns2);
+	static const uint8_t zero_nguid[sizeof(nsdata1->nguid)];
+
+	if (memcmp(nsdata1->nguid, zero_nguid, sizeof(zero_nguid)) != 0) {
+		return memcmp(nsdata1->nguid, nsdata2->nguid, sizeof(nsdata1->nguid)) == 0;
+	}
+
+	if (nsdata1->eui64 != 0) {
+		return nsdata1->eui64 == nsdata2->eui64;
+	}
+
+	/* Namespaces without a globally unique identifier are never grouped. */
+	return false;
+}
+
+/*
+ * Find an existing blockdev covering the same LBA range of the same namespace
+ *  through another controller.
+ */
+static struct nvme_blockdev *
+nvme_find_blockdev_path(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_ns *ns,
+			uint64_t lba_start, uint64_t lba_end)
+{
+	struct nvme_blockdev *bdev;
+	uint32_t i;
+	int idx;
+
+	for (idx = 0; idx < blockdev_index_max; idx++) {
+		bdev = &g_blockdev[idx];
+
+		if (bdev->lba_start != lba_start || bdev->lba_end != lba_end ||
+		    bdev->blocklen != spdk_nvme_ns_get_sector_size(ns)) {
+			continue;
+		}
+
+		for (i = 0; i < bdev->num_paths; i++) {
+			if (bdev->paths[i].ctrlr == ctrlr) {
+				break;
+			}
+		}
+		if (i != bdev->num_paths) {
+			continue;
+		}
+
+		if (nvme_ns_same_identifier(bdev->paths[0].ns, ns)) {
+			return bdev;
+		}
+	}
+
+	return NULL;
+}
+
 void
-nvme_ctrlr_initialize_blockdevs(struct spdk_nvme_ctrlr *ctrlr, int bdev_per_ns, int ctrlr_id)
+nvme_ctrlr_initialize_blockdevs(struct spdk_nvme_ctrlr *ctrlr, int bdev_per_ns, int ctrlr_id,
+				bool contig_payload)
 {
 	struct nvme_blockdev	*bdev;
 	struct spdk_nvme_ns	*ns;
@@ -556,12 +1072,34 @@ nvme_ctrlr_initialize_blockdevs(struct spdk_nvme_ctrlr *ctrlr, int bdev_per_ns,
 
 		lba_offset = 0;
 		for (bdev_idx = 0; bdev_idx < bdev_per_ns; bdev_idx++) {
+			bdev = nvme_find_blockdev_path(ctrlr, ns, lba_offset, lba_offset + bdev_size - 1);
+			if (bdev != NULL && bdev->num_paths < NVME_MAX_PATHS) {
+				SPDK_NOTICELOG("Nvme%dn%dp%d is another path to %s\n",
+					       ctrlr_id, spdk_nvme_ns_get_id(ns), bdev_idx, bdev->disk.name);
+				bdev->paths[bdev->num_paths].ctrlr = ctrlr;
+				bdev->paths[bdev->num_paths].ns = ns;
+				bdev->paths[bdev->num_paths].contig_payload = contig_payload;
+				bdev->num_paths++;
+				if (!cdata->oncs.dsm) {
+					bdev->disk.thin_provisioning = 0;
+					bdev->disk.max_unmap_bdesc_count = 0;
+				}
+				/* A stream is only usable if every path can place data in it. */
+				if (spdk_nvme_ns_get_max_write_streams(ns) < bdev->disk.max_write_streams) {
+					bdev->disk.max_write_streams = spdk_nvme_ns_get_max_write_streams(ns);
+				}
+				lba_offset += bdev_size;
+				continue;
+			}
+
 			if (blockdev_index_max >= NVME_MAX_BLOCKDEVS)
 				return;
 
 			bdev = &g_blockdev[blockdev_index_max];
-			bdev->ctrlr = ctrlr;
-			bdev->ns = ns;
+			bdev->paths[0].ctrlr = ctrlr;
+			bdev->paths[0].ns = ns;
+			bdev->paths[0].contig_payload = contig_payload;
+			bdev->num_paths = 1;
 			bdev->lba_start = lba_offset;
 			bdev->lba_end = lba_offset + bdev_size - 1;
 			lba_offset += bdev_size;
@@ -582,6 +1120,7 @@ nvme_ctrlr_initialize_blockdevs(struct spdk_nvme_ctrlr *ctrlr, int bdev_per_ns,
 					NVME_DEFAULT_MAX_UNMAP_BDESC_COUNT;
 			}
 			bdev->disk.write_cache = 1;
+			bdev->disk.max_write_streams = spdk_nvme_ns_get_max_write_streams(ns);
 			bdev->blocklen = spdk_nvme_ns_get_sector_size(ns);
 			bdev->disk.blocklen = bdev->blocklen;
 			bdev->disk.blockcnt = bdev->lba_end - bdev->lba_start + 1;
@@ -594,30 +1133,134 @@ nvme_ctrlr_initialize_blockdevs(struct spdk_nvme_ctrlr *ctrlr, int bdev_per_ns,
 	}
 }
 
+/*
+ * Errors that say nothing about the I/O itself, only that the path it was sent down
+ *  went away, are worth retrying on another path.
+ */
+static bool
+blockdev_nvme_is_path_error(struct nvme_blockdev *nbdev, uint32_t path,
+			    const struct spdk_nvme_cpl *cpl)
+{
+	if (spdk_nvme_ctrlr_is_failed(nbdev->paths[path].ctrlr)) {
+		return true;
+	}
+
+	return cpl->status.sct == SPDK_NVME_SCT_GENERIC &&
+	       (cpl->status.sc == SPDK_NVME_SC_ABORTED_BY_REQUEST ||
+		cpl->status.sc == SPDK_NVME_SC_ABORTED_SQ_DELETION);
+}
+
+/* Copy between the iovecs of an I/O and its bounce buffer. */
+static void
+blockdev_nvme_copy_bounce_buf(struct nvme_blockio *bio, bool to_bounce_buf)
+{
+	uint8_t *buf = bio->bounce_buf;
+	uint64_t remaining = bio->bounce_len;
+	size_t len;
+	int i;
+
+	for (i = 0; i < bio->iovcnt && remaining > 0; i++) {
+		len = bio->iovs[i].iov_len < remaining ? bio->iovs[i].iov_len : remaining;
+		if (to_bounce_buf) {
+			memcpy(buf, bio->iovs[i].iov_base, len);
+		} else {
+			memcpy(bio->iovs[i].iov_base, buf, len);
+		}
+		buf += len;
+		remaining -= len;
+	}
+}
+
 static void
 queued_done(void *ref, const struct spdk_nvme_cpl *cpl)
 {
 	struct nvme_blockio *bio = ref;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
 	enum spdk_bdev_io_status status;
 
+	if (bio->bounce_buf != NULL) {
+		if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ && !spdk_nvme_cpl_is_error(cpl)) {
+			blockdev_nvme_copy_bounce_buf(bio, false);
+		}
+		free(bio->bounce_buf);
+		bio->bounce_buf = NULL;
+	}
+
+	if (bio->mp_ch != NULL) {
+		bio->mp_ch->outstanding[bio->path]--;
+
+		if (spdk_nvme_cpl_is_error(cpl) &&
+		    blockdev_nvme_is_path_error(bdev_io->ctx, bio->path, cpl)) {
+			SPDK_TRACELOG(SPDK_TRACE_BDEV_NVME, "I/O failed on path %u, retrying\n",
+				      bio->path);
+			((struct nvme_blockdev *)bdev_io->ctx)->reset_path = bio->path;
+			if (blockdev_nvme_submit_multipath(bdev_io) == 0) {
+				return;
+			}
+		}
+	}
+
 	if (spdk_nvme_cpl_is_error(cpl)) {
 		status = SPDK_BDEV_IO_STATUS_FAILED;
 	} else {
 		status = SPDK_BDEV_IO_STATUS_SUCCESS;
 	}
 
-	spdk_bdev_io_complete(spdk_bdev_io_from_ctx(bio), status);
+	spdk_bdev_io_complete(bdev_io, status);
+}
+
+static void
+queued_reset_sgl(void *ref, uint32_t sgl_offset)
+{
+	struct nvme_blockio *bio = ref;
+	struct iovec *iov;
+
+	bio->iov_offset = sgl_offset;
+	for (bio->iovpos = 0; bio->iovpos < bio->iovcnt; bio->iovpos++) {
+		iov = &bio->iovs[bio->iovpos];
+		if (bio->iov_offset < iov->iov_len)
+			break;
+
+		bio->iov_offset -= iov->iov_len;
+	}
+}
+
+static int
+queued_next_sge(void *ref, uint64_t *address, uint32_t *length)
+{
+	struct nvme_blockio *bio = ref;
+	struct iovec *iov;
+
+	assert(bio->iovpos < bio->iovcnt);
+
+	iov = &bio->iovs[bio->iovpos];
+	bio->iovpos++;
+
+	*address = spdk_vtophys(iov->iov_base);
+	*length = iov->iov_len;
+
+	if (bio->iov_offset) {
+		assert(bio->iov_offset <= iov->iov_len);
+		*address += bio->iov_offset;
+		*length -= bio->iov_offset;
+		bio->iov_offset = 0;
+	}
+
+	return 0;
 }
 
 int
-nvme_queue_cmd(struct nvme_blockdev *bdev, struct spdk_nvme_qpair *qpair,
-	       struct nvme_blockio *bio,
-	       int direction, void *buf, uint64_t nbytes, uint64_t offset)
+nvme_queue_cmd(struct nvme_blockdev *bdev, struct spdk_nvme_ns *ns,
+	       struct spdk_nvme_qpair *qpair, struct nvme_blockio *bio,
+	       int direction, struct iovec *iov, int iovcnt, uint64_t nbytes,
+	       uint64_t offset)
 {
-	uint32_t ss = spdk_nvme_ns_get_sector_size(bdev->ns);
+	uint32_t ss = spdk_nvme_ns_get_sector_size(ns);
 	uint32_t lba_count;
 	uint64_t relative_lba = offset / bdev->blocklen;
 	uint64_t next_lba = relative_lba + bdev->lba_start;
+	struct spdk_bdev_io_hints *hints = &spdk_bdev_io_from_ctx(bio)->hints;
+	uint8_t dsm;
 	int rc;
 
 	if (nbytes % ss) {
@@ -628,12 +1271,65 @@ nvme_queue_cmd(struct nvme_blockdev *bdev, struct spdk_nvme_qpair *qpair,
 
 	lba_count = nbytes / ss;
 
-	if (direction == BDEV_DISK_READ) {
-		rc = spdk_nvme_ns_cmd_read(bdev->ns, qpair, buf, next_lba,
-					   lba_count, queued_done, bio, 0);
+	/* The blockdev access frequency values match the NVMe dataset management encoding. */
+	dsm = hints->access_freq & SPDK_NVME_IO_DSM_ACCESS_FREQ_MASK;
+	if (hints->sequential) {
+		dsm |= SPDK_NVME_IO_DSM_SEQUENTIAL_REQUEST;
+	}
+
+	if (iovcnt > 1 && bdev->paths[bio->path].contig_payload) {
+		/* Fabrics transports only carry contiguous payloads, so copy through a buffer */
+		bio->iovs = iov;
+		bio->iovcnt = iovcnt;
+		bio->bounce_len = nbytes;
+		bio->bounce_buf = malloc(nbytes);
+		if (bio->bounce_buf == NULL) {
+			SPDK_ERRLOG("Could not allocate a bounce buffer\n");
+			return -1;
+		}
+
+		if (direction == BDEV_DISK_READ) {
+			rc = spdk_nvme_ns_cmd_read_with_hints(ns, qpair, bio->bounce_buf, next_lba,
+							      lba_count, queued_done, bio, 0, dsm);
+		} else {
+			blockdev_nvme_copy_bounce_buf(bio, true);
+			rc = spdk_nvme_ns_cmd_write_with_hints(ns, qpair, bio->bounce_buf, next_lba,
+							       lba_count, queued_done, bio, 0, dsm,
+							       hints->write_stream);
+		}
+
+		if (rc != 0) {
+			free(bio->bounce_buf);
+			bio->bounce_buf = NULL;
+		}
+	} else if (iovcnt > 1) {
+		/* Scattered payloads go through the SGL callbacks */
+		bio->iovs = iov;
+		bio->iovcnt = iovcnt;
+		bio->iovpos = 0;
+		bio->iov_offset = 0;
+
+		if (direction == BDEV_DISK_READ) {
+			rc = spdk_nvme_ns_cmd_readv_with_hints(ns, qpair, next_lba, lba_count, queued_done,
+							       bio, 0, queued_reset_sgl, queued_next_sge,
+							       dsm);
+		} else {
+			rc = spdk_nvme_ns_cmd_writev_with_hints(ns, qpair, next_lba, lba_count, queued_done,
+								bio, 0, queued_reset_sgl, queued_next_sge,
+								dsm, hints->write_stream);
+		}
+	} else if (iovcnt == 1 && iov->iov_len >= nbytes) {
+		if (direction == BDEV_DISK_READ) {
+			rc = spdk_nvme_ns_cmd_read_with_hints(ns, qpair, iov->iov_base, next_lba,
+							      lba_count, queued_done, bio, 0, dsm);
+		} else {
+			rc = spdk_nvme_ns_cmd_write_with_hints(ns, qpair, iov->iov_base, next_lba,
+							       lba_count, queued_done, bio, 0, dsm,
+							       hints->write_stream);
+		}
 	} else {
-		rc = spdk_nvme_ns_cmd_write(bdev->ns, qpair, buf, next_lba,
-					    lba_count, queued_done, bio, 0);
+		SPDK_ERRLOG("IO buffer too small\n");
+		return -1;
 	}
 
 	if (rc != 0) {
@@ -643,12 +1339,11 @@ nvme_queue_cmd(struct nvme_blockdev *bdev, struct spdk_nvme_qpair *qpair,
 }
 
 static int
-blockdev_nvme_unmap(struct nvme_blockdev *nbdev, struct spdk_io_channel *ch,
-		    struct nvme_blockio *bio,
+blockdev_nvme_unmap(struct nvme_blockdev *nbdev, struct spdk_nvme_ns *ns,
+		    struct spdk_nvme_qpair *qpair, struct nvme_blockio *bio,
 		    struct spdk_scsi_unmap_bdesc *unmap_d,
 		    uint16_t bdesc_count)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
 	int rc = 0, i;
 	struct spdk_nvme_dsm_range dsm_range[NVME_DEFAULT_MAX_UNMAP_BDESC_COUNT];
 
@@ -663,7 +1358,7 @@ blockdev_nvme_unmap(struct nvme_blockdev *nbdev, struct spdk_io_channel *ch,
 		unmap_d++;
 	}
 
-	rc = spdk_nvme_ns_cmd_dataset_management(nbdev->ns, nvme_ch->qpair,
+	rc = spdk_nvme_ns_cmd_dataset_management(ns, qpair,
 			SPDK_NVME_DSM_ATTR_DEALLOCATE,
 			dsm_range, bdesc_count,
 			queued_done, bio);
@@ -677,6 +1372,8 @@ blockdev_nvme_unmap(struct nvme_blockdev *nbdev, struct spdk_io_channel *ch,
 static void
 blockdev_nvme_get_spdk_running_config(FILE *fp)
 {
+	int i;
+
 	fprintf(fp,
 		"\n"
 		"# Users may change this to partition an NVMe namespace into multiple LUNs.\n"
@@ -689,6 +1386,38 @@ blockdev_nvme_get_spdk_running_config(FILE *fp)
 	if (LunSizeInMB != 0) {
 		fprintf(fp, "  LunSizeInMB %d\n", LunSizeInMB);
 	}
+	if (g_arb_mechanism == SPDK_NVME_CC_AMS_WRR) {
+		fprintf(fp, "  ArbitrationMechanism WRR\n");
+	}
+	if (g_use_cmb_read_buffers) {
+		fprintf(fp, "  UseCmbReadBuffers Yes\n");
+	}
+	if (g_enable_interrupts) {
+		fprintf(fp, "  InterruptMode Yes\n");
+	}
+	if (g_multipath_policy == NVME_MULTIPATH_LEAST_QUEUE_DEPTH) {
+		fprintf(fp, "  MultipathPolicy LeastQueueDepth\n");
+	}
+	if (g_io_queue_size != 0) {
+		fprintf(fp, "  IoQueueSize %d\n", g_io_queue_size);
+	}
+	if (g_io_queue_requests != 0) {
+		fprintf(fp, "  IoQueueRequests %d\n", g_io_queue_requests);
+	}
+	if (g_latency_target_us != 0) {
+		fprintf(fp, "  LatencyTargetUs %d\n", g_latency_target_us);
+	}
+	if (g_admin_poll_period_us != NVME_DEFAULT_ADMIN_POLL_PERIOD_US) {
+		fprintf(fp, "  AdminPollRate %d\n", g_admin_poll_period_us);
+	}
+	for (i = 0; i < g_num_nvme_trids; i++) {
+		fprintf(fp, "  TransportID \"trtype:TCP traddr:%s trsvcid:%s", g_nvme_trids[i].traddr,
+			g_nvme_trids[i].trsvcid);
+		if (g_nvme_trids[i].subnqn[0] != '\0') {
+			fprintf(fp, " subnqn:%s", g_nvme_trids[i].subnqn);
+		}
+		fprintf(fp, "\"\n");
+	}
 }
 
 SPDK_LOG_REGISTER_TRACE_FLAG("bdev_nvme", SPDK_TRACE_BDEV_NVME)
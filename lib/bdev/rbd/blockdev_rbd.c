@@ -74,6 +74,11 @@ struct blockdev_rbd_io {
 	rbd_cb_fn_t cb_fn;
 	struct blockdev_rbd_io_channel *ch;
 	struct blockdev_rbd_io *next;
+
+	/* Without librbd iovec support, scattered data goes through a bounce buffer */
+	void *bounce_buf;
+	struct iovec *iovs;
+	int iovcnt;
 };
 
 struct blockdev_rbd {
@@ -208,29 +213,134 @@ blockdev_rbd_finish_aiocb(rbd_completion_t cb, void *arg)
 	pthread_mutex_unlock(&ch->lock);
 }
 
+static size_t
+blockdev_rbd_iov_len(struct iovec *iov, int iovcnt)
+{
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		len += iov[i].iov_len;
+	}
+
+	return len;
+}
+
+/*
+ * Return the buffer to hand to librbd for iov. Scattered data is gathered into
+ * a bounce buffer, which blockdev_rbd_io_done() scatters and frees for reads.
+ * Only used when librbd cannot take the iovec itself.
+ */
+static void *
+blockdev_rbd_get_buf(struct blockdev_rbd_io *cmd, struct iovec *iov, int iovcnt, size_t len)
+{
+	size_t copied = 0;
+	int i;
+
+	if (iovcnt == 1) {
+		return iov[0].iov_len >= len ? iov[0].iov_base : NULL;
+	}
+
+	if (blockdev_rbd_iov_len(iov, iovcnt) < len) {
+		return NULL;
+	}
+
+	cmd->bounce_buf = malloc(len);
+	if (cmd->bounce_buf == NULL) {
+		return NULL;
+	}
+
+	if (cmd->direction == BLOCKDEV_RBD_WRITE) {
+		for (i = 0; i < iovcnt && copied < len; i++) {
+			size_t n = iov[i].iov_len < len - copied ? iov[i].iov_len : len - copied;
+
+			memcpy((uint8_t *)cmd->bounce_buf + copied, iov[i].iov_base, n);
+			copied += n;
+		}
+	}
+
+	return cmd->bounce_buf;
+}
+
+static void
+blockdev_rbd_io_done(struct blockdev_rbd_io *cmd)
+{
+	size_t copied = 0;
+	int i;
+
+	if (cmd->bounce_buf == NULL) {
+		return;
+	}
+
+	if (cmd->direction == BLOCKDEV_RBD_READ && cmd->status == 0) {
+		for (i = 0; i < cmd->iovcnt && copied < cmd->len; i++) {
+			size_t n = cmd->iovs[i].iov_len < cmd->len - copied ?
+				   cmd->iovs[i].iov_len : cmd->len - copied;
+
+			memcpy(cmd->iovs[i].iov_base, (uint8_t *)cmd->bounce_buf + copied, n);
+			copied += n;
+		}
+	}
+
+	free(cmd->bounce_buf);
+	cmd->bounce_buf = NULL;
+}
+
 static int
 blockdev_rbd_start_aio(rbd_image_t image, struct blockdev_rbd_io *cmd,
-		       void *buf, uint64_t offset, size_t len)
+		       struct iovec *iov, int iovcnt, uint64_t offset, size_t len)
 {
+	void *buf = NULL;
+	bool vectored = false;
 	int ret;
 
+	cmd->bounce_buf = NULL;
+	cmd->iovs = iov;
+	cmd->iovcnt = iovcnt;
+
+#ifdef LIBRBD_SUPPORTS_IOVEC
+	/* Newer librbd takes the iovec directly, so no data is copied */
+	vectored = iovcnt > 1 && blockdev_rbd_iov_len(iov, iovcnt) == len;
+#endif
+
+	if (!vectored) {
+		buf = blockdev_rbd_get_buf(cmd, iov, iovcnt, len);
+		if (buf == NULL) {
+			return -1;
+		}
+	}
+
 	ret = rbd_aio_create_completion((void *)cmd, blockdev_rbd_finish_aiocb,
 					&cmd->completion);
 	if (ret < 0) {
+		free(cmd->bounce_buf);
+		cmd->bounce_buf = NULL;
 		return -1;
 	}
 
 	if (cmd->direction == BLOCKDEV_RBD_READ) {
-		ret = rbd_aio_read(image, offset, len,
-				   buf, cmd->completion);
+#ifdef LIBRBD_SUPPORTS_IOVEC
+		if (vectored) {
+			ret = rbd_aio_readv(image, iov, iovcnt, offset, cmd->completion);
+		} else
+#endif
+			ret = rbd_aio_read(image, offset, len,
+					   buf, cmd->completion);
 
 	} else if (cmd->direction == BLOCKDEV_RBD_WRITE) {
-		ret = rbd_aio_write(image, offset, len,
-				    buf, cmd->completion);
+#ifdef LIBRBD_SUPPORTS_IOVEC
+		if (vectored) {
+			ret = rbd_aio_writev(image, iov, iovcnt, offset, cmd->completion);
+		} else
+#endif
+			ret = rbd_aio_write(image, offset, len,
+					    buf, cmd->completion);
 	}
 
 	if (ret < 0) {
 		rbd_aio_release(cmd->completion);
+		free(cmd->bounce_buf);
+		cmd->bounce_buf = NULL;
 		return -1;
 	}
 
@@ -250,17 +360,17 @@ SPDK_BDEV_MODULE_REGISTER(blockdev_rbd_library_init, blockdev_rbd_library_fini,
 			  blockdev_rbd_get_ctx_size)
 
 static int64_t
-blockdev_rbd_read(struct blockdev_rbd *disk, struct spdk_io_channel *ch,
-		  struct blockdev_rbd_io *cmd, void *buf, size_t nbytes,
-		  uint64_t offset)
+blockdev_rbd_readv(struct blockdev_rbd *disk, struct spdk_io_channel *ch,
+		   struct blockdev_rbd_io *cmd, struct iovec *iov,
+		   int iovcnt, size_t len, uint64_t offset)
 {
 	struct blockdev_rbd_io_channel *rbdio_ch = spdk_io_channel_get_ctx(ch);
 
 	cmd->ch = rbdio_ch;
 	cmd->direction = BLOCKDEV_RBD_READ;
-	cmd->len = nbytes;
+	cmd->len = len;
 
-	return blockdev_rbd_start_aio(rbdio_ch->image, cmd, buf, offset, nbytes);
+	return blockdev_rbd_start_aio(rbdio_ch->image, cmd, iov, iovcnt, offset, len);
 }
 
 static int64_t
@@ -270,13 +380,11 @@ blockdev_rbd_writev(struct blockdev_rbd *disk, struct spdk_io_channel *ch,
 {
 	struct blockdev_rbd_io_channel *rbdio_ch = spdk_io_channel_get_ctx(ch);
 
-	if ((iovcnt != 1) || (iov->iov_len != len))
-		return -1;
-
 	cmd->ch = (void *)rbdio_ch;
 	cmd->direction = BLOCKDEV_RBD_WRITE;
+	cmd->len = len;
 
-	return blockdev_rbd_start_aio(rbdio_ch->image, cmd, (void *)iov->iov_base, offset, len);
+	return blockdev_rbd_start_aio(rbdio_ch->image, cmd, iov, iovcnt, offset, len);
 }
 
 static int
@@ -289,12 +397,13 @@ static void blockdev_rbd_get_rbuf_cb(struct spdk_bdev_io *bdev_io)
 {
 	int ret;
 
-	ret = blockdev_rbd_read(bdev_io->ctx,
-				bdev_io->ch,
-				(struct blockdev_rbd_io *)bdev_io->driver_ctx,
-				bdev_io->u.read.buf,
-				bdev_io->u.read.nbytes,
-				bdev_io->u.read.offset);
+	ret = blockdev_rbd_readv(bdev_io->ctx,
+				 bdev_io->ch,
+				 (struct blockdev_rbd_io *)bdev_io->driver_ctx,
+				 bdev_io->u.read.iovs,
+				 bdev_io->u.read.iovcnt,
+				 bdev_io->u.read.nbytes,
+				 bdev_io->u.read.offset);
 
 	if (ret != 0) {
 		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
@@ -358,6 +467,7 @@ blockdev_rbd_io_poll(void *arg)
 	*req_head = NULL;
 	while (req != NULL) {
 		req_next = req->next;
+		blockdev_rbd_io_done(req);
 		status = req->status == 0 ? SPDK_BDEV_IO_STATUS_SUCCESS : SPDK_BDEV_IO_STATUS_FAILED;
 		spdk_bdev_io_complete(spdk_bdev_io_from_ctx(req), status);
 		req = req_next;
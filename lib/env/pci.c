@@ -31,6 +31,7 @@
  *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -44,6 +45,7 @@
 #include <stdbool.h>
 
 #include <rte_config.h>
+#include <rte_interrupts.h>
 #include <rte_pci.h>
 #include <rte_version.h>
 
@@ -53,6 +55,11 @@
 #include <sys/pciio.h>
 #endif
 
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/vfio.h>
+#endif
+
 #include "spdk/env.h"
 #include "spdk/pci_ids.h"
 
@@ -189,6 +196,12 @@ spdk_pci_enumerate(enum spdk_pci_device_type type,
 	return rc;
 }
 
+int
+spdk_pci_scan(void)
+{
+	return rte_eal_pci_scan();
+}
+
 int
 spdk_pci_device_map_bar(struct spdk_pci_device *device, uint32_t bar,
 			void **mapped_addr, uint64_t *phys_addr, uint64_t *size)
@@ -208,6 +221,111 @@ spdk_pci_device_unmap_bar(struct spdk_pci_device *device, uint32_t bar, void *ad
 	return 0;
 }
 
+int
+spdk_pci_device_enable_interrupts(struct spdk_pci_device *dev, uint32_t num_vectors)
+{
+	struct rte_intr_handle *intr_handle = &dev->intr_handle;
+	uint32_t nb_efd;
+
+	/*
+	 * Per-vector eventfds are only available through VFIO MSI-X.  DPDK routes vector 0
+	 *  to intr_handle->fd and vectors 1..nb_efd to the efds[] array.
+	 */
+	if (intr_handle->type != RTE_INTR_HANDLE_VFIO_MSIX) {
+		return -ENOTSUP;
+	}
+
+	if (num_vectors == 0) {
+		return -EINVAL;
+	}
+
+	nb_efd = num_vectors - 1;
+	if (nb_efd > RTE_MAX_RXTX_INTR_VEC_ID) {
+		nb_efd = RTE_MAX_RXTX_INTR_VEC_ID;
+	}
+
+	if (rte_intr_efd_enable(intr_handle, nb_efd) != 0) {
+		return -ENOMEM;
+	}
+
+	if (rte_intr_enable(intr_handle) != 0) {
+		rte_intr_efd_disable(intr_handle);
+		return -EIO;
+	}
+
+	return nb_efd + 1;
+}
+
+void
+spdk_pci_device_disable_interrupts(struct spdk_pci_device *dev)
+{
+	struct rte_intr_handle *intr_handle = &dev->intr_handle;
+
+	if (intr_handle->type != RTE_INTR_HANDLE_VFIO_MSIX) {
+		return;
+	}
+
+	rte_intr_disable(intr_handle);
+	rte_intr_efd_disable(intr_handle);
+}
+
+int
+spdk_pci_device_get_interrupt_fd(struct spdk_pci_device *dev, uint32_t vector)
+{
+	struct rte_intr_handle *intr_handle = &dev->intr_handle;
+
+	if (intr_handle->type != RTE_INTR_HANDLE_VFIO_MSIX || intr_handle->nb_efd == 0) {
+		return -1;
+	}
+
+	if (vector == 0) {
+		return intr_handle->fd;
+	} else if (vector <= intr_handle->nb_efd) {
+		return intr_handle->efds[vector - 1];
+	}
+
+	return -1;
+}
+
+int
+spdk_pci_device_mask_interrupt(struct spdk_pci_device *dev, uint32_t vector, bool mask)
+{
+#ifdef __linux__
+	struct rte_intr_handle *intr_handle = &dev->intr_handle;
+	char irq_set_buf[sizeof(struct vfio_irq_set) + sizeof(int)];
+	struct vfio_irq_set *irq_set = (struct vfio_irq_set *)irq_set_buf;
+	int fd;
+
+	fd = spdk_pci_device_get_interrupt_fd(dev, vector);
+	if (fd < 0) {
+		return -EINVAL;
+	}
+
+	/*
+	 * VFIO does not let user space touch the MSI-X table, so mask a vector by detaching
+	 *  its eventfd (the kernel masks the vector when it releases the IRQ) and unmask it
+	 *  by attaching the eventfd again.
+	 */
+	irq_set->argsz = sizeof(irq_set_buf);
+	irq_set->flags = VFIO_IRQ_SET_DATA_EVENTFD | VFIO_IRQ_SET_ACTION_TRIGGER;
+	irq_set->index = VFIO_PCI_MSIX_IRQ_INDEX;
+	irq_set->start = vector;
+	irq_set->count = 1;
+	if (mask) {
+		fd = -1;
+	}
+	memcpy(irq_set->data, &fd, sizeof(fd));
+
+	if (ioctl(intr_handle->vfio_dev_fd, VFIO_DEVICE_SET_IRQS, irq_set) != 0) {
+		return -errno;
+	}
+
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
 static int
 pci_device_get_u32(struct spdk_pci_device *dev, const char *file, uint32_t *val)
 {
@@ -34,12 +34,15 @@
 #include "spdk/event.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
 
 #ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/prctl.h>
 #endif
 
@@ -54,6 +57,8 @@
 
 #include "reactor.h"
 
+#include "spdk/barrier.h"
+#include "spdk/likely.h"
 #include "spdk/log.h"
 #include "spdk/io_channel.h"
 
@@ -61,6 +66,14 @@
 
 #define SPDK_REACTOR_SPIN_TIME_US	1
 
+/*
+ * How long all of a reactor's pollers must have been idle before it stops polling and waits
+ *  for interrupts.  Any work found resets the timer, so a reactor under load never blocks.
+ */
+#define SPDK_REACTOR_INTR_IDLE_TIME_US	1000
+
+#define SPDK_REACTOR_MAX_INTR_EVENTS	16
+
 enum spdk_poller_state {
 	/* The poller is registered with a reactor but not currently executing its fn. */
 	SPDK_POLLER_STATE_WAITING,
@@ -84,6 +97,10 @@ struct spdk_poller {
 	spdk_poller_fn			fn;
 	void				*arg;
 
+	/* File descriptor that becomes readable when the poller has work, or -1. */
+	int				intr_fd;
+	spdk_poller_intr_fn		intr_fn;
+
 	struct spdk_event		*unregister_complete_event;
 };
 
@@ -115,6 +132,21 @@ struct spdk_reactor {
 	struct rte_ring					*events;
 
 	uint64_t					max_delay_us;
+
+	/*
+	 * Interrupt mode.  The interrupt file descriptors of pollers registered with
+	 *  spdk_poller_register_interrupt() are added to epfd along with event_fd, which
+	 *  spdk_event_call() signals while the reactor is blocked in epoll_wait().
+	 *  The reactor only blocks while every active poller has an interrupt file descriptor.
+	 */
+	int						epfd;
+	int						event_fd;
+	volatile bool					intr_waiting;
+	uint32_t					num_active_pollers;
+	uint32_t					num_intr_pollers;
+
+	/* Set by spdk_poller_set_busy() while an interrupt poller runs. */
+	bool						poller_busy;
 };
 
 static struct spdk_reactor g_reactors[RTE_MAX_LCORE];
@@ -173,6 +205,18 @@ spdk_event_free(uint32_t lcore, struct spdk_event *event)
 	rte_mempool_put(g_spdk_event_mempool[socket_id], (void *)event);
 }
 
+static void
+_spdk_reactor_wakeup(struct spdk_reactor *reactor)
+{
+	uint64_t one = 1;
+
+	if (reactor->event_fd >= 0) {
+		if (write(reactor->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+			SPDK_ERRLOG("failed to wake reactor %u\n", reactor->lcore);
+		}
+	}
+}
+
 void
 spdk_event_call(spdk_event_t event)
 {
@@ -186,6 +230,17 @@ spdk_event_call(spdk_event_t event)
 	if (rc != 0) {
 		assert(false);
 	}
+
+	/*
+	 * Wake the reactor if it is blocked waiting for interrupts.  Only reactors with
+	 *  interrupt pollers can block, so other reactors skip the barrier.
+	 */
+	if (spdk_unlikely(reactor->num_intr_pollers != 0)) {
+		spdk_mb();
+		if (reactor->intr_waiting) {
+			_spdk_reactor_wakeup(reactor);
+		}
+	}
 }
 
 static uint32_t
@@ -291,6 +346,19 @@ spdk_poller_insert_timer(struct spdk_reactor *reactor, struct spdk_poller *polle
 static void
 _spdk_poller_unregister_complete(struct spdk_poller *poller)
 {
+	struct spdk_reactor *reactor = spdk_reactor_get(poller->lcore);
+
+	if (poller->period_ticks == 0) {
+		reactor->num_active_pollers--;
+	}
+
+	if (poller->intr_fd >= 0) {
+#ifdef __linux__
+		epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, poller->intr_fd, NULL);
+#endif
+		reactor->num_intr_pollers--;
+	}
+
 	if (poller->unregister_complete_event) {
 		spdk_event_call(poller->unregister_complete_event);
 	}
@@ -298,6 +366,107 @@ _spdk_poller_unregister_complete(struct spdk_poller *poller)
 	free(poller);
 }
 
+/*
+ * Run the poller at the head of the active list and move it to the tail.
+ *  Returns false only if it was an interrupt poller that found no work.
+ */
+static bool
+_spdk_reactor_run_active_poller(struct spdk_reactor *reactor)
+{
+	struct spdk_poller	*poller;
+	bool			busy;
+
+	poller = TAILQ_FIRST(&reactor->active_pollers);
+	if (poller == NULL) {
+		return false;
+	}
+
+	TAILQ_REMOVE(&reactor->active_pollers, poller, tailq);
+	poller->state = SPDK_POLLER_STATE_RUNNING;
+	reactor->poller_busy = false;
+	poller->fn(poller->arg);
+	busy = poller->intr_fd < 0 || reactor->poller_busy;
+	if (poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
+		_spdk_poller_unregister_complete(poller);
+	} else {
+		poller->state = SPDK_POLLER_STATE_WAITING;
+		TAILQ_INSERT_TAIL(&reactor->active_pollers, poller, tailq);
+	}
+
+	return busy;
+}
+
+static bool
+_spdk_reactor_can_wait_interrupts(struct spdk_reactor *reactor)
+{
+	return reactor->num_intr_pollers != 0 &&
+	       reactor->num_intr_pollers == reactor->num_active_pollers;
+}
+
+#ifdef __linux__
+static void
+_spdk_reactor_drain_fd(int fd)
+{
+	uint64_t count;
+
+	while (read(fd, &count, sizeof(count)) == sizeof(count)) {
+	}
+}
+
+/*
+ * Block until an interrupt poller's file descriptor becomes readable, an event is sent to
+ *  the reactor, or timeout_ms expires (-1 for no timeout).  Pending notifications are
+ *  cleared and every poller runs once more first, so work that arrived before the
+ *  notifications were cleared is not left waiting for the next interrupt.
+ */
+static void
+_spdk_reactor_wait_interrupts(struct spdk_reactor *reactor, int timeout_ms)
+{
+	struct epoll_event	events[SPDK_REACTOR_MAX_INTR_EVENTS];
+	struct spdk_poller	*poller;
+	uint32_t		i, count;
+
+	TAILQ_FOREACH(poller, &reactor->active_pollers, tailq) {
+		if (poller->intr_fn) {
+			poller->intr_fn(poller->arg, true);
+		}
+		_spdk_reactor_drain_fd(poller->intr_fd);
+	}
+	_spdk_reactor_drain_fd(reactor->event_fd);
+
+	count = reactor->num_active_pollers;
+	for (i = 0; i < count; i++) {
+		if (_spdk_reactor_run_active_poller(reactor)) {
+			goto out;
+		}
+	}
+
+	reactor->intr_waiting = true;
+	spdk_mb();
+
+	/* An event may have been queued before intr_waiting became visible to its sender. */
+	if (spdk_event_queue_count(reactor->lcore) == 0 &&
+	    g_reactor_state == SPDK_REACTOR_STATE_RUNNING) {
+		epoll_wait(reactor->epfd, events, SPDK_REACTOR_MAX_INTR_EVENTS, timeout_ms);
+	}
+
+	reactor->intr_waiting = false;
+
+out:
+	/* Back to polling - the interrupts are not needed until the next wait. */
+	TAILQ_FOREACH(poller, &reactor->active_pollers, tailq) {
+		if (poller->intr_fn) {
+			poller->intr_fn(poller->arg, false);
+		}
+	}
+}
+#else
+static void
+_spdk_reactor_wait_interrupts(struct spdk_reactor *reactor, int timeout_ms)
+{
+}
+#endif
+
 /**
 
 \brief This is the main function of the reactor thread.
@@ -334,8 +503,9 @@ _spdk_reactor_run(void *arg)
 	struct spdk_poller	*poller;
 	uint32_t		event_count;
 	uint64_t		last_action, now;
-	uint64_t		spin_cycles, sleep_cycles;
+	uint64_t		spin_cycles, sleep_cycles, intr_idle_cycles;
 	uint32_t		sleep_us;
+	int			timeout_ms;
 
 	spdk_allocate_thread();
 	set_reactor_thread_name();
@@ -343,6 +513,7 @@ _spdk_reactor_run(void *arg)
 
 	spin_cycles = SPDK_REACTOR_SPIN_TIME_US * rte_get_timer_hz() / 1000000ULL;
 	sleep_cycles = reactor->max_delay_us * rte_get_timer_hz() / 1000000ULL;
+	intr_idle_cycles = SPDK_REACTOR_INTR_IDLE_TIME_US * rte_get_timer_hz() / 1000000ULL;
 	last_action = rte_get_timer_cycles();
 
 	while (1) {
@@ -351,17 +522,7 @@ _spdk_reactor_run(void *arg)
 			last_action = rte_get_timer_cycles();
 		}
 
-		poller = TAILQ_FIRST(&reactor->active_pollers);
-		if (poller) {
-			TAILQ_REMOVE(&reactor->active_pollers, poller, tailq);
-			poller->state = SPDK_POLLER_STATE_RUNNING;
-			poller->fn(poller->arg);
-			if (poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
-				_spdk_poller_unregister_complete(poller);
-			} else {
-				poller->state = SPDK_POLLER_STATE_WAITING;
-				TAILQ_INSERT_TAIL(&reactor->active_pollers, poller, tailq);
-			}
+		if (_spdk_reactor_run_active_poller(reactor)) {
 			last_action = rte_get_timer_cycles();
 		}
 
@@ -382,8 +543,31 @@ _spdk_reactor_run(void *arg)
 			}
 		}
 
-		/* Determine if the thread can sleep */
-		if (sleep_cycles > 0) {
+		/*
+		 * Switch to interrupt mode once every active poller can be woken by an interrupt
+		 *  and none of them has found work for SPDK_REACTOR_INTR_IDLE_TIME_US.  Waking up
+		 *  switches straight back to polling, and the idle time has to pass again before
+		 *  the next wait.
+		 */
+		if (_spdk_reactor_can_wait_interrupts(reactor)) {
+			now = rte_get_timer_cycles();
+			if (now >= (last_action + intr_idle_cycles)) {
+				timeout_ms = -1;
+				poller = TAILQ_FIRST(&reactor->timer_pollers);
+				if (poller) {
+					/* Round up, since epoll_wait() only has millisecond resolution. */
+					timeout_ms = 0;
+					if (poller->next_run_tick > now) {
+						timeout_ms = ((poller->next_run_tick - now) * 1000ULL +
+							      rte_get_timer_hz() - 1) / rte_get_timer_hz();
+					}
+				}
+
+				_spdk_reactor_wait_interrupts(reactor, timeout_ms);
+				last_action = rte_get_timer_cycles();
+			}
+		} else if (sleep_cycles > 0) {
+			/* Determine if the thread can sleep */
 			now = rte_get_timer_cycles();
 			if (now >= (last_action + spin_cycles)) {
 				sleep_us = reactor->max_delay_us;
@@ -416,6 +600,36 @@ _spdk_reactor_run(void *arg)
 	return 0;
 }
 
+static void
+_spdk_reactor_init_interrupts(struct spdk_reactor *reactor)
+{
+	reactor->epfd = -1;
+	reactor->event_fd = -1;
+
+#ifdef __linux__
+	struct epoll_event ev = {};
+
+	reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+	reactor->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (reactor->epfd >= 0 && reactor->event_fd >= 0) {
+		ev.events = EPOLLIN;
+		if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, reactor->event_fd, &ev) == 0) {
+			return;
+		}
+	}
+
+	SPDK_ERRLOG("interrupt mode unavailable on reactor %u\n", reactor->lcore);
+	if (reactor->epfd >= 0) {
+		close(reactor->epfd);
+		reactor->epfd = -1;
+	}
+	if (reactor->event_fd >= 0) {
+		close(reactor->event_fd);
+		reactor->event_fd = -1;
+	}
+#endif
+}
+
 static void
 spdk_reactor_construct(struct spdk_reactor *reactor, uint32_t lcore, uint64_t max_delay_us)
 {
@@ -427,6 +641,8 @@ spdk_reactor_construct(struct spdk_reactor *reactor, uint32_t lcore, uint64_t ma
 	TAILQ_INIT(&reactor->active_pollers);
 	TAILQ_INIT(&reactor->timer_pollers);
 
+	_spdk_reactor_init_interrupts(reactor);
+
 	snprintf(ring_name, sizeof(ring_name) - 1, "spdk_event_queue_%u", lcore);
 	reactor->events =
 		rte_ring_create(ring_name, 65536, rte_lcore_to_socket_id(lcore), RING_F_SC_DEQ);
@@ -577,7 +793,17 @@ spdk_reactors_start(void)
 
 void spdk_reactors_stop(void)
 {
+	uint32_t i;
+
 	g_reactor_state = SPDK_REACTOR_STATE_EXITING;
+	spdk_mb();
+
+	/* Reactors blocked waiting for interrupts would not notice the state change. */
+	RTE_LCORE_FOREACH(i) {
+		if (((1ULL << i) & spdk_app_get_core_mask())) {
+			_spdk_reactor_wakeup(spdk_reactor_get(i));
+		}
+	}
 }
 
 int
@@ -671,6 +897,25 @@ _spdk_event_add_poller(spdk_event_t event)
 		spdk_poller_insert_timer(reactor, poller, rte_get_timer_cycles());
 	} else {
 		TAILQ_INSERT_TAIL(&reactor->active_pollers, poller, tailq);
+		reactor->num_active_pollers++;
+	}
+
+	if (poller->intr_fd >= 0) {
+#ifdef __linux__
+		struct epoll_event ev = {};
+
+		ev.events = EPOLLIN;
+		ev.data.ptr = poller;
+		if (reactor->epfd >= 0 &&
+		    epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, poller->intr_fd, &ev) == 0) {
+			reactor->num_intr_pollers++;
+		} else {
+			/* Fall back to polling only. */
+			poller->intr_fd = -1;
+		}
+#else
+		poller->intr_fd = -1;
+#endif
 	}
 
 	if (next) {
@@ -678,9 +923,10 @@ _spdk_event_add_poller(spdk_event_t event)
 	}
 }
 
-void
-spdk_poller_register(struct spdk_poller **ppoller, spdk_poller_fn fn, void *arg,
-		     uint32_t lcore, struct spdk_event *complete, uint64_t period_microseconds)
+static void
+_spdk_poller_register(struct spdk_poller **ppoller, spdk_poller_fn fn, void *arg,
+		      uint32_t lcore, struct spdk_event *complete, uint64_t period_microseconds,
+		      int intr_fd, spdk_poller_intr_fn intr_fn)
 {
 	struct spdk_poller *poller;
 	struct spdk_reactor *reactor;
@@ -696,6 +942,8 @@ spdk_poller_register(struct spdk_poller **ppoller, spdk_poller_fn fn, void *arg,
 	poller->state = SPDK_POLLER_STATE_WAITING;
 	poller->fn = fn;
 	poller->arg = arg;
+	poller->intr_fd = intr_fd;
+	poller->intr_fn = intr_fn;
 
 	if (period_microseconds) {
 		poller->period_ticks = (rte_get_timer_hz() * period_microseconds) / 1000000ULL;
@@ -715,6 +963,27 @@ spdk_poller_register(struct spdk_poller **ppoller, spdk_poller_fn fn, void *arg,
 	spdk_event_call(event);
 }
 
+void
+spdk_poller_register(struct spdk_poller **ppoller, spdk_poller_fn fn, void *arg,
+		     uint32_t lcore, struct spdk_event *complete, uint64_t period_microseconds)
+{
+	_spdk_poller_register(ppoller, fn, arg, lcore, complete, period_microseconds, -1, NULL);
+}
+
+void
+spdk_poller_register_interrupt(struct spdk_poller **ppoller, spdk_poller_fn fn, void *arg,
+			       uint32_t lcore, struct spdk_event *complete, int intr_fd,
+			       spdk_poller_intr_fn intr_fn)
+{
+	_spdk_poller_register(ppoller, fn, arg, lcore, complete, 0, intr_fd, intr_fn);
+}
+
+void
+spdk_poller_set_busy(void)
+{
+	spdk_reactor_get(rte_lcore_id())->poller_busy = true;
+}
+
 static void
 _spdk_poller_unregister(struct spdk_reactor *reactor, struct spdk_poller *poller,
 			struct spdk_event *next)
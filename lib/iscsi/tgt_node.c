@@ -57,6 +57,7 @@
 #include "spdk/event.h"
 #include "spdk/log.h"
 #include "spdk/conf.h"
+#include "spdk/io_channel.h"
 #include "spdk/net.h"
 #include "iscsi/iscsi.h"
 #include "iscsi/conn.h"
@@ -791,7 +792,8 @@ spdk_cf_add_iscsi_tgt_node(struct spdk_conf_section *sp)
 	int lun_id_list[SPDK_SCSI_DEV_MAX_LUN];
 	char lun_name_array[SPDK_SCSI_DEV_MAX_LUN][SPDK_SCSI_LUN_MAX_NAME_LENGTH] = {};
 	char *lun_name_list[SPDK_SCSI_DEV_MAX_LUN];
-	int num_luns, queue_depth;
+	int num_luns, queue_depth, write_stream;
+	uint32_t io_priority;
 
 	SPDK_TRACELOG(SPDK_TRACE_DEBUG, "add unit %d\n", sp->num);
 
@@ -951,6 +953,25 @@ spdk_cf_add_iscsi_tgt_node(struct spdk_conf_section *sp)
 		queue_depth = (int) strtol(val, NULL, 10);
 	}
 
+	val = spdk_conf_section_get_val(sp, "Priority");
+	if (val == NULL) {
+		io_priority = SPDK_IO_PRIORITY_DEFAULT;
+	} else if (spdk_io_priority_parse(val, &io_priority) != 0) {
+		SPDK_ERRLOG("tgt_node%d: unknown Priority %s\n", target_num, val);
+		return -1;
+	}
+
+	val = spdk_conf_section_get_val(sp, "WriteStream");
+	if (val == NULL) {
+		write_stream = 0;
+	} else {
+		write_stream = (int) strtol(val, NULL, 10);
+		if (write_stream < 0 || write_stream > UINT16_MAX) {
+			SPDK_ERRLOG("tgt_node%d: invalid WriteStream %s\n", target_num, val);
+			return -1;
+		}
+	}
+
 	num_luns = 0;
 
 	for (i = 0; i < SPDK_SCSI_DEV_MAX_LUN; i++) {
@@ -983,6 +1004,9 @@ spdk_cf_add_iscsi_tgt_node(struct spdk_conf_section *sp)
 		return -1;
 	}
 
+	target->dev->io_priority = io_priority;
+	target->dev->write_stream = write_stream;
+
 	spdk_scsi_dev_print(target->dev);
 	return 0;
 }
@@ -32,18 +32,88 @@
  */
 
 #include "nvme_internal.h"
+#include "nvme_uevent.h"
 
-struct nvme_driver _g_nvme_driver = {
-	.lock = PTHREAD_MUTEX_INITIALIZER,
-	.init_ctrlrs = TAILQ_HEAD_INITIALIZER(_g_nvme_driver.init_ctrlrs),
-	.attached_ctrlrs = TAILQ_HEAD_INITIALIZER(_g_nvme_driver.attached_ctrlrs),
-	.request_mempool = NULL,
-};
+#include <strings.h>
 
-struct nvme_driver *g_spdk_nvme_driver = &_g_nvme_driver;
+#define SPDK_NVME_DRIVER_NAME "spdk_nvme_driver"
+
+struct nvme_driver *g_spdk_nvme_driver;
+pid_t g_spdk_nvme_pid;
+
+/* Serializes initialization of g_spdk_nvme_driver within this process */
+static pthread_mutex_t g_nvme_driver_init_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 int32_t		spdk_nvme_retry_count;
 
+static int
+nvme_driver_init(void)
+{
+	struct nvme_driver *driver;
+	int rc = 0;
+
+	pthread_mutex_lock(&g_nvme_driver_init_mutex);
+
+	if (g_spdk_nvme_driver != NULL) {
+		pthread_mutex_unlock(&g_nvme_driver_init_mutex);
+		return 0;
+	}
+
+	g_spdk_nvme_pid = getpid();
+
+	if (!nvme_process_is_primary()) {
+		/*
+		 * Secondary processes share the driver state (and the controllers the primary
+		 *  attached) through the memzone reserved by the primary process.
+		 */
+		driver = nvme_memzone_lookup(SPDK_NVME_DRIVER_NAME);
+		if (driver == NULL || !driver->initialized) {
+			SPDK_ERRLOG("primary process has not initialized the NVMe driver\n");
+			rc = -1;
+		} else {
+			g_spdk_nvme_driver = driver;
+		}
+		pthread_mutex_unlock(&g_nvme_driver_init_mutex);
+		return rc;
+	}
+
+	driver = nvme_memzone_reserve(SPDK_NVME_DRIVER_NAME, sizeof(struct nvme_driver),
+				      NVME_SOCKET_ID_ANY, 0);
+	if (driver == NULL) {
+		SPDK_ERRLOG("Unable to reserve memory for the NVMe driver\n");
+		pthread_mutex_unlock(&g_nvme_driver_init_mutex);
+		return -1;
+	}
+
+	memset(driver, 0, sizeof(*driver));
+	if (nvme_mutex_init_shared(&driver->lock)) {
+		SPDK_ERRLOG("Unable to initialize the NVMe driver lock\n");
+		nvme_memzone_free(SPDK_NVME_DRIVER_NAME);
+		pthread_mutex_unlock(&g_nvme_driver_init_mutex);
+		return -1;
+	}
+
+	TAILQ_INIT(&driver->probe_ctxs);
+	TAILQ_INIT(&driver->attached_ctrlrs);
+	driver->hotplug_fd = -1;
+
+	driver->request_mempool = nvme_mempool_create("nvme_request", 8192,
+				  sizeof(struct nvme_request), 128);
+	if (driver->request_mempool == NULL) {
+		SPDK_ERRLOG("Unable to allocate pool of requests\n");
+		pthread_mutex_destroy(&driver->lock);
+		nvme_memzone_free(SPDK_NVME_DRIVER_NAME);
+		pthread_mutex_unlock(&g_nvme_driver_init_mutex);
+		return -1;
+	}
+
+	driver->initialized = true;
+	g_spdk_nvme_driver = driver;
+
+	pthread_mutex_unlock(&g_nvme_driver_init_mutex);
+	return 0;
+}
+
 static struct spdk_nvme_ctrlr *
 nvme_attach(void *devhandle)
 {
@@ -64,6 +134,12 @@ nvme_attach(void *devhandle)
 		return NULL;
 	}
 
+	if (nvme_ctrlr_add_process(ctrlr, devhandle) != 0) {
+		nvme_ctrlr_destruct(ctrlr);
+		nvme_free(ctrlr);
+		return NULL;
+	}
+
 	return ctrlr;
 }
 
@@ -72,9 +148,14 @@ spdk_nvme_detach(struct spdk_nvme_ctrlr *ctrlr)
 {
 	pthread_mutex_lock(&g_spdk_nvme_driver->lock);
 
-	nvme_ctrlr_destruct(ctrlr);
-	TAILQ_REMOVE(&g_spdk_nvme_driver->attached_ctrlrs, ctrlr, tailq);
-	nvme_free(ctrlr);
+	nvme_ctrlr_remove_process(ctrlr);
+
+	/* The last process to detach the controller destroys it. */
+	if (TAILQ_EMPTY(&ctrlr->active_procs)) {
+		nvme_ctrlr_destruct(ctrlr);
+		TAILQ_REMOVE(&g_spdk_nvme_driver->attached_ctrlrs, ctrlr, tailq);
+		nvme_free(ctrlr);
+	}
 
 	pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
 	return 0;
@@ -118,6 +199,7 @@ nvme_allocate_request(const struct nvme_payload *payload, uint32_t payload_size,
 	req->cb_arg = cb_arg;
 	req->payload = *payload;
 	req->payload_size = payload_size;
+	req->pid = g_spdk_nvme_pid;
 
 	return req;
 }
@@ -228,32 +310,95 @@ nvme_mutex_init_shared(pthread_mutex_t *mtx)
 	return rc;
 }
 
-struct nvme_enum_ctx {
-	spdk_nvme_probe_cb probe_cb;
-	void *cb_ctx;
-};
+/* This function must only be called while holding g_spdk_nvme_driver->lock */
+static bool
+nvme_devhandle_in_use(void *devhandle)
+{
+	struct spdk_nvme_ctrlr *ctrlr;
+	struct spdk_nvme_probe_ctx *probe_ctx;
+
+	/* NOTE: This assumes that the PCI abstraction layer will use the same device handle
+	 *  across enumerations; we could compare by BDF instead if this is not true.
+	 */
+	TAILQ_FOREACH(ctrlr, &g_spdk_nvme_driver->attached_ctrlrs, tailq) {
+		if (devhandle == ctrlr->devhandle) {
+			return true;
+		}
+	}
+
+	/* Also skip controllers that another probe is still initializing. */
+	TAILQ_FOREACH(probe_ctx, &g_spdk_nvme_driver->probe_ctxs, tailq) {
+		TAILQ_FOREACH(ctrlr, &probe_ctx->init_ctrlrs, tailq) {
+			if (devhandle == ctrlr->devhandle) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Attach a secondary process to a controller that the primary process has already
+ *  initialized.  Secondary processes never initialize controllers themselves.
+ *
+ * This function must only be called while holding g_spdk_nvme_driver->lock
+ */
+static int
+nvme_enum_cb_secondary(struct spdk_nvme_probe_ctx *probe_ctx, struct spdk_pci_device *pci_dev)
+{
+	struct spdk_nvme_ctrlr *ctrlr;
+	struct spdk_nvme_ctrlr_opts opts;
+
+	TAILQ_FOREACH(ctrlr, &g_spdk_nvme_driver->attached_ctrlrs, tailq) {
+		if (nvme_ctrlr_matches_pci_dev(ctrlr, pci_dev)) {
+			break;
+		}
+	}
+
+	if (ctrlr == NULL || nvme_ctrlr_get_current_process(ctrlr) != NULL) {
+		/* Not attached by the primary process, or already attached by this one. */
+		return 0;
+	}
+
+	/* The controller is already initialized, so changes to its options are ignored. */
+	opts = ctrlr->opts;
+	if (!probe_ctx->probe_cb(probe_ctx->cb_ctx, pci_dev, &opts)) {
+		return 0;
+	}
+
+	if (nvme_ctrlr_add_process(ctrlr, pci_dev) != 0) {
+		SPDK_ERRLOG("nvme_ctrlr_add_process() failed\n");
+		return -1;
+	}
+
+	pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
+	probe_ctx->attach_cb(probe_ctx->cb_ctx, pci_dev, ctrlr, &ctrlr->opts);
+	pthread_mutex_lock(&g_spdk_nvme_driver->lock);
+
+	return 0;
+}
 
 /* This function must only be called while holding g_spdk_nvme_driver->lock */
 static int
 nvme_enum_cb(void *ctx, struct spdk_pci_device *pci_dev)
 {
-	struct nvme_enum_ctx *enum_ctx = ctx;
+	struct spdk_nvme_probe_ctx *probe_ctx = ctx;
 	struct spdk_nvme_ctrlr *ctrlr;
 	struct spdk_nvme_ctrlr_opts opts;
 
+	if (!nvme_process_is_primary()) {
+		return nvme_enum_cb_secondary(probe_ctx, pci_dev);
+	}
+
 	/* Verify that this controller is not already attached */
-	TAILQ_FOREACH(ctrlr, &g_spdk_nvme_driver->attached_ctrlrs, tailq) {
-		/* NOTE: This assumes that the PCI abstraction layer will use the same device handle
-		 *  across enumerations; we could compare by BDF instead if this is not true.
-		 */
-		if (pci_dev == ctrlr->devhandle) {
-			return 0;
-		}
+	if (nvme_devhandle_in_use(pci_dev)) {
+		return 0;
 	}
 
 	spdk_nvme_ctrlr_opts_set_defaults(&opts);
 
-	if (enum_ctx->probe_cb(enum_ctx->cb_ctx, pci_dev, &opts)) {
+	if (probe_ctx->probe_cb(probe_ctx->cb_ctx, pci_dev, &opts)) {
 		ctrlr = nvme_attach(pci_dev);
 		if (ctrlr == NULL) {
 			SPDK_ERRLOG("nvme_attach() failed\n");
@@ -262,88 +407,406 @@ nvme_enum_cb(void *ctx, struct spdk_pci_device *pci_dev)
 
 		ctrlr->opts = opts;
 
-		TAILQ_INSERT_TAIL(&g_spdk_nvme_driver->init_ctrlrs, ctrlr, tailq);
+		TAILQ_INSERT_TAIL(&probe_ctx->init_ctrlrs, ctrlr, tailq);
 	}
 
 	return 0;
 }
 
-int
-spdk_nvme_probe(void *cb_ctx, spdk_nvme_probe_cb probe_cb, spdk_nvme_attach_cb attach_cb,
-		spdk_nvme_remove_cb remove_cb)
+/* This function must only be called while holding g_spdk_nvme_driver->lock */
+static void
+nvme_hotplug_remove(struct nvme_uevent *uevent, void *cb_ctx, spdk_nvme_remove_cb remove_cb)
 {
-	int rc, start_rc;
-	struct nvme_enum_ctx enum_ctx;
-	struct spdk_nvme_ctrlr *ctrlr, *ctrlr_tmp;
+	struct spdk_nvme_ctrlr *ctrlr, *tmp;
+	struct spdk_pci_device *pci_dev;
 
-	pthread_mutex_lock(&g_spdk_nvme_driver->lock);
+	TAILQ_FOREACH_SAFE(ctrlr, &g_spdk_nvme_driver->attached_ctrlrs, tailq, tmp) {
+		if (ctrlr->transport != NULL) {
+			/* Fabrics controllers have no PCI device */
+			continue;
+		}
 
-	if (g_spdk_nvme_driver->request_mempool == NULL) {
-		g_spdk_nvme_driver->request_mempool = nvme_mempool_create("nvme_request", 8192,
-						      sizeof(struct nvme_request), 128);
-		if (g_spdk_nvme_driver->request_mempool == NULL) {
-			SPDK_ERRLOG("Unable to allocate pool of requests\n");
+		pci_dev = ctrlr->devhandle;
+		if (spdk_pci_device_get_domain(pci_dev) != uevent->domain ||
+		    spdk_pci_device_get_bus(pci_dev) != uevent->bus ||
+		    spdk_pci_device_get_dev(pci_dev) != uevent->dev ||
+		    spdk_pci_device_get_func(pci_dev) != uevent->func ||
+		    ctrlr->is_failed) {
+			continue;
+		}
+
+		SPDK_NOTICELOG("NVMe controller %04x:%02x:%02x.%x removed\n",
+			       uevent->domain, uevent->bus, uevent->dev, uevent->func);
+
+		/*
+		 * Only mark the controller failed here; outstanding I/O is failed by
+		 *  each queue pair's owner the next time it processes completions.
+		 */
+		ctrlr->is_failed = true;
+
+		if (remove_cb) {
+			/* The user may call spdk_nvme_detach() from the callback. */
 			pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
-			return -1;
+			remove_cb(cb_ctx, ctrlr);
+			pthread_mutex_lock(&g_spdk_nvme_driver->lock);
 		}
+		break;
 	}
+}
 
-	enum_ctx.probe_cb = probe_cb;
-	enum_ctx.cb_ctx = cb_ctx;
+/*
+ * Drain pending uevents.  Removed controllers are reported to remove_cb; added
+ *  devices cause the PCI bus to be rescanned before the next enumeration.
+ *
+ * This function must only be called while holding g_spdk_nvme_driver->lock
+ */
+static int
+nvme_hotplug_process_events(void *cb_ctx, spdk_nvme_remove_cb remove_cb)
+{
+	struct nvme_uevent uevent;
+	int rc;
+
+	if (g_spdk_nvme_driver->hotplug_fd < 0) {
+		rc = nvme_uevent_connect();
+		if (rc < 0) {
+			SPDK_ERRLOG("Failed to open uevent socket: %s\n", strerror(-rc));
+			return rc;
+		}
+		g_spdk_nvme_driver->hotplug_fd = rc;
+	}
+
+	while ((rc = nvme_uevent_get(g_spdk_nvme_driver->hotplug_fd, &uevent)) > 0) {
+		if (uevent.action == NVME_UEVENT_ADD) {
+			SPDK_TRACELOG(SPDK_TRACE_NVME, "PCI device %04x:%02x:%02x.%x added\n",
+				      uevent.domain, uevent.bus, uevent.dev, uevent.func);
+			g_spdk_nvme_driver->hotplug_rescan = true;
+		} else {
+			nvme_hotplug_remove(&uevent, cb_ctx, remove_cb);
+		}
+	}
+
+	return rc;
+}
+
+/* This function must only be called while holding g_spdk_nvme_driver->lock */
+static struct spdk_nvme_probe_ctx *
+nvme_probe_start(void *cb_ctx, spdk_nvme_probe_cb probe_cb, spdk_nvme_attach_cb attach_cb)
+{
+	struct spdk_nvme_probe_ctx *probe_ctx;
+	int rc;
+
+	probe_ctx = calloc(1, sizeof(*probe_ctx));
+	if (probe_ctx == NULL) {
+		SPDK_ERRLOG("Unable to allocate probe context\n");
+		return NULL;
+	}
+
+	probe_ctx->cb_ctx = cb_ctx;
+	probe_ctx->probe_cb = probe_cb;
+	probe_ctx->attach_cb = attach_cb;
+	TAILQ_INIT(&probe_ctx->init_ctrlrs);
 
-	rc = spdk_pci_enumerate(SPDK_PCI_DEVICE_NVME, nvme_enum_cb, &enum_ctx);
+	/*
+	 * Only the primary process initializes controllers, so only its probes are tracked
+	 *  in the shared driver state.  A secondary's probe context is private to it.
+	 */
+	if (nvme_process_is_primary()) {
+		TAILQ_INSERT_TAIL(&g_spdk_nvme_driver->probe_ctxs, probe_ctx, tailq);
+	}
+
+	if (g_spdk_nvme_driver->hotplug_rescan) {
+		g_spdk_nvme_driver->hotplug_rescan = false;
+		if (spdk_pci_scan() != 0) {
+			SPDK_ERRLOG("PCI rescan failed\n");
+		}
+	}
+
+	rc = spdk_pci_enumerate(SPDK_PCI_DEVICE_NVME, nvme_enum_cb, probe_ctx);
 	/*
 	 * Keep going even if one or more nvme_attach() calls failed,
-	 *  but maintain the value of rc to signal errors when we return.
+	 *  but maintain the value of rc to signal errors when the probe completes.
 	 */
+	probe_ctx->rc = rc;
+
+	return probe_ctx;
+}
+
+struct spdk_nvme_probe_ctx *
+spdk_nvme_probe_async(void *cb_ctx, spdk_nvme_probe_cb probe_cb, spdk_nvme_attach_cb attach_cb,
+		      spdk_nvme_remove_cb remove_cb)
+{
+	struct spdk_nvme_probe_ctx *probe_ctx;
 
-	/* Initialize all new controllers in the init_ctrlrs list in parallel. */
-	while (!TAILQ_EMPTY(&g_spdk_nvme_driver->init_ctrlrs)) {
-		TAILQ_FOREACH_SAFE(ctrlr, &g_spdk_nvme_driver->init_ctrlrs, tailq, ctrlr_tmp) {
-			/* Drop the driver lock while calling nvme_ctrlr_process_init()
-			 *  since it needs to acquire the driver lock internally when calling
-			 *  nvme_ctrlr_start().
-			 *
-			 * TODO: Rethink the locking - maybe reset should take the lock so that start() and
-			 *  the functions it calls (in particular nvme_ctrlr_set_num_qpairs())
-			 *  can assume it is held.
+	if (nvme_driver_init() != 0) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&g_spdk_nvme_driver->lock);
+
+	/* Hot remove is only monitored by the primary process, which owns the controllers. */
+	if (remove_cb && nvme_process_is_primary()) {
+		/* Failure to monitor hotplug events is not fatal for the probe itself. */
+		nvme_hotplug_process_events(cb_ctx, remove_cb);
+	}
+
+	probe_ctx = nvme_probe_start(cb_ctx, probe_cb, attach_cb);
+
+	pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
+	return probe_ctx;
+}
+
+int
+spdk_nvme_probe_poll_async(struct spdk_nvme_probe_ctx *probe_ctx)
+{
+	struct spdk_nvme_ctrlr *ctrlr, *ctrlr_tmp;
+	int start_rc, rc;
+
+	pthread_mutex_lock(&g_spdk_nvme_driver->lock);
+
+	/* Advance every controller in this probe by one initialization step. */
+	TAILQ_FOREACH_SAFE(ctrlr, &probe_ctx->init_ctrlrs, tailq, ctrlr_tmp) {
+		/* Drop the driver lock while calling nvme_ctrlr_process_init()
+		 *  since it needs to acquire the driver lock internally when calling
+		 *  nvme_ctrlr_start().
+		 *
+		 * TODO: Rethink the locking - maybe reset should take the lock so that start() and
+		 *  the functions it calls (in particular nvme_ctrlr_set_num_qpairs())
+		 *  can assume it is held.
+		 */
+		pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
+		start_rc = nvme_ctrlr_process_init(ctrlr);
+		pthread_mutex_lock(&g_spdk_nvme_driver->lock);
+
+		if (start_rc) {
+			/* Controller failed to initialize. */
+			TAILQ_REMOVE(&probe_ctx->init_ctrlrs, ctrlr, tailq);
+			nvme_ctrlr_destruct(ctrlr);
+			nvme_free(ctrlr);
+			probe_ctx->rc = -1;
+			continue;
+		}
+
+		if (ctrlr->state == NVME_CTRLR_STATE_READY) {
+			/*
+			 * Controller has been initialized.
+			 *  Move it to the attached_ctrlrs list.
+			 */
+			TAILQ_REMOVE(&probe_ctx->init_ctrlrs, ctrlr, tailq);
+			TAILQ_INSERT_TAIL(&g_spdk_nvme_driver->attached_ctrlrs, ctrlr, tailq);
+
+			/*
+			 * Unlock while calling attach_cb() so the user can call other functions
+			 *  that may take the driver lock, like nvme_detach().
 			 */
 			pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
-			start_rc = nvme_ctrlr_process_init(ctrlr);
+			probe_ctx->attach_cb(probe_ctx->cb_ctx, ctrlr->devhandle, ctrlr, &ctrlr->opts);
 			pthread_mutex_lock(&g_spdk_nvme_driver->lock);
+		}
+	}
 
-			if (start_rc) {
-				/* Controller failed to initialize. */
-				TAILQ_REMOVE(&g_spdk_nvme_driver->init_ctrlrs, ctrlr, tailq);
-				nvme_ctrlr_destruct(ctrlr);
-				nvme_free(ctrlr);
-				rc = -1;
-				break;
-			}
+	if (!TAILQ_EMPTY(&probe_ctx->init_ctrlrs)) {
+		pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
+		return -EAGAIN;
+	}
+
+	if (nvme_process_is_primary()) {
+		TAILQ_REMOVE(&g_spdk_nvme_driver->probe_ctxs, probe_ctx, tailq);
+	}
+	pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
+
+	rc = probe_ctx->rc;
+	free(probe_ctx);
+	return rc;
+}
+
+int
+spdk_nvme_probe(void *cb_ctx, spdk_nvme_probe_cb probe_cb, spdk_nvme_attach_cb attach_cb,
+		spdk_nvme_remove_cb remove_cb)
+{
+	struct spdk_nvme_probe_ctx *probe_ctx;
+	int rc;
+
+	probe_ctx = spdk_nvme_probe_async(cb_ctx, probe_cb, attach_cb, remove_cb);
+	if (probe_ctx == NULL) {
+		return -1;
+	}
+
+	/* Initialize all new controllers in parallel. */
+	do {
+		rc = spdk_nvme_probe_poll_async(probe_ctx);
+	} while (rc == -EAGAIN);
+
+	return rc;
+}
+
+int
+spdk_nvme_hotplug_poll(void *cb_ctx, spdk_nvme_probe_cb probe_cb, spdk_nvme_attach_cb attach_cb,
+		       spdk_nvme_remove_cb remove_cb)
+{
+	struct spdk_nvme_probe_ctx *probe_ctx;
+	int rc;
+
+	if (nvme_driver_init() != 0) {
+		return -1;
+	}
+
+	if (!nvme_process_is_primary()) {
+		/* Hotplug events are handled by the primary process. */
+		return 0;
+	}
+
+	pthread_mutex_lock(&g_spdk_nvme_driver->lock);
+
+	rc = nvme_hotplug_process_events(cb_ctx, remove_cb);
+	if (rc < 0) {
+		pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
+		return rc;
+	}
+
+	if (g_spdk_nvme_driver->hotplug_probe_ctx == NULL && g_spdk_nvme_driver->hotplug_rescan) {
+		g_spdk_nvme_driver->hotplug_probe_ctx = nvme_probe_start(cb_ctx, probe_cb, attach_cb);
+	}
+	probe_ctx = g_spdk_nvme_driver->hotplug_probe_ctx;
+
+	pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
+
+	if (probe_ctx == NULL) {
+		return 0;
+	}
 
-			if (ctrlr->state == NVME_CTRLR_STATE_READY) {
-				/*
-				 * Controller has been initialized.
-				 *  Move it to the attached_ctrlrs list.
-				 */
-				TAILQ_REMOVE(&g_spdk_nvme_driver->init_ctrlrs, ctrlr, tailq);
-				TAILQ_INSERT_TAIL(&g_spdk_nvme_driver->attached_ctrlrs, ctrlr, tailq);
-
-				/*
-				 * Unlock while calling attach_cb() so the user can call other functions
-				 *  that may take the driver lock, like nvme_detach().
-				 */
-				pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
-				attach_cb(cb_ctx, ctrlr->devhandle, ctrlr, &ctrlr->opts);
-				pthread_mutex_lock(&g_spdk_nvme_driver->lock);
-
-				break;
+	rc = spdk_nvme_probe_poll_async(probe_ctx);
+	if (rc == -EAGAIN) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&g_spdk_nvme_driver->lock);
+	g_spdk_nvme_driver->hotplug_probe_ctx = NULL;
+	pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
+
+	return rc;
+}
+
+int
+spdk_nvme_transport_id_parse(struct spdk_nvme_transport_id *trid, const char *str)
+{
+	char buf[512];
+	char *saveptr = NULL;
+	char *tok, *val;
+	bool has_trtype = false;
+
+	if (trid == NULL || str == NULL || strlen(str) >= sizeof(buf)) {
+		return -1;
+	}
+
+	memset(trid, 0, sizeof(*trid));
+	snprintf(buf, sizeof(buf), "%s", str);
+
+	for (tok = strtok_r(buf, " \t\n", &saveptr); tok != NULL;
+	     tok = strtok_r(NULL, " \t\n", &saveptr)) {
+		val = strchr(tok, ':');
+		if (val == NULL) {
+			SPDK_ERRLOG("Transport ID key '%s' has no value\n", tok);
+			return -1;
+		}
+		*val++ = '\0';
+
+		if (strcasecmp(tok, "trtype") == 0) {
+			if (strcasecmp(val, "TCP") != 0) {
+				SPDK_ERRLOG("Unsupported transport type '%s'\n", val);
+				return -1;
+			}
+			trid->trtype = SPDK_NVME_TRANSPORT_TCP;
+			has_trtype = true;
+		} else if (strcasecmp(tok, "traddr") == 0) {
+			if (strlen(val) > SPDK_NVME_TRANSPORT_ID_TRADDR_MAX_LEN) {
+				SPDK_ERRLOG("traddr '%s' is too long\n", val);
+				return -1;
+			}
+			snprintf(trid->traddr, sizeof(trid->traddr), "%s", val);
+		} else if (strcasecmp(tok, "trsvcid") == 0) {
+			if (strlen(val) > SPDK_NVME_TRANSPORT_ID_TRSVCID_MAX_LEN) {
+				SPDK_ERRLOG("trsvcid '%s' is too long\n", val);
+				return -1;
 			}
+			snprintf(trid->trsvcid, sizeof(trid->trsvcid), "%s", val);
+		} else if (strcasecmp(tok, "subnqn") == 0) {
+			if (strlen(val) >= sizeof(trid->subnqn)) {
+				SPDK_ERRLOG("subnqn '%s' is too long\n", val);
+				return -1;
+			}
+			snprintf(trid->subnqn, sizeof(trid->subnqn), "%s", val);
+		} else {
+			SPDK_ERRLOG("Unknown transport ID key '%s'\n", tok);
+			return -1;
 		}
 	}
 
+	if (!has_trtype || trid->traddr[0] == '\0' || trid->trsvcid[0] == '\0') {
+		SPDK_ERRLOG("Transport ID requires trtype, traddr and trsvcid\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+struct spdk_nvme_ctrlr *
+spdk_nvme_connect(const struct spdk_nvme_transport_id *trid,
+		  const struct spdk_nvme_ctrlr_opts *opts)
+{
+	struct spdk_nvme_ctrlr	*ctrlr;
+	uint64_t		phys_addr = 0;
+
+	if (trid == NULL || trid->trtype != SPDK_NVME_TRANSPORT_TCP) {
+		SPDK_ERRLOG("Unsupported transport\n");
+		return NULL;
+	}
+
+	if (nvme_driver_init() != 0) {
+		return NULL;
+	}
+
+	ctrlr = nvme_malloc(sizeof(struct spdk_nvme_ctrlr), 64, &phys_addr);
+	if (ctrlr == NULL) {
+		SPDK_ERRLOG("could not allocate ctrlr\n");
+		return NULL;
+	}
+
+	/* The options are needed before construction, since the connect sends the host NQN. */
+	if (opts != NULL) {
+		ctrlr->opts = *opts;
+	} else {
+		spdk_nvme_ctrlr_opts_set_defaults(&ctrlr->opts);
+	}
+	/* Queues live in the remote controller, and completions arrive on sockets */
+	ctrlr->opts.use_cmb_sqs = false;
+	ctrlr->opts.enable_interrupts = false;
+
+	if (nvme_ctrlr_construct_fabrics(ctrlr, &nvme_tcp_transport, trid) != 0) {
+		nvme_free(ctrlr);
+		return NULL;
+	}
+
+	if (nvme_ctrlr_add_process(ctrlr, NULL) != 0) {
+		nvme_ctrlr_destruct(ctrlr);
+		nvme_free(ctrlr);
+		return NULL;
+	}
+
+	while (ctrlr->state != NVME_CTRLR_STATE_READY) {
+		if (nvme_ctrlr_process_init(ctrlr) != 0) {
+			SPDK_ERRLOG("Initialization of controller %s at %s:%s failed\n", trid->subnqn,
+				    trid->traddr, trid->trsvcid);
+			nvme_ctrlr_destruct(ctrlr);
+			nvme_free(ctrlr);
+			return NULL;
+		}
+	}
+
+	pthread_mutex_lock(&g_spdk_nvme_driver->lock);
+	TAILQ_INSERT_TAIL(&g_spdk_nvme_driver->attached_ctrlrs, ctrlr, tailq);
 	pthread_mutex_unlock(&g_spdk_nvme_driver->lock);
-	return rc;
+
+	return ctrlr;
 }
 
 SPDK_LOG_REGISTER_TRACE_FLAG("nvme", SPDK_TRACE_NVME)
@@ -36,6 +36,7 @@
 
 static int nvme_ctrlr_construct_and_submit_aer(struct spdk_nvme_ctrlr *ctrlr,
 		struct nvme_async_event_request *aer);
+static void nvme_ctrlr_free_process(struct spdk_nvme_ctrlr_process *proc);
 
 
 void
@@ -44,6 +45,8 @@ spdk_nvme_ctrlr_opts_set_defaults(struct spdk_nvme_ctrlr_opts *opts)
 	opts->num_io_queues = DEFAULT_MAX_IO_QUEUES;
 	opts->use_cmb_sqs = false;
 	opts->arb_mechanism = SPDK_NVME_CC_AMS_RR;
+	opts->enable_interrupts = false;
+	strncpy(opts->hostnqn, DEFAULT_HOSTNQN, sizeof(opts->hostnqn));
 }
 
 static int
@@ -52,6 +55,17 @@ spdk_nvme_ctrlr_create_qpair(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_qpa
 	struct nvme_completion_poll_status	status;
 	int rc;
 
+	if (ctrlr->transport != NULL) {
+		/* A fabrics I/O queue is created by connecting it to the controller. */
+		rc = ctrlr->transport->qpair_connect(qpair);
+		if (rc != 0) {
+			return rc;
+		}
+
+		nvme_qpair_reset(qpair);
+		return 0;
+	}
+
 	status.done = false;
 	rc = nvme_ctrlr_cmd_create_io_cq(ctrlr, qpair, nvme_completion_poll_cb, &status);
 	if (rc != 0) {
@@ -94,14 +108,76 @@ spdk_nvme_ctrlr_create_qpair(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_qpa
 	return 0;
 }
 
+void
+spdk_nvme_ctrlr_get_default_io_qpair_opts(struct spdk_nvme_ctrlr *ctrlr,
+		struct spdk_nvme_io_qpair_opts *opts)
+{
+	union spdk_nvme_cap_register	cap;
+
+	/*
+	 * NVMe spec sets a hard limit of 64K max entries, but
+	 *  devices may specify a smaller limit, so we need to check
+	 *  the MQES field in the capabilities register.
+	 */
+	cap.raw = nvme_mmio_read_8(ctrlr, cap.raw);
+
+	memset(opts, 0, sizeof(*opts));
+	opts->qprio = SPDK_NVME_QPRIO_URGENT;
+	opts->io_queue_size = nvme_min(NVME_IO_ENTRIES, cap.bits.mqes + 1);
+
+	/*
+	 * No need to have more trackers than entries in the submit queue.
+	 *  Note also that for a queue size of N, we can only have (N-1)
+	 *  commands outstanding, hence the "-1" here.
+	 */
+	opts->io_queue_requests = nvme_min(NVME_IO_TRACKERS, opts->io_queue_size - 1);
+}
+
+/*
+ * Reallocate the rings and trackers of a free I/O qpair if it was constructed with different
+ *  sizes.  On failure the previous sizes are restored if possible; otherwise num_trackers is
+ *  left at 0 so that the next allocation tries again.
+ */
+static int
+nvme_ctrlr_resize_io_qpair(struct spdk_nvme_qpair *qpair, uint16_t num_entries,
+			   uint16_t num_trackers)
+{
+	uint16_t old_entries = qpair->num_entries;
+	uint16_t old_trackers = qpair->num_trackers;
+
+	if (num_entries == old_entries && num_trackers == old_trackers) {
+		return 0;
+	}
+
+	nvme_qpair_destroy(qpair);
+	qpair->num_trackers = 0;
+	if (nvme_qpair_construct(qpair, qpair->id, num_entries, num_trackers, qpair->ctrlr) == 0) {
+		return 0;
+	}
+
+	SPDK_ERRLOG("could not allocate I/O qpair with %u entries and %u trackers\n",
+		    num_entries, num_trackers);
+	qpair->num_trackers = 0;
+	if (old_trackers != 0 &&
+	    nvme_qpair_construct(qpair, qpair->id, old_entries, old_trackers, qpair->ctrlr) != 0) {
+		qpair->num_trackers = 0;
+	}
+
+	return -ENOMEM;
+}
+
 struct spdk_nvme_qpair *
-spdk_nvme_ctrlr_alloc_io_qpair(struct spdk_nvme_ctrlr *ctrlr,
-			       enum spdk_nvme_qprio qprio)
+spdk_nvme_ctrlr_alloc_io_qpair_with_opts(struct spdk_nvme_ctrlr *ctrlr,
+		const struct spdk_nvme_io_qpair_opts *opts)
 {
 	struct spdk_nvme_qpair			*qpair;
 	union spdk_nvme_cc_register		cc;
+	union spdk_nvme_cap_register		cap;
+	enum spdk_nvme_qprio			qprio = opts->qprio;
+	uint32_t				num_entries, num_trackers;
 
 	cc.raw = nvme_mmio_read_4(ctrlr, cc.raw);
+	cap.raw = nvme_mmio_read_8(ctrlr, cap.raw);
 
 	/* Only the low 2 bits (values 0, 1, 2, 3) of QPRIO are valid. */
 	if ((qprio & 3) != qprio) {
@@ -117,6 +193,11 @@ spdk_nvme_ctrlr_alloc_io_qpair(struct spdk_nvme_ctrlr *ctrlr,
 		return NULL;
 	}
 
+	num_entries = nvme_max(opts->io_queue_size, NVME_MIN_IO_TRACKERS + 1);
+	num_entries = nvme_min(num_entries, nvme_min(cap.bits.mqes + 1u, UINT16_MAX));
+	num_trackers = nvme_max(opts->io_queue_requests, NVME_MIN_IO_TRACKERS);
+	num_trackers = nvme_min(num_trackers, nvme_min(NVME_MAX_IO_TRACKERS, num_entries - 1));
+
 	pthread_mutex_lock(&ctrlr->ctrlr_lock);
 
 	/*
@@ -129,6 +210,11 @@ spdk_nvme_ctrlr_alloc_io_qpair(struct spdk_nvme_ctrlr *ctrlr,
 		return NULL;
 	}
 
+	if (nvme_ctrlr_resize_io_qpair(qpair, num_entries, num_trackers) != 0) {
+		pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+		return NULL;
+	}
+
 	/*
 	 * At this point, qpair contains a preallocated submission and completion queue and a
 	 *  unique queue ID, but it is not yet created on the controller.
@@ -147,11 +233,31 @@ spdk_nvme_ctrlr_alloc_io_qpair(struct spdk_nvme_ctrlr *ctrlr,
 	TAILQ_REMOVE(&ctrlr->free_io_qpairs, qpair, tailq);
 	TAILQ_INSERT_TAIL(&ctrlr->active_io_qpairs, qpair, tailq);
 
+	nvme_qpair_init_depth_limiter(qpair, opts->latency_target_us);
+
+	/* Track the qpair so that it is freed if this process detaches or exits. */
+	qpair->active_proc = nvme_ctrlr_get_current_process(ctrlr);
+	if (qpair->active_proc) {
+		TAILQ_INSERT_TAIL(&qpair->active_proc->allocated_io_qpairs, qpair, per_process_tailq);
+	}
+
 	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
 
 	return qpair;
 }
 
+struct spdk_nvme_qpair *
+spdk_nvme_ctrlr_alloc_io_qpair(struct spdk_nvme_ctrlr *ctrlr,
+			       enum spdk_nvme_qprio qprio)
+{
+	struct spdk_nvme_io_qpair_opts opts;
+
+	spdk_nvme_ctrlr_get_default_io_qpair_opts(ctrlr, &opts);
+	opts.qprio = qprio;
+
+	return spdk_nvme_ctrlr_alloc_io_qpair_with_opts(ctrlr, &opts);
+}
+
 int
 spdk_nvme_ctrlr_free_io_qpair(struct spdk_nvme_qpair *qpair)
 {
@@ -167,6 +273,12 @@ spdk_nvme_ctrlr_free_io_qpair(struct spdk_nvme_qpair *qpair)
 
 	pthread_mutex_lock(&ctrlr->ctrlr_lock);
 
+	if (ctrlr->transport != NULL) {
+		/* Disconnecting a fabrics I/O queue deletes it on the controller. */
+		ctrlr->transport->qpair_disconnect(qpair);
+		goto free_qpair;
+	}
+
 	/* Delete the I/O submission queue and then the completion queue */
 
 	status.done = false;
@@ -197,13 +309,38 @@ spdk_nvme_ctrlr_free_io_qpair(struct spdk_nvme_qpair *qpair)
 		return -1;
 	}
 
+free_qpair:
 	TAILQ_REMOVE(&ctrlr->active_io_qpairs, qpair, tailq);
 	TAILQ_INSERT_HEAD(&ctrlr->free_io_qpairs, qpair, tailq);
 
+	if (qpair->active_proc) {
+		TAILQ_REMOVE(&qpair->active_proc->allocated_io_qpairs, qpair, per_process_tailq);
+		qpair->active_proc = NULL;
+	}
+
 	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
 	return 0;
 }
 
+/*
+ * ctrlr->devhandle lives in shared memory and is the primary process's PCI device,
+ *  so every process must go through its own handle.  Until a process has attached
+ *  (construction) and after the last one has detached (destruction), ctrlr->devhandle
+ *  is the calling process's handle.
+ */
+static struct spdk_pci_device *
+nvme_ctrlr_proc_get_devhandle(struct spdk_nvme_ctrlr *ctrlr)
+{
+	struct spdk_nvme_ctrlr_process *proc;
+
+	proc = nvme_ctrlr_get_current_process(ctrlr);
+	if (proc == NULL) {
+		return ctrlr->devhandle;
+	}
+
+	return proc->devhandle;
+}
+
 static void
 nvme_ctrlr_construct_intel_support_log_page_list(struct spdk_nvme_ctrlr *ctrlr,
 		struct spdk_nvme_intel_log_page_directory *log_page_directory)
@@ -214,7 +351,7 @@ nvme_ctrlr_construct_intel_support_log_page_list(struct spdk_nvme_ctrlr *ctrlr,
 	if (ctrlr->cdata.vid != SPDK_PCI_VID_INTEL || log_page_directory == NULL)
 		return;
 
-	dev = ctrlr->devhandle;
+	dev = nvme_ctrlr_proc_get_devhandle(ctrlr);
 	pci_id.vendor_id = spdk_pci_device_get_vendor_id(dev);
 	pci_id.dev_id = spdk_pci_device_get_device_id(dev);
 	pci_id.sub_vendor_id = spdk_pci_device_get_subvendor_id(dev);
@@ -284,7 +421,8 @@ nvme_ctrlr_set_supported_log_pages(struct spdk_nvme_ctrlr *ctrlr)
 	if (ctrlr->cdata.lpa.celp) {
 		ctrlr->log_page_supported[SPDK_NVME_LOG_COMMAND_EFFECTS_LOG] = true;
 	}
-	if (ctrlr->cdata.vid == SPDK_PCI_VID_INTEL) {
+	/* Intel log page quirks are keyed on the PCI IDs, so they only apply to PCIe controllers. */
+	if (ctrlr->cdata.vid == SPDK_PCI_VID_INTEL && ctrlr->transport == NULL) {
 		nvme_ctrlr_set_intel_support_log_pages(ctrlr);
 	}
 }
@@ -344,8 +482,8 @@ static int
 nvme_ctrlr_construct_io_qpairs(struct spdk_nvme_ctrlr *ctrlr)
 {
 	struct spdk_nvme_qpair		*qpair;
-	union spdk_nvme_cap_register	cap;
-	uint32_t			i, num_entries, num_trackers;
+	struct spdk_nvme_io_qpair_opts	opts;
+	uint32_t			i;
 	int				rc;
 	uint64_t			phys_addr = 0;
 
@@ -360,19 +498,10 @@ nvme_ctrlr_construct_io_qpairs(struct spdk_nvme_ctrlr *ctrlr)
 	}
 
 	/*
-	 * NVMe spec sets a hard limit of 64K max entries, but
-	 *  devices may specify a smaller limit, so we need to check
-	 *  the MQES field in the capabilities register.
-	 */
-	cap.raw = nvme_mmio_read_8(ctrlr, cap.raw);
-	num_entries = nvme_min(NVME_IO_ENTRIES, cap.bits.mqes + 1);
-
-	/*
-	 * No need to have more trackers than entries in the submit queue.
-	 *  Note also that for a queue size of N, we can only have (N-1)
-	 *  commands outstanding, hence the "-1" here.
+	 * Queue pairs are preallocated with the default sizes and reallocated when a
+	 *  different size is requested through spdk_nvme_ctrlr_alloc_io_qpair_with_opts().
 	 */
-	num_trackers = nvme_min(NVME_IO_TRACKERS, (num_entries - 1));
+	spdk_nvme_ctrlr_get_default_io_qpair_opts(ctrlr, &opts);
 
 	ctrlr->ioq = nvme_malloc(ctrlr->opts.num_io_queues * sizeof(struct spdk_nvme_qpair),
 				 64, &phys_addr);
@@ -389,8 +518,8 @@ nvme_ctrlr_construct_io_qpairs(struct spdk_nvme_ctrlr *ctrlr)
 		 */
 		rc = nvme_qpair_construct(qpair,
 					  i + 1, /* qpair ID */
-					  num_entries,
-					  num_trackers,
+					  opts.io_queue_size,
+					  opts.io_queue_requests,
 					  ctrlr);
 		if (rc)
 			return -1;
@@ -457,14 +586,17 @@ nvme_ctrlr_enable(struct spdk_nvme_ctrlr *ctrlr)
 		return -EINVAL;
 	}
 
-	nvme_mmio_write_8(ctrlr, asq, ctrlr->adminq.cmd_bus_addr);
-	nvme_mmio_write_8(ctrlr, acq, ctrlr->adminq.cpl_bus_addr);
+	/* The admin queue of a fabrics controller is set up by the Connect command instead. */
+	if (ctrlr->transport == NULL) {
+		nvme_mmio_write_8(ctrlr, asq, ctrlr->adminq.cmd_bus_addr);
+		nvme_mmio_write_8(ctrlr, acq, ctrlr->adminq.cpl_bus_addr);
 
-	aqa.raw = 0;
-	/* acqs and asqs are 0-based. */
-	aqa.bits.acqs = ctrlr->adminq.num_entries - 1;
-	aqa.bits.asqs = ctrlr->adminq.num_entries - 1;
-	nvme_mmio_write_4(ctrlr, aqa.raw, aqa.raw);
+		aqa.raw = 0;
+		/* acqs and asqs are 0-based. */
+		aqa.bits.acqs = ctrlr->adminq.num_entries - 1;
+		aqa.bits.asqs = ctrlr->adminq.num_entries - 1;
+		nvme_mmio_write_4(ctrlr, aqa.raw, aqa.raw);
+	}
 
 	cc.bits.en = 1;
 	cc.bits.css = 0;
@@ -542,6 +674,23 @@ spdk_nvme_ctrlr_reset(struct spdk_nvme_ctrlr *ctrlr)
 		nvme_qpair_disable(&ctrlr->ioq[i]);
 	}
 
+	if (ctrlr->transport != NULL) {
+		/*
+		 * A fabrics controller is reset by tearing down the association and connecting
+		 *  a new admin queue; the I/O queues are reconnected once it is ready again.
+		 */
+		TAILQ_FOREACH(qpair, &ctrlr->active_io_qpairs, tailq) {
+			ctrlr->transport->qpair_disconnect(qpair);
+		}
+		if (ctrlr->transport->qpair_connect(&ctrlr->adminq) != 0) {
+			SPDK_ERRLOG("%s: could not reconnect admin queue\n", __func__);
+			nvme_ctrlr_fail(ctrlr);
+			ctrlr->is_resetting = false;
+			pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+			return -1;
+		}
+	}
+
 	/* Set the state back to INIT to cause a full hardware reset. */
 	nvme_ctrlr_set_state(ctrlr, NVME_CTRLR_STATE_INIT, NVME_TIMEOUT_INFINITE);
 
@@ -650,6 +799,63 @@ nvme_ctrlr_set_num_qpairs(struct spdk_nvme_ctrlr *ctrlr)
 	return 0;
 }
 
+/*
+ * Enable the streams directive for all namespaces and read back how many write
+ *  streams the host may use.  Streams are an optional optimization, so any
+ *  failure here only leaves them disabled.
+ */
+static void
+nvme_ctrlr_enable_streams(struct spdk_nvme_ctrlr *ctrlr)
+{
+	struct nvme_completion_poll_status	status;
+	struct spdk_nvme_streams_params		params;
+	int					rc;
+
+	ctrlr->max_streams = 0;
+
+	if (!ctrlr->cdata.oacs.directives) {
+		return;
+	}
+
+	status.done = false;
+	rc = nvme_ctrlr_cmd_directive_send(ctrlr, SPDK_NVME_GLOBAL_NS_TAG,
+					   SPDK_NVME_IDENTIFY_DIRECTIVE_SEND_ENABLE,
+					   SPDK_NVME_DIRECTIVE_TYPE_IDENTIFY, 0,
+					   (SPDK_NVME_DIRECTIVE_TYPE_STREAMS << 8) | 1,
+					   NULL, 0, nvme_completion_poll_cb, &status);
+	if (rc != 0) {
+		return;
+	}
+
+	while (status.done == false) {
+		spdk_nvme_qpair_process_completions(&ctrlr->adminq, 0);
+	}
+	if (spdk_nvme_cpl_is_error(&status.cpl)) {
+		SPDK_NOTICELOG("Controller does not allow enabling the streams directive\n");
+		return;
+	}
+
+	memset(&params, 0, sizeof(params));
+	status.done = false;
+	rc = nvme_ctrlr_cmd_directive_receive(ctrlr, SPDK_NVME_GLOBAL_NS_TAG,
+					      SPDK_NVME_STREAMS_DIRECTIVE_RECEIVE_RETURN_PARAM,
+					      SPDK_NVME_DIRECTIVE_TYPE_STREAMS, 0, 0,
+					      &params, sizeof(params), nvme_completion_poll_cb, &status);
+	if (rc != 0) {
+		return;
+	}
+
+	while (status.done == false) {
+		spdk_nvme_qpair_process_completions(&ctrlr->adminq, 0);
+	}
+	if (spdk_nvme_cpl_is_error(&status.cpl)) {
+		SPDK_NOTICELOG("Failed to read streams directive parameters\n");
+		return;
+	}
+
+	ctrlr->max_streams = params.msl;
+}
+
 static void
 nvme_ctrlr_destruct_namespaces(struct spdk_nvme_ctrlr *ctrlr)
 {
@@ -660,7 +866,7 @@ nvme_ctrlr_destruct_namespaces(struct spdk_nvme_ctrlr *ctrlr)
 			nvme_ns_destruct(&ctrlr->ns[i]);
 		}
 
-		free(ctrlr->ns);
+		nvme_free(ctrlr->ns);
 		ctrlr->ns = NULL;
 		ctrlr->num_ns = 0;
 	}
@@ -688,7 +894,7 @@ nvme_ctrlr_construct_namespaces(struct spdk_nvme_ctrlr *ctrlr)
 	if (nn != ctrlr->num_ns) {
 		nvme_ctrlr_destruct_namespaces(ctrlr);
 
-		ctrlr->ns = calloc(nn, sizeof(struct spdk_nvme_ns));
+		ctrlr->ns = nvme_malloc(nn * sizeof(struct spdk_nvme_ns), 64, &phys_addr);
 		if (ctrlr->ns == NULL) {
 			goto fail;
 		}
@@ -718,11 +924,29 @@ fail:
 	return -1;
 }
 
+static void
+nvme_ctrlr_proc_queue_aer(struct spdk_nvme_ctrlr_process *proc, const struct spdk_nvme_cpl *cpl)
+{
+	uint32_t tail;
+
+	if (proc->num_pending_aers == NVME_MAX_ASYNC_EVENTS) {
+		/* The process is not polling its admin queue - drop its oldest event. */
+		SPDK_ERRLOG("dropping asynchronous event for process %d\n", (int)proc->pid);
+		proc->pending_aer_head = (proc->pending_aer_head + 1) % NVME_MAX_ASYNC_EVENTS;
+		proc->num_pending_aers--;
+	}
+
+	tail = (proc->pending_aer_head + proc->num_pending_aers) % NVME_MAX_ASYNC_EVENTS;
+	proc->pending_aers[tail] = *cpl;
+	proc->num_pending_aers++;
+}
+
 static void
 nvme_ctrlr_async_event_cb(void *arg, const struct spdk_nvme_cpl *cpl)
 {
 	struct nvme_async_event_request	*aer = arg;
 	struct spdk_nvme_ctrlr		*ctrlr = aer->ctrlr;
+	struct spdk_nvme_ctrlr_process	*proc;
 
 	if (cpl->status.sc == SPDK_NVME_SC_ABORTED_SQ_DELETION) {
 		/*
@@ -734,9 +958,24 @@ nvme_ctrlr_async_event_cb(void *arg, const struct spdk_nvme_cpl *cpl)
 		return;
 	}
 
-	if (ctrlr->aer_cb_fn != NULL) {
-		ctrlr->aer_cb_fn(ctrlr->aer_cb_arg, cpl);
+	/*
+	 * Fan the event out to every attached process.  Callbacks of other processes
+	 *  cannot be called from here, so their events are queued until they next
+	 *  poll the admin queue.
+	 */
+	pthread_mutex_lock(&ctrlr->ctrlr_lock);
+	TAILQ_FOREACH(proc, &ctrlr->active_procs, tailq) {
+		if (proc->aer_cb_fn == NULL) {
+			continue;
+		}
+
+		if (proc->pid == g_spdk_nvme_pid) {
+			proc->aer_cb_fn(proc->aer_cb_arg, cpl);
+		} else {
+			nvme_ctrlr_proc_queue_aer(proc, cpl);
+		}
 	}
+	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
 
 	/*
 	 * Repost another asynchronous event request to replace the one
@@ -915,6 +1154,72 @@ nvme_ctrlr_process_init(struct spdk_nvme_ctrlr *ctrlr)
 	return 0;
 }
 
+static void
+nvme_ctrlr_enable_interrupts(struct spdk_nvme_ctrlr *ctrlr)
+{
+	struct spdk_pci_device *dev;
+	uint32_t i;
+	int rc;
+
+	/*
+	 * The interrupt file descriptors belong to the process that enabled them, so
+	 *  interrupt mode is only available to the primary process.
+	 */
+	if (!nvme_process_is_primary()) {
+		SPDK_NOTICELOG("Interrupts not available in a secondary process\n");
+		ctrlr->opts.enable_interrupts = false;
+		return;
+	}
+
+	dev = nvme_ctrlr_proc_get_devhandle(ctrlr);
+
+	/* Vector 0 is used by the admin queue, and I/O queue N is given vector N. */
+	rc = spdk_pci_device_enable_interrupts(dev, ctrlr->opts.num_io_queues + 1);
+	if (rc < 0) {
+		SPDK_NOTICELOG("Interrupts not available (%d), I/O queues will only be polled\n", rc);
+		ctrlr->opts.enable_interrupts = false;
+		return;
+	}
+
+	ctrlr->num_intr_vectors = rc;
+
+	/*
+	 * Queues are polled until their owner decides to wait for an interrupt, so keep every
+	 *  vector masked until then.  The admin queue (vector 0) is always polled.
+	 */
+	for (i = 0; i < ctrlr->num_intr_vectors; i++) {
+		spdk_pci_device_mask_interrupt(dev, i, true);
+	}
+}
+
+int
+spdk_nvme_qpair_get_interrupt_fd(struct spdk_nvme_qpair *qpair)
+{
+	struct spdk_nvme_ctrlr *ctrlr = qpair->ctrlr;
+
+	if (qpair->id == 0 || qpair->id >= ctrlr->num_intr_vectors || !nvme_process_is_primary()) {
+		return -1;
+	}
+
+	return spdk_pci_device_get_interrupt_fd(nvme_ctrlr_proc_get_devhandle(ctrlr), qpair->id);
+}
+
+int
+spdk_nvme_qpair_mask_interrupt(struct spdk_nvme_qpair *qpair, bool mask)
+{
+	struct spdk_nvme_ctrlr *ctrlr = qpair->ctrlr;
+
+	if (qpair->id == 0 || qpair->id >= ctrlr->num_intr_vectors) {
+		return -EINVAL;
+	}
+
+	if (!nvme_process_is_primary()) {
+		return -ENOTSUP;
+	}
+
+	return spdk_pci_device_mask_interrupt(nvme_ctrlr_proc_get_devhandle(ctrlr), qpair->id, mask);
+}
+
 int
 nvme_ctrlr_start(struct spdk_nvme_ctrlr *ctrlr)
 {
@@ -930,10 +1235,16 @@ nvme_ctrlr_start(struct spdk_nvme_ctrlr *ctrlr)
 		return -1;
 	}
 
+	if (ctrlr->opts.enable_interrupts && ctrlr->num_intr_vectors == 0) {
+		nvme_ctrlr_enable_interrupts(ctrlr);
+	}
+
 	if (nvme_ctrlr_construct_io_qpairs(ctrlr)) {
 		return -1;
 	}
 
+	nvme_ctrlr_enable_streams(ctrlr);
+
 	if (nvme_ctrlr_construct_namespaces(ctrlr) != 0) {
 		return -1;
 	}
@@ -952,6 +1263,28 @@ nvme_ctrlr_start(struct spdk_nvme_ctrlr *ctrlr)
 	return 0;
 }
 
+/* Preallocate the descriptors that track freed CMB I/O data buffers. */
+static int
+nvme_ctrlr_init_cmb_io_bufs(struct spdk_nvme_ctrlr *ctrlr)
+{
+	uint64_t phys_addr;
+	int i;
+
+	ctrlr->cmb_io_bufs = nvme_malloc((ctrlr->cmb_size / PAGE_SIZE) * sizeof(*ctrlr->cmb_io_bufs),
+					 64, &phys_addr);
+	if (ctrlr->cmb_io_bufs == NULL) {
+		SPDK_ERRLOG("could not allocate CMB I/O buffer descriptors\n");
+		return -ENOMEM;
+	}
+
+	pthread_spin_init(&ctrlr->cmb_io_lock, PTHREAD_PROCESS_SHARED);
+	for (i = 0; i < NVME_CMB_IO_BUF_CLASSES; i++) {
+		LIST_INIT(&ctrlr->free_cmb_io_buffers[i]);
+	}
+
+	return 0;
+}
+
 static void
 nvme_ctrlr_map_cmb(struct spdk_nvme_ctrlr *ctrlr)
 {
@@ -979,7 +1312,7 @@ nvme_ctrlr_map_cmb(struct spdk_nvme_ctrlr *ctrlr)
 	/* controller memory buffer offset from BAR in Bytes */
 	offset = unit_size * cmbloc.bits.ofst;
 
-	rc = spdk_pci_device_map_bar(ctrlr->devhandle, bir, &addr,
+	rc = spdk_pci_device_map_bar(nvme_ctrlr_proc_get_devhandle(ctrlr), bir, &addr,
 				     &bar_phys_addr, &bar_size);
 	if ((rc != 0) || addr == NULL) {
 		goto exit;
@@ -1002,9 +1335,16 @@ nvme_ctrlr_map_cmb(struct spdk_nvme_ctrlr *ctrlr)
 		ctrlr->opts.use_cmb_sqs = false;
 	}
 
+	/* An I/O buffer may be used for either direction, so both data transfers must be supported. */
+	ctrlr->cmb_io_data_supported = cmbsz.bits.rds && cmbsz.bits.wds;
+	if (ctrlr->cmb_io_data_supported && nvme_ctrlr_init_cmb_io_bufs(ctrlr) != 0) {
+		ctrlr->cmb_io_data_supported = false;
+	}
+
 	return;
 exit:
 	ctrlr->cmb_bar_virt_addr = NULL;
+	ctrlr->cmb_io_data_supported = false;
 	ctrlr->opts.use_cmb_sqs = false;
 	return;
 }
@@ -1015,10 +1355,20 @@ nvme_ctrlr_unmap_cmb(struct spdk_nvme_ctrlr *ctrlr)
 	int rc = 0;
 	union spdk_nvme_cmbloc_register cmbloc;
 	void *addr = ctrlr->cmb_bar_virt_addr;
+	int i;
+
+	if (ctrlr->cmb_io_bufs != NULL) {
+		for (i = 0; i < NVME_CMB_IO_BUF_CLASSES; i++) {
+			LIST_INIT(&ctrlr->free_cmb_io_buffers[i]);
+		}
+		pthread_spin_destroy(&ctrlr->cmb_io_lock);
+		nvme_free(ctrlr->cmb_io_bufs);
+		ctrlr->cmb_io_bufs = NULL;
+	}
 
 	if (addr) {
 		cmbloc.raw = nvme_mmio_read_4(ctrlr, cmbloc.raw);
-		rc = spdk_pci_device_unmap_bar(ctrlr->devhandle, cmbloc.bits.bir, addr);
+		rc = spdk_pci_device_unmap_bar(nvme_ctrlr_proc_get_devhandle(ctrlr), cmbloc.bits.bir, addr);
 	}
 	return rc;
 }
@@ -1041,6 +1391,88 @@ nvme_ctrlr_alloc_cmb(struct spdk_nvme_ctrlr *ctrlr, uint64_t length, uint64_t al
 	return 0;
 }
 
+/*
+ * The CMB is a bump allocator, so only the most recent reservation can be handed back.
+ */
+void
+nvme_ctrlr_free_cmb(struct spdk_nvme_ctrlr *ctrlr, uint64_t offset, uint64_t length)
+{
+	if (offset + length == ctrlr->cmb_current_offset) {
+		ctrlr->cmb_current_offset = offset;
+	}
+}
+
+static inline uint32_t
+nvme_cmb_io_buf_class(uint64_t size)
+{
+	uint64_t pages = size / PAGE_SIZE;
+
+	return pages < NVME_CMB_IO_BUF_CLASSES ? pages - 1 : NVME_CMB_IO_BUF_CLASSES - 1;
+}
+
+void *
+spdk_nvme_ctrlr_alloc_cmb_io_buffer(struct spdk_nvme_ctrlr *ctrlr, size_t size)
+{
+	struct nvme_cmb_io_buffer *cmb_buf;
+	uint32_t buf_class;
+	uint64_t offset;
+	void *buf = NULL;
+
+	if (!ctrlr->cmb_io_data_supported || size == 0) {
+		return NULL;
+	}
+
+	size = (size + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+	buf_class = nvme_cmb_io_buf_class(size);
+
+	pthread_spin_lock(&ctrlr->cmb_io_lock);
+	LIST_FOREACH(cmb_buf, &ctrlr->free_cmb_io_buffers[buf_class], link) {
+		/* Only the list of the largest sizes holds more than one size */
+		if (cmb_buf->size == size) {
+			LIST_REMOVE(cmb_buf, link);
+			buf = (uint8_t *)ctrlr->cmb_bar_virt_addr +
+			      (uint64_t)(cmb_buf - ctrlr->cmb_io_bufs) * PAGE_SIZE;
+			break;
+		}
+	}
+	pthread_spin_unlock(&ctrlr->cmb_io_lock);
+
+	if (buf != NULL) {
+		return buf;
+	}
+
+	/* The CMB space itself is shared with the submission queues */
+	pthread_mutex_lock(&ctrlr->ctrlr_lock);
+	if (nvme_ctrlr_alloc_cmb(ctrlr, size, PAGE_SIZE, &offset) == 0) {
+		buf = (uint8_t *)ctrlr->cmb_bar_virt_addr + offset;
+		ctrlr->cmb_io_data_used = true;
+	}
+	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+
+	return buf;
+}
+
+void
+spdk_nvme_ctrlr_free_cmb_io_buffer(struct spdk_nvme_ctrlr *ctrlr, void *buf, size_t size)
+{
+	struct nvme_cmb_io_buffer *cmb_buf;
+	uint64_t offset;
+
+	if (buf == NULL) {
+		return;
+	}
+
+	offset = (uint8_t *)buf - (uint8_t *)ctrlr->cmb_bar_virt_addr;
+	assert(offset % PAGE_SIZE == 0 && offset < ctrlr->cmb_size);
+	cmb_buf = &ctrlr->cmb_io_bufs[offset / PAGE_SIZE];
+	cmb_buf->size = (size + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+
+	pthread_spin_lock(&ctrlr->cmb_io_lock);
+	LIST_INSERT_HEAD(&ctrlr->free_cmb_io_buffers[nvme_cmb_io_buf_class(cmb_buf->size)], cmb_buf,
+			 link);
+	pthread_spin_unlock(&ctrlr->cmb_io_lock);
+}
+
 static int
 nvme_ctrlr_allocate_bars(struct spdk_nvme_ctrlr *ctrlr)
 {
@@ -1048,7 +1480,7 @@ nvme_ctrlr_allocate_bars(struct spdk_nvme_ctrlr *ctrlr)
 	void *addr;
 	uint64_t phys_addr, size;
 
-	rc = spdk_pci_device_map_bar(ctrlr->devhandle, 0, &addr,
+	rc = spdk_pci_device_map_bar(nvme_ctrlr_proc_get_devhandle(ctrlr), 0, &addr,
 				     &phys_addr, &size);
 	ctrlr->regs = (volatile struct spdk_nvme_registers *)addr;
 	if ((ctrlr->regs == NULL) || (rc != 0)) {
@@ -1075,7 +1507,7 @@ nvme_ctrlr_free_bars(struct spdk_nvme_ctrlr *ctrlr)
 	}
 
 	if (addr) {
-		rc = spdk_pci_device_unmap_bar(ctrlr->devhandle, 0, addr);
+		rc = spdk_pci_device_unmap_bar(nvme_ctrlr_proc_get_devhandle(ctrlr), 0, addr);
 	}
 	return rc;
 }
@@ -1089,7 +1521,9 @@ pthread_mutex_init_recursive(pthread_mutex_t *mtx)
 	if (pthread_mutexattr_init(&attr)) {
 		return -1;
 	}
+	/* The controller may be shared with secondary processes. */
 	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) ||
+	    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) ||
 	    pthread_mutex_init(mtx, &attr)) {
 		rc = -1;
 	}
@@ -1108,6 +1542,12 @@ nvme_ctrlr_construct(struct spdk_nvme_ctrlr *ctrlr, void *devhandle)
 	nvme_ctrlr_set_state(ctrlr, NVME_CTRLR_STATE_INIT, NVME_TIMEOUT_INFINITE);
 	ctrlr->devhandle = devhandle;
 	ctrlr->flags = 0;
+	TAILQ_INIT(&ctrlr->active_procs);
+
+	ctrlr->pci_addr.domain = spdk_pci_device_get_domain(devhandle);
+	ctrlr->pci_addr.bus = spdk_pci_device_get_bus(devhandle);
+	ctrlr->pci_addr.dev = spdk_pci_device_get_dev(devhandle);
+	ctrlr->pci_addr.func = spdk_pci_device_get_func(devhandle);
 
 	status = nvme_ctrlr_allocate_bars(ctrlr);
 	if (status != 0) {
@@ -1142,10 +1582,54 @@ nvme_ctrlr_construct(struct spdk_nvme_ctrlr *ctrlr, void *devhandle)
 	return 0;
 }
 
+int
+nvme_ctrlr_construct_fabrics(struct spdk_nvme_ctrlr *ctrlr, const struct nvme_transport *transport,
+			     const struct spdk_nvme_transport_id *trid)
+{
+	union spdk_nvme_cap_register	cap;
+	int				rc;
+
+	nvme_ctrlr_set_state(ctrlr, NVME_CTRLR_STATE_INIT, NVME_TIMEOUT_INFINITE);
+	ctrlr->transport = transport;
+	ctrlr->trid = *trid;
+	ctrlr->devhandle = NULL;
+	ctrlr->flags = 0;
+	TAILQ_INIT(&ctrlr->active_procs);
+
+	rc = nvme_ctrlr_construct_admin_qpair(ctrlr);
+	if (rc)
+		return rc;
+
+	/* The admin queue must be connected before any property can be read. */
+	rc = transport->qpair_connect(&ctrlr->adminq);
+	if (rc) {
+		nvme_qpair_destroy(&ctrlr->adminq);
+		return rc;
+	}
+
+	cap.raw = nvme_mmio_read_8(ctrlr, cap.raw);
+
+	/* There are no doorbells; queues are driven through the transport. */
+	ctrlr->doorbell_stride_u32 = 0;
+
+	ctrlr->min_page_size = 1 << (12 + cap.bits.mpsmin);
+
+	ctrlr->is_resetting = false;
+	ctrlr->is_failed = false;
+
+	TAILQ_INIT(&ctrlr->free_io_qpairs);
+	TAILQ_INIT(&ctrlr->active_io_qpairs);
+
+	pthread_mutex_init_recursive(&ctrlr->ctrlr_lock);
+
+	return 0;
+}
+
 void
 nvme_ctrlr_destruct(struct spdk_nvme_ctrlr *ctrlr)
 {
-	uint32_t	i;
+	struct spdk_nvme_ctrlr_process	*proc;
+	uint32_t			i;
 
 	while (!TAILQ_EMPTY(&ctrlr->active_io_qpairs)) {
 		struct spdk_nvme_qpair *qpair = TAILQ_FIRST(&ctrlr->active_io_qpairs);
@@ -1166,7 +1650,20 @@ nvme_ctrlr_destruct(struct spdk_nvme_ctrlr *ctrlr)
 
 	nvme_qpair_destroy(&ctrlr->adminq);
 
-	nvme_ctrlr_free_bars(ctrlr);
+	if (ctrlr->num_intr_vectors != 0) {
+		spdk_pci_device_disable_interrupts(nvme_ctrlr_proc_get_devhandle(ctrlr));
+		ctrlr->num_intr_vectors = 0;
+	}
+
+	if (ctrlr->transport == NULL) {
+		nvme_ctrlr_free_bars(ctrlr);
+	}
+
+	while ((proc = TAILQ_FIRST(&ctrlr->active_procs)) != NULL) {
+		TAILQ_REMOVE(&ctrlr->active_procs, proc, tailq);
+		nvme_ctrlr_free_process(proc);
+	}
+
 	pthread_mutex_destroy(&ctrlr->ctrlr_lock);
 }
 
@@ -1177,6 +1674,190 @@ nvme_ctrlr_submit_admin_request(struct spdk_nvme_ctrlr *ctrlr,
 	return nvme_qpair_submit_request(&ctrlr->adminq, req);
 }
 
+bool
+nvme_ctrlr_matches_pci_dev(struct spdk_nvme_ctrlr *ctrlr, struct spdk_pci_device *pci_dev)
+{
+	if (ctrlr->transport != NULL) {
+		return false;
+	}
+
+	return ctrlr->pci_addr.domain == spdk_pci_device_get_domain(pci_dev) &&
+	       ctrlr->pci_addr.bus == spdk_pci_device_get_bus(pci_dev) &&
+	       ctrlr->pci_addr.dev == spdk_pci_device_get_dev(pci_dev) &&
+	       ctrlr->pci_addr.func == spdk_pci_device_get_func(pci_dev);
+}
+
+struct spdk_nvme_ctrlr_process *
+nvme_ctrlr_get_current_process(struct spdk_nvme_ctrlr *ctrlr)
+{
+	struct spdk_nvme_ctrlr_process *proc;
+
+	TAILQ_FOREACH(proc, &ctrlr->active_procs, tailq) {
+		if (proc->pid == g_spdk_nvme_pid) {
+			return proc;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Release the per-process state of a process that is detaching or has exited.
+ *  The caller must hold ctrlr_lock and have removed proc from active_procs.
+ */
+static void
+nvme_ctrlr_free_process(struct spdk_nvme_ctrlr_process *proc)
+{
+	struct spdk_nvme_qpair	*qpair;
+	struct nvme_request	*req;
+
+	while ((qpair = TAILQ_FIRST(&proc->allocated_io_qpairs)) != NULL) {
+		if (spdk_nvme_ctrlr_free_io_qpair(qpair) != 0) {
+			/* Still stop tracking the qpair so that this loop terminates. */
+			TAILQ_REMOVE(&proc->allocated_io_qpairs, qpair, per_process_tailq);
+			qpair->active_proc = NULL;
+		}
+	}
+
+	while ((req = STAILQ_FIRST(&proc->active_reqs)) != NULL) {
+		STAILQ_REMOVE_HEAD(&proc->active_reqs, stailq);
+		nvme_free_request(req);
+	}
+
+	nvme_free(proc);
+}
+
+/*
+ * Free the state of processes that exited without detaching the controller.
+ *  The caller must hold ctrlr_lock.
+ */
+static void
+nvme_ctrlr_remove_inactive_procs(struct spdk_nvme_ctrlr *ctrlr)
+{
+	struct spdk_nvme_ctrlr_process *proc, *tmp;
+
+	TAILQ_FOREACH_SAFE(proc, &ctrlr->active_procs, tailq, tmp) {
+		if (kill(proc->pid, 0) == -1 && errno == ESRCH) {
+			SPDK_NOTICELOG("process %d exited without detaching the controller\n",
+				       (int)proc->pid);
+			TAILQ_REMOVE(&ctrlr->active_procs, proc, tailq);
+			nvme_ctrlr_free_process(proc);
+		}
+	}
+}
+
+int
+nvme_ctrlr_add_process(struct spdk_nvme_ctrlr *ctrlr, void *devhandle)
+{
+	struct spdk_nvme_ctrlr_process	*proc;
+	uint64_t			phys_addr;
+
+	proc = nvme_malloc(sizeof(*proc), 64, &phys_addr);
+	if (proc == NULL) {
+		SPDK_ERRLOG("could not allocate process state for the controller\n");
+		return -ENOMEM;
+	}
+
+	proc->is_primary = nvme_process_is_primary();
+	proc->pid = g_spdk_nvme_pid;
+	proc->devhandle = devhandle;
+	STAILQ_INIT(&proc->active_reqs);
+	TAILQ_INIT(&proc->allocated_io_qpairs);
+
+	pthread_mutex_lock(&ctrlr->ctrlr_lock);
+	nvme_ctrlr_remove_inactive_procs(ctrlr);
+	TAILQ_INSERT_TAIL(&ctrlr->active_procs, proc, tailq);
+	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+
+	return 0;
+}
+
+void
+nvme_ctrlr_remove_process(struct spdk_nvme_ctrlr *ctrlr)
+{
+	struct spdk_nvme_ctrlr_process *proc;
+
+	pthread_mutex_lock(&ctrlr->ctrlr_lock);
+
+	proc = nvme_ctrlr_get_current_process(ctrlr);
+	if (proc != NULL) {
+		TAILQ_REMOVE(&ctrlr->active_procs, proc, tailq);
+
+		if (TAILQ_EMPTY(&ctrlr->active_procs)) {
+			/* The last process destroys the controller through its own mapping of it. */
+			ctrlr->devhandle = proc->devhandle;
+		}
+
+		nvme_ctrlr_free_process(proc);
+	}
+
+	nvme_ctrlr_remove_inactive_procs(ctrlr);
+
+	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+}
+
+void
+nvme_ctrlr_queue_proc_admin_request(struct spdk_nvme_ctrlr *ctrlr, struct nvme_request *req,
+				    const struct spdk_nvme_cpl *cpl)
+{
+	struct spdk_nvme_ctrlr_process *proc;
+
+	pthread_mutex_lock(&ctrlr->ctrlr_lock);
+
+	TAILQ_FOREACH(proc, &ctrlr->active_procs, tailq) {
+		if (proc->pid == req->pid) {
+			break;
+		}
+	}
+
+	if (proc == NULL) {
+		/* The submitting process is gone - nobody is left to complete the request. */
+		nvme_free_request(req);
+	} else {
+		req->cpl = *cpl;
+		STAILQ_INSERT_TAIL(&proc->active_reqs, req, stailq);
+	}
+
+	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+}
+
+void
+nvme_ctrlr_complete_proc_admin_requests(struct spdk_nvme_ctrlr *ctrlr)
+{
+	struct spdk_nvme_ctrlr_process	*proc;
+	struct nvme_request		*req;
+	struct spdk_nvme_cpl		cpl;
+
+	pthread_mutex_lock(&ctrlr->ctrlr_lock);
+
+	proc = nvme_ctrlr_get_current_process(ctrlr);
+	if (proc == NULL) {
+		pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+		return;
+	}
+
+	/* Complete admin requests of this process that another process reaped. */
+	while ((req = STAILQ_FIRST(&proc->active_reqs)) != NULL) {
+		STAILQ_REMOVE_HEAD(&proc->active_reqs, stailq);
+		if (req->cb_fn) {
+			req->cb_fn(req->cb_arg, &req->cpl);
+		}
+		nvme_free_request(req);
+	}
+
+	/* Deliver asynchronous events that were fanned out by the primary process. */
+	while (proc->num_pending_aers > 0) {
+		cpl = proc->pending_aers[proc->pending_aer_head];
+		proc->pending_aer_head = (proc->pending_aer_head + 1) % NVME_MAX_ASYNC_EVENTS;
+		proc->num_pending_aers--;
+		if (proc->aer_cb_fn != NULL) {
+			proc->aer_cb_fn(proc->aer_cb_arg, &cpl);
+		}
+	}
+
+	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+}
+
 int32_t
 spdk_nvme_ctrlr_process_admin_completions(struct spdk_nvme_ctrlr *ctrlr)
 {
@@ -1195,6 +1876,12 @@ spdk_nvme_ctrlr_get_data(struct spdk_nvme_ctrlr *ctrlr)
 	return &ctrlr->cdata;
 }
 
+bool
+spdk_nvme_ctrlr_is_failed(struct spdk_nvme_ctrlr *ctrlr)
+{
+	return ctrlr->is_failed;
+}
+
 union spdk_nvme_cap_register spdk_nvme_ctrlr_get_regs_cap(struct spdk_nvme_ctrlr *ctrlr)
 {
 	union spdk_nvme_cap_register cap;
@@ -1211,6 +1898,14 @@ union spdk_nvme_vs_register spdk_nvme_ctrlr_get_regs_vs(struct spdk_nvme_ctrlr *
 	return vs;
 }
 
+union spdk_nvme_cmbsz_register spdk_nvme_ctrlr_get_regs_cmbsz(struct spdk_nvme_ctrlr *ctrlr)
+{
+	union spdk_nvme_cmbsz_register cmbsz;
+
+	cmbsz.raw = nvme_mmio_read_4(ctrlr, cmbsz.raw);
+	return cmbsz;
+}
+
 uint32_t
 spdk_nvme_ctrlr_get_num_ns(struct spdk_nvme_ctrlr *ctrlr)
 {
@@ -1232,8 +1927,49 @@ spdk_nvme_ctrlr_register_aer_callback(struct spdk_nvme_ctrlr *ctrlr,
 				      spdk_nvme_aer_cb aer_cb_fn,
 				      void *aer_cb_arg)
 {
-	ctrlr->aer_cb_fn = aer_cb_fn;
-	ctrlr->aer_cb_arg = aer_cb_arg;
+	struct spdk_nvme_ctrlr_process *proc;
+
+	/* Each process sharing the controller registers its own callback. */
+	pthread_mutex_lock(&ctrlr->ctrlr_lock);
+	proc = nvme_ctrlr_get_current_process(ctrlr);
+	if (proc != NULL) {
+		proc->aer_cb_fn = aer_cb_fn;
+		proc->aer_cb_arg = aer_cb_arg;
+	}
+	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+}
+
+void
+spdk_nvme_ctrlr_register_timeout_callback(struct spdk_nvme_ctrlr *ctrlr,
+		uint32_t timeout_sec, spdk_nvme_timeout_cb cb_fn, void *cb_arg)
+{
+	struct spdk_nvme_qpair *qpair;
+
+	if (timeout_sec == 0 || cb_fn == NULL) {
+		ctrlr->timeout_cb_fn = NULL;
+		ctrlr->timeout_cb_arg = NULL;
+		ctrlr->timeout_ticks = 0;
+		return;
+	}
+
+	if (timeout_sec < NVME_MIN_TIMEOUT_PERIOD) {
+		timeout_sec = NVME_MIN_TIMEOUT_PERIOD;
+	} else if (timeout_sec > NVME_MAX_TIMEOUT_PERIOD) {
+		timeout_sec = NVME_MAX_TIMEOUT_PERIOD;
+	}
+
+	ctrlr->timeout_ticks = timeout_sec * nvme_get_tsc_hz();
+	ctrlr->timeout_cb_arg = cb_arg;
+	ctrlr->timeout_pid = g_spdk_nvme_pid;
+	ctrlr->timeout_cb_fn = cb_fn;
+
+	/* The timeout may have shrunk - force the next completion poll to rescan its trackers. */
+	pthread_mutex_lock(&ctrlr->ctrlr_lock);
+	ctrlr->adminq.next_timeout_tick = 0;
+	TAILQ_FOREACH(qpair, &ctrlr->active_io_qpairs, tailq) {
+		qpair->next_timeout_tick = 0;
+	}
+	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
 }
 
 bool
@@ -1380,60 +2116,166 @@ spdk_nvme_ctrlr_format(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
 }
 
 int
-spdk_nvme_ctrlr_update_firmware(struct spdk_nvme_ctrlr *ctrlr, void *payload, uint32_t size,
-				int slot)
+spdk_nvme_ctrlr_attach_ns_async(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+				struct spdk_nvme_ctrlr_list *payload,
+				spdk_nvme_cmd_cb cb_fn, void *cb_arg)
 {
-	struct spdk_nvme_fw_commit		fw_commit;
-	struct nvme_completion_poll_status	status;
-	int					res;
-	unsigned int				size_remaining;
-	unsigned int				offset;
-	unsigned int				transfer;
-	void					*p;
+	return nvme_ctrlr_cmd_attach_ns(ctrlr, nsid, payload, cb_fn, cb_arg);
+}
 
-	if (size % 4) {
-		SPDK_ERRLOG("spdk_nvme_ctrlr_update_firmware invalid size!\n");
-		return -1;
+int
+spdk_nvme_ctrlr_detach_ns_async(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+				struct spdk_nvme_ctrlr_list *payload,
+				spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+	return nvme_ctrlr_cmd_detach_ns(ctrlr, nsid, payload, cb_fn, cb_arg);
+}
+
+int
+spdk_nvme_ctrlr_create_ns_async(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_ns_data *payload,
+				spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+	return nvme_ctrlr_cmd_create_ns(ctrlr, payload, cb_fn, cb_arg);
+}
+
+int
+spdk_nvme_ctrlr_delete_ns_async(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+				spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+	return nvme_ctrlr_cmd_delete_ns(ctrlr, nsid, cb_fn, cb_arg);
+}
+
+int
+spdk_nvme_ctrlr_format_async(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+			     struct spdk_nvme_format *format,
+			     spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+	return nvme_ctrlr_cmd_format(ctrlr, nsid, format, cb_fn, cb_arg);
+}
+
+/*
+ * State of a firmware update.  Each download command is submitted from the completion of the
+ *  previous one, followed by the commit command.
+ */
+struct nvme_fw_update_ctx {
+	struct spdk_nvme_ctrlr	*ctrlr;
+	uint8_t			*payload;
+	uint32_t		size;
+	uint32_t		offset;
+	uint32_t		transfer;
+	int			slot;
+	spdk_nvme_cmd_cb	cb_fn;
+	void			*cb_arg;
+};
+
+static void
+nvme_fw_update_ctx_complete(struct nvme_fw_update_ctx *ctx, const struct spdk_nvme_cpl *cpl)
+{
+	if (ctx->cb_fn) {
+		ctx->cb_fn(ctx->cb_arg, cpl);
 	}
+	free(ctx);
+}
 
-	/* Firmware download */
-	size_remaining = size;
-	offset = 0;
-	p = payload;
+static void
+nvme_fw_update_commit_done(void *arg, const struct spdk_nvme_cpl *cpl)
+{
+	if (spdk_nvme_cpl_is_error(cpl)) {
+		SPDK_ERRLOG("nvme_ctrlr_cmd_fw_commit failed!\n");
+	}
+	nvme_fw_update_ctx_complete(arg, cpl);
+}
 
-	while (size_remaining > 0) {
-		transfer = nvme_min(size_remaining, ctrlr->min_page_size);
-		status.done = false;
+static void nvme_fw_update_download_done(void *arg, const struct spdk_nvme_cpl *cpl);
 
-		res = nvme_ctrlr_cmd_fw_image_download(ctrlr, transfer, offset, p,
-						       nvme_completion_poll_cb,
-						       &status);
-		if (res)
-			return res;
+static int
+nvme_fw_update_submit_next(struct nvme_fw_update_ctx *ctx)
+{
+	struct spdk_nvme_fw_commit	fw_commit;
 
-		while (status.done == false) {
-			pthread_mutex_lock(&ctrlr->ctrlr_lock);
-			spdk_nvme_qpair_process_completions(&ctrlr->adminq, 0);
-			pthread_mutex_unlock(&ctrlr->ctrlr_lock);
-		}
-		if (spdk_nvme_cpl_is_error(&status.cpl)) {
-			SPDK_ERRLOG("spdk_nvme_ctrlr_fw_image_download failed!\n");
-			return -ENXIO;
-		}
-		p += transfer;
-		offset += transfer;
-		size_remaining -= transfer;
+	if (ctx->offset < ctx->size) {
+		ctx->transfer = nvme_min(ctx->size - ctx->offset, ctx->ctrlr->min_page_size);
+		return nvme_ctrlr_cmd_fw_image_download(ctx->ctrlr, ctx->transfer, ctx->offset,
+							ctx->payload + ctx->offset,
+							nvme_fw_update_download_done, ctx);
 	}
 
-	/* Firmware commit */
 	memset(&fw_commit, 0, sizeof(struct spdk_nvme_fw_commit));
-	fw_commit.fs = slot;
+	fw_commit.fs = ctx->slot;
 	fw_commit.ca = SPDK_NVME_FW_COMMIT_REPLACE_IMG;
 
-	status.done = false;
+	return nvme_ctrlr_cmd_fw_commit(ctx->ctrlr, &fw_commit, nvme_fw_update_commit_done, ctx);
+}
+
+static void
+nvme_fw_update_download_done(void *arg, const struct spdk_nvme_cpl *cpl)
+{
+	struct nvme_fw_update_ctx	*ctx = arg;
+	struct spdk_nvme_cpl		status;
+
+	if (spdk_nvme_cpl_is_error(cpl)) {
+		SPDK_ERRLOG("spdk_nvme_ctrlr_fw_image_download failed!\n");
+		nvme_fw_update_ctx_complete(ctx, cpl);
+		return;
+	}
+
+	ctx->offset += ctx->transfer;
+	if (nvme_fw_update_submit_next(ctx) != 0) {
+		memset(&status, 0, sizeof(status));
+		status.status.sct = SPDK_NVME_SCT_GENERIC;
+		status.status.sc = SPDK_NVME_SC_INTERNAL_DEVICE_ERROR;
+		nvme_fw_update_ctx_complete(ctx, &status);
+	}
+}
+
+int
+spdk_nvme_ctrlr_update_firmware_async(struct spdk_nvme_ctrlr *ctrlr, void *payload,
+				      uint32_t size, int slot,
+				      spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+	struct nvme_fw_update_ctx	*ctx;
+	int				rc;
+
+	if (size % 4) {
+		SPDK_ERRLOG("spdk_nvme_ctrlr_update_firmware invalid size!\n");
+		return -EINVAL;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		return -ENOMEM;
+	}
+
+	ctx->ctrlr = ctrlr;
+	ctx->payload = payload;
+	ctx->size = size;
+	ctx->slot = slot;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+
+	rc = nvme_fw_update_submit_next(ctx);
+	if (rc != 0) {
+		free(ctx);
+	}
+
+	return rc;
+}
+
+int
+spdk_nvme_ctrlr_update_firmware(struct spdk_nvme_ctrlr *ctrlr, void *payload, uint32_t size,
+				int slot)
+{
+	struct nvme_completion_poll_status	status;
+	int					res;
 
-	res = nvme_ctrlr_cmd_fw_commit(ctrlr, &fw_commit, nvme_completion_poll_cb,
-				       &status);
+	if (size % 4) {
+		SPDK_ERRLOG("spdk_nvme_ctrlr_update_firmware invalid size!\n");
+		return -1;
+	}
+
+	status.done = false;
+	res = spdk_nvme_ctrlr_update_firmware_async(ctrlr, payload, size, slot,
+			nvme_completion_poll_cb, &status);
 	if (res)
 		return res;
 
@@ -1443,7 +2285,6 @@ spdk_nvme_ctrlr_update_firmware(struct spdk_nvme_ctrlr *ctrlr, void *payload, ui
 		pthread_mutex_unlock(&ctrlr->ctrlr_lock);
 	}
 	if (spdk_nvme_cpl_is_error(&status.cpl)) {
-		SPDK_ERRLOG("nvme_ctrlr_cmd_fw_commit failed!\n");
 		return -ENXIO;
 	}
 
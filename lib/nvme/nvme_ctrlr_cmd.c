@@ -151,8 +151,13 @@ nvme_ctrlr_cmd_create_io_cq(struct spdk_nvme_ctrlr *ctrlr,
 	/*
 	 * 0x2 = interrupts enabled
 	 * 0x1 = physically contiguous
+	 *
+	 * Interrupt vector N is reserved for I/O queue N when the controller has it.
 	 */
 	cmd->cdw11 = 0x1;
+	if (io_que->id < ctrlr->num_intr_vectors) {
+		cmd->cdw11 |= ((uint32_t)io_que->id << 16) | 0x2;
+	}
 	cmd->dptr.prp.prp1 = io_que->cpl_bus_addr;
 
 	return nvme_ctrlr_submit_admin_request(ctrlr, req);
@@ -462,14 +467,24 @@ spdk_nvme_ctrlr_cmd_get_log_page(struct spdk_nvme_ctrlr *ctrlr, uint8_t log_page
 }
 
 int
-nvme_ctrlr_cmd_abort(struct spdk_nvme_ctrlr *ctrlr, uint16_t cid,
-		     uint16_t sqid, spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+spdk_nvme_ctrlr_cmd_abort(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_qpair *qpair,
+			  uint16_t cid, spdk_nvme_cmd_cb cb_fn, void *cb_arg)
 {
 	struct nvme_request *req;
 	struct spdk_nvme_cmd *cmd;
+	uint16_t sqid;
+	int rc;
+
+	if (qpair) {
+		sqid = qpair->id;
+	} else {
+		sqid = ctrlr->adminq.id; /* 0 */
+	}
 
+	pthread_mutex_lock(&ctrlr->ctrlr_lock);
 	req = nvme_allocate_request_null(cb_fn, cb_arg);
 	if (req == NULL) {
+		pthread_mutex_unlock(&ctrlr->ctrlr_lock);
 		return -ENOMEM;
 	}
 
@@ -477,7 +492,10 @@ nvme_ctrlr_cmd_abort(struct spdk_nvme_ctrlr *ctrlr, uint16_t cid,
 	cmd->opc = SPDK_NVME_OPC_ABORT;
 	cmd->cdw10 = (cid << 16) | sqid;
 
-	return nvme_ctrlr_submit_admin_request(ctrlr, req);
+	rc = nvme_ctrlr_submit_admin_request(ctrlr, req);
+	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+
+	return rc;
 }
 
 int
@@ -533,3 +551,67 @@ nvme_ctrlr_cmd_fw_image_download(struct spdk_nvme_ctrlr *ctrlr,
 
 	return rc;
 }
+
+int
+nvme_ctrlr_cmd_directive_send(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+			      uint32_t doper, uint32_t dtype, uint32_t dspec, uint32_t cdw12,
+			      void *payload, uint32_t payload_size,
+			      spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+	struct nvme_request *req;
+	struct spdk_nvme_cmd *cmd;
+	int rc;
+
+	pthread_mutex_lock(&ctrlr->ctrlr_lock);
+	if (payload_size) {
+		req = nvme_allocate_request_user_copy(payload, payload_size, cb_fn, cb_arg, true);
+	} else {
+		req = nvme_allocate_request_null(cb_fn, cb_arg);
+	}
+	if (req == NULL) {
+		pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+		return -ENOMEM;
+	}
+
+	cmd = &req->cmd;
+	cmd->opc = SPDK_NVME_OPC_DIRECTIVE_SEND;
+	cmd->nsid = nsid;
+	cmd->cdw10 = payload_size ? (payload_size >> 2) - 1 : 0;
+	cmd->cdw11 = (dspec << 16) | (dtype << 8) | doper;
+	cmd->cdw12 = cdw12;
+
+	rc = nvme_ctrlr_submit_admin_request(ctrlr, req);
+	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+
+	return rc;
+}
+
+int
+nvme_ctrlr_cmd_directive_receive(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+				 uint32_t doper, uint32_t dtype, uint32_t dspec, uint32_t cdw12,
+				 void *payload, uint32_t payload_size,
+				 spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+	struct nvme_request *req;
+	struct spdk_nvme_cmd *cmd;
+	int rc;
+
+	pthread_mutex_lock(&ctrlr->ctrlr_lock);
+	req = nvme_allocate_request_user_copy(payload, payload_size, cb_fn, cb_arg, false);
+	if (req == NULL) {
+		pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+		return -ENOMEM;
+	}
+
+	cmd = &req->cmd;
+	cmd->opc = SPDK_NVME_OPC_DIRECTIVE_RECEIVE;
+	cmd->nsid = nsid;
+	cmd->cdw10 = (payload_size >> 2) - 1;
+	cmd->cdw11 = (dspec << 16) | (dtype << 8) | doper;
+	cmd->cdw12 = cdw12;
+
+	rc = nvme_ctrlr_submit_admin_request(ctrlr, req);
+	pthread_mutex_unlock(&ctrlr->ctrlr_lock);
+
+	return rc;
+}
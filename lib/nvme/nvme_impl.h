@@ -92,6 +92,8 @@
  */
 #define nvme_memzone_reserve		spdk_memzone_reserve
 
+#define NVME_SOCKET_ID_ANY		SOCKET_ID_ANY
+
 /**
  * Lookup the memory zone identified by the given name.
  * Return a pointer to the reserved memory address. If the reservation
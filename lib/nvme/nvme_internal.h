@@ -38,6 +38,7 @@
 
 #include <errno.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -52,10 +53,22 @@
 
 #include "spdk/queue.h"
 #include "spdk/barrier.h"
+#include "spdk/likely.h"
 #include "spdk/log.h"
 #include "spdk/mmio.h"
 #include "spdk/pci_ids.h"
 #include "spdk/nvme_intel.h"
+#include "spdk/trace.h"
+
+#define OWNER_NVME_QPAIR		0x40
+#define OBJECT_NVME_CMD			0x40
+
+#define TRACE_GROUP_NVME		0x4
+#define TRACE_NVME_SUBMIT		SPDK_TPOINT_ID(TRACE_GROUP_NVME, 0x0)
+#define TRACE_NVME_COMPLETE		SPDK_TPOINT_ID(TRACE_GROUP_NVME, 0x1)
+#define TRACE_NVME_QUEUED		SPDK_TPOINT_ID(TRACE_GROUP_NVME, 0x2)
+#define TRACE_NVME_SPLIT		SPDK_TPOINT_ID(TRACE_GROUP_NVME, 0x3)
+#define TRACE_NVME_RETRY		SPDK_TPOINT_ID(TRACE_GROUP_NVME, 0x4)
 
 /*
  * Some Intel devices support vendor-unique read latency log page even
@@ -80,6 +93,12 @@
  */
 #define NVME_MAX_XFER_SIZE	NVME_MAX_PRP_LIST_ENTRIES * PAGE_SIZE
 
+/*
+ * nvme_vtophys() translates at hugepage granularity, so a virtually contiguous
+ *  buffer is also physically contiguous within each aligned 2MB region.
+ */
+#define NVME_VTOPHYS_PAGE_SIZE	(1ULL << 21)
+
 #define NVME_ADMIN_TRACKERS	(16)
 #define NVME_ADMIN_ENTRIES	(128)
 /* min and max are defined in admin queue attributes section of spec */
@@ -99,6 +118,14 @@
 #define NVME_MIN_IO_TRACKERS	(4)
 #define NVME_MAX_IO_TRACKERS	(1024)
 
+/*
+ * The adaptive depth limiter never goes below two outstanding commands, so that fused
+ *  operations can still be submitted, and averages latency over at least
+ *  NVME_DEPTH_LIMITER_MIN_WINDOW completions.
+ */
+#define NVME_DEPTH_LIMITER_MIN_DEPTH	(2)
+#define NVME_DEPTH_LIMITER_MIN_WINDOW	(8)
+
 /*
  * NVME_MAX_SGL_DESCRIPTORS defines the maximum number of descriptors in one SGL
  *  segment.
@@ -118,12 +145,19 @@
 /* Maximum log page size to fetch for AERs. */
 #define NVME_MAX_AER_LOG_SIZE		(4096)
 
+/*
+ * Freed CMB I/O data buffers of fewer pages than this are kept on one free list per size,
+ *  so that reusing one never searches.
+ */
+#define NVME_CMB_IO_BUF_CLASSES		(16)
+
 /*
  * NVME_MAX_IO_QUEUES in nvme_spec.h defines the 64K spec-limit, but this
  *  define specifies the maximum number of queues this driver will actually
  *  try to configure, if available.
  */
 #define DEFAULT_MAX_IO_QUEUES		(1024)
+#define DEFAULT_HOSTNQN			"nqn.2016-06.io.spdk:host"
 
 enum nvme_payload_type {
 	NVME_PAYLOAD_TYPE_INVALID = 0,
@@ -193,6 +227,12 @@ struct nvme_request {
 	uint32_t			payload_offset;
 	uint32_t			md_offset;
 
+	/**
+	 * Process that submitted this request.  Admin requests are only completed
+	 *  by (and their callbacks only called in) the process that submitted them.
+	 */
+	pid_t				pid;
+
 	spdk_nvme_cmd_cb		cb_fn;
 	void				*cb_arg;
 	STAILQ_ENTRY(nvme_request)	stailq;
@@ -239,6 +279,12 @@ struct nvme_request {
 	spdk_nvme_cmd_cb		user_cb_fn;
 	void				*user_cb_arg;
 	void				*user_buffer;
+
+	/**
+	 * Completion of an admin request reaped by another process, held until the
+	 *  submitting process polls the admin queue.
+	 */
+	struct spdk_nvme_cpl		cpl;
 };
 
 struct nvme_completion_poll_status {
@@ -252,17 +298,27 @@ struct nvme_async_event_request {
 	struct spdk_nvme_cpl		cpl;
 };
 
-struct nvme_tracker {
-	LIST_ENTRY(nvme_tracker)	list;
+struct nvme_pci_addr {
+	uint16_t			domain;
+	uint8_t				bus;
+	uint8_t				dev;
+	uint8_t				func;
+};
 
+struct nvme_tracker {
+	/* NULL while the tracker's command ID is on the qpair's free_cids stack */
 	struct nvme_request		*req;
 	uint16_t			cid;
 
-	uint16_t			rsvd1: 15;
+	uint16_t			rsvd1: 14;
+	uint16_t			timed_out: 1;
 	uint16_t			active: 1;
 
 	uint32_t			rsvd2;
 
+	/* Timestamp (in ticks) when the command was submitted; 0 if timeouts were disabled. */
+	uint64_t			submit_tick;
+
 	uint64_t			prp_sgl_bus_addr;
 
 	union {
@@ -270,7 +326,7 @@ struct nvme_tracker {
 		struct spdk_nvme_sgl_descriptor	sgl[NVME_MAX_SGL_DESCRIPTORS];
 	} u;
 
-	uint64_t			rsvd3;
+	uint64_t			rsvd3[2];
 };
 /*
  * struct nvme_tracker must be exactly 4K so that the prp[] array does not cross a page boundary
@@ -280,6 +336,30 @@ SPDK_STATIC_ASSERT(sizeof(struct nvme_tracker) == 4096, "nvme_tracker is not 4K"
 SPDK_STATIC_ASSERT((offsetof(struct nvme_tracker, u.sgl) & 7) == 0, "SGL must be Qword aligned");
 
 
+/*
+ * Adaptive queue depth limiter of an I/O qpair.  Completion latency is averaged over windows
+ *  of at least depth_limit completions.  A window whose average exceeds the target lowers
+ *  depth_limit by a quarter; a window that met the target while depth_limit commands were
+ *  outstanding raises it by one.
+ */
+struct nvme_depth_limiter {
+	/* 0 if the limiter is disabled */
+	uint64_t			latency_target_ticks;
+
+	uint64_t			window_latency_ticks;
+	uint32_t			window_completions;
+
+	/* depth_limit commands were outstanding at some point during the window */
+	bool				window_saturated;
+
+	uint16_t			depth_limit;
+
+	uint64_t			depth_increases;
+	uint64_t			depth_decreases;
+	uint64_t			throttled_requests;
+	uint64_t			last_avg_latency_ticks;
+};
+
 struct spdk_nvme_qpair {
 	volatile uint32_t		*sq_tdbl;
 	volatile uint32_t		*cq_hdbl;
@@ -294,14 +374,24 @@ struct spdk_nvme_qpair {
 	 */
 	struct spdk_nvme_cpl		*cpl;
 
-	LIST_HEAD(, nvme_tracker)	free_tr;
-	LIST_HEAD(, nvme_tracker)	outstanding_tr;
-
 	/**
 	 * Array of trackers indexed by command ID.
 	 */
 	struct nvme_tracker		*tr;
 
+	/**
+	 * Stack of free command IDs.  The top of the stack is the most recently freed
+	 *  tracker, whose cache lines are the most likely to still be warm.
+	 */
+	uint16_t			*free_cids;
+	uint16_t			num_free_cids;
+
+	/*
+	 * Commands are only submitted while more than this many command IDs are free.
+	 *  The adaptive queue depth limiter raises it to lower the effective queue depth.
+	 */
+	uint16_t			min_free_cids;
+
 	STAILQ_HEAD(, nvme_request)	queued_req;
 
 	uint16_t			id;
@@ -321,13 +411,32 @@ struct spdk_nvme_qpair {
 
 	uint8_t				qprio;
 
+	uint16_t			num_trackers;
+
+	/* Earliest tick at which an outstanding command can time out */
+	uint64_t			next_timeout_tick;
+
 	struct spdk_nvme_ctrlr		*ctrlr;
 
 	/* List entry for spdk_nvme_ctrlr::free_io_qpairs and active_io_qpairs */
 	TAILQ_ENTRY(spdk_nvme_qpair)	tailq;
 
+	/* Process that allocated this I/O qpair, or NULL if it is not allocated */
+	struct spdk_nvme_ctrlr_process	*active_proc;
+
+	/* List entry for spdk_nvme_ctrlr_process::allocated_io_qpairs */
+	TAILQ_ENTRY(spdk_nvme_qpair)	per_process_tailq;
+
 	uint64_t			cmd_bus_addr;
 	uint64_t			cpl_bus_addr;
+
+	/* Bytes of the controller memory buffer reserved for cmd while sq_in_cmb is set */
+	uint64_t			cmb_sq_size;
+
+	/* Transport connection state of a fabrics qpair; NULL while disconnected */
+	void				*transport_ctx;
+
+	struct nvme_depth_limiter	limiter;
 };
 
 struct spdk_nvme_ns {
@@ -342,6 +451,38 @@ struct spdk_nvme_ns {
 	uint16_t			flags;
 };
 
+/**
+ * NVMe over Fabrics transport.  A fabrics controller has no MMIO registers or queues in host
+ *  memory: its queue pairs are connected through the transport, commands are handed to it
+ *  instead of being written to a submission queue, and register accesses become property
+ *  get/set commands.
+ */
+struct nvme_transport {
+	const char	*name;
+
+	/* Connect qpair to the controller, dropping any previous connection first */
+	int	(*qpair_connect)(struct spdk_nvme_qpair *qpair);
+	/* Drop the connection of qpair; does nothing if it is not connected */
+	void	(*qpair_disconnect)(struct spdk_nvme_qpair *qpair);
+
+	/* Check at submission that the transport can carry the request's payload */
+	int	(*qpair_check_request)(struct spdk_nvme_qpair *qpair, struct nvme_request *req);
+	/* Queue the command of an active tracker; it is sent at the next qpair_flush */
+	void	(*qpair_queue_tracker)(struct spdk_nvme_qpair *qpair, struct nvme_tracker *tr);
+	void	(*qpair_flush)(struct spdk_nvme_qpair *qpair);
+
+	/* Complete trackers through nvme_qpair_complete_tracker(); negative on connection loss */
+	int32_t	(*qpair_process_completions)(struct spdk_nvme_qpair *qpair,
+					     uint32_t max_completions);
+
+	int	(*ctrlr_get_reg_4)(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset, uint32_t *value);
+	int	(*ctrlr_get_reg_8)(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset, uint64_t *value);
+	int	(*ctrlr_set_reg_4)(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset, uint32_t value);
+	int	(*ctrlr_set_reg_8)(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset, uint64_t value);
+};
+
+extern const struct nvme_transport nvme_tcp_transport;
+
 /**
  * State of struct spdk_nvme_ctrlr (in particular, during initialization).
  */
@@ -386,6 +527,9 @@ struct spdk_nvme_ctrlr {
 	/** I/O queue pairs */
 	struct spdk_nvme_qpair		*ioq;
 
+	/** Fabrics transport, or NULL for a PCIe controller */
+	const struct nvme_transport	*transport;
+
 	/** Array of namespaces indexed by nsid - 1 */
 	struct spdk_nvme_ns		*ns;
 
@@ -398,6 +542,14 @@ struct spdk_nvme_ctrlr {
 	/** Controller support flags */
 	uint64_t			flags;
 
+	/**
+	 * Command timeout callback; checked from the completion path, so it lives with the hot data.
+	 */
+	spdk_nvme_timeout_cb		timeout_cb_fn;
+	void				*timeout_cb_arg;
+	/** Command timeout in ticks; only valid if timeout_cb_fn != NULL */
+	uint64_t			timeout_ticks;
+
 	/* Cold data (not accessed in normal I/O path) is after this point. */
 
 	enum nvme_ctrlr_state		state;
@@ -423,14 +575,29 @@ struct spdk_nvme_ctrlr {
 	/** stride in uint32_t units between doorbell registers (1 = 4 bytes, 2 = 8 bytes, ...) */
 	uint32_t			doorbell_stride_u32;
 
+	/** number of write streams available to the host (0 = streams directive not enabled) */
+	uint16_t			max_streams;
+
 	uint32_t			num_aers;
 	struct nvme_async_event_request	aer[NVME_MAX_ASYNC_EVENTS];
-	spdk_nvme_aer_cb		aer_cb_fn;
-	void				*aer_cb_arg;
+
+	/** Process that registered timeout_cb_fn; only that process can call it */
+	pid_t				timeout_pid;
 
 	/** guards access to the controller itself, including admin queues */
 	pthread_mutex_t			ctrlr_lock;
 
+	/** PCI address of the controller, used to find it from secondary processes */
+	struct nvme_pci_addr		pci_addr;
+
+	/** Address of a fabrics controller */
+	struct spdk_nvme_transport_id	trid;
+
+	/** Controller ID assigned by a fabrics controller when the admin queue connected */
+	uint16_t			cntlid;
+
+	/** Processes that have attached this controller (struct spdk_nvme_ctrlr_process) */
+	TAILQ_HEAD(, spdk_nvme_ctrlr_process)	active_procs;
 
 	struct spdk_nvme_qpair		adminq;
 
@@ -451,6 +618,9 @@ struct spdk_nvme_ctrlr {
 
 	struct spdk_nvme_ctrlr_opts	opts;
 
+	/** Number of MSI-X vectors routed to eventfds (0 if interrupts are not enabled) */
+	uint32_t			num_intr_vectors;
+
 	/** BAR mapping address which contains controller memory buffer */
 	void				*cmb_bar_virt_addr;
 	/** BAR physical address which contains controller memory buffer */
@@ -459,13 +629,105 @@ struct spdk_nvme_ctrlr {
 	uint64_t			cmb_size;
 	/** Current offset of controller memory buffer */
 	uint64_t			cmb_current_offset;
+	/** Controller memory buffer supports both read and write data */
+	bool				cmb_io_data_supported;
+	/** True once an I/O data buffer has been allocated from the controller memory buffer */
+	bool				cmb_io_data_used;
+	/**
+	 * One descriptor for each page of the controller memory buffer.  The descriptor of a
+	 *  freed I/O data buffer's first page keeps it on a free list.
+	 */
+	struct nvme_cmb_io_buffer		*cmb_io_bufs;
+	/** Protects free_cmb_io_buffers */
+	pthread_spinlock_t			cmb_io_lock;
+	/**
+	 * Freed controller memory buffer I/O data buffers, available for reuse, by size in pages.
+	 *  The last list holds every larger size.
+	 */
+	LIST_HEAD(, nvme_cmb_io_buffer)		free_cmb_io_buffers[NVME_CMB_IO_BUF_CLASSES];
+};
+
+/*
+ * A freed I/O data buffer in the controller memory buffer.
+ */
+struct nvme_cmb_io_buffer {
+	uint64_t				size;
+	LIST_ENTRY(nvme_cmb_io_buffer)		link;
+};
+
+/*
+ * Per-process state of a controller.
+ *
+ * The controller itself is owned by the primary process, which initializes it and
+ *  keeps its asynchronous event requests outstanding.  Secondary processes attach to
+ *  the already initialized controller, allocate their own I/O qpairs and share its
+ *  admin queue.  Allocated from shared memory so that any process can walk
+ *  spdk_nvme_ctrlr::active_procs.
+ */
+struct spdk_nvme_ctrlr_process {
+	/** Whether this is the process that initialized the controller */
+	bool					is_primary;
+
+	pid_t					pid;
+
+	/** PCI device handle of the controller in this process */
+	struct spdk_pci_device			*devhandle;
+
+	/** Admin requests submitted by this process and reaped by another process */
+	STAILQ_HEAD(, nvme_request)		active_reqs;
+
+	/** I/O qpairs allocated by this process */
+	TAILQ_HEAD(, spdk_nvme_qpair)		allocated_io_qpairs;
+
+	spdk_nvme_aer_cb			aer_cb_fn;
+	void					*aer_cb_arg;
+
+	/** Ring of asynchronous events not yet delivered to this process */
+	struct spdk_nvme_cpl			pending_aers[NVME_MAX_ASYNC_EVENTS];
+	uint32_t				pending_aer_head;
+	uint32_t				num_pending_aers;
+
+	/** List entry for spdk_nvme_ctrlr::active_procs */
+	TAILQ_ENTRY(spdk_nvme_ctrlr_process)	tailq;
+};
+
+/*
+ * State of one (possibly asynchronous) spdk_nvme_probe() call.
+ */
+struct spdk_nvme_probe_ctx {
+	void				*cb_ctx;
+	spdk_nvme_probe_cb		probe_cb;
+	spdk_nvme_attach_cb		attach_cb;
+
+	/** Controllers found by this probe that are still being initialized */
+	TAILQ_HEAD(, spdk_nvme_ctrlr)	init_ctrlrs;
+
+	/** Sticky error code reported when the probe completes */
+	int				rc;
+
+	/** List entry for nvme_driver::probe_ctxs */
+	TAILQ_ENTRY(spdk_nvme_probe_ctx)	tailq;
 };
 
+/*
+ * Shared by the primary and secondary processes - allocated from a named memzone by the
+ *  primary process and looked up by secondaries.
+ */
 struct nvme_driver {
 	pthread_mutex_t	lock;
-	TAILQ_HEAD(, spdk_nvme_ctrlr)	init_ctrlrs;
+	TAILQ_HEAD(, spdk_nvme_probe_ctx)	probe_ctxs;
 	TAILQ_HEAD(, spdk_nvme_ctrlr)	attached_ctrlrs;
 	nvme_mempool_t	*request_mempool;
+
+	/** uevent socket used to monitor hotplug events, or -1 if not monitoring */
+	int				hotplug_fd;
+	/** A device was added since the PCI bus was last scanned */
+	bool				hotplug_rescan;
+	/** Probe started by spdk_nvme_hotplug_poll() to attach added devices */
+	struct spdk_nvme_probe_ctx	*hotplug_probe_ctx;
+
+	/** Set once the primary process has finished initializing this structure */
+	bool				initialized;
 };
 
 struct pci_id {
@@ -477,21 +739,68 @@ struct pci_id {
 
 extern struct nvme_driver *g_spdk_nvme_driver;
 
+/** pid of the calling process, cached when the driver is initialized */
+extern pid_t g_spdk_nvme_pid;
+
 #define nvme_min(a,b) (((a)<(b))?(a):(b))
+#define nvme_max(a,b) (((a)>(b))?(a):(b))
 
 #define INTEL_DC_P3X00_DEVID	0x09538086
 
+/*
+ * Controller registers are MMIO for PCIe controllers and properties accessed through the
+ *  transport for fabrics controllers.  A failed property read returns all ones, just like
+ *  a read from a PCIe device that has been removed.
+ */
+static inline uint32_t
+nvme_transport_get_reg_4(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset)
+{
+	uint32_t value;
+
+	if (ctrlr->transport->ctrlr_get_reg_4(ctrlr, offset, &value) != 0) {
+		return 0xFFFFFFFFu;
+	}
+	return value;
+}
+
+static inline uint64_t
+nvme_transport_get_reg_8(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset)
+{
+	uint64_t value;
+
+	if (ctrlr->transport->ctrlr_get_reg_8(ctrlr, offset, &value) != 0) {
+		return 0xFFFFFFFFFFFFFFFFull;
+	}
+	return value;
+}
+
 #define nvme_mmio_read_4(sc, reg) \
-	spdk_mmio_read_4(&(sc)->regs->reg)
+	((sc)->transport == NULL ? spdk_mmio_read_4(&(sc)->regs->reg) : \
+	 nvme_transport_get_reg_4(sc, offsetof(struct spdk_nvme_registers, reg)))
 
 #define nvme_mmio_read_8(sc, reg) \
-	spdk_mmio_read_8(&(sc)->regs->reg)
+	((sc)->transport == NULL ? spdk_mmio_read_8(&(sc)->regs->reg) : \
+	 nvme_transport_get_reg_8(sc, offsetof(struct spdk_nvme_registers, reg)))
 
 #define nvme_mmio_write_4(sc, reg, val) \
-	spdk_mmio_write_4(&(sc)->regs->reg, val)
+	do { \
+		if ((sc)->transport == NULL) { \
+			spdk_mmio_write_4(&(sc)->regs->reg, val); \
+		} else { \
+			(sc)->transport->ctrlr_set_reg_4(sc, \
+					offsetof(struct spdk_nvme_registers, reg), val); \
+		} \
+	} while (0)
 
 #define nvme_mmio_write_8(sc, reg, val) \
-	spdk_mmio_write_8(&(sc)->regs->reg, val)
+	do { \
+		if ((sc)->transport == NULL) { \
+			spdk_mmio_write_8(&(sc)->regs->reg, val); \
+		} else { \
+			(sc)->transport->ctrlr_set_reg_8(sc, \
+					offsetof(struct spdk_nvme_registers, reg), val); \
+		} \
+	} while (0)
 
 #define nvme_delay		usleep
 
@@ -534,8 +843,6 @@ int	nvme_ctrlr_cmd_set_num_queues(struct spdk_nvme_ctrlr *ctrlr,
 int	nvme_ctrlr_cmd_set_async_event_config(struct spdk_nvme_ctrlr *ctrlr,
 		union spdk_nvme_critical_warning_state state,
 		spdk_nvme_cmd_cb cb_fn, void *cb_arg);
-int	nvme_ctrlr_cmd_abort(struct spdk_nvme_ctrlr *ctrlr, uint16_t cid,
-			     uint16_t sqid, spdk_nvme_cmd_cb cb_fn, void *cb_arg);
 int	nvme_ctrlr_cmd_attach_ns(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
 				 struct spdk_nvme_ctrlr_list *payload, spdk_nvme_cmd_cb cb_fn, void *cb_arg);
 int	nvme_ctrlr_cmd_detach_ns(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
@@ -552,28 +859,51 @@ int	nvme_ctrlr_cmd_fw_commit(struct spdk_nvme_ctrlr *ctrlr,
 int	nvme_ctrlr_cmd_fw_image_download(struct spdk_nvme_ctrlr *ctrlr,
 		uint32_t size, uint32_t offset, void *payload,
 		spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+int	nvme_ctrlr_cmd_directive_send(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+				      uint32_t doper, uint32_t dtype, uint32_t dspec, uint32_t cdw12,
+				      void *payload, uint32_t payload_size,
+				      spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+int	nvme_ctrlr_cmd_directive_receive(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+		uint32_t doper, uint32_t dtype, uint32_t dspec, uint32_t cdw12,
+		void *payload, uint32_t payload_size,
+		spdk_nvme_cmd_cb cb_fn, void *cb_arg);
 void	nvme_completion_poll_cb(void *arg, const struct spdk_nvme_cpl *cpl);
 
 int	nvme_ctrlr_construct(struct spdk_nvme_ctrlr *ctrlr, void *devhandle);
+int	nvme_ctrlr_construct_fabrics(struct spdk_nvme_ctrlr *ctrlr,
+				     const struct nvme_transport *transport,
+				     const struct spdk_nvme_transport_id *trid);
 void	nvme_ctrlr_destruct(struct spdk_nvme_ctrlr *ctrlr);
 int	nvme_ctrlr_process_init(struct spdk_nvme_ctrlr *ctrlr);
 int	nvme_ctrlr_start(struct spdk_nvme_ctrlr *ctrlr);
 
 int	nvme_ctrlr_submit_admin_request(struct spdk_nvme_ctrlr *ctrlr,
 					struct nvme_request *req);
+
+int	nvme_ctrlr_add_process(struct spdk_nvme_ctrlr *ctrlr, void *devhandle);
+void	nvme_ctrlr_remove_process(struct spdk_nvme_ctrlr *ctrlr);
+struct spdk_nvme_ctrlr_process *nvme_ctrlr_get_current_process(struct spdk_nvme_ctrlr *ctrlr);
+bool	nvme_ctrlr_matches_pci_dev(struct spdk_nvme_ctrlr *ctrlr, struct spdk_pci_device *pci_dev);
+void	nvme_ctrlr_queue_proc_admin_request(struct spdk_nvme_ctrlr *ctrlr,
+		struct nvme_request *req, const struct spdk_nvme_cpl *cpl);
+void	nvme_ctrlr_complete_proc_admin_requests(struct spdk_nvme_ctrlr *ctrlr);
 int	nvme_ctrlr_alloc_cmb(struct spdk_nvme_ctrlr *ctrlr, uint64_t length, uint64_t aligned,
 			     uint64_t *offset);
+void	nvme_ctrlr_free_cmb(struct spdk_nvme_ctrlr *ctrlr, uint64_t offset, uint64_t length);
 int	nvme_qpair_construct(struct spdk_nvme_qpair *qpair, uint16_t id,
 			     uint16_t num_entries,
 			     uint16_t num_trackers,
 			     struct spdk_nvme_ctrlr *ctrlr);
 void	nvme_qpair_destroy(struct spdk_nvme_qpair *qpair);
+void	nvme_qpair_init_depth_limiter(struct spdk_nvme_qpair *qpair, uint32_t latency_target_us);
 void	nvme_qpair_enable(struct spdk_nvme_qpair *qpair);
 void	nvme_qpair_disable(struct spdk_nvme_qpair *qpair);
 int	nvme_qpair_submit_request(struct spdk_nvme_qpair *qpair,
 				  struct nvme_request *req);
 void	nvme_qpair_reset(struct spdk_nvme_qpair *qpair);
 void	nvme_qpair_fail(struct spdk_nvme_qpair *qpair);
+void	nvme_qpair_complete_tracker(struct spdk_nvme_qpair *qpair, struct nvme_tracker *tr,
+				    struct spdk_nvme_cpl *cpl, bool print_on_error);
 
 int	nvme_ns_construct(struct spdk_nvme_ns *ns, uint16_t id,
 			  struct spdk_nvme_ctrlr *ctrlr);
@@ -590,8 +920,6 @@ void	nvme_free_request(struct nvme_request *req);
 void	nvme_request_remove_child(struct nvme_request *parent, struct nvme_request *child);
 bool	nvme_intel_has_quirk(struct pci_id *id, uint64_t quirk);
 
-void	spdk_nvme_ctrlr_opts_set_defaults(struct spdk_nvme_ctrlr_opts *opts);
-
 int	nvme_mutex_init_shared(pthread_mutex_t *mtx);
 
 #endif /* __NVME_INTERNAL_H__ */
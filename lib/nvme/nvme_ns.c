@@ -96,6 +96,17 @@ int nvme_ns_identify_update(struct spdk_nvme_ns *ns)
 		ns->flags |= SPDK_NVME_NS_RESERVATION_SUPPORTED;
 	}
 
+	if (ns->ctrlr->cdata.oncs.compare) {
+		ns->flags |= SPDK_NVME_NS_COMPARE_SUPPORTED;
+		if (ns->ctrlr->cdata.fuses & 0x1) {
+			ns->flags |= SPDK_NVME_NS_COMPARE_AND_WRITE_SUPPORTED;
+		}
+	}
+
+	if (ns->ctrlr->max_streams) {
+		ns->flags |= SPDK_NVME_NS_STREAMS_SUPPORTED;
+	}
+
 	ns->md_size = nsdata->lbaf[nsdata->flbas.format].ms;
 	ns->pi_type = SPDK_NVME_FMT_NVM_PROTECTION_DISABLE;
 	if (nsdata->lbaf[nsdata->flbas.format].ms && nsdata->dps.pit) {
@@ -156,6 +167,12 @@ spdk_nvme_ns_get_flags(struct spdk_nvme_ns *ns)
 	return ns->flags;
 }
 
+uint16_t
+spdk_nvme_ns_get_max_write_streams(struct spdk_nvme_ns *ns)
+{
+	return ns->ctrlr->max_streams;
+}
+
 enum spdk_nvme_pi_type
 spdk_nvme_ns_get_pi_type(struct spdk_nvme_ns *ns) {
 	return ns->pi_type;
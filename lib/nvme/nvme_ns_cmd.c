@@ -37,7 +37,7 @@ static struct nvme_request *_nvme_ns_cmd_rw(struct spdk_nvme_ns *ns,
 		const struct nvme_payload *payload, uint64_t lba,
 		uint32_t lba_count, spdk_nvme_cmd_cb cb_fn,
 		void *cb_arg, uint32_t opc, uint32_t io_flags,
-		uint16_t apptag_mask, uint16_t apptag);
+		uint16_t apptag_mask, uint16_t apptag, uint32_t cdw13);
 
 static void
 nvme_cb_complete_child(void *child_arg, const struct spdk_nvme_cpl *cpl)
@@ -47,7 +47,16 @@ nvme_cb_complete_child(void *child_arg, const struct spdk_nvme_cpl *cpl)
 
 	nvme_request_remove_child(parent, child);
 
-	if (spdk_nvme_cpl_is_error(cpl)) {
+	/*
+	 * When one half of a fused operation fails, the other half is aborted; keep
+	 *  the status of the command that actually failed.
+	 */
+	if (spdk_nvme_cpl_is_error(cpl) &&
+	    !(child->cmd.fuse != SPDK_NVME_CMD_FUSE_NONE &&
+	      spdk_nvme_cpl_is_error(&parent->parent_status) &&
+	      cpl->status.sct == SPDK_NVME_SCT_GENERIC &&
+	      (cpl->status.sc == SPDK_NVME_SC_ABORTED_FAILED_FUSED ||
+	       cpl->status.sc == SPDK_NVME_SC_ABORTED_MISSING_FUSED))) {
 		memcpy(&parent->parent_status, cpl, sizeof(*cpl));
 	}
 
@@ -100,7 +109,7 @@ _nvme_ns_cmd_split_request(struct spdk_nvme_ns *ns,
 			   spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t opc,
 			   uint32_t io_flags, struct nvme_request *req,
 			   uint32_t sectors_per_max_io, uint32_t sector_mask,
-			   uint16_t apptag_mask, uint16_t apptag)
+			   uint16_t apptag_mask, uint16_t apptag, uint32_t cdw13)
 {
 	uint32_t		sector_size = ns->sector_size;
 	uint32_t		md_size = ns->md_size;
@@ -120,7 +129,7 @@ _nvme_ns_cmd_split_request(struct spdk_nvme_ns *ns,
 		lba_count = nvme_min(remaining_lba_count, lba_count);
 
 		child = _nvme_ns_cmd_rw(ns, payload, lba, lba_count, cb_fn,
-					cb_arg, opc, io_flags, apptag_mask, apptag);
+					cb_arg, opc, io_flags, apptag_mask, apptag, cdw13);
 		if (child == NULL) {
 			if (req->num_children) {
 				/* free all child nvme_request  */
@@ -143,17 +152,66 @@ _nvme_ns_cmd_split_request(struct spdk_nvme_ns *ns,
 		md_offset += lba_count * md_size;
 	}
 
+	spdk_trace_record(TRACE_NVME_SPLIT, 0, req->payload_size, 0, req->num_children);
+
 	return req;
 }
 
+/*
+ * Number of bytes transferred per logical block in the data buffer.
+ */
+static inline uint32_t
+_nvme_ns_payload_sector_size(struct spdk_nvme_ns *ns, uint32_t io_flags)
+{
+	uint32_t sector_size = ns->sector_size;
+
+	if (ns->flags & SPDK_NVME_NS_DPS_PI_SUPPORTED) {
+		/* for extended LBA only */
+		if ((ns->flags & SPDK_NVME_NS_EXTENDED_LBA_SUPPORTED) && !(io_flags & SPDK_NVME_IO_FLAGS_PRACT))
+			sector_size += ns->md_size;
+	}
+
+	return sector_size;
+}
+
+static void
+_nvme_ns_cmd_setup_rw(struct spdk_nvme_ns *ns, struct nvme_request *req, uint32_t opc,
+		      uint64_t lba, uint32_t lba_count, uint32_t io_flags,
+		      uint16_t apptag_mask, uint16_t apptag, uint32_t cdw13)
+{
+	struct spdk_nvme_cmd	*cmd;
+	uint64_t		*tmp_lba;
+
+	cmd = &req->cmd;
+	cmd->opc = opc;
+	cmd->nsid = ns->id;
+
+	tmp_lba = (uint64_t *)&cmd->cdw10;
+	*tmp_lba = lba;
+
+	if (ns->flags & SPDK_NVME_NS_DPS_PI_SUPPORTED) {
+		switch (ns->pi_type) {
+		case SPDK_NVME_FMT_NVM_PROTECTION_TYPE1:
+		case SPDK_NVME_FMT_NVM_PROTECTION_TYPE2:
+			cmd->cdw14 = (uint32_t)lba;
+			break;
+		}
+	}
+
+	cmd->cdw12 = lba_count - 1;
+	cmd->cdw12 |= io_flags;
+	cmd->cdw13 = cdw13;
+
+	cmd->cdw15 = apptag_mask;
+	cmd->cdw15 = (cmd->cdw15 << 16 | apptag);
+}
+
 static struct nvme_request *
 _nvme_ns_cmd_rw(struct spdk_nvme_ns *ns, const struct nvme_payload *payload,
 		uint64_t lba, uint32_t lba_count, spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t opc,
-		uint32_t io_flags, uint16_t apptag_mask, uint16_t apptag)
+		uint32_t io_flags, uint16_t apptag_mask, uint16_t apptag, uint32_t cdw13)
 {
 	struct nvme_request	*req;
-	struct spdk_nvme_cmd	*cmd;
-	uint64_t		*tmp_lba;
 	uint32_t		sector_size;
 	uint32_t		sectors_per_max_io;
 	uint32_t		sectors_per_stripe;
@@ -163,16 +221,10 @@ _nvme_ns_cmd_rw(struct spdk_nvme_ns *ns, const struct nvme_payload *payload,
 		return NULL;
 	}
 
-	sector_size = ns->sector_size;
+	sector_size = _nvme_ns_payload_sector_size(ns, io_flags);
 	sectors_per_max_io = ns->sectors_per_max_io;
 	sectors_per_stripe = ns->sectors_per_stripe;
 
-	if (ns->flags & SPDK_NVME_NS_DPS_PI_SUPPORTED) {
-		/* for extended LBA only */
-		if ((ns->flags & SPDK_NVME_NS_EXTENDED_LBA_SUPPORTED) && !(io_flags & SPDK_NVME_IO_FLAGS_PRACT))
-			sector_size += ns->md_size;
-	}
-
 	req = nvme_allocate_request(payload, lba_count * sector_size, cb_fn, cb_arg);
 	if (req == NULL) {
 		return NULL;
@@ -188,32 +240,13 @@ _nvme_ns_cmd_rw(struct spdk_nvme_ns *ns, const struct nvme_payload *payload,
 	    (((lba & (sectors_per_stripe - 1)) + lba_count) > sectors_per_stripe)) {
 
 		return _nvme_ns_cmd_split_request(ns, payload, lba, lba_count, cb_fn, cb_arg, opc,
-						  io_flags, req, sectors_per_stripe, sectors_per_stripe - 1, apptag_mask, apptag);
+						  io_flags, req, sectors_per_stripe, sectors_per_stripe - 1, apptag_mask, apptag,
+						  cdw13);
 	} else if (lba_count > sectors_per_max_io) {
 		return _nvme_ns_cmd_split_request(ns, payload, lba, lba_count, cb_fn, cb_arg, opc,
-						  io_flags, req, sectors_per_max_io, 0, apptag_mask, apptag);
+						  io_flags, req, sectors_per_max_io, 0, apptag_mask, apptag, cdw13);
 	} else {
-		cmd = &req->cmd;
-		cmd->opc = opc;
-		cmd->nsid = ns->id;
-
-		tmp_lba = (uint64_t *)&cmd->cdw10;
-		*tmp_lba = lba;
-
-		if (ns->flags & SPDK_NVME_NS_DPS_PI_SUPPORTED) {
-			switch (ns->pi_type) {
-			case SPDK_NVME_FMT_NVM_PROTECTION_TYPE1:
-			case SPDK_NVME_FMT_NVM_PROTECTION_TYPE2:
-				cmd->cdw14 = (uint32_t)lba;
-				break;
-			}
-		}
-
-		cmd->cdw12 = lba_count - 1;
-		cmd->cdw12 |= io_flags;
-
-		cmd->cdw15 = apptag_mask;
-		cmd->cdw15 = (cmd->cdw15 << 16 | apptag);
+		_nvme_ns_cmd_setup_rw(ns, req, opc, lba, lba_count, io_flags, apptag_mask, apptag, cdw13);
 	}
 
 	return req;
@@ -233,7 +266,7 @@ spdk_nvme_ns_cmd_read(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair, vo
 	payload.md = NULL;
 
 	req = _nvme_ns_cmd_rw(ns, &payload, lba, lba_count, cb_fn, cb_arg, SPDK_NVME_OPC_READ, io_flags, 0,
-			      0);
+			      0, 0);
 	if (req != NULL) {
 		return nvme_qpair_submit_request(qpair, req);
 	} else {
@@ -256,7 +289,29 @@ spdk_nvme_ns_cmd_read_with_md(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *q
 	payload.md = metadata;
 
 	req = _nvme_ns_cmd_rw(ns, &payload, lba, lba_count, cb_fn, cb_arg, SPDK_NVME_OPC_READ, io_flags,
-			      apptag_mask, apptag);
+			      apptag_mask, apptag, 0);
+	if (req != NULL) {
+		return nvme_qpair_submit_request(qpair, req);
+	} else {
+		return -ENOMEM;
+	}
+}
+
+int
+spdk_nvme_ns_cmd_read_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				 void *buffer, uint64_t lba, uint32_t lba_count,
+				 spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				 uint8_t dsm)
+{
+	struct nvme_request *req;
+	struct nvme_payload payload;
+
+	payload.type = NVME_PAYLOAD_TYPE_CONTIG;
+	payload.u.contig = buffer;
+	payload.md = NULL;
+
+	req = _nvme_ns_cmd_rw(ns, &payload, lba, lba_count, cb_fn, cb_arg, SPDK_NVME_OPC_READ, io_flags, 0,
+			      0, dsm);
 	if (req != NULL) {
 		return nvme_qpair_submit_request(qpair, req);
 	} else {
@@ -284,7 +339,35 @@ spdk_nvme_ns_cmd_readv(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 	payload.u.sgl.cb_arg = cb_arg;
 
 	req = _nvme_ns_cmd_rw(ns, &payload, lba, lba_count, cb_fn, cb_arg, SPDK_NVME_OPC_READ, io_flags, 0,
-			      0);
+			      0, 0);
+	if (req != NULL) {
+		return nvme_qpair_submit_request(qpair, req);
+	} else {
+		return -ENOMEM;
+	}
+}
+
+int
+spdk_nvme_ns_cmd_readv_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				  uint64_t lba, uint32_t lba_count,
+				  spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				  spdk_nvme_req_reset_sgl_cb reset_sgl_fn,
+				  spdk_nvme_req_next_sge_cb next_sge_fn, uint8_t dsm)
+{
+	struct nvme_request *req;
+	struct nvme_payload payload;
+
+	if (reset_sgl_fn == NULL || next_sge_fn == NULL)
+		return -EINVAL;
+
+	payload.type = NVME_PAYLOAD_TYPE_SGL;
+	payload.md = NULL;
+	payload.u.sgl.reset_sgl_fn = reset_sgl_fn;
+	payload.u.sgl.next_sge_fn = next_sge_fn;
+	payload.u.sgl.cb_arg = cb_arg;
+
+	req = _nvme_ns_cmd_rw(ns, &payload, lba, lba_count, cb_fn, cb_arg, SPDK_NVME_OPC_READ, io_flags, 0,
+			      0, dsm);
 	if (req != NULL) {
 		return nvme_qpair_submit_request(qpair, req);
 	} else {
@@ -306,7 +389,7 @@ spdk_nvme_ns_cmd_write(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 	payload.md = NULL;
 
 	req = _nvme_ns_cmd_rw(ns, &payload, lba, lba_count, cb_fn, cb_arg, SPDK_NVME_OPC_WRITE, io_flags, 0,
-			      0);
+			      0, 0);
 	if (req != NULL) {
 		return nvme_qpair_submit_request(qpair, req);
 	} else {
@@ -328,7 +411,52 @@ spdk_nvme_ns_cmd_write_with_md(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *
 	payload.md = metadata;
 
 	req = _nvme_ns_cmd_rw(ns, &payload, lba, lba_count, cb_fn, cb_arg, SPDK_NVME_OPC_WRITE, io_flags,
-			      apptag_mask, apptag);
+			      apptag_mask, apptag, 0);
+	if (req != NULL) {
+		return nvme_qpair_submit_request(qpair, req);
+	} else {
+		return -ENOMEM;
+	}
+}
+
+static int
+_nvme_ns_cmd_write_hints(struct spdk_nvme_ns *ns, uint8_t dsm, uint16_t stream_id,
+			 uint32_t *io_flags, uint32_t *cdw13)
+{
+	if (stream_id > ns->ctrlr->max_streams) {
+		return -EINVAL;
+	}
+
+	/* DSM attributes live in CDW13 bits 7:0 and the stream identifier (DSPEC) in bits 31:16. */
+	*cdw13 = dsm;
+	if (stream_id != 0) {
+		*io_flags |= SPDK_NVME_IO_FLAGS_STREAMS_DIRECTIVE;
+		*cdw13 |= (uint32_t)stream_id << 16;
+	}
+
+	return 0;
+}
+
+int
+spdk_nvme_ns_cmd_write_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				  void *buffer, uint64_t lba, uint32_t lba_count,
+				  spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				  uint8_t dsm, uint16_t stream_id)
+{
+	struct nvme_request *req;
+	struct nvme_payload payload;
+	uint32_t cdw13;
+
+	if (_nvme_ns_cmd_write_hints(ns, dsm, stream_id, &io_flags, &cdw13) != 0) {
+		return -EINVAL;
+	}
+
+	payload.type = NVME_PAYLOAD_TYPE_CONTIG;
+	payload.u.contig = buffer;
+	payload.md = NULL;
+
+	req = _nvme_ns_cmd_rw(ns, &payload, lba, lba_count, cb_fn, cb_arg, SPDK_NVME_OPC_WRITE, io_flags, 0,
+			      0, cdw13);
 	if (req != NULL) {
 		return nvme_qpair_submit_request(qpair, req);
 	} else {
@@ -356,7 +484,41 @@ spdk_nvme_ns_cmd_writev(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 	payload.u.sgl.cb_arg = cb_arg;
 
 	req = _nvme_ns_cmd_rw(ns, &payload, lba, lba_count, cb_fn, cb_arg, SPDK_NVME_OPC_WRITE, io_flags, 0,
-			      0);
+			      0, 0);
+	if (req != NULL) {
+		return nvme_qpair_submit_request(qpair, req);
+	} else {
+		return -ENOMEM;
+	}
+}
+
+int
+spdk_nvme_ns_cmd_writev_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				   uint64_t lba, uint32_t lba_count,
+				   spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				   spdk_nvme_req_reset_sgl_cb reset_sgl_fn,
+				   spdk_nvme_req_next_sge_cb next_sge_fn,
+				   uint8_t dsm, uint16_t stream_id)
+{
+	struct nvme_request *req;
+	struct nvme_payload payload;
+	uint32_t cdw13;
+
+	if (reset_sgl_fn == NULL || next_sge_fn == NULL)
+		return -EINVAL;
+
+	if (_nvme_ns_cmd_write_hints(ns, dsm, stream_id, &io_flags, &cdw13) != 0) {
+		return -EINVAL;
+	}
+
+	payload.type = NVME_PAYLOAD_TYPE_SGL;
+	payload.md = NULL;
+	payload.u.sgl.reset_sgl_fn = reset_sgl_fn;
+	payload.u.sgl.next_sge_fn = next_sge_fn;
+	payload.u.sgl.cb_arg = cb_arg;
+
+	req = _nvme_ns_cmd_rw(ns, &payload, lba, lba_count, cb_fn, cb_arg, SPDK_NVME_OPC_WRITE, io_flags, 0,
+			      0, cdw13);
 	if (req != NULL) {
 		return nvme_qpair_submit_request(qpair, req);
 	} else {
@@ -395,6 +557,201 @@ spdk_nvme_ns_cmd_write_zeroes(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *q
 	return nvme_qpair_submit_request(qpair, req);
 }
 
+int
+spdk_nvme_ns_cmd_compare(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair, void *buffer,
+			 uint64_t lba, uint32_t lba_count, spdk_nvme_cmd_cb cb_fn, void *cb_arg,
+			 uint32_t io_flags)
+{
+	struct nvme_request *req;
+	struct nvme_payload payload;
+
+	payload.type = NVME_PAYLOAD_TYPE_CONTIG;
+	payload.u.contig = buffer;
+	payload.md = NULL;
+
+	req = _nvme_ns_cmd_rw(ns, &payload, lba, lba_count, cb_fn, cb_arg, SPDK_NVME_OPC_COMPARE,
+			      io_flags, 0, 0, 0);
+	if (req != NULL) {
+		return nvme_qpair_submit_request(qpair, req);
+	} else {
+		return -ENOMEM;
+	}
+}
+
+/*
+ * State of a compare and write emulated on a controller without fused operations.
+ */
+struct nvme_compare_and_write_ctx {
+	struct spdk_nvme_ns	*ns;
+	struct spdk_nvme_qpair	*qpair;
+	void			*compare_payload;
+	void			*write_payload;
+	/** buffer the blocks are read into when the compare command is not supported */
+	void			*read_buf;
+	uint32_t		payload_size;
+	uint64_t		lba;
+	uint32_t		lba_count;
+	uint32_t		io_flags;
+	spdk_nvme_cmd_cb	cb_fn;
+	void			*cb_arg;
+};
+
+static void
+nvme_compare_and_write_ctx_complete(struct nvme_compare_and_write_ctx *ctx,
+				    const struct spdk_nvme_cpl *cpl)
+{
+	if (ctx->cb_fn) {
+		ctx->cb_fn(ctx->cb_arg, cpl);
+	}
+
+	if (ctx->read_buf) {
+		nvme_free(ctx->read_buf);
+	}
+	free(ctx);
+}
+
+static void
+nvme_compare_and_write_emulated_write_done(void *arg, const struct spdk_nvme_cpl *cpl)
+{
+	nvme_compare_and_write_ctx_complete(arg, cpl);
+}
+
+static void
+nvme_compare_and_write_emulated_compare_done(void *arg, const struct spdk_nvme_cpl *cpl)
+{
+	struct nvme_compare_and_write_ctx *ctx = arg;
+	struct spdk_nvme_cpl status;
+	int rc;
+
+	memcpy(&status, cpl, sizeof(status));
+
+	if (!spdk_nvme_cpl_is_error(&status) && ctx->read_buf != NULL &&
+	    memcmp(ctx->read_buf, ctx->compare_payload, ctx->payload_size) != 0) {
+		status.status.sct = SPDK_NVME_SCT_MEDIA_ERROR;
+		status.status.sc = SPDK_NVME_SC_COMPARE_FAILURE;
+	}
+
+	if (spdk_nvme_cpl_is_error(&status)) {
+		nvme_compare_and_write_ctx_complete(ctx, &status);
+		return;
+	}
+
+	rc = spdk_nvme_ns_cmd_write(ctx->ns, ctx->qpair, ctx->write_payload, ctx->lba,
+				    ctx->lba_count, nvme_compare_and_write_emulated_write_done,
+				    ctx, ctx->io_flags);
+	if (rc != 0) {
+		status.status.sct = SPDK_NVME_SCT_GENERIC;
+		status.status.sc = SPDK_NVME_SC_INTERNAL_DEVICE_ERROR;
+		nvme_compare_and_write_ctx_complete(ctx, &status);
+	}
+}
+
+static int
+_nvme_ns_cmd_compare_and_write_emulated(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+					void *compare_payload, void *write_payload,
+					uint64_t lba, uint32_t lba_count,
+					spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags)
+{
+	struct nvme_compare_and_write_ctx *ctx;
+	uint64_t phys_addr;
+	int rc;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		return -ENOMEM;
+	}
+
+	ctx->ns = ns;
+	ctx->qpair = qpair;
+	ctx->compare_payload = compare_payload;
+	ctx->write_payload = write_payload;
+	ctx->payload_size = lba_count * _nvme_ns_payload_sector_size(ns, io_flags);
+	ctx->lba = lba;
+	ctx->lba_count = lba_count;
+	ctx->io_flags = io_flags;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+
+	if (ns->flags & SPDK_NVME_NS_COMPARE_SUPPORTED) {
+		rc = spdk_nvme_ns_cmd_compare(ns, qpair, compare_payload, lba, lba_count,
+					      nvme_compare_and_write_emulated_compare_done, ctx, io_flags);
+	} else {
+		ctx->read_buf = nvme_malloc(ctx->payload_size, 0x1000, &phys_addr);
+		if (ctx->read_buf == NULL) {
+			free(ctx);
+			return -ENOMEM;
+		}
+		rc = spdk_nvme_ns_cmd_read(ns, qpair, ctx->read_buf, lba, lba_count,
+					   nvme_compare_and_write_emulated_compare_done, ctx, io_flags);
+	}
+
+	if (rc != 0) {
+		if (ctx->read_buf) {
+			nvme_free(ctx->read_buf);
+		}
+		free(ctx);
+	}
+
+	return rc;
+}
+
+int
+spdk_nvme_ns_cmd_compare_and_write(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				   void *compare_payload, void *write_payload,
+				   uint64_t lba, uint32_t lba_count,
+				   spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags)
+{
+	struct nvme_request	*req, *compare_req, *write_req;
+	uint32_t		payload_size;
+
+	if (lba_count == 0 || (io_flags & 0xFFFF)) {
+		return -EINVAL;
+	}
+
+	if (!(ns->flags & SPDK_NVME_NS_COMPARE_AND_WRITE_SUPPORTED)) {
+		return _nvme_ns_cmd_compare_and_write_emulated(ns, qpair, compare_payload, write_payload,
+				lba, lba_count, cb_fn, cb_arg, io_flags);
+	}
+
+	/*
+	 * Both halves must be submitted as single commands, so the operation cannot
+	 *  be split and must fit in the atomic compare and write unit.
+	 */
+	if (lba_count > ns->sectors_per_max_io || lba_count > (uint32_t)ns->ctrlr->cdata.acwu + 1) {
+		return -EINVAL;
+	}
+
+	payload_size = lba_count * _nvme_ns_payload_sector_size(ns, io_flags);
+
+	req = nvme_allocate_request_null(cb_fn, cb_arg);
+	if (req == NULL) {
+		return -ENOMEM;
+	}
+
+	compare_req = nvme_allocate_request_contig(compare_payload, payload_size, NULL, NULL);
+	if (compare_req == NULL) {
+		nvme_free_request(req);
+		return -ENOMEM;
+	}
+
+	write_req = nvme_allocate_request_contig(write_payload, payload_size, NULL, NULL);
+	if (write_req == NULL) {
+		nvme_free_request(compare_req);
+		nvme_free_request(req);
+		return -ENOMEM;
+	}
+
+	_nvme_ns_cmd_setup_rw(ns, compare_req, SPDK_NVME_OPC_COMPARE, lba, lba_count, io_flags, 0, 0, 0);
+	compare_req->cmd.fuse = SPDK_NVME_CMD_FUSE_FIRST;
+	_nvme_ns_cmd_setup_rw(ns, write_req, SPDK_NVME_OPC_WRITE, lba, lba_count, io_flags, 0, 0, 0);
+	write_req->cmd.fuse = SPDK_NVME_CMD_FUSE_SECOND;
+
+	nvme_request_add_child(req, compare_req);
+	nvme_request_add_child(req, write_req);
+
+	return nvme_qpair_submit_request(qpair, req);
+}
+
 int
 spdk_nvme_ns_cmd_dataset_management(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 				    uint32_t type,
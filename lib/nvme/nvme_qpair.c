@@ -315,6 +315,7 @@ nvme_qpair_construct_tracker(struct nvme_tracker *tr, uint16_t cid, uint64_t phy
 {
 	tr->prp_sgl_bus_addr = phys_addr + offsetof(struct nvme_tracker, u.prp);
 	tr->cid = cid;
+	tr->req = NULL;
 	tr->active = false;
 }
 
@@ -341,39 +342,133 @@ nvme_copy_command(struct spdk_nvme_cmd *dst, const struct spdk_nvme_cmd *src)
 #endif
 }
 
-static void
-nvme_qpair_submit_tracker(struct spdk_nvme_qpair *qpair, struct nvme_tracker *tr)
+static inline void
+nvme_qpair_copy_tracker_command(struct spdk_nvme_qpair *qpair, struct nvme_tracker *tr)
 {
 	struct nvme_request	*req;
 
 	req = tr->req;
 	qpair->tr[tr->cid].active = true;
 
+	/*
+	 * The tracker identifies the command in the trace until it completes, so a
+	 *  resubmission is traced as a retry of the original command.
+	 */
+	spdk_trace_record(req->retries ? TRACE_NVME_RETRY : TRACE_NVME_SUBMIT, qpair->id,
+			  req->payload_size, (uintptr_t)tr, tr->cid);
+
+	if (qpair->ctrlr->transport != NULL) {
+		qpair->ctrlr->transport->qpair_queue_tracker(qpair, tr);
+		return;
+	}
+
 	/* Copy the command from the tracker to the submission queue. */
 	nvme_copy_command(&qpair->cmd[qpair->sq_tail], &req->cmd);
 
 	if (++qpair->sq_tail == qpair->num_entries) {
 		qpair->sq_tail = 0;
 	}
+}
+
+static inline void
+nvme_qpair_ring_sq_doorbell(struct spdk_nvme_qpair *qpair)
+{
+	if (qpair->ctrlr->transport != NULL) {
+		qpair->ctrlr->transport->qpair_flush(qpair);
+		return;
+	}
 
 	spdk_wmb();
 	spdk_mmio_write_4(qpair->sq_tdbl, qpair->sq_tail);
 }
 
 static void
+nvme_qpair_submit_tracker(struct spdk_nvme_qpair *qpair, struct nvme_tracker *tr)
+{
+	nvme_qpair_copy_tracker_command(qpair, tr);
+	nvme_qpair_ring_sq_doorbell(qpair);
+}
+
+/*
+ * Admin requests may be submitted by any process sharing the controller, but a callback
+ *  can only be called in the process that submitted the request.  Hand requests of
+ *  other processes over to them; they are completed when that process next polls the
+ *  admin queue.
+ */
+static inline bool
+nvme_qpair_defer_completion(struct spdk_nvme_qpair *qpair, struct nvme_request *req,
+			    const struct spdk_nvme_cpl *cpl)
+{
+	if (req->pid == g_spdk_nvme_pid || !nvme_qpair_is_admin_queue(qpair)) {
+		return false;
+	}
+
+	nvme_ctrlr_queue_proc_admin_request(qpair->ctrlr, req, cpl);
+	return true;
+}
+
+/*
+ * Sample the latency of a completed command and, at the end of each window, adjust the depth
+ *  limit: multiplicative decrease when the window missed the latency target, additive increase
+ *  when it met the target with the queue pair full.
+ */
+static void
+nvme_qpair_update_depth_limiter(struct spdk_nvme_qpair *qpair, struct nvme_tracker *tr)
+{
+	struct nvme_depth_limiter	*limiter = &qpair->limiter;
+	uint64_t			avg_latency_ticks;
+	uint16_t			depth_limit;
+
+	/* Submitted before the limiter was enabled */
+	if (tr->submit_tick == 0) {
+		return;
+	}
+
+	limiter->window_latency_ticks += nvme_get_tsc() - tr->submit_tick;
+	if (++limiter->window_completions < nvme_max(limiter->depth_limit,
+			NVME_DEPTH_LIMITER_MIN_WINDOW)) {
+		return;
+	}
+
+	avg_latency_ticks = limiter->window_latency_ticks / limiter->window_completions;
+	if (avg_latency_ticks > limiter->latency_target_ticks) {
+		depth_limit = nvme_max(limiter->depth_limit * 3 / 4, NVME_DEPTH_LIMITER_MIN_DEPTH);
+		if (depth_limit < limiter->depth_limit) {
+			limiter->depth_limit = depth_limit;
+			limiter->depth_decreases++;
+		}
+	} else if (limiter->window_saturated && limiter->depth_limit < qpair->num_trackers) {
+		limiter->depth_limit++;
+		limiter->depth_increases++;
+	}
+
+	limiter->last_avg_latency_ticks = avg_latency_ticks;
+	limiter->window_latency_ticks = 0;
+	limiter->window_completions = 0;
+	limiter->window_saturated = false;
+	qpair->min_free_cids = qpair->num_trackers - limiter->depth_limit;
+}
+
+void
 nvme_qpair_complete_tracker(struct spdk_nvme_qpair *qpair, struct nvme_tracker *tr,
 			    struct spdk_nvme_cpl *cpl, bool print_on_error)
 {
 	struct nvme_request	*req;
 	bool			retry, error;
+	uint16_t		num_free_cids;
 
 	req = tr->req;
 
 	assert(req != NULL);
 
+	/*
+	 * Half of a fused operation cannot be resubmitted on its own, since its
+	 *  partner would no longer be adjacent to it in the submission queue.
+	 */
 	error = spdk_nvme_cpl_is_error(cpl);
 	retry = error && nvme_completion_is_retry(cpl) &&
-		req->retries < spdk_nvme_retry_count;
+		req->retries < spdk_nvme_retry_count &&
+		req->cmd.fuse == SPDK_NVME_CMD_FUSE_NONE;
 
 	if (error && print_on_error) {
 		nvme_qpair_print_command(qpair, &req->cmd);
@@ -386,28 +481,47 @@ nvme_qpair_complete_tracker(struct spdk_nvme_qpair *qpair, struct nvme_tracker *
 
 	if (retry) {
 		req->retries++;
+		/* The resubmitted command gets a full timeout period of its own. */
+		if (tr->submit_tick != 0) {
+			tr->submit_tick = nvme_get_tsc();
+		}
+		tr->timed_out = 0;
 		nvme_qpair_submit_tracker(qpair, tr);
 	} else {
-		if (req->cb_fn) {
-			req->cb_fn(req->cb_arg, cpl);
-		}
+		spdk_trace_record(TRACE_NVME_COMPLETE, qpair->id, 0, (uintptr_t)tr, tr->cid);
 
-		nvme_free_request(req);
+		if (!nvme_qpair_defer_completion(qpair, req, cpl)) {
+			if (req->cb_fn) {
+				req->cb_fn(req->cb_arg, cpl);
+			}
+
+			nvme_free_request(req);
+		}
 		tr->req = NULL;
 
-		LIST_REMOVE(tr, list);
-		LIST_INSERT_HEAD(&qpair->free_tr, tr, list);
+		if (spdk_unlikely(qpair->limiter.latency_target_ticks != 0)) {
+			nvme_qpair_update_depth_limiter(qpair, tr);
+		}
+
+		qpair->free_cids[qpair->num_free_cids++] = tr->cid;
 
 		/*
 		 * If the controller is in the middle of resetting, don't
 		 *  try to submit queued requests here - let the reset logic
-		 *  handle that instead.
+		 *  handle that instead.  More than one request may fit if the
+		 *  depth limiter just raised the queue depth.
 		 */
-		if (!STAILQ_EMPTY(&qpair->queued_req) &&
-		    !qpair->ctrlr->is_resetting) {
+		while (!STAILQ_EMPTY(&qpair->queued_req) &&
+		       qpair->num_free_cids > qpair->min_free_cids &&
+		       !qpair->ctrlr->is_resetting) {
+			num_free_cids = qpair->num_free_cids;
 			req = STAILQ_FIRST(&qpair->queued_req);
 			STAILQ_REMOVE_HEAD(&qpair->queued_req, stailq);
 			nvme_qpair_submit_request(qpair, req);
+			if (qpair->num_free_cids >= num_free_cids) {
+				/* The request was queued again or completed immediately. */
+				break;
+			}
 		}
 	}
 }
@@ -448,6 +562,10 @@ nvme_qpair_manual_complete_request(struct spdk_nvme_qpair *qpair,
 		nvme_qpair_print_completion(qpair, &cpl);
 	}
 
+	if (nvme_qpair_defer_completion(qpair, req, &cpl)) {
+		return;
+	}
+
 	if (req->cb_fn) {
 		req->cb_fn(req->cb_arg, &cpl);
 	}
@@ -465,12 +583,92 @@ nvme_qpair_check_enabled(struct spdk_nvme_qpair *qpair)
 	return qpair->is_enabled;
 }
 
+static void
+nvme_qpair_check_timeouts(struct spdk_nvme_qpair *qpair)
+{
+	struct spdk_nvme_ctrlr	*ctrlr = qpair->ctrlr;
+	struct nvme_tracker	*tr;
+	uint64_t		now, expire_tick, next_timeout_tick;
+	uint16_t		i;
+
+	if (ctrlr->is_resetting) {
+		return;
+	}
+
+	/*
+	 * There is no list of outstanding trackers to walk in submission order, so only
+	 *  scan the tracker array once the earliest outstanding command may have expired.
+	 *  Commands submitted after a scan always expire later than the commands it saw.
+	 */
+	now = nvme_get_tsc();
+	if (now < qpair->next_timeout_tick) {
+		return;
+	}
+
+	/* The callback can only be called in the process that registered it. */
+	if (ctrlr->timeout_pid != g_spdk_nvme_pid) {
+		return;
+	}
+
+	next_timeout_tick = now + ctrlr->timeout_ticks;
+
+	for (i = 0; i < qpair->num_trackers; i++) {
+		tr = &qpair->tr[i];
+
+		/* Skip free trackers and commands submitted while timeouts were disabled. */
+		if (tr->req == NULL || tr->submit_tick == 0 || tr->timed_out) {
+			continue;
+		}
+
+		/* AERs are expected to stay outstanding indefinitely. */
+		if (nvme_qpair_is_admin_queue(qpair) &&
+		    tr->req->cmd.opc == SPDK_NVME_OPC_ASYNC_EVENT_REQUEST) {
+			continue;
+		}
+
+		expire_tick = tr->submit_tick + ctrlr->timeout_ticks;
+		if (expire_tick > now) {
+			next_timeout_tick = nvme_min(next_timeout_tick, expire_tick);
+			continue;
+		}
+
+		tr->timed_out = 1;
+		ctrlr->timeout_cb_fn(ctrlr->timeout_cb_arg, ctrlr,
+				     nvme_qpair_is_admin_queue(qpair) ? NULL : qpair,
+				     tr->cid);
+
+		/*
+		 * The callback may have reset the controller, which completes or
+		 *  requeues every outstanding tracker - stop scanning and look again
+		 *  on the next call.
+		 */
+		if (!qpair->is_enabled || ctrlr->is_resetting) {
+			next_timeout_tick = 0;
+			break;
+		}
+	}
+
+	qpair->next_timeout_tick = next_timeout_tick;
+}
+
 int32_t
 spdk_nvme_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_completions)
 {
 	struct nvme_tracker	*tr;
-	struct spdk_nvme_cpl	*cpl;
+	struct spdk_nvme_cpl	*cpl, *next_cpl;
 	uint32_t num_completions = 0;
+	uint16_t next_head;
+	uint8_t next_phase;
+	int32_t rc;
+
+	if (spdk_unlikely(qpair->ctrlr->is_failed)) {
+		/*
+		 * The controller failed or was hot removed - complete any
+		 *  outstanding I/O with an error since it will never finish.
+		 */
+		nvme_qpair_fail(qpair);
+		return 0;
+	}
 
 	if (!nvme_qpair_check_enabled(qpair)) {
 		/*
@@ -492,6 +690,23 @@ spdk_nvme_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_
 		max_completions = qpair->num_entries - 1;
 	}
 
+	if (qpair->ctrlr->transport != NULL) {
+		rc = qpair->ctrlr->transport->qpair_process_completions(qpair, max_completions);
+		if (rc < 0) {
+			/*
+			 * The connection to the controller was lost; treat it like a hot removal
+			 *  so that the other queue pairs fail their I/O as well.
+			 */
+			SPDK_ERRLOG("%s: connection of qpair %u failed\n",
+				    qpair->ctrlr->transport->name, qpair->id);
+			qpair->ctrlr->is_failed = true;
+			nvme_qpair_fail(qpair);
+			return 0;
+		}
+		num_completions = rc;
+		goto out;
+	}
+
 	while (1) {
 		cpl = &qpair->cpl[qpair->cq_head];
 
@@ -500,6 +715,24 @@ spdk_nvme_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_
 
 		tr = &qpair->tr[cpl->cid];
 
+		/*
+		 * Start pulling in the request (touched by the callback and when it is freed) and,
+		 *  if the controller already posted the next completion, its tracker while this
+		 *  completion is processed.
+		 */
+		__builtin_prefetch(tr->req);
+
+		next_head = qpair->cq_head + 1;
+		next_phase = qpair->phase;
+		if (spdk_unlikely(next_head == qpair->num_entries)) {
+			next_head = 0;
+			next_phase = !next_phase;
+		}
+		next_cpl = &qpair->cpl[next_head];
+		if (next_cpl->status.p == next_phase) {
+			__builtin_prefetch(&qpair->tr[next_cpl->cid]);
+		}
+
 		if (tr->active) {
 			nvme_qpair_complete_tracker(qpair, tr, cpl, true);
 		} else {
@@ -508,10 +741,11 @@ spdk_nvme_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_
 			assert(0);
 		}
 
-		if (++qpair->cq_head == qpair->num_entries) {
+		if (spdk_unlikely(++qpair->cq_head == qpair->num_entries)) {
 			qpair->cq_head = 0;
 			qpair->phase = !qpair->phase;
 		}
+		__builtin_prefetch(&qpair->cpl[qpair->cq_head]);
 
 		if (++num_completions == max_completions) {
 			break;
@@ -522,9 +756,46 @@ spdk_nvme_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_
 		spdk_mmio_write_4(qpair->cq_hdbl, qpair->cq_head);
 	}
 
+out:
+	if (nvme_qpair_is_admin_queue(qpair)) {
+		nvme_ctrlr_complete_proc_admin_requests(qpair->ctrlr);
+	}
+
+	if (spdk_unlikely(qpair->ctrlr->timeout_cb_fn != NULL)) {
+		nvme_qpair_check_timeouts(qpair);
+	}
+
 	return num_completions;
 }
 
+void
+nvme_qpair_init_depth_limiter(struct spdk_nvme_qpair *qpair, uint32_t latency_target_us)
+{
+	struct nvme_depth_limiter	*limiter = &qpair->limiter;
+	uint64_t			ticks;
+
+	memset(limiter, 0, sizeof(*limiter));
+	if (latency_target_us != 0) {
+		ticks = (uint64_t)latency_target_us * nvme_get_tsc_hz() / 1000000;
+		limiter->latency_target_ticks = nvme_max(ticks, 1);
+	}
+	limiter->depth_limit = qpair->num_trackers;
+	qpair->min_free_cids = 0;
+}
+
+void
+spdk_nvme_qpair_get_stats(struct spdk_nvme_qpair *qpair, struct spdk_nvme_qpair_stats *stats)
+{
+	struct nvme_depth_limiter *limiter = &qpair->limiter;
+
+	stats->depth_limit = limiter->depth_limit;
+	stats->max_depth = qpair->num_trackers;
+	stats->depth_increases = limiter->depth_increases;
+	stats->depth_decreases = limiter->depth_decreases;
+	stats->throttled_requests = limiter->throttled_requests;
+	stats->avg_latency_us = limiter->last_avg_latency_ticks * 1000000 / nvme_get_tsc_hz();
+}
+
 int
 nvme_qpair_construct(struct spdk_nvme_qpair *qpair, uint16_t id,
 		     uint16_t num_entries, uint16_t num_trackers,
@@ -534,7 +805,9 @@ nvme_qpair_construct(struct spdk_nvme_qpair *qpair, uint16_t id,
 	uint16_t		i;
 	volatile uint32_t	*doorbell_base;
 	uint64_t		phys_addr = 0;
+	uint64_t		free_cids_phys_addr;
 	uint64_t		offset;
+	uint64_t		sq_size;
 
 	assert(num_entries != 0);
 	assert(num_trackers != 0);
@@ -542,16 +815,36 @@ nvme_qpair_construct(struct spdk_nvme_qpair *qpair, uint16_t id,
 	qpair->id = id;
 	qpair->num_entries = num_entries;
 	qpair->qprio = 0;
-	qpair->sq_in_cmb = false;
 
 	qpair->ctrlr = ctrlr;
+	qpair->transport_ctx = NULL;
+
+	STAILQ_INIT(&qpair->queued_req);
+
+	if (ctrlr->transport != NULL) {
+		/* Fabrics queues live on the controller; only the trackers are needed here. */
+		goto alloc_trackers;
+	}
 
-	/* cmd and cpl rings must be aligned on 4KB boundaries. */
-	if (ctrlr->opts.use_cmb_sqs) {
-		if (nvme_ctrlr_alloc_cmb(ctrlr, qpair->num_entries * sizeof(struct spdk_nvme_cmd),
-					 0x1000, &offset) == 0) {
+	/*
+	 * cmd and cpl rings must be aligned on 4KB boundaries.
+	 *
+	 * nvme_qpair_destroy() leaves a CMB SQ reserved, so a qpair that is reconstructed
+	 *  (e.g. resized on reallocation) keeps using its old SQ space when the new ring fits.
+	 */
+	sq_size = qpair->num_entries * sizeof(struct spdk_nvme_cmd);
+	if (!ctrlr->opts.use_cmb_sqs) {
+		qpair->sq_in_cmb = false;
+	} else if (!qpair->sq_in_cmb || sq_size > qpair->cmb_sq_size) {
+		if (qpair->sq_in_cmb) {
+			nvme_ctrlr_free_cmb(ctrlr, qpair->cmd_bus_addr - ctrlr->cmb_bar_phys_addr,
+					    qpair->cmb_sq_size);
+			qpair->sq_in_cmb = false;
+		}
+		if (nvme_ctrlr_alloc_cmb(ctrlr, sq_size, 0x1000, &offset) == 0) {
 			qpair->cmd = ctrlr->cmb_bar_virt_addr + offset;
 			qpair->cmd_bus_addr = ctrlr->cmb_bar_phys_addr + offset;
+			qpair->cmb_sq_size = sq_size;
 			qpair->sq_in_cmb = true;
 		}
 	}
@@ -577,10 +870,7 @@ nvme_qpair_construct(struct spdk_nvme_qpair *qpair, uint16_t id,
 	qpair->sq_tdbl = doorbell_base + (2 * id + 0) * ctrlr->doorbell_stride_u32;
 	qpair->cq_hdbl = doorbell_base + (2 * id + 1) * ctrlr->doorbell_stride_u32;
 
-	LIST_INIT(&qpair->free_tr);
-	LIST_INIT(&qpair->outstanding_tr);
-	STAILQ_INIT(&qpair->queued_req);
-
+alloc_trackers:
 	/*
 	 * Reserve space for all of the trackers in a single allocation.
 	 *   struct nvme_tracker must be padded so that its size is already a power of 2.
@@ -593,13 +883,29 @@ nvme_qpair_construct(struct spdk_nvme_qpair *qpair, uint16_t id,
 		goto fail;
 	}
 
+	/* Shared with secondary processes, like the rest of the qpair. */
+	qpair->free_cids = nvme_malloc(num_trackers * sizeof(*qpair->free_cids), 64,
+				       &free_cids_phys_addr);
+	if (qpair->free_cids == NULL) {
+		SPDK_ERRLOG("alloc free_cids failed\n");
+		goto fail;
+	}
+
+	qpair->num_trackers = num_trackers;
+	qpair->num_free_cids = 0;
 	for (i = 0; i < num_trackers; i++) {
 		tr = &qpair->tr[i];
 		nvme_qpair_construct_tracker(tr, i, phys_addr);
-		LIST_INSERT_HEAD(&qpair->free_tr, tr, list);
 		phys_addr += sizeof(struct nvme_tracker);
 	}
 
+	/* Push in reverse order so that the lowest command IDs are handed out first. */
+	for (i = num_trackers; i > 0; i--) {
+		qpair->free_cids[qpair->num_free_cids++] = i - 1;
+	}
+
+	nvme_qpair_init_depth_limiter(qpair, 0);
+
 	nvme_qpair_reset(qpair);
 	return 0;
 fail:
@@ -611,17 +917,18 @@ static void
 nvme_admin_qpair_abort_aers(struct spdk_nvme_qpair *qpair)
 {
 	struct nvme_tracker	*tr;
+	uint16_t		i;
+
+	if (qpair->tr == NULL) {
+		return;
+	}
 
-	tr = LIST_FIRST(&qpair->outstanding_tr);
-	while (tr != NULL) {
-		assert(tr->req != NULL);
-		if (tr->req->cmd.opc == SPDK_NVME_OPC_ASYNC_EVENT_REQUEST) {
+	for (i = 0; i < qpair->num_trackers; i++) {
+		tr = &qpair->tr[i];
+		if (tr->req != NULL && tr->req->cmd.opc == SPDK_NVME_OPC_ASYNC_EVENT_REQUEST) {
 			nvme_qpair_manual_complete_tracker(qpair, tr,
 							   SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_ABORTED_SQ_DELETION, 0,
 							   false);
-			tr = LIST_FIRST(&qpair->outstanding_tr);
-		} else {
-			tr = LIST_NEXT(tr, list);
 		}
 	}
 }
@@ -639,6 +946,9 @@ nvme_qpair_destroy(struct spdk_nvme_qpair *qpair)
 	if (nvme_qpair_is_admin_queue(qpair)) {
 		_nvme_admin_qpair_destroy(qpair);
 	}
+	if (qpair->ctrlr != NULL && qpair->ctrlr->transport != NULL) {
+		qpair->ctrlr->transport->qpair_disconnect(qpair);
+	}
 	if (qpair->cmd && !qpair->sq_in_cmb) {
 		nvme_free(qpair->cmd);
 		qpair->cmd = NULL;
@@ -651,6 +961,10 @@ nvme_qpair_destroy(struct spdk_nvme_qpair *qpair)
 		nvme_free(qpair->tr);
 		qpair->tr = NULL;
 	}
+	if (qpair->free_cids) {
+		nvme_free(qpair->free_cids);
+		qpair->free_cids = NULL;
+	}
 }
 
 static void
@@ -665,6 +979,25 @@ _nvme_fail_request_bad_vtophys(struct spdk_nvme_qpair *qpair, struct nvme_tracke
 					   1 /* do not retry */, true);
 }
 
+/*
+ * Buffers from spdk_nvme_ctrlr_alloc_cmb_io_buffer() are in the controller's BAR rather
+ *  than in hugepage memory, so they are translated from the CMB mapping instead.
+ */
+static inline uint64_t
+nvme_payload_vtophys(struct spdk_nvme_ctrlr *ctrlr, void *buf)
+{
+	uint64_t offset;
+
+	if (spdk_unlikely(ctrlr->cmb_io_data_used)) {
+		offset = (uintptr_t)buf - (uintptr_t)ctrlr->cmb_bar_virt_addr;
+		if (offset < ctrlr->cmb_current_offset) {
+			return ctrlr->cmb_bar_phys_addr + offset;
+		}
+	}
+
+	return nvme_vtophys(buf);
+}
+
 /**
  * Build PRP list describing physically contiguous payload buffer.
  */
@@ -673,12 +1006,13 @@ _nvme_qpair_build_contig_request(struct spdk_nvme_qpair *qpair, struct nvme_requ
 				 struct nvme_tracker *tr)
 {
 	uint64_t phys_addr;
+	uint64_t *prp;
 	void *seg_addr;
-	uint32_t nseg, cur_nseg, modulo, unaligned;
+	uint32_t nseg, cur_nseg, run_nseg, modulo, unaligned, i;
 	void *md_payload;
 	void *payload = req->payload.u.contig + req->payload_offset;
 
-	phys_addr = nvme_vtophys(payload);
+	phys_addr = nvme_payload_vtophys(qpair->ctrlr, payload);
 	if (phys_addr == NVME_VTOPHYS_ERROR) {
 		_nvme_fail_request_bad_vtophys(qpair, tr);
 		return -1;
@@ -692,7 +1026,7 @@ _nvme_qpair_build_contig_request(struct spdk_nvme_qpair *qpair, struct nvme_requ
 
 	if (req->payload.md) {
 		md_payload = req->payload.md + req->md_offset;
-		tr->req->cmd.mptr = nvme_vtophys(md_payload);
+		tr->req->cmd.mptr = nvme_payload_vtophys(qpair->ctrlr, md_payload);
 		if (tr->req->cmd.mptr == NVME_VTOPHYS_ERROR) {
 			_nvme_fail_request_bad_vtophys(qpair, tr);
 			return -1;
@@ -703,19 +1037,36 @@ _nvme_qpair_build_contig_request(struct spdk_nvme_qpair *qpair, struct nvme_requ
 	tr->req->cmd.dptr.prp.prp1 = phys_addr;
 	if (nseg == 2) {
 		seg_addr = payload + PAGE_SIZE - unaligned;
-		tr->req->cmd.dptr.prp.prp2 = nvme_vtophys(seg_addr);
+		phys_addr = nvme_payload_vtophys(qpair->ctrlr, seg_addr);
+		if (phys_addr == NVME_VTOPHYS_ERROR) {
+			_nvme_fail_request_bad_vtophys(qpair, tr);
+			return -1;
+		}
+		tr->req->cmd.dptr.prp.prp2 = phys_addr;
 	} else if (nseg > 2) {
 		cur_nseg = 1;
 		tr->req->cmd.dptr.prp.prp2 = (uint64_t)tr->prp_sgl_bus_addr;
 		while (cur_nseg < nseg) {
+			/*
+			 * Translate only the first page of each 2MB run; the remaining
+			 *  PRP entries of the run are consecutive physical pages.
+			 */
 			seg_addr = payload + cur_nseg * PAGE_SIZE - unaligned;
-			phys_addr = nvme_vtophys(seg_addr);
+			phys_addr = nvme_payload_vtophys(qpair->ctrlr, seg_addr);
 			if (phys_addr == NVME_VTOPHYS_ERROR) {
 				_nvme_fail_request_bad_vtophys(qpair, tr);
 				return -1;
 			}
-			tr->u.prp[cur_nseg - 1] = phys_addr;
-			cur_nseg++;
+
+			run_nseg = (NVME_VTOPHYS_PAGE_SIZE -
+				    ((uintptr_t)seg_addr & (NVME_VTOPHYS_PAGE_SIZE - 1))) >> nvme_u32log2(PAGE_SIZE);
+			run_nseg = nvme_min(run_nseg, nseg - cur_nseg);
+
+			prp = &tr->u.prp[cur_nseg - 1];
+			for (i = 0; i < run_nseg; i++) {
+				prp[i] = phys_addr + (uint64_t)i * PAGE_SIZE;
+			}
+			cur_nseg += run_nseg;
 		}
 	}
 
@@ -883,6 +1234,114 @@ _nvme_qpair_build_prps_sgl_request(struct spdk_nvme_qpair *qpair, struct nvme_re
 	return 0;
 }
 
+/*
+ * Assign a tracker to the request and build its PRP or SGL.  On a build failure the
+ *  request has already been completed with an error through the tracker.
+ */
+static int
+_nvme_qpair_prepare_tracker(struct spdk_nvme_qpair *qpair, struct nvme_request *req,
+			    struct nvme_tracker **tr_out)
+{
+	int			rc = 0;
+	struct nvme_tracker	*tr;
+	struct spdk_nvme_ctrlr	*ctrlr = qpair->ctrlr;
+
+	tr = &qpair->tr[qpair->free_cids[--qpair->num_free_cids]];
+	tr->req = req;
+	req->cmd.cid = tr->cid;
+
+	if (spdk_unlikely(ctrlr->timeout_cb_fn != NULL || qpair->limiter.latency_target_ticks != 0)) {
+		tr->submit_tick = nvme_get_tsc();
+		if (qpair->num_free_cids <= qpair->min_free_cids) {
+			/* This command filled the queue pair up to its depth limit. */
+			qpair->limiter.window_saturated = true;
+		}
+	} else {
+		tr->submit_tick = 0;
+	}
+	tr->timed_out = 0;
+
+	if (req->payload_size == 0) {
+		/* Null payload - leave PRP fields zeroed */
+	} else if (ctrlr->transport != NULL) {
+		/*
+		 * The transport describes the data itself.  Payloads it cannot carry were
+		 *  rejected by qpair_check_request when the request was submitted.
+		 */
+	} else if (req->payload.type == NVME_PAYLOAD_TYPE_CONTIG) {
+		rc = _nvme_qpair_build_contig_request(qpair, req, tr);
+		if (rc < 0) {
+			return rc;
+		}
+	} else if (req->payload.type == NVME_PAYLOAD_TYPE_SGL) {
+		if (ctrlr->flags & SPDK_NVME_CTRLR_SGL_SUPPORTED)
+			rc = _nvme_qpair_build_hw_sgl_request(qpair, req, tr);
+		else
+			rc = _nvme_qpair_build_prps_sgl_request(qpair, req, tr);
+		if (rc < 0) {
+			return rc;
+		}
+	} else {
+		assert(0);
+		_nvme_fail_request_bad_vtophys(qpair, tr);
+		return -EINVAL;
+	}
+
+	*tr_out = tr;
+	return 0;
+}
+
+/*
+ * Submit the two children of a fused operation.  Both commands are copied into
+ *  consecutive submission queue slots and made visible with a single doorbell write,
+ *  so no other command can end up between them.
+ */
+static int
+nvme_qpair_submit_fused_request(struct spdk_nvme_qpair *qpair, struct nvme_request *req)
+{
+	struct nvme_request	*first_req, *second_req;
+	struct nvme_tracker	*first_tr, *second_tr;
+	int			rc;
+
+	assert(req->num_children == 2);
+	first_req = TAILQ_FIRST(&req->children);
+	second_req = TAILQ_NEXT(first_req, child_tailq);
+
+	if (!qpair->is_enabled) {
+		STAILQ_INSERT_TAIL(&qpair->queued_req, req, stailq);
+		return 0;
+	}
+
+	if (qpair->num_free_cids < qpair->min_free_cids + 2) {
+		/*
+		 * Queue at the head so that the pair is retried as soon as the next
+		 *  tracker is freed, rather than losing that tracker to a single command.
+		 */
+		STAILQ_INSERT_HEAD(&qpair->queued_req, req, stailq);
+		spdk_trace_record(TRACE_NVME_QUEUED, qpair->id, req->payload_size, 0, (uintptr_t)req);
+		return 0;
+	}
+
+	rc = _nvme_qpair_prepare_tracker(qpair, first_req, &first_tr);
+	if (rc < 0) {
+		nvme_qpair_manual_complete_request(qpair, second_req, SPDK_NVME_SCT_GENERIC,
+						   SPDK_NVME_SC_ABORTED_MISSING_FUSED, true);
+		return rc;
+	}
+
+	rc = _nvme_qpair_prepare_tracker(qpair, second_req, &second_tr);
+	if (rc < 0) {
+		nvme_qpair_manual_complete_tracker(qpair, first_tr, SPDK_NVME_SCT_GENERIC,
+						   SPDK_NVME_SC_ABORTED_MISSING_FUSED, 1, true);
+		return rc;
+	}
+
+	nvme_qpair_copy_tracker_command(qpair, first_tr);
+	nvme_qpair_copy_tracker_command(qpair, second_tr);
+	nvme_qpair_ring_sq_doorbell(qpair);
+	return 0;
+}
+
 int
 nvme_qpair_submit_request(struct spdk_nvme_qpair *qpair, struct nvme_request *req)
 {
@@ -893,13 +1352,35 @@ nvme_qpair_submit_request(struct spdk_nvme_qpair *qpair, struct nvme_request *re
 	bool			child_req_failed = false;
 
 	if (ctrlr->is_failed) {
+		if (req->num_children) {
+			TAILQ_FOREACH_SAFE(child_req, &req->children, child_tailq, tmp) {
+				nvme_request_remove_child(req, child_req);
+				nvme_free_request(child_req);
+			}
+		}
 		nvme_free_request(req);
 		return -ENXIO;
 	}
 
+	if (ctrlr->transport != NULL && ctrlr->transport->qpair_check_request != NULL) {
+		rc = ctrlr->transport->qpair_check_request(qpair, req);
+		if (rc != 0) {
+			TAILQ_FOREACH_SAFE(child_req, &req->children, child_tailq, tmp) {
+				nvme_request_remove_child(req, child_req);
+				nvme_free_request(child_req);
+			}
+			nvme_free_request(req);
+			return rc;
+		}
+	}
+
 	nvme_qpair_check_enabled(qpair);
 
 	if (req->num_children) {
+		if (TAILQ_FIRST(&req->children)->cmd.fuse == SPDK_NVME_CMD_FUSE_FIRST) {
+			return nvme_qpair_submit_fused_request(qpair, req);
+		}
+
 		/*
 		 * This is a split (parent) request. Submit all of the children but not the parent
 		 * request itself, since the parent is the original unsplit request.
@@ -918,11 +1399,10 @@ nvme_qpair_submit_request(struct spdk_nvme_qpair *qpair, struct nvme_request *re
 		return rc;
 	}
 
-	tr = LIST_FIRST(&qpair->free_tr);
-
-	if (tr == NULL || !qpair->is_enabled) {
+	if (qpair->num_free_cids <= qpair->min_free_cids || !qpair->is_enabled) {
 		/*
-		 * No tracker is available, or the qpair is disabled due to
+		 * No tracker is available, the depth limiter does not allow
+		 *  another outstanding command, or the qpair is disabled due to
 		 *  an in-progress controller-level reset.
 		 *
 		 * Put the request on the qpair's request queue to be
@@ -930,34 +1410,17 @@ nvme_qpair_submit_request(struct spdk_nvme_qpair *qpair, struct nvme_request *re
 		 *  completion or when the controller reset is
 		 *  completed.
 		 */
+		if (qpair->num_free_cids != 0 && qpair->is_enabled) {
+			qpair->limiter.throttled_requests++;
+		}
 		STAILQ_INSERT_TAIL(&qpair->queued_req, req, stailq);
+		spdk_trace_record(TRACE_NVME_QUEUED, qpair->id, req->payload_size, 0, (uintptr_t)req);
 		return 0;
 	}
 
-	LIST_REMOVE(tr, list); /* remove tr from free_tr */
-	LIST_INSERT_HEAD(&qpair->outstanding_tr, tr, list);
-	tr->req = req;
-	req->cmd.cid = tr->cid;
-
-	if (req->payload_size == 0) {
-		/* Null payload - leave PRP fields zeroed */
-	} else if (req->payload.type == NVME_PAYLOAD_TYPE_CONTIG) {
-		rc = _nvme_qpair_build_contig_request(qpair, req, tr);
-		if (rc < 0) {
-			return rc;
-		}
-	} else if (req->payload.type == NVME_PAYLOAD_TYPE_SGL) {
-		if (ctrlr->flags & SPDK_NVME_CTRLR_SGL_SUPPORTED)
-			rc = _nvme_qpair_build_hw_sgl_request(qpair, req, tr);
-		else
-			rc = _nvme_qpair_build_prps_sgl_request(qpair, req, tr);
-		if (rc < 0) {
-			return rc;
-		}
-	} else {
-		assert(0);
-		_nvme_fail_request_bad_vtophys(qpair, tr);
-		return -EINVAL;
+	rc = _nvme_qpair_prepare_tracker(qpair, req, &tr);
+	if (rc < 0) {
+		return rc;
 	}
 
 	nvme_qpair_submit_tracker(qpair, tr);
@@ -978,6 +1441,11 @@ nvme_qpair_reset(struct spdk_nvme_qpair *qpair)
 	 */
 	qpair->phase = 1;
 
+	if (qpair->cmd == NULL) {
+		/* Fabrics qpair - there are no rings in host memory. */
+		return;
+	}
+
 	memset(qpair->cmd, 0,
 	       qpair->num_entries * sizeof(struct spdk_nvme_cmd));
 	memset(qpair->cpl, 0,
@@ -988,7 +1456,7 @@ static void
 _nvme_admin_qpair_enable(struct spdk_nvme_qpair *qpair)
 {
 	struct nvme_tracker		*tr;
-	struct nvme_tracker		*tr_temp;
+	uint16_t			i;
 
 	/*
 	 * Manually abort each outstanding admin command.  Do not retry
@@ -996,7 +1464,11 @@ _nvme_admin_qpair_enable(struct spdk_nvme_qpair *qpair)
 	 *  a controller reset and its likely the context in which the
 	 *  command was issued no longer applies.
 	 */
-	LIST_FOREACH_SAFE(tr, &qpair->outstanding_tr, list, tr_temp) {
+	for (i = 0; i < qpair->num_trackers; i++) {
+		tr = &qpair->tr[i];
+		if (tr->req == NULL) {
+			continue;
+		}
 		SPDK_ERRLOG("aborting outstanding admin command\n");
 		nvme_qpair_manual_complete_tracker(qpair, tr, SPDK_NVME_SCT_GENERIC,
 						   SPDK_NVME_SC_ABORTED_BY_REQUEST, 1 /* do not retry */, true);
@@ -1009,8 +1481,8 @@ static void
 _nvme_io_qpair_enable(struct spdk_nvme_qpair *qpair)
 {
 	struct nvme_tracker		*tr;
-	struct nvme_tracker		*temp;
 	struct nvme_request		*req;
+	uint16_t			i;
 
 	qpair->is_enabled = true;
 
@@ -1024,7 +1496,11 @@ _nvme_io_qpair_enable(struct spdk_nvme_qpair *qpair)
 	}
 
 	/* Manually abort each outstanding I/O. */
-	LIST_FOREACH_SAFE(tr, &qpair->outstanding_tr, list, temp) {
+	for (i = 0; i < qpair->num_trackers; i++) {
+		tr = &qpair->tr[i];
+		if (tr->req == NULL) {
+			continue;
+		}
 		SPDK_ERRLOG("aborting outstanding i/o\n");
 		nvme_qpair_manual_complete_tracker(qpair, tr, SPDK_NVME_SCT_GENERIC,
 						   SPDK_NVME_SC_ABORTED_BY_REQUEST, 0, true);
@@ -1069,6 +1545,7 @@ nvme_qpair_fail(struct spdk_nvme_qpair *qpair)
 {
 	struct nvme_tracker		*tr;
 	struct nvme_request		*req;
+	uint16_t			i;
 
 	while (!STAILQ_EMPTY(&qpair->queued_req)) {
 		req = STAILQ_FIRST(&qpair->queued_req);
@@ -1079,10 +1556,13 @@ nvme_qpair_fail(struct spdk_nvme_qpair *qpair)
 	}
 
 	/* Manually abort each outstanding I/O. */
-	while (!LIST_EMPTY(&qpair->outstanding_tr)) {
-		tr = LIST_FIRST(&qpair->outstanding_tr);
+	for (i = 0; i < qpair->num_trackers; i++) {
+		tr = &qpair->tr[i];
+		if (tr->req == NULL) {
+			continue;
+		}
 		/*
-		 * Do not remove the tracker.  The abort_tracker path will
+		 * Do not free the tracker.  The complete_tracker path will
 		 *  do that for us.
 		 */
 		SPDK_ERRLOG("failing outstanding i/o\n");
@@ -1091,3 +1571,18 @@ nvme_qpair_fail(struct spdk_nvme_qpair *qpair)
 	}
 }
 
+SPDK_TRACE_REGISTER_FN(nvme_trace)
+{
+	spdk_trace_register_owner(OWNER_NVME_QPAIR, 'q');
+	spdk_trace_register_object(OBJECT_NVME_CMD, 'c');
+	spdk_trace_register_description("NVME_SUBMIT", "", TRACE_NVME_SUBMIT,
+					OWNER_NVME_QPAIR, OBJECT_NVME_CMD, 1, 0, 0, "cid:   ");
+	spdk_trace_register_description("NVME_COMPLETE", "", TRACE_NVME_COMPLETE,
+					OWNER_NVME_QPAIR, OBJECT_NVME_CMD, 0, 0, 0, "");
+	spdk_trace_register_description("NVME_QUEUED", "", TRACE_NVME_QUEUED,
+					OWNER_NVME_QPAIR, OBJECT_NONE, 0, 1, 0, "req:   ");
+	spdk_trace_register_description("NVME_SPLIT", "", TRACE_NVME_SPLIT,
+					OWNER_NONE, OBJECT_NONE, 0, 0, 0, "child: ");
+	spdk_trace_register_description("NVME_RETRY", "", TRACE_NVME_RETRY,
+					OWNER_NVME_QPAIR, OBJECT_NVME_CMD, 0, 0, 0, "");
+}
@@ -0,0 +1,1358 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * NVMe over Fabrics TCP host transport
+ *
+ * Each queue pair is one TCP connection.  Commands are sent as CapsuleCmd PDUs: writes up to
+ *  the controller's in-capsule data size carry their data in the capsule, larger writes wait
+ *  for an R2T and are answered with H2CData PDUs, and read data arrives in C2HData PDUs
+ *  directly into the request's buffer.  Header and data digests are not negotiated.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "nvme_internal.h"
+#include "spdk/nvmf_spec.h"
+
+#define NVME_TCP_PDU_MAX_HDR_SIZE		128
+#define NVME_TCP_RECV_BUF_SIZE			(64 * 1024)
+#define NVME_TCP_MAX_IOVS			64
+
+/* Payloads at least this large are received directly into the request's data buffer */
+#define NVME_TCP_DIRECT_RECV_THRESHOLD		4096
+
+/* Controllers accept up to 8 KiB of in-capsule data on the admin queue regardless of IOCCSZ */
+#define NVME_TCP_ADMIN_IN_CAPSULE_DATA_SIZE	8192
+
+/* Connect and property commands are sent outside of the trackers with this command ID */
+#define NVME_TCP_SYNC_CID			0xFFFF
+
+/* How long to wait for connection setup and for each synchronous command */
+#define NVME_TCP_SYNC_TIMEOUT_MS		5000
+
+struct nvme_tcp_req;
+
+/* A PDU queued for transmission */
+struct nvme_tcp_pdu {
+	/* PDU header, followed by padding up to the data offset */
+	uint8_t					hdr[NVME_TCP_PDU_MAX_HDR_SIZE];
+	uint32_t				hdr_len;
+
+	void					*data;
+	uint32_t				data_len;
+
+	/* Number of bytes of this PDU already written to the socket */
+	uint32_t				written;
+	bool					queued;
+
+	/* Command this PDU belongs to, or NULL */
+	struct nvme_tcp_req			*tcp_req;
+
+	TAILQ_ENTRY(nvme_tcp_pdu)		link;
+};
+
+/* Transport state of a command, indexed by command ID like the qpair's trackers */
+struct nvme_tcp_req {
+	struct nvme_tracker			*tr;
+
+	/* CapsuleCmd PDU, carrying the in-capsule data if any */
+	struct nvme_tcp_pdu			cmd_pdu;
+	/* H2CData PDU answering the current R2T */
+	struct nvme_tcp_pdu			h2c_pdu;
+
+	/* Bytes of host to controller data sent, and the end of the range the R2T asked for */
+	uint32_t				h2c_offset;
+	uint32_t				r2t_end;
+	uint16_t				ttag;
+
+	/* Bytes of controller to host data received so far */
+	uint32_t				c2h_offset;
+
+	/*
+	 * Completion received while a PDU of the command was partially written.  The
+	 *  tracker is completed once the PDU is out, since it still points to the payload.
+	 */
+	bool					cpl_deferred;
+	struct spdk_nvme_cpl			cpl;
+};
+
+enum nvme_tcp_recv_state {
+	/* Waiting for the 8 byte common header */
+	NVME_TCP_RECV_STATE_CH = 0,
+	/* Waiting for the rest of the PDU header */
+	NVME_TCP_RECV_STATE_PSH,
+	/* Skipping padding up to the data offset */
+	NVME_TCP_RECV_STATE_PAD,
+	NVME_TCP_RECV_STATE_DATA,
+};
+
+/* The PDU currently being received */
+struct nvme_tcp_recv_pdu {
+	enum nvme_tcp_recv_state		state;
+
+	union {
+		uint8_t					raw[NVME_TCP_PDU_MAX_HDR_SIZE];
+		struct spdk_nvme_tcp_common_pdu_hdr	common;
+		struct spdk_nvme_tcp_ic_resp		ic_resp;
+		struct spdk_nvme_tcp_rsp		capsule_resp;
+		struct spdk_nvme_tcp_c2h_data_hdr	c2h_data;
+		struct spdk_nvme_tcp_r2t_hdr		r2t;
+		struct spdk_nvme_tcp_term_req_hdr	term_req;
+	} hdr;
+
+	/* Destination of the current state's bytes (NULL to discard them) */
+	uint8_t					*dest;
+	uint32_t				need;
+	uint32_t				got;
+
+	uint32_t				pad_len;
+	uint32_t				data_len;
+	uint8_t					*data_dest;
+
+	struct nvme_tcp_req			*tcp_req;
+};
+
+struct nvme_tcp_qpair {
+	int					sock;
+
+	/* Set when the connection failed; the next poll reports it */
+	bool					failed;
+
+	/*
+	 * Number of polls and synchronous commands in progress, and whether to free the qpair
+	 *  when the last of them ends
+	 */
+	int					refs;
+	bool					disconnected;
+
+	/* Connection parameters returned in the ICResp */
+	bool					ic_done;
+	uint32_t				cpda_bytes;
+	uint32_t				maxh2cdata;
+
+	/* Writes up to this size are sent as in-capsule data */
+	uint32_t				in_capsule_data_size;
+
+	/* Array of size num_reqs, indexed by command ID */
+	struct nvme_tcp_req			*reqs;
+	uint16_t				num_reqs;
+	uint16_t				num_deferred_cpls;
+
+	/* Bytes read from the socket but not yet parsed */
+	uint8_t					*recv_buf;
+	uint32_t				recv_len;
+	uint32_t				recv_offset;
+
+	struct nvme_tcp_recv_pdu		recv_pdu;
+
+	/* PDUs waiting to be written to the socket, in order */
+	TAILQ_HEAD(, nvme_tcp_pdu)		send_queue;
+
+	struct nvme_tcp_pdu			ic_req_pdu;
+
+	/* Synchronous command (Connect, Property Get/Set) and its completion */
+	struct nvme_tcp_pdu			sync_pdu;
+	struct spdk_nvmf_fabric_connect_data	connect_data;
+	bool					sync_busy;
+	bool					sync_done;
+	struct spdk_nvme_cpl			sync_cpl;
+};
+
+static void nvme_tcp_qpair_disconnect(struct spdk_nvme_qpair *qpair);
+static void nvme_tcp_qpair_free(struct nvme_tcp_qpair *tqpair);
+
+/*
+ * Completion callbacks may disconnect the qpair while it is being polled, so the qpair is
+ *  only freed when the last poll or synchronous command using it returns.
+ */
+static inline void
+nvme_tcp_qpair_hold(struct nvme_tcp_qpair *tqpair)
+{
+	tqpair->refs++;
+}
+
+static inline void
+nvme_tcp_qpair_release(struct nvme_tcp_qpair *tqpair)
+{
+	if (--tqpair->refs == 0 && tqpair->disconnected) {
+		nvme_tcp_qpair_free(tqpair);
+	}
+}
+
+static void
+nvme_tcp_qpair_free(struct nvme_tcp_qpair *tqpair)
+{
+	if (tqpair->sock >= 0) {
+		close(tqpair->sock);
+	}
+
+	free(tqpair->recv_buf);
+	free(tqpair->reqs);
+	free(tqpair);
+}
+
+static int
+nvme_tcp_sock_connect(const char *traddr, const char *trsvcid)
+{
+	struct addrinfo		hints, *res, *ai;
+	int			sock = -1;
+	int			flags, val = 1;
+	int			rc;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	rc = getaddrinfo(traddr, trsvcid, &hints, &res);
+	if (rc != 0) {
+		SPDK_ERRLOG("getaddrinfo() failed for %s:%s: %s\n", traddr, trsvcid, gai_strerror(rc));
+		return -1;
+	}
+
+	for (ai = res; ai != NULL; ai = ai->ai_next) {
+		sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (sock < 0) {
+			continue;
+		}
+		if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+			break;
+		}
+		close(sock);
+		sock = -1;
+	}
+	freeaddrinfo(res);
+
+	if (sock < 0) {
+		SPDK_ERRLOG("Could not connect to %s:%s\n", traddr, trsvcid);
+		return -1;
+	}
+
+	/* Commands are batched by the flush, so do not let the kernel delay them further */
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+
+	flags = fcntl(sock, F_GETFL);
+	if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+		SPDK_ERRLOG("fcntl to set socket to non-blocking failed\n");
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+/*
+
+Transmit path.  PDUs are queued on the qpair and written out in batches by
+nvme_tcp_qpair_flush(), once per batch of submitted commands.
+
+*/
+
+static inline void
+nvme_tcp_pdu_init(struct nvme_tcp_pdu *pdu, enum spdk_nvme_tcp_pdu_type pdu_type, uint32_t hlen)
+{
+	struct spdk_nvme_tcp_common_pdu_hdr *common = (struct spdk_nvme_tcp_common_pdu_hdr *)pdu->hdr;
+
+	memset(pdu->hdr, 0, hlen);
+	common->pdu_type = pdu_type;
+	common->hlen = hlen;
+	pdu->hdr_len = hlen;
+	pdu->data = NULL;
+	pdu->data_len = 0;
+	pdu->written = 0;
+	pdu->tcp_req = NULL;
+}
+
+/* Pad the header to the controller's data alignment, fill in the PDU length and queue it. */
+static void
+nvme_tcp_pdu_queue(struct nvme_tcp_qpair *tqpair, struct nvme_tcp_pdu *pdu)
+{
+	struct spdk_nvme_tcp_common_pdu_hdr *common = (struct spdk_nvme_tcp_common_pdu_hdr *)pdu->hdr;
+	uint32_t pdo;
+
+	if (pdu->data_len > 0) {
+		if (tqpair->cpda_bytes > 1) {
+			pdo = (pdu->hdr_len + tqpair->cpda_bytes - 1) / tqpair->cpda_bytes *
+			      tqpair->cpda_bytes;
+			assert(pdo <= NVME_TCP_PDU_MAX_HDR_SIZE);
+			memset(&pdu->hdr[pdu->hdr_len], 0, pdo - pdu->hdr_len);
+			pdu->hdr_len = pdo;
+		}
+		common->pdo = pdu->hdr_len;
+	}
+
+	common->plen = pdu->hdr_len + pdu->data_len;
+
+	pdu->queued = true;
+	TAILQ_INSERT_TAIL(&tqpair->send_queue, pdu, link);
+}
+
+/* Queue the next H2CData PDU of the current R2T. */
+static void
+nvme_tcp_req_queue_h2c_data(struct nvme_tcp_qpair *tqpair, struct nvme_tcp_req *treq)
+{
+	struct nvme_request			*req = treq->tr->req;
+	struct nvme_tcp_pdu			*pdu = &treq->h2c_pdu;
+	struct spdk_nvme_tcp_h2c_data_hdr	*h2c_data;
+	uint32_t				len;
+
+	len = nvme_min(treq->r2t_end - treq->h2c_offset, tqpair->maxh2cdata);
+
+	nvme_tcp_pdu_init(pdu, SPDK_NVME_TCP_PDU_TYPE_H2C_DATA, sizeof(*h2c_data));
+	pdu->tcp_req = treq;
+	h2c_data = (struct spdk_nvme_tcp_h2c_data_hdr *)pdu->hdr;
+	h2c_data->cccid = treq->tr->cid;
+	h2c_data->ttag = treq->ttag;
+	h2c_data->datao = treq->h2c_offset;
+	h2c_data->datal = len;
+	pdu->data = (uint8_t *)req->payload.u.contig + req->payload_offset + treq->h2c_offset;
+	pdu->data_len = len;
+
+	/* The next PDU of this R2T is queued once this one has been written */
+	treq->h2c_offset += len;
+	if (treq->h2c_offset == treq->r2t_end) {
+		h2c_data->common.flags = SPDK_NVME_TCP_H2C_DATA_FLAGS_LAST_PDU;
+	}
+
+	nvme_tcp_pdu_queue(tqpair, pdu);
+}
+
+/* Append the unwritten parts of a PDU to an iovec array.  Returns the new iovec count. */
+static int
+nvme_tcp_pdu_get_iovs(struct nvme_tcp_pdu *pdu, struct iovec *iovs, int iovcnt)
+{
+	if (pdu->written < pdu->hdr_len) {
+		iovs[iovcnt].iov_base = pdu->hdr + pdu->written;
+		iovs[iovcnt].iov_len = pdu->hdr_len - pdu->written;
+		iovcnt++;
+		if (pdu->data_len > 0) {
+			iovs[iovcnt].iov_base = pdu->data;
+			iovs[iovcnt].iov_len = pdu->data_len;
+			iovcnt++;
+		}
+	} else {
+		iovs[iovcnt].iov_base = (uint8_t *)pdu->data + (pdu->written - pdu->hdr_len);
+		iovs[iovcnt].iov_len = pdu->hdr_len + pdu->data_len - pdu->written;
+		iovcnt++;
+	}
+
+	return iovcnt;
+}
+
+/* Write as many queued PDUs as the socket accepts.  Returns 0, or -1 on error. */
+static int
+nvme_tcp_qpair_flush_send_queue(struct nvme_tcp_qpair *tqpair)
+{
+	struct iovec		iovs[NVME_TCP_MAX_IOVS];
+	struct nvme_tcp_pdu	*pdu;
+	struct nvme_tcp_req	*treq;
+	size_t			total;
+	ssize_t			rc;
+	uint32_t		remaining, pdu_len;
+	int			iovcnt, i;
+
+	if (tqpair->failed) {
+		return -1;
+	}
+
+	while (!TAILQ_EMPTY(&tqpair->send_queue)) {
+		/* Gather as many PDUs as fit in one writev() */
+		iovcnt = 0;
+		TAILQ_FOREACH(pdu, &tqpair->send_queue, link) {
+			if (iovcnt > NVME_TCP_MAX_IOVS - 2) {
+				break;
+			}
+			iovcnt = nvme_tcp_pdu_get_iovs(pdu, iovs, iovcnt);
+		}
+
+		total = 0;
+		for (i = 0; i < iovcnt; i++) {
+			total += iovs[i].iov_len;
+		}
+
+		rc = writev(tqpair->sock, iovs, iovcnt);
+		if (rc < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return 0;
+			}
+			SPDK_ERRLOG("writev() failed: %s\n", strerror(errno));
+			tqpair->failed = true;
+			return -1;
+		}
+
+		/* Retire the PDUs that were completely written */
+		remaining = rc;
+		while ((pdu = TAILQ_FIRST(&tqpair->send_queue)) != NULL) {
+			pdu_len = pdu->hdr_len + pdu->data_len;
+			if (remaining < pdu_len - pdu->written) {
+				pdu->written += remaining;
+				break;
+			}
+
+			remaining -= pdu_len - pdu->written;
+			TAILQ_REMOVE(&tqpair->send_queue, pdu, link);
+			pdu->queued = false;
+			treq = pdu->tcp_req;
+			if (treq != NULL && pdu == &treq->h2c_pdu && treq->tr != NULL &&
+			    treq->h2c_offset != treq->r2t_end) {
+				nvme_tcp_req_queue_h2c_data(tqpair, treq);
+			}
+		}
+
+		if ((size_t)rc < total) {
+			/* The socket buffer is full */
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static void
+nvme_tcp_qpair_flush(struct spdk_nvme_qpair *qpair)
+{
+	struct nvme_tcp_qpair *tqpair = qpair->transport_ctx;
+
+	if (tqpair != NULL) {
+		/* Errors are reported by the next nvme_tcp_qpair_process_completions() */
+		nvme_tcp_qpair_flush_send_queue(tqpair);
+	}
+}
+
+static int
+nvme_tcp_qpair_check_request(struct spdk_nvme_qpair *qpair, struct nvme_request *req)
+{
+	/* Data is sent and received straight from the caller's buffer */
+	if (req->payload_size != 0 &&
+	    (req->payload.type != NVME_PAYLOAD_TYPE_CONTIG || req->payload.md != NULL)) {
+		SPDK_ERRLOG("TCP transport only supports contiguous payloads without separate metadata\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static void
+nvme_tcp_qpair_queue_tracker(struct spdk_nvme_qpair *qpair, struct nvme_tracker *tr)
+{
+	struct nvme_tcp_qpair		*tqpair = qpair->transport_ctx;
+	struct nvme_request		*req = tr->req;
+	struct nvme_tcp_req		*treq;
+	struct nvme_tcp_pdu		*pdu;
+	struct spdk_nvme_tcp_cmd	*capsule_cmd;
+	struct spdk_nvme_sgl_descriptor	*sgl;
+
+	if (tqpair == NULL) {
+		/*
+		 * The qpair is not connected.  The tracker stays outstanding and is aborted
+		 *  when the qpair is reconnected and enabled again.
+		 */
+		return;
+	}
+
+	treq = &tqpair->reqs[tr->cid];
+	assert(!treq->cpl_deferred);
+	treq->tr = tr;
+	treq->h2c_offset = 0;
+	treq->r2t_end = 0;
+	treq->c2h_offset = 0;
+
+	pdu = &treq->cmd_pdu;
+	nvme_tcp_pdu_init(pdu, SPDK_NVME_TCP_PDU_TYPE_CAPSULE_CMD, sizeof(*capsule_cmd));
+	capsule_cmd = (struct spdk_nvme_tcp_cmd *)pdu->hdr;
+	memcpy(&capsule_cmd->ccsqe, &req->cmd, sizeof(capsule_cmd->ccsqe));
+	pdu->tcp_req = treq;
+
+	/* Fabrics commands always describe their data with an SGL */
+	capsule_cmd->ccsqe.psdt = SPDK_NVME_PSDT_SGL_MPTR_CONTIG;
+	sgl = &capsule_cmd->ccsqe.dptr.sgl1;
+	memset(sgl, 0, sizeof(*sgl));
+	sgl->unkeyed.length = req->payload_size;
+
+	if (req->payload_size > 0 && req->payload_size <= tqpair->in_capsule_data_size &&
+	    spdk_nvme_opc_get_data_transfer(req->cmd.opc) == SPDK_NVME_DATA_HOST_TO_CONTROLLER) {
+		sgl->unkeyed.type = SPDK_NVME_SGL_TYPE_DATA_BLOCK;
+		sgl->unkeyed.subtype = SPDK_NVME_SGL_SUBTYPE_OFFSET;
+		pdu->data = (uint8_t *)req->payload.u.contig + req->payload_offset;
+		pdu->data_len = req->payload_size;
+		treq->h2c_offset = req->payload_size;
+	} else {
+		sgl->unkeyed.type = SPDK_NVME_SGL_TYPE_TRANSPORT_DATA_BLOCK;
+		sgl->unkeyed.subtype = SPDK_NVME_SGL_SUBTYPE_TRANSPORT;
+	}
+
+	nvme_tcp_pdu_queue(tqpair, pdu);
+}
+
+/*
+
+Receive path.  Bytes read from the socket are run through a small state machine
+that reassembles one PDU at a time: common header, rest of the header, padding
+and data.
+
+*/
+
+static inline void
+nvme_tcp_recv_set_state(struct nvme_tcp_recv_pdu *pdu, enum nvme_tcp_recv_state state,
+			void *dest, uint32_t len)
+{
+	pdu->state = state;
+	pdu->dest = dest;
+	pdu->need = len;
+	pdu->got = 0;
+}
+
+static inline void
+nvme_tcp_recv_next_pdu(struct nvme_tcp_recv_pdu *pdu)
+{
+	pdu->tcp_req = NULL;
+	nvme_tcp_recv_set_state(pdu, NVME_TCP_RECV_STATE_CH, pdu->hdr.raw,
+				sizeof(struct spdk_nvme_tcp_common_pdu_hdr));
+}
+
+/* Find the outstanding command with the given command ID. */
+static struct nvme_tcp_req *
+nvme_tcp_qpair_get_req(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair,
+		       uint16_t cid)
+{
+	if (cid >= tqpair->num_reqs || !qpair->tr[cid].active || tqpair->reqs[cid].tr == NULL) {
+		SPDK_ERRLOG("PDU for CID 0x%x does not map to an outstanding command\n", cid);
+		return NULL;
+	}
+
+	return &tqpair->reqs[cid];
+}
+
+/*
+ * Drop the PDUs of a command that are still queued when its completion arrives, e.g. the
+ *  H2CData of an R2T the controller failed the command after.  Returns false if one of them
+ *  is partially written and has to be finished first.
+ */
+static bool
+nvme_tcp_req_drop_pdus(struct nvme_tcp_qpair *tqpair, struct nvme_tcp_req *treq)
+{
+	struct nvme_tcp_pdu *pdus[] = { &treq->cmd_pdu, &treq->h2c_pdu };
+	bool idle = true;
+	size_t i;
+
+	for (i = 0; i < sizeof(pdus) / sizeof(pdus[0]); i++) {
+		if (!pdus[i]->queued) {
+			continue;
+		}
+		if (pdus[i]->written == 0) {
+			TAILQ_REMOVE(&tqpair->send_queue, pdus[i], link);
+			pdus[i]->queued = false;
+		} else {
+			idle = false;
+		}
+	}
+
+	return idle;
+}
+
+/* Complete the trackers whose completion waited for a partially written PDU. */
+static int
+nvme_tcp_qpair_complete_deferred(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair)
+{
+	struct nvme_tcp_req	*treq;
+	struct spdk_nvme_cpl	cpl;
+	uint16_t		cid;
+	int			count = 0;
+
+	for (cid = 0; cid < tqpair->num_reqs && tqpair->num_deferred_cpls > 0; cid++) {
+		treq = &tqpair->reqs[cid];
+		if (!treq->cpl_deferred || treq->cmd_pdu.queued || treq->h2c_pdu.queued) {
+			continue;
+		}
+
+		treq->cpl_deferred = false;
+		tqpair->num_deferred_cpls--;
+		cpl = treq->cpl;
+		nvme_qpair_complete_tracker(qpair, &qpair->tr[cid], &cpl, true);
+		count++;
+		if (tqpair->disconnected) {
+			break;
+		}
+	}
+
+	return count;
+}
+
+/* Returns 1 if a tracker was completed, 0 for the synchronous command, or -1 on error. */
+static int
+nvme_tcp_qpair_complete(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair,
+			struct spdk_nvme_cpl *cpl)
+{
+	struct nvme_tcp_req *treq;
+
+	if (cpl->cid == NVME_TCP_SYNC_CID) {
+		if (!tqpair->sync_busy) {
+			SPDK_ERRLOG("Unexpected completion of a synchronous command\n");
+			return 0;
+		}
+		tqpair->sync_cpl = *cpl;
+		tqpair->sync_done = true;
+		return 0;
+	}
+
+	treq = nvme_tcp_qpair_get_req(qpair, tqpair, cpl->cid);
+	if (treq == NULL) {
+		return -1;
+	}
+
+	/* Later PDUs for this command ID are rejected, and no more H2CData is queued */
+	treq->tr = NULL;
+	if (!nvme_tcp_req_drop_pdus(tqpair, treq)) {
+		treq->cpl = *cpl;
+		treq->cpl_deferred = true;
+		tqpair->num_deferred_cpls++;
+		return 0;
+	}
+
+	nvme_qpair_complete_tracker(qpair, &qpair->tr[cpl->cid], cpl, true);
+	return 1;
+}
+
+static int
+nvme_tcp_recv_ic_resp(struct nvme_tcp_qpair *tqpair)
+{
+	struct spdk_nvme_tcp_ic_resp *ic_resp = &tqpair->recv_pdu.hdr.ic_resp;
+
+	if (ic_resp->pfv != 0 || ic_resp->cpda > SPDK_NVME_TCP_PDA_MAX ||
+	    ic_resp->dgst.raw != 0 || ic_resp->maxh2cdata < 4096 || ic_resp->maxh2cdata % 4 != 0) {
+		SPDK_ERRLOG("Unsupported ICResp: pfv %u cpda %u dgst 0x%x maxh2cdata %u\n",
+			    ic_resp->pfv, ic_resp->cpda, ic_resp->dgst.raw, ic_resp->maxh2cdata);
+		return -1;
+	}
+
+	tqpair->cpda_bytes = (ic_resp->cpda + 1) * 4;
+	tqpair->maxh2cdata = ic_resp->maxh2cdata;
+	tqpair->ic_done = true;
+
+	SPDK_TRACELOG(SPDK_TRACE_NVME_TCP, "ICResp: cpda %u maxh2cdata %u\n", ic_resp->cpda,
+		      ic_resp->maxh2cdata);
+
+	nvme_tcp_recv_next_pdu(&tqpair->recv_pdu);
+	return 0;
+}
+
+static int
+nvme_tcp_recv_capsule_resp(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair)
+{
+	struct spdk_nvme_cpl cpl = tqpair->recv_pdu.hdr.capsule_resp.rccqe;
+
+	/* The receive state is reset first, since the completion may poll this qpair again */
+	nvme_tcp_recv_next_pdu(&tqpair->recv_pdu);
+
+	return nvme_tcp_qpair_complete(qpair, tqpair, &cpl);
+}
+
+static int
+nvme_tcp_recv_c2h_data(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair)
+{
+	struct nvme_tcp_recv_pdu		*pdu = &tqpair->recv_pdu;
+	struct spdk_nvme_tcp_c2h_data_hdr	*c2h_data = &pdu->hdr.c2h_data;
+	struct nvme_tcp_req			*treq;
+	struct nvme_request			*req;
+
+	treq = nvme_tcp_qpair_get_req(qpair, tqpair, c2h_data->cccid);
+	if (treq == NULL) {
+		return -1;
+	}
+
+	req = treq->tr->req;
+	if (c2h_data->datao != treq->c2h_offset ||
+	    c2h_data->datal != pdu->data_len ||
+	    c2h_data->datal > req->payload_size - treq->c2h_offset) {
+		SPDK_ERRLOG("C2HData offset 0x%x length 0x%x out of range\n", c2h_data->datao,
+			    c2h_data->datal);
+		return -1;
+	}
+
+	if ((c2h_data->common.flags & SPDK_NVME_TCP_C2H_DATA_FLAGS_SUCCESS) &&
+	    !(c2h_data->common.flags & SPDK_NVME_TCP_C2H_DATA_FLAGS_LAST_PDU)) {
+		SPDK_ERRLOG("C2HData with SUCCESS but not LAST_PDU flag\n");
+		return -1;
+	}
+
+	pdu->tcp_req = treq;
+	pdu->data_dest = (uint8_t *)req->payload.u.contig + req->payload_offset + c2h_data->datao;
+	return 0;
+}
+
+static int
+nvme_tcp_recv_c2h_data_done(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair)
+{
+	struct nvme_tcp_recv_pdu	*pdu = &tqpair->recv_pdu;
+	struct nvme_tcp_req		*treq = pdu->tcp_req;
+	struct spdk_nvme_cpl		cpl;
+	uint8_t				flags = pdu->hdr.c2h_data.common.flags;
+
+	treq->c2h_offset += pdu->hdr.c2h_data.datal;
+	nvme_tcp_recv_next_pdu(pdu);
+
+	if (!(flags & SPDK_NVME_TCP_C2H_DATA_FLAGS_SUCCESS)) {
+		return 0;
+	}
+
+	/* The controller omitted the CapsuleResp of a successful command */
+	memset(&cpl, 0, sizeof(cpl));
+	cpl.cid = treq->tr->cid;
+	cpl.sqid = qpair->id;
+	return nvme_tcp_qpair_complete(qpair, tqpair, &cpl);
+}
+
+static int
+nvme_tcp_recv_r2t(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair)
+{
+	struct spdk_nvme_tcp_r2t_hdr	*r2t = &tqpair->recv_pdu.hdr.r2t;
+	struct nvme_tcp_req		*treq;
+	struct nvme_request		*req;
+
+	treq = nvme_tcp_qpair_get_req(qpair, tqpair, r2t->cccid);
+	if (treq == NULL) {
+		return -1;
+	}
+
+	req = treq->tr->req;
+	if (spdk_nvme_opc_get_data_transfer(req->cmd.opc) != SPDK_NVME_DATA_HOST_TO_CONTROLLER ||
+	    treq->h2c_offset != treq->r2t_end || r2t->r2to != treq->h2c_offset ||
+	    r2t->r2tl == 0 || r2t->r2tl > req->payload_size - r2t->r2to) {
+		SPDK_ERRLOG("R2T offset 0x%x length 0x%x out of range\n", r2t->r2to, r2t->r2tl);
+		return -1;
+	}
+
+	treq->ttag = r2t->ttag;
+	treq->r2t_end = r2t->r2to + r2t->r2tl;
+	nvme_tcp_req_queue_h2c_data(tqpair, treq);
+
+	nvme_tcp_recv_next_pdu(&tqpair->recv_pdu);
+	return 0;
+}
+
+/* Validate the common header and size the rest of the PDU header. */
+static int
+nvme_tcp_recv_ch(struct nvme_tcp_qpair *tqpair)
+{
+	struct nvme_tcp_recv_pdu		*pdu = &tqpair->recv_pdu;
+	struct spdk_nvme_tcp_common_pdu_hdr	*common = &pdu->hdr.common;
+	uint32_t				expected_hlen;
+
+	switch (common->pdu_type) {
+	case SPDK_NVME_TCP_PDU_TYPE_IC_RESP:
+		expected_hlen = sizeof(struct spdk_nvme_tcp_ic_resp);
+		break;
+	case SPDK_NVME_TCP_PDU_TYPE_C2H_TERM_REQ:
+		expected_hlen = sizeof(struct spdk_nvme_tcp_term_req_hdr);
+		break;
+	case SPDK_NVME_TCP_PDU_TYPE_CAPSULE_RESP:
+		expected_hlen = sizeof(struct spdk_nvme_tcp_rsp);
+		break;
+	case SPDK_NVME_TCP_PDU_TYPE_C2H_DATA:
+		expected_hlen = sizeof(struct spdk_nvme_tcp_c2h_data_hdr);
+		break;
+	case SPDK_NVME_TCP_PDU_TYPE_R2T:
+		expected_hlen = sizeof(struct spdk_nvme_tcp_r2t_hdr);
+		break;
+	default:
+		SPDK_ERRLOG("Unexpected PDU type 0x%x\n", common->pdu_type);
+		return -1;
+	}
+
+	if ((common->pdu_type == SPDK_NVME_TCP_PDU_TYPE_IC_RESP) == tqpair->ic_done) {
+		SPDK_ERRLOG("Unexpected PDU type 0x%x %s connection initialization\n", common->pdu_type,
+			    tqpair->ic_done ? "after" : "before");
+		return -1;
+	}
+
+	if (common->hlen != expected_hlen) {
+		SPDK_ERRLOG("Invalid HLEN %u for PDU type 0x%x\n", common->hlen, common->pdu_type);
+		return -1;
+	}
+
+	if (common->flags & (SPDK_NVME_TCP_CH_FLAGS_HDGSTF | SPDK_NVME_TCP_CH_FLAGS_DDGSTF)) {
+		SPDK_ERRLOG("PDU flags 0x%x use a digest that was not negotiated\n", common->flags);
+		return -1;
+	}
+
+	if (common->plen < common->hlen ||
+	    (common->pdu_type != SPDK_NVME_TCP_PDU_TYPE_C2H_DATA &&
+	     common->pdu_type != SPDK_NVME_TCP_PDU_TYPE_C2H_TERM_REQ &&
+	     common->plen != common->hlen)) {
+		SPDK_ERRLOG("Invalid PLEN %u for PDU type 0x%x\n", common->plen, common->pdu_type);
+		return -1;
+	}
+
+	nvme_tcp_recv_set_state(pdu, NVME_TCP_RECV_STATE_PSH,
+				pdu->hdr.raw + sizeof(struct spdk_nvme_tcp_common_pdu_hdr),
+				common->hlen - sizeof(struct spdk_nvme_tcp_common_pdu_hdr));
+	return 0;
+}
+
+/* Locate the data and dispatch the PDU header.  Returns the number of completed trackers. */
+static int
+nvme_tcp_recv_psh(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair)
+{
+	struct nvme_tcp_recv_pdu		*pdu = &tqpair->recv_pdu;
+	struct spdk_nvme_tcp_common_pdu_hdr	*common = &pdu->hdr.common;
+	int					rc;
+
+	switch (common->pdu_type) {
+	case SPDK_NVME_TCP_PDU_TYPE_IC_RESP:
+		return nvme_tcp_recv_ic_resp(tqpair);
+	case SPDK_NVME_TCP_PDU_TYPE_CAPSULE_RESP:
+		return nvme_tcp_recv_capsule_resp(qpair, tqpair);
+	case SPDK_NVME_TCP_PDU_TYPE_R2T:
+		return nvme_tcp_recv_r2t(qpair, tqpair);
+	case SPDK_NVME_TCP_PDU_TYPE_C2H_TERM_REQ:
+		SPDK_ERRLOG("Controller terminated the connection: fes 0x%x fei 0x%x\n",
+			    pdu->hdr.term_req.fes, pdu->hdr.term_req.fei);
+		return -1;
+	default:
+		break;
+	}
+
+	assert(common->pdu_type == SPDK_NVME_TCP_PDU_TYPE_C2H_DATA);
+	if (common->plen == common->hlen || common->pdo < common->hlen ||
+	    common->pdo > NVME_TCP_PDU_MAX_HDR_SIZE || common->plen < common->pdo) {
+		SPDK_ERRLOG("Invalid PDO %u for PDU of length %u\n", common->pdo, common->plen);
+		return -1;
+	}
+	pdu->pad_len = common->pdo - common->hlen;
+	pdu->data_len = common->plen - common->pdo;
+
+	rc = nvme_tcp_recv_c2h_data(qpair, tqpair);
+	if (rc < 0) {
+		return rc;
+	}
+
+	if (pdu->data_len == 0) {
+		return nvme_tcp_recv_c2h_data_done(qpair, tqpair);
+	}
+
+	if (pdu->pad_len > 0) {
+		nvme_tcp_recv_set_state(pdu, NVME_TCP_RECV_STATE_PAD, NULL, pdu->pad_len);
+	} else {
+		nvme_tcp_recv_set_state(pdu, NVME_TCP_RECV_STATE_DATA, pdu->data_dest, pdu->data_len);
+	}
+	return 0;
+}
+
+/* The current receive state has all of its bytes.  Returns the number of completed trackers. */
+static int
+nvme_tcp_recv_state_done(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair)
+{
+	struct nvme_tcp_recv_pdu *pdu = &tqpair->recv_pdu;
+
+	switch (pdu->state) {
+	case NVME_TCP_RECV_STATE_CH:
+		return nvme_tcp_recv_ch(tqpair);
+	case NVME_TCP_RECV_STATE_PSH:
+		return nvme_tcp_recv_psh(qpair, tqpair);
+	case NVME_TCP_RECV_STATE_PAD:
+		nvme_tcp_recv_set_state(pdu, NVME_TCP_RECV_STATE_DATA, pdu->data_dest, pdu->data_len);
+		return 0;
+	case NVME_TCP_RECV_STATE_DATA:
+		return nvme_tcp_recv_c2h_data_done(qpair, tqpair);
+	}
+
+	return -1;
+}
+
+/*
+ * Read once from the socket.  Large read payloads are received directly into the request's
+ *  buffer, everything else goes through recv_buf.
+ *
+ * Returns the number of bytes read, 0 if no data was available, or -1 on error.
+ */
+static int
+nvme_tcp_sock_recv(struct nvme_tcp_qpair *tqpair)
+{
+	struct nvme_tcp_recv_pdu	*pdu = &tqpair->recv_pdu;
+	uint32_t			remaining = pdu->need - pdu->got;
+	ssize_t				rc;
+
+	if (pdu->state == NVME_TCP_RECV_STATE_DATA && remaining >= NVME_TCP_DIRECT_RECV_THRESHOLD) {
+		rc = recv(tqpair->sock, pdu->dest + pdu->got, remaining, 0);
+		if (rc > 0) {
+			pdu->got += rc;
+		}
+	} else {
+		rc = recv(tqpair->sock, tqpair->recv_buf, NVME_TCP_RECV_BUF_SIZE, 0);
+		if (rc > 0) {
+			tqpair->recv_len = rc;
+			tqpair->recv_offset = 0;
+		}
+	}
+
+	if (rc == 0) {
+		SPDK_ERRLOG("Connection closed by the controller\n");
+		return -1;
+	} else if (rc < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return 0;
+		}
+		SPDK_ERRLOG("recv() failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return rc;
+}
+
+/*
+ * Read from the socket once and parse what was read, stopping after max_completions
+ *  completed trackers.
+ *
+ * Returns the number of completed trackers, or -1 on error.
+ */
+static int
+nvme_tcp_qpair_recv(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair,
+		    uint32_t max_completions)
+{
+	struct nvme_tcp_recv_pdu	*pdu = &tqpair->recv_pdu;
+	uint32_t			len;
+	bool				did_recv = false;
+	int				rc;
+	uint32_t			count = 0;
+
+	while (count < max_completions && !tqpair->disconnected) {
+		if (tqpair->recv_offset == tqpair->recv_len) {
+			if (did_recv) {
+				break;
+			}
+			did_recv = true;
+
+			rc = nvme_tcp_sock_recv(tqpair);
+			if (rc <= 0) {
+				return rc < 0 ? -1 : (int)count;
+			}
+		} else {
+			len = tqpair->recv_len - tqpair->recv_offset;
+			if (len > pdu->need - pdu->got) {
+				len = pdu->need - pdu->got;
+			}
+			if (pdu->dest) {
+				memcpy(pdu->dest + pdu->got, tqpair->recv_buf + tqpair->recv_offset, len);
+			}
+			pdu->got += len;
+			tqpair->recv_offset += len;
+		}
+
+		if (pdu->got == pdu->need) {
+			rc = nvme_tcp_recv_state_done(qpair, tqpair);
+			if (rc < 0) {
+				return -1;
+			}
+			count += rc;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * Send queued PDUs, receive and complete commands, then send the PDUs queued by the R2Ts
+ *  and completion callbacks of this poll.
+ */
+static int32_t
+nvme_tcp_qpair_poll(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair,
+		    uint32_t max_completions)
+{
+	int32_t rc;
+
+	nvme_tcp_qpair_hold(tqpair);
+
+	rc = nvme_tcp_qpair_flush_send_queue(tqpair);
+	if (rc == 0) {
+		rc = nvme_tcp_qpair_recv(qpair, tqpair, max_completions);
+	}
+	if (rc >= 0 && !tqpair->disconnected && nvme_tcp_qpair_flush_send_queue(tqpair) != 0) {
+		rc = -1;
+	}
+	if (rc >= 0 && !tqpair->disconnected && tqpair->num_deferred_cpls > 0) {
+		rc += nvme_tcp_qpair_complete_deferred(qpair, tqpair);
+	}
+
+	if (rc < 0) {
+		tqpair->failed = true;
+	}
+
+	nvme_tcp_qpair_release(tqpair);
+
+	return rc;
+}
+
+static int32_t
+nvme_tcp_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_completions)
+{
+	struct nvme_tcp_qpair *tqpair = qpair->transport_ctx;
+
+	if (tqpair == NULL) {
+		/* Not connected, e.g. while the controller is being reset */
+		return 0;
+	}
+
+	return nvme_tcp_qpair_poll(qpair, tqpair, max_completions);
+}
+
+/*
+ * Poll the qpair until *done is set.  The caller holds a reference to the qpair.
+ *
+ * Returns 0, or -1 on error or timeout.  A timed out qpair is marked failed, since the
+ *  PDU that was waited on may still be queued, partially written or answered later.
+ */
+static int
+nvme_tcp_qpair_wait(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair, bool *done)
+{
+	uint64_t timeout_tsc;
+
+	timeout_tsc = nvme_get_tsc() +
+		      (uint64_t)NVME_TCP_SYNC_TIMEOUT_MS * nvme_get_tsc_hz() / 1000;
+	while (!*done) {
+		if (tqpair->failed || tqpair->disconnected) {
+			return -1;
+		}
+		nvme_tcp_qpair_poll(qpair, tqpair, UINT32_MAX);
+		if (nvme_get_tsc() > timeout_tsc) {
+			SPDK_ERRLOG("Timed out waiting for the controller\n");
+			tqpair->failed = true;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Send a Fabrics command outside of the trackers and wait for its completion.  Data, if any,
+ *  is sent in the capsule.
+ */
+static int
+nvme_tcp_qpair_sync_cmd(struct spdk_nvme_qpair *qpair, struct spdk_nvme_cmd *cmd,
+			void *data, uint32_t data_len, struct spdk_nvme_cpl *cpl)
+{
+	struct nvme_tcp_qpair		*tqpair = qpair->transport_ctx;
+	struct nvme_tcp_pdu		*pdu;
+	struct spdk_nvme_tcp_cmd	*capsule_cmd;
+	struct spdk_nvme_sgl_descriptor	*sgl;
+	int				rc;
+
+	if (tqpair == NULL || tqpair->sync_busy || tqpair->failed) {
+		SPDK_ERRLOG("qpair %u cannot send a fabrics command now\n", qpair->id);
+		return -1;
+	}
+
+	pdu = &tqpair->sync_pdu;
+	nvme_tcp_pdu_init(pdu, SPDK_NVME_TCP_PDU_TYPE_CAPSULE_CMD, sizeof(*capsule_cmd));
+	capsule_cmd = (struct spdk_nvme_tcp_cmd *)pdu->hdr;
+	memcpy(&capsule_cmd->ccsqe, cmd, sizeof(capsule_cmd->ccsqe));
+	capsule_cmd->ccsqe.cid = NVME_TCP_SYNC_CID;
+	capsule_cmd->ccsqe.psdt = SPDK_NVME_PSDT_SGL_MPTR_CONTIG;
+	sgl = &capsule_cmd->ccsqe.dptr.sgl1;
+	memset(sgl, 0, sizeof(*sgl));
+	sgl->unkeyed.type = SPDK_NVME_SGL_TYPE_DATA_BLOCK;
+	sgl->unkeyed.subtype = SPDK_NVME_SGL_SUBTYPE_OFFSET;
+	sgl->unkeyed.length = data_len;
+	pdu->data = data;
+	pdu->data_len = data_len;
+
+	tqpair->sync_busy = true;
+	tqpair->sync_done = false;
+	nvme_tcp_pdu_queue(tqpair, pdu);
+
+	nvme_tcp_qpair_hold(tqpair);
+	rc = nvme_tcp_qpair_wait(qpair, tqpair, &tqpair->sync_done);
+	if (rc == 0) {
+		*cpl = tqpair->sync_cpl;
+	}
+	tqpair->sync_busy = false;
+	nvme_tcp_qpair_release(tqpair);
+
+	return rc;
+}
+
+/* Exchange ICReq and ICResp to set up the connection. */
+static int
+nvme_tcp_qpair_icreq(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair)
+{
+	struct nvme_tcp_pdu		*pdu = &tqpair->ic_req_pdu;
+	struct spdk_nvme_tcp_ic_req	*ic_req;
+	int				rc;
+
+	nvme_tcp_pdu_init(pdu, SPDK_NVME_TCP_PDU_TYPE_IC_REQ, sizeof(*ic_req));
+	ic_req = (struct spdk_nvme_tcp_ic_req *)pdu->hdr;
+	ic_req->pfv = 0;
+	ic_req->hpda = 0;
+	ic_req->maxr2t = 0;
+	nvme_tcp_pdu_queue(tqpair, pdu);
+
+	nvme_tcp_qpair_hold(tqpair);
+	rc = nvme_tcp_qpair_wait(qpair, tqpair, &tqpair->ic_done);
+	nvme_tcp_qpair_release(tqpair);
+
+	return rc;
+}
+
+static int
+nvme_tcp_qpair_fabric_connect(struct spdk_nvme_qpair *qpair, struct nvme_tcp_qpair *tqpair)
+{
+	struct spdk_nvme_ctrlr			*ctrlr = qpair->ctrlr;
+	struct spdk_nvmf_fabric_connect_data	*data = &tqpair->connect_data;
+	struct spdk_nvmf_fabric_connect_cmd	*cmd;
+	struct spdk_nvmf_fabric_connect_rsp	*rsp;
+	struct spdk_nvme_cmd			nvme_cmd;
+	struct spdk_nvme_cpl			cpl;
+
+	memset(&nvme_cmd, 0, sizeof(nvme_cmd));
+	cmd = (struct spdk_nvmf_fabric_connect_cmd *)&nvme_cmd;
+	cmd->opcode = SPDK_NVME_OPC_FABRIC;
+	cmd->fctype = SPDK_NVMF_FABRIC_COMMAND_CONNECT;
+	cmd->recfmt = 0;
+	cmd->qid = qpair->id;
+	/* Only the trackers and the synchronous command can ever be outstanding */
+	cmd->sqsize = nvme_min(qpair->num_entries - 1, qpair->num_trackers + 1);
+
+	memset(data, 0, sizeof(*data));
+	data->cntlid = qpair->id == 0 ? 0xFFFF : ctrlr->cntlid;
+	snprintf((char *)data->subnqn, sizeof(data->subnqn), "%s", ctrlr->trid.subnqn);
+	snprintf((char *)data->hostnqn, sizeof(data->hostnqn), "%s", ctrlr->opts.hostnqn);
+
+	if (nvme_tcp_qpair_sync_cmd(qpair, &nvme_cmd, data, sizeof(*data), &cpl) != 0) {
+		return -1;
+	}
+
+	if (spdk_nvme_cpl_is_error(&cpl)) {
+		SPDK_ERRLOG("Connect of qpair %u to %s failed: sct 0x%x sc 0x%x\n", qpair->id,
+			    ctrlr->trid.subnqn, cpl.status.sct, cpl.status.sc);
+		return -1;
+	}
+
+	if (qpair->id == 0) {
+		rsp = (struct spdk_nvmf_fabric_connect_rsp *)&cpl;
+		ctrlr->cntlid = rsp->status_code_specific.success.cntlid;
+		SPDK_TRACELOG(SPDK_TRACE_NVME_TCP, "Connected to %s, cntlid 0x%x\n",
+			      ctrlr->trid.subnqn, ctrlr->cntlid);
+	}
+
+	return 0;
+}
+
+static int
+nvme_tcp_qpair_connect(struct spdk_nvme_qpair *qpair)
+{
+	struct spdk_nvme_ctrlr	*ctrlr = qpair->ctrlr;
+	struct nvme_tcp_qpair	*tqpair;
+	uint32_t		ioccsz;
+
+	nvme_tcp_qpair_disconnect(qpair);
+
+	tqpair = calloc(1, sizeof(*tqpair));
+	if (tqpair == NULL) {
+		SPDK_ERRLOG("Could not allocate TCP qpair\n");
+		return -1;
+	}
+
+	tqpair->sock = -1;
+	TAILQ_INIT(&tqpair->send_queue);
+	nvme_tcp_recv_next_pdu(&tqpair->recv_pdu);
+
+	if (qpair->id == 0) {
+		tqpair->in_capsule_data_size = NVME_TCP_ADMIN_IN_CAPSULE_DATA_SIZE;
+	} else {
+		/* IOCCSZ is in 16 byte units and includes the 64 byte command */
+		ioccsz = ctrlr->cdata.nvmf_specific.ioccsz;
+		tqpair->in_capsule_data_size = ioccsz > 4 ? (ioccsz - 4) * 16 : 0;
+	}
+
+	tqpair->num_reqs = qpair->num_trackers;
+	tqpair->reqs = calloc(tqpair->num_reqs, sizeof(*tqpair->reqs));
+	tqpair->recv_buf = malloc(NVME_TCP_RECV_BUF_SIZE);
+	if (tqpair->reqs == NULL || tqpair->recv_buf == NULL) {
+		SPDK_ERRLOG("Unable to allocate sufficient memory for TCP qpair\n");
+		nvme_tcp_qpair_free(tqpair);
+		return -1;
+	}
+
+	tqpair->sock = nvme_tcp_sock_connect(ctrlr->trid.traddr, ctrlr->trid.trsvcid);
+	if (tqpair->sock < 0) {
+		nvme_tcp_qpair_free(tqpair);
+		return -1;
+	}
+
+	qpair->transport_ctx = tqpair;
+
+	if (nvme_tcp_qpair_icreq(qpair, tqpair) != 0 ||
+	    nvme_tcp_qpair_fabric_connect(qpair, tqpair) != 0) {
+		nvme_tcp_qpair_disconnect(qpair);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+nvme_tcp_qpair_disconnect(struct spdk_nvme_qpair *qpair)
+{
+	struct nvme_tcp_qpair *tqpair = qpair->transport_ctx;
+
+	if (tqpair == NULL) {
+		return;
+	}
+
+	qpair->transport_ctx = NULL;
+
+	if (tqpair->refs > 0) {
+		/* Called while the qpair is in use; the last user frees it */
+		tqpair->disconnected = true;
+		return;
+	}
+
+	nvme_tcp_qpair_free(tqpair);
+}
+
+/*
+
+Controller registers are Fabrics properties, read and written with Property Get and
+Property Set commands on the admin queue.
+
+*/
+
+static int
+nvme_tcp_ctrlr_get_reg(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset, uint8_t size,
+		       uint64_t *value)
+{
+	struct spdk_nvmf_fabric_prop_get_cmd	*cmd;
+	struct spdk_nvmf_fabric_prop_get_rsp	*rsp;
+	struct spdk_nvme_cmd			nvme_cmd;
+	struct spdk_nvme_cpl			cpl;
+
+	memset(&nvme_cmd, 0, sizeof(nvme_cmd));
+	cmd = (struct spdk_nvmf_fabric_prop_get_cmd *)&nvme_cmd;
+	cmd->opcode = SPDK_NVME_OPC_FABRIC;
+	cmd->fctype = SPDK_NVMF_FABRIC_COMMAND_PROPERTY_GET;
+	cmd->attrib.size = size;
+	cmd->ofst = offset;
+
+	if (nvme_tcp_qpair_sync_cmd(&ctrlr->adminq, &nvme_cmd, NULL, 0, &cpl) != 0 ||
+	    spdk_nvme_cpl_is_error(&cpl)) {
+		SPDK_ERRLOG("Property Get of offset 0x%x failed\n", offset);
+		return -1;
+	}
+
+	rsp = (struct spdk_nvmf_fabric_prop_get_rsp *)&cpl;
+	*value = size == SPDK_NVMF_PROP_SIZE_8 ? rsp->value.u64 : rsp->value.u32.low;
+	return 0;
+}
+
+static int
+nvme_tcp_ctrlr_set_reg(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset, uint8_t size,
+		       uint64_t value)
+{
+	struct spdk_nvmf_fabric_prop_set_cmd	*cmd;
+	struct spdk_nvme_cmd			nvme_cmd;
+	struct spdk_nvme_cpl			cpl;
+
+	memset(&nvme_cmd, 0, sizeof(nvme_cmd));
+	cmd = (struct spdk_nvmf_fabric_prop_set_cmd *)&nvme_cmd;
+	cmd->opcode = SPDK_NVME_OPC_FABRIC;
+	cmd->fctype = SPDK_NVMF_FABRIC_COMMAND_PROPERTY_SET;
+	cmd->attrib.size = size;
+	cmd->ofst = offset;
+	cmd->value.u64 = value;
+
+	if (nvme_tcp_qpair_sync_cmd(&ctrlr->adminq, &nvme_cmd, NULL, 0, &cpl) != 0 ||
+	    spdk_nvme_cpl_is_error(&cpl)) {
+		SPDK_ERRLOG("Property Set of offset 0x%x failed\n", offset);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+nvme_tcp_ctrlr_get_reg_4(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset, uint32_t *value)
+{
+	uint64_t tmp;
+
+	if (nvme_tcp_ctrlr_get_reg(ctrlr, offset, SPDK_NVMF_PROP_SIZE_4, &tmp) != 0) {
+		return -1;
+	}
+
+	*value = (uint32_t)tmp;
+	return 0;
+}
+
+static int
+nvme_tcp_ctrlr_get_reg_8(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset, uint64_t *value)
+{
+	return nvme_tcp_ctrlr_get_reg(ctrlr, offset, SPDK_NVMF_PROP_SIZE_8, value);
+}
+
+static int
+nvme_tcp_ctrlr_set_reg_4(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset, uint32_t value)
+{
+	return nvme_tcp_ctrlr_set_reg(ctrlr, offset, SPDK_NVMF_PROP_SIZE_4, value);
+}
+
+static int
+nvme_tcp_ctrlr_set_reg_8(struct spdk_nvme_ctrlr *ctrlr, uint32_t offset, uint64_t value)
+{
+	return nvme_tcp_ctrlr_set_reg(ctrlr, offset, SPDK_NVMF_PROP_SIZE_8, value);
+}
+
+const struct nvme_transport nvme_tcp_transport = {
+	.name = "TCP",
+	.qpair_connect = nvme_tcp_qpair_connect,
+	.qpair_disconnect = nvme_tcp_qpair_disconnect,
+	.qpair_check_request = nvme_tcp_qpair_check_request,
+	.qpair_queue_tracker = nvme_tcp_qpair_queue_tracker,
+	.qpair_flush = nvme_tcp_qpair_flush,
+	.qpair_process_completions = nvme_tcp_qpair_process_completions,
+	.ctrlr_get_reg_4 = nvme_tcp_ctrlr_get_reg_4,
+	.ctrlr_get_reg_8 = nvme_tcp_ctrlr_get_reg_8,
+	.ctrlr_set_reg_4 = nvme_tcp_ctrlr_set_reg_4,
+	.ctrlr_set_reg_8 = nvme_tcp_ctrlr_set_reg_8,
+};
+
+SPDK_LOG_REGISTER_TRACE_FLAG("nvme_tcp", SPDK_TRACE_NVME_TCP)
@@ -0,0 +1,196 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "nvme_uevent.h"
+
+#define NVME_UEVENT_MSG_LEN	4096
+
+int
+nvme_uevent_connect(void)
+{
+	struct sockaddr_nl addr;
+	int fd;
+	int size = 64 * 1024;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_pid = getpid();
+	addr.nl_groups = 1; /* kernel uevents only, not udev re-broadcasts */
+
+	fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (fd < 0) {
+		return -errno;
+	}
+
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size));
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		int rc = -errno;
+
+		close(fd);
+		return rc;
+	}
+
+	return fd;
+}
+
+static int
+nvme_uevent_parse_pci_addr(const char *str, struct nvme_uevent *uevent)
+{
+	unsigned int domain, bus, dev, func;
+
+	if (sscanf(str, "%x:%x:%x.%x", &domain, &bus, &dev, &func) != 4) {
+		return -1;
+	}
+
+	uevent->domain = domain;
+	uevent->bus = bus;
+	uevent->dev = dev;
+	uevent->func = func;
+	return 0;
+}
+
+int
+nvme_uevent_parse(const char *buf, size_t len, struct nvme_uevent *uevent)
+{
+	const char *action = NULL, *subsystem = NULL, *devpath = NULL;
+	const char *driver = NULL, *pci_slot_name = NULL;
+	const char *end = buf + len;
+	const char *uio;
+	char pci_addr[32];
+	size_t addr_len;
+
+	/* Messages are a sequence of NUL-terminated KEY=value strings. */
+	while (buf < end && *buf != '\0') {
+		if (!strncmp(buf, "ACTION=", 7)) {
+			action = buf + 7;
+		} else if (!strncmp(buf, "SUBSYSTEM=", 10)) {
+			subsystem = buf + 10;
+		} else if (!strncmp(buf, "DEVPATH=", 8)) {
+			devpath = buf + 8;
+		} else if (!strncmp(buf, "DRIVER=", 7)) {
+			driver = buf + 7;
+		} else if (!strncmp(buf, "PCI_SLOT_NAME=", 14)) {
+			pci_slot_name = buf + 14;
+		}
+		buf += strnlen(buf, end - buf) + 1;
+	}
+
+	if (action == NULL || subsystem == NULL) {
+		return 0;
+	}
+
+	if (!strcmp(action, "add") || !strcmp(action, "bind")) {
+		uevent->action = NVME_UEVENT_ADD;
+	} else if (!strcmp(action, "remove")) {
+		uevent->action = NVME_UEVENT_REMOVE;
+	} else {
+		return 0;
+	}
+
+	if (!strcmp(subsystem, "uio")) {
+		/*
+		 * uio devices are reported with a DEVPATH like
+		 *  /devices/pci0000:80/0000:80:01.0/0000:81:00.0/uio/uio0
+		 *  where the path component before /uio is the PCI address.
+		 */
+		if (devpath == NULL) {
+			return 0;
+		}
+		uio = strstr(devpath, "/uio/");
+		if (uio == NULL) {
+			return 0;
+		}
+		addr_len = 0;
+		while (uio - addr_len > devpath && *(uio - addr_len - 1) != '/') {
+			addr_len++;
+		}
+		if (addr_len == 0 || addr_len >= sizeof(pci_addr)) {
+			return 0;
+		}
+		memcpy(pci_addr, uio - addr_len, addr_len);
+		pci_addr[addr_len] = '\0';
+		return nvme_uevent_parse_pci_addr(pci_addr, uevent) == 0;
+	}
+
+	if (!strcmp(subsystem, "pci") && pci_slot_name != NULL) {
+		/*
+		 * vfio-pci has no class device of its own; only report the PCI
+		 *  device itself when it is (or was) bound to vfio-pci.  A newly
+		 *  inserted device is added before any driver is bound to it, so
+		 *  its arrival is the "bind" to vfio-pci that follows.
+		 */
+		if (driver == NULL || strcmp(driver, "vfio-pci")) {
+			return 0;
+		}
+		return nvme_uevent_parse_pci_addr(pci_slot_name, uevent) == 0;
+	}
+
+	return 0;
+}
+
+int
+nvme_uevent_get(int fd, struct nvme_uevent *uevent)
+{
+	char buf[NVME_UEVENT_MSG_LEN];
+	ssize_t len;
+
+	while (1) {
+		len = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return 0;
+			}
+			if (errno == EINTR) {
+				continue;
+			}
+			return -errno;
+		}
+		if (len == 0) {
+			return 0;
+		}
+
+		buf[len] = '\0';
+		if (nvme_uevent_parse(buf, len, uevent)) {
+			return 1;
+		}
+	}
+}
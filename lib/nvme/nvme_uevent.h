@@ -0,0 +1,82 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \file
+ * Kernel uevent monitoring for NVMe hotplug.
+ */
+
+#ifndef __NVME_UEVENT_H__
+#define __NVME_UEVENT_H__
+
+#include <stdint.h>
+
+enum nvme_uevent_action {
+	NVME_UEVENT_ADD = 0,
+	NVME_UEVENT_REMOVE = 1,
+};
+
+struct nvme_uevent {
+	enum nvme_uevent_action	action;
+
+	/* PCI address of the device the event refers to */
+	uint16_t		domain;
+	uint8_t			bus;
+	uint8_t			dev;
+	uint8_t			func;
+};
+
+/**
+ * Open a non-blocking netlink socket that receives kernel uevents.
+ *
+ * \return socket fd on success, negative errno on failure.
+ */
+int nvme_uevent_connect(void);
+
+/**
+ * Parse one raw uevent message (NUL-separated "KEY=value" strings).
+ *
+ * \return 1 if the message describes a device add or remove that is relevant to the
+ *  NVMe driver (uio or vfio-pci bound device), 0 if it should be ignored.
+ */
+int nvme_uevent_parse(const char *buf, size_t len, struct nvme_uevent *uevent);
+
+/**
+ * Fetch the next relevant uevent from the socket without blocking.
+ *
+ * \return 1 if an event was returned, 0 if no more events are pending, negative errno on error.
+ */
+int nvme_uevent_get(int fd, struct nvme_uevent *uevent);
+
+#endif
@@ -51,17 +51,29 @@ struct spdk_nvmf_globals g_nvmf_tgt;
 
 int
 nvmf_tgt_init(uint16_t max_queue_depth, uint16_t max_queues_per_sess,
-	      uint32_t in_capsule_data_size, uint32_t max_io_size)
+	      uint32_t in_capsule_data_size, uint32_t max_io_size,
+	      uint32_t srq_depth, uint32_t cq_depth, uint32_t sess_data_bufs,
+	      uint32_t small_data_bufs, uint32_t large_data_bufs)
 {
 	g_nvmf_tgt.max_queues_per_session = max_queues_per_sess;
 	g_nvmf_tgt.max_queue_depth = max_queue_depth;
 	g_nvmf_tgt.in_capsule_data_size = in_capsule_data_size;
 	g_nvmf_tgt.max_io_size = max_io_size;
+	g_nvmf_tgt.srq_depth = srq_depth;
+	g_nvmf_tgt.cq_depth = cq_depth;
+	g_nvmf_tgt.sess_data_bufs = sess_data_bufs;
+	g_nvmf_tgt.small_data_bufs = small_data_bufs;
+	g_nvmf_tgt.large_data_bufs = large_data_bufs;
 
 	SPDK_TRACELOG(SPDK_TRACE_NVMF, "Max Queues Per Session: %d\n", max_queues_per_sess);
 	SPDK_TRACELOG(SPDK_TRACE_NVMF, "Max Queue Depth: %d\n", max_queue_depth);
 	SPDK_TRACELOG(SPDK_TRACE_NVMF, "Max In Capsule Data: %d bytes\n", in_capsule_data_size);
 	SPDK_TRACELOG(SPDK_TRACE_NVMF, "Max I/O Size: %d bytes\n", max_io_size);
+	SPDK_TRACELOG(SPDK_TRACE_NVMF, "Shared Receive Queue Depth: %d\n", srq_depth);
+	SPDK_TRACELOG(SPDK_TRACE_NVMF, "Shared Completion Queue Depth: %d\n", cq_depth);
+	SPDK_TRACELOG(SPDK_TRACE_NVMF, "Session Data Buffers: %d\n", sess_data_bufs);
+	SPDK_TRACELOG(SPDK_TRACE_NVMF, "Small Data Buffers: %d\n", small_data_bufs);
+	SPDK_TRACELOG(SPDK_TRACE_NVMF, "Large Data Buffers: %d\n", large_data_bufs);
 
 	return 0;
 }
@@ -49,6 +49,8 @@
 #define SPDK_NVMF_DEFAULT_NUM_SESSIONS_PER_LCORE 1
 #define SPDK_NVMF_DEFAULT_SIN_PORT ((uint16_t)4420)
 
+#define MAX_VIRTUAL_NAMESPACE 16
+
 #define OBJECT_NVMF_IO				0x30
 
 #define TRACE_GROUP_NVMF			0x3
@@ -68,10 +70,31 @@ struct spdk_nvmf_globals {
 
 	uint32_t in_capsule_data_size;
 	uint32_t max_io_size;
+
+	/* Receive queue depth shared by the connections of an RDMA device. 0 disables it. */
+	uint32_t srq_depth;
+
+	/*
+	 * Depth of the completion queue shared by the RDMA I/O queues of a device
+	 * whose completions are reaped on the same core. 0 disables it.
+	 */
+	uint32_t cq_depth;
+
+	/* Number of MaxIOSize data buffers allocated for each TCP session. */
+	uint32_t sess_data_bufs;
+
+	/*
+	 * Number of small and MaxIOSize buffers in the RDMA data buffer pool of each
+	 * NUMA node. 0 picks a multiple of max_queue_depth.
+	 */
+	uint32_t small_data_bufs;
+	uint32_t large_data_bufs;
 };
 
 int nvmf_tgt_init(uint16_t max_queue_depth, uint16_t max_conn_per_sess,
-		  uint32_t in_capsule_data_size, uint32_t max_io_size);
+		  uint32_t in_capsule_data_size, uint32_t max_io_size,
+		  uint32_t srq_depth, uint32_t cq_depth, uint32_t sess_data_bufs,
+		  uint32_t small_data_bufs, uint32_t large_data_bufs);
 
 static inline uint32_t
 nvmf_u32log2(uint32_t x)
@@ -83,6 +106,38 @@ nvmf_u32log2(uint32_t x)
 	return 31u - __builtin_clz(x);
 }
 
+/*
+ * Latency histogram with power of two buckets. Bucket i counts latencies of
+ * at least 2^(i-1) and less than 2^i ticks; bucket 0 counts latencies of 0.
+ */
+#define SPDK_NVMF_LATENCY_BUCKETS	64
+
+struct spdk_nvmf_latency_histogram {
+	uint64_t	bucket[SPDK_NVMF_LATENCY_BUCKETS];
+};
+
+static inline void
+spdk_nvmf_latency_histogram_add(struct spdk_nvmf_latency_histogram *hist, uint64_t ticks)
+{
+	uint32_t i = 0;
+
+	if (ticks != 0) {
+		i = nvmf_min(64u - __builtin_clzll(ticks), SPDK_NVMF_LATENCY_BUCKETS - 1);
+	}
+	hist->bucket[i]++;
+}
+
+static inline void
+spdk_nvmf_latency_histogram_merge(struct spdk_nvmf_latency_histogram *dst,
+				  const struct spdk_nvmf_latency_histogram *src)
+{
+	int i;
+
+	for (i = 0; i < SPDK_NVMF_LATENCY_BUCKETS; i++) {
+		dst->bucket[i] += src->bucket[i];
+	}
+}
+
 extern struct spdk_nvmf_globals g_nvmf_tgt;
 
 #endif /* __NVMF_INTERNAL_H__ */
@@ -33,6 +33,7 @@
 
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <infiniband/verbs.h>
 #include <rdma/rdma_cma.h>
 #include <rdma/rdma_verbs.h>
@@ -51,6 +52,7 @@
 #include "subsystem.h"
 #include "transport.h"
 #include "spdk/assert.h"
+#include "spdk/barrier.h"
 #include "spdk/log.h"
 #include "spdk/nvmf_spec.h"
 #include "spdk/string.h"
@@ -59,127 +61,1424 @@
 /*
  RDMA Connection Resouce Defaults
  */
-#define NVMF_DEFAULT_TX_SGE		1
+#define NVMF_DEFAULT_TX_SGE		SPDK_NVMF_MAX_SGL_ENTRIES
 #define NVMF_DEFAULT_RX_SGE		2
 
+/* Admin commands never carry more than 4 KiB of data in their capsule */
+#define NVMF_RDMA_ADMIN_IN_CAPSULE_DATA_SIZE	4096
+
+/*
+ RDMA Data Buffer Pool Defaults
+
+ Data that does not fit in a request's in capsule buffer is placed in a buffer
+ from a transport-wide pool for the NIC's NUMA node. Transfers of up to
+ NVMF_RDMA_SMALL_BUF_SIZE bytes use the small size class, so they do not tie
+ up a MaxIOSize buffer. Virtual mode reads and writes that are larger take
+ several small buffers instead, since the bdev accepts the data scattered.
+ Unless configured, pool sizes are given in multiples of MaxQueueDepth.
+ */
+#define NVMF_RDMA_SMALL_BUF_SIZE		32768
+#define NVMF_RDMA_SMALL_BUFS_PER_QUEUE_DEPTH	4
+#define NVMF_RDMA_LARGE_BUFS_PER_QUEUE_DEPTH	2
+#define NVMF_RDMA_BUF_CACHE_SIZE		8
+
+/*
+ RDMA Poll Group Defaults
+
+ A shared completion queue is reaped in larger batches than a connection's own
+ completion queue, since one poll serves every connection attached to it.
+ */
+#define NVMF_RDMA_POLL_GROUP_BATCH		128
+
+enum spdk_nvmf_rdma_buf_class {
+	NVMF_RDMA_BUF_SMALL = 0,
+	NVMF_RDMA_BUF_LARGE,
+	NVMF_RDMA_NUM_BUF_CLASSES,
+};
+
 struct spdk_nvmf_rdma_buf {
 	SLIST_ENTRY(spdk_nvmf_rdma_buf) link;
 };
 
-struct spdk_nvmf_rdma_request {
-	struct spdk_nvmf_request		req;
+/* A receive buffer: one command capsule and its in capsule data */
+struct spdk_nvmf_rdma_recv {
+	union nvmf_h2c_msg			*cmd;
+	uint8_t					*buf;
+
+	struct ibv_recv_wr			wr;
+	struct ibv_sge				sgl[NVMF_DEFAULT_RX_SGE];
+
+	TAILQ_ENTRY(spdk_nvmf_rdma_recv)	link;
+};
+
+struct spdk_nvmf_rdma_request {
+	struct spdk_nvmf_request		req;
+
+	/* In Capsule data buffer */
+	uint8_t					*buf;
+
+	/* Receive buffer holding the capsule, until it is reposted */
+	struct spdk_nvmf_rdma_recv		*recv;
+
+	/* Buffers taken from the data buffer pool, if any */
+	struct spdk_nvmf_rdma_buf		*data_bufs[SPDK_NVMF_MAX_SGL_ENTRIES];
+	uint32_t				num_data_bufs;
+	enum spdk_nvmf_rdma_buf_class		data_buf_class;
+
+	/* Work requests for the data transfer and the response. They only
+	 * need to live until the connection posts its queued chain. */
+	struct ibv_send_wr			data_wr;
+	struct ibv_sge				data_sgl[SPDK_NVMF_MAX_SGL_ENTRIES];
+	struct ibv_send_wr			rsp_wr;
+	struct ibv_sge				rsp_sge;
+
+	/* Set while an unsignaled RDMA WRITE runs ahead of the response */
+	bool					write_chained;
+
+	TAILQ_ENTRY(spdk_nvmf_rdma_request)	link;
+};
+
+struct spdk_nvmf_rdma_conn {
+	struct spdk_nvmf_conn			conn;
+
+	struct rdma_cm_id			*cm_id;
+	struct ibv_cq				*cq;
+
+	/* The maximum number of I/O outstanding on this connection at one time */
+	uint16_t				max_queue_depth;
+
+	/* The maximum number of active RDMA READ and WRITE operations at one time */
+	uint16_t				max_rw_depth;
+
+	/* The maximum number of data buffers one RDMA WRITE, or one RDMA READ, can cover */
+	uint16_t				max_send_sge;
+	uint16_t				max_read_sge;
+
+	/*
+	 * Size of the in capsule data buffer of each receive. Admin queues use
+	 * less than I/O queues. With a shared receive queue the buffers are
+	 * larger, but the connection still accepts no more than this.
+	 */
+	uint32_t				in_capsule_data_size;
+
+	/* The current number of I/O outstanding on this connection. This number
+	 * includes all I/O from the time the capsule is first received until it is
+	 * completed.
+	 */
+	uint16_t				cur_queue_depth;
+
+	/* The number of RDMA READ and WRITE requests that are outstanding */
+	uint16_t				cur_rdma_rw_depth;
+
+	/* Requests that are waiting to obtain a data buffer, by size class */
+	TAILQ_HEAD(, spdk_nvmf_rdma_request)	pending_data_buf_queue[NVMF_RDMA_NUM_BUF_CLASSES];
+
+	/* Requests that are waiting to perform an RDMA READ or WRITE */
+	TAILQ_HEAD(, spdk_nvmf_rdma_request)	pending_rdma_rw_queue;
+
+	/*
+	 * Capsules are not tied to a request. Received capsules are bound to a
+	 * free request, or wait for one to become free. A request is free again
+	 * once its response has been sent.
+	 */
+	TAILQ_HEAD(, spdk_nvmf_rdma_request)	free_queue;
+	TAILQ_HEAD(, spdk_nvmf_rdma_recv)	pending_recv_queue;
+
+	/* Shared receive queue, if any, in place of the receive buffers below */
+	struct spdk_nvmf_rdma_srq		*srq;
+	TAILQ_ENTRY(spdk_nvmf_rdma_conn)	srq_link;
+
+	/* Poll group whose shared completion queue is used in place of cq, if any */
+	struct spdk_nvmf_rdma_poll_group	*poll_group;
+	TAILQ_ENTRY(spdk_nvmf_rdma_conn)	poll_group_link;
+	uint32_t				cq_size;
+
+	/*
+	 * Completions routed to this connection from the shared completion queue.
+	 * The poll group adds them at head and the connection's poller, which may
+	 * run on another core, takes them from tail.
+	 */
+	struct ibv_wc				*wc_ring;
+	uint32_t				wc_ring_mask;
+	volatile uint32_t			wc_ring_head;
+	volatile uint32_t			wc_ring_tail;
+	volatile bool				wc_ring_overflow;
+
+	/*
+	 * Work requests queued while processing completions. Each queue is posted
+	 * as one chain when the poll finishes, or right away outside of a poll.
+	 */
+	bool					in_poll;
+	struct ibv_send_wr			*send_wr_first;
+	struct ibv_send_wr			*send_wr_last;
+	struct ibv_recv_wr			*recv_wr_first;
+	struct ibv_recv_wr			*recv_wr_last;
+
+	/* Array of size "max_queue_depth" containing RDMA requests. */
+	struct spdk_nvmf_rdma_request		*reqs;
+
+	/* Array of size "max_queue_depth" containing receive buffers.
+	 * Not allocated with a shared receive queue.
+	 */
+	struct spdk_nvmf_rdma_recv		*recvs;
+
+	/* Array of size "max_queue_depth" containing 64 byte capsules
+	 * used for receive. Not allocated with a shared receive queue.
+	 */
+	union nvmf_h2c_msg			*cmds;
+	struct ibv_mr				*cmds_mr;
+
+	/* Array of size "max_queue_depth" containing 16 byte completions
+	 * to be sent back to the user.
+	 */
+	union nvmf_c2h_msg			*cpls;
+	struct ibv_mr				*cpls_mr;
+
+	/* Array of size "max_queue_depth * in_capsule_data_size" containing
+	 * buffers to be used for in capsule data. Not allocated with a shared
+	 * receive queue.
+	 */
+	void					*bufs;
+	struct ibv_mr				*bufs_mr;
+
+	/* Data buffer pool for the NIC's NUMA node and its registration in our protection domain */
+	struct spdk_nvmf_rdma_buf_pool		*buf_pool;
+	struct ibv_mr				*buf_mr;
+
+	/* Set while this connection is in the buffer pool's wait list for a size class */
+	bool					buf_waiting[NVMF_RDMA_NUM_BUF_CLASSES];
+	TAILQ_ENTRY(spdk_nvmf_rdma_conn)	buf_wait_link[NVMF_RDMA_NUM_BUF_CLASSES];
+
+	TAILQ_ENTRY(spdk_nvmf_rdma_conn)	link;
+};
+
+/*
+ * A receive queue shared by all connections on one RDMA device. The capsule
+ * and in capsule data buffers are sized for the SRQ depth instead of for every
+ * connection's queue depth. Each completion names the QP that received it,
+ * which maps it back to its connection.
+ */
+struct spdk_nvmf_rdma_srq {
+	struct ibv_context			*verbs;
+
+	/*
+	 * The protection domain rdma_cm allocated for the device, which every
+	 * connection on it and the data buffer pool registrations use as well.
+	 */
+	struct ibv_pd				*pd;
+	struct ibv_srq				*srq;
+	uint32_t				depth;
+
+	/* Number of connections using the SRQ, protected by g_rdma.lock */
+	uint32_t				refcnt;
+
+	struct spdk_nvmf_rdma_recv		*recvs;
+
+	union nvmf_h2c_msg			*cmds;
+	struct ibv_mr				*cmds_mr;
+
+	void					*bufs;
+	struct ibv_mr				*bufs_mr;
+
+	/* Connections attached to the SRQ, which may be polled on different cores */
+	pthread_spinlock_t			lock;
+	TAILQ_HEAD(, spdk_nvmf_rdma_conn)	conns;
+
+	TAILQ_ENTRY(spdk_nvmf_rdma_srq)		link;
+};
+
+/*
+ * A completion queue shared by the connections of one RDMA device whose
+ * completions are reaped on one core. A single poll on that core serves all
+ * of them, so an idle connection costs nothing there.
+ */
+struct spdk_nvmf_rdma_poll_group {
+	struct ibv_context			*verbs;
+	uint32_t				lcore;
+	struct ibv_cq				*cq;
+
+	/* Completion queue entries reserved by connections, protected by g_rdma.lock */
+	uint32_t				cq_used;
+
+	/* Connections attached to the completion queue, protected by the core's lock */
+	TAILQ_HEAD(, spdk_nvmf_rdma_conn)	conns;
+
+	/* The connection that received the last completion */
+	struct spdk_nvmf_rdma_conn		*last_conn;
+
+	TAILQ_ENTRY(spdk_nvmf_rdma_poll_group)	link;
+};
+
+/* The poll groups reaped on one core */
+struct spdk_nvmf_rdma_lcore_poll_groups {
+	pthread_spinlock_t			lock;
+	TAILQ_HEAD(, spdk_nvmf_rdma_poll_group)	groups;
+
+	/* Number of connections attached to them, protected by g_rdma.lock */
+	uint32_t				num_conns;
+};
+
+/* List of RDMA connections that have not yet received a CONNECT capsule */
+static TAILQ_HEAD(, spdk_nvmf_rdma_conn) g_pending_conns = TAILQ_HEAD_INITIALIZER(g_pending_conns);
+
+struct spdk_nvmf_rdma_buf_cache {
+	SLIST_HEAD(, spdk_nvmf_rdma_buf)	bufs;
+	uint32_t				count;
+};
+
+struct spdk_nvmf_rdma_buf_mr {
+	struct ibv_pd				*pd;
+	struct ibv_mr				*mr;
+	TAILQ_ENTRY(spdk_nvmf_rdma_buf_mr)	link;
+};
+
+/*
+ * Data buffers shared by all connections on NICs of one NUMA node. The memory
+ * is registered once for each protection domain that uses it. Each core caches
+ * a few buffers of each size class so that the lock is only taken in batches.
+ * While connections are waiting for a size class, buffers bypass the caches and
+ * the waiting connections take turns at the shared list.
+ */
+struct spdk_nvmf_rdma_buf_pool {
+	int					socket_id;
+
+	/* Number of connections using the pool, protected by g_rdma.lock */
+	uint32_t				refcnt;
+
+	uint8_t					*buf;
+	size_t					len;
+	TAILQ_HEAD(, spdk_nvmf_rdma_buf_mr)	mrs;
+
+	uint32_t				buf_size[NVMF_RDMA_NUM_BUF_CLASSES];
+	uint32_t				buf_count[NVMF_RDMA_NUM_BUF_CLASSES];
+	uint32_t				cache_size[NVMF_RDMA_NUM_BUF_CLASSES];
+
+	pthread_spinlock_t			lock;
+	SLIST_HEAD(, spdk_nvmf_rdma_buf)	free_bufs[NVMF_RDMA_NUM_BUF_CLASSES];
+	TAILQ_HEAD(, spdk_nvmf_rdma_conn)	waiters[NVMF_RDMA_NUM_BUF_CLASSES];
+	uint32_t				num_waiters[NVMF_RDMA_NUM_BUF_CLASSES];
+
+	struct spdk_nvmf_rdma_buf_cache		cache[RTE_MAX_LCORE][NVMF_RDMA_NUM_BUF_CLASSES];
+};
+
+struct spdk_nvmf_rdma_listen_addr {
+	char					*traddr;
+	char					*trsvcid;
+	struct rdma_cm_id			*id;
+	struct ibv_device_attr 			attr;
+	struct ibv_comp_channel			*comp_channel;
+	TAILQ_ENTRY(spdk_nvmf_rdma_listen_addr)	link;
+};
+
+struct spdk_nvmf_rdma {
+	struct rdma_event_channel	*event_channel;
+
+	pthread_mutex_t 		lock;
+
+	uint16_t 			max_queue_depth;
+	uint32_t 			max_io_size;
+	uint32_t 			in_capsule_data_size;
+	uint32_t			srq_depth;
+	uint32_t			cq_depth;
+	uint32_t			small_data_bufs;
+	uint32_t			large_data_bufs;
+
+	TAILQ_HEAD(, spdk_nvmf_rdma_listen_addr)	listen_addrs;
+	TAILQ_HEAD(, spdk_nvmf_rdma_srq)		srqs;
+
+	struct spdk_nvmf_rdma_buf_pool	*buf_pools[RTE_MAX_NUMA_NODES];
+
+	struct spdk_nvmf_rdma_lcore_poll_groups	poll_groups[RTE_MAX_LCORE];
+};
+
+static struct spdk_nvmf_rdma g_rdma = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.listen_addrs = TAILQ_HEAD_INITIALIZER(g_rdma.listen_addrs),
+	.srqs = TAILQ_HEAD_INITIALIZER(g_rdma.srqs),
+};
+
+static inline struct spdk_nvmf_rdma_conn *
+get_rdma_conn(struct spdk_nvmf_conn *conn)
+{
+	return (struct spdk_nvmf_rdma_conn *)((uintptr_t)conn - offsetof(struct spdk_nvmf_rdma_conn, conn));
+}
+
+static inline struct spdk_nvmf_rdma_request *
+get_rdma_req(struct spdk_nvmf_request *req)
+{
+	return (struct spdk_nvmf_rdma_request *)((uintptr_t)req - offsetof(struct spdk_nvmf_rdma_request,
+			req));
+}
+
+static int
+spdk_nvmf_rdma_get_numa_node(struct ibv_context *verbs)
+{
+	char		path[PATH_MAX];
+	FILE		*f;
+	int		node = -1;
+
+	snprintf(path, sizeof(path), "%s/device/numa_node", verbs->device->ibdev_path);
+	f = fopen(path, "r");
+	if (f != NULL) {
+		if (fscanf(f, "%d", &node) != 1) {
+			node = -1;
+		}
+		fclose(f);
+	}
+
+	/* Not every platform reports the device's node. Fall back to our own. */
+	if (node < 0 || node >= RTE_MAX_NUMA_NODES) {
+		node = (int)rte_socket_id();
+		if (node < 0 || node >= RTE_MAX_NUMA_NODES) {
+			node = 0;
+		}
+	}
+
+	return node;
+}
+
+/*
+ * max_bufs is the number of small buffers the transfer may be spread across,
+ * or 1 if its data has to be contiguous.
+ */
+static enum spdk_nvmf_rdma_buf_class
+spdk_nvmf_rdma_buf_class(struct spdk_nvmf_rdma_buf_pool *pool, uint32_t length, uint32_t max_bufs)
+{
+	uint32_t num_bufs;
+
+	if (pool->buf_count[NVMF_RDMA_BUF_SMALL] == 0) {
+		return NVMF_RDMA_BUF_LARGE;
+	}
+
+	num_bufs = ((uint64_t)length + pool->buf_size[NVMF_RDMA_BUF_SMALL] - 1) /
+		   pool->buf_size[NVMF_RDMA_BUF_SMALL];
+
+	/* A transfer that needs more small buffers than the pool has would wait forever */
+	if (num_bufs <= max_bufs && num_bufs <= pool->buf_count[NVMF_RDMA_BUF_SMALL]) {
+		return NVMF_RDMA_BUF_SMALL;
+	}
+
+	return NVMF_RDMA_BUF_LARGE;
+}
+
+static struct spdk_nvmf_rdma_buf_pool *
+spdk_nvmf_rdma_buf_pool_create(int socket_id)
+{
+	struct spdk_nvmf_rdma_buf_pool	*pool;
+	struct spdk_nvmf_rdma_buf	*buf;
+	uint8_t				*p;
+	uint32_t			i, lcores;
+	int				c;
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool) {
+		return NULL;
+	}
+
+	pool->socket_id = socket_id;
+	TAILQ_INIT(&pool->mrs);
+
+	/* The small class is only worth having if it is smaller than the large one */
+	pool->buf_size[NVMF_RDMA_BUF_SMALL] = NVMF_RDMA_SMALL_BUF_SIZE;
+	pool->buf_size[NVMF_RDMA_BUF_LARGE] = g_rdma.max_io_size;
+	if (g_rdma.max_io_size > NVMF_RDMA_SMALL_BUF_SIZE) {
+		pool->buf_count[NVMF_RDMA_BUF_SMALL] = g_rdma.small_data_bufs;
+	}
+	pool->buf_count[NVMF_RDMA_BUF_LARGE] = g_rdma.large_data_bufs;
+
+	for (c = 0; c < NVMF_RDMA_NUM_BUF_CLASSES; c++) {
+		pool->len += (size_t)pool->buf_size[c] * pool->buf_count[c];
+	}
+
+	pool->buf = rte_malloc_socket("nvmf_rdma_buf_pool", pool->len, 0x20000, socket_id);
+	if (!pool->buf) {
+		SPDK_ERRLOG("Data buffer pool allocation failed (%zu bytes on socket %d)\n",
+			    pool->len, socket_id);
+		free(pool);
+		return NULL;
+	}
+
+	pthread_spin_init(&pool->lock, PTHREAD_PROCESS_PRIVATE);
+
+	/* Keep at most half of each class in the per-core caches */
+	lcores = nvmf_max(rte_lcore_count(), 1);
+	p = pool->buf;
+	for (c = 0; c < NVMF_RDMA_NUM_BUF_CLASSES; c++) {
+		SLIST_INIT(&pool->free_bufs[c]);
+		TAILQ_INIT(&pool->waiters[c]);
+		for (i = 0; i < pool->buf_count[c]; i++) {
+			buf = (struct spdk_nvmf_rdma_buf *)p;
+			SLIST_INSERT_HEAD(&pool->free_bufs[c], buf, link);
+			p += pool->buf_size[c];
+		}
+		pool->cache_size[c] = nvmf_min(NVMF_RDMA_BUF_CACHE_SIZE,
+					       pool->buf_count[c] / (2 * lcores));
+	}
+
+	for (i = 0; i < RTE_MAX_LCORE; i++) {
+		for (c = 0; c < NVMF_RDMA_NUM_BUF_CLASSES; c++) {
+			SLIST_INIT(&pool->cache[i][c].bufs);
+		}
+	}
+
+	SPDK_TRACELOG(SPDK_TRACE_RDMA, "Data Buffer Pool: %p Length: %zx Socket: %d "
+		      "Small: %u x %u Large: %u x %u\n", pool->buf, pool->len, socket_id,
+		      pool->buf_count[NVMF_RDMA_BUF_SMALL], pool->buf_size[NVMF_RDMA_BUF_SMALL],
+		      pool->buf_count[NVMF_RDMA_BUF_LARGE], pool->buf_size[NVMF_RDMA_BUF_LARGE]);
+
+	return pool;
+}
+
+static void
+spdk_nvmf_rdma_buf_pool_destroy(struct spdk_nvmf_rdma_buf_pool *pool)
+{
+	struct spdk_nvmf_rdma_buf_mr *buf_mr;
+
+	while ((buf_mr = TAILQ_FIRST(&pool->mrs)) != NULL) {
+		TAILQ_REMOVE(&pool->mrs, buf_mr, link);
+		rdma_dereg_mr(buf_mr->mr);
+		free(buf_mr);
+	}
+
+	pthread_spin_destroy(&pool->lock);
+	rte_free(pool->buf);
+	free(pool);
+}
+
+static inline struct spdk_nvmf_rdma_buf_cache *
+spdk_nvmf_rdma_buf_get_cache(struct spdk_nvmf_rdma_buf_pool *pool,
+			     enum spdk_nvmf_rdma_buf_class buf_class)
+{
+	unsigned lcore = rte_lcore_id();
+
+	/* Threads that are not EAL cores go straight to the shared list */
+	if (lcore >= RTE_MAX_LCORE) {
+		return NULL;
+	}
+
+	return &pool->cache[lcore][buf_class];
+}
+
+/* Move buffers from a core's cache back to the shared list. Must hold pool->lock. */
+static void
+spdk_nvmf_rdma_buf_cache_drain(struct spdk_nvmf_rdma_buf_pool *pool,
+			       enum spdk_nvmf_rdma_buf_class buf_class,
+			       struct spdk_nvmf_rdma_buf_cache *cache, uint32_t keep)
+{
+	struct spdk_nvmf_rdma_buf *buf;
+
+	while (cache->count > keep) {
+		buf = SLIST_FIRST(&cache->bufs);
+		SLIST_REMOVE_HEAD(&cache->bufs, link);
+		cache->count--;
+		SLIST_INSERT_HEAD(&pool->free_bufs[buf_class], buf, link);
+	}
+}
+
+static struct spdk_nvmf_rdma_buf *
+spdk_nvmf_rdma_buf_get(struct spdk_nvmf_rdma_conn *rdma_conn,
+		       enum spdk_nvmf_rdma_buf_class buf_class)
+{
+	struct spdk_nvmf_rdma_buf_pool	*pool = rdma_conn->buf_pool;
+	struct spdk_nvmf_rdma_buf_cache	*cache = spdk_nvmf_rdma_buf_get_cache(pool, buf_class);
+	struct spdk_nvmf_rdma_buf	*buf;
+
+	/*
+	 * num_waiters is read without the lock here. At worst one buffer is handed
+	 * out of turn while another connection starts waiting.
+	 */
+	if (cache != NULL && pool->num_waiters[buf_class] == 0) {
+		buf = SLIST_FIRST(&cache->bufs);
+		if (buf != NULL) {
+			SLIST_REMOVE_HEAD(&cache->bufs, link);
+			cache->count--;
+			return buf;
+		}
+	}
+
+	pthread_spin_lock(&pool->lock);
+
+	if (pool->num_waiters[buf_class] != 0) {
+		/* Give the waiting connections everything this core is holding */
+		if (cache != NULL) {
+			spdk_nvmf_rdma_buf_cache_drain(pool, buf_class, cache, 0);
+		}
+
+		/* Only the connection at the head of the wait list may take a buffer */
+		if (TAILQ_FIRST(&pool->waiters[buf_class]) != rdma_conn) {
+			pthread_spin_unlock(&pool->lock);
+			return NULL;
+		}
+	}
+
+	buf = SLIST_FIRST(&pool->free_bufs[buf_class]);
+	if (buf != NULL) {
+		SLIST_REMOVE_HEAD(&pool->free_bufs[buf_class], link);
+
+		/* Refill this core's cache while we hold the lock */
+		if (cache != NULL && pool->num_waiters[buf_class] == 0) {
+			while (cache->count < pool->cache_size[buf_class] / 2) {
+				struct spdk_nvmf_rdma_buf *tmp = SLIST_FIRST(&pool->free_bufs[buf_class]);
+
+				if (tmp == NULL) {
+					break;
+				}
+				SLIST_REMOVE_HEAD(&pool->free_bufs[buf_class], link);
+				SLIST_INSERT_HEAD(&cache->bufs, tmp, link);
+				cache->count++;
+			}
+		}
+	}
+
+	pthread_spin_unlock(&pool->lock);
+
+	return buf;
+}
+
+static void
+spdk_nvmf_rdma_buf_put(struct spdk_nvmf_rdma_buf_pool *pool,
+		       enum spdk_nvmf_rdma_buf_class buf_class,
+		       struct spdk_nvmf_rdma_buf *buf)
+{
+	struct spdk_nvmf_rdma_buf_cache	*cache = spdk_nvmf_rdma_buf_get_cache(pool, buf_class);
+
+	if (cache != NULL && pool->num_waiters[buf_class] == 0 &&
+	    cache->count < pool->cache_size[buf_class]) {
+		SLIST_INSERT_HEAD(&cache->bufs, buf, link);
+		cache->count++;
+		return;
+	}
+
+	pthread_spin_lock(&pool->lock);
+	SLIST_INSERT_HEAD(&pool->free_bufs[buf_class], buf, link);
+	if (cache != NULL) {
+		/* Empty the cache for waiting connections, otherwise return half of it */
+		spdk_nvmf_rdma_buf_cache_drain(pool, buf_class, cache,
+					       pool->num_waiters[buf_class] ? 0 : pool->cache_size[buf_class] / 2);
+	}
+	pthread_spin_unlock(&pool->lock);
+}
+
+/* Queue the connection behind others waiting for this buffer class */
+static void
+spdk_nvmf_rdma_conn_buf_wait(struct spdk_nvmf_rdma_conn *rdma_conn,
+			     enum spdk_nvmf_rdma_buf_class buf_class)
+{
+	struct spdk_nvmf_rdma_buf_pool *pool = rdma_conn->buf_pool;
+
+	if (rdma_conn->buf_waiting[buf_class]) {
+		return;
+	}
+
+	pthread_spin_lock(&pool->lock);
+	TAILQ_INSERT_TAIL(&pool->waiters[buf_class], rdma_conn, buf_wait_link[buf_class]);
+	pool->num_waiters[buf_class]++;
+	pthread_spin_unlock(&pool->lock);
+	rdma_conn->buf_waiting[buf_class] = true;
+}
+
+/*
+ * Called after the connection had its turn. If it still has requests waiting,
+ * it goes to the back of the line so that connections are served round robin.
+ */
+static void
+spdk_nvmf_rdma_conn_buf_wait_done(struct spdk_nvmf_rdma_conn *rdma_conn,
+				  enum spdk_nvmf_rdma_buf_class buf_class)
+{
+	struct spdk_nvmf_rdma_buf_pool *pool = rdma_conn->buf_pool;
+
+	pthread_spin_lock(&pool->lock);
+	TAILQ_REMOVE(&pool->waiters[buf_class], rdma_conn, buf_wait_link[buf_class]);
+	if (!TAILQ_EMPTY(&rdma_conn->pending_data_buf_queue[buf_class])) {
+		TAILQ_INSERT_TAIL(&pool->waiters[buf_class], rdma_conn, buf_wait_link[buf_class]);
+	} else {
+		pool->num_waiters[buf_class]--;
+		rdma_conn->buf_waiting[buf_class] = false;
+	}
+	pthread_spin_unlock(&pool->lock);
+}
+
+static void
+spdk_nvmf_rdma_request_put_bufs(struct spdk_nvmf_rdma_buf_pool *pool,
+				struct spdk_nvmf_rdma_request *rdma_req)
+{
+	while (rdma_req->num_data_bufs > 0) {
+		rdma_req->num_data_bufs--;
+		spdk_nvmf_rdma_buf_put(pool, rdma_req->data_buf_class,
+				       rdma_req->data_bufs[rdma_req->num_data_bufs]);
+		rdma_req->data_bufs[rdma_req->num_data_bufs] = NULL;
+	}
+}
+
+/*
+ * Take every buffer the request's data needs from its class, or none of them.
+ * Connections holding part of what they need could otherwise starve each other.
+ */
+static int
+spdk_nvmf_rdma_request_get_bufs(struct spdk_nvmf_rdma_conn *rdma_conn,
+				struct spdk_nvmf_rdma_request *rdma_req)
+{
+	struct spdk_nvmf_rdma_buf_pool	*pool = rdma_conn->buf_pool;
+	struct spdk_nvmf_request	*req = &rdma_req->req;
+	uint32_t			buf_size = pool->buf_size[rdma_req->data_buf_class];
+	uint32_t			num_bufs = (req->length + buf_size - 1) / buf_size;
+	uint32_t			remaining = req->length;
+	struct spdk_nvmf_rdma_buf	*buf;
+	uint32_t			i;
+
+	assert(num_bufs <= SPDK_NVMF_MAX_SGL_ENTRIES);
+
+	while (rdma_req->num_data_bufs < num_bufs) {
+		buf = spdk_nvmf_rdma_buf_get(rdma_conn, rdma_req->data_buf_class);
+		if (buf == NULL) {
+			spdk_nvmf_rdma_request_put_bufs(pool, rdma_req);
+			return -1;
+		}
+		rdma_req->data_bufs[rdma_req->num_data_bufs++] = buf;
+	}
+
+	for (i = 0; i < num_bufs; i++) {
+		req->iov[i].iov_base = rdma_req->data_bufs[i];
+		req->iov[i].iov_len = nvmf_min(remaining, buf_size);
+		remaining -= req->iov[i].iov_len;
+	}
+	req->iovcnt = num_bufs;
+
+	/* Only a single buffer is contiguous */
+	if (num_bufs == 1) {
+		req->data = rdma_req->data_bufs[0];
+	}
+
+	return 0;
+}
+
+/*
+ * Attach the connection to the data buffer pool of its NIC's NUMA node,
+ * registering the pool in the connection's protection domain on first use.
+ */
+static int
+spdk_nvmf_rdma_conn_bind_buf_pool(struct spdk_nvmf_rdma_conn *rdma_conn)
+{
+	struct rdma_cm_id		*id = rdma_conn->cm_id;
+	struct spdk_nvmf_rdma_buf_pool	*pool;
+	struct spdk_nvmf_rdma_buf_mr	*buf_mr;
+	int				socket_id;
+
+	socket_id = spdk_nvmf_rdma_get_numa_node(id->verbs);
+
+	pthread_mutex_lock(&g_rdma.lock);
+
+	pool = g_rdma.buf_pools[socket_id];
+	if (pool == NULL) {
+		pool = spdk_nvmf_rdma_buf_pool_create(socket_id);
+		if (pool == NULL) {
+			pthread_mutex_unlock(&g_rdma.lock);
+			return -1;
+		}
+		g_rdma.buf_pools[socket_id] = pool;
+	}
+
+	TAILQ_FOREACH(buf_mr, &pool->mrs, link) {
+		if (buf_mr->pd == id->pd) {
+			break;
+		}
+	}
+
+	if (buf_mr == NULL) {
+		buf_mr = calloc(1, sizeof(*buf_mr));
+		if (buf_mr == NULL) {
+			pthread_mutex_unlock(&g_rdma.lock);
+			return -1;
+		}
+
+		buf_mr->mr = rdma_reg_msgs(id, pool->buf, pool->len);
+		if (buf_mr->mr == NULL) {
+			SPDK_ERRLOG("Data buffer pool registration failed (%zu bytes)\n", pool->len);
+			free(buf_mr);
+			pthread_mutex_unlock(&g_rdma.lock);
+			return -1;
+		}
+		buf_mr->pd = id->pd;
+		TAILQ_INSERT_TAIL(&pool->mrs, buf_mr, link);
+
+		SPDK_TRACELOG(SPDK_TRACE_RDMA, "Data Buffer Pool: %p PD: %p LKey: %x\n",
+			      pool->buf, id->pd, buf_mr->mr->lkey);
+	}
+
+	pool->refcnt++;
+	rdma_conn->buf_pool = pool;
+	rdma_conn->buf_mr = buf_mr->mr;
+
+	pthread_mutex_unlock(&g_rdma.lock);
+
+	return 0;
+}
+
+static void
+spdk_nvmf_rdma_conn_unbind_buf_pool(struct spdk_nvmf_rdma_conn *rdma_conn)
+{
+	struct spdk_nvmf_rdma_buf_pool	*pool = rdma_conn->buf_pool;
+	struct spdk_nvmf_rdma_request	*rdma_req;
+	int				i;
+
+	if (pool == NULL) {
+		return;
+	}
+
+	/* Return buffers held by requests that never completed */
+	if (rdma_conn->reqs) {
+		for (i = 0; i < rdma_conn->max_queue_depth; i++) {
+			rdma_req = &rdma_conn->reqs[i];
+			spdk_nvmf_rdma_request_put_bufs(pool, rdma_req);
+		}
+	}
+
+	pthread_spin_lock(&pool->lock);
+	for (i = 0; i < NVMF_RDMA_NUM_BUF_CLASSES; i++) {
+		if (rdma_conn->buf_waiting[i]) {
+			TAILQ_REMOVE(&pool->waiters[i], rdma_conn, buf_wait_link[i]);
+			pool->num_waiters[i]--;
+			rdma_conn->buf_waiting[i] = false;
+		}
+	}
+	pthread_spin_unlock(&pool->lock);
+
+	/* A pool detached by spdk_nvmf_rdma_fini() goes away with its last connection */
+	pthread_mutex_lock(&g_rdma.lock);
+	pool->refcnt--;
+	if (pool->refcnt == 0 && g_rdma.buf_pools[pool->socket_id] != pool) {
+		spdk_nvmf_rdma_buf_pool_destroy(pool);
+	}
+	pthread_mutex_unlock(&g_rdma.lock);
+
+	rdma_conn->buf_pool = NULL;
+	rdma_conn->buf_mr = NULL;
+}
+
+static inline void
+nvmf_trace_ibv_sge(struct ibv_sge *sg_list)
+{
+	if (sg_list) {
+		SPDK_TRACELOG(SPDK_TRACE_RDMA, "local addr %p length 0x%x lkey 0x%x\n",
+			      (void *)sg_list->addr, sg_list->length, sg_list->lkey);
+	}
+}
+
+static struct ibv_recv_wr *
+nvmf_rdma_recv_wr_init(struct spdk_nvmf_rdma_recv *recv, struct ibv_mr *cmds_mr,
+		       struct ibv_mr *bufs_mr, uint32_t buf_size)
+{
+	recv->sgl[0].addr = (uintptr_t)recv->cmd;
+	recv->sgl[0].length = sizeof(*recv->cmd);
+	recv->sgl[0].lkey = cmds_mr->lkey;
+	nvmf_trace_ibv_sge(&recv->sgl[0]);
+
+	recv->sgl[1].addr = (uintptr_t)recv->buf;
+	recv->sgl[1].length = buf_size;
+	recv->sgl[1].lkey = bufs_mr->lkey;
+	nvmf_trace_ibv_sge(&recv->sgl[1]);
+
+	memset(&recv->wr, 0, sizeof(recv->wr));
+	recv->wr.wr_id = (uintptr_t)recv;
+	recv->wr.next = NULL;
+	recv->wr.sg_list = recv->sgl;
+	recv->wr.num_sge = 2;
+
+	return &recv->wr;
+}
+
+/* ibv_post_srq_recv() is safe to call from connections polled on different cores */
+static int
+nvmf_post_rdma_srq_recv(struct spdk_nvmf_rdma_srq *srq, struct ibv_recv_wr *wr)
+{
+	struct ibv_recv_wr *bad_wr = NULL;
+	int rc;
+
+	SPDK_TRACELOG(SPDK_TRACE_RDMA, "RDMA SRQ RECV POSTED. Recv: %p SRQ: %p\n",
+		      (void *)wr->wr_id, srq);
+
+	rc = ibv_post_srq_recv(srq->srq, wr, &bad_wr);
+	if (rc) {
+		SPDK_ERRLOG("Failure posting rdma srq recv, rc = 0x%x\n", rc);
+	}
+
+	return rc;
+}
+
+static void
+spdk_nvmf_rdma_srq_destroy(struct spdk_nvmf_rdma_srq *srq)
+{
+	if (srq->cmds_mr) {
+		ibv_dereg_mr(srq->cmds_mr);
+	}
+
+	if (srq->bufs_mr) {
+		ibv_dereg_mr(srq->bufs_mr);
+	}
+
+	if (srq->srq) {
+		ibv_destroy_srq(srq->srq);
+	}
+
+	pthread_spin_destroy(&srq->lock);
+	rte_free(srq->cmds);
+	rte_free(srq->bufs);
+	free(srq->recvs);
+	free(srq);
+}
+
+static struct spdk_nvmf_rdma_srq *
+spdk_nvmf_rdma_srq_create(struct rdma_cm_id *id)
+{
+	struct ibv_context		*verbs = id->verbs;
+	struct spdk_nvmf_rdma_srq	*srq;
+	struct ibv_device_attr		dev_attr;
+	struct ibv_srq_init_attr	srq_attr;
+	struct spdk_nvmf_rdma_recv	*recv;
+	uint32_t			i;
+
+	srq = calloc(1, sizeof(*srq));
+	if (!srq) {
+		return NULL;
+	}
+
+	srq->verbs = verbs;
+	srq->pd = id->pd;
+	pthread_spin_init(&srq->lock, PTHREAD_PROCESS_PRIVATE);
+	TAILQ_INIT(&srq->conns);
+
+	if (ibv_query_device(verbs, &dev_attr)) {
+		SPDK_ERRLOG("Failed to query RDMA device attributes.\n");
+		spdk_nvmf_rdma_srq_destroy(srq);
+		return NULL;
+	}
+
+	srq->depth = nvmf_min(g_rdma.srq_depth, (uint32_t)dev_attr.max_srq_wr);
+	if (srq->depth == 0 || dev_attr.max_srq_sge < NVMF_DEFAULT_RX_SGE) {
+		SPDK_ERRLOG("RDMA device %s does not support shared receive queues\n", verbs->device->name);
+		spdk_nvmf_rdma_srq_destroy(srq);
+		return NULL;
+	}
+
+	memset(&srq_attr, 0, sizeof(srq_attr));
+	srq_attr.attr.max_wr = srq->depth;
+	srq_attr.attr.max_sge = NVMF_DEFAULT_RX_SGE;
+	srq->srq = ibv_create_srq(srq->pd, &srq_attr);
+	if (!srq->srq) {
+		SPDK_ERRLOG("Unable to create shared receive queue\n");
+		SPDK_ERRLOG("Errno %d: %s\n", errno, strerror(errno));
+		spdk_nvmf_rdma_srq_destroy(srq);
+		return NULL;
+	}
+
+	srq->recvs = calloc(srq->depth, sizeof(*srq->recvs));
+	srq->cmds = rte_calloc("nvmf_rdma_srq_cmd", srq->depth, sizeof(*srq->cmds), 0x1000);
+	srq->bufs = rte_calloc("nvmf_rdma_srq_buf", srq->depth, g_rdma.in_capsule_data_size, 0x1000);
+	if (!srq->recvs || !srq->cmds || !srq->bufs) {
+		SPDK_ERRLOG("Unable to allocate sufficient memory for shared receive queue.\n");
+		spdk_nvmf_rdma_srq_destroy(srq);
+		return NULL;
+	}
+
+	srq->cmds_mr = ibv_reg_mr(srq->pd, srq->cmds, srq->depth * sizeof(*srq->cmds),
+				  IBV_ACCESS_LOCAL_WRITE);
+	srq->bufs_mr = ibv_reg_mr(srq->pd, srq->bufs, srq->depth * g_rdma.in_capsule_data_size,
+				  IBV_ACCESS_LOCAL_WRITE);
+	if (!srq->cmds_mr || !srq->bufs_mr) {
+		SPDK_ERRLOG("Unable to register required memory for shared receive queue.\n");
+		spdk_nvmf_rdma_srq_destroy(srq);
+		return NULL;
+	}
+
+	/* Post all receive buffers as one chain */
+	for (i = 0; i < srq->depth; i++) {
+		recv = &srq->recvs[i];
+		recv->cmd = &srq->cmds[i];
+		recv->buf = (uint8_t *)srq->bufs + (i * g_rdma.in_capsule_data_size);
+		nvmf_rdma_recv_wr_init(recv, srq->cmds_mr, srq->bufs_mr, g_rdma.in_capsule_data_size);
+		if (i > 0) {
+			srq->recvs[i - 1].wr.next = &recv->wr;
+		}
+	}
+
+	if (nvmf_post_rdma_srq_recv(srq, &srq->recvs[0].wr)) {
+		SPDK_ERRLOG("Unable to post capsules for RDMA SRQ RECV\n");
+		spdk_nvmf_rdma_srq_destroy(srq);
+		return NULL;
+	}
+
+	SPDK_TRACELOG(SPDK_TRACE_RDMA, "Shared Receive Queue: %p Device: %s Depth: %u\n",
+		      srq, verbs->device->name, srq->depth);
+
+	return srq;
+}
+
+/* Find or create the shared receive queue of a device and take a reference to it */
+static struct spdk_nvmf_rdma_srq *
+spdk_nvmf_rdma_srq_get(struct rdma_cm_id *id)
+{
+	struct spdk_nvmf_rdma_srq *srq;
+
+	pthread_mutex_lock(&g_rdma.lock);
+
+	TAILQ_FOREACH(srq, &g_rdma.srqs, link) {
+		if (srq->verbs == id->verbs) {
+			break;
+		}
+	}
+
+	if (srq == NULL) {
+		srq = spdk_nvmf_rdma_srq_create(id);
+		if (srq == NULL) {
+			pthread_mutex_unlock(&g_rdma.lock);
+			return NULL;
+		}
+		TAILQ_INSERT_TAIL(&g_rdma.srqs, srq, link);
+	}
+
+	srq->refcnt++;
+
+	pthread_mutex_unlock(&g_rdma.lock);
+
+	return srq;
+}
+
+static void
+spdk_nvmf_rdma_srq_put(struct spdk_nvmf_rdma_srq *srq)
+{
+	struct spdk_nvmf_rdma_srq *tmp;
+
+	pthread_mutex_lock(&g_rdma.lock);
+
+	srq->refcnt--;
+	if (srq->refcnt == 0) {
+		/* Keep it for the next connection unless spdk_nvmf_rdma_fini() already ran */
+		TAILQ_FOREACH(tmp, &g_rdma.srqs, link) {
+			if (tmp == srq) {
+				break;
+			}
+		}
+		if (tmp == NULL) {
+			spdk_nvmf_rdma_srq_destroy(srq);
+		}
+	}
+
+	pthread_mutex_unlock(&g_rdma.lock);
+}
+
+static void
+spdk_nvmf_rdma_srq_add_conn(struct spdk_nvmf_rdma_srq *srq, struct spdk_nvmf_rdma_conn *rdma_conn)
+{
+	pthread_spin_lock(&srq->lock);
+	TAILQ_INSERT_TAIL(&srq->conns, rdma_conn, srq_link);
+	pthread_spin_unlock(&srq->lock);
+}
+
+/* Detach the connection from its SRQ and give back the capsules it still holds */
+static void
+spdk_nvmf_rdma_conn_release_recvs(struct spdk_nvmf_rdma_conn *rdma_conn)
+{
+	struct spdk_nvmf_rdma_srq	*srq = rdma_conn->srq;
+	struct spdk_nvmf_rdma_conn	*tmp;
+	struct spdk_nvmf_rdma_recv	*recv;
+	struct ibv_recv_wr		*first = NULL, *last = NULL;
+	int				i;
+
+	if (srq == NULL) {
+		return;
+	}
+
+	pthread_spin_lock(&srq->lock);
+	TAILQ_FOREACH(tmp, &srq->conns, srq_link) {
+		if (tmp == rdma_conn) {
+			TAILQ_REMOVE(&srq->conns, rdma_conn, srq_link);
+			break;
+		}
+	}
+	pthread_spin_unlock(&srq->lock);
+
+	/* Queued receives are not posted yet either */
+	if (rdma_conn->recv_wr_first) {
+		first = rdma_conn->recv_wr_first;
+		last = rdma_conn->recv_wr_last;
+		rdma_conn->recv_wr_first = NULL;
+		rdma_conn->recv_wr_last = NULL;
+	}
+
+	if (rdma_conn->reqs) {
+		for (i = 0; i < rdma_conn->max_queue_depth; i++) {
+			recv = rdma_conn->reqs[i].recv;
+			if (recv != NULL) {
+				TAILQ_INSERT_TAIL(&rdma_conn->pending_recv_queue, recv, link);
+				rdma_conn->reqs[i].recv = NULL;
+			}
+		}
+	}
+
+	while ((recv = TAILQ_FIRST(&rdma_conn->pending_recv_queue)) != NULL) {
+		TAILQ_REMOVE(&rdma_conn->pending_recv_queue, recv, link);
+		nvmf_rdma_recv_wr_init(recv, srq->cmds_mr, srq->bufs_mr, g_rdma.in_capsule_data_size);
+		if (last) {
+			last->next = &recv->wr;
+		} else {
+			first = &recv->wr;
+		}
+		last = &recv->wr;
+	}
+
+	if (first) {
+		nvmf_post_rdma_srq_recv(srq, first);
+	}
+}
+
+/*
+ * Pick the core that reaps the completions of a new connection on a device:
+ * the least loaded core, preferring those on the device's NUMA node, whose
+ * poll group for the device still has cq_size entries to spare. Called with
+ * g_rdma.lock held.
+ */
+static uint32_t
+spdk_nvmf_rdma_poll_group_select_lcore(struct ibv_context *verbs, uint32_t cq_size)
+{
+	struct spdk_nvmf_rdma_poll_group *group;
+	uint32_t lcore, best = RTE_MAX_LCORE;
+	int socket_id = spdk_nvmf_rdma_get_numa_node(verbs);
+	bool local, best_local = false;
+
+	RTE_LCORE_FOREACH(lcore) {
+		TAILQ_FOREACH(group, &g_rdma.poll_groups[lcore].groups, link) {
+			if (group->verbs == verbs) {
+				break;
+			}
+		}
+
+		if (group != NULL && group->cq_used + cq_size > g_rdma.cq_depth) {
+			continue;
+		}
+
+		local = (rte_lcore_to_socket_id(lcore) == (unsigned)socket_id);
+		if (best == RTE_MAX_LCORE || (local && !best_local) ||
+		    (local == best_local &&
+		     g_rdma.poll_groups[lcore].num_conns < g_rdma.poll_groups[best].num_conns)) {
+			best = lcore;
+			best_local = local;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Reserve cq_size entries of a shared completion queue for a new connection.
+ * Returns NULL if there is no room, in which case the connection uses its own.
+ */
+static struct spdk_nvmf_rdma_poll_group *
+spdk_nvmf_rdma_poll_group_get(struct ibv_context *verbs, uint32_t cq_size)
+{
+	struct spdk_nvmf_rdma_lcore_poll_groups *lcore_groups;
+	struct spdk_nvmf_rdma_poll_group *group;
+	uint32_t lcore;
+
+	pthread_mutex_lock(&g_rdma.lock);
+
+	lcore = spdk_nvmf_rdma_poll_group_select_lcore(verbs, cq_size);
+	if (lcore == RTE_MAX_LCORE) {
+		pthread_mutex_unlock(&g_rdma.lock);
+		return NULL;
+	}
+	lcore_groups = &g_rdma.poll_groups[lcore];
+
+	TAILQ_FOREACH(group, &lcore_groups->groups, link) {
+		if (group->verbs == verbs) {
+			break;
+		}
+	}
+
+	if (group == NULL) {
+		group = calloc(1, sizeof(*group));
+		if (group == NULL) {
+			pthread_mutex_unlock(&g_rdma.lock);
+			return NULL;
+		}
+
+		group->cq = ibv_create_cq(verbs, g_rdma.cq_depth, NULL, NULL, 0);
+		if (group->cq == NULL) {
+			SPDK_ERRLOG("Unable to create shared completion queue of depth %u: %s\n",
+				    g_rdma.cq_depth, strerror(errno));
+			free(group);
+			pthread_mutex_unlock(&g_rdma.lock);
+			return NULL;
+		}
+
+		group->verbs = verbs;
+		group->lcore = lcore;
+		TAILQ_INIT(&group->conns);
+
+		pthread_spin_lock(&lcore_groups->lock);
+		TAILQ_INSERT_TAIL(&lcore_groups->groups, group, link);
+		pthread_spin_unlock(&lcore_groups->lock);
+
+		SPDK_TRACELOG(SPDK_TRACE_RDMA, "Created poll group %p for device %s on lcore %u\n",
+			      group, verbs->device->name, lcore);
+	}
+
+	group->cq_used += cq_size;
+	lcore_groups->num_conns++;
+
+	pthread_mutex_unlock(&g_rdma.lock);
+
+	return group;
+}
+
+/* Give back a connection's completion queue entries. Must be called after its QP is destroyed. */
+static void
+spdk_nvmf_rdma_poll_group_put(struct spdk_nvmf_rdma_poll_group *group, uint32_t cq_size)
+{
+	struct spdk_nvmf_rdma_lcore_poll_groups *lcore_groups = &g_rdma.poll_groups[group->lcore];
+
+	pthread_mutex_lock(&g_rdma.lock);
+
+	group->cq_used -= cq_size;
+	lcore_groups->num_conns--;
+
+	if (group->cq_used == 0) {
+		pthread_spin_lock(&lcore_groups->lock);
+		TAILQ_REMOVE(&lcore_groups->groups, group, link);
+		pthread_spin_unlock(&lcore_groups->lock);
+
+		ibv_destroy_cq(group->cq);
+		free(group);
+	}
+
+	pthread_mutex_unlock(&g_rdma.lock);
+}
 
-	/* In Capsule data buffer */
-	uint8_t					*buf;
+static void
+spdk_nvmf_rdma_poll_group_add_conn(struct spdk_nvmf_rdma_poll_group *group,
+				   struct spdk_nvmf_rdma_conn *rdma_conn)
+{
+	struct spdk_nvmf_rdma_lcore_poll_groups *lcore_groups = &g_rdma.poll_groups[group->lcore];
 
-	TAILQ_ENTRY(spdk_nvmf_rdma_request)	link;
-};
+	pthread_spin_lock(&lcore_groups->lock);
+	TAILQ_INSERT_TAIL(&group->conns, rdma_conn, poll_group_link);
+	pthread_spin_unlock(&lcore_groups->lock);
+}
 
-struct spdk_nvmf_rdma_conn {
-	struct spdk_nvmf_conn			conn;
+/*
+ * Stop routing completions to a connection, before its QP is destroyed. Entries
+ * still in the completion queue for the QP are dropped, and the provider removes
+ * the rest when the QP is destroyed.
+ */
+static void
+spdk_nvmf_rdma_poll_group_remove_conn(struct spdk_nvmf_rdma_poll_group *group,
+				      struct spdk_nvmf_rdma_conn *rdma_conn)
+{
+	struct spdk_nvmf_rdma_lcore_poll_groups *lcore_groups = &g_rdma.poll_groups[group->lcore];
+	struct spdk_nvmf_rdma_conn *tmp;
 
-	struct rdma_cm_id			*cm_id;
-	struct ibv_cq				*cq;
+	pthread_spin_lock(&lcore_groups->lock);
+	TAILQ_FOREACH(tmp, &group->conns, poll_group_link) {
+		if (tmp == rdma_conn) {
+			TAILQ_REMOVE(&group->conns, rdma_conn, poll_group_link);
+			break;
+		}
+	}
+	if (group->last_conn == rdma_conn) {
+		group->last_conn = NULL;
+	}
+	pthread_spin_unlock(&lcore_groups->lock);
+}
 
-	/* The maximum number of I/O outstanding on this connection at one time */
-	uint16_t				max_queue_depth;
+/* Called with the core's poll group lock held */
+static struct spdk_nvmf_rdma_conn *
+spdk_nvmf_rdma_poll_group_find_conn(struct spdk_nvmf_rdma_poll_group *group, uint32_t qp_num)
+{
+	struct spdk_nvmf_rdma_conn *rdma_conn = group->last_conn;
 
-	/* The maximum number of active RDMA READ and WRITE operations at one time */
-	uint16_t				max_rw_depth;
+	if (rdma_conn != NULL && rdma_conn->cm_id->qp->qp_num == qp_num) {
+		return rdma_conn;
+	}
 
-	/* The current number of I/O outstanding on this connection. This number
-	 * includes all I/O from the time the capsule is first received until it is
-	 * completed.
-	 */
-	uint16_t				cur_queue_depth;
+	TAILQ_FOREACH(rdma_conn, &group->conns, poll_group_link) {
+		if (rdma_conn->cm_id->qp->qp_num == qp_num) {
+			group->last_conn = rdma_conn;
+			break;
+		}
+	}
 
-	/* The number of RDMA READ and WRITE requests that are outstanding */
-	uint16_t				cur_rdma_rw_depth;
+	return rdma_conn;
+}
 
-	/* Requests that are waiting to obtain a data buffer */
-	TAILQ_HEAD(, spdk_nvmf_rdma_request)	pending_data_buf_queue;
+/* Reap the shared completion queue and hand each completion to its connection */
+static void
+spdk_nvmf_rdma_poll_group_reap(struct spdk_nvmf_rdma_poll_group *group)
+{
+	struct ibv_wc wc[NVMF_RDMA_POLL_GROUP_BATCH];
+	struct spdk_nvmf_rdma_conn *rdma_conn;
+	uint32_t head;
+	int reaped, i;
+
+	reaped = ibv_poll_cq(group->cq, NVMF_RDMA_POLL_GROUP_BATCH, wc);
+	if (reaped < 0) {
+		SPDK_ERRLOG("Error polling shared CQ! (%d): %s\n", errno, strerror(errno));
+		return;
+	}
 
-	/* Requests that are waiting to perform an RDMA READ or WRITE */
-	TAILQ_HEAD(, spdk_nvmf_rdma_request)	pending_rdma_rw_queue;
+	for (i = 0; i < reaped; i++) {
+		rdma_conn = spdk_nvmf_rdma_poll_group_find_conn(group, wc[i].qp_num);
+		if (rdma_conn == NULL) {
+			SPDK_TRACELOG(SPDK_TRACE_RDMA, "Dropping completion for unknown QP %u\n",
+				      wc[i].qp_num);
+			continue;
+		}
 
-	/* Array of size "max_queue_depth" containing RDMA requests. */
-	struct spdk_nvmf_rdma_request		*reqs;
+		head = rdma_conn->wc_ring_head;
+		if (head - rdma_conn->wc_ring_tail > rdma_conn->wc_ring_mask) {
+			/* Cannot happen while the connection stays within its queue depth */
+			rdma_conn->wc_ring_overflow = true;
+			continue;
+		}
 
-	/* Array of size "max_queue_depth" containing 64 byte capsules
-	 * used for receive.
-	 */
-	union nvmf_h2c_msg			*cmds;
-	struct ibv_mr				*cmds_mr;
+		rdma_conn->wc_ring[head & rdma_conn->wc_ring_mask] = wc[i];
+		spdk_wmb();
+		rdma_conn->wc_ring_head = head + 1;
+	}
+}
 
-	/* Array of size "max_queue_depth" containing 16 byte completions
-	 * to be sent back to the user.
-	 */
-	union nvmf_c2h_msg			*cpls;
-	struct ibv_mr				*cpls_mr;
+/* Take up to max completions that the poll group routed to the connection */
+static int
+spdk_nvmf_rdma_conn_reap(struct spdk_nvmf_rdma_conn *rdma_conn, struct ibv_wc *wc, int max)
+{
+	uint32_t head, tail;
+	int count = 0;
 
-	/* Array of size "max_queue_depth * InCapsuleDataSize" containing
-	 * buffers to be used for in capsule data.
-	 */
-	void					*bufs;
-	struct ibv_mr				*bufs_mr;
+	if (rdma_conn->wc_ring_overflow) {
+		SPDK_ERRLOG("Completion ring overflow on Connection %p\n", rdma_conn);
+		return -1;
+	}
 
-	TAILQ_ENTRY(spdk_nvmf_rdma_conn)	link;
-};
+	tail = rdma_conn->wc_ring_tail;
+	head = rdma_conn->wc_ring_head;
+	if (head == tail) {
+		return 0;
+	}
 
-/* List of RDMA connections that have not yet received a CONNECT capsule */
-static TAILQ_HEAD(, spdk_nvmf_rdma_conn) g_pending_conns = TAILQ_HEAD_INITIALIZER(g_pending_conns);
+	/* Read the entries only after seeing head */
+	spdk_mb();
 
-struct spdk_nvmf_rdma_session {
-	SLIST_HEAD(, spdk_nvmf_rdma_buf)	data_buf_pool;
+	while (tail != head && count < max) {
+		wc[count++] = rdma_conn->wc_ring[tail & rdma_conn->wc_ring_mask];
+		tail++;
+	}
 
-	uint8_t					*buf;
-	struct ibv_mr				*buf_mr;
-};
+	/* The entries must be copied out before the poll group may reuse them */
+	spdk_mb();
+	rdma_conn->wc_ring_tail = tail;
 
-struct spdk_nvmf_rdma_listen_addr {
-	char					*traddr;
-	char					*trsvcid;
-	struct rdma_cm_id			*id;
-	struct ibv_device_attr 			attr;
-	struct ibv_comp_channel			*comp_channel;
-	TAILQ_ENTRY(spdk_nvmf_rdma_listen_addr)	link;
-};
+	return count;
+}
 
-struct spdk_nvmf_rdma {
-	struct rdma_event_channel	*event_channel;
+static void
+spdk_nvmf_rdma_poll_group_poll(void)
+{
+	struct spdk_nvmf_rdma_lcore_poll_groups *lcore_groups;
+	struct spdk_nvmf_rdma_poll_group *group;
+	unsigned lcore = rte_lcore_id();
 
-	pthread_mutex_t 		lock;
+	if (lcore >= RTE_MAX_LCORE) {
+		return;
+	}
 
-	uint16_t 			max_queue_depth;
-	uint32_t 			max_io_size;
-	uint32_t 			in_capsule_data_size;
+	lcore_groups = &g_rdma.poll_groups[lcore];
+	if (TAILQ_EMPTY(&lcore_groups->groups)) {
+		return;
+	}
 
-	TAILQ_HEAD(, spdk_nvmf_rdma_listen_addr)	listen_addrs;
-};
+	pthread_spin_lock(&lcore_groups->lock);
+	TAILQ_FOREACH(group, &lcore_groups->groups, link) {
+		spdk_nvmf_rdma_poll_group_reap(group);
+	}
+	pthread_spin_unlock(&lcore_groups->lock);
+}
 
-static struct spdk_nvmf_rdma g_rdma = {
-	.lock = PTHREAD_MUTEX_INITIALIZER,
-	.listen_addrs = TAILQ_HEAD_INITIALIZER(g_rdma.listen_addrs),
-};
+static inline void
+nvmf_rdma_queue_send_wr(struct spdk_nvmf_rdma_conn *rdma_conn, struct ibv_send_wr *wr)
+{
+	wr->next = NULL;
+	if (rdma_conn->send_wr_last) {
+		rdma_conn->send_wr_last->next = wr;
+	} else {
+		rdma_conn->send_wr_first = wr;
+	}
+	rdma_conn->send_wr_last = wr;
+}
 
-static inline struct spdk_nvmf_rdma_conn *
-get_rdma_conn(struct spdk_nvmf_conn *conn)
+static inline void
+nvmf_rdma_queue_recv_wr(struct spdk_nvmf_rdma_conn *rdma_conn, struct ibv_recv_wr *wr)
 {
-	return (struct spdk_nvmf_rdma_conn *)((uintptr_t)conn - offsetof(struct spdk_nvmf_rdma_conn, conn));
+	wr->next = NULL;
+	if (rdma_conn->recv_wr_last) {
+		rdma_conn->recv_wr_last->next = wr;
+	} else {
+		rdma_conn->recv_wr_first = wr;
+	}
+	rdma_conn->recv_wr_last = wr;
 }
 
-static inline struct spdk_nvmf_rdma_request *
-get_rdma_req(struct spdk_nvmf_request *req)
+/* Post the queued work requests, one chain and one doorbell per queue */
+static int
+spdk_nvmf_rdma_conn_flush(struct spdk_nvmf_rdma_conn *rdma_conn)
 {
-	return (struct spdk_nvmf_rdma_request *)((uintptr_t)req - offsetof(struct spdk_nvmf_rdma_request,
-			req));
+	struct ibv_send_wr	*bad_send_wr = NULL;
+	struct ibv_recv_wr	*bad_recv_wr = NULL;
+	struct ibv_recv_wr	*recv_wr = rdma_conn->recv_wr_first;
+	struct ibv_send_wr	*send_wr = rdma_conn->send_wr_first;
+	int			rc;
+
+	rdma_conn->recv_wr_first = NULL;
+	rdma_conn->recv_wr_last = NULL;
+	rdma_conn->send_wr_first = NULL;
+	rdma_conn->send_wr_last = NULL;
+
+	/* Receives go first so that they are in place before the host sees the responses */
+	if (recv_wr) {
+		if (rdma_conn->srq) {
+			rc = nvmf_post_rdma_srq_recv(rdma_conn->srq, recv_wr);
+		} else {
+			rc = ibv_post_recv(rdma_conn->cm_id->qp, recv_wr, &bad_recv_wr);
+			if (rc) {
+				SPDK_ERRLOG("Failure posting rdma recv, rc = 0x%x\n", rc);
+			}
+		}
+		if (rc) {
+			return rc;
+		}
+	}
+
+	if (send_wr) {
+		rc = ibv_post_send(rdma_conn->cm_id->qp, send_wr, &bad_send_wr);
+		if (rc) {
+			SPDK_ERRLOG("Failure posting rdma send, rc = 0x%x\n", rc);
+			return rc;
+		}
+	}
+
+	return 0;
 }
 
-static int nvmf_post_rdma_recv(struct spdk_nvmf_request *req);
+static void nvmf_post_rdma_recv(struct spdk_nvmf_rdma_conn *rdma_conn,
+				struct spdk_nvmf_rdma_recv *recv);
 
 static void
 spdk_nvmf_rdma_conn_destroy(struct spdk_nvmf_rdma_conn *rdma_conn)
 {
+	SPDK_TRACELOG(SPDK_TRACE_RDMA, "Connection %p: %" PRIu64 " in capsule writes, %" PRIu64
+		      " writes transferred by RDMA READ\n", rdma_conn,
+		      rdma_conn->conn.stats.in_capsule_writes, rdma_conn->conn.stats.transferred_writes);
+
+	spdk_nvmf_rdma_conn_unbind_buf_pool(rdma_conn);
+	spdk_nvmf_rdma_conn_release_recvs(rdma_conn);
+
 	if (rdma_conn->cmds_mr) {
 		rdma_dereg_mr(rdma_conn->cmds_mr);
 	}
@@ -192,6 +1491,10 @@ spdk_nvmf_rdma_conn_destroy(struct spdk_nvmf_rdma_conn *rdma_conn)
 		rdma_dereg_mr(rdma_conn->bufs_mr);
 	}
 
+	if (rdma_conn->poll_group) {
+		spdk_nvmf_rdma_poll_group_remove_conn(rdma_conn->poll_group, rdma_conn);
+	}
+
 	if (rdma_conn->cm_id) {
 		rdma_destroy_qp(rdma_conn->cm_id);
 		rdma_destroy_id(rdma_conn->cm_id);
@@ -201,23 +1504,36 @@ spdk_nvmf_rdma_conn_destroy(struct spdk_nvmf_rdma_conn *rdma_conn)
 		ibv_destroy_cq(rdma_conn->cq);
 	}
 
+	if (rdma_conn->poll_group) {
+		spdk_nvmf_rdma_poll_group_put(rdma_conn->poll_group, rdma_conn->cq_size);
+	}
+
+	/* Only after the QP is gone, since it may be the SRQ's last user */
+	if (rdma_conn->srq) {
+		spdk_nvmf_rdma_srq_put(rdma_conn->srq);
+	}
+
 	/* Free all memory */
 	rte_free(rdma_conn->cmds);
 	rte_free(rdma_conn->cpls);
 	rte_free(rdma_conn->bufs);
+	free(rdma_conn->recvs);
 	free(rdma_conn->reqs);
+	free(rdma_conn->wc_ring);
 	free(rdma_conn);
 }
 
 static struct spdk_nvmf_rdma_conn *
 spdk_nvmf_rdma_conn_create(struct rdma_cm_id *id, struct ibv_comp_channel *channel,
-			   uint16_t max_queue_depth, uint16_t max_rw_depth)
+			   uint16_t max_queue_depth, uint16_t max_rw_depth, uint16_t max_send_sge,
+			   uint16_t max_read_sge, uint32_t in_capsule_data_size, bool shared_cq)
 {
 	struct spdk_nvmf_rdma_conn	*rdma_conn;
 	struct spdk_nvmf_conn		*conn;
 	int				rc, i;
 	struct ibv_qp_init_attr		attr;
 	struct spdk_nvmf_rdma_request	*rdma_req;
+	struct spdk_nvmf_rdma_recv	*recv;
 
 	rdma_conn = calloc(1, sizeof(struct spdk_nvmf_rdma_conn));
 	if (rdma_conn == NULL) {
@@ -227,28 +1543,71 @@ spdk_nvmf_rdma_conn_create(struct rdma_cm_id *id, struct ibv_comp_channel *chann
 
 	rdma_conn->max_queue_depth = max_queue_depth;
 	rdma_conn->max_rw_depth = max_rw_depth;
+	rdma_conn->max_send_sge = max_send_sge;
+	rdma_conn->max_read_sge = max_read_sge;
+	rdma_conn->in_capsule_data_size = in_capsule_data_size;
 	rdma_conn->cm_id = id;
-	TAILQ_INIT(&rdma_conn->pending_data_buf_queue);
+	for (i = 0; i < NVMF_RDMA_NUM_BUF_CLASSES; i++) {
+		TAILQ_INIT(&rdma_conn->pending_data_buf_queue[i]);
+	}
 	TAILQ_INIT(&rdma_conn->pending_rdma_rw_queue);
+	TAILQ_INIT(&rdma_conn->free_queue);
+	TAILQ_INIT(&rdma_conn->pending_recv_queue);
 
-	rdma_conn->cq = ibv_create_cq(id->verbs, max_queue_depth * 2, NULL, channel, 0);
-	if (!rdma_conn->cq) {
-		SPDK_ERRLOG("Unable to create completion queue\n");
-		SPDK_ERRLOG("Completion Channel: %p Id: %p Verbs: %p\n", channel, id, id->verbs);
-		SPDK_ERRLOG("Errno %d: %s\n", errno, strerror(errno));
-		free(rdma_conn);
-		return NULL;
+	/* One entry per send and receive work request */
+	rdma_conn->cq_size = max_queue_depth * 2 + max_rw_depth;
+
+	if (shared_cq) {
+		rdma_conn->poll_group = spdk_nvmf_rdma_poll_group_get(id->verbs,
+					rdma_conn->cq_size);
+	}
+
+	if (rdma_conn->poll_group) {
+		/* Large enough for every completion the connection can have outstanding */
+		rdma_conn->wc_ring_mask = (1U << (nvmf_u32log2(rdma_conn->cq_size) + 1)) - 1;
+		rdma_conn->wc_ring = calloc(rdma_conn->wc_ring_mask + 1,
+					    sizeof(*rdma_conn->wc_ring));
+		if (!rdma_conn->wc_ring) {
+			SPDK_ERRLOG("Unable to allocate completion ring\n");
+			spdk_nvmf_rdma_conn_destroy(rdma_conn);
+			return NULL;
+		}
+	} else {
+		rdma_conn->cq = ibv_create_cq(id->verbs, rdma_conn->cq_size, NULL, channel, 0);
+		if (!rdma_conn->cq) {
+			SPDK_ERRLOG("Unable to create completion queue\n");
+			SPDK_ERRLOG("Completion Channel: %p Id: %p Verbs: %p\n",
+				    channel, id, id->verbs);
+			SPDK_ERRLOG("Errno %d: %s\n", errno, strerror(errno));
+			free(rdma_conn);
+			return NULL;
+		}
 	}
 
 	memset(&attr, 0, sizeof(struct ibv_qp_init_attr));
 	attr.qp_type		= IBV_QPT_RC;
 	attr.send_cq		= rdma_conn->cq;
 	attr.recv_cq		= rdma_conn->cq;
-	attr.cap.max_send_wr	= max_queue_depth; /* SEND, READ, and WRITE operations */
+	if (rdma_conn->poll_group) {
+		attr.send_cq = rdma_conn->poll_group->cq;
+		attr.recv_cq = rdma_conn->poll_group->cq;
+	}
+	attr.cap.max_send_wr	= max_queue_depth + max_rw_depth; /* SEND, READ, and WRITE operations */
 	attr.cap.max_recv_wr	= max_queue_depth; /* RECV operations */
-	attr.cap.max_send_sge	= NVMF_DEFAULT_TX_SGE;
+	attr.cap.max_send_sge	= max_send_sge;
 	attr.cap.max_recv_sge	= NVMF_DEFAULT_RX_SGE;
 
+	if (g_rdma.srq_depth > 0) {
+		rdma_conn->srq = spdk_nvmf_rdma_srq_get(id);
+		if (!rdma_conn->srq) {
+			spdk_nvmf_rdma_conn_destroy(rdma_conn);
+			return NULL;
+		}
+		attr.srq = rdma_conn->srq->srq;
+		attr.cap.max_recv_wr = 0;
+		attr.cap.max_recv_sge = 0;
+	}
+
 	rc = rdma_create_qp(rdma_conn->cm_id, NULL, &attr);
 	if (rc) {
 		SPDK_ERRLOG("rdma_create_qp failed\n");
@@ -261,16 +1620,60 @@ spdk_nvmf_rdma_conn_create(struct rdma_cm_id *id, struct ibv_comp_channel *chann
 	conn->transport = &spdk_nvmf_transport_rdma;
 	id->context = conn;
 
+	if (rdma_conn->poll_group) {
+		spdk_nvmf_rdma_poll_group_add_conn(rdma_conn->poll_group, rdma_conn);
+
+		/* Poll the queue on the core that reaps its completions */
+		conn->lcore = rdma_conn->poll_group->lcore;
+		conn->lcore_preferred = true;
+		SPDK_TRACELOG(SPDK_TRACE_RDMA, "Connection %p uses the shared CQ of lcore %u\n",
+			      conn, conn->lcore);
+	}
+
+	if (spdk_nvmf_rdma_conn_bind_buf_pool(rdma_conn)) {
+		spdk_nvmf_rdma_conn_destroy(rdma_conn);
+		return NULL;
+	}
+
 	SPDK_TRACELOG(SPDK_TRACE_RDMA, "New RDMA Connection: %p\n", conn);
 
 	rdma_conn->reqs = calloc(max_queue_depth, sizeof(*rdma_conn->reqs));
-	rdma_conn->cmds = rte_calloc("nvmf_rdma_cmd", max_queue_depth,
-				     sizeof(*rdma_conn->cmds), 0x1000);
 	rdma_conn->cpls = rte_calloc("nvmf_rdma_cpl", max_queue_depth,
 				     sizeof(*rdma_conn->cpls), 0x1000);
+	if (!rdma_conn->reqs || !rdma_conn->cpls) {
+		SPDK_ERRLOG("Unable to allocate sufficient memory for RDMA queue.\n");
+		spdk_nvmf_rdma_conn_destroy(rdma_conn);
+		return NULL;
+	}
+
+	for (i = 0; i < max_queue_depth; i++) {
+		rdma_req = &rdma_conn->reqs[i];
+		rdma_req->req.rsp = &rdma_conn->cpls[i];
+		rdma_req->req.conn = &rdma_conn->conn;
+		TAILQ_INSERT_TAIL(&rdma_conn->free_queue, rdma_req, link);
+	}
+
+	if (rdma_conn->srq) {
+		/* Capsules arrive in the shared receive buffers */
+		rdma_conn->cpls_mr = rdma_reg_msgs(rdma_conn->cm_id, rdma_conn->cpls,
+						   max_queue_depth * sizeof(*rdma_conn->cpls));
+		if (!rdma_conn->cpls_mr) {
+			SPDK_ERRLOG("Unable to register required memory for RDMA queue.\n");
+			spdk_nvmf_rdma_conn_destroy(rdma_conn);
+			return NULL;
+		}
+
+		spdk_nvmf_rdma_srq_add_conn(rdma_conn->srq, rdma_conn);
+
+		return rdma_conn;
+	}
+
+	rdma_conn->recvs = calloc(max_queue_depth, sizeof(*rdma_conn->recvs));
+	rdma_conn->cmds = rte_calloc("nvmf_rdma_cmd", max_queue_depth,
+				     sizeof(*rdma_conn->cmds), 0x1000);
 	rdma_conn->bufs = rte_calloc("nvmf_rdma_buf", max_queue_depth,
-				     g_rdma.in_capsule_data_size, 0x1000);
-	if (!rdma_conn->reqs || !rdma_conn->cmds || !rdma_conn->cpls || !rdma_conn->bufs) {
+				     in_capsule_data_size, 0x1000);
+	if (!rdma_conn->recvs || !rdma_conn->cmds || !rdma_conn->bufs) {
 		SPDK_ERRLOG("Unable to allocate sufficient memory for RDMA queue.\n");
 		spdk_nvmf_rdma_conn_destroy(rdma_conn);
 		return NULL;
@@ -281,7 +1684,7 @@ spdk_nvmf_rdma_conn_create(struct rdma_cm_id *id, struct ibv_comp_channel *chann
 	rdma_conn->cpls_mr = rdma_reg_msgs(rdma_conn->cm_id, rdma_conn->cpls,
 					   max_queue_depth * sizeof(*rdma_conn->cpls));
 	rdma_conn->bufs_mr = rdma_reg_msgs(rdma_conn->cm_id, rdma_conn->bufs,
-					   max_queue_depth * g_rdma.in_capsule_data_size);
+					   max_queue_depth * in_capsule_data_size);
 	if (!rdma_conn->cmds_mr || !rdma_conn->cpls_mr || !rdma_conn->bufs_mr) {
 		SPDK_ERRLOG("Unable to register required memory for RDMA queue.\n");
 		spdk_nvmf_rdma_conn_destroy(rdma_conn);
@@ -292,34 +1695,24 @@ spdk_nvmf_rdma_conn_create(struct rdma_cm_id *id, struct ibv_comp_channel *chann
 	SPDK_TRACELOG(SPDK_TRACE_RDMA, "Completion Array: %p Length: %lx LKey: %x\n",
 		      rdma_conn->cpls, max_queue_depth * sizeof(*rdma_conn->cpls), rdma_conn->cpls_mr->lkey);
 	SPDK_TRACELOG(SPDK_TRACE_RDMA, "In Capsule Data Array: %p Length: %x LKey: %x\n",
-		      rdma_conn->bufs, max_queue_depth * g_rdma.in_capsule_data_size, rdma_conn->bufs_mr->lkey);
+		      rdma_conn->bufs, max_queue_depth * in_capsule_data_size, rdma_conn->bufs_mr->lkey);
 
 	for (i = 0; i < max_queue_depth; i++) {
-		rdma_req = &rdma_conn->reqs[i];
-		rdma_req->buf = (void *)((uintptr_t)rdma_conn->bufs + (i * g_rdma.in_capsule_data_size));
-		rdma_req->req.cmd = &rdma_conn->cmds[i];
-		rdma_req->req.rsp = &rdma_conn->cpls[i];
-		rdma_req->req.conn = &rdma_conn->conn;
+		recv = &rdma_conn->recvs[i];
+		recv->cmd = &rdma_conn->cmds[i];
+		recv->buf = (uint8_t *)rdma_conn->bufs + (i * in_capsule_data_size);
+		nvmf_post_rdma_recv(rdma_conn, recv);
+	}
 
-		if (nvmf_post_rdma_recv(&rdma_req->req)) {
-			SPDK_ERRLOG("Unable to post capsule for RDMA RECV\n");
-			spdk_nvmf_rdma_conn_destroy(rdma_conn);
-			return NULL;
-		}
+	if (spdk_nvmf_rdma_conn_flush(rdma_conn)) {
+		SPDK_ERRLOG("Unable to post capsules for RDMA RECV\n");
+		spdk_nvmf_rdma_conn_destroy(rdma_conn);
+		return NULL;
 	}
 
 	return rdma_conn;
 }
 
-static inline void
-nvmf_trace_ibv_sge(struct ibv_sge *sg_list)
-{
-	if (sg_list) {
-		SPDK_TRACELOG(SPDK_TRACE_RDMA, "local addr %p length 0x%x lkey 0x%x\n",
-			      (void *)sg_list->addr, sg_list->length, sg_list->lkey);
-	}
-}
-
 static inline void
 nvmf_ibv_send_wr_init(struct ibv_send_wr *wr,
 		      struct spdk_nvmf_request *req,
@@ -331,6 +1724,7 @@ nvmf_ibv_send_wr_init(struct ibv_send_wr *wr,
 	assert(wr != NULL);
 	assert(sg_list != NULL);
 
+	memset(wr, 0, sizeof(*wr));
 	wr->wr_id = (uint64_t)rdma_req;
 	wr->opcode = opcode;
 	wr->send_flags = send_flags;
@@ -352,138 +1746,115 @@ nvmf_ibv_send_wr_set_rkey(struct ibv_send_wr *wr, struct spdk_nvmf_request *req)
 		      wr->wr.rdma.rkey, (void *)wr->wr.rdma.remote_addr);
 }
 
+/* Returns the number of SGEs that describe the request's data */
 static int
-nvmf_post_rdma_read(struct spdk_nvmf_request *req)
+nvmf_rdma_request_data_sge_init(struct spdk_nvmf_request *req)
 {
-	struct ibv_send_wr	wr = {};
-	struct ibv_send_wr	*bad_wr = NULL;
-	struct spdk_nvmf_conn 	*conn = req->conn;
-	struct spdk_nvmf_rdma_conn 	*rdma_conn = get_rdma_conn(conn);
-	struct spdk_nvmf_rdma_session 	*rdma_sess;
-	struct ibv_sge 		sge;
-	int 			rc;
-
-	SPDK_TRACELOG(SPDK_TRACE_RDMA, "RDMA READ POSTED. Request: %p Connection: %p\n", req, conn);
-
-	sge.addr = (uintptr_t)req->data;
-	if (req->length > g_rdma.in_capsule_data_size) {
-		rdma_sess = conn->sess->trctx;
-		sge.lkey = rdma_sess->buf_mr->lkey;
-	} else {
-		sge.lkey = rdma_conn->bufs_mr->lkey;
+	struct spdk_nvmf_rdma_conn	*rdma_conn = get_rdma_conn(req->conn);
+	struct spdk_nvmf_rdma_request	*rdma_req = get_rdma_req(req);
+	struct ibv_sge			*sge = rdma_req->data_sgl;
+	uint32_t			i;
+
+	if (rdma_req->num_data_bufs > 0) {
+		for (i = 0; i < rdma_req->num_data_bufs; i++) {
+			sge[i].addr = (uintptr_t)req->iov[i].iov_base;
+			sge[i].length = req->iov[i].iov_len;
+			sge[i].lkey = rdma_conn->buf_mr->lkey;
+			nvmf_trace_ibv_sge(&sge[i]);
+		}
+		return rdma_req->num_data_bufs;
 	}
-	sge.length = req->length;
-	nvmf_trace_ibv_sge(&sge);
 
-	nvmf_ibv_send_wr_init(&wr, req, &sge, IBV_WR_RDMA_READ, IBV_SEND_SIGNALED);
-	nvmf_ibv_send_wr_set_rkey(&wr, req);
-
-	spdk_trace_record(TRACE_RDMA_READ_START, 0, 0, (uintptr_t)req, 0);
-	rc = ibv_post_send(rdma_conn->cm_id->qp, &wr, &bad_wr);
-	if (rc) {
-		SPDK_ERRLOG("Failure posting rdma read send, rc = 0x%x\n", rc);
+	sge->addr = (uintptr_t)req->data;
+	if (rdma_conn->srq != NULL) {
+		sge->lkey = rdma_conn->srq->bufs_mr->lkey;
+	} else {
+		sge->lkey = rdma_conn->bufs_mr->lkey;
 	}
-
-	return rc;
+	sge->length = req->length;
+	nvmf_trace_ibv_sge(sge);
+	return 1;
 }
 
-static int
-nvmf_post_rdma_write(struct spdk_nvmf_request *req)
+/*
+ * The nvmf_post_rdma_* functions queue their work request on the connection.
+ * spdk_nvmf_rdma_conn_flush() posts them.
+ */
+
+static void
+nvmf_post_rdma_read(struct spdk_nvmf_request *req)
 {
-	struct ibv_send_wr	wr = {};
-	struct ibv_send_wr	*bad_wr = NULL;
 	struct spdk_nvmf_conn 	*conn = req->conn;
 	struct spdk_nvmf_rdma_conn 	*rdma_conn = get_rdma_conn(conn);
-	struct spdk_nvmf_rdma_session 	*rdma_sess;
-	struct ibv_sge 		sge;
-	int 			rc;
-
-	SPDK_TRACELOG(SPDK_TRACE_RDMA, "RDMA WRITE POSTED. Request: %p Connection: %p\n", req, conn);
-
-	sge.addr = (uintptr_t)req->data;
-	if (req->length > g_rdma.in_capsule_data_size) {
-		rdma_sess = conn->sess->trctx;
-		sge.lkey = rdma_sess->buf_mr->lkey;
-	} else {
-		sge.lkey = rdma_conn->bufs_mr->lkey;
-	}
-	sge.length = req->length;
-	nvmf_trace_ibv_sge(&sge);
+	struct spdk_nvmf_rdma_request	*rdma_req = get_rdma_req(req);
+	int				num_sge;
 
-	nvmf_ibv_send_wr_init(&wr, req, &sge, IBV_WR_RDMA_WRITE, IBV_SEND_SIGNALED);
-	nvmf_ibv_send_wr_set_rkey(&wr, req);
+	SPDK_TRACELOG(SPDK_TRACE_RDMA, "RDMA READ POSTED. Request: %p Connection: %p\n", req, conn);
 
-	spdk_trace_record(TRACE_RDMA_WRITE_START, 0, 0, (uintptr_t)req, 0);
-	rc = ibv_post_send(rdma_conn->cm_id->qp, &wr, &bad_wr);
-	if (rc) {
-		SPDK_ERRLOG("Failure posting rdma write send, rc = 0x%x\n", rc);
-	}
+	num_sge = nvmf_rdma_request_data_sge_init(req);
+	nvmf_ibv_send_wr_init(&rdma_req->data_wr, req, rdma_req->data_sgl, IBV_WR_RDMA_READ,
+			      IBV_SEND_SIGNALED);
+	rdma_req->data_wr.num_sge = num_sge;
+	nvmf_ibv_send_wr_set_rkey(&rdma_req->data_wr, req);
 
-	return rc;
+	spdk_trace_record(TRACE_RDMA_READ_START, 0, 0, (uintptr_t)req, 0);
+	nvmf_rdma_queue_send_wr(rdma_conn, &rdma_req->data_wr);
 }
 
-static int
-nvmf_post_rdma_recv(struct spdk_nvmf_request *req)
+/* Not signaled. Completion of the response SEND that follows implies completion of the WRITE. */
+static void
+nvmf_post_rdma_write(struct spdk_nvmf_request *req)
 {
-	struct ibv_recv_wr wr, *bad_wr = NULL;
-	struct spdk_nvmf_conn *conn = req->conn;
-	struct spdk_nvmf_rdma_conn *rdma_conn = get_rdma_conn(conn);
-	struct spdk_nvmf_rdma_request *rdma_req = get_rdma_req(req);
-	struct ibv_sge sg_list[2];
-	int rc;
+	struct spdk_nvmf_conn 	*conn = req->conn;
+	struct spdk_nvmf_rdma_conn 	*rdma_conn = get_rdma_conn(conn);
+	struct spdk_nvmf_rdma_request	*rdma_req = get_rdma_req(req);
+	int				num_sge;
 
-	SPDK_TRACELOG(SPDK_TRACE_RDMA, "RDMA RECV POSTED. Request: %p Connection: %p\n", req, conn);
+	SPDK_TRACELOG(SPDK_TRACE_RDMA, "RDMA WRITE POSTED. Request: %p Connection: %p\n", req, conn);
 
-	sg_list[0].addr = (uintptr_t)req->cmd;
-	sg_list[0].length = sizeof(*req->cmd);
-	sg_list[0].lkey = rdma_conn->cmds_mr->lkey;
-	nvmf_trace_ibv_sge(&sg_list[0]);
+	num_sge = nvmf_rdma_request_data_sge_init(req);
+	nvmf_ibv_send_wr_init(&rdma_req->data_wr, req, rdma_req->data_sgl, IBV_WR_RDMA_WRITE, 0);
+	rdma_req->data_wr.num_sge = num_sge;
+	nvmf_ibv_send_wr_set_rkey(&rdma_req->data_wr, req);
 
-	sg_list[1].addr = (uintptr_t)rdma_req->buf;
-	sg_list[1].length = g_rdma.in_capsule_data_size;
-	sg_list[1].lkey = rdma_conn->bufs_mr->lkey;
-	nvmf_trace_ibv_sge(&sg_list[1]);
+	spdk_trace_record(TRACE_RDMA_WRITE_START, 0, 0, (uintptr_t)req, 0);
+	nvmf_rdma_queue_send_wr(rdma_conn, &rdma_req->data_wr);
+}
 
-	memset(&wr, 0, sizeof(wr));
-	wr.wr_id = (uintptr_t)rdma_req;
-	wr.next = NULL;
-	wr.sg_list = sg_list;
-	wr.num_sge = 2;
+static void
+nvmf_post_rdma_recv(struct spdk_nvmf_rdma_conn *rdma_conn, struct spdk_nvmf_rdma_recv *recv)
+{
+	SPDK_TRACELOG(SPDK_TRACE_RDMA, "RDMA RECV POSTED. Recv: %p Connection: %p\n", recv, rdma_conn);
 
-	rc = ibv_post_recv(rdma_conn->cm_id->qp, &wr, &bad_wr);
-	if (rc) {
-		SPDK_ERRLOG("Failure posting rdma recv, rc = 0x%x\n", rc);
+	if (rdma_conn->srq) {
+		nvmf_rdma_recv_wr_init(recv, rdma_conn->srq->cmds_mr, rdma_conn->srq->bufs_mr,
+				       g_rdma.in_capsule_data_size);
+	} else {
+		nvmf_rdma_recv_wr_init(recv, rdma_conn->cmds_mr, rdma_conn->bufs_mr,
+				       rdma_conn->in_capsule_data_size);
 	}
-
-	return rc;
+	nvmf_rdma_queue_recv_wr(rdma_conn, &recv->wr);
 }
 
-static int
+static void
 nvmf_post_rdma_send(struct spdk_nvmf_request *req)
 {
-	struct ibv_send_wr	wr = {};
-	struct ibv_send_wr	*bad_wr = NULL;
 	struct spdk_nvmf_conn 	*conn = req->conn;
 	struct spdk_nvmf_rdma_conn 	*rdma_conn = get_rdma_conn(conn);
-	struct ibv_sge 		sge;
-	int 			rc;
+	struct spdk_nvmf_rdma_request	*rdma_req = get_rdma_req(req);
+	struct ibv_sge 		*sge = &rdma_req->rsp_sge;
 
 	SPDK_TRACELOG(SPDK_TRACE_RDMA, "RDMA SEND POSTED. Request: %p Connection: %p\n", req, conn);
 
-	sge.addr = (uintptr_t)req->rsp;
-	sge.length = sizeof(*req->rsp);
-	sge.lkey = rdma_conn->cpls_mr->lkey;
-	nvmf_trace_ibv_sge(&sge);
+	sge->addr = (uintptr_t)req->rsp;
+	sge->length = sizeof(*req->rsp);
+	sge->lkey = rdma_conn->cpls_mr->lkey;
+	nvmf_trace_ibv_sge(sge);
 
-	nvmf_ibv_send_wr_init(&wr, req, &sge, IBV_WR_SEND, IBV_SEND_SIGNALED);
+	nvmf_ibv_send_wr_init(&rdma_req->rsp_wr, req, sge, IBV_WR_SEND, IBV_SEND_SIGNALED);
 
 	spdk_trace_record(TRACE_NVMF_IO_COMPLETE, 0, 0, (uintptr_t)req, 0);
-	rc = ibv_post_send(rdma_conn->cm_id->qp, &wr, &bad_wr);
-	if (rc) {
-		SPDK_ERRLOG("Failure posting rdma send for NVMf completion, rc = 0x%x\n", rc);
-	}
-
-	return rc;
+	nvmf_rdma_queue_send_wr(rdma_conn, &rdma_req->rsp_wr);
 }
 
 /**
@@ -493,22 +1864,28 @@ nvmf_post_rdma_send(struct spdk_nvmf_request *req)
  *
  * 1) Transfer any data to the host using an RDMA Write. If no data or an NVMe write,
  *    this step is unnecessary. (spdk_nvmf_rdma_request_transfer_data)
- * 2) Upon transfer completion, update sq_head, re-post the recv capsule,
- *    and send the completion. (spdk_nvmf_rdma_request_send_completion)
- * 3) Upon getting acknowledgement of the completion, decrement the internal
- *    count of number of outstanding requests. (spdk_nvmf_rdma_request_ack_completion)
+ * 2) Update sq_head, re-post the recv capsule, and send the completion. The
+ *    completion is chained right behind the RDMA Write, if there is one.
+ *    (spdk_nvmf_rdma_request_send_completion)
+ * 3) Upon getting acknowledgement of the completion, release the data buffer,
+ *    decrement the internal count of number of outstanding requests and free
+ *    the request. (spdk_nvmf_rdma_request_ack_completion)
  *
  * There are two public interfaces to initiate the process of completing a request,
  * exposed as callbacks in the transport layer.
  *
  * 1) spdk_nvmf_rdma_request_complete, which attempts to do all three steps.
  * 2) spdk_nvmf_rdma_request_release, which skips straight to step 3.
+ *
+ * Work requests are queued on the connection. Within spdk_nvmf_rdma_poll they
+ * are posted once the poll is done; otherwise before the public interfaces return.
 **/
 
+static int spdk_nvmf_rdma_request_send_completion(struct spdk_nvmf_request *req);
+
 static int
 spdk_nvmf_rdma_request_transfer_data(struct spdk_nvmf_request *req)
 {
-	int rc;
 	struct spdk_nvmf_rdma_request *rdma_req = get_rdma_req(req);
 	struct spdk_nvmf_conn *conn = req->conn;
 	struct spdk_nvmf_rdma_conn *rdma_conn = get_rdma_conn(conn);
@@ -516,21 +1893,19 @@ spdk_nvmf_rdma_request_transfer_data(struct spdk_nvmf_request *req)
 	assert(req->xfer != SPDK_NVME_DATA_NONE);
 
 	if (rdma_conn->cur_rdma_rw_depth < rdma_conn->max_rw_depth) {
+		rdma_conn->cur_rdma_rw_depth++;
 		if (req->xfer == SPDK_NVME_DATA_CONTROLLER_TO_HOST) {
-			rc = nvmf_post_rdma_write(req);
-			if (rc) {
-				SPDK_ERRLOG("Unable to transfer data from target to host\n");
-				return -1;
-			}
+			/* The response follows the data in the same chain */
+			conn->stats.ctrlr_to_host_bytes += req->length;
+			nvmf_post_rdma_write(req);
+			rdma_req->write_chained = true;
+			return spdk_nvmf_rdma_request_send_completion(req);
 		} else if (req->xfer == SPDK_NVME_DATA_HOST_TO_CONTROLLER) {
-			rc = nvmf_post_rdma_read(req);
-			if (rc) {
-				SPDK_ERRLOG("Unable to transfer data from host to target\n");
-				return -1;
-			}
+			conn->stats.host_to_ctrlr_bytes += req->length;
+			nvmf_post_rdma_read(req);
 		}
-		rdma_conn->cur_rdma_rw_depth++;
 	} else {
+		conn->stats.pending_xfer_waits++;
 		TAILQ_INSERT_TAIL(&rdma_conn->pending_rdma_rw_queue, rdma_req, link);
 	}
 
@@ -540,21 +1915,10 @@ spdk_nvmf_rdma_request_transfer_data(struct spdk_nvmf_request *req)
 static int
 spdk_nvmf_rdma_request_send_completion(struct spdk_nvmf_request *req)
 {
-	int rc;
 	struct spdk_nvmf_conn		*conn = req->conn;
+	struct spdk_nvmf_rdma_conn	*rdma_conn = get_rdma_conn(conn);
+	struct spdk_nvmf_rdma_request	*rdma_req = get_rdma_req(req);
 	struct spdk_nvme_cpl		*rsp = &req->rsp->nvme_cpl;
-	struct spdk_nvmf_rdma_session	*rdma_sess;
-	struct spdk_nvmf_rdma_buf	*buf;
-
-	if (req->length > g_rdma.in_capsule_data_size) {
-		/* Put the buffer back in the pool */
-		rdma_sess = conn->sess->trctx;
-		buf = req->data;
-
-		SLIST_INSERT_HEAD(&rdma_sess->data_buf_pool, buf, link);
-		req->data = NULL;
-		req->length = 0;
-	}
 
 	/* Advance our sq_head pointer */
 	if (conn->sq_head == conn->sq_head_max) {
@@ -564,20 +1928,22 @@ spdk_nvmf_rdma_request_send_completion(struct spdk_nvmf_request *req)
 	}
 	rsp->sqhd = conn->sq_head;
 
-	/* Post the capsule to the recv buffer */
-	rc = nvmf_post_rdma_recv(req);
-	if (rc) {
-		SPDK_ERRLOG("Unable to re-post rx descriptor\n");
-		return rc;
+	/*
+	 * Post the capsule to the recv buffer. If the RDMA WRITE chained ahead of the
+	 * response sends its data out of the receive buffer, the buffer is reposted
+	 * once the response completes instead: with a shared receive queue another
+	 * connection's capsule could otherwise land in it before the WRITE has read it.
+	 */
+	if (rdma_req->recv != NULL && !(rdma_req->write_chained && rdma_req->num_data_bufs == 0)) {
+		nvmf_post_rdma_recv(rdma_conn, rdma_req->recv);
+		rdma_req->recv = NULL;
 	}
 
 	/* Send the completion */
-	rc = nvmf_post_rdma_send(req);
-	if (rc) {
-		SPDK_ERRLOG("Unable to send response capsule\n");
-	}
+	nvmf_post_rdma_send(req);
+	spdk_nvmf_conn_stats_completion(conn, req->arrival_tsc);
 
-	return rc;
+	return 0;
 }
 
 static int
@@ -594,6 +1960,7 @@ spdk_nvmf_rdma_request_ack_completion(struct spdk_nvmf_request *req)
 	}
 
 	rdma_conn->cur_queue_depth--;
+	spdk_nvmf_conn_stats_done(conn);
 
 	return 0;
 }
@@ -601,6 +1968,7 @@ spdk_nvmf_rdma_request_ack_completion(struct spdk_nvmf_request *req)
 static int
 spdk_nvmf_rdma_request_complete(struct spdk_nvmf_request *req)
 {
+	struct spdk_nvmf_rdma_conn *rdma_conn = get_rdma_conn(req->conn);
 	struct spdk_nvme_cpl *rsp = &req->rsp->nvme_cpl;
 	int rc;
 
@@ -611,13 +1979,45 @@ spdk_nvmf_rdma_request_complete(struct spdk_nvmf_request *req)
 		rc = spdk_nvmf_rdma_request_send_completion(req);
 	}
 
+	if (rc == 0 && !rdma_conn->in_poll) {
+		rc = spdk_nvmf_rdma_conn_flush(rdma_conn);
+	}
+
 	return rc;
 }
 
 static int
 spdk_nvmf_rdma_request_release(struct spdk_nvmf_request *req)
 {
-	return spdk_nvmf_rdma_request_ack_completion(req);
+	struct spdk_nvmf_rdma_conn *rdma_conn = get_rdma_conn(req->conn);
+	struct spdk_nvmf_rdma_request *rdma_req = get_rdma_req(req);
+	int rc;
+
+	/* No response is sent, so give the capsule and the request back right away */
+	if (rdma_req->recv != NULL) {
+		nvmf_post_rdma_recv(rdma_conn, rdma_req->recv);
+		rdma_req->recv = NULL;
+	}
+
+	if (rdma_req->num_data_bufs > 0) {
+		spdk_nvmf_rdma_request_put_bufs(rdma_conn->buf_pool, rdma_req);
+		req->data = NULL;
+		req->iovcnt = 0;
+		req->length = 0;
+	}
+
+	rc = spdk_nvmf_rdma_request_ack_completion(req);
+	if (rc) {
+		return rc;
+	}
+
+	TAILQ_INSERT_TAIL(&rdma_conn->free_queue, rdma_req, link);
+
+	if (!rdma_conn->in_poll) {
+		rc = spdk_nvmf_rdma_conn_flush(rdma_conn);
+	}
+
+	return rc;
 }
 
 static int
@@ -632,6 +2032,10 @@ nvmf_rdma_connect(struct rdma_cm_event *event)
 	uint16_t			sts = 0;
 	uint16_t			max_queue_depth;
 	uint16_t			max_rw_depth;
+	uint16_t			max_send_sge;
+	uint16_t			max_read_sge;
+	uint32_t			in_capsule_data_size;
+	bool				shared_cq;
 	int 				rc;
 
 	if (event->id == NULL) {
@@ -667,6 +2071,9 @@ nvmf_rdma_connect(struct rdma_cm_event *event)
 		      addr->attr.max_qp_wr, addr->attr.max_qp_rd_atom);
 	max_queue_depth = nvmf_min(max_queue_depth, addr->attr.max_qp_wr);
 	max_rw_depth = nvmf_min(max_rw_depth, addr->attr.max_qp_rd_atom);
+	max_send_sge = nvmf_min(NVMF_DEFAULT_TX_SGE, addr->attr.max_sge);
+	/* RDMA READs have their own limit, which is 1 on iWARP NICs */
+	max_read_sge = nvmf_max(nvmf_min(max_send_sge, addr->attr.max_sge_rd), 1);
 
 	/* Next check the remote NIC's hardware limitations */
 	rdma_param = &event->param.conn;
@@ -686,13 +2093,33 @@ nvmf_rdma_connect(struct rdma_cm_event *event)
 		max_queue_depth = nvmf_min(max_queue_depth, private_data->hsqsize);
 	}
 
+	/*
+	 * The RDMA WRITE of a read and its SEND are posted together, so the send queue
+	 * holds up to max_rw_depth more work requests than there are requests.
+	 */
+	max_rw_depth = nvmf_min(max_rw_depth, addr->attr.max_qp_wr / 2);
+	if (max_queue_depth + max_rw_depth > addr->attr.max_qp_wr) {
+		max_queue_depth = addr->attr.max_qp_wr - max_rw_depth;
+	}
+
 	SPDK_TRACELOG(SPDK_TRACE_RDMA, "Final Negotiated Queue Depth: %d R/W Depth: %d\n",
 		      max_queue_depth, max_rw_depth);
 
+	/*
+	 * I/O queues may share a completion queue. Admin queues are polled on their
+	 * subsystem's core, which is not known until the CONNECT capsule arrives.
+	 */
+	shared_cq = g_rdma.cq_depth > 0 && private_data != NULL && private_data->qid != 0;
+
+	in_capsule_data_size = g_rdma.in_capsule_data_size;
+	if (private_data != NULL && private_data->qid == 0) {
+		in_capsule_data_size = nvmf_min(in_capsule_data_size, NVMF_RDMA_ADMIN_IN_CAPSULE_DATA_SIZE);
+	}
 
 	/* Init the NVMf rdma transport connection */
 	rdma_conn = spdk_nvmf_rdma_conn_create(event->id, addr->comp_channel, max_queue_depth,
-					       max_rw_depth);
+					       max_rw_depth, max_send_sge, max_read_sge, in_capsule_data_size,
+					       shared_cq);
 	if (rdma_conn == NULL) {
 		SPDK_ERRLOG("Error on nvmf connection creation\n");
 		goto err1;
@@ -719,16 +2146,25 @@ nvmf_rdma_connect(struct rdma_cm_event *event)
 	}
 	SPDK_TRACELOG(SPDK_TRACE_RDMA, "Sent back the accept\n");
 
+	rdma_ack_cm_event(event);
 	return 0;
 
 err1: {
 		struct spdk_nvmf_rdma_reject_private_data rej_data;
 
 		rej_data.status.sc = sts;
-		rdma_reject(event->id, &ctrlr_event_data, sizeof(rej_data));
-		free(rdma_conn);
+		rdma_reject(event->id, &rej_data, sizeof(rej_data));
+	}
+
+	if (rdma_conn != NULL) {
+		TAILQ_REMOVE(&g_pending_conns, rdma_conn, link);
+		/* ack the connect request event before rdma_destroy_id */
+		rdma_ack_cm_event(event);
+		spdk_nvmf_rdma_conn_destroy(rdma_conn);
+		return -1;
 	}
 err0:
+	rdma_ack_cm_event(event);
 	return -1;
 }
 
@@ -799,17 +2235,60 @@ typedef enum _spdk_nvmf_request_prep_type {
 	SPDK_NVMF_REQUEST_PREP_PENDING_DATA = 2,
 } spdk_nvmf_request_prep_type;
 
+/*
+ * Virtual mode reads and writes hand the bdev an iovec, so their data may be
+ * spread across small buffers, as many as one RDMA WRITE (for reads) or one
+ * RDMA READ (for writes) can cover. Everything else needs contiguous data.
+ */
+static uint32_t
+spdk_nvmf_rdma_request_max_bufs(struct spdk_nvmf_request *req)
+{
+	struct spdk_nvmf_conn	*conn = req->conn;
+	uint8_t			opc = req->cmd->nvme_cmd.opc;
+
+	if (conn->type != CONN_TYPE_IOQ || conn->sess == NULL ||
+	    conn->sess->subsys->mode != NVMF_SUBSYSTEM_MODE_VIRTUAL) {
+		return 1;
+	}
+
+	if (opc == SPDK_NVME_OPC_READ) {
+		return get_rdma_conn(conn)->max_send_sge;
+	} else if (opc == SPDK_NVME_OPC_WRITE) {
+		return get_rdma_conn(conn)->max_read_sge;
+	}
+
+	return 1;
+}
+
+/*
+ * The largest in capsule data this connection accepts: the size of its receive
+ * buffers, further limited by the subsystem for I/O queues.
+ */
+static uint32_t
+spdk_nvmf_rdma_conn_in_capsule_limit(struct spdk_nvmf_rdma_conn *rdma_conn)
+{
+	struct spdk_nvmf_conn *conn = &rdma_conn->conn;
+
+	if (conn->type != CONN_TYPE_IOQ || conn->sess == NULL) {
+		return rdma_conn->in_capsule_data_size;
+	}
+
+	return nvmf_min(rdma_conn->in_capsule_data_size, conn->sess->subsys->in_capsule_data_size);
+}
+
 static spdk_nvmf_request_prep_type
 spdk_nvmf_request_prep_data(struct spdk_nvmf_request *req)
 {
 	struct spdk_nvme_cmd		*cmd = &req->cmd->nvme_cmd;
 	struct spdk_nvme_cpl		*rsp = &req->rsp->nvme_cpl;
 	struct spdk_nvmf_rdma_request	*rdma_req = get_rdma_req(req);
-	struct spdk_nvmf_rdma_session	*rdma_sess;
+	struct spdk_nvmf_rdma_conn	*rdma_conn = get_rdma_conn(req->conn);
 	struct spdk_nvme_sgl_descriptor *sgl;
+	enum spdk_nvmf_rdma_buf_class	buf_class;
 
 	req->length = 0;
 	req->data = NULL;
+	req->iovcnt = 0;
 
 	if (cmd->opc == SPDK_NVME_OPC_FABRIC) {
 		req->xfer = spdk_nvme_opc_get_data_transfer(req->cmd->nvmf_cmd.fctype);
@@ -840,24 +2319,28 @@ spdk_nvmf_request_prep_data(struct spdk_nvmf_request *req)
 
 		req->length = sgl->keyed.length;
 
-		/* TODO: In Capsule Data Size should be tracked per queue (admin, for instance, should always have 4k and no more). */
-		if (sgl->keyed.length > g_rdma.in_capsule_data_size) {
-			rdma_sess = req->conn->sess->trctx;
-			req->data = SLIST_FIRST(&rdma_sess->data_buf_pool);
-			if (!req->data) {
+		if (sgl->keyed.length > rdma_conn->in_capsule_data_size) {
+			buf_class = spdk_nvmf_rdma_buf_class(rdma_conn->buf_pool, sgl->keyed.length,
+							     spdk_nvmf_rdma_request_max_bufs(req));
+			rdma_req->data_buf_class = buf_class;
+
+			/* Don't overtake requests of this connection that are already waiting */
+			if (!TAILQ_EMPTY(&rdma_conn->pending_data_buf_queue[buf_class]) ||
+			    spdk_nvmf_rdma_request_get_bufs(rdma_conn, rdma_req) != 0) {
 				/* No available buffers. Queue this request up. */
-				SPDK_TRACELOG(SPDK_TRACE_RDMA, "No available large data buffers. Queueing request %p\n", req);
+				SPDK_TRACELOG(SPDK_TRACE_RDMA, "No available data buffers. Queueing request %p\n", req);
 				return SPDK_NVMF_REQUEST_PREP_PENDING_BUFFER;
 			}
 
-			SPDK_TRACELOG(SPDK_TRACE_RDMA, "Request %p took buffer from central pool\n", req);
-			SLIST_REMOVE_HEAD(&rdma_sess->data_buf_pool, link);
+			SPDK_TRACELOG(SPDK_TRACE_RDMA, "Request %p took %u buffers from central pool\n", req,
+				      rdma_req->num_data_bufs);
 		} else {
 			/* Use the in capsule data buffer, even though this isn't in capsule data */
 			SPDK_TRACELOG(SPDK_TRACE_RDMA, "Request using in capsule buffer for non-capsule data\n");
 			req->data = rdma_req->buf;
 		}
 		if (req->xfer == SPDK_NVME_DATA_HOST_TO_CONTROLLER) {
+			req->conn->stats.transferred_writes++;
 			return SPDK_NVMF_REQUEST_PREP_PENDING_DATA;
 		} else {
 			return SPDK_NVMF_REQUEST_PREP_READY;
@@ -865,7 +2348,7 @@ spdk_nvmf_request_prep_data(struct spdk_nvmf_request *req)
 	} else if (sgl->generic.type == SPDK_NVME_SGL_TYPE_DATA_BLOCK &&
 		   sgl->unkeyed.subtype == SPDK_NVME_SGL_SUBTYPE_OFFSET) {
 		uint64_t offset = sgl->address;
-		uint32_t max_len = g_rdma.in_capsule_data_size;
+		uint32_t max_len = spdk_nvmf_rdma_conn_in_capsule_limit(rdma_conn);
 
 		SPDK_TRACELOG(SPDK_TRACE_NVMF, "In-capsule data: offset 0x%" PRIx64 ", length 0x%x\n",
 			      offset, sgl->unkeyed.length);
@@ -892,6 +2375,9 @@ spdk_nvmf_request_prep_data(struct spdk_nvmf_request *req)
 
 		req->data = rdma_req->buf + offset;
 		req->length = sgl->unkeyed.length;
+		if (req->xfer == SPDK_NVME_DATA_HOST_TO_CONTROLLER) {
+			req->conn->stats.in_capsule_writes++;
+		}
 		return SPDK_NVMF_REQUEST_PREP_READY;
 	}
 
@@ -901,6 +2387,114 @@ spdk_nvmf_request_prep_data(struct spdk_nvmf_request *req)
 	return SPDK_NVMF_REQUEST_PREP_ERROR;
 }
 
+/* Start processing a newly received capsule. Returns the number of requests executed. */
+static int
+spdk_nvmf_rdma_handle_recv(struct spdk_nvmf_request *req)
+{
+	struct spdk_nvmf_conn		*conn = req->conn;
+	struct spdk_nvmf_rdma_conn	*rdma_conn = get_rdma_conn(conn);
+	struct spdk_nvmf_rdma_request	*rdma_req = get_rdma_req(req);
+	int				rc;
+
+	rdma_conn->cur_queue_depth++;
+	req->arrival_tsc = spdk_nvmf_conn_stats_capsule(conn);
+	SPDK_TRACELOG(SPDK_TRACE_RDMA,
+		      "RDMA RECV Complete. Request: %p Connection: %p Outstanding I/O: %d\n",
+		      req, conn, rdma_conn->cur_queue_depth);
+	spdk_trace_record(TRACE_NVMF_IO_START, 0, 0, (uint64_t)req, 0);
+
+	memset(req->rsp, 0, sizeof(*req->rsp));
+	rc = spdk_nvmf_request_prep_data(req);
+	switch (rc) {
+	case SPDK_NVMF_REQUEST_PREP_READY:
+		SPDK_TRACELOG(SPDK_TRACE_RDMA, "Request %p is ready for execution\n", req);
+		/* Data is immediately available */
+		rc = spdk_nvmf_request_exec(req);
+		if (rc < 0) {
+			return -1;
+		}
+		return 1;
+	case SPDK_NVMF_REQUEST_PREP_PENDING_BUFFER:
+		SPDK_TRACELOG(SPDK_TRACE_RDMA, "Request %p needs data buffer\n", req);
+		conn->stats.pending_buf_waits++;
+		TAILQ_INSERT_TAIL(&rdma_conn->pending_data_buf_queue[rdma_req->data_buf_class],
+				  rdma_req, link);
+		spdk_nvmf_rdma_conn_buf_wait(rdma_conn, rdma_req->data_buf_class);
+		break;
+	case SPDK_NVMF_REQUEST_PREP_PENDING_DATA:
+		SPDK_TRACELOG(SPDK_TRACE_RDMA, "Request %p needs data transfer\n", req);
+		rc = spdk_nvmf_rdma_request_transfer_data(req);
+		if (rc < 0) {
+			return -1;
+		}
+		break;
+	case SPDK_NVMF_REQUEST_PREP_ERROR:
+		spdk_nvmf_rdma_request_complete(req);
+		break;
+	}
+
+	return 0;
+}
+
+/* Bind received capsules to free requests of the connection */
+static int
+spdk_nvmf_rdma_handle_pending_recvs(struct spdk_nvmf_rdma_conn *rdma_conn)
+{
+	struct spdk_nvmf_rdma_recv	*recv;
+	struct spdk_nvmf_rdma_request	*rdma_req;
+	int				rc;
+	int				count = 0;
+
+	while (!TAILQ_EMPTY(&rdma_conn->pending_recv_queue) &&
+	       !TAILQ_EMPTY(&rdma_conn->free_queue)) {
+		recv = TAILQ_FIRST(&rdma_conn->pending_recv_queue);
+		TAILQ_REMOVE(&rdma_conn->pending_recv_queue, recv, link);
+		rdma_req = TAILQ_FIRST(&rdma_conn->free_queue);
+		TAILQ_REMOVE(&rdma_conn->free_queue, rdma_req, link);
+
+		rdma_req->recv = recv;
+		rdma_req->buf = recv->buf;
+		rdma_req->req.cmd = recv->cmd;
+
+		rc = spdk_nvmf_rdma_handle_recv(&rdma_req->req);
+		if (rc < 0) {
+			return -1;
+		}
+		count += rc;
+	}
+
+	return count;
+}
+
+/*
+ * Queue a received capsule on its connection. Completions from a shared receive
+ * queue are routed to the connection whose QP received them.
+ */
+static int
+spdk_nvmf_rdma_handle_recv_wc(struct spdk_nvmf_rdma_conn *rdma_conn, struct ibv_wc *wc)
+{
+	struct spdk_nvmf_rdma_recv	*recv = (struct spdk_nvmf_rdma_recv *)wc->wr_id;
+
+	/*
+	 * Completions are reaped from the connection's own CQ, or routed to the connection by
+	 *  the poll group, so a capsule always arrives on the core that owns its connection.
+	 */
+	if (wc->qp_num != rdma_conn->cm_id->qp->qp_num) {
+		SPDK_ERRLOG("Capsule for QP %u completed on connection %p\n", wc->qp_num, rdma_conn);
+		assert(false);
+		return -1;
+	}
+
+	if (wc->byte_len < sizeof(struct spdk_nvmf_capsule_cmd)) {
+		SPDK_ERRLOG("recv length %u less than capsule header\n", wc->byte_len);
+		return -1;
+	}
+
+	TAILQ_INSERT_TAIL(&rdma_conn->pending_recv_queue, recv, link);
+
+	return spdk_nvmf_rdma_handle_pending_recvs(rdma_conn);
+}
+
 static int spdk_nvmf_rdma_poll(struct spdk_nvmf_conn *conn);
 
 static void
@@ -938,9 +2532,8 @@ spdk_nvmf_rdma_acceptor_poll(void)
 				rc = nvmf_rdma_connect(event);
 				if (rc < 0) {
 					SPDK_ERRLOG("Unable to process connect event. rc: %d\n", rc);
-					break;
 				}
-				break;
+				continue;
 			case RDMA_CM_EVENT_ESTABLISHED:
 				break;
 			case RDMA_CM_EVENT_ADDR_CHANGE:
@@ -971,49 +2564,9 @@ spdk_nvmf_rdma_acceptor_poll(void)
 static int
 spdk_nvmf_rdma_session_init(struct spdk_nvmf_session *session, struct spdk_nvmf_conn *conn)
 {
-	struct spdk_nvmf_rdma_session	*rdma_sess;
-	struct spdk_nvmf_rdma_conn	*rdma_conn = get_rdma_conn(conn);
-	int				i;
-	struct spdk_nvmf_rdma_buf	*buf;
-
-	rdma_sess = calloc(1, sizeof(*rdma_sess));
-	if (!rdma_sess) {
-		return -1;
-	}
-
-	/* TODO: Make the number of elements in this pool configurable. For now, one full queue
-	 *       worth seems reasonable.
-	 */
-	rdma_sess->buf = rte_calloc("large_buf_pool", g_rdma.max_queue_depth, g_rdma.max_io_size,
-				    0x20000);
-	if (!rdma_sess->buf) {
-		SPDK_ERRLOG("Large buffer pool allocation failed (%d x %d)\n",
-			    g_rdma.max_queue_depth, g_rdma.max_io_size);
-		free(rdma_sess);
-		return -1;
-	}
-
-	rdma_sess->buf_mr = rdma_reg_msgs(rdma_conn->cm_id, rdma_sess->buf,
-					  g_rdma.max_queue_depth * g_rdma.max_io_size);
-	if (!rdma_sess->buf_mr) {
-		SPDK_ERRLOG("Large buffer pool registration failed (%d x %d)\n",
-			    g_rdma.max_queue_depth, g_rdma.max_io_size);
-		rte_free(rdma_sess->buf);
-		free(rdma_sess);
-		return -1;
-	}
-
-	SPDK_TRACELOG(SPDK_TRACE_RDMA, "Session Shared Data Pool: %p Length: %x LKey: %x\n",
-		      rdma_sess->buf,  g_rdma.max_queue_depth * g_rdma.max_io_size, rdma_sess->buf_mr->lkey);
-
-	SLIST_INIT(&rdma_sess->data_buf_pool);
-	for (i = 0; i < g_rdma.max_queue_depth; i++) {
-		buf = (struct spdk_nvmf_rdma_buf *)(rdma_sess->buf + (i * g_rdma.max_io_size));
-		SLIST_INSERT_HEAD(&rdma_sess->data_buf_pool, buf, link);
-	}
-
+	/* Data buffers come from the transport-wide pools, so there is no per-session state */
 	session->transport = conn->transport;
-	session->trctx = rdma_sess;
+	session->trctx = NULL;
 
 	return 0;
 }
@@ -1021,16 +2574,6 @@ spdk_nvmf_rdma_session_init(struct spdk_nvmf_session *session, struct spdk_nvmf_
 static void
 spdk_nvmf_rdma_session_fini(struct spdk_nvmf_session *session)
 {
-	struct spdk_nvmf_rdma_session *rdma_sess = session->trctx;
-
-	if (!rdma_sess) {
-		return;
-	}
-
-	rdma_dereg_mr(rdma_sess->buf_mr);
-	rte_free(rdma_sess->buf);
-	free(rdma_sess);
-	session->trctx = NULL;
 }
 
 /*
@@ -1042,12 +2585,28 @@ static int
 spdk_nvmf_rdma_init(uint16_t max_queue_depth, uint32_t max_io_size,
 		    uint32_t in_capsule_data_size)
 {
+	int i;
+
 	SPDK_NOTICELOG("*** RDMA Transport Init ***\n");
 
 	pthread_mutex_lock(&g_rdma.lock);
 	g_rdma.max_queue_depth = max_queue_depth;
 	g_rdma.max_io_size = max_io_size;
 	g_rdma.in_capsule_data_size = in_capsule_data_size;
+	g_rdma.srq_depth = g_nvmf_tgt.srq_depth;
+	g_rdma.cq_depth = g_nvmf_tgt.cq_depth;
+	g_rdma.small_data_bufs = g_nvmf_tgt.small_data_bufs;
+	if (g_rdma.small_data_bufs == 0) {
+		g_rdma.small_data_bufs = NVMF_RDMA_SMALL_BUFS_PER_QUEUE_DEPTH * max_queue_depth;
+	}
+	g_rdma.large_data_bufs = g_nvmf_tgt.large_data_bufs;
+	if (g_rdma.large_data_bufs == 0) {
+		g_rdma.large_data_bufs = NVMF_RDMA_LARGE_BUFS_PER_QUEUE_DEPTH * max_queue_depth;
+	}
+	for (i = 0; i < RTE_MAX_LCORE; i++) {
+		pthread_spin_init(&g_rdma.poll_groups[i].lock, PTHREAD_PROCESS_PRIVATE);
+		TAILQ_INIT(&g_rdma.poll_groups[i].groups);
+	}
 	pthread_mutex_unlock(&g_rdma.lock);
 
 	return 0;
@@ -1057,6 +2616,9 @@ static int
 spdk_nvmf_rdma_fini(void)
 {
 	struct spdk_nvmf_rdma_listen_addr *addr, *tmp;
+	struct spdk_nvmf_rdma_buf_pool *pool;
+	struct spdk_nvmf_rdma_srq *srq, *srq_tmp;
+	int i;
 
 	pthread_mutex_lock(&g_rdma.lock);
 	TAILQ_FOREACH_SAFE(addr, &g_rdma.listen_addrs, link, tmp) {
@@ -1066,6 +2628,23 @@ spdk_nvmf_rdma_fini(void)
 	}
 
 	rdma_destroy_event_channel(g_rdma.event_channel);
+
+	/* Pools still in use are freed along with their last connection */
+	for (i = 0; i < RTE_MAX_NUMA_NODES; i++) {
+		pool = g_rdma.buf_pools[i];
+		g_rdma.buf_pools[i] = NULL;
+		if (pool != NULL && pool->refcnt == 0) {
+			spdk_nvmf_rdma_buf_pool_destroy(pool);
+		}
+	}
+
+	/* Likewise for shared receive queues */
+	TAILQ_FOREACH_SAFE(srq, &g_rdma.srqs, link, srq_tmp) {
+		TAILQ_REMOVE(&g_rdma.srqs, srq, link);
+		if (srq->refcnt == 0) {
+			spdk_nvmf_rdma_srq_destroy(srq);
+		}
+	}
 	pthread_mutex_unlock(&g_rdma.lock);
 
 	return 0;
@@ -1083,22 +2662,22 @@ static int
 spdk_nvmf_rdma_handle_pending_rdma_rw(struct spdk_nvmf_conn *conn)
 {
 	struct spdk_nvmf_rdma_conn	*rdma_conn = get_rdma_conn(conn);
-	struct spdk_nvmf_rdma_session	*rdma_sess;
 	struct spdk_nvmf_rdma_request	*rdma_req, *tmp;
+	int				buf_class;
+	bool				served;
 	int rc;
 	int count = 0;
 
 	/* First, try to assign free data buffers to requests that need one */
-	if (conn->sess) {
-		rdma_sess = conn->sess->trctx;
-		TAILQ_FOREACH_SAFE(rdma_req, &rdma_conn->pending_data_buf_queue, link, tmp) {
-			assert(rdma_req->req.data == NULL);
-			rdma_req->req.data = SLIST_FIRST(&rdma_sess->data_buf_pool);
-			if (!rdma_req->req.data) {
+	for (buf_class = 0; buf_class < NVMF_RDMA_NUM_BUF_CLASSES; buf_class++) {
+		served = false;
+		TAILQ_FOREACH_SAFE(rdma_req, &rdma_conn->pending_data_buf_queue[buf_class], link, tmp) {
+			assert(rdma_req->num_data_bufs == 0);
+			if (spdk_nvmf_rdma_request_get_bufs(rdma_conn, rdma_req) != 0) {
 				break;
 			}
-			SLIST_REMOVE_HEAD(&rdma_sess->data_buf_pool, link);
-			TAILQ_REMOVE(&rdma_conn->pending_data_buf_queue, rdma_req, link);
+			served = true;
+			TAILQ_REMOVE(&rdma_conn->pending_data_buf_queue[buf_class], rdma_req, link);
 			if (rdma_req->req.xfer == SPDK_NVME_DATA_HOST_TO_CONTROLLER) {
 				TAILQ_INSERT_TAIL(&rdma_conn->pending_rdma_rw_queue, rdma_req, link);
 			} else {
@@ -1109,6 +2688,11 @@ spdk_nvmf_rdma_handle_pending_rdma_rw(struct spdk_nvmf_conn *conn)
 				count++;
 			}
 		}
+
+		if (rdma_conn->buf_waiting[buf_class] &&
+		    (served || TAILQ_EMPTY(&rdma_conn->pending_data_buf_queue[buf_class]))) {
+			spdk_nvmf_rdma_conn_buf_wait_done(rdma_conn, buf_class);
+		}
 	}
 
 	/* Try to initiate RDMA Reads or Writes on requests that have data buffers */
@@ -1135,7 +2719,7 @@ spdk_nvmf_rdma_handle_pending_rdma_rw(struct spdk_nvmf_conn *conn)
  * or -1 on error.
  */
 static int
-spdk_nvmf_rdma_poll(struct spdk_nvmf_conn *conn)
+spdk_nvmf_rdma_process_completions(struct spdk_nvmf_conn *conn)
 {
 	struct ibv_wc wc[32];
 	struct spdk_nvmf_rdma_conn *rdma_conn = get_rdma_conn(conn);
@@ -1145,10 +2729,16 @@ spdk_nvmf_rdma_poll(struct spdk_nvmf_conn *conn)
 	int count = 0;
 
 	/* Poll for completing operations. */
-	rc = ibv_poll_cq(rdma_conn->cq, 32, wc);
+	if (rdma_conn->poll_group) {
+		rc = spdk_nvmf_rdma_conn_reap(rdma_conn, wc, 32);
+	} else {
+		rc = ibv_poll_cq(rdma_conn->cq, 32, wc);
+		if (rc < 0) {
+			SPDK_ERRLOG("Error polling CQ! (%d): %s\n",
+				    errno, strerror(errno));
+		}
+	}
 	if (rc < 0) {
-		SPDK_ERRLOG("Error polling CQ! (%d): %s\n",
-			    errno, strerror(errno));
 		return -1;
 	}
 
@@ -1160,6 +2750,15 @@ spdk_nvmf_rdma_poll(struct spdk_nvmf_conn *conn)
 			return -1;
 		}
 
+		if (wc[i].opcode == IBV_WC_RECV) {
+			rc = spdk_nvmf_rdma_handle_recv_wc(rdma_conn, &wc[i]);
+			if (rc < 0) {
+				return -1;
+			}
+			count += rc;
+			continue;
+		}
+
 		rdma_req = (struct spdk_nvmf_rdma_request *)wc[i].wr_id;
 		if (rdma_req == NULL) {
 			SPDK_ERRLOG("NULL wr_id in RDMA work completion\n");
@@ -1174,28 +2773,41 @@ spdk_nvmf_rdma_poll(struct spdk_nvmf_conn *conn)
 			SPDK_TRACELOG(SPDK_TRACE_RDMA,
 				      "RDMA SEND Complete. Request: %p Connection: %p Outstanding I/O: %d\n",
 				      req, conn, rdma_conn->cur_queue_depth - 1);
-			rc = spdk_nvmf_rdma_request_ack_completion(req);
-			if (rc) {
-				return -1;
+			if (rdma_req->recv != NULL) {
+				/* The RDMA WRITE ahead of the response read from the receive buffer */
+				nvmf_post_rdma_recv(rdma_conn, rdma_req->recv);
+				rdma_req->recv = NULL;
 			}
-			break;
 
-		case IBV_WC_RDMA_WRITE:
-			SPDK_TRACELOG(SPDK_TRACE_RDMA, "RDMA WRITE Complete. Request: %p Connection: %p\n",
-				      req, conn);
-			spdk_trace_record(TRACE_RDMA_WRITE_COMPLETE, 0, 0, (uint64_t)req, 0);
-			rc = spdk_nvmf_rdma_request_send_completion(req);
+			if (rdma_req->num_data_bufs > 0) {
+				/* Put the buffers back in the pool */
+				spdk_nvmf_rdma_request_put_bufs(rdma_conn->buf_pool, rdma_req);
+				req->data = NULL;
+				req->iovcnt = 0;
+				req->length = 0;
+			}
+
+			rc = spdk_nvmf_rdma_request_ack_completion(req);
 			if (rc) {
 				return -1;
 			}
 
-			/* Since an RDMA R/W operation completed, try to submit from the pending list. */
-			rdma_conn->cur_rdma_rw_depth--;
-			rc = spdk_nvmf_rdma_handle_pending_rdma_rw(conn);
-			if (rc < 0) {
-				return -1;
+			/* The response is out, so the request can take another capsule */
+			TAILQ_INSERT_TAIL(&rdma_conn->free_queue, rdma_req, link);
+
+			if (rdma_req->write_chained) {
+				/* The RDMA WRITE ahead of the response is complete as well */
+				rdma_req->write_chained = false;
+				spdk_trace_record(TRACE_RDMA_WRITE_COMPLETE, 0, 0, (uint64_t)req, 0);
+
+				/* Since an RDMA R/W operation completed, try to submit from the pending list. */
+				rdma_conn->cur_rdma_rw_depth--;
+				rc = spdk_nvmf_rdma_handle_pending_rdma_rw(conn);
+				if (rc < 0) {
+					return -1;
+				}
+				count += rc;
 			}
-			count += rc;
 			break;
 
 		case IBV_WC_RDMA_READ:
@@ -1217,53 +2829,48 @@ spdk_nvmf_rdma_poll(struct spdk_nvmf_conn *conn)
 			count += rc;
 			break;
 
-		case IBV_WC_RECV:
-			if (wc[i].byte_len < sizeof(struct spdk_nvmf_capsule_cmd)) {
-				SPDK_ERRLOG("recv length %u less than capsule header\n", wc[i].byte_len);
-				return -1;
-			}
-
-			rdma_conn->cur_queue_depth++;
-			SPDK_TRACELOG(SPDK_TRACE_RDMA,
-				      "RDMA RECV Complete. Request: %p Connection: %p Outstanding I/O: %d\n",
-				      req, conn, rdma_conn->cur_queue_depth);
-			spdk_trace_record(TRACE_NVMF_IO_START, 0, 0, (uint64_t)req, 0);
-
-			memset(req->rsp, 0, sizeof(*req->rsp));
-			rc = spdk_nvmf_request_prep_data(req);
-			switch (rc) {
-			case SPDK_NVMF_REQUEST_PREP_READY:
-				SPDK_TRACELOG(SPDK_TRACE_RDMA, "Request %p is ready for execution\n", req);
-				/* Data is immediately available */
-				rc = spdk_nvmf_request_exec(req);
-				if (rc < 0) {
-					return -1;
-				}
-				count++;
-				break;
-			case SPDK_NVMF_REQUEST_PREP_PENDING_BUFFER:
-				SPDK_TRACELOG(SPDK_TRACE_RDMA, "Request %p needs data buffer\n", req);
-				TAILQ_INSERT_TAIL(&rdma_conn->pending_data_buf_queue, rdma_req, link);
-				break;
-			case SPDK_NVMF_REQUEST_PREP_PENDING_DATA:
-				SPDK_TRACELOG(SPDK_TRACE_RDMA, "Request %p needs data transfer\n", req);
-				rc = spdk_nvmf_rdma_request_transfer_data(req);
-				if (rc < 0) {
-					return -1;
-				}
-				break;
-			case SPDK_NVMF_REQUEST_PREP_ERROR:
-				spdk_nvmf_rdma_request_complete(req);
-				break;
-			}
-			break;
-
 		default:
 			SPDK_ERRLOG("Received an unknown opcode on the CQ: %d\n", wc[i].opcode);
 			return -1;
 		}
 	}
 
+	/* Capsules may be waiting for the requests freed above */
+	rc = spdk_nvmf_rdma_handle_pending_recvs(rdma_conn);
+	if (rc < 0) {
+		return -1;
+	}
+	count += rc;
+
+	/* Other connections may have returned data buffers to the pool */
+	rc = spdk_nvmf_rdma_handle_pending_rdma_rw(conn);
+	if (rc < 0) {
+		return -1;
+	}
+	count += rc;
+
+	return count;
+}
+
+static int
+spdk_nvmf_rdma_poll(struct spdk_nvmf_conn *conn)
+{
+	struct spdk_nvmf_rdma_conn *rdma_conn = get_rdma_conn(conn);
+	int count;
+
+	/* Work requests queued while processing completions are posted together afterwards */
+	rdma_conn->in_poll = true;
+	count = spdk_nvmf_rdma_process_completions(conn);
+	rdma_conn->in_poll = false;
+
+	if (count < 0) {
+		return -1;
+	}
+
+	if (spdk_nvmf_rdma_conn_flush(rdma_conn)) {
+		return -1;
+	}
+
 	return count;
 }
 
@@ -1412,6 +3019,7 @@ const struct spdk_nvmf_transport spdk_nvmf_transport_rdma = {
 	.conn_fini = spdk_nvmf_rdma_close_conn,
 	.conn_poll = spdk_nvmf_rdma_poll,
 
+	.poll_group_poll = spdk_nvmf_rdma_poll_group_poll,
 
 };
 
@@ -324,6 +324,12 @@ spdk_nvmf_request_exec(struct spdk_nvmf_request *req)
 
 	nvmf_trace_command(req->cmd, req->conn->type);
 
+	if (req->iovcnt == 0 && req->data != NULL && req->length > 0) {
+		req->iov[0].iov_base = req->data;
+		req->iov[0].iov_len = req->length;
+		req->iovcnt = 1;
+	}
+
 	if (cmd->opc == SPDK_NVME_OPC_FABRIC) {
 		status = nvmf_process_fabrics_command(req);
 	} else if (session == NULL || !session->vcprop.cc.bits.en) {
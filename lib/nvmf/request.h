@@ -34,9 +34,14 @@
 #ifndef NVMF_REQUEST_H
 #define NVMF_REQUEST_H
 
+#include <sys/uio.h>
+
 #include "spdk/nvmf_spec.h"
 #include "spdk/queue.h"
 
+/* Maximum number of buffers a transport may spread one request's data across */
+#define SPDK_NVMF_MAX_SGL_ENTRIES	16
+
 typedef enum _spdk_nvmf_request_exec_status {
 	SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE,
 	SPDK_NVMF_REQUEST_EXEC_STATUS_RELEASE,
@@ -63,9 +68,22 @@ struct spdk_nvmf_request {
 	struct spdk_nvmf_conn		*conn;
 	uint32_t			length;
 	enum spdk_nvme_data_transfer	xfer;
+
+	/* Set only when the data is contiguous, otherwise NULL */
 	void				*data;
+
+	/*
+	 * The data buffers. A transport that places the data in a single buffer may
+	 * leave iovcnt at 0, and spdk_nvmf_request_exec() describes data instead.
+	 */
+	struct iovec			iov[SPDK_NVMF_MAX_SGL_ENTRIES];
+	int				iovcnt;
+
 	union nvmf_h2c_msg		*cmd;
 	union nvmf_c2h_msg		*rsp;
+
+	/* spdk_get_ticks() when the command capsule was received */
+	uint64_t			arrival_tsc;
 };
 
 int
@@ -104,8 +104,7 @@ nvmf_init_nvme_session_properties(struct spdk_nvmf_session *session)
 	session->vcdata.nvmf_specific.ctrattr.ctrlr_model = SPDK_NVMF_CTRLR_MODEL_DYNAMIC;
 	session->vcdata.nvmf_specific.msdbd = 1; /* target supports single SGL in capsule */
 
-	/* TODO: this should be set by the transport */
-	session->vcdata.nvmf_specific.ioccsz += g_nvmf_tgt.in_capsule_data_size / 16;
+	session->vcdata.nvmf_specific.ioccsz += session->subsys->in_capsule_data_size / 16;
 
 	strncpy((char *)session->vcdata.subnqn, session->subsys->subnqn, sizeof(session->vcdata.subnqn));
 
@@ -326,7 +325,7 @@ spdk_nvmf_session_connect(struct spdk_nvmf_conn *conn,
 	conn->sess = session;
 
 	rsp->status.sc = SPDK_NVME_SC_SUCCESS;
-	rsp->status_code_specific.success.cntlid = 0;
+	rsp->status_code_specific.success.cntlid = session->id;
 	SPDK_TRACELOG(SPDK_TRACE_NVMF, "connect capsule response: cntlid = 0x%04x\n",
 		      rsp->status_code_specific.success.cntlid);
 }
@@ -339,6 +338,8 @@ spdk_nvmf_session_disconnect(struct spdk_nvmf_conn *conn)
 	assert(session != NULL);
 	session->num_connections--;
 	TAILQ_REMOVE(&session->connections, conn, link);
+	spdk_nvmf_latency_histogram_merge(&session->subsys->closed_conn_latency,
+					  &conn->stats.latency);
 	conn->transport->conn_fini(conn);
 
 	if (session->num_connections == 0) {
@@ -560,6 +561,11 @@ spdk_nvmf_session_poll(struct spdk_nvmf_session *session)
 	struct spdk_nvmf_conn	*conn, *tmp;
 
 	TAILQ_FOREACH_SAFE(conn, &session->connections, link, tmp) {
+		if (conn->scheduled) {
+			/* Polled on its own core */
+			continue;
+		}
+
 		if (conn->transport->conn_poll(conn) < 0) {
 			SPDK_ERRLOG("Transport poll failed for conn %p; closing connection\n", conn);
 			spdk_nvmf_session_disconnect(conn);
@@ -37,6 +37,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "nvmf_internal.h"
+
+#include "spdk/env.h"
 #include "spdk/nvmf_spec.h"
 #include "spdk/queue.h"
 
@@ -44,12 +47,42 @@
 #define MAX_SESSION_IO_QUEUES 64
 
 struct spdk_nvmf_transport;
+struct spdk_io_channel;
+struct spdk_poller;
 
 enum conn_type {
 	CONN_TYPE_AQ = 0,
 	CONN_TYPE_IOQ = 1,
 };
 
+/*
+ * Statistics of a connection. The transport updates them on the core polling
+ * the connection; the get_nvmf_stats RPC reads them without synchronization.
+ */
+struct spdk_nvmf_conn_stats {
+	/* Command capsules received */
+	uint64_t				capsules;
+
+	/* Writes whose data arrived in the capsule, and writes transferred separately */
+	uint64_t				in_capsule_writes;
+	uint64_t				transferred_writes;
+
+	/* Data transferred outside of capsules (RDMA READ and RDMA WRITE for RDMA) */
+	uint64_t				host_to_ctrlr_bytes;
+	uint64_t				ctrlr_to_host_bytes;
+
+	/* Requests that had to wait for a data buffer or for a free RDMA READ/WRITE slot */
+	uint64_t				pending_buf_waits;
+	uint64_t				pending_xfer_waits;
+
+	/* Requests received and not yet finished */
+	uint32_t				queue_depth;
+	uint32_t				peak_queue_depth;
+
+	/* Time from capsule arrival to completion send of I/O queue commands */
+	struct spdk_nvmf_latency_histogram	latency;
+};
+
 struct spdk_nvmf_conn {
 	const struct spdk_nvmf_transport	*transport;
 	struct spdk_nvmf_session		*sess;
@@ -58,9 +91,59 @@ struct spdk_nvmf_conn {
 	uint16_t				sq_head;
 	uint16_t				sq_head_max;
 
+	/*
+	 * I/O queues may be scheduled onto a core other than the one that owns
+	 * their session. A scheduled connection is polled by its own poller on
+	 * lcore, submits I/O through its own channels and is skipped by
+	 * spdk_nvmf_session_poll().
+	 */
+	bool					scheduled;
+	bool					stopping;
+	uint32_t				lcore;
+
+	/*
+	 * Set by the transport when the connection's completions are reaped on
+	 * lcore, so that the connection scheduler keeps it there.
+	 */
+	bool					lcore_preferred;
+	struct spdk_poller			*poller;
+	struct spdk_io_channel			*ch[MAX_VIRTUAL_NAMESPACE];
+
+	struct spdk_nvmf_conn_stats		stats;
+
 	TAILQ_ENTRY(spdk_nvmf_conn) 		link;
 };
 
+/* Account a command capsule received on conn. Returns its arrival time. */
+static inline uint64_t
+spdk_nvmf_conn_stats_capsule(struct spdk_nvmf_conn *conn)
+{
+	conn->stats.capsules++;
+	conn->stats.queue_depth++;
+	if (conn->stats.queue_depth > conn->stats.peak_queue_depth) {
+		conn->stats.peak_queue_depth = conn->stats.queue_depth;
+	}
+
+	return spdk_get_ticks();
+}
+
+/* Account the completion of a request that arrived at arrival_tsc being sent */
+static inline void
+spdk_nvmf_conn_stats_completion(struct spdk_nvmf_conn *conn, uint64_t arrival_tsc)
+{
+	if (conn->type == CONN_TYPE_IOQ) {
+		spdk_nvmf_latency_histogram_add(&conn->stats.latency,
+						spdk_get_ticks() - arrival_tsc);
+	}
+}
+
+/* Account a request of conn being finished, whether or not a completion was sent */
+static inline void
+spdk_nvmf_conn_stats_done(struct spdk_nvmf_conn *conn)
+{
+	conn->stats.queue_depth--;
+}
+
 /*
  * This structure maintains the NVMf virtual controller session
  * state. Each NVMf session permits some number of connections.
@@ -82,6 +165,7 @@ struct spdk_nvmf_session {
 	int num_connections;
 	int max_connections_allowed;
 	uint32_t kato;
+	uint32_t async_event_config;
 	const struct spdk_nvmf_transport	*transport;
 
 	/* This is filled in by calling the transport's
@@ -134,6 +134,7 @@ spdk_nvmf_create_subsystem(int num, const char *name,
 
 	subsystem->num = num;
 	subsystem->subtype = subtype;
+	subsystem->in_capsule_data_size = g_nvmf_tgt.in_capsule_data_size;
 	subsystem->cb_ctx = cb_ctx;
 	subsystem->connect_cb = connect_cb;
 	subsystem->disconnect_cb = disconnect_cb;
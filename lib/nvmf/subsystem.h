@@ -45,7 +45,6 @@ struct spdk_nvmf_subsystem;
 struct spdk_nvmf_request;
 struct spdk_nvmf_session;
 
-#define MAX_VIRTUAL_NAMESPACE 16
 #define MAX_SN_LEN 20
 
 enum spdk_nvmf_subsystem_mode {
@@ -106,6 +105,8 @@ struct spdk_nvmf_subsystem {
 	char subnqn[SPDK_NVMF_NQN_MAX_LEN];
 	enum spdk_nvmf_subsystem_mode mode;
 	enum spdk_nvmf_subtype subtype;
+	/* In capsule data size advertised to and accepted from hosts on I/O queues */
+	uint32_t in_capsule_data_size;
 
 	union {
 		struct {
@@ -119,6 +120,8 @@ struct spdk_nvmf_subsystem {
 			struct spdk_bdev *ns_list[MAX_VIRTUAL_NAMESPACE];
 			struct spdk_io_channel *ch[MAX_VIRTUAL_NAMESPACE];
 			uint16_t ns_count;
+			/** write stream used for data written by hosts, 0 for none */
+			uint16_t write_stream;
 		} virt;
 	} dev;
 
@@ -131,6 +134,9 @@ struct spdk_nvmf_subsystem {
 	TAILQ_HEAD(, spdk_nvmf_session)		sessions;
 	uint32_t				session_id;
 
+	/* I/O latency of connections that have been closed */
+	struct spdk_nvmf_latency_histogram	closed_conn_latency;
+
 	TAILQ_HEAD(, spdk_nvmf_listen_addr)	listen_addrs;
 	uint32_t				num_listen_addrs;
 
@@ -0,0 +1,1742 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/uio.h>
+
+#include <rte_config.h>
+#include <rte_malloc.h>
+
+#include "nvmf_internal.h"
+#include "request.h"
+#include "session.h"
+#include "subsystem.h"
+#include "transport.h"
+#include "spdk/assert.h"
+#include "spdk/crc32.h"
+#include "spdk/log.h"
+#include "spdk/net.h"
+#include "spdk/nvmf_spec.h"
+#include "spdk/string.h"
+#include "spdk/trace.h"
+
+/*
+ TCP Connection Resource Defaults
+ */
+/* Largest PDU header we send or receive: ICReq/ICResp, or a data PDU header padded to HPDA */
+#define NVMF_TCP_PDU_MAX_HDR_SIZE		128
+#define NVMF_TCP_RECV_BUF_SIZE			(64 * 1024)
+#define NVMF_TCP_MAX_IOVS			64
+
+/* Payloads at least this large are received directly into the request's data buffer */
+#define NVMF_TCP_DIRECT_RECV_THRESHOLD		4096
+
+/* Hosts send up to 8 KiB of in-capsule data on the admin queue regardless of IOCCSZ */
+#define NVMF_TCP_ADMIN_IN_CAPSULE_DATA_SIZE	8192
+
+struct spdk_nvmf_tcp_buf {
+	SLIST_ENTRY(spdk_nvmf_tcp_buf) link;
+};
+
+struct spdk_nvmf_tcp_request;
+
+/* A PDU queued for transmission */
+struct spdk_nvmf_tcp_pdu {
+	/* PDU header, followed by the header digest and padding up to the data offset */
+	uint8_t					hdr[NVMF_TCP_PDU_MAX_HDR_SIZE];
+	uint32_t				hdr_len;
+
+	void					*data;
+	uint32_t				data_len;
+
+	/* Data digest, sent after the data when ddgst_len is not 0 */
+	uint32_t				ddgst;
+	uint32_t				ddgst_len;
+
+	/* Number of bytes of this PDU already written to the socket */
+	uint32_t				written;
+
+	/* Request to free once this PDU has been written */
+	struct spdk_nvmf_tcp_request		*tcp_req;
+
+	TAILQ_ENTRY(spdk_nvmf_tcp_pdu)		link;
+};
+
+enum spdk_nvmf_tcp_request_state {
+	NVMF_TCP_REQUEST_STATE_FREE = 0,
+	NVMF_TCP_REQUEST_STATE_NEED_BUFFER,
+	NVMF_TCP_REQUEST_STATE_TRANSFERRING_H2C,
+	NVMF_TCP_REQUEST_STATE_EXECUTING,
+	/* The response is queued and the request is freed once it has been written */
+	NVMF_TCP_REQUEST_STATE_TRANSFERRING_C2H,
+};
+
+struct spdk_nvmf_tcp_request {
+	struct spdk_nvmf_request		req;
+	union nvmf_h2c_msg			cmd;
+	union nvmf_c2h_msg			rsp;
+
+	enum spdk_nvmf_tcp_request_state	state;
+
+	/* Transfer tag sent in R2T PDUs; the index of this request in the connection */
+	uint16_t				ttag;
+
+	/* In Capsule data buffer, and the number of bytes of in-capsule data received */
+	uint8_t					*buf;
+	uint32_t				in_capsule_data_len;
+
+	/* Buffer taken from the session's pool, or NULL */
+	struct spdk_nvmf_tcp_buf		*pool_buf;
+
+	/* Bytes of host to controller data received so far */
+	uint32_t				h2c_offset;
+	bool					h2c_dgst_error;
+
+	/* R2T or C2HData PDU */
+	struct spdk_nvmf_tcp_pdu		data_pdu;
+	struct spdk_nvmf_tcp_pdu		rsp_pdu;
+
+	TAILQ_ENTRY(spdk_nvmf_tcp_request)	link;
+};
+
+enum spdk_nvmf_tcp_recv_state {
+	/* Waiting for the 8 byte common header */
+	NVMF_TCP_RECV_STATE_CH = 0,
+	/* Waiting for the rest of the PDU header and its digest */
+	NVMF_TCP_RECV_STATE_PSH,
+	/* Skipping padding up to the data offset */
+	NVMF_TCP_RECV_STATE_PAD,
+	NVMF_TCP_RECV_STATE_DATA,
+	NVMF_TCP_RECV_STATE_DDGST,
+};
+
+/* The PDU currently being received */
+struct spdk_nvmf_tcp_recv_pdu {
+	enum spdk_nvmf_tcp_recv_state		state;
+
+	union {
+		uint8_t					raw[NVMF_TCP_PDU_MAX_HDR_SIZE +
+							    SPDK_NVME_TCP_DIGEST_LEN];
+		struct spdk_nvme_tcp_common_pdu_hdr	common;
+		struct spdk_nvme_tcp_ic_req		ic_req;
+		struct spdk_nvme_tcp_cmd		capsule_cmd;
+		struct spdk_nvme_tcp_h2c_data_hdr	h2c_data;
+		struct spdk_nvme_tcp_term_req_hdr	term_req;
+	} hdr;
+
+	/* Destination of the current state's bytes (NULL to discard them) */
+	uint8_t					*dest;
+	uint32_t				need;
+	uint32_t				got;
+
+	uint32_t				pad_len;
+	uint32_t				data_len;
+	uint8_t					*data_dest;
+	bool					has_ddgst;
+	uint32_t				ddgst;
+	uint32_t				crc;
+
+	struct spdk_nvmf_tcp_request		*tcp_req;
+};
+
+struct spdk_nvmf_tcp_conn {
+	struct spdk_nvmf_conn			conn;
+
+	int					sock;
+
+	/* True while the connection is polled by the acceptor, waiting for a CONNECT */
+	bool					pending;
+
+	/* Connection parameters negotiated by ICReq/ICResp */
+	bool					ic_done;
+	bool					hdgst_enable;
+	bool					ddgst_enable;
+	/* Host PDU data alignment, in bytes */
+	uint32_t				hpda_bytes;
+
+	/* The maximum number of I/O outstanding on this connection at one time */
+	uint16_t				max_queue_depth;
+
+	/* The current number of I/O outstanding on this connection. This number
+	 * includes all I/O from the time the capsule is first received until its
+	 * response has been written to the socket.
+	 */
+	uint16_t				cur_queue_depth;
+
+	/* Size of each request's in capsule data buffer */
+	uint32_t				in_capsule_buf_size;
+
+	/* Array of size "max_queue_depth" containing TCP requests. */
+	struct spdk_nvmf_tcp_request		*reqs;
+
+	/* Array of size "max_queue_depth * in_capsule_buf_size" containing
+	 * buffers to be used for in capsule data.
+	 */
+	void					*bufs;
+
+	TAILQ_HEAD(, spdk_nvmf_tcp_request)	free_queue;
+
+	/* Requests that are waiting to obtain a data buffer */
+	TAILQ_HEAD(, spdk_nvmf_tcp_request)	pending_data_buf_queue;
+
+	/* Bytes read from the socket but not yet parsed */
+	uint8_t					*recv_buf;
+	uint32_t				recv_len;
+	uint32_t				recv_offset;
+
+	struct spdk_nvmf_tcp_recv_pdu		recv_pdu;
+
+	/* PDUs waiting to be written to the socket, in order */
+	TAILQ_HEAD(, spdk_nvmf_tcp_pdu)		send_queue;
+
+	struct spdk_nvmf_tcp_pdu		ic_resp_pdu;
+	struct spdk_nvmf_tcp_pdu		term_req_pdu;
+	uint8_t					term_req_data[NVMF_TCP_PDU_MAX_HDR_SIZE];
+
+	/*
+	 * One reference while the connection is open, plus one for each executing request.
+	 *  Requests complete on the connection's core while it is closed on the subsystem's,
+	 *  so the connection is freed when the last reference is dropped.
+	 */
+	uint32_t				refcnt;
+	bool					closing;
+
+	/* Session whose data buffers the requests of a closed connection hold */
+	struct spdk_nvmf_tcp_session		*tcp_sess;
+
+	TAILQ_ENTRY(spdk_nvmf_tcp_conn)		link;
+};
+
+/* List of TCP connections that have not yet received a CONNECT capsule */
+static TAILQ_HEAD(, spdk_nvmf_tcp_conn) g_pending_conns = TAILQ_HEAD_INITIALIZER(g_pending_conns);
+
+struct spdk_nvmf_tcp_session {
+	/* Shared by all I/O queues of the session, which may be polled on different cores */
+	pthread_spinlock_t			lock;
+	SLIST_HEAD(, spdk_nvmf_tcp_buf)		data_buf_pool;
+
+	uint8_t					*buf;
+
+	/* Held by the session and by each closed connection whose requests still execute */
+	uint32_t				refcnt;
+};
+
+struct spdk_nvmf_tcp_listen_addr {
+	char					*traddr;
+	char					*trsvcid;
+	int					sock;
+	TAILQ_ENTRY(spdk_nvmf_tcp_listen_addr)	link;
+};
+
+struct spdk_nvmf_tcp {
+	pthread_mutex_t 		lock;
+
+	uint16_t 			max_queue_depth;
+	uint32_t 			max_io_size;
+	uint32_t 			in_capsule_data_size;
+
+	/* Number of max_io_size data buffers in the pool of each session */
+	uint32_t			sess_data_bufs;
+
+	TAILQ_HEAD(, spdk_nvmf_tcp_listen_addr)	listen_addrs;
+};
+
+static struct spdk_nvmf_tcp g_tcp = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.listen_addrs = TAILQ_HEAD_INITIALIZER(g_tcp.listen_addrs),
+};
+
+typedef enum _spdk_nvmf_request_prep_type {
+	SPDK_NVMF_REQUEST_PREP_ERROR = -1,
+	SPDK_NVMF_REQUEST_PREP_READY = 0,
+	SPDK_NVMF_REQUEST_PREP_PENDING_BUFFER = 1,
+	SPDK_NVMF_REQUEST_PREP_PENDING_DATA = 2,
+} spdk_nvmf_request_prep_type;
+
+static struct spdk_nvmf_tcp_buf *
+spdk_nvmf_tcp_session_get_buf(struct spdk_nvmf_tcp_session *tcp_sess)
+{
+	struct spdk_nvmf_tcp_buf *buf;
+
+	pthread_spin_lock(&tcp_sess->lock);
+	buf = SLIST_FIRST(&tcp_sess->data_buf_pool);
+	if (buf != NULL) {
+		SLIST_REMOVE_HEAD(&tcp_sess->data_buf_pool, link);
+	}
+	pthread_spin_unlock(&tcp_sess->lock);
+
+	return buf;
+}
+
+static void
+spdk_nvmf_tcp_session_put_buf(struct spdk_nvmf_tcp_session *tcp_sess, struct spdk_nvmf_tcp_buf *buf)
+{
+	pthread_spin_lock(&tcp_sess->lock);
+	SLIST_INSERT_HEAD(&tcp_sess->data_buf_pool, buf, link);
+	pthread_spin_unlock(&tcp_sess->lock);
+}
+
+static void
+spdk_nvmf_tcp_session_put(struct spdk_nvmf_tcp_session *tcp_sess)
+{
+	if (__sync_sub_and_fetch(&tcp_sess->refcnt, 1) != 0) {
+		return;
+	}
+
+	pthread_spin_destroy(&tcp_sess->lock);
+	rte_free(tcp_sess->buf);
+	free(tcp_sess);
+}
+
+static inline struct spdk_nvmf_tcp_conn *
+get_tcp_conn(struct spdk_nvmf_conn *conn)
+{
+	return (struct spdk_nvmf_tcp_conn *)((uintptr_t)conn - offsetof(struct spdk_nvmf_tcp_conn, conn));
+}
+
+static inline struct spdk_nvmf_tcp_request *
+get_tcp_req(struct spdk_nvmf_request *req)
+{
+	return (struct spdk_nvmf_tcp_request *)((uintptr_t)req - offsetof(struct spdk_nvmf_tcp_request,
+			req));
+}
+
+/* NVMe/TCP digests are the standard CRC-32C: seeded with and finalized by inverting all bits */
+static inline uint32_t
+nvmf_tcp_digest(const void *buf, size_t len)
+{
+	return ~spdk_crc32c_update(buf, len, ~0u);
+}
+
+static void
+spdk_nvmf_tcp_conn_destroy(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	struct spdk_nvmf_tcp_request	*tcp_req;
+	int				i;
+
+	if (tcp_conn->sock >= 0) {
+		spdk_sock_close(tcp_conn->sock);
+	}
+
+	if (tcp_conn->tcp_sess) {
+		/* Return the data buffers of requests that never got to send their response */
+		for (i = 0; i < tcp_conn->max_queue_depth; i++) {
+			tcp_req = &tcp_conn->reqs[i];
+			if (tcp_req->pool_buf) {
+				spdk_nvmf_tcp_session_put_buf(tcp_conn->tcp_sess, tcp_req->pool_buf);
+				tcp_req->pool_buf = NULL;
+			}
+		}
+		spdk_nvmf_tcp_session_put(tcp_conn->tcp_sess);
+	}
+
+	free(tcp_conn->recv_buf);
+	rte_free(tcp_conn->bufs);
+	free(tcp_conn->reqs);
+	free(tcp_conn);
+}
+
+/* Drop a reference to the connection, and free it if it was closed and nothing else holds it. */
+static void
+spdk_nvmf_tcp_conn_put(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	if (__sync_sub_and_fetch(&tcp_conn->refcnt, 1) == 0) {
+		spdk_nvmf_tcp_conn_destroy(tcp_conn);
+	}
+}
+
+static struct spdk_nvmf_tcp_conn *
+spdk_nvmf_tcp_conn_create(int sock)
+{
+	struct spdk_nvmf_tcp_conn	*tcp_conn;
+	struct spdk_nvmf_tcp_request	*tcp_req;
+	int				flags, i;
+
+	tcp_conn = calloc(1, sizeof(struct spdk_nvmf_tcp_conn));
+	if (tcp_conn == NULL) {
+		SPDK_ERRLOG("Could not allocate new connection.\n");
+		return NULL;
+	}
+
+	tcp_conn->sock = sock;
+	tcp_conn->refcnt = 1;
+	tcp_conn->max_queue_depth = g_tcp.max_queue_depth;
+	tcp_conn->in_capsule_buf_size = g_tcp.in_capsule_data_size;
+	if (tcp_conn->in_capsule_buf_size < NVMF_TCP_ADMIN_IN_CAPSULE_DATA_SIZE) {
+		tcp_conn->in_capsule_buf_size = NVMF_TCP_ADMIN_IN_CAPSULE_DATA_SIZE;
+	}
+	TAILQ_INIT(&tcp_conn->free_queue);
+	TAILQ_INIT(&tcp_conn->pending_data_buf_queue);
+	TAILQ_INIT(&tcp_conn->send_queue);
+
+	flags = fcntl(sock, F_GETFL);
+	if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+		SPDK_ERRLOG("fcntl to set socket to non-blocking failed\n");
+		spdk_nvmf_tcp_conn_destroy(tcp_conn);
+		return NULL;
+	}
+
+	tcp_conn->reqs = calloc(tcp_conn->max_queue_depth, sizeof(*tcp_conn->reqs));
+	tcp_conn->bufs = rte_calloc("nvmf_tcp_in_capsule_bufs", tcp_conn->max_queue_depth,
+				    tcp_conn->in_capsule_buf_size, 0x1000);
+	tcp_conn->recv_buf = malloc(NVMF_TCP_RECV_BUF_SIZE);
+	if (!tcp_conn->reqs || !tcp_conn->bufs || !tcp_conn->recv_buf) {
+		SPDK_ERRLOG("Unable to allocate sufficient memory for TCP connection.\n");
+		spdk_nvmf_tcp_conn_destroy(tcp_conn);
+		return NULL;
+	}
+
+	for (i = 0; i < tcp_conn->max_queue_depth; i++) {
+		tcp_req = &tcp_conn->reqs[i];
+		tcp_req->buf = (void *)((uintptr_t)tcp_conn->bufs + (i * tcp_conn->in_capsule_buf_size));
+		tcp_req->ttag = i;
+		tcp_req->req.conn = &tcp_conn->conn;
+		tcp_req->req.cmd = &tcp_req->cmd;
+		tcp_req->req.rsp = &tcp_req->rsp;
+		TAILQ_INSERT_TAIL(&tcp_conn->free_queue, tcp_req, link);
+	}
+
+	tcp_conn->conn.transport = &spdk_nvmf_transport_tcp;
+	tcp_conn->recv_pdu.state = NVMF_TCP_RECV_STATE_CH;
+	tcp_conn->recv_pdu.dest = tcp_conn->recv_pdu.hdr.raw;
+	tcp_conn->recv_pdu.need = sizeof(struct spdk_nvme_tcp_common_pdu_hdr);
+
+	return tcp_conn;
+}
+
+/*
+
+Transmit path.  PDUs are queued on the connection and written out in batches by
+spdk_nvmf_tcp_conn_flush(), normally once at the end of each poll.
+
+*/
+
+static inline void
+nvmf_tcp_pdu_init(struct spdk_nvmf_tcp_pdu *pdu, enum spdk_nvme_tcp_pdu_type pdu_type,
+		  uint32_t hlen)
+{
+	struct spdk_nvme_tcp_common_pdu_hdr *common = (struct spdk_nvme_tcp_common_pdu_hdr *)pdu->hdr;
+
+	memset(pdu->hdr, 0, hlen);
+	common->pdu_type = pdu_type;
+	common->hlen = hlen;
+	pdu->hdr_len = hlen;
+	pdu->data = NULL;
+	pdu->data_len = 0;
+	pdu->ddgst_len = 0;
+	pdu->written = 0;
+	pdu->tcp_req = NULL;
+}
+
+/* Add the digests and padding, fill in the PDU length and queue the PDU for sending. */
+static void
+nvmf_tcp_pdu_queue(struct spdk_nvmf_tcp_conn *tcp_conn, struct spdk_nvmf_tcp_pdu *pdu,
+		   bool digests)
+{
+	struct spdk_nvme_tcp_common_pdu_hdr *common = (struct spdk_nvme_tcp_common_pdu_hdr *)pdu->hdr;
+	uint32_t hlen = common->hlen;
+	uint32_t pdo, crc;
+
+	if (digests && tcp_conn->hdgst_enable) {
+		common->flags |= SPDK_NVME_TCP_CH_FLAGS_HDGSTF;
+		pdu->hdr_len += SPDK_NVME_TCP_DIGEST_LEN;
+	}
+
+	if (pdu->data_len > 0) {
+		/* Pad the header so that the data starts at the host's requested alignment */
+		if (tcp_conn->hpda_bytes > 1) {
+			pdo = (pdu->hdr_len + tcp_conn->hpda_bytes - 1) / tcp_conn->hpda_bytes *
+			      tcp_conn->hpda_bytes;
+			assert(pdo <= NVMF_TCP_PDU_MAX_HDR_SIZE);
+			memset(&pdu->hdr[pdu->hdr_len], 0, pdo - pdu->hdr_len);
+			pdu->hdr_len = pdo;
+		}
+		common->pdo = pdu->hdr_len;
+
+		if (digests && tcp_conn->ddgst_enable) {
+			common->flags |= SPDK_NVME_TCP_CH_FLAGS_DDGSTF;
+			pdu->ddgst = nvmf_tcp_digest(pdu->data, pdu->data_len);
+			pdu->ddgst_len = SPDK_NVME_TCP_DIGEST_LEN;
+		}
+	}
+
+	common->plen = pdu->hdr_len + pdu->data_len + pdu->ddgst_len;
+
+	/* The header digest covers the final header, so it is computed last */
+	if (common->flags & SPDK_NVME_TCP_CH_FLAGS_HDGSTF) {
+		crc = nvmf_tcp_digest(pdu->hdr, hlen);
+		memcpy(&pdu->hdr[hlen], &crc, sizeof(crc));
+	}
+
+	TAILQ_INSERT_TAIL(&tcp_conn->send_queue, pdu, link);
+}
+
+static void spdk_nvmf_tcp_request_free(struct spdk_nvmf_tcp_request *tcp_req);
+
+/* Append the unwritten parts of a PDU to an iovec array.  Returns the new iovec count. */
+static int
+nvmf_tcp_pdu_get_iovs(struct spdk_nvmf_tcp_pdu *pdu, struct iovec *iovs, int iovcnt)
+{
+	struct {
+		void		*base;
+		uint32_t	len;
+	} seg[3] = {
+		{ pdu->hdr, pdu->hdr_len },
+		{ pdu->data, pdu->data_len },
+		{ &pdu->ddgst, pdu->ddgst_len },
+	};
+	uint32_t skip = pdu->written;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		if (skip >= seg[i].len) {
+			skip -= seg[i].len;
+			continue;
+		}
+		iovs[iovcnt].iov_base = (uint8_t *)seg[i].base + skip;
+		iovs[iovcnt].iov_len = seg[i].len - skip;
+		iovcnt++;
+		skip = 0;
+	}
+
+	return iovcnt;
+}
+
+/* Write as many queued PDUs as the socket accepts.  Returns 0, or -1 on error. */
+static int
+spdk_nvmf_tcp_conn_flush(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	struct iovec		iovs[NVMF_TCP_MAX_IOVS];
+	struct spdk_nvmf_tcp_pdu *pdu;
+	size_t			total;
+	ssize_t			rc;
+	uint32_t		remaining, pdu_len;
+	int			iovcnt, i;
+
+	while (!TAILQ_EMPTY(&tcp_conn->send_queue)) {
+		/* Gather as many PDUs as fit in one writev() */
+		iovcnt = 0;
+		TAILQ_FOREACH(pdu, &tcp_conn->send_queue, link) {
+			if (iovcnt > NVMF_TCP_MAX_IOVS - 3) {
+				break;
+			}
+			iovcnt = nvmf_tcp_pdu_get_iovs(pdu, iovs, iovcnt);
+		}
+
+		total = 0;
+		for (i = 0; i < iovcnt; i++) {
+			total += iovs[i].iov_len;
+		}
+
+		rc = spdk_sock_writev(tcp_conn->sock, iovs, iovcnt);
+		if (rc < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return 0;
+			}
+			SPDK_ERRLOG("writev() failed on connection %p: %s\n", tcp_conn, strerror(errno));
+			return -1;
+		}
+
+		/* Retire the PDUs that were completely written */
+		remaining = rc;
+		while ((pdu = TAILQ_FIRST(&tcp_conn->send_queue)) != NULL) {
+			pdu_len = pdu->hdr_len + pdu->data_len + pdu->ddgst_len;
+			if (remaining < pdu_len - pdu->written) {
+				pdu->written += remaining;
+				break;
+			}
+
+			remaining -= pdu_len - pdu->written;
+			TAILQ_REMOVE(&tcp_conn->send_queue, pdu, link);
+			if (pdu->tcp_req) {
+				spdk_nvmf_tcp_request_free(pdu->tcp_req);
+			}
+		}
+
+		if ((size_t)rc < total) {
+			/* The socket buffer is full */
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/* Send a C2HTermReq carrying the offending PDU header.  The connection is closed afterwards. */
+static void
+spdk_nvmf_tcp_send_term_req(struct spdk_nvmf_tcp_conn *tcp_conn,
+			    enum spdk_nvme_tcp_term_req_fes fes, uint32_t fei)
+{
+	struct spdk_nvmf_tcp_recv_pdu *recv_pdu = &tcp_conn->recv_pdu;
+	struct spdk_nvmf_tcp_pdu *pdu = &tcp_conn->term_req_pdu;
+	struct spdk_nvme_tcp_term_req_hdr *term_req;
+	uint32_t copy_len;
+
+	SPDK_ERRLOG("Terminating TCP connection %p: fes 0x%x fei 0x%x\n", tcp_conn, fes, fei);
+
+	/* Only send back the part of the header that was actually received */
+	if (recv_pdu->state == NVMF_TCP_RECV_STATE_CH) {
+		copy_len = recv_pdu->got;
+	} else if (recv_pdu->state == NVMF_TCP_RECV_STATE_PSH) {
+		copy_len = sizeof(struct spdk_nvme_tcp_common_pdu_hdr) + recv_pdu->got;
+	} else {
+		copy_len = recv_pdu->hdr.common.hlen;
+	}
+	if (copy_len > recv_pdu->hdr.common.hlen) {
+		copy_len = recv_pdu->hdr.common.hlen;
+	}
+	if (copy_len > sizeof(tcp_conn->term_req_data)) {
+		copy_len = sizeof(tcp_conn->term_req_data);
+	}
+	memcpy(tcp_conn->term_req_data, recv_pdu->hdr.raw, copy_len);
+
+	nvmf_tcp_pdu_init(pdu, SPDK_NVME_TCP_PDU_TYPE_C2H_TERM_REQ,
+			  sizeof(struct spdk_nvme_tcp_term_req_hdr));
+	term_req = (struct spdk_nvme_tcp_term_req_hdr *)pdu->hdr;
+	term_req->fes = fes;
+	term_req->fei = fei;
+	pdu->data = tcp_conn->term_req_data;
+	pdu->data_len = copy_len;
+
+	/* TermReq PDUs never carry digests, and their data directly follows the header */
+	term_req->common.plen = pdu->hdr_len + pdu->data_len;
+	TAILQ_INSERT_TAIL(&tcp_conn->send_queue, pdu, link);
+
+	spdk_nvmf_tcp_conn_flush(tcp_conn);
+}
+
+/*
+
+Request completion.  For a successful read, a C2HData PDU carrying the data is
+queued ahead of the response capsule.  The request is freed once its response
+capsule has been written to the socket.
+
+*/
+
+static void
+spdk_nvmf_tcp_request_free(struct spdk_nvmf_tcp_request *tcp_req)
+{
+	struct spdk_nvmf_conn		*conn = tcp_req->req.conn;
+	struct spdk_nvmf_tcp_conn	*tcp_conn = get_tcp_conn(conn);
+	struct spdk_nvmf_tcp_session	*tcp_sess;
+
+	if (tcp_req->pool_buf) {
+		/* Put the buffer back in the pool */
+		tcp_sess = conn->sess->trctx;
+		spdk_nvmf_tcp_session_put_buf(tcp_sess, tcp_req->pool_buf);
+		tcp_req->pool_buf = NULL;
+	}
+
+	tcp_req->req.data = NULL;
+	tcp_req->req.iovcnt = 0;
+	tcp_req->req.length = 0;
+	tcp_req->state = NVMF_TCP_REQUEST_STATE_FREE;
+
+	assert(tcp_conn->cur_queue_depth > 0);
+	tcp_conn->cur_queue_depth--;
+	spdk_nvmf_conn_stats_done(conn);
+	TAILQ_INSERT_TAIL(&tcp_conn->free_queue, tcp_req, link);
+}
+
+static void
+spdk_nvmf_tcp_send_r2t(struct spdk_nvmf_tcp_request *tcp_req)
+{
+	struct spdk_nvmf_tcp_conn	*tcp_conn = get_tcp_conn(tcp_req->req.conn);
+	struct spdk_nvmf_tcp_pdu	*pdu = &tcp_req->data_pdu;
+	struct spdk_nvme_tcp_r2t_hdr	*r2t;
+
+	SPDK_TRACELOG(SPDK_TRACE_NVMF_TCP, "Request %p: R2T for 0x%x bytes\n", tcp_req,
+		      tcp_req->req.length);
+
+	tcp_req->state = NVMF_TCP_REQUEST_STATE_TRANSFERRING_H2C;
+	tcp_req->h2c_offset = 0;
+	tcp_req->h2c_dgst_error = false;
+
+	nvmf_tcp_pdu_init(pdu, SPDK_NVME_TCP_PDU_TYPE_R2T, sizeof(*r2t));
+	r2t = (struct spdk_nvme_tcp_r2t_hdr *)pdu->hdr;
+	r2t->cccid = tcp_req->cmd.nvme_cmd.cid;
+	r2t->ttag = tcp_req->ttag;
+	r2t->r2to = 0;
+	r2t->r2tl = tcp_req->req.length;
+	nvmf_tcp_pdu_queue(tcp_conn, pdu, true);
+
+	tcp_req->req.conn->stats.transferred_writes++;
+	tcp_req->req.conn->stats.host_to_ctrlr_bytes += tcp_req->req.length;
+}
+
+static int
+spdk_nvmf_tcp_request_complete(struct spdk_nvmf_request *req)
+{
+	struct spdk_nvmf_tcp_request	*tcp_req = get_tcp_req(req);
+	struct spdk_nvmf_conn		*conn = req->conn;
+	struct spdk_nvmf_tcp_conn	*tcp_conn = get_tcp_conn(conn);
+	struct spdk_nvme_cpl		*rsp = &req->rsp->nvme_cpl;
+	struct spdk_nvme_tcp_c2h_data_hdr *c2h_data;
+	struct spdk_nvme_tcp_rsp	*capsule_resp;
+	struct spdk_nvmf_tcp_pdu	*pdu;
+	int				rc = 0;
+
+	if (tcp_conn->closing) {
+		/* The connection was closed; its data buffers are returned when it is freed */
+		spdk_nvmf_tcp_conn_put(tcp_conn);
+		return 0;
+	}
+
+	tcp_req->state = NVMF_TCP_REQUEST_STATE_TRANSFERRING_C2H;
+
+	if (rsp->status.sc == SPDK_NVME_SC_SUCCESS &&
+	    req->xfer == SPDK_NVME_DATA_CONTROLLER_TO_HOST && req->length > 0) {
+		pdu = &tcp_req->data_pdu;
+		nvmf_tcp_pdu_init(pdu, SPDK_NVME_TCP_PDU_TYPE_C2H_DATA, sizeof(*c2h_data));
+		c2h_data = (struct spdk_nvme_tcp_c2h_data_hdr *)pdu->hdr;
+		c2h_data->common.flags = SPDK_NVME_TCP_C2H_DATA_FLAGS_LAST_PDU;
+		c2h_data->cccid = req->cmd->nvme_cmd.cid;
+		c2h_data->datao = 0;
+		c2h_data->datal = req->length;
+		pdu->data = req->data;
+		pdu->data_len = req->length;
+		nvmf_tcp_pdu_queue(tcp_conn, pdu, true);
+		conn->stats.ctrlr_to_host_bytes += req->length;
+	}
+
+	/* Advance our sq_head pointer */
+	if (conn->sq_head == conn->sq_head_max) {
+		conn->sq_head = 0;
+	} else {
+		conn->sq_head++;
+	}
+	rsp->sqhd = conn->sq_head;
+
+	pdu = &tcp_req->rsp_pdu;
+	nvmf_tcp_pdu_init(pdu, SPDK_NVME_TCP_PDU_TYPE_CAPSULE_RESP, sizeof(*capsule_resp));
+	capsule_resp = (struct spdk_nvme_tcp_rsp *)pdu->hdr;
+	memcpy(&capsule_resp->rccqe, rsp, sizeof(capsule_resp->rccqe));
+	pdu->tcp_req = tcp_req;
+	nvmf_tcp_pdu_queue(tcp_conn, pdu, true);
+	spdk_nvmf_conn_stats_completion(conn, req->arrival_tsc);
+
+	/*
+	 * Responses are normally written in a batch at the end of the connection's poll.
+	 *  A connection whose CONNECT failed is never polled again, so write it out now.
+	 */
+	if (conn->sess == NULL) {
+		rc = spdk_nvmf_tcp_conn_flush(tcp_conn);
+	}
+
+	spdk_nvmf_tcp_conn_put(tcp_conn);
+	return rc;
+}
+
+static int
+spdk_nvmf_tcp_request_release(struct spdk_nvmf_request *req)
+{
+	struct spdk_nvmf_conn *conn = req->conn;
+	struct spdk_nvmf_tcp_conn *tcp_conn = get_tcp_conn(conn);
+
+	if (tcp_conn->closing) {
+		spdk_nvmf_tcp_conn_put(tcp_conn);
+		return 0;
+	}
+
+	/* Advance our sq_head pointer */
+	if (conn->sq_head == conn->sq_head_max) {
+		conn->sq_head = 0;
+	} else {
+		conn->sq_head++;
+	}
+
+	spdk_nvmf_tcp_request_free(get_tcp_req(req));
+	spdk_nvmf_tcp_conn_put(tcp_conn);
+
+	return 0;
+}
+
+/* The request is handed to the target; it holds the connection until it completes. */
+static inline void
+nvmf_tcp_request_set_executing(struct spdk_nvmf_tcp_request *tcp_req)
+{
+	tcp_req->state = NVMF_TCP_REQUEST_STATE_EXECUTING;
+	__sync_fetch_and_add(&get_tcp_conn(tcp_req->req.conn)->refcnt, 1);
+}
+
+static spdk_nvmf_request_prep_type
+spdk_nvmf_tcp_request_prep_data(struct spdk_nvmf_tcp_request *tcp_req)
+{
+	struct spdk_nvmf_request	*req = &tcp_req->req;
+	struct spdk_nvmf_tcp_conn	*tcp_conn = get_tcp_conn(req->conn);
+	struct spdk_nvme_cmd		*cmd = &req->cmd->nvme_cmd;
+	struct spdk_nvme_cpl		*rsp = &req->rsp->nvme_cpl;
+	struct spdk_nvmf_tcp_session	*tcp_sess;
+	struct spdk_nvme_sgl_descriptor *sgl;
+
+	req->length = 0;
+	req->data = NULL;
+	req->iovcnt = 0;
+
+	if (cmd->opc == SPDK_NVME_OPC_FABRIC) {
+		req->xfer = spdk_nvme_opc_get_data_transfer(req->cmd->nvmf_cmd.fctype);
+	} else {
+		req->xfer = spdk_nvme_opc_get_data_transfer(cmd->opc);
+	}
+
+	if (req->xfer == SPDK_NVME_DATA_NONE) {
+		return SPDK_NVMF_REQUEST_PREP_READY;
+	}
+
+	sgl = &cmd->dptr.sgl1;
+
+	if (sgl->generic.type == SPDK_NVME_SGL_TYPE_TRANSPORT_DATA_BLOCK &&
+	    sgl->unkeyed.subtype == SPDK_NVME_SGL_SUBTYPE_TRANSPORT) {
+		if (sgl->unkeyed.length > g_tcp.max_io_size) {
+			SPDK_ERRLOG("SGL length 0x%x exceeds max io size 0x%x\n",
+				    sgl->unkeyed.length, g_tcp.max_io_size);
+			rsp->status.sc = SPDK_NVME_SC_DATA_SGL_LENGTH_INVALID;
+			return SPDK_NVMF_REQUEST_PREP_ERROR;
+		}
+
+		if (sgl->unkeyed.length == 0) {
+			req->xfer = SPDK_NVME_DATA_NONE;
+			return SPDK_NVMF_REQUEST_PREP_READY;
+		}
+
+		req->length = sgl->unkeyed.length;
+
+		if (req->length > tcp_conn->in_capsule_buf_size) {
+			if (req->conn->sess == NULL) {
+				SPDK_ERRLOG("Large data transfer requested before CONNECT\n");
+				rsp->status.sc = SPDK_NVME_SC_DATA_SGL_LENGTH_INVALID;
+				return SPDK_NVMF_REQUEST_PREP_ERROR;
+			}
+
+			tcp_sess = req->conn->sess->trctx;
+			tcp_req->pool_buf = spdk_nvmf_tcp_session_get_buf(tcp_sess);
+			if (!tcp_req->pool_buf) {
+				/* No available buffers. Queue this request up. */
+				SPDK_TRACELOG(SPDK_TRACE_NVMF_TCP,
+					      "No available large data buffers. Queueing request %p\n", req);
+				return SPDK_NVMF_REQUEST_PREP_PENDING_BUFFER;
+			}
+
+			SPDK_TRACELOG(SPDK_TRACE_NVMF_TCP, "Request %p took buffer from central pool\n", req);
+			req->data = tcp_req->pool_buf;
+		} else {
+			/* Use the in capsule data buffer, even though this isn't in capsule data */
+			req->data = tcp_req->buf;
+		}
+
+		if (req->xfer == SPDK_NVME_DATA_HOST_TO_CONTROLLER) {
+			return SPDK_NVMF_REQUEST_PREP_PENDING_DATA;
+		} else {
+			return SPDK_NVMF_REQUEST_PREP_READY;
+		}
+	} else if (sgl->generic.type == SPDK_NVME_SGL_TYPE_DATA_BLOCK &&
+		   sgl->unkeyed.subtype == SPDK_NVME_SGL_SUBTYPE_OFFSET) {
+		uint64_t offset = sgl->address;
+		uint32_t max_len = tcp_req->in_capsule_data_len;
+
+		SPDK_TRACELOG(SPDK_TRACE_NVMF, "In-capsule data: offset 0x%" PRIx64 ", length 0x%x\n",
+			      offset, sgl->unkeyed.length);
+
+		if (offset > max_len) {
+			SPDK_ERRLOG("In-capsule offset 0x%" PRIx64 " exceeds capsule length 0x%x\n",
+				    offset, max_len);
+			rsp->status.sc = SPDK_NVME_SC_INVALID_SGL_OFFSET;
+			return SPDK_NVMF_REQUEST_PREP_ERROR;
+		}
+		max_len -= (uint32_t)offset;
+
+		if (sgl->unkeyed.length > max_len) {
+			SPDK_ERRLOG("In-capsule data length 0x%x exceeds capsule length 0x%x\n",
+				    sgl->unkeyed.length, max_len);
+			rsp->status.sc = SPDK_NVME_SC_DATA_SGL_LENGTH_INVALID;
+			return SPDK_NVMF_REQUEST_PREP_ERROR;
+		}
+
+		if (sgl->unkeyed.length == 0) {
+			req->xfer = SPDK_NVME_DATA_NONE;
+			return SPDK_NVMF_REQUEST_PREP_READY;
+		}
+
+		req->data = tcp_req->buf + offset;
+		req->length = sgl->unkeyed.length;
+		if (req->xfer == SPDK_NVME_DATA_HOST_TO_CONTROLLER) {
+			req->conn->stats.in_capsule_writes++;
+		}
+		return SPDK_NVMF_REQUEST_PREP_READY;
+	}
+
+	SPDK_ERRLOG("Invalid NVMf I/O Command SGL:  Type 0x%x, Subtype 0x%x\n",
+		    sgl->generic.type, sgl->generic.subtype);
+	rsp->status.sc = SPDK_NVME_SC_SGL_DESCRIPTOR_TYPE_INVALID;
+	return SPDK_NVMF_REQUEST_PREP_ERROR;
+}
+
+/* Returns the number of times that spdk_nvmf_request_exec was called, or -1 on error. */
+static int
+spdk_nvmf_tcp_request_start(struct spdk_nvmf_tcp_request *tcp_req)
+{
+	struct spdk_nvmf_request	*req = &tcp_req->req;
+	struct spdk_nvmf_tcp_conn	*tcp_conn = get_tcp_conn(req->conn);
+	int				rc;
+
+	switch (spdk_nvmf_tcp_request_prep_data(tcp_req)) {
+	case SPDK_NVMF_REQUEST_PREP_READY:
+		SPDK_TRACELOG(SPDK_TRACE_NVMF_TCP, "Request %p is ready for execution\n", req);
+		nvmf_tcp_request_set_executing(tcp_req);
+		rc = spdk_nvmf_request_exec(req);
+		if (rc < 0) {
+			return -1;
+		}
+		return 1;
+	case SPDK_NVMF_REQUEST_PREP_PENDING_BUFFER:
+		SPDK_TRACELOG(SPDK_TRACE_NVMF_TCP, "Request %p needs data buffer\n", req);
+		tcp_req->state = NVMF_TCP_REQUEST_STATE_NEED_BUFFER;
+		TAILQ_INSERT_TAIL(&tcp_conn->pending_data_buf_queue, tcp_req, link);
+		req->conn->stats.pending_buf_waits++;
+		return 0;
+	case SPDK_NVMF_REQUEST_PREP_PENDING_DATA:
+		SPDK_TRACELOG(SPDK_TRACE_NVMF_TCP, "Request %p needs data transfer\n", req);
+		spdk_nvmf_tcp_send_r2t(tcp_req);
+		return 0;
+	case SPDK_NVMF_REQUEST_PREP_ERROR:
+	default:
+		nvmf_tcp_request_set_executing(tcp_req);
+		return spdk_nvmf_request_complete(req);
+	}
+}
+
+/* Complete a request without executing it because its data digest was wrong. */
+static int
+spdk_nvmf_tcp_request_fail_digest(struct spdk_nvmf_tcp_request *tcp_req)
+{
+	SPDK_ERRLOG("Data digest error on request %p\n", tcp_req);
+
+	nvmf_tcp_request_set_executing(tcp_req);
+	tcp_req->req.xfer = SPDK_NVME_DATA_NONE;
+	tcp_req->rsp.nvme_cpl.status.sc = SPDK_NVME_SC_DATA_TRANSFER_ERROR;
+	return spdk_nvmf_request_complete(&tcp_req->req);
+}
+
+static int
+spdk_nvmf_tcp_handle_pending_data_buf(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	struct spdk_nvmf_tcp_session	*tcp_sess;
+	struct spdk_nvmf_tcp_request	*tcp_req, *tmp;
+	int rc;
+	int count = 0;
+
+	if (tcp_conn->conn.sess == NULL) {
+		return 0;
+	}
+
+	tcp_sess = tcp_conn->conn.sess->trctx;
+	TAILQ_FOREACH_SAFE(tcp_req, &tcp_conn->pending_data_buf_queue, link, tmp) {
+		assert(tcp_req->pool_buf == NULL);
+		tcp_req->pool_buf = spdk_nvmf_tcp_session_get_buf(tcp_sess);
+		if (!tcp_req->pool_buf) {
+			break;
+		}
+		TAILQ_REMOVE(&tcp_conn->pending_data_buf_queue, tcp_req, link);
+		tcp_req->req.data = tcp_req->pool_buf;
+
+		if (tcp_req->req.xfer == SPDK_NVME_DATA_HOST_TO_CONTROLLER) {
+			spdk_nvmf_tcp_send_r2t(tcp_req);
+		} else {
+			nvmf_tcp_request_set_executing(tcp_req);
+			rc = spdk_nvmf_request_exec(&tcp_req->req);
+			if (rc < 0) {
+				return -1;
+			}
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+
+Receive path.  Bytes read from the socket are run through a small state machine
+that reassembles one PDU at a time: common header, rest of the header and its
+digest, padding, data and data digest.
+
+*/
+
+static inline void
+nvmf_tcp_recv_set_state(struct spdk_nvmf_tcp_recv_pdu *pdu, enum spdk_nvmf_tcp_recv_state state,
+			void *dest, uint32_t len)
+{
+	pdu->state = state;
+	pdu->dest = dest;
+	pdu->need = len;
+	pdu->got = 0;
+}
+
+static inline void
+nvmf_tcp_recv_next_pdu(struct spdk_nvmf_tcp_recv_pdu *pdu)
+{
+	pdu->tcp_req = NULL;
+	nvmf_tcp_recv_set_state(pdu, NVMF_TCP_RECV_STATE_CH, pdu->hdr.raw,
+				sizeof(struct spdk_nvme_tcp_common_pdu_hdr));
+}
+
+/* Start receiving the data of the current PDU, or finish the PDU if it has none. */
+static int spdk_nvmf_tcp_recv_payload_done(struct spdk_nvmf_tcp_conn *tcp_conn, bool dgst_ok);
+
+static int
+nvmf_tcp_recv_data(struct spdk_nvmf_tcp_conn *tcp_conn, void *dest)
+{
+	struct spdk_nvmf_tcp_recv_pdu *pdu = &tcp_conn->recv_pdu;
+
+	if (pdu->data_len == 0) {
+		return spdk_nvmf_tcp_recv_payload_done(tcp_conn, true);
+	}
+
+	pdu->crc = ~0u;
+	pdu->data_dest = dest;
+	if (pdu->pad_len > 0) {
+		nvmf_tcp_recv_set_state(pdu, NVMF_TCP_RECV_STATE_PAD, NULL, pdu->pad_len);
+	} else {
+		nvmf_tcp_recv_set_state(pdu, NVMF_TCP_RECV_STATE_DATA, dest, pdu->data_len);
+	}
+
+	return 0;
+}
+
+static int
+spdk_nvmf_tcp_recv_ic_req(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	struct spdk_nvme_tcp_ic_req	*ic_req = &tcp_conn->recv_pdu.hdr.ic_req;
+	struct spdk_nvmf_tcp_pdu	*pdu = &tcp_conn->ic_resp_pdu;
+	struct spdk_nvme_tcp_ic_resp	*ic_resp;
+
+	if (ic_req->pfv != 0) {
+		SPDK_ERRLOG("Unsupported ICReq PFV %u\n", ic_req->pfv);
+		spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_INVALID_DATA_UNSUPPORTED_PARAMETER,
+					    offsetof(struct spdk_nvme_tcp_ic_req, pfv));
+		return -1;
+	}
+
+	if (ic_req->hpda > SPDK_NVME_TCP_PDA_MAX) {
+		SPDK_ERRLOG("Invalid ICReq HPDA %u\n", ic_req->hpda);
+		spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_INVALID_HEADER_FIELD,
+					    offsetof(struct spdk_nvme_tcp_ic_req, hpda));
+		return -1;
+	}
+
+	tcp_conn->hpda_bytes = (ic_req->hpda + 1) * 4;
+	tcp_conn->hdgst_enable = ic_req->dgst.bits.hdgst_enable;
+	tcp_conn->ddgst_enable = ic_req->dgst.bits.ddgst_enable;
+	tcp_conn->ic_done = true;
+
+	SPDK_TRACELOG(SPDK_TRACE_NVMF_TCP, "ICReq on connection %p: hpda %u hdgst %d ddgst %d\n",
+		      tcp_conn, ic_req->hpda, tcp_conn->hdgst_enable, tcp_conn->ddgst_enable);
+
+	nvmf_tcp_pdu_init(pdu, SPDK_NVME_TCP_PDU_TYPE_IC_RESP, sizeof(*ic_resp));
+	ic_resp = (struct spdk_nvme_tcp_ic_resp *)pdu->hdr;
+	ic_resp->pfv = 0;
+	ic_resp->cpda = 0;
+	ic_resp->dgst.bits.hdgst_enable = tcp_conn->hdgst_enable;
+	ic_resp->dgst.bits.ddgst_enable = tcp_conn->ddgst_enable;
+	ic_resp->maxh2cdata = g_tcp.max_io_size;
+	nvmf_tcp_pdu_queue(tcp_conn, pdu, false);
+
+	nvmf_tcp_recv_next_pdu(&tcp_conn->recv_pdu);
+	return 0;
+}
+
+static int
+spdk_nvmf_tcp_recv_capsule_cmd(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	struct spdk_nvmf_tcp_recv_pdu	*pdu = &tcp_conn->recv_pdu;
+	struct spdk_nvmf_tcp_request	*tcp_req;
+
+	tcp_req = TAILQ_FIRST(&tcp_conn->free_queue);
+	if (tcp_req == NULL) {
+		SPDK_ERRLOG("Host exceeded the queue depth of connection %p\n", tcp_conn);
+		spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_PDU_SEQUENCE_ERROR, 0);
+		return -1;
+	}
+
+	if (pdu->data_len > tcp_conn->in_capsule_buf_size) {
+		SPDK_ERRLOG("In-capsule data length 0x%x exceeds 0x%x\n", pdu->data_len,
+			    tcp_conn->in_capsule_buf_size);
+		spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_DATA_TRANSFER_LIMIT_EXCEEDED,
+					    0);
+		return -1;
+	}
+
+	TAILQ_REMOVE(&tcp_conn->free_queue, tcp_req, link);
+	tcp_conn->cur_queue_depth++;
+	tcp_req->req.arrival_tsc = spdk_nvmf_conn_stats_capsule(&tcp_conn->conn);
+	SPDK_TRACELOG(SPDK_TRACE_NVMF_TCP,
+		      "Capsule received. Request: %p Connection: %p Outstanding I/O: %d\n",
+		      &tcp_req->req, tcp_conn, tcp_conn->cur_queue_depth);
+	spdk_trace_record(TRACE_NVMF_IO_START, 0, 0, (uint64_t)&tcp_req->req, 0);
+
+	memcpy(&tcp_req->cmd, &pdu->hdr.capsule_cmd.ccsqe, sizeof(tcp_req->cmd));
+	memset(&tcp_req->rsp, 0, sizeof(tcp_req->rsp));
+	tcp_req->in_capsule_data_len = pdu->data_len;
+	pdu->tcp_req = tcp_req;
+
+	return nvmf_tcp_recv_data(tcp_conn, tcp_req->buf);
+}
+
+static int
+spdk_nvmf_tcp_recv_h2c_data(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	struct spdk_nvmf_tcp_recv_pdu		*pdu = &tcp_conn->recv_pdu;
+	struct spdk_nvme_tcp_h2c_data_hdr	*h2c_data = &pdu->hdr.h2c_data;
+	struct spdk_nvmf_tcp_request		*tcp_req;
+
+	if (h2c_data->ttag >= tcp_conn->max_queue_depth) {
+		SPDK_ERRLOG("Invalid H2CData TTAG 0x%x\n", h2c_data->ttag);
+		spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_INVALID_HEADER_FIELD,
+					    offsetof(struct spdk_nvme_tcp_h2c_data_hdr, ttag));
+		return -1;
+	}
+
+	tcp_req = &tcp_conn->reqs[h2c_data->ttag];
+	if (tcp_req->state != NVMF_TCP_REQUEST_STATE_TRANSFERRING_H2C ||
+	    tcp_req->cmd.nvme_cmd.cid != h2c_data->cccid) {
+		SPDK_ERRLOG("H2CData for CID 0x%x does not match an R2T\n", h2c_data->cccid);
+		spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_INVALID_HEADER_FIELD,
+					    offsetof(struct spdk_nvme_tcp_h2c_data_hdr, cccid));
+		return -1;
+	}
+
+	if (h2c_data->datao != tcp_req->h2c_offset ||
+	    h2c_data->datal != pdu->data_len ||
+	    h2c_data->datal > tcp_req->req.length - tcp_req->h2c_offset) {
+		SPDK_ERRLOG("H2CData offset 0x%x length 0x%x out of range\n", h2c_data->datao,
+			    h2c_data->datal);
+		spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_DATA_TRANSFER_OUT_OF_RANGE,
+					    offsetof(struct spdk_nvme_tcp_h2c_data_hdr, datao));
+		return -1;
+	}
+
+	pdu->tcp_req = tcp_req;
+
+	return nvmf_tcp_recv_data(tcp_conn, (uint8_t *)tcp_req->req.data + h2c_data->datao);
+}
+
+/* Validate the common header and size the rest of the PDU header. */
+static int
+spdk_nvmf_tcp_recv_ch(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	struct spdk_nvmf_tcp_recv_pdu		*pdu = &tcp_conn->recv_pdu;
+	struct spdk_nvme_tcp_common_pdu_hdr	*common = &pdu->hdr.common;
+	uint32_t				expected_hlen, hdgst_len;
+
+	switch (common->pdu_type) {
+	case SPDK_NVME_TCP_PDU_TYPE_IC_REQ:
+		expected_hlen = sizeof(struct spdk_nvme_tcp_ic_req);
+		break;
+	case SPDK_NVME_TCP_PDU_TYPE_H2C_TERM_REQ:
+		expected_hlen = sizeof(struct spdk_nvme_tcp_term_req_hdr);
+		break;
+	case SPDK_NVME_TCP_PDU_TYPE_CAPSULE_CMD:
+		expected_hlen = sizeof(struct spdk_nvme_tcp_cmd);
+		break;
+	case SPDK_NVME_TCP_PDU_TYPE_H2C_DATA:
+		expected_hlen = sizeof(struct spdk_nvme_tcp_h2c_data_hdr);
+		break;
+	default:
+		SPDK_ERRLOG("Unexpected PDU type 0x%x\n", common->pdu_type);
+		spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_INVALID_HEADER_FIELD,
+					    offsetof(struct spdk_nvme_tcp_common_pdu_hdr, pdu_type));
+		return -1;
+	}
+
+	if ((common->pdu_type == SPDK_NVME_TCP_PDU_TYPE_IC_REQ) == tcp_conn->ic_done) {
+		SPDK_ERRLOG("Unexpected PDU type 0x%x %s connection initialization\n", common->pdu_type,
+			    tcp_conn->ic_done ? "after" : "before");
+		spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_PDU_SEQUENCE_ERROR, 0);
+		return -1;
+	}
+
+	if (common->hlen != expected_hlen) {
+		SPDK_ERRLOG("Invalid HLEN %u for PDU type 0x%x\n", common->hlen, common->pdu_type);
+		spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_INVALID_HEADER_FIELD,
+					    offsetof(struct spdk_nvme_tcp_common_pdu_hdr, hlen));
+		return -1;
+	}
+
+	hdgst_len = 0;
+	pdu->has_ddgst = false;
+	if (common->pdu_type == SPDK_NVME_TCP_PDU_TYPE_CAPSULE_CMD ||
+	    common->pdu_type == SPDK_NVME_TCP_PDU_TYPE_H2C_DATA) {
+		if (((common->flags & SPDK_NVME_TCP_CH_FLAGS_HDGSTF) && !tcp_conn->hdgst_enable) ||
+		    ((common->flags & SPDK_NVME_TCP_CH_FLAGS_DDGSTF) && !tcp_conn->ddgst_enable)) {
+			SPDK_ERRLOG("PDU flags 0x%x use a digest that was not negotiated\n", common->flags);
+			spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_INVALID_HEADER_FIELD,
+						    offsetof(struct spdk_nvme_tcp_common_pdu_hdr, flags));
+			return -1;
+		}
+		if (common->flags & SPDK_NVME_TCP_CH_FLAGS_HDGSTF) {
+			hdgst_len = SPDK_NVME_TCP_DIGEST_LEN;
+		}
+		pdu->has_ddgst = !!(common->flags & SPDK_NVME_TCP_CH_FLAGS_DDGSTF);
+	}
+
+	if (common->plen < common->hlen + hdgst_len ||
+	    (common->pdu_type == SPDK_NVME_TCP_PDU_TYPE_IC_REQ && common->plen != common->hlen)) {
+		SPDK_ERRLOG("Invalid PLEN %u for PDU type 0x%x\n", common->plen, common->pdu_type);
+		spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_INVALID_HEADER_FIELD,
+					    offsetof(struct spdk_nvme_tcp_common_pdu_hdr, plen));
+		return -1;
+	}
+
+	nvmf_tcp_recv_set_state(pdu, NVMF_TCP_RECV_STATE_PSH,
+				pdu->hdr.raw + sizeof(struct spdk_nvme_tcp_common_pdu_hdr),
+				common->hlen + hdgst_len - sizeof(struct spdk_nvme_tcp_common_pdu_hdr));
+	return 0;
+}
+
+/* Verify the header digest, locate the data and dispatch the PDU header. */
+static int
+spdk_nvmf_tcp_recv_psh(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	struct spdk_nvmf_tcp_recv_pdu		*pdu = &tcp_conn->recv_pdu;
+	struct spdk_nvme_tcp_common_pdu_hdr	*common = &pdu->hdr.common;
+	uint32_t				hdr_len, ddgst_len, crc;
+
+	hdr_len = common->hlen;
+	if (common->flags & SPDK_NVME_TCP_CH_FLAGS_HDGSTF &&
+	    common->pdu_type != SPDK_NVME_TCP_PDU_TYPE_IC_REQ &&
+	    common->pdu_type != SPDK_NVME_TCP_PDU_TYPE_H2C_TERM_REQ) {
+		memcpy(&crc, &pdu->hdr.raw[common->hlen], sizeof(crc));
+		if (crc != nvmf_tcp_digest(pdu->hdr.raw, common->hlen)) {
+			SPDK_ERRLOG("Header digest error on connection %p\n", tcp_conn);
+			spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_HDGST_ERROR, 0);
+			return -1;
+		}
+		hdr_len += SPDK_NVME_TCP_DIGEST_LEN;
+	}
+
+	if (common->pdu_type == SPDK_NVME_TCP_PDU_TYPE_H2C_TERM_REQ) {
+		SPDK_ERRLOG("Host terminated connection %p: fes 0x%x\n", tcp_conn,
+			    pdu->hdr.term_req.fes);
+		return -1;
+	}
+
+	/* Locate the data, if any, from the data offset */
+	pdu->pad_len = 0;
+	pdu->data_len = 0;
+	if (common->plen > hdr_len) {
+		ddgst_len = pdu->has_ddgst ? SPDK_NVME_TCP_DIGEST_LEN : 0;
+		if (common->pdo < hdr_len || common->pdo > NVMF_TCP_PDU_MAX_HDR_SIZE ||
+		    common->plen < common->pdo + ddgst_len) {
+			SPDK_ERRLOG("Invalid PDO %u for PDU of length %u\n", common->pdo, common->plen);
+			spdk_nvmf_tcp_send_term_req(tcp_conn, SPDK_NVME_TCP_TERM_REQ_FES_INVALID_HEADER_FIELD,
+						    offsetof(struct spdk_nvme_tcp_common_pdu_hdr, pdo));
+			return -1;
+		}
+		pdu->pad_len = common->pdo - hdr_len;
+		pdu->data_len = common->plen - common->pdo - ddgst_len;
+	} else {
+		pdu->has_ddgst = false;
+	}
+
+	switch (common->pdu_type) {
+	case SPDK_NVME_TCP_PDU_TYPE_IC_REQ:
+		return spdk_nvmf_tcp_recv_ic_req(tcp_conn);
+	case SPDK_NVME_TCP_PDU_TYPE_CAPSULE_CMD:
+		return spdk_nvmf_tcp_recv_capsule_cmd(tcp_conn);
+	case SPDK_NVME_TCP_PDU_TYPE_H2C_DATA:
+		return spdk_nvmf_tcp_recv_h2c_data(tcp_conn);
+	default:
+		assert(0);
+		return -1;
+	}
+}
+
+static int
+spdk_nvmf_tcp_recv_payload_done(struct spdk_nvmf_tcp_conn *tcp_conn, bool dgst_ok)
+{
+	struct spdk_nvmf_tcp_recv_pdu	*pdu = &tcp_conn->recv_pdu;
+	struct spdk_nvmf_tcp_request	*tcp_req = pdu->tcp_req;
+	int				rc;
+
+	nvmf_tcp_recv_next_pdu(pdu);
+
+	if (pdu->hdr.common.pdu_type == SPDK_NVME_TCP_PDU_TYPE_CAPSULE_CMD) {
+		if (!dgst_ok) {
+			rc = spdk_nvmf_tcp_request_fail_digest(tcp_req);
+			return rc < 0 ? -1 : 0;
+		}
+		return spdk_nvmf_tcp_request_start(tcp_req);
+	}
+
+	assert(pdu->hdr.common.pdu_type == SPDK_NVME_TCP_PDU_TYPE_H2C_DATA);
+	tcp_req->h2c_offset += pdu->hdr.h2c_data.datal;
+	if (!dgst_ok) {
+		tcp_req->h2c_dgst_error = true;
+	}
+
+	if (tcp_req->h2c_offset < tcp_req->req.length) {
+		return 0;
+	}
+
+	if (tcp_req->h2c_dgst_error) {
+		rc = spdk_nvmf_tcp_request_fail_digest(tcp_req);
+		return rc < 0 ? -1 : 0;
+	}
+
+	SPDK_TRACELOG(SPDK_TRACE_NVMF_TCP, "Request %p received all H2C data\n", tcp_req);
+	nvmf_tcp_request_set_executing(tcp_req);
+	rc = spdk_nvmf_request_exec(&tcp_req->req);
+	if (rc < 0) {
+		return -1;
+	}
+	return 1;
+}
+
+/* The current receive state has all of its bytes.  Returns the number of executed requests. */
+static int
+spdk_nvmf_tcp_recv_state_done(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	struct spdk_nvmf_tcp_recv_pdu *pdu = &tcp_conn->recv_pdu;
+
+	switch (pdu->state) {
+	case NVMF_TCP_RECV_STATE_CH:
+		return spdk_nvmf_tcp_recv_ch(tcp_conn);
+	case NVMF_TCP_RECV_STATE_PSH:
+		return spdk_nvmf_tcp_recv_psh(tcp_conn);
+	case NVMF_TCP_RECV_STATE_PAD:
+		nvmf_tcp_recv_set_state(pdu, NVMF_TCP_RECV_STATE_DATA, pdu->data_dest, pdu->data_len);
+		return 0;
+	case NVMF_TCP_RECV_STATE_DATA:
+		if (pdu->has_ddgst) {
+			nvmf_tcp_recv_set_state(pdu, NVMF_TCP_RECV_STATE_DDGST, &pdu->ddgst,
+						SPDK_NVME_TCP_DIGEST_LEN);
+			return 0;
+		}
+		return spdk_nvmf_tcp_recv_payload_done(tcp_conn, true);
+	case NVMF_TCP_RECV_STATE_DDGST:
+		return spdk_nvmf_tcp_recv_payload_done(tcp_conn, pdu->ddgst == ~pdu->crc);
+	}
+
+	return -1;
+}
+
+/* Copy received bytes into the current receive state's destination. */
+static inline void
+nvmf_tcp_recv_copy(struct spdk_nvmf_tcp_recv_pdu *pdu, const uint8_t *buf, uint32_t len)
+{
+	if (pdu->dest) {
+		memcpy(pdu->dest + pdu->got, buf, len);
+	}
+	if (pdu->state == NVMF_TCP_RECV_STATE_DATA && pdu->has_ddgst) {
+		pdu->crc = spdk_crc32c_update(buf, len, pdu->crc);
+	}
+	pdu->got += len;
+}
+
+/*
+ * Read once from the socket.  Large payloads are received directly into the request's data
+ *  buffer, everything else goes through recv_buf.
+ *
+ * Returns the number of bytes read, 0 if no data was available, or -1 on error.
+ */
+static int
+spdk_nvmf_tcp_sock_recv(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	struct spdk_nvmf_tcp_recv_pdu	*pdu = &tcp_conn->recv_pdu;
+	uint32_t			remaining = pdu->need - pdu->got;
+	ssize_t				rc;
+
+	if (pdu->state == NVMF_TCP_RECV_STATE_DATA && remaining >= NVMF_TCP_DIRECT_RECV_THRESHOLD) {
+		rc = spdk_sock_recv(tcp_conn->sock, pdu->dest + pdu->got, remaining);
+		if (rc > 0) {
+			if (pdu->has_ddgst) {
+				pdu->crc = spdk_crc32c_update(pdu->dest + pdu->got, rc, pdu->crc);
+			}
+			pdu->got += rc;
+		}
+	} else {
+		rc = spdk_sock_recv(tcp_conn->sock, tcp_conn->recv_buf, NVMF_TCP_RECV_BUF_SIZE);
+		if (rc > 0) {
+			tcp_conn->recv_len = rc;
+			tcp_conn->recv_offset = 0;
+		}
+	}
+
+	if (rc == 0) {
+		SPDK_TRACELOG(SPDK_TRACE_NVMF_TCP, "Connection %p closed by the host\n", tcp_conn);
+		return -1;
+	} else if (rc < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return 0;
+		}
+		SPDK_ERRLOG("recv() failed on connection %p: %s\n", tcp_conn, strerror(errno));
+		return -1;
+	}
+
+	return rc;
+}
+
+/*
+ * Read from the socket once and parse everything that was read.
+ *
+ * Returns the number of times that spdk_nvmf_request_exec was called, or -1 on error.
+ */
+static int
+spdk_nvmf_tcp_conn_recv(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	struct spdk_nvmf_tcp_recv_pdu	*pdu = &tcp_conn->recv_pdu;
+	uint32_t			len;
+	bool				did_recv = false;
+	int				rc;
+	int				count = 0;
+
+	while (1) {
+		/* A pending connection's CONNECT now belongs to the subsystem's poller. */
+		if (tcp_conn->pending && count > 0) {
+			break;
+		}
+
+		if (tcp_conn->recv_offset == tcp_conn->recv_len) {
+			if (did_recv) {
+				break;
+			}
+			did_recv = true;
+
+			rc = spdk_nvmf_tcp_sock_recv(tcp_conn);
+			if (rc <= 0) {
+				return rc < 0 ? -1 : count;
+			}
+		} else {
+			len = tcp_conn->recv_len - tcp_conn->recv_offset;
+			if (len > pdu->need - pdu->got) {
+				len = pdu->need - pdu->got;
+			}
+			nvmf_tcp_recv_copy(pdu, tcp_conn->recv_buf + tcp_conn->recv_offset, len);
+			tcp_conn->recv_offset += len;
+		}
+
+		if (pdu->got == pdu->need) {
+			rc = spdk_nvmf_tcp_recv_state_done(tcp_conn);
+			if (rc < 0) {
+				return -1;
+			}
+			count += rc;
+		}
+	}
+
+	return count;
+}
+
+/* Returns the number of times that spdk_nvmf_request_exec was called,
+ * or -1 on error.
+ */
+static int
+spdk_nvmf_tcp_poll(struct spdk_nvmf_conn *conn)
+{
+	struct spdk_nvmf_tcp_conn *tcp_conn = get_tcp_conn(conn);
+	int rc;
+	int count = 0;
+
+	/* Requests waiting for a large buffer go first, since buffers are freed by writes */
+	rc = spdk_nvmf_tcp_handle_pending_data_buf(tcp_conn);
+	if (rc < 0) {
+		return -1;
+	}
+	count += rc;
+
+	rc = spdk_nvmf_tcp_conn_recv(tcp_conn);
+	if (rc < 0) {
+		return -1;
+	}
+	count += rc;
+
+	if (tcp_conn->pending && count > 0) {
+		/* Do not touch the connection after handing its CONNECT to the subsystem */
+		return count;
+	}
+
+	rc = spdk_nvmf_tcp_conn_flush(tcp_conn);
+	if (rc < 0) {
+		return -1;
+	}
+
+	return count;
+}
+
+static void
+spdk_nvmf_tcp_acceptor_poll(void)
+{
+	struct spdk_nvmf_tcp_listen_addr	*addr;
+	struct spdk_nvmf_tcp_conn		*tcp_conn, *tmp;
+	char					saddr[64], caddr[64];
+	int					rc, sock;
+
+	/* Process pending connections for incoming capsules. The only capsule
+	 * this should ever find is a CONNECT request. */
+	TAILQ_FOREACH_SAFE(tcp_conn, &g_pending_conns, link, tmp) {
+		rc = spdk_nvmf_tcp_poll(&tcp_conn->conn);
+		if (rc < 0) {
+			TAILQ_REMOVE(&g_pending_conns, tcp_conn, link);
+			spdk_nvmf_tcp_conn_destroy(tcp_conn);
+		} else if (rc > 0) {
+			/* At least one request was processed which is assumed to be
+			 * a CONNECT. Remove this connection from our list. */
+			TAILQ_REMOVE(&g_pending_conns, tcp_conn, link);
+			tcp_conn->pending = false;
+		}
+	}
+
+	pthread_mutex_lock(&g_tcp.lock);
+	TAILQ_FOREACH(addr, &g_tcp.listen_addrs, link) {
+		while (1) {
+			sock = spdk_sock_accept(addr->sock);
+			if (sock < 0) {
+				if (errno != EAGAIN && errno != EWOULDBLOCK) {
+					SPDK_ERRLOG("accept() failed on %s:%s: %s\n", addr->traddr,
+						    addr->trsvcid, strerror(errno));
+				}
+				break;
+			}
+
+			tcp_conn = spdk_nvmf_tcp_conn_create(sock);
+			if (tcp_conn == NULL) {
+				spdk_sock_close(sock);
+				continue;
+			}
+
+			if (spdk_sock_getaddr(sock, saddr, sizeof(saddr), caddr, sizeof(caddr)) == 0) {
+				SPDK_TRACELOG(SPDK_TRACE_NVMF_TCP, "New TCP connection %p from %s to %s\n",
+					      tcp_conn, caddr, saddr);
+			}
+
+			tcp_conn->pending = true;
+			TAILQ_INSERT_TAIL(&g_pending_conns, tcp_conn, link);
+		}
+	}
+	pthread_mutex_unlock(&g_tcp.lock);
+}
+
+static int
+spdk_nvmf_tcp_session_init(struct spdk_nvmf_session *session, struct spdk_nvmf_conn *conn)
+{
+	struct spdk_nvmf_tcp_session	*tcp_sess;
+	uint32_t			i;
+	struct spdk_nvmf_tcp_buf	*buf;
+
+	tcp_sess = calloc(1, sizeof(*tcp_sess));
+	if (!tcp_sess) {
+		return -1;
+	}
+
+	tcp_sess->buf = rte_calloc("large_buf_pool", g_tcp.sess_data_bufs, g_tcp.max_io_size,
+				   0x20000);
+	if (!tcp_sess->buf) {
+		SPDK_ERRLOG("Large buffer pool allocation failed (%u x %u)\n",
+			    g_tcp.sess_data_bufs, g_tcp.max_io_size);
+		free(tcp_sess);
+		return -1;
+	}
+
+	pthread_spin_init(&tcp_sess->lock, PTHREAD_PROCESS_PRIVATE);
+	tcp_sess->refcnt = 1;
+	SLIST_INIT(&tcp_sess->data_buf_pool);
+	for (i = 0; i < g_tcp.sess_data_bufs; i++) {
+		buf = (struct spdk_nvmf_tcp_buf *)(tcp_sess->buf + (i * g_tcp.max_io_size));
+		SLIST_INSERT_HEAD(&tcp_sess->data_buf_pool, buf, link);
+	}
+
+	session->transport = conn->transport;
+	session->trctx = tcp_sess;
+
+	return 0;
+}
+
+static void
+spdk_nvmf_tcp_session_fini(struct spdk_nvmf_session *session)
+{
+	struct spdk_nvmf_tcp_session *tcp_sess = session->trctx;
+
+	if (!tcp_sess) {
+		return;
+	}
+
+	/* Requests of closed connections may still be using the session's buffers */
+	spdk_nvmf_tcp_session_put(tcp_sess);
+	session->trctx = NULL;
+}
+
+static int
+spdk_nvmf_tcp_init(uint16_t max_queue_depth, uint32_t max_io_size,
+		   uint32_t in_capsule_data_size)
+{
+	SPDK_NOTICELOG("*** TCP Transport Init ***\n");
+
+	pthread_mutex_lock(&g_tcp.lock);
+	g_tcp.max_queue_depth = max_queue_depth;
+	g_tcp.max_io_size = max_io_size;
+	g_tcp.in_capsule_data_size = in_capsule_data_size;
+	g_tcp.sess_data_bufs = g_nvmf_tgt.sess_data_bufs;
+	pthread_mutex_unlock(&g_tcp.lock);
+
+	return 0;
+}
+
+static int
+spdk_nvmf_tcp_fini(void)
+{
+	struct spdk_nvmf_tcp_listen_addr	*addr, *addr_tmp;
+	struct spdk_nvmf_tcp_conn		*tcp_conn, *conn_tmp;
+
+	pthread_mutex_lock(&g_tcp.lock);
+	TAILQ_FOREACH_SAFE(addr, &g_tcp.listen_addrs, link, addr_tmp) {
+		TAILQ_REMOVE(&g_tcp.listen_addrs, addr, link);
+		spdk_sock_close(addr->sock);
+		free(addr);
+	}
+
+	TAILQ_FOREACH_SAFE(tcp_conn, &g_pending_conns, link, conn_tmp) {
+		TAILQ_REMOVE(&g_pending_conns, tcp_conn, link);
+		spdk_nvmf_tcp_conn_destroy(tcp_conn);
+	}
+	pthread_mutex_unlock(&g_tcp.lock);
+
+	return 0;
+}
+
+static void
+spdk_nvmf_tcp_close_conn(struct spdk_nvmf_conn *conn)
+{
+	struct spdk_nvmf_tcp_conn *tcp_conn = get_tcp_conn(conn);
+	struct spdk_nvmf_tcp_session *tcp_sess;
+
+	/* The connection's poller has stopped, but requests may still be executing */
+	if (conn->sess != NULL) {
+		tcp_sess = conn->sess->trctx;
+		__sync_fetch_and_add(&tcp_sess->refcnt, 1);
+		tcp_conn->tcp_sess = tcp_sess;
+	}
+
+	spdk_sock_close(tcp_conn->sock);
+	tcp_conn->sock = -1;
+	tcp_conn->closing = true;
+	__sync_synchronize();
+
+	spdk_nvmf_tcp_conn_put(tcp_conn);
+}
+
+static void
+spdk_nvmf_tcp_discover(struct spdk_nvmf_listen_addr *listen_addr,
+		       struct spdk_nvmf_discovery_log_page_entry *entry)
+{
+	entry->trtype = SPDK_NVMF_TRTYPE_TCP;
+	entry->adrfam = SPDK_NVMF_ADRFAM_IPV4;
+	entry->treq.secure_channel = SPDK_NVMF_TREQ_SECURE_CHANNEL_NOT_SPECIFIED;
+
+	spdk_strcpy_pad(entry->trsvcid, listen_addr->trsvcid, sizeof(entry->trsvcid), ' ');
+	spdk_strcpy_pad(entry->traddr, listen_addr->traddr, sizeof(entry->traddr), ' ');
+
+	/* No transport security (TLS) is supported */
+	memset(&entry->tsas, 0, sizeof(entry->tsas));
+}
+
+static int
+spdk_nvmf_tcp_listen(struct spdk_nvmf_listen_addr *listen_addr)
+{
+	struct spdk_nvmf_tcp_listen_addr *addr;
+
+	pthread_mutex_lock(&g_tcp.lock);
+	TAILQ_FOREACH(addr, &g_tcp.listen_addrs, link) {
+		if ((!strcasecmp(addr->traddr, listen_addr->traddr)) &&
+		    (!strcasecmp(addr->trsvcid, listen_addr->trsvcid))) {
+			/* Already listening at this address */
+			pthread_mutex_unlock(&g_tcp.lock);
+			return 0;
+		}
+	}
+
+	addr = calloc(1, sizeof(*addr));
+	if (!addr) {
+		pthread_mutex_unlock(&g_tcp.lock);
+		return -1;
+	}
+
+	addr->traddr = listen_addr->traddr;
+	addr->trsvcid = listen_addr->trsvcid;
+
+	/* The listening socket is non-blocking, so the acceptor never waits in accept() */
+	addr->sock = spdk_sock_listen(addr->traddr, (int)strtol(addr->trsvcid, NULL, 10));
+	if (addr->sock < 0) {
+		SPDK_ERRLOG("spdk_sock_listen() failed on %s:%s\n", addr->traddr, addr->trsvcid);
+		free(addr);
+		pthread_mutex_unlock(&g_tcp.lock);
+		return -1;
+	}
+
+	TAILQ_INSERT_TAIL(&g_tcp.listen_addrs, addr, link);
+	pthread_mutex_unlock(&g_tcp.lock);
+
+	SPDK_NOTICELOG("*** NVMf Target Listening on %s port %s (TCP) ***\n",
+		       addr->traddr, addr->trsvcid);
+
+	return 0;
+}
+
+const struct spdk_nvmf_transport spdk_nvmf_transport_tcp = {
+	.name = "tcp",
+	.transport_init = spdk_nvmf_tcp_init,
+	.transport_fini = spdk_nvmf_tcp_fini,
+
+	.acceptor_poll = spdk_nvmf_tcp_acceptor_poll,
+
+	.listen_addr_add = spdk_nvmf_tcp_listen,
+	.listen_addr_discover = spdk_nvmf_tcp_discover,
+
+	.session_init = spdk_nvmf_tcp_session_init,
+	.session_fini = spdk_nvmf_tcp_session_fini,
+
+	.req_complete = spdk_nvmf_tcp_request_complete,
+	.req_release = spdk_nvmf_tcp_request_release,
+
+	.conn_fini = spdk_nvmf_tcp_close_conn,
+	.conn_poll = spdk_nvmf_tcp_poll,
+};
+
+SPDK_LOG_REGISTER_TRACE_FLAG("nvmf_tcp", SPDK_TRACE_NVMF_TCP)
@@ -45,6 +45,7 @@ static const struct spdk_nvmf_transport *const g_transports[] = {
 #ifdef SPDK_CONFIG_RDMA
 	&spdk_nvmf_transport_rdma,
 #endif
+	&spdk_nvmf_transport_tcp,
 };
 
 #define NUM_TRANSPORTS (sizeof(g_transports) / sizeof(*g_transports))
@@ -94,6 +95,18 @@ spdk_nvmf_acceptor_poll(void)
 	}
 }
 
+void
+spdk_nvmf_poll_group_poll(void)
+{
+	size_t i;
+
+	for (i = 0; i != NUM_TRANSPORTS; i++) {
+		if (g_transports[i]->poll_group_poll) {
+			g_transports[i]->poll_group_poll();
+		}
+	}
+}
+
 const struct spdk_nvmf_transport *
 spdk_nvmf_transport_get(const char *name)
 {
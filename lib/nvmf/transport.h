@@ -110,6 +110,12 @@ struct spdk_nvmf_transport {
 	 * Poll a connection for events.
 	 */
 	int (*conn_poll)(struct spdk_nvmf_conn *conn);
+
+	/*
+	 * Reap the completion queues shared by connections on the current core.
+	 * Optional.
+	 */
+	void (*poll_group_poll)(void);
 };
 
 int spdk_nvmf_transport_init(void);
@@ -117,7 +123,9 @@ int spdk_nvmf_transport_fini(void);
 const struct spdk_nvmf_transport *spdk_nvmf_transport_get(const char *name);
 
 void spdk_nvmf_acceptor_poll(void);
+void spdk_nvmf_poll_group_poll(void);
 
 extern const struct spdk_nvmf_transport spdk_nvmf_transport_rdma;
+extern const struct spdk_nvmf_transport spdk_nvmf_transport_tcp;
 
 #endif /* SPDK_NVMF_TRANSPORT_H */
@@ -283,6 +283,9 @@ nvmf_virtual_ctrlr_get_features(struct spdk_nvmf_request *req)
 	case SPDK_NVME_FEAT_KEEP_ALIVE_TIMER:
 		response->cdw0 = session->kato;
 		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
+	case SPDK_NVME_FEAT_ASYNC_EVENT_CONFIGURATION:
+		response->cdw0 = session->async_event_config;
+		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
 	default:
 		SPDK_ERRLOG("get features command with invalid code\n");
 		response->status.sc = SPDK_NVME_SC_INVALID_OPCODE;
@@ -323,6 +326,12 @@ nvmf_virtual_ctrlr_set_features(struct spdk_nvmf_request *req)
 			session->kato = cmd->cdw11;
 		}
 		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
+	case SPDK_NVME_FEAT_ASYNC_EVENT_CONFIGURATION:
+		/* No asynchronous events are generated; just remember the setting */
+		SPDK_TRACELOG(SPDK_TRACE_NVMF, "Set Features - Async Event Configuration, cdw11 0x%x\n",
+			      cmd->cdw11);
+		session->async_event_config = cmd->cdw11;
+		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
 	default:
 		SPDK_ERRLOG("set features command with invalid code\n");
 		response->status.sc = SPDK_NVME_SC_INVALID_OPCODE;
@@ -392,6 +401,7 @@ nvmf_virtual_ctrlr_rw_cmd(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 	struct spdk_nvme_cmd *cmd = &req->cmd->nvme_cmd;
 	struct spdk_nvme_cpl *response = &req->rsp->nvme_cpl;
 	struct nvme_read_cdw12 *cdw12 = (struct nvme_read_cdw12 *)&cmd->cdw12;
+	struct spdk_bdev_io_hints hints = {};
 
 	blockcnt = bdev->blockcnt;
 	lba_address = cmd->cdw11;
@@ -412,17 +422,22 @@ nvmf_virtual_ctrlr_rw_cmd(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
 	}
 
+	/* Pass the host's dataset management hints through to the block device. */
+	hints.access_freq = cmd->cdw13 & SPDK_NVME_IO_DSM_ACCESS_FREQ_MASK;
+	hints.sequential = (cmd->cdw13 & SPDK_NVME_IO_DSM_SEQUENTIAL_REQUEST) != 0;
+
 	if (cmd->opc == SPDK_NVME_OPC_READ) {
 		spdk_trace_record(TRACE_NVMF_LIB_READ_START, 0, 0, (uint64_t)req, 0);
-		if (spdk_bdev_read(bdev, ch, req->data, offset, req->length, nvmf_virtual_ctrlr_complete_cmd,
-				   req) == NULL) {
+		if (spdk_bdev_readv_with_hints(bdev, ch, req->iov, req->iovcnt, offset, req->length,
+					       &hints, nvmf_virtual_ctrlr_complete_cmd, req) == NULL) {
 			response->status.sc = SPDK_NVME_SC_INTERNAL_DEVICE_ERROR;
 			return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
 		}
 	} else {
 		spdk_trace_record(TRACE_NVMF_LIB_WRITE_START, 0, 0, (uint64_t)req, 0);
-		if (spdk_bdev_write(bdev, ch, req->data, offset, req->length, nvmf_virtual_ctrlr_complete_cmd,
-				    req) == NULL) {
+		hints.write_stream = req->conn->sess->subsys->dev.virt.write_stream;
+		if (spdk_bdev_writev_with_hints(bdev, ch, req->iov, req->iovcnt, offset, req->length,
+						&hints, nvmf_virtual_ctrlr_complete_cmd, req) == NULL) {
 			response->status.sc = SPDK_NVME_SC_INTERNAL_DEVICE_ERROR;
 			return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
 		}
@@ -515,7 +530,11 @@ nvmf_virtual_ctrlr_process_io_cmd(struct spdk_nvmf_request *req)
 	}
 
 	bdev = subsystem->dev.virt.ns_list[nsid - 1];
-	ch = subsystem->dev.virt.ch[nsid - 1];
+	if (req->conn->scheduled) {
+		ch = req->conn->ch[nsid - 1];
+	} else {
+		ch = subsystem->dev.virt.ch[nsid - 1];
+	}
 	switch (cmd->opc) {
 	case SPDK_NVME_OPC_READ:
 	case SPDK_NVME_OPC_WRITE:
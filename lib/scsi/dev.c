@@ -34,6 +34,8 @@
 
 #include "scsi_internal.h"
 
+#include "spdk/io_channel.h"
+
 static struct spdk_scsi_dev g_devs[SPDK_SCSI_MAX_DEVS];
 
 struct spdk_scsi_dev *
@@ -163,6 +165,8 @@ spdk_scsi_dev_construct(const char *name, char *lun_name_list[], int *lun_id_lis
 
 	dev->num_ports = 0;
 	dev->maxlun = 0;
+	dev->io_priority = SPDK_IO_PRIORITY_DEFAULT;
+	dev->write_stream = 0;
 
 	for (i = 0; i < num_luns; i++) {
 		bdev = spdk_bdev_get_by_name(lun_name_list[i]);
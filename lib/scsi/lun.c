@@ -404,7 +404,7 @@ int spdk_scsi_lun_allocate_io_channel(struct spdk_scsi_lun *lun)
 		return -1;
 	}
 
-	lun->io_channel = spdk_bdev_get_io_channel(lun->bdev, SPDK_IO_PRIORITY_DEFAULT);
+	lun->io_channel = spdk_bdev_get_io_channel(lun->bdev, lun->dev->io_priority);
 	if (lun->io_channel == NULL) {
 		return -1;
 	}
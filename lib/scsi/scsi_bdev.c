@@ -1357,6 +1357,7 @@ spdk_bdev_scsi_write(struct spdk_bdev *bdev,
 	uint64_t offset;
 	uint64_t nbytes;
 	struct spdk_scsi_task *primary = task->parent;
+	struct spdk_bdev_io_hints hints = {};
 
 	if (len == 0) {
 		task->data_transferred = 0;
@@ -1385,10 +1386,11 @@ spdk_bdev_scsi_write(struct spdk_bdev *bdev,
 	}
 
 	offset += task->offset;
-	task->blockdev_io = spdk_bdev_writev(bdev, task->ch, &task->iov,
-					     1, offset, task->length,
-					     spdk_bdev_scsi_task_complete,
-					     task);
+	hints.write_stream = task->lun->dev->write_stream;
+	task->blockdev_io = spdk_bdev_writev_with_hints(bdev, task->ch, &task->iov,
+			    1, offset, task->length, &hints,
+			    spdk_bdev_scsi_task_complete,
+			    task);
 
 	if (!task->blockdev_io) {
 		SPDK_ERRLOG("spdk_bdev_writev failed\n");
@@ -0,0 +1,105 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "spdk/crc32.h"
+
+#ifdef __SSE4_2__
+#include <x86intrin.h>
+#define SPDK_CRC32C_USE_SSE42
+#endif
+
+#ifdef SPDK_CRC32C_USE_SSE42
+
+/* The SSE4.2 crc32 instruction implements exactly the reflected CRC-32C polynomial. */
+uint32_t
+spdk_crc32c_update(const void *buf, size_t len, uint32_t crc)
+{
+	const uint8_t *p = buf;
+	uint64_t crc64 = crc;
+	uint64_t val;
+
+	while (len >= sizeof(val)) {
+		memcpy(&val, p, sizeof(val));
+		crc64 = _mm_crc32_u64(crc64, val);
+		p += sizeof(val);
+		len -= sizeof(val);
+	}
+
+	crc = (uint32_t)crc64;
+	while (len > 0) {
+		crc = _mm_crc32_u8(crc, *p);
+		p++;
+		len--;
+	}
+
+	return crc;
+}
+
+#else
+
+static uint32_t g_crc32c_table[256];
+
+__attribute__((constructor)) static void
+crc32c_init_table(void)
+{
+	uint32_t i, j, val;
+
+	for (i = 0; i < 256; i++) {
+		val = i;
+		for (j = 0; j < 8; j++) {
+			if (val & 1) {
+				val = (val >> 1) ^ SPDK_CRC32C_POLYNOMIAL_REFLECTED;
+			} else {
+				val = val >> 1;
+			}
+		}
+		g_crc32c_table[i] = val;
+	}
+}
+
+uint32_t
+spdk_crc32c_update(const void *buf, size_t len, uint32_t crc)
+{
+	const uint8_t *p = buf;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		crc = (crc >> 8) ^ g_crc32c_table[(crc ^ p[i]) & 0xff];
+	}
+
+	return crc;
+}
+
+#endif
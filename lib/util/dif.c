@@ -0,0 +1,518 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "spdk/dif.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "spdk/crc16.h"
+#include "spdk/endian.h"
+
+/* Protection information as stored in the metadata, big-endian. */
+struct spdk_dif {
+	uint16_t	guard;
+	uint16_t	app_tag;
+	uint32_t	ref_tag;
+};
+
+/* Cursor over a scatter gather list. */
+struct _dif_sgl {
+	struct iovec	*iov;
+	int		iovcnt;
+	uint32_t	iov_offset;
+};
+
+static bool
+_dif_sgl_is_valid(struct iovec *iovs, int iovcnt, uint64_t bytes)
+{
+	uint64_t total = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		total += iovs[i].iov_len;
+	}
+
+	return total >= bytes;
+}
+
+static void
+_dif_sgl_advance(struct _dif_sgl *sgl, uint32_t step)
+{
+	sgl->iov_offset += step;
+	while (sgl->iovcnt != 0 && sgl->iov_offset >= sgl->iov->iov_len) {
+		sgl->iov_offset -= sgl->iov->iov_len;
+		sgl->iov++;
+		sgl->iovcnt--;
+	}
+}
+
+static void
+_dif_sgl_init(struct _dif_sgl *sgl, struct iovec *iovs, int iovcnt)
+{
+	sgl->iov = iovs;
+	sgl->iovcnt = iovcnt;
+	sgl->iov_offset = 0;
+	_dif_sgl_advance(sgl, 0);
+}
+
+/*
+ * Return the contiguous part of the next len bytes.  Callers have validated the total length,
+ *  so the cursor never runs past the last iovec here.
+ */
+static uint32_t
+_dif_sgl_get_buf(struct _dif_sgl *sgl, uint8_t **buf, uint32_t len)
+{
+	uint32_t avail = sgl->iov->iov_len - sgl->iov_offset;
+
+	*buf = (uint8_t *)sgl->iov->iov_base + sgl->iov_offset;
+
+	return len < avail ? len : avail;
+}
+
+static uint16_t
+_dif_sgl_crc(struct _dif_sgl *sgl, uint32_t len, uint16_t crc)
+{
+	uint8_t *buf;
+	uint32_t n;
+
+	while (len != 0) {
+		n = _dif_sgl_get_buf(sgl, &buf, len);
+		crc = spdk_crc16_t10dif(crc, buf, n);
+		_dif_sgl_advance(sgl, n);
+		len -= n;
+	}
+
+	return crc;
+}
+
+static void
+_dif_sgl_read(struct _dif_sgl *sgl, void *dst, uint32_t len)
+{
+	uint8_t *buf;
+	uint32_t n;
+
+	while (len != 0) {
+		n = _dif_sgl_get_buf(sgl, &buf, len);
+		memcpy(dst, buf, n);
+		_dif_sgl_advance(sgl, n);
+		dst = (uint8_t *)dst + n;
+		len -= n;
+	}
+}
+
+static void
+_dif_sgl_write(struct _dif_sgl *sgl, const void *src, uint32_t len)
+{
+	uint8_t *buf;
+	uint32_t n;
+
+	while (len != 0) {
+		n = _dif_sgl_get_buf(sgl, &buf, len);
+		memcpy(buf, src, n);
+		_dif_sgl_advance(sgl, n);
+		src = (const uint8_t *)src + n;
+		len -= n;
+	}
+}
+
+static void
+_dif_sgl_copy(struct _dif_sgl *dst, struct _dif_sgl *src, uint32_t len)
+{
+	uint8_t *buf;
+	uint32_t n;
+
+	while (len != 0) {
+		n = _dif_sgl_get_buf(src, &buf, len);
+		_dif_sgl_write(dst, buf, n);
+		_dif_sgl_advance(src, n);
+		len -= n;
+	}
+}
+
+static inline uint32_t
+_dif_data_size(const struct spdk_dif_ctx *ctx)
+{
+	return ctx->md_interleave ? ctx->block_size - ctx->md_size : ctx->block_size;
+}
+
+/* Number of metadata bytes following the protection information. */
+static inline uint32_t
+_dif_pi_tail(const struct spdk_dif_ctx *ctx)
+{
+	uint32_t ext_size = ctx->md_interleave ? ctx->block_size : ctx->block_size + ctx->md_size;
+
+	return ext_size - ctx->guard_interval - SPDK_DIF_PI_SIZE;
+}
+
+static inline uint32_t
+_dif_ref_tag(const struct spdk_dif_ctx *ctx, uint32_t offset_blocks)
+{
+	if (ctx->dif_type == SPDK_DIF_TYPE3) {
+		return ctx->init_ref_tag;
+	}
+
+	return ctx->init_ref_tag + offset_blocks;
+}
+
+int
+spdk_dif_ctx_init(struct spdk_dif_ctx *ctx, uint32_t block_size, uint32_t md_size,
+		  bool md_interleave, bool dif_loc, enum spdk_dif_type dif_type,
+		  uint32_t dif_flags, uint32_t init_ref_tag, uint16_t apptag_mask,
+		  uint16_t app_tag, uint16_t guard_seed)
+{
+	uint32_t data_size;
+
+	if (md_size < SPDK_DIF_PI_SIZE) {
+		return -EINVAL;
+	}
+
+	if (md_interleave) {
+		if (block_size <= md_size) {
+			return -EINVAL;
+		}
+		data_size = block_size - md_size;
+	} else {
+		if (block_size == 0) {
+			return -EINVAL;
+		}
+		data_size = block_size;
+	}
+
+	switch (dif_type) {
+	case SPDK_DIF_TYPE1:
+	case SPDK_DIF_TYPE2:
+	case SPDK_DIF_TYPE3:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	ctx->block_size = block_size;
+	ctx->md_size = md_size;
+	ctx->md_interleave = md_interleave;
+	ctx->guard_interval = data_size + (dif_loc ? 0 : md_size - SPDK_DIF_PI_SIZE);
+	ctx->dif_type = dif_type;
+	ctx->dif_flags = dif_flags;
+	ctx->init_ref_tag = init_ref_tag;
+	ctx->apptag_mask = apptag_mask;
+	ctx->app_tag = app_tag;
+	ctx->guard_seed = guard_seed;
+
+	return 0;
+}
+
+static void
+_dif_generate_pi(struct spdk_dif *dif, uint16_t guard, uint32_t offset_blocks,
+		 const struct spdk_dif_ctx *ctx)
+{
+	to_be16(&dif->guard, guard);
+	to_be16(&dif->app_tag, ctx->app_tag);
+	to_be32(&dif->ref_tag, _dif_ref_tag(ctx, offset_blocks));
+}
+
+static int
+_dif_verify_pi(struct spdk_dif *dif, uint16_t guard, uint32_t offset_blocks,
+	       const struct spdk_dif_ctx *ctx, struct spdk_dif_error *err_blk)
+{
+	uint16_t app_tag = from_be16(&dif->app_tag);
+	uint32_t ref_tag = from_be32(&dif->ref_tag);
+	struct spdk_dif_error err;
+
+	/* An all-ones application tag (and, for type 3, reference tag) disables checking. */
+	if (app_tag == 0xFFFF) {
+		if (ctx->dif_type != SPDK_DIF_TYPE3 || ref_tag == 0xFFFFFFFF) {
+			return 0;
+		}
+	}
+
+	if ((ctx->dif_flags & SPDK_DIF_FLAGS_GUARD_CHECK) && from_be16(&dif->guard) != guard) {
+		err.err_type = SPDK_DIF_GUARD_ERROR;
+		err.expected = guard;
+		err.actual = from_be16(&dif->guard);
+	} else if ((ctx->dif_flags & SPDK_DIF_FLAGS_APPTAG_CHECK) &&
+		   (app_tag & ctx->apptag_mask) != (ctx->app_tag & ctx->apptag_mask)) {
+		err.err_type = SPDK_DIF_APPTAG_ERROR;
+		err.expected = ctx->app_tag & ctx->apptag_mask;
+		err.actual = app_tag & ctx->apptag_mask;
+	} else if ((ctx->dif_flags & SPDK_DIF_FLAGS_REFTAG_CHECK) &&
+		   ctx->dif_type != SPDK_DIF_TYPE3 &&
+		   ref_tag != _dif_ref_tag(ctx, offset_blocks)) {
+		err.err_type = SPDK_DIF_REFTAG_ERROR;
+		err.expected = _dif_ref_tag(ctx, offset_blocks);
+		err.actual = ref_tag;
+	} else {
+		return 0;
+	}
+
+	if (err_blk) {
+		err.err_offset = offset_blocks;
+		*err_blk = err;
+	}
+
+	return -EIO;
+}
+
+/*
+ * Compute the guard over ctx->guard_interval bytes of an extended block, leaving the cursor at
+ *  the protection information.
+ */
+static uint16_t
+_dif_guard(struct _dif_sgl *sgl, const struct spdk_dif_ctx *ctx)
+{
+	if (ctx->dif_flags & SPDK_DIF_FLAGS_GUARD_CHECK) {
+		return _dif_sgl_crc(sgl, ctx->guard_interval, ctx->guard_seed);
+	}
+
+	_dif_sgl_advance(sgl, ctx->guard_interval);
+	return 0;
+}
+
+int
+spdk_dif_generate(struct iovec *iovs, int iovcnt, uint32_t num_blocks,
+		  const struct spdk_dif_ctx *ctx)
+{
+	struct _dif_sgl sgl;
+	struct spdk_dif dif;
+	uint32_t offset_blocks;
+	uint16_t guard;
+
+	if (!ctx->md_interleave ||
+	    !_dif_sgl_is_valid(iovs, iovcnt, (uint64_t)ctx->block_size * num_blocks)) {
+		return -EINVAL;
+	}
+
+	_dif_sgl_init(&sgl, iovs, iovcnt);
+
+	for (offset_blocks = 0; offset_blocks < num_blocks; offset_blocks++) {
+		guard = _dif_guard(&sgl, ctx);
+		_dif_generate_pi(&dif, guard, offset_blocks, ctx);
+		_dif_sgl_write(&sgl, &dif, sizeof(dif));
+		_dif_sgl_advance(&sgl, _dif_pi_tail(ctx));
+	}
+
+	return 0;
+}
+
+int
+spdk_dif_verify(struct iovec *iovs, int iovcnt, uint32_t num_blocks,
+		const struct spdk_dif_ctx *ctx, struct spdk_dif_error *err_blk)
+{
+	struct _dif_sgl sgl;
+	struct spdk_dif dif;
+	uint32_t offset_blocks;
+	uint16_t guard;
+	int rc;
+
+	if (!ctx->md_interleave ||
+	    !_dif_sgl_is_valid(iovs, iovcnt, (uint64_t)ctx->block_size * num_blocks)) {
+		return -EINVAL;
+	}
+
+	_dif_sgl_init(&sgl, iovs, iovcnt);
+
+	for (offset_blocks = 0; offset_blocks < num_blocks; offset_blocks++) {
+		guard = _dif_guard(&sgl, ctx);
+		_dif_sgl_read(&sgl, &dif, sizeof(dif));
+		_dif_sgl_advance(&sgl, _dif_pi_tail(ctx));
+
+		rc = _dif_verify_pi(&dif, guard, offset_blocks, ctx, err_blk);
+		if (rc != 0) {
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+int
+spdk_dif_insert(struct iovec *src_iovs, int src_iovcnt, struct iovec *dst_iovs,
+		int dst_iovcnt, uint32_t num_blocks, const struct spdk_dif_ctx *ctx)
+{
+	struct _dif_sgl src, dst, blk;
+	struct spdk_dif dif;
+	uint32_t offset_blocks, data_size;
+	uint16_t guard;
+
+	data_size = _dif_data_size(ctx);
+
+	if (!ctx->md_interleave ||
+	    !_dif_sgl_is_valid(src_iovs, src_iovcnt, (uint64_t)data_size * num_blocks) ||
+	    !_dif_sgl_is_valid(dst_iovs, dst_iovcnt, (uint64_t)ctx->block_size * num_blocks)) {
+		return -EINVAL;
+	}
+
+	_dif_sgl_init(&src, src_iovs, src_iovcnt);
+	_dif_sgl_init(&dst, dst_iovs, dst_iovcnt);
+
+	for (offset_blocks = 0; offset_blocks < num_blocks; offset_blocks++) {
+		blk = dst;
+		_dif_sgl_copy(&dst, &src, data_size);
+
+		/* The copied data is still in cache, so read it back for the guard. */
+		guard = _dif_guard(&blk, ctx);
+		_dif_generate_pi(&dif, guard, offset_blocks, ctx);
+		_dif_sgl_write(&blk, &dif, sizeof(dif));
+		_dif_sgl_advance(&blk, _dif_pi_tail(ctx));
+		dst = blk;
+	}
+
+	return 0;
+}
+
+int
+spdk_dif_strip(struct iovec *src_iovs, int src_iovcnt, struct iovec *dst_iovs,
+	       int dst_iovcnt, uint32_t num_blocks, const struct spdk_dif_ctx *ctx,
+	       struct spdk_dif_error *err_blk)
+{
+	struct _dif_sgl src, dst, blk;
+	struct spdk_dif dif;
+	uint32_t offset_blocks, data_size;
+	uint16_t guard;
+	int rc;
+
+	data_size = _dif_data_size(ctx);
+
+	if (!ctx->md_interleave ||
+	    !_dif_sgl_is_valid(src_iovs, src_iovcnt, (uint64_t)ctx->block_size * num_blocks) ||
+	    !_dif_sgl_is_valid(dst_iovs, dst_iovcnt, (uint64_t)data_size * num_blocks)) {
+		return -EINVAL;
+	}
+
+	_dif_sgl_init(&src, src_iovs, src_iovcnt);
+	_dif_sgl_init(&dst, dst_iovs, dst_iovcnt);
+
+	for (offset_blocks = 0; offset_blocks < num_blocks; offset_blocks++) {
+		blk = src;
+		guard = _dif_guard(&src, ctx);
+		_dif_sgl_read(&src, &dif, sizeof(dif));
+		_dif_sgl_advance(&src, _dif_pi_tail(ctx));
+
+		rc = _dif_verify_pi(&dif, guard, offset_blocks, ctx, err_blk);
+		if (rc != 0) {
+			return rc;
+		}
+
+		_dif_sgl_copy(&dst, &blk, data_size);
+	}
+
+	return 0;
+}
+
+/*
+ * Compute the guard over a data block and the metadata preceding the protection information,
+ *  leaving the metadata cursor at the protection information.
+ */
+static uint16_t
+_dix_guard(struct _dif_sgl *data_sgl, struct _dif_sgl *md_sgl, const struct spdk_dif_ctx *ctx)
+{
+	uint32_t md_len = ctx->guard_interval - ctx->block_size;
+	uint16_t guard;
+
+	if (!(ctx->dif_flags & SPDK_DIF_FLAGS_GUARD_CHECK)) {
+		_dif_sgl_advance(data_sgl, ctx->block_size);
+		_dif_sgl_advance(md_sgl, md_len);
+		return 0;
+	}
+
+	guard = _dif_sgl_crc(data_sgl, ctx->block_size, ctx->guard_seed);
+	return _dif_sgl_crc(md_sgl, md_len, guard);
+}
+
+static bool
+_dix_is_valid(struct iovec *iovs, int iovcnt, struct iovec *md_iov, uint32_t num_blocks,
+	      const struct spdk_dif_ctx *ctx)
+{
+	return !ctx->md_interleave &&
+	       _dif_sgl_is_valid(iovs, iovcnt, (uint64_t)ctx->block_size * num_blocks) &&
+	       _dif_sgl_is_valid(md_iov, 1, (uint64_t)ctx->md_size * num_blocks);
+}
+
+int
+spdk_dix_generate(struct iovec *iovs, int iovcnt, struct iovec *md_iov,
+		  uint32_t num_blocks, const struct spdk_dif_ctx *ctx)
+{
+	struct _dif_sgl data_sgl, md_sgl;
+	struct spdk_dif dif;
+	uint32_t offset_blocks;
+	uint16_t guard;
+
+	if (!_dix_is_valid(iovs, iovcnt, md_iov, num_blocks, ctx)) {
+		return -EINVAL;
+	}
+
+	_dif_sgl_init(&data_sgl, iovs, iovcnt);
+	_dif_sgl_init(&md_sgl, md_iov, 1);
+
+	for (offset_blocks = 0; offset_blocks < num_blocks; offset_blocks++) {
+		guard = _dix_guard(&data_sgl, &md_sgl, ctx);
+		_dif_generate_pi(&dif, guard, offset_blocks, ctx);
+		_dif_sgl_write(&md_sgl, &dif, sizeof(dif));
+		_dif_sgl_advance(&md_sgl, _dif_pi_tail(ctx));
+	}
+
+	return 0;
+}
+
+int
+spdk_dix_verify(struct iovec *iovs, int iovcnt, struct iovec *md_iov,
+		uint32_t num_blocks, const struct spdk_dif_ctx *ctx,
+		struct spdk_dif_error *err_blk)
+{
+	struct _dif_sgl data_sgl, md_sgl;
+	struct spdk_dif dif;
+	uint32_t offset_blocks;
+	uint16_t guard;
+	int rc;
+
+	if (!_dix_is_valid(iovs, iovcnt, md_iov, num_blocks, ctx)) {
+		return -EINVAL;
+	}
+
+	_dif_sgl_init(&data_sgl, iovs, iovcnt);
+	_dif_sgl_init(&md_sgl, md_iov, 1);
+
+	for (offset_blocks = 0; offset_blocks < num_blocks; offset_blocks++) {
+		guard = _dix_guard(&data_sgl, &md_sgl, ctx);
+		_dif_sgl_read(&md_sgl, &dif, sizeof(dif));
+		_dif_sgl_advance(&md_sgl, _dif_pi_tail(ctx));
+
+		rc = _dif_verify_pi(&dif, guard, offset_blocks, ctx, err_blk);
+		if (rc != 0) {
+			return rc;
+		}
+	}
+
+	return 0;
+}
@@ -36,6 +36,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #include "spdk/io_channel.h"
 #include "spdk/log.h"
@@ -137,8 +138,8 @@ spdk_get_io_channel(void *io_device, uint32_t priority, bool unique, void *uniqu
 	struct io_device *dev;
 	int rc;
 
-	if (priority != SPDK_IO_PRIORITY_DEFAULT) {
-		SPDK_ERRLOG("priority must be set to SPDK_IO_PRIORITY_DEFAULT\n");
+	if (priority > SPDK_IO_PRIORITY_LOW) {
+		SPDK_ERRLOG("priority %u is out of range\n", priority);
 		return NULL;
 	}
 
@@ -193,6 +194,24 @@ spdk_get_io_channel(void *io_device, uint32_t priority, bool unique, void *uniqu
 	return ch;
 }
 
+int
+spdk_io_priority_parse(const char *name, uint32_t *priority)
+{
+	if (strcasecmp(name, "Urgent") == 0) {
+		*priority = SPDK_IO_PRIORITY_URGENT;
+	} else if (strcasecmp(name, "High") == 0) {
+		*priority = SPDK_IO_PRIORITY_HIGH;
+	} else if (strcasecmp(name, "Default") == 0) {
+		*priority = SPDK_IO_PRIORITY_DEFAULT;
+	} else if (strcasecmp(name, "Low") == 0) {
+		*priority = SPDK_IO_PRIORITY_LOW;
+	} else {
+		return -1;
+	}
+
+	return 0;
+}
+
 void
 spdk_put_io_channel(struct spdk_io_channel *ch)
 {
@@ -308,6 +308,12 @@ def get_nvmf_subsystems(args):
 p = subparsers.add_parser('get_nvmf_subsystems', help='Display nvmf subsystems')
 p.set_defaults(func=get_nvmf_subsystems)
 
+def get_nvmf_stats(args):
+    print_dict(jsonrpc_call('get_nvmf_stats'))
+
+p = subparsers.add_parser('get_nvmf_stats', help='Display nvmf connection statistics')
+p.set_defaults(func=get_nvmf_stats)
+
 def construct_nvmf_subsystem(args):
     namespaces = []
     hosts = []
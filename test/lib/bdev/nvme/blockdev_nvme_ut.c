@@ -0,0 +1,815 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spdk_cunit.h"
+
+#include "blockdev_nvme.c"
+
+struct spdk_nvme_ctrlr {
+	bool			is_failed;
+	uint32_t		num_resets;
+};
+
+struct spdk_nvme_ns {
+	struct spdk_nvme_ns_data	nsdata;
+};
+
+struct spdk_nvme_qpair {
+	uint32_t		path;
+};
+
+struct spdk_io_channel {
+	void			*ctx;
+};
+
+#define UT_NUM_PATHS	3
+
+int32_t spdk_nvme_retry_count;
+
+static struct spdk_nvme_ctrlr		g_ut_ctrlr[UT_NUM_PATHS];
+static struct spdk_nvme_ns		g_ut_ns[UT_NUM_PATHS];
+static struct spdk_nvme_qpair		g_ut_qpair[UT_NUM_PATHS];
+static struct nvme_io_channel		g_ut_nvme_ch[UT_NUM_PATHS];
+static struct spdk_io_channel		g_ut_path_ch[UT_NUM_PATHS];
+static uint32_t				g_ut_submit_path[8];
+static uint32_t				g_ut_num_submits;
+static int				g_ut_submit_rc;
+static int				g_ut_reset_rc;
+static void				*g_ut_submit_payload;
+static bool				g_ut_io_completed;
+static enum spdk_bdev_io_status		g_ut_io_status;
+
+void
+spdk_bdev_register(struct spdk_bdev *bdev)
+{
+}
+
+void
+spdk_bdev_module_list_add(struct spdk_bdev_module_if *bdev_module)
+{
+}
+
+void
+spdk_bdev_io_get_rbuf(struct spdk_bdev_io *bdev_io, spdk_bdev_io_get_rbuf_cb cb)
+{
+}
+
+void
+spdk_bdev_io_complete(struct spdk_bdev_io *bdev_io, enum spdk_bdev_io_status status)
+{
+	g_ut_io_completed = true;
+	g_ut_io_status = status;
+}
+
+void
+spdk_io_device_register(void *io_device, io_channel_create_cb_t create_cb,
+			io_channel_destroy_cb_t destroy_cb, uint32_t ctx_size)
+{
+}
+
+struct spdk_io_channel *
+spdk_get_io_channel(void *io_device, uint32_t priority, bool unique, void *unique_ctx)
+{
+	return NULL;
+}
+
+void
+spdk_put_io_channel(struct spdk_io_channel *ch)
+{
+}
+
+void *
+spdk_io_channel_get_ctx(struct spdk_io_channel *ch)
+{
+	return ch->ctx;
+}
+
+uint32_t
+spdk_app_get_current_core(void)
+{
+	return 0;
+}
+
+void
+spdk_poller_register(struct spdk_poller **ppoller, spdk_poller_fn fn, void *arg,
+		     uint32_t lcore, struct spdk_event *complete, uint64_t period_microseconds)
+{
+}
+
+void
+spdk_poller_register_interrupt(struct spdk_poller **ppoller, spdk_poller_fn fn, void *arg,
+			       uint32_t lcore, struct spdk_event *complete, int intr_fd,
+			       spdk_poller_intr_fn intr_fn)
+{
+}
+
+void
+spdk_poller_unregister(struct spdk_poller **ppoller, struct spdk_event *complete)
+{
+}
+
+void
+spdk_poller_set_busy(void)
+{
+}
+
+struct spdk_conf_section *
+spdk_conf_find_section(struct spdk_conf *cp, const char *name)
+{
+	return NULL;
+}
+
+char *
+spdk_conf_section_get_val(struct spdk_conf_section *sp, const char *key)
+{
+	return NULL;
+}
+
+char *
+spdk_conf_section_get_nmval(struct spdk_conf_section *sp, const char *key, int idx1, int idx2)
+{
+	return NULL;
+}
+
+int
+spdk_conf_section_get_intval(struct spdk_conf_section *sp, const char *key)
+{
+	return -1;
+}
+
+uint64_t
+spdk_vtophys(void *buf)
+{
+	return (uintptr_t)buf;
+}
+
+int
+spdk_pci_device_claim(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint16_t
+spdk_pci_device_get_domain(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_bus(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_dev(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_func(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+int
+spdk_nvme_probe(void *cb_ctx, spdk_nvme_probe_cb probe_cb, spdk_nvme_attach_cb attach_cb,
+		spdk_nvme_remove_cb remove_cb)
+{
+	return 0;
+}
+
+struct spdk_nvme_ctrlr *
+spdk_nvme_connect(const struct spdk_nvme_transport_id *trid,
+		  const struct spdk_nvme_ctrlr_opts *opts)
+{
+	return NULL;
+}
+
+int
+spdk_nvme_transport_id_parse(struct spdk_nvme_transport_id *trid, const char *str)
+{
+	return -1;
+}
+
+void
+spdk_nvme_ctrlr_opts_set_defaults(struct spdk_nvme_ctrlr_opts *opts)
+{
+}
+
+int
+spdk_nvme_detach(struct spdk_nvme_ctrlr *ctrlr)
+{
+	return 0;
+}
+
+int
+spdk_nvme_ctrlr_reset(struct spdk_nvme_ctrlr *ctrlr)
+{
+	ctrlr->num_resets++;
+	return g_ut_reset_rc;
+}
+
+bool
+spdk_nvme_ctrlr_is_failed(struct spdk_nvme_ctrlr *ctrlr)
+{
+	return ctrlr->is_failed;
+}
+
+const struct spdk_nvme_ctrlr_data *
+spdk_nvme_ctrlr_get_data(struct spdk_nvme_ctrlr *ctrlr)
+{
+	return NULL;
+}
+
+uint32_t
+spdk_nvme_ctrlr_get_num_ns(struct spdk_nvme_ctrlr *ctrlr)
+{
+	return 0;
+}
+
+struct spdk_nvme_ns *
+spdk_nvme_ctrlr_get_ns(struct spdk_nvme_ctrlr *ctrlr, uint32_t ns_id)
+{
+	return NULL;
+}
+
+void
+spdk_nvme_ctrlr_register_aer_callback(struct spdk_nvme_ctrlr *ctrlr, spdk_nvme_aer_cb aer_cb_fn,
+				      void *aer_cb_arg)
+{
+}
+
+int32_t
+spdk_nvme_ctrlr_process_admin_completions(struct spdk_nvme_ctrlr *ctrlr)
+{
+	return 0;
+}
+
+void *
+spdk_nvme_ctrlr_alloc_cmb_io_buffer(struct spdk_nvme_ctrlr *ctrlr, size_t size)
+{
+	return NULL;
+}
+
+void
+spdk_nvme_ctrlr_free_cmb_io_buffer(struct spdk_nvme_ctrlr *ctrlr, void *buf, size_t size)
+{
+}
+
+void
+spdk_nvme_ctrlr_get_default_io_qpair_opts(struct spdk_nvme_ctrlr *ctrlr,
+		struct spdk_nvme_io_qpair_opts *opts)
+{
+}
+
+struct spdk_nvme_qpair *
+spdk_nvme_ctrlr_alloc_io_qpair_with_opts(struct spdk_nvme_ctrlr *ctrlr,
+		const struct spdk_nvme_io_qpair_opts *opts)
+{
+	return NULL;
+}
+
+int
+spdk_nvme_ctrlr_free_io_qpair(struct spdk_nvme_qpair *qpair)
+{
+	return 0;
+}
+
+int
+spdk_nvme_qpair_get_interrupt_fd(struct spdk_nvme_qpair *qpair)
+{
+	return -1;
+}
+
+int
+spdk_nvme_qpair_mask_interrupt(struct spdk_nvme_qpair *qpair, bool mask)
+{
+	return 0;
+}
+
+int32_t
+spdk_nvme_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_completions)
+{
+	return 0;
+}
+
+const struct spdk_nvme_ns_data *
+spdk_nvme_ns_get_data(struct spdk_nvme_ns *ns)
+{
+	return &ns->nsdata;
+}
+
+uint32_t
+spdk_nvme_ns_get_id(struct spdk_nvme_ns *ns)
+{
+	return 1;
+}
+
+uint32_t
+spdk_nvme_ns_get_sector_size(struct spdk_nvme_ns *ns)
+{
+	return 512;
+}
+
+uint64_t
+spdk_nvme_ns_get_num_sectors(struct spdk_nvme_ns *ns)
+{
+	return 1024;
+}
+
+uint16_t
+spdk_nvme_ns_get_max_write_streams(struct spdk_nvme_ns *ns)
+{
+	return 0;
+}
+
+int
+spdk_nvme_ns_cmd_read_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				 void *payload, uint64_t lba, uint32_t lba_count,
+				 spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				 uint8_t dsm)
+{
+	if (g_ut_submit_rc != 0) {
+		return g_ut_submit_rc;
+	}
+
+	SPDK_CU_ASSERT_FATAL(g_ut_num_submits < sizeof(g_ut_submit_path) / sizeof(g_ut_submit_path[0]));
+	g_ut_submit_path[g_ut_num_submits++] = qpair->path;
+	g_ut_submit_payload = payload;
+	return 0;
+}
+
+int
+spdk_nvme_ns_cmd_readv_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				  uint64_t lba, uint32_t lba_count,
+				  spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				  spdk_nvme_req_reset_sgl_cb reset_sgl_fn,
+				  spdk_nvme_req_next_sge_cb next_sge_fn, uint8_t dsm)
+{
+	return -1;
+}
+
+int
+spdk_nvme_ns_cmd_write_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				  void *payload, uint64_t lba, uint32_t lba_count,
+				  spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				  uint8_t dsm, uint16_t stream_id)
+{
+	if (g_ut_submit_rc != 0) {
+		return g_ut_submit_rc;
+	}
+
+	SPDK_CU_ASSERT_FATAL(g_ut_num_submits < sizeof(g_ut_submit_path) / sizeof(g_ut_submit_path[0]));
+	g_ut_submit_path[g_ut_num_submits++] = qpair->path;
+	g_ut_submit_payload = payload;
+	return 0;
+}
+
+int
+spdk_nvme_ns_cmd_writev_with_hints(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				   uint64_t lba, uint32_t lba_count,
+				   spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t io_flags,
+				   spdk_nvme_req_reset_sgl_cb reset_sgl_fn,
+				   spdk_nvme_req_next_sge_cb next_sge_fn,
+				   uint8_t dsm, uint16_t stream_id)
+{
+	return -1;
+}
+
+int
+spdk_nvme_ns_cmd_dataset_management(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				    uint32_t type, const struct spdk_nvme_dsm_range *ranges,
+				    uint16_t num_ranges, spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+	return -1;
+}
+
+/* A blockdev reachable through UT_NUM_PATHS controllers, with a multipath I/O channel. */
+static void
+ut_init_multipath(struct nvme_blockdev *nbdev, struct nvme_mp_io_channel *mp_ch)
+{
+	uint32_t i;
+
+	memset(nbdev, 0, sizeof(*nbdev));
+	memset(mp_ch, 0, sizeof(*mp_ch));
+	memset(g_ut_ctrlr, 0, sizeof(g_ut_ctrlr));
+
+	nbdev->num_paths = UT_NUM_PATHS;
+	nbdev->blocklen = 512;
+	nbdev->lba_end = 1023;
+
+	for (i = 0; i < UT_NUM_PATHS; i++) {
+		nbdev->paths[i].ctrlr = &g_ut_ctrlr[i];
+		nbdev->paths[i].ns = &g_ut_ns[i];
+		g_ut_qpair[i].path = i;
+		g_ut_nvme_ch[i].qpair = &g_ut_qpair[i];
+		g_ut_path_ch[i].ctx = &g_ut_nvme_ch[i];
+		mp_ch->path_ch[i] = &g_ut_path_ch[i];
+	}
+
+	g_multipath_policy = NVME_MULTIPATH_ROUND_ROBIN;
+	g_ut_num_submits = 0;
+	g_ut_submit_rc = 0;
+	g_ut_reset_rc = 0;
+	g_ut_io_completed = false;
+}
+
+static void
+test_nvme_ns_same_identifier(void)
+{
+	struct spdk_nvme_ns ns1 = {}, ns2 = {};
+
+	/* Namespaces without any identifier are never grouped, even though both are zero */
+	CU_ASSERT(nvme_ns_same_identifier(&ns1, &ns2) == false);
+
+	/* EUI64 is compared when the NGUID is zero */
+	ns1.nsdata.eui64 = 0x1122334455667788ULL;
+	ns2.nsdata.eui64 = 0x1122334455667788ULL;
+	CU_ASSERT(nvme_ns_same_identifier(&ns1, &ns2) == true);
+	ns2.nsdata.eui64 = 0x1122334455667789ULL;
+	CU_ASSERT(nvme_ns_same_identifier(&ns1, &ns2) == false);
+	ns2.nsdata.eui64 = 0;
+	CU_ASSERT(nvme_ns_same_identifier(&ns1, &ns2) == false);
+
+	/* A non-zero NGUID takes precedence over a matching EUI64 */
+	ns2.nsdata.eui64 = ns1.nsdata.eui64;
+	ns1.nsdata.nguid[0] = 0xAB;
+	ns1.nsdata.nguid[15] = 0xCD;
+	CU_ASSERT(nvme_ns_same_identifier(&ns1, &ns2) == false);
+	memcpy(ns2.nsdata.nguid, ns1.nsdata.nguid, sizeof(ns2.nsdata.nguid));
+	CU_ASSERT(nvme_ns_same_identifier(&ns1, &ns2) == true);
+	ns2.nsdata.eui64 = 0;
+	CU_ASSERT(nvme_ns_same_identifier(&ns1, &ns2) == true);
+	ns2.nsdata.nguid[15] = 0xCE;
+	CU_ASSERT(nvme_ns_same_identifier(&ns1, &ns2) == false);
+}
+
+static void
+test_select_path_round_robin(void)
+{
+	struct nvme_blockdev nbdev;
+	struct nvme_mp_io_channel mp_ch;
+	struct nvme_blockio bio = {};
+
+	ut_init_multipath(&nbdev, &mp_ch);
+	bio.mp_ch = &mp_ch;
+
+	/* Paths are used in turn, regardless of their queue depth */
+	mp_ch.outstanding[1] = 10;
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 0);
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 1);
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 2);
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 0);
+
+	/* Failed controllers and paths without an I/O channel are skipped */
+	g_ut_ctrlr[1].is_failed = true;
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 2);
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 0);
+	mp_ch.path_ch[2] = NULL;
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 0);
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 0);
+
+	/* Paths the I/O was already tried on are skipped */
+	g_ut_ctrlr[1].is_failed = false;
+	mp_ch.path_ch[2] = &g_ut_path_ch[2];
+	bio.tried_paths = (1U << 0) | (1U << 2);
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 1);
+	bio.tried_paths = (1U << UT_NUM_PATHS) - 1;
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == -1);
+}
+
+static void
+test_select_path_least_queue_depth(void)
+{
+	struct nvme_blockdev nbdev;
+	struct nvme_mp_io_channel mp_ch;
+	struct nvme_blockio bio = {};
+
+	ut_init_multipath(&nbdev, &mp_ch);
+	g_multipath_policy = NVME_MULTIPATH_LEAST_QUEUE_DEPTH;
+	bio.mp_ch = &mp_ch;
+
+	mp_ch.outstanding[0] = 3;
+	mp_ch.outstanding[1] = 1;
+	mp_ch.outstanding[2] = 2;
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 1);
+	CU_ASSERT(mp_ch.next_path == 2);
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 1);
+
+	/* Ties go to the first path in round robin order */
+	mp_ch.outstanding[0] = 1;
+	mp_ch.outstanding[2] = 1;
+	mp_ch.next_path = 2;
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 2);
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 0);
+
+	/* The shallowest path is skipped once its controller failed or the I/O was tried on it */
+	mp_ch.outstanding[0] = 0;
+	g_ut_ctrlr[0].is_failed = true;
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 1);
+	g_ut_ctrlr[0].is_failed = false;
+	bio.tried_paths = 1U << 0;
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == 2);
+	bio.tried_paths = (1U << UT_NUM_PATHS) - 1;
+	CU_ASSERT(blockdev_nvme_select_path(&nbdev, &bio) == -1);
+}
+
+static struct spdk_bdev_io *
+ut_alloc_read(struct nvme_blockdev *nbdev, struct spdk_io_channel *ch, struct iovec *iov)
+{
+	struct spdk_bdev_io *bdev_io;
+
+	bdev_io = calloc(1, sizeof(*bdev_io) + sizeof(struct nvme_blockio));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+
+	bdev_io->ctx = nbdev;
+	bdev_io->ch = ch;
+	bdev_io->type = SPDK_BDEV_IO_TYPE_READ;
+	bdev_io->u.read.iovs = iov;
+	bdev_io->u.read.iovcnt = 1;
+	bdev_io->u.read.nbytes = iov->iov_len;
+	bdev_io->u.read.offset = 0;
+
+	return bdev_io;
+}
+
+static void
+test_multipath_retry(void)
+{
+	struct nvme_blockdev nbdev;
+	struct nvme_mp_io_channel mp_ch;
+	struct spdk_io_channel ch = { .ctx = &mp_ch };
+	struct spdk_bdev_io *bdev_io;
+	struct nvme_blockio *bio;
+	struct spdk_nvme_cpl cpl = {};
+	char buf[512];
+	struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+
+	ut_init_multipath(&nbdev, &mp_ch);
+	bdev_io = ut_alloc_read(&nbdev, &ch, &iov);
+	bio = (struct nvme_blockio *)bdev_io->driver_ctx;
+
+	/* Success on the first path completes the I/O */
+	CU_ASSERT(blockdev_nvme_submit_rw(bdev_io) == 0);
+	CU_ASSERT(g_ut_num_submits == 1);
+	CU_ASSERT(g_ut_submit_path[0] == 0);
+	CU_ASSERT(mp_ch.outstanding[0] == 1);
+	queued_done(bio, &cpl);
+	CU_ASSERT(g_ut_io_completed == true);
+	CU_ASSERT(g_ut_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(mp_ch.outstanding[0] == 0);
+
+	/* Errors about the I/O itself are not retried on another path */
+	g_ut_io_completed = false;
+	g_ut_num_submits = 0;
+	CU_ASSERT(blockdev_nvme_submit_rw(bdev_io) == 0);
+	CU_ASSERT(g_ut_submit_path[0] == 1);
+	cpl.status.sct = SPDK_NVME_SCT_GENERIC;
+	cpl.status.sc = SPDK_NVME_SC_LBA_OUT_OF_RANGE;
+	queued_done(bio, &cpl);
+	CU_ASSERT(g_ut_num_submits == 1);
+	CU_ASSERT(g_ut_io_completed == true);
+	CU_ASSERT(g_ut_io_status == SPDK_BDEV_IO_STATUS_FAILED);
+	CU_ASSERT(mp_ch.outstanding[1] == 0);
+
+	/* Path errors are retried on every other path once, then the I/O fails */
+	g_ut_io_completed = false;
+	g_ut_num_submits = 0;
+	CU_ASSERT(blockdev_nvme_submit_rw(bdev_io) == 0);
+	cpl.status.sc = SPDK_NVME_SC_ABORTED_SQ_DELETION;
+	queued_done(bio, &cpl);
+	CU_ASSERT(g_ut_io_completed == false);
+	queued_done(bio, &cpl);
+	CU_ASSERT(g_ut_io_completed == false);
+	CU_ASSERT(bio->tried_paths == (1U << UT_NUM_PATHS) - 1);
+	queued_done(bio, &cpl);
+	CU_ASSERT(g_ut_io_completed == true);
+	CU_ASSERT(g_ut_io_status == SPDK_BDEV_IO_STATUS_FAILED);
+	CU_ASSERT(g_ut_num_submits == UT_NUM_PATHS);
+	CU_ASSERT(g_ut_submit_path[0] == 2);
+	CU_ASSERT(g_ut_submit_path[1] == 0);
+	CU_ASSERT(g_ut_submit_path[2] == 1);
+	CU_ASSERT(mp_ch.outstanding[0] == 0);
+	CU_ASSERT(mp_ch.outstanding[1] == 0);
+	CU_ASSERT(mp_ch.outstanding[2] == 0);
+
+	/* An error on a failed controller is a path error whatever its status */
+	g_ut_io_completed = false;
+	g_ut_num_submits = 0;
+	CU_ASSERT(blockdev_nvme_submit_rw(bdev_io) == 0);
+	CU_ASSERT(g_ut_submit_path[0] == 2);
+	g_ut_ctrlr[2].is_failed = true;
+	cpl.status.sc = SPDK_NVME_SC_INTERNAL_DEVICE_ERROR;
+	queued_done(bio, &cpl);
+	CU_ASSERT(g_ut_io_completed == false);
+	CU_ASSERT(g_ut_num_submits == 2);
+	CU_ASSERT(g_ut_submit_path[1] == 0);
+	CU_ASSERT(mp_ch.outstanding[2] == 0);
+	CU_ASSERT(mp_ch.outstanding[0] == 1);
+	memset(&cpl, 0, sizeof(cpl));
+	queued_done(bio, &cpl);
+	CU_ASSERT(g_ut_io_completed == true);
+	CU_ASSERT(g_ut_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	g_ut_ctrlr[2].is_failed = false;
+
+	/* Submission failures move on to the next path until none is left */
+	g_ut_submit_rc = -ENOMEM;
+	CU_ASSERT(blockdev_nvme_submit_rw(bdev_io) == -1);
+	CU_ASSERT(bio->tried_paths == (1U << UT_NUM_PATHS) - 1);
+	CU_ASSERT(mp_ch.outstanding[0] == 0);
+	CU_ASSERT(mp_ch.outstanding[1] == 0);
+	CU_ASSERT(mp_ch.outstanding[2] == 0);
+
+	free(bdev_io);
+}
+
+static void
+test_multipath_reset(void)
+{
+	struct nvme_blockdev nbdev;
+	struct nvme_mp_io_channel mp_ch;
+	struct spdk_io_channel ch = { .ctx = &mp_ch };
+	struct spdk_bdev_io *bdev_io;
+	struct nvme_blockio *bio;
+	struct spdk_nvme_cpl cpl = {};
+	char buf[512];
+	struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+
+	ut_init_multipath(&nbdev, &mp_ch);
+	bdev_io = ut_alloc_read(&nbdev, &ch, &iov);
+	bio = (struct nvme_blockio *)bdev_io->driver_ctx;
+
+	/* An I/O fails on path 1 and is retried on path 2 */
+	mp_ch.next_path = 1;
+	CU_ASSERT(blockdev_nvme_submit_rw(bdev_io) == 0);
+	CU_ASSERT(g_ut_submit_path[0] == 1);
+	cpl.status.sct = SPDK_NVME_SCT_GENERIC;
+	cpl.status.sc = SPDK_NVME_SC_ABORTED_SQ_DELETION;
+	queued_done(bio, &cpl);
+	CU_ASSERT(g_ut_submit_path[1] == 2);
+	memset(&cpl, 0, sizeof(cpl));
+	queued_done(bio, &cpl);
+	CU_ASSERT(g_ut_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+
+	/* The reset only goes to the path the I/O failed on */
+	g_ut_io_completed = false;
+	CU_ASSERT(blockdev_nvme_reset(&nbdev, bio) == 0);
+	CU_ASSERT(g_ut_io_completed == true);
+	CU_ASSERT(g_ut_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(g_ut_ctrlr[0].num_resets == 0);
+	CU_ASSERT(g_ut_ctrlr[1].num_resets == 1);
+	CU_ASSERT(g_ut_ctrlr[2].num_resets == 0);
+
+	/* Further resets move on to the next path */
+	CU_ASSERT(blockdev_nvme_reset(&nbdev, bio) == 0);
+	CU_ASSERT(g_ut_ctrlr[1].num_resets == 1);
+	CU_ASSERT(g_ut_ctrlr[2].num_resets == 1);
+
+	/* A reset that fails fails the reset I/O */
+	g_ut_io_completed = false;
+	g_ut_reset_rc = -1;
+	CU_ASSERT(blockdev_nvme_reset(&nbdev, bio) == -1);
+	CU_ASSERT(g_ut_io_completed == true);
+	CU_ASSERT(g_ut_io_status == SPDK_BDEV_IO_STATUS_FAILED);
+	CU_ASSERT(g_ut_ctrlr[0].num_resets == 1);
+	CU_ASSERT(g_ut_ctrlr[1].num_resets == 1);
+	CU_ASSERT(g_ut_ctrlr[2].num_resets == 1);
+
+	free(bdev_io);
+}
+
+static void
+test_fabrics_scattered_payload(void)
+{
+	struct nvme_blockdev nbdev;
+	struct nvme_mp_io_channel mp_ch;
+	struct spdk_io_channel ch = { .ctx = &g_ut_nvme_ch[0] };
+	struct spdk_bdev_io *bdev_io;
+	struct nvme_blockio *bio;
+	struct spdk_nvme_cpl cpl = {};
+	char buf1[512], buf2[1024], data[1536];
+	struct iovec iovs[2] = {
+		{ .iov_base = buf1, .iov_len = sizeof(buf1) },
+		{ .iov_base = buf2, .iov_len = sizeof(buf2) },
+	};
+
+	/* A single path blockdev on a controller that only takes contiguous payloads */
+	ut_init_multipath(&nbdev, &mp_ch);
+	nbdev.num_paths = 1;
+	nbdev.paths[0].contig_payload = true;
+	memset(data, 0x5A, sizeof(buf1));
+	memset(data + sizeof(buf1), 0xA5, sizeof(buf2));
+
+	/* A scattered read is received into a bounce buffer and copied out on completion */
+	bdev_io = ut_alloc_read(&nbdev, &ch, &iovs[0]);
+	bio = (struct nvme_blockio *)bdev_io->driver_ctx;
+	bdev_io->u.read.iovcnt = 2;
+	bdev_io->u.read.nbytes = sizeof(data);
+	CU_ASSERT(blockdev_nvme_submit_rw(bdev_io) == 0);
+	CU_ASSERT(g_ut_num_submits == 1);
+	SPDK_CU_ASSERT_FATAL(g_ut_submit_payload != NULL);
+	CU_ASSERT(g_ut_submit_payload == bio->bounce_buf);
+	memcpy(g_ut_submit_payload, data, sizeof(data));
+	queued_done(bio, &cpl);
+	CU_ASSERT(g_ut_io_completed == true);
+	CU_ASSERT(g_ut_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(bio->bounce_buf == NULL);
+	CU_ASSERT(memcmp(buf1, data, sizeof(buf1)) == 0);
+	CU_ASSERT(memcmp(buf2, data + sizeof(buf1), sizeof(buf2)) == 0);
+
+	/* A scattered write is gathered into a bounce buffer before it is sent */
+	g_ut_io_completed = false;
+	g_ut_num_submits = 0;
+	bdev_io->type = SPDK_BDEV_IO_TYPE_WRITE;
+	bdev_io->u.write.iovs = iovs;
+	bdev_io->u.write.iovcnt = 2;
+	bdev_io->u.write.len = sizeof(data);
+	bdev_io->u.write.offset = 0;
+	CU_ASSERT(blockdev_nvme_submit_rw(bdev_io) == 0);
+	CU_ASSERT(g_ut_num_submits == 1);
+	SPDK_CU_ASSERT_FATAL(g_ut_submit_payload != NULL);
+	CU_ASSERT(memcmp(g_ut_submit_payload, data, sizeof(data)) == 0);
+	queued_done(bio, &cpl);
+	CU_ASSERT(g_ut_io_completed == true);
+	CU_ASSERT(g_ut_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(bio->bounce_buf == NULL);
+
+	/* The bounce buffer is released if the command cannot be submitted */
+	g_ut_submit_rc = -ENOMEM;
+	CU_ASSERT(blockdev_nvme_submit_rw(bdev_io) == -1);
+	CU_ASSERT(bio->bounce_buf == NULL);
+
+	free(bdev_io);
+}
+
+int main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("blockdev_nvme", NULL, NULL);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (
+		CU_add_test(suite, "nvme_ns_same_identifier", test_nvme_ns_same_identifier) == NULL
+		|| CU_add_test(suite, "select path round robin", test_select_path_round_robin) == NULL
+		|| CU_add_test(suite, "select path least queue depth",
+			       test_select_path_least_queue_depth) == NULL
+		|| CU_add_test(suite, "multipath retry", test_multipath_retry) == NULL
+		|| CU_add_test(suite, "multipath reset", test_multipath_reset) == NULL
+		|| CU_add_test(suite, "fabrics scattered payload", test_fabrics_scattered_payload) == NULL
+	) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+	return num_failures;
+}
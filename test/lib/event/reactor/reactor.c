@@ -35,6 +35,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/eventfd.h>
 
 #include "spdk/event.h"
 
@@ -44,6 +45,11 @@ static struct spdk_poller *poller_100ms;
 static struct spdk_poller *poller_250ms;
 static struct spdk_poller *poller_500ms;
 static struct spdk_poller *poller_oneshot;
+static struct spdk_poller *poller_intr;
+static struct spdk_poller *poller_intr_signal;
+static int g_intr_fd = -1;
+static bool g_intr_pending;
+static bool g_intr_enabled;
 
 static void
 test_end(void *arg)
@@ -67,6 +73,33 @@ oneshot(void *arg)
 	spdk_poller_unregister(&poller_oneshot, NULL);
 }
 
+static void
+intr_signal(void *arg)
+{
+	uint64_t one = 1;
+
+	/* Stands in for a device posting work, which only raises an interrupt when unmasked. */
+	g_intr_pending = true;
+	if (g_intr_enabled && write(g_intr_fd, &one, sizeof(one)) != sizeof(one)) {
+		printf("eventfd write failed\n");
+	}
+}
+
+static void
+intr_poll(void *arg)
+{
+	if (g_intr_pending) {
+		g_intr_pending = false;
+		spdk_poller_set_busy();
+	}
+}
+
+static void
+intr_enable(void *arg, bool enable)
+{
+	g_intr_enabled = enable;
+}
+
 static void
 test_start(spdk_event_t evt)
 {
@@ -79,6 +112,17 @@ test_start(spdk_event_t evt)
 	spdk_poller_register(&poller_250ms, tick, (void *)250, 0, NULL, 250000);
 	spdk_poller_register(&poller_500ms, tick, (void *)500, 0, NULL, 500000);
 	spdk_poller_register(&poller_oneshot, oneshot, NULL, 0, NULL, 0);
+
+	/*
+	 * Once the oneshot poller is gone, the interrupt poller is the only active poller,
+	 *  so the reactor sleeps until the eventfd or a timer wakes it.
+	 */
+	g_intr_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (g_intr_fd >= 0) {
+		spdk_poller_register_interrupt(&poller_intr, intr_poll, NULL, 0, NULL, g_intr_fd,
+					       intr_enable);
+		spdk_poller_register(&poller_intr_signal, intr_signal, NULL, 0, NULL, 300000);
+	}
 }
 
 static void
@@ -90,6 +134,8 @@ test_cleanup(void)
 	spdk_poller_unregister(&poller_100ms, NULL);
 	spdk_poller_unregister(&poller_250ms, NULL);
 	spdk_poller_unregister(&poller_500ms, NULL);
+	spdk_poller_unregister(&poller_intr, NULL);
+	spdk_poller_unregister(&poller_intr_signal, NULL);
 	/* poller_oneshot unregisters itself */
 }
 
@@ -140,5 +186,9 @@ main(int argc, char **argv)
 
 	spdk_app_fini();
 
+	if (g_intr_fd >= 0) {
+		close(g_intr_fd);
+	}
+
 	return 0;
 }
@@ -36,6 +36,7 @@
 #include "spdk/env.h"
 
 #include "nvme/nvme.c"
+#include "nvme/nvme_uevent.c"
 
 int
 spdk_pci_enumerate(enum spdk_pci_device_type type,
@@ -45,6 +46,36 @@ spdk_pci_enumerate(enum spdk_pci_device_type type,
 	return -1;
 }
 
+int
+spdk_pci_scan(void)
+{
+	return 0;
+}
+
+uint16_t
+spdk_pci_device_get_domain(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_bus(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_dev(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_func(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
 uint64_t nvme_vtophys(void *buf)
 {
 	return (uintptr_t)buf;
@@ -56,6 +87,15 @@ nvme_ctrlr_construct(struct spdk_nvme_ctrlr *ctrlr, void *devhandle)
 	return 0;
 }
 
+const struct nvme_transport nvme_tcp_transport;
+
+int
+nvme_ctrlr_construct_fabrics(struct spdk_nvme_ctrlr *ctrlr, const struct nvme_transport *transport,
+			     const struct spdk_nvme_transport_id *trid)
+{
+	return 0;
+}
+
 void
 nvme_ctrlr_destruct(struct spdk_nvme_ctrlr *ctrlr)
 {
@@ -73,6 +113,29 @@ nvme_ctrlr_start(struct spdk_nvme_ctrlr *ctrlr)
 	return 0;
 }
 
+int
+nvme_ctrlr_add_process(struct spdk_nvme_ctrlr *ctrlr, void *devhandle)
+{
+	return 0;
+}
+
+void
+nvme_ctrlr_remove_process(struct spdk_nvme_ctrlr *ctrlr)
+{
+}
+
+struct spdk_nvme_ctrlr_process *
+nvme_ctrlr_get_current_process(struct spdk_nvme_ctrlr *ctrlr)
+{
+	return NULL;
+}
+
+bool
+nvme_ctrlr_matches_pci_dev(struct spdk_nvme_ctrlr *ctrlr, struct spdk_pci_device *pci_dev)
+{
+	return false;
+}
+
 void
 spdk_nvme_ctrlr_opts_set_defaults(struct spdk_nvme_ctrlr_opts *opts)
 {
@@ -97,6 +160,82 @@ test_opc_data_transfer(void)
 	CU_ASSERT(xfer == SPDK_NVME_DATA_CONTROLLER_TO_HOST);
 }
 
+static void
+test_nvme_uevent_parse(void)
+{
+	struct nvme_uevent uevent;
+	const char uio_add[] = "add@/devices/pci0000:80/0000:80:01.0/0000:81:00.0/uio/uio0\0"
+			       "ACTION=add\0DEVPATH=/devices/pci0000:80/0000:80:01.0/0000:81:00.0/uio/uio0\0"
+			       "SUBSYSTEM=uio\0MAJOR=243\0MINOR=0\0SEQNUM=1234\0";
+	const char vfio_remove[] = "remove@/devices/pci0000:00/0000:00:03.0/0000:06:00.1\0"
+				   "ACTION=remove\0DEVPATH=/devices/pci0000:00/0000:00:03.0/0000:06:00.1\0"
+				   "SUBSYSTEM=pci\0DRIVER=vfio-pci\0PCI_SLOT_NAME=0000:06:00.1\0";
+	const char pci_add[] = "add@/devices/pci0000:00/0000:00:03.0/0000:06:00.1\0"
+			       "ACTION=add\0DEVPATH=/devices/pci0000:00/0000:00:03.0/0000:06:00.1\0"
+			       "SUBSYSTEM=pci\0PCI_SLOT_NAME=0000:06:00.1\0";
+	const char vfio_bind[] = "bind@/devices/pci0000:00/0000:00:03.0/0000:06:00.1\0"
+				 "ACTION=bind\0DEVPATH=/devices/pci0000:00/0000:00:03.0/0000:06:00.1\0"
+				 "SUBSYSTEM=pci\0DRIVER=vfio-pci\0PCI_SLOT_NAME=0000:06:00.1\0";
+	const char nvme_remove[] = "remove@/devices/pci0000:00/0000:00:03.0/0000:06:00.0\0"
+				   "ACTION=remove\0SUBSYSTEM=pci\0DRIVER=nvme\0PCI_SLOT_NAME=0000:06:00.0\0";
+	const char uio_change[] = "change@/devices/pci0000:80/0000:80:01.0/0000:81:00.0/uio/uio0\0"
+				  "ACTION=change\0DEVPATH=/devices/pci0000:80/0000:80:01.0/0000:81:00.0/uio/uio0\0"
+				  "SUBSYSTEM=uio\0";
+
+	memset(&uevent, 0, sizeof(uevent));
+	CU_ASSERT(nvme_uevent_parse(uio_add, sizeof(uio_add), &uevent) == 1);
+	CU_ASSERT(uevent.action == NVME_UEVENT_ADD);
+	CU_ASSERT(uevent.domain == 0);
+	CU_ASSERT(uevent.bus == 0x81);
+	CU_ASSERT(uevent.dev == 0);
+	CU_ASSERT(uevent.func == 0);
+
+	memset(&uevent, 0, sizeof(uevent));
+	CU_ASSERT(nvme_uevent_parse(vfio_remove, sizeof(vfio_remove), &uevent) == 1);
+	CU_ASSERT(uevent.action == NVME_UEVENT_REMOVE);
+	CU_ASSERT(uevent.bus == 0x06);
+	CU_ASSERT(uevent.func == 1);
+
+	/* A vfio-pci device arrives when it is bound, not when it is added. */
+	CU_ASSERT(nvme_uevent_parse(pci_add, sizeof(pci_add), &uevent) == 0);
+	memset(&uevent, 0, sizeof(uevent));
+	CU_ASSERT(nvme_uevent_parse(vfio_bind, sizeof(vfio_bind), &uevent) == 1);
+	CU_ASSERT(uevent.action == NVME_UEVENT_ADD);
+	CU_ASSERT(uevent.bus == 0x06);
+	CU_ASSERT(uevent.func == 1);
+
+	/* Devices bound to the kernel driver and other actions are ignored */
+	CU_ASSERT(nvme_uevent_parse(nvme_remove, sizeof(nvme_remove), &uevent) == 0);
+	CU_ASSERT(nvme_uevent_parse(uio_change, sizeof(uio_change), &uevent) == 0);
+}
+
+static bool
+ut_probe_cb(void *cb_ctx, struct spdk_pci_device *pci_dev, struct spdk_nvme_ctrlr_opts *opts)
+{
+	return true;
+}
+
+static void
+ut_attach_cb(void *cb_ctx, struct spdk_pci_device *pci_dev, struct spdk_nvme_ctrlr *ctrlr,
+	     const struct spdk_nvme_ctrlr_opts *opts)
+{
+}
+
+static void
+test_spdk_nvme_probe_async(void)
+{
+	struct spdk_nvme_probe_ctx *probe_ctx;
+
+	/* The stubbed PCI enumeration fails, so the probe completes with an error. */
+	probe_ctx = spdk_nvme_probe_async(NULL, ut_probe_cb, ut_attach_cb, NULL);
+	SPDK_CU_ASSERT_FATAL(probe_ctx != NULL);
+	CU_ASSERT(TAILQ_FIRST(&g_spdk_nvme_driver->probe_ctxs) == probe_ctx);
+	CU_ASSERT(spdk_nvme_probe_poll_async(probe_ctx) == -1);
+	CU_ASSERT(TAILQ_EMPTY(&g_spdk_nvme_driver->probe_ctxs));
+
+	CU_ASSERT(spdk_nvme_probe(NULL, ut_probe_cb, ut_attach_cb, NULL) == -1);
+}
+
 int main(int argc, char **argv)
 {
 	CU_pSuite	suite = NULL;
@@ -114,6 +253,8 @@ int main(int argc, char **argv)
 
 	if (
 		CU_add_test(suite, "test_opc_data_transfer", test_opc_data_transfer) == NULL
+		|| CU_add_test(suite, "test_nvme_uevent_parse", test_nvme_uevent_parse) == NULL
+		|| CU_add_test(suite, "test_spdk_nvme_probe_async", test_spdk_nvme_probe_async) == NULL
 	) {
 		CU_cleanup_registry();
 		return CU_get_error();
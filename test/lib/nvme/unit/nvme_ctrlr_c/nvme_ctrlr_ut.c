@@ -45,10 +45,15 @@ struct nvme_driver _g_nvme_driver = {
 	.request_mempool = NULL,
 };
 
+pid_t g_spdk_nvme_pid;
+
 static uint16_t g_pci_vendor_id;
 static uint16_t g_pci_device_id;
 static uint16_t g_pci_subvendor_id;
 static uint16_t g_pci_subdevice_id;
+static int g_pci_intr_vectors;
+static bool g_pci_intr_disabled;
+static uint32_t g_pci_intr_masked;
 
 uint64_t g_ut_tsc = 0;
 struct spdk_nvme_registers g_ut_nvme_regs = {};
@@ -71,6 +76,39 @@ spdk_pci_device_unmap_bar(struct spdk_pci_device *dev, uint32_t bar, void *addr)
 	return 0;
 }
 
+int
+spdk_pci_device_enable_interrupts(struct spdk_pci_device *dev, uint32_t num_vectors)
+{
+	if (g_pci_intr_vectors < 0) {
+		return g_pci_intr_vectors;
+	}
+
+	return nvme_min(num_vectors, (uint32_t)g_pci_intr_vectors);
+}
+
+void
+spdk_pci_device_disable_interrupts(struct spdk_pci_device *dev)
+{
+	g_pci_intr_disabled = true;
+}
+
+int
+spdk_pci_device_get_interrupt_fd(struct spdk_pci_device *dev, uint32_t vector)
+{
+	return 100 + vector;
+}
+
+int
+spdk_pci_device_mask_interrupt(struct spdk_pci_device *dev, uint32_t vector, bool mask)
+{
+	if (mask) {
+		g_pci_intr_masked |= (1u << vector);
+	} else {
+		g_pci_intr_masked &= ~(1u << vector);
+	}
+	return 0;
+}
+
 int
 spdk_pci_device_cfg_read32(struct spdk_pci_device *dev, uint32_t *value,
 			   uint32_t offset)
@@ -110,18 +148,51 @@ spdk_pci_device_get_subdevice_id(struct spdk_pci_device *dev)
 	return g_pci_subdevice_id;
 }
 
+uint16_t
+spdk_pci_device_get_domain(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_bus(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_dev(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_func(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
 int nvme_qpair_construct(struct spdk_nvme_qpair *qpair, uint16_t id,
 			 uint16_t num_entries, uint16_t num_trackers,
 			 struct spdk_nvme_ctrlr *ctrlr)
 {
 	qpair->id = id;
 	qpair->num_entries = num_entries;
+	qpair->num_trackers = num_trackers;
 	qpair->qprio = 0;
 	qpair->ctrlr = ctrlr;
 
 	return 0;
 }
 
+void
+nvme_qpair_init_depth_limiter(struct spdk_nvme_qpair *qpair, uint32_t latency_target_us)
+{
+	memset(&qpair->limiter, 0, sizeof(qpair->limiter));
+	qpair->limiter.latency_target_ticks = latency_target_us;
+	qpair->limiter.depth_limit = qpair->num_trackers;
+}
+
 static void
 fake_cpl_success(spdk_nvme_cmd_cb cb_fn, void *cb_arg)
 {
@@ -288,10 +359,16 @@ nvme_ctrlr_cmd_format(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid, struct spdk_
 	return 0;
 }
 
+static uint32_t g_fw_download_count;
+static uint32_t g_fw_download_offset;
+static uint32_t g_fw_commit_slot;
+
 int
 nvme_ctrlr_cmd_fw_commit(struct spdk_nvme_ctrlr *ctrlr, const struct spdk_nvme_fw_commit *fw_commit,
 			 spdk_nvme_cmd_cb cb_fn, void *cb_arg)
 {
+	g_fw_commit_slot = fw_commit->fs;
+	fake_cpl_success(cb_fn, cb_arg);
 	return 0;
 }
 
@@ -300,6 +377,30 @@ nvme_ctrlr_cmd_fw_image_download(struct spdk_nvme_ctrlr *ctrlr,
 				 uint32_t size, uint32_t offset, void *payload,
 				 spdk_nvme_cmd_cb cb_fn, void *cb_arg)
 {
+	CU_ASSERT(offset == g_fw_download_offset);
+	g_fw_download_count++;
+	g_fw_download_offset += size;
+	fake_cpl_success(cb_fn, cb_arg);
+	return 0;
+}
+
+int
+nvme_ctrlr_cmd_directive_send(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+			      uint32_t doper, uint32_t dtype, uint32_t dspec, uint32_t cdw12,
+			      void *payload, uint32_t payload_size,
+			      spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+	fake_cpl_success(cb_fn, cb_arg);
+	return 0;
+}
+
+int
+nvme_ctrlr_cmd_directive_receive(struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid,
+				 uint32_t doper, uint32_t dtype, uint32_t dspec, uint32_t cdw12,
+				 void *payload, uint32_t payload_size,
+				 spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+	fake_cpl_success(cb_fn, cb_arg);
 	return 0;
 }
 
@@ -336,6 +437,12 @@ nvme_allocate_request(const struct nvme_payload *payload, uint32_t payload_size,
 	return req;
 }
 
+void
+nvme_free_request(struct nvme_request *req)
+{
+	nvme_mempool_put(_g_nvme_driver.request_mempool, req);
+}
+
 struct nvme_request *
 nvme_allocate_request_contig(void *buffer, uint32_t payload_size, spdk_nvme_cmd_cb cb_fn,
 			     void *cb_arg)
@@ -1038,6 +1145,68 @@ test_alloc_io_qpair_wrr_2(void)
 	cleanup_qpairs(&ctrlr);
 }
 
+static void
+test_alloc_io_qpair_with_opts(void)
+{
+	struct spdk_nvme_ctrlr ctrlr = {};
+	struct spdk_nvme_io_qpair_opts opts;
+	struct spdk_nvme_qpair *q0;
+
+	g_ut_nvme_regs.cap.bits.mqes = 1023;
+	g_ut_nvme_regs.cc.bits.ams = SPDK_NVME_CC_AMS_RR;
+	setup_qpairs(&ctrlr, 1);
+
+	spdk_nvme_ctrlr_get_default_io_qpair_opts(&ctrlr, &opts);
+	CU_ASSERT(opts.qprio == SPDK_NVME_QPRIO_URGENT);
+	CU_ASSERT(opts.io_queue_size == NVME_IO_ENTRIES);
+	CU_ASSERT(opts.io_queue_requests == NVME_IO_TRACKERS);
+	CU_ASSERT(opts.latency_target_us == 0);
+	CU_ASSERT(ctrlr.ioq[0].num_entries == NVME_IO_ENTRIES);
+	CU_ASSERT(ctrlr.ioq[0].num_trackers == NVME_IO_TRACKERS);
+
+	/* Deeper queues than the default */
+	opts.io_queue_size = 1024;
+	opts.io_queue_requests = 512;
+	opts.latency_target_us = 100;
+	q0 = spdk_nvme_ctrlr_alloc_io_qpair_with_opts(&ctrlr, &opts);
+	SPDK_CU_ASSERT_FATAL(q0 != NULL);
+	CU_ASSERT(q0->num_entries == 1024);
+	CU_ASSERT(q0->num_trackers == 512);
+	CU_ASSERT(q0->limiter.latency_target_ticks == 100);
+	SPDK_CU_ASSERT_FATAL(spdk_nvme_ctrlr_free_io_qpair(q0) == 0);
+
+	/* Sizes beyond MQES and the tracker limit are clamped */
+	opts.io_queue_size = 100000;
+	opts.io_queue_requests = 100000;
+	opts.latency_target_us = 0;
+	q0 = spdk_nvme_ctrlr_alloc_io_qpair_with_opts(&ctrlr, &opts);
+	SPDK_CU_ASSERT_FATAL(q0 != NULL);
+	CU_ASSERT(q0->num_entries == 1024);
+	/* One entry of each queue is always left empty */
+	CU_ASSERT(q0->num_trackers == 1023);
+	CU_ASSERT(q0->limiter.latency_target_ticks == 0);
+	SPDK_CU_ASSERT_FATAL(spdk_nvme_ctrlr_free_io_qpair(q0) == 0);
+
+	/* So are sizes that are too small */
+	opts.io_queue_size = 1;
+	opts.io_queue_requests = 0;
+	q0 = spdk_nvme_ctrlr_alloc_io_qpair_with_opts(&ctrlr, &opts);
+	SPDK_CU_ASSERT_FATAL(q0 != NULL);
+	CU_ASSERT(q0->num_entries == NVME_MIN_IO_TRACKERS + 1);
+	CU_ASSERT(q0->num_trackers == NVME_MIN_IO_TRACKERS);
+	SPDK_CU_ASSERT_FATAL(spdk_nvme_ctrlr_free_io_qpair(q0) == 0);
+
+	/* The default allocation returns to the default sizes */
+	q0 = spdk_nvme_ctrlr_alloc_io_qpair(&ctrlr, 0);
+	SPDK_CU_ASSERT_FATAL(q0 != NULL);
+	CU_ASSERT(q0->num_entries == NVME_IO_ENTRIES);
+	CU_ASSERT(q0->num_trackers == NVME_IO_TRACKERS);
+	SPDK_CU_ASSERT_FATAL(spdk_nvme_ctrlr_free_io_qpair(q0) == 0);
+
+	cleanup_qpairs(&ctrlr);
+	g_ut_nvme_regs.cap.bits.mqes = 0;
+}
+
 static void
 test_nvme_ctrlr_fail(void)
 {
@@ -1146,6 +1315,281 @@ test_nvme_ctrlr_alloc_cmb(void)
 
 	rc = nvme_ctrlr_alloc_cmb(&ctrlr, 0x8000000, 0x1000, &offset);
 	CU_ASSERT(rc == -1);
+
+	/* Only the last reservation can be given back */
+	nvme_ctrlr_free_cmb(&ctrlr, 0x2000, 0x800);
+	CU_ASSERT(ctrlr.cmb_current_offset == 0x900000);
+	nvme_ctrlr_free_cmb(&ctrlr, 0x100000, 0x800000);
+	CU_ASSERT(ctrlr.cmb_current_offset == 0x100000);
+}
+
+static void
+dummy_timeout_cb(void *cb_arg, struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_qpair *qpair,
+		 uint16_t cid)
+{
+}
+
+static void
+test_nvme_ctrlr_register_timeout_callback(void)
+{
+	struct spdk_nvme_ctrlr	ctrlr = {};
+
+	spdk_nvme_ctrlr_register_timeout_callback(&ctrlr, 30, dummy_timeout_cb, &ctrlr);
+	CU_ASSERT(ctrlr.timeout_cb_fn == dummy_timeout_cb);
+	CU_ASSERT(ctrlr.timeout_cb_arg == &ctrlr);
+	CU_ASSERT(ctrlr.timeout_ticks == 30 * nvme_get_tsc_hz());
+
+	/* Out of range timeouts are clamped */
+	spdk_nvme_ctrlr_register_timeout_callback(&ctrlr, 1, dummy_timeout_cb, NULL);
+	CU_ASSERT(ctrlr.timeout_ticks == NVME_MIN_TIMEOUT_PERIOD * nvme_get_tsc_hz());
+	spdk_nvme_ctrlr_register_timeout_callback(&ctrlr, 100000, dummy_timeout_cb, NULL);
+	CU_ASSERT(ctrlr.timeout_ticks == NVME_MAX_TIMEOUT_PERIOD * nvme_get_tsc_hz());
+
+	/* A zero timeout disables timeout detection */
+	spdk_nvme_ctrlr_register_timeout_callback(&ctrlr, 0, dummy_timeout_cb, NULL);
+	CU_ASSERT(ctrlr.timeout_cb_fn == NULL);
+}
+
+static void
+test_nvme_ctrlr_alloc_cmb_io_buffer(void)
+{
+	struct spdk_nvme_ctrlr	ctrlr = {};
+	uint8_t			cmb[(NVME_CMB_IO_BUF_CLASSES + 8) * PAGE_SIZE];
+	void			*buf1, *buf2, *buf3, *big1, *big2;
+	int			i;
+
+	pthread_mutex_init_recursive(&ctrlr.ctrlr_lock);
+
+	/* No CMB data support */
+	CU_ASSERT(spdk_nvme_ctrlr_alloc_cmb_io_buffer(&ctrlr, PAGE_SIZE) == NULL);
+
+	ctrlr.cmb_bar_virt_addr = cmb;
+	ctrlr.cmb_bar_phys_addr = 0x100000;
+	ctrlr.cmb_size = sizeof(cmb);
+	ctrlr.cmb_current_offset = PAGE_SIZE;
+	ctrlr.cmb_io_data_supported = true;
+	CU_ASSERT(nvme_ctrlr_init_cmb_io_bufs(&ctrlr) == 0);
+
+	/* Sizes are rounded up to whole pages */
+	buf1 = spdk_nvme_ctrlr_alloc_cmb_io_buffer(&ctrlr, 100);
+	CU_ASSERT(buf1 == cmb + PAGE_SIZE);
+	CU_ASSERT(ctrlr.cmb_io_data_used == true);
+	buf2 = spdk_nvme_ctrlr_alloc_cmb_io_buffer(&ctrlr, 2 * PAGE_SIZE);
+	CU_ASSERT(buf2 == cmb + 2 * PAGE_SIZE);
+	CU_ASSERT(ctrlr.cmb_current_offset == 4 * PAGE_SIZE);
+
+	/* Not enough space left */
+	CU_ASSERT(spdk_nvme_ctrlr_alloc_cmb_io_buffer(&ctrlr, sizeof(cmb)) == NULL);
+
+	/* Freed buffers are reused for allocations of the same size */
+	spdk_nvme_ctrlr_free_cmb_io_buffer(&ctrlr, buf2, 2 * PAGE_SIZE);
+	buf3 = spdk_nvme_ctrlr_alloc_cmb_io_buffer(&ctrlr, PAGE_SIZE);
+	CU_ASSERT(buf3 == cmb + 4 * PAGE_SIZE);
+	buf3 = spdk_nvme_ctrlr_alloc_cmb_io_buffer(&ctrlr, 2 * PAGE_SIZE);
+	CU_ASSERT(buf3 == buf2);
+	CU_ASSERT(LIST_EMPTY(&ctrlr.free_cmb_io_buffers[1]));
+
+	/* Sizes beyond the last class share a list, but are still only reused at the same size */
+	big1 = spdk_nvme_ctrlr_alloc_cmb_io_buffer(&ctrlr, NVME_CMB_IO_BUF_CLASSES * PAGE_SIZE);
+	big2 = spdk_nvme_ctrlr_alloc_cmb_io_buffer(&ctrlr, (NVME_CMB_IO_BUF_CLASSES + 1) * PAGE_SIZE);
+	SPDK_CU_ASSERT_FATAL(big1 != NULL);
+	CU_ASSERT(big2 == NULL);
+	spdk_nvme_ctrlr_free_cmb_io_buffer(&ctrlr, big1, NVME_CMB_IO_BUF_CLASSES * PAGE_SIZE);
+	CU_ASSERT(spdk_nvme_ctrlr_alloc_cmb_io_buffer(&ctrlr,
+			(NVME_CMB_IO_BUF_CLASSES + 1) * PAGE_SIZE) == NULL);
+	CU_ASSERT(spdk_nvme_ctrlr_alloc_cmb_io_buffer(&ctrlr, NVME_CMB_IO_BUF_CLASSES * PAGE_SIZE) == big1);
+
+	spdk_nvme_ctrlr_free_cmb_io_buffer(&ctrlr, buf1, 100);
+	CU_ASSERT(!LIST_EMPTY(&ctrlr.free_cmb_io_buffers[0]));
+	ctrlr.cmb_bar_virt_addr = NULL;
+	nvme_ctrlr_unmap_cmb(&ctrlr);
+	CU_ASSERT(ctrlr.cmb_io_bufs == NULL);
+	for (i = 0; i < NVME_CMB_IO_BUF_CLASSES; i++) {
+		CU_ASSERT(LIST_EMPTY(&ctrlr.free_cmb_io_buffers[i]));
+	}
+
+	pthread_mutex_destroy(&ctrlr.ctrlr_lock);
+}
+
+static void
+test_nvme_ctrlr_enable_interrupts(void)
+{
+	struct spdk_nvme_ctrlr	ctrlr = {};
+
+	/* The device cannot route interrupts to eventfds, so all queues are polled */
+	g_pci_intr_vectors = -ENOTSUP;
+	setup_qpairs(&ctrlr, 4);
+	ctrlr.opts.enable_interrupts = true;
+	nvme_ctrlr_enable_interrupts(&ctrlr);
+	CU_ASSERT(ctrlr.opts.enable_interrupts == false);
+	CU_ASSERT(ctrlr.num_intr_vectors == 0);
+	CU_ASSERT(spdk_nvme_qpair_get_interrupt_fd(&ctrlr.ioq[0]) == -1);
+	g_pci_intr_disabled = false;
+	cleanup_qpairs(&ctrlr);
+	CU_ASSERT(g_pci_intr_disabled == false);
+
+	/* Only vectors 0-2 are available: I/O queues 1 and 2 get interrupts, 3 and 4 are polled */
+	memset(&ctrlr, 0, sizeof(ctrlr));
+	g_pci_intr_vectors = 3;
+	setup_qpairs(&ctrlr, 4);
+	ctrlr.opts.enable_interrupts = true;
+	nvme_ctrlr_enable_interrupts(&ctrlr);
+	CU_ASSERT(ctrlr.opts.enable_interrupts == true);
+	CU_ASSERT(ctrlr.num_intr_vectors == 3);
+	CU_ASSERT(spdk_nvme_qpair_get_interrupt_fd(&ctrlr.adminq) == -1);
+	CU_ASSERT(spdk_nvme_qpair_get_interrupt_fd(&ctrlr.ioq[0]) == 101);
+	CU_ASSERT(spdk_nvme_qpair_get_interrupt_fd(&ctrlr.ioq[1]) == 102);
+	CU_ASSERT(spdk_nvme_qpair_get_interrupt_fd(&ctrlr.ioq[2]) == -1);
+	CU_ASSERT(spdk_nvme_qpair_get_interrupt_fd(&ctrlr.ioq[3]) == -1);
+
+	/* Every vector starts out masked and only I/O queues with a vector can unmask theirs */
+	CU_ASSERT(g_pci_intr_masked == 0x7);
+	CU_ASSERT(spdk_nvme_qpair_mask_interrupt(&ctrlr.ioq[1], false) == 0);
+	CU_ASSERT(g_pci_intr_masked == 0x3);
+	CU_ASSERT(spdk_nvme_qpair_mask_interrupt(&ctrlr.ioq[1], true) == 0);
+	CU_ASSERT(g_pci_intr_masked == 0x7);
+	CU_ASSERT(spdk_nvme_qpair_mask_interrupt(&ctrlr.adminq, false) == -EINVAL);
+	CU_ASSERT(spdk_nvme_qpair_mask_interrupt(&ctrlr.ioq[2], false) == -EINVAL);
+	CU_ASSERT(g_pci_intr_masked == 0x7);
+	cleanup_qpairs(&ctrlr);
+	CU_ASSERT(g_pci_intr_disabled == true);
+	CU_ASSERT(ctrlr.num_intr_vectors == 0);
+}
+
+static uint32_t g_primary_aer_count;
+static uint32_t g_secondary_aer_count;
+static uint32_t g_proc_admin_cpl_count;
+
+static void
+primary_aer_cb(void *arg, const struct spdk_nvme_cpl *cpl)
+{
+	g_primary_aer_count++;
+}
+
+static void
+secondary_aer_cb(void *arg, const struct spdk_nvme_cpl *cpl)
+{
+	g_secondary_aer_count++;
+}
+
+static void
+proc_admin_cpl_cb(void *arg, const struct spdk_nvme_cpl *cpl)
+{
+	CU_ASSERT(cpl->status.sc == SPDK_NVME_SC_INVALID_FIELD);
+	g_proc_admin_cpl_count++;
+}
+
+static void
+test_nvme_ctrlr_multi_process(void)
+{
+	struct spdk_nvme_ctrlr		ctrlr = {};
+	struct spdk_nvme_ctrlr_process	*primary, *secondary;
+	struct spdk_nvme_qpair		*qpair;
+	struct nvme_request		*req;
+	struct spdk_nvme_cpl		cpl = {};
+	pid_t				primary_pid = getpid();
+	pid_t				secondary_pid = getppid();
+
+	setup_qpairs(&ctrlr, 2);
+	g_ut_nvme_regs.cc.bits.ams = SPDK_NVME_CC_AMS_RR;
+	g_primary_aer_count = 0;
+	g_secondary_aer_count = 0;
+	g_proc_admin_cpl_count = 0;
+
+	ctrlr.devhandle = (struct spdk_pci_device *)0x1000;
+	g_spdk_nvme_pid = primary_pid;
+	CU_ASSERT(nvme_ctrlr_add_process(&ctrlr, ctrlr.devhandle) == 0);
+	primary = nvme_ctrlr_get_current_process(&ctrlr);
+	SPDK_CU_ASSERT_FATAL(primary != NULL);
+	spdk_nvme_ctrlr_register_aer_callback(&ctrlr, primary_aer_cb, NULL);
+	CU_ASSERT(primary->aer_cb_fn == primary_aer_cb);
+
+	/* A second process attaches and allocates its own I/O qpair. */
+	g_spdk_nvme_pid = secondary_pid;
+	CU_ASSERT(nvme_ctrlr_get_current_process(&ctrlr) == NULL);
+	CU_ASSERT(nvme_ctrlr_add_process(&ctrlr, (struct spdk_pci_device *)0x2000) == 0);
+	secondary = nvme_ctrlr_get_current_process(&ctrlr);
+	SPDK_CU_ASSERT_FATAL(secondary != NULL && secondary != primary);
+	/* The secondary reaches the device through its own handle, not the primary's. */
+	CU_ASSERT(nvme_ctrlr_proc_get_devhandle(&ctrlr) == (struct spdk_pci_device *)0x2000);
+	spdk_nvme_ctrlr_register_aer_callback(&ctrlr, secondary_aer_cb, NULL);
+	qpair = spdk_nvme_ctrlr_alloc_io_qpair(&ctrlr, 0);
+	SPDK_CU_ASSERT_FATAL(qpair != NULL);
+	CU_ASSERT(qpair->active_proc == secondary);
+	CU_ASSERT(TAILQ_FIRST(&secondary->allocated_io_qpairs) == qpair);
+	CU_ASSERT(TAILQ_EMPTY(&primary->allocated_io_qpairs));
+
+	/* Asynchronous events are delivered in the primary and queued for the secondary. */
+	g_spdk_nvme_pid = primary_pid;
+	ctrlr.aer[0].ctrlr = &ctrlr;
+	nvme_ctrlr_async_event_cb(&ctrlr.aer[0], &cpl);
+	CU_ASSERT(g_primary_aer_count == 1);
+	CU_ASSERT(g_secondary_aer_count == 0);
+	CU_ASSERT(secondary->num_pending_aers == 1);
+
+	/* An admin request of the secondary reaped by the primary waits for the secondary. */
+	req = nvme_allocate_request_null(proc_admin_cpl_cb, NULL);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+	req->pid = secondary_pid;
+	cpl.status.sc = SPDK_NVME_SC_INVALID_FIELD;
+	nvme_ctrlr_queue_proc_admin_request(&ctrlr, req, &cpl);
+	CU_ASSERT(STAILQ_FIRST(&secondary->active_reqs) == req);
+	nvme_ctrlr_complete_proc_admin_requests(&ctrlr);
+	CU_ASSERT(g_proc_admin_cpl_count == 0);
+
+	g_spdk_nvme_pid = secondary_pid;
+	nvme_ctrlr_complete_proc_admin_requests(&ctrlr);
+	CU_ASSERT(g_proc_admin_cpl_count == 1);
+	CU_ASSERT(g_secondary_aer_count == 1);
+	CU_ASSERT(secondary->num_pending_aers == 0);
+	CU_ASSERT(STAILQ_EMPTY(&secondary->active_reqs));
+
+	/* Detaching the secondary frees its qpairs but leaves the controller attached. */
+	nvme_ctrlr_remove_process(&ctrlr);
+	CU_ASSERT(TAILQ_EMPTY(&ctrlr.active_io_qpairs));
+	CU_ASSERT(qpair->active_proc == NULL);
+	CU_ASSERT(TAILQ_FIRST(&ctrlr.active_procs) == primary);
+	CU_ASSERT(TAILQ_NEXT(primary, tailq) == NULL);
+
+	g_spdk_nvme_pid = primary_pid;
+	cleanup_qpairs(&ctrlr);
+	CU_ASSERT(TAILQ_EMPTY(&ctrlr.active_procs));
+	g_spdk_nvme_pid = 0;
+}
+
+static void
+fw_update_cb(void *cb_arg, const struct spdk_nvme_cpl *cpl)
+{
+	int *done = cb_arg;
+
+	CU_ASSERT(!spdk_nvme_cpl_is_error(cpl));
+	*done = 1;
+}
+
+static void
+test_nvme_ctrlr_update_firmware_async(void)
+{
+	struct spdk_nvme_ctrlr	ctrlr = {};
+	uint8_t			image[10000];
+	int			done = 0;
+
+	ctrlr.min_page_size = 4096;
+	g_fw_download_count = 0;
+	g_fw_download_offset = 0;
+	g_fw_commit_slot = 0;
+
+	/* The size must be a multiple of 4 */
+	CU_ASSERT(spdk_nvme_ctrlr_update_firmware_async(&ctrlr, image, sizeof(image) - 1, 1,
+			fw_update_cb, &done) == -EINVAL);
+	CU_ASSERT(g_fw_download_count == 0);
+
+	/* The image is downloaded one page at a time and then committed */
+	CU_ASSERT(spdk_nvme_ctrlr_update_firmware_async(&ctrlr, image, sizeof(image), 2,
+			fw_update_cb, &done) == 0);
+	CU_ASSERT(done == 1);
+	CU_ASSERT(g_fw_download_count == 3);
+	CU_ASSERT(g_fw_download_offset == sizeof(image));
+	CU_ASSERT(g_fw_commit_slot == 2);
 }
 
 int main(int argc, char **argv)
@@ -1181,6 +1625,7 @@ int main(int argc, char **argv)
 		|| CU_add_test(suite, "alloc_io_qpair_rr 1", test_alloc_io_qpair_rr_1) == NULL
 		|| CU_add_test(suite, "alloc_io_qpair_wrr 1", test_alloc_io_qpair_wrr_1) == NULL
 		|| CU_add_test(suite, "alloc_io_qpair_wrr 2", test_alloc_io_qpair_wrr_2) == NULL
+		|| CU_add_test(suite, "alloc_io_qpair_with_opts", test_alloc_io_qpair_with_opts) == NULL
 		|| CU_add_test(suite, "test nvme_ctrlr function nvme_ctrlr_fail", test_nvme_ctrlr_fail) == NULL
 		|| CU_add_test(suite, "test nvme ctrlr function nvme_ctrlr_construct_intel_support_log_page_list",
 			       test_nvme_ctrlr_construct_intel_support_log_page_list) == NULL
@@ -1188,6 +1633,16 @@ int main(int argc, char **argv)
 			       test_nvme_ctrlr_set_supported_features) == NULL
 		|| CU_add_test(suite, "test nvme ctrlr function nvme_ctrlr_alloc_cmb",
 			       test_nvme_ctrlr_alloc_cmb) == NULL
+		|| CU_add_test(suite, "test nvme ctrlr function spdk_nvme_ctrlr_register_timeout_callback",
+			       test_nvme_ctrlr_register_timeout_callback) == NULL
+		|| CU_add_test(suite, "test nvme_ctrlr_alloc_cmb_io_buffer",
+			       test_nvme_ctrlr_alloc_cmb_io_buffer) == NULL
+		|| CU_add_test(suite, "test nvme_ctrlr_enable_interrupts",
+			       test_nvme_ctrlr_enable_interrupts) == NULL
+		|| CU_add_test(suite, "test nvme_ctrlr_update_firmware_async",
+			       test_nvme_ctrlr_update_firmware_async) == NULL
+		|| CU_add_test(suite, "test nvme_ctrlr_multi_process",
+			       test_nvme_ctrlr_multi_process) == NULL
 	) {
 		CU_cleanup_registry();
 		return CU_get_error();
@@ -53,6 +53,7 @@ uint16_t abort_cid = 1;
 uint16_t abort_sqid = 1;
 uint32_t namespace_management_nsid = 1;
 uint32_t format_nvme_nsid = 1;
+uint32_t create_io_cq_cdw11;
 
 typedef void (*verify_request_fn_t)(struct nvme_request *req);
 verify_request_fn_t verify_fn;
@@ -114,6 +115,13 @@ static void verify_abort_cmd(struct nvme_request *req)
 	CU_ASSERT(req->cmd.cdw10 == (((uint32_t)abort_cid << 16) | abort_sqid));
 }
 
+static void verify_create_io_cq(struct nvme_request *req)
+{
+	CU_ASSERT(req->cmd.opc == SPDK_NVME_OPC_CREATE_IO_CQ);
+	CU_ASSERT(req->cmd.cdw10 == ((255u << 16) | 3));
+	CU_ASSERT(req->cmd.cdw11 == create_io_cq_cdw11);
+}
+
 static void verify_io_raw_cmd(struct nvme_request *req)
 {
 	struct spdk_nvme_cmd	command = {};
@@ -457,10 +465,37 @@ static void
 test_abort_cmd(void)
 {
 	struct spdk_nvme_ctrlr	ctrlr = {};
+	struct spdk_nvme_qpair	qpair = {};
 
 	verify_fn = verify_abort_cmd;
 
-	nvme_ctrlr_cmd_abort(&ctrlr, abort_cid, abort_sqid, NULL, NULL);
+	qpair.id = abort_sqid;
+	spdk_nvme_ctrlr_cmd_abort(&ctrlr, &qpair, abort_cid, NULL, NULL);
+}
+
+static void
+test_create_io_cq(void)
+{
+	struct spdk_nvme_ctrlr	ctrlr = {};
+	struct spdk_nvme_qpair	qpair = {};
+
+	verify_fn = verify_create_io_cq;
+
+	qpair.id = 3;
+	qpair.num_entries = 256;
+
+	/* Polled: physically contiguous, interrupts disabled. */
+	create_io_cq_cdw11 = 0x1;
+	nvme_ctrlr_cmd_create_io_cq(&ctrlr, &qpair, NULL, NULL);
+
+	/* Not enough vectors for this queue - still polled. */
+	ctrlr.num_intr_vectors = 3;
+	nvme_ctrlr_cmd_create_io_cq(&ctrlr, &qpair, NULL, NULL);
+
+	/* Interrupts enabled on vector 3. */
+	ctrlr.num_intr_vectors = 4;
+	create_io_cq_cdw11 = (3u << 16) | 0x2 | 0x1;
+	nvme_ctrlr_cmd_create_io_cq(&ctrlr, &qpair, NULL, NULL);
 }
 
 static void
@@ -579,6 +614,7 @@ int main(int argc, char **argv)
 		|| CU_add_test(suite, "test ctrlr cmd set_feature", test_set_feature_cmd) == NULL
 		|| CU_add_test(suite, "test ctrlr cmd get_feature", test_get_feature_cmd) == NULL
 		|| CU_add_test(suite, "test ctrlr cmd abort_cmd", test_abort_cmd) == NULL
+		|| CU_add_test(suite, "test ctrlr cmd create_io_cq", test_create_io_cq) == NULL
 		|| CU_add_test(suite, "test ctrlr cmd io_raw_cmd", test_io_raw_cmd) == NULL
 		|| CU_add_test(suite, "test ctrlr cmd namespace_attach", test_namespace_attach) == NULL
 		|| CU_add_test(suite, "test ctrlr cmd namespace_detach", test_namespace_detach) == NULL
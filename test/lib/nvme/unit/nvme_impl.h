@@ -37,6 +37,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <pthread.h>
@@ -52,6 +53,7 @@ nvme_malloc(size_t size, unsigned align, uint64_t *phys_addr)
 	if (posix_memalign(&buf, align, size)) {
 		return NULL;
 	}
+	memset(buf, 0, size);
 	*phys_addr = (uint64_t)buf;
 	return buf;
 }
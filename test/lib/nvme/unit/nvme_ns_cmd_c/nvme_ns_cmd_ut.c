@@ -37,6 +37,17 @@
 
 struct nvme_request *g_request = NULL;
 
+/* Normally reserved from shared memory by spdk_nvme_probe() */
+static struct nvme_driver _g_nvme_driver = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.request_mempool = NULL,
+};
+
+void
+spdk_trace_record(uint16_t tpoint_id, uint16_t poller_id, uint32_t size,
+		  uint64_t object_id, uint64_t arg1)
+{
+}
 
 int
 spdk_pci_enumerate(enum spdk_pci_device_type type,
@@ -46,6 +57,36 @@ spdk_pci_enumerate(enum spdk_pci_device_type type,
 	return -1;
 }
 
+int
+spdk_pci_scan(void)
+{
+	return 0;
+}
+
+uint16_t
+spdk_pci_device_get_domain(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_bus(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_dev(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
+uint8_t
+spdk_pci_device_get_func(struct spdk_pci_device *dev)
+{
+	return 0;
+}
+
 static void nvme_request_reset_sgl(void *cb_arg, uint32_t sgl_offset)
 {
 }
@@ -66,6 +107,15 @@ nvme_ctrlr_construct(struct spdk_nvme_ctrlr *ctrlr, void *devhandle)
 	return 0;
 }
 
+const struct nvme_transport nvme_tcp_transport;
+
+int
+nvme_ctrlr_construct_fabrics(struct spdk_nvme_ctrlr *ctrlr, const struct nvme_transport *transport,
+			     const struct spdk_nvme_transport_id *trid)
+{
+	return 0;
+}
+
 void
 nvme_ctrlr_destruct(struct spdk_nvme_ctrlr *ctrlr)
 {
@@ -83,6 +133,29 @@ nvme_ctrlr_start(struct spdk_nvme_ctrlr *ctrlr)
 	return 0;
 }
 
+int
+nvme_ctrlr_add_process(struct spdk_nvme_ctrlr *ctrlr, void *devhandle)
+{
+	return 0;
+}
+
+void
+nvme_ctrlr_remove_process(struct spdk_nvme_ctrlr *ctrlr)
+{
+}
+
+struct spdk_nvme_ctrlr_process *
+nvme_ctrlr_get_current_process(struct spdk_nvme_ctrlr *ctrlr)
+{
+	return NULL;
+}
+
+bool
+nvme_ctrlr_matches_pci_dev(struct spdk_nvme_ctrlr *ctrlr, struct spdk_pci_device *pci_dev)
+{
+	return false;
+}
+
 void
 spdk_nvme_ctrlr_opts_set_defaults(struct spdk_nvme_ctrlr_opts *opts)
 {
@@ -774,12 +847,179 @@ test_nvme_ns_cmd_write_with_md(void)
 	nvme_free_request(g_request);
 }
 
+static void
+test_nvme_ns_cmd_write_with_hints(void)
+{
+	struct spdk_nvme_ns		ns;
+	struct spdk_nvme_ctrlr		ctrlr;
+	struct spdk_nvme_qpair		qpair;
+	int				rc = 0;
+	void				*buffer = NULL;
+	uint8_t				dsm;
+
+	prepare_for_test(&ns, &ctrlr, &qpair, 512, 128 * 1024, 0);
+	ctrlr.max_streams = 4;
+	buffer = malloc(4096);
+	dsm = SPDK_NVME_DSM_ACCESS_FREQ_FREQ_WRITE_INFREQ_READ | SPDK_NVME_IO_DSM_SEQUENTIAL_REQUEST;
+
+	/* No stream - only the dataset management hints are set. */
+	rc = spdk_nvme_ns_cmd_write_with_hints(&ns, &qpair, buffer, 0, 8, NULL, NULL, 0, dsm, 0);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_request != NULL);
+	CU_ASSERT(g_request->cmd.opc == SPDK_NVME_OPC_WRITE);
+	CU_ASSERT((g_request->cmd.cdw12 & SPDK_NVME_IO_FLAGS_STREAMS_DIRECTIVE) == 0);
+	CU_ASSERT(g_request->cmd.cdw13 == dsm);
+	nvme_free_request(g_request);
+
+	/* Stream 3 - DTYPE selects streams and DSPEC carries the stream identifier. */
+	rc = spdk_nvme_ns_cmd_write_with_hints(&ns, &qpair, buffer, 0, 8, NULL, NULL, 0, dsm, 3);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_request != NULL);
+	CU_ASSERT((g_request->cmd.cdw12 & SPDK_NVME_IO_FLAGS_STREAMS_DIRECTIVE) != 0);
+	CU_ASSERT((g_request->cmd.cdw12 & 0xFFFF) == 7);
+	CU_ASSERT(g_request->cmd.cdw13 == ((3U << 16) | dsm));
+	nvme_free_request(g_request);
+
+	/* Streams beyond what the controller granted are rejected. */
+	g_request = NULL;
+	rc = spdk_nvme_ns_cmd_write_with_hints(&ns, &qpair, buffer, 0, 8, NULL, NULL, 0, 0, 5);
+	CU_ASSERT(rc == -EINVAL);
+	CU_ASSERT(g_request == NULL);
+
+	/* Reads carry the dataset management hints only. */
+	rc = spdk_nvme_ns_cmd_read_with_hints(&ns, &qpair, buffer, 0, 8, NULL, NULL, 0,
+					      SPDK_NVME_DSM_ACCESS_FREQ_SPECULATIVE_READ);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_request != NULL);
+	CU_ASSERT(g_request->cmd.opc == SPDK_NVME_OPC_READ);
+	CU_ASSERT(g_request->cmd.cdw13 == SPDK_NVME_DSM_ACCESS_FREQ_SPECULATIVE_READ);
+	nvme_free_request(g_request);
+
+	/* Scattered payloads carry the same hints. */
+	rc = spdk_nvme_ns_cmd_writev_with_hints(&ns, &qpair, 0, 8, NULL, buffer, 0,
+						nvme_request_reset_sgl, nvme_request_next_sge, dsm, 3);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_request != NULL);
+	CU_ASSERT(g_request->cmd.opc == SPDK_NVME_OPC_WRITE);
+	CU_ASSERT(g_request->payload.type == NVME_PAYLOAD_TYPE_SGL);
+	CU_ASSERT((g_request->cmd.cdw12 & SPDK_NVME_IO_FLAGS_STREAMS_DIRECTIVE) != 0);
+	CU_ASSERT(g_request->cmd.cdw13 == ((3U << 16) | dsm));
+	nvme_free_request(g_request);
+
+	g_request = NULL;
+	rc = spdk_nvme_ns_cmd_writev_with_hints(&ns, &qpair, 0, 8, NULL, buffer, 0,
+						nvme_request_reset_sgl, nvme_request_next_sge, 0, 5);
+	CU_ASSERT(rc == -EINVAL);
+	CU_ASSERT(g_request == NULL);
+
+	rc = spdk_nvme_ns_cmd_readv_with_hints(&ns, &qpair, 0, 8, NULL, buffer, 0,
+					       nvme_request_reset_sgl, nvme_request_next_sge,
+					       SPDK_NVME_DSM_ACCESS_FREQ_SPECULATIVE_READ);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_request != NULL);
+	CU_ASSERT(g_request->cmd.opc == SPDK_NVME_OPC_READ);
+	CU_ASSERT(g_request->payload.type == NVME_PAYLOAD_TYPE_SGL);
+	CU_ASSERT(g_request->cmd.cdw13 == SPDK_NVME_DSM_ACCESS_FREQ_SPECULATIVE_READ);
+	nvme_free_request(g_request);
+
+	free(buffer);
+}
+
+static void
+compare_and_write_cb(void *cb_arg, const struct spdk_nvme_cpl *cpl)
+{
+	memcpy(cb_arg, cpl, sizeof(*cpl));
+}
+
+static void
+test_nvme_ns_cmd_compare_and_write(void)
+{
+	struct spdk_nvme_ns		ns;
+	struct spdk_nvme_ctrlr		ctrlr;
+	struct spdk_nvme_qpair		qpair;
+	struct spdk_nvme_cpl		cpl, status;
+	struct nvme_request		*compare_req, *write_req;
+	uint64_t			cmd_lba;
+	uint32_t			cmd_lba_count;
+	char				compare_buf[512], write_buf[512];
+	int				rc;
+
+	prepare_for_test(&ns, &ctrlr, &qpair, 512, 128 * 1024, 0);
+	ns.flags = SPDK_NVME_NS_COMPARE_SUPPORTED | SPDK_NVME_NS_COMPARE_AND_WRITE_SUPPORTED;
+	ctrlr.cdata.acwu = 0;
+
+	/* Longer than the atomic compare and write unit */
+	rc = spdk_nvme_ns_cmd_compare_and_write(&ns, &qpair, compare_buf, write_buf, 0x10, 2,
+						NULL, NULL, 0);
+	CU_ASSERT(rc == -EINVAL);
+	CU_ASSERT(g_request == NULL);
+
+	rc = spdk_nvme_ns_cmd_compare_and_write(&ns, &qpair, compare_buf, write_buf, 0x10, 1,
+						NULL, NULL, 0);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_request != NULL);
+	SPDK_CU_ASSERT_FATAL(g_request->num_children == 2);
+
+	compare_req = TAILQ_FIRST(&g_request->children);
+	write_req = TAILQ_NEXT(compare_req, child_tailq);
+	CU_ASSERT(compare_req->cmd.opc == SPDK_NVME_OPC_COMPARE);
+	CU_ASSERT(compare_req->cmd.fuse == SPDK_NVME_CMD_FUSE_FIRST);
+	CU_ASSERT(compare_req->payload.u.contig == compare_buf);
+	CU_ASSERT(write_req->cmd.opc == SPDK_NVME_OPC_WRITE);
+	CU_ASSERT(write_req->cmd.fuse == SPDK_NVME_CMD_FUSE_SECOND);
+	CU_ASSERT(write_req->payload.u.contig == write_buf);
+	nvme_cmd_interpret_rw(&write_req->cmd, &cmd_lba, &cmd_lba_count);
+	CU_ASSERT(cmd_lba == 0x10);
+	CU_ASSERT(cmd_lba_count == 1);
+
+	/* A compare failure is reported even if the aborted write completes last. */
+	g_request->cb_fn = compare_and_write_cb;
+	g_request->cb_arg = &status;
+	memset(&cpl, 0, sizeof(cpl));
+	cpl.status.sct = SPDK_NVME_SCT_MEDIA_ERROR;
+	cpl.status.sc = SPDK_NVME_SC_COMPARE_FAILURE;
+	compare_req->cb_fn(compare_req->cb_arg, &cpl);
+	nvme_free_request(compare_req);
+	cpl.status.sct = SPDK_NVME_SCT_GENERIC;
+	cpl.status.sc = SPDK_NVME_SC_ABORTED_FAILED_FUSED;
+	write_req->cb_fn(write_req->cb_arg, &cpl);
+	nvme_free_request(write_req);
+	CU_ASSERT(status.status.sct == SPDK_NVME_SCT_MEDIA_ERROR);
+	CU_ASSERT(status.status.sc == SPDK_NVME_SC_COMPARE_FAILURE);
+
+	/* Without fused operations the compare is issued first and the write follows. */
+	ns.flags = SPDK_NVME_NS_COMPARE_SUPPORTED;
+	g_request = NULL;
+	rc = spdk_nvme_ns_cmd_compare_and_write(&ns, &qpair, compare_buf, write_buf, 0x10, 1,
+						compare_and_write_cb, &status, 0);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	SPDK_CU_ASSERT_FATAL(g_request != NULL);
+	compare_req = g_request;
+	CU_ASSERT(compare_req->num_children == 0);
+	CU_ASSERT(compare_req->cmd.opc == SPDK_NVME_OPC_COMPARE);
+	CU_ASSERT(compare_req->cmd.fuse == SPDK_NVME_CMD_FUSE_NONE);
+
+	memset(&cpl, 0, sizeof(cpl));
+	compare_req->cb_fn(compare_req->cb_arg, &cpl);
+	nvme_free_request(compare_req);
+	SPDK_CU_ASSERT_FATAL(g_request != compare_req);
+	write_req = g_request;
+	CU_ASSERT(write_req->cmd.opc == SPDK_NVME_OPC_WRITE);
+	CU_ASSERT(write_req->payload.u.contig == write_buf);
+
+	status.status.sc = SPDK_NVME_SC_INVALID_FIELD;
+	write_req->cb_fn(write_req->cb_arg, &cpl);
+	nvme_free_request(write_req);
+	CU_ASSERT(!spdk_nvme_cpl_is_error(&status));
+}
 
 int main(int argc, char **argv)
 {
 	CU_pSuite	suite = NULL;
 	unsigned int	num_failures;
 
+	g_spdk_nvme_driver = &_g_nvme_driver;
+
 	if (CU_initialize_registry() != CUE_SUCCESS) {
 		return CU_get_error();
 	}
@@ -811,6 +1051,8 @@ int main(int argc, char **argv)
 		|| CU_add_test(suite, "nvme_ns_cmd_readv", test_nvme_ns_cmd_readv) == NULL
 		|| CU_add_test(suite, "nvme_ns_cmd_writev", test_nvme_ns_cmd_writev) == NULL
 		|| CU_add_test(suite, "nvme_ns_cmd_write_with_md", test_nvme_ns_cmd_write_with_md) == NULL
+		|| CU_add_test(suite, "nvme_ns_cmd_write_with_hints", test_nvme_ns_cmd_write_with_hints) == NULL
+		|| CU_add_test(suite, "nvme_ns_cmd_compare_and_write", test_nvme_ns_cmd_compare_and_write) == NULL
 	) {
 		CU_cleanup_registry();
 		return CU_get_error();
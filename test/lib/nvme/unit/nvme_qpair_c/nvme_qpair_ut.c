@@ -49,14 +49,60 @@ struct nvme_driver _g_nvme_driver = {
 
 int32_t spdk_nvme_retry_count = 1;
 
+pid_t g_spdk_nvme_pid;
+
+uint64_t g_ut_tsc = 0;
+
 struct nvme_request *g_request = NULL;
 
 bool fail_vtophys = false;
 
 bool fail_next_sge = false;
 
+uint32_t g_vtophys_calls = 0;
+
+uint16_t g_trace_tpoint_id;
+uint16_t g_trace_poller_id;
+uint64_t g_trace_object_id;
+uint64_t g_trace_arg1;
+
+void
+spdk_trace_record(uint16_t tpoint_id, uint16_t poller_id, uint32_t size,
+		  uint64_t object_id, uint64_t arg1)
+{
+	g_trace_tpoint_id = tpoint_id;
+	g_trace_poller_id = poller_id;
+	g_trace_object_id = object_id;
+	g_trace_arg1 = arg1;
+}
+
+void
+spdk_trace_add_register_fn(struct spdk_trace_register_fn *reg_fn)
+{
+}
+
+void
+spdk_trace_register_owner(uint8_t type, char id_prefix)
+{
+}
+
+void
+spdk_trace_register_object(uint8_t type, char id_prefix)
+{
+}
+
+void
+spdk_trace_register_description(const char *name, const char *short_name,
+				uint16_t tpoint_id, uint8_t owner_type,
+				uint8_t object_type, uint8_t new_object,
+				uint8_t arg1_is_ptr, uint8_t arg1_is_alias,
+				const char *arg1_name)
+{
+}
+
 uint64_t nvme_vtophys(void *buf)
 {
+	g_vtophys_calls++;
 	if (fail_vtophys) {
 		return (uint64_t) - 1;
 	} else {
@@ -163,6 +209,7 @@ nvme_allocate_request_contig(void *buffer, uint32_t payload_size, spdk_nvme_cmd_
 
 	payload.type = NVME_PAYLOAD_TYPE_CONTIG;
 	payload.u.contig = buffer;
+	payload.md = NULL;
 
 	return nvme_allocate_request(&payload, payload_size, cb_fn, cb_arg);
 }
@@ -187,11 +234,40 @@ nvme_request_remove_child(struct nvme_request *parent,
 	TAILQ_REMOVE(&parent->children, child, child_tailq);
 }
 
+struct nvme_request *g_proc_admin_request = NULL;
+
+void
+nvme_ctrlr_queue_proc_admin_request(struct spdk_nvme_ctrlr *ctrlr, struct nvme_request *req,
+				    const struct spdk_nvme_cpl *cpl)
+{
+	req->cpl = *cpl;
+	g_proc_admin_request = req;
+}
+
+void
+nvme_ctrlr_complete_proc_admin_requests(struct spdk_nvme_ctrlr *ctrlr)
+{
+}
+
 int
 nvme_ctrlr_alloc_cmb(struct spdk_nvme_ctrlr *ctrlr, uint64_t length, uint64_t aligned,
 		     uint64_t *offset)
 {
-	return -1;
+	if (ctrlr->cmb_current_offset + length > ctrlr->cmb_size) {
+		return -1;
+	}
+
+	*offset = ctrlr->cmb_current_offset;
+	ctrlr->cmb_current_offset += length;
+	return 0;
+}
+
+void
+nvme_ctrlr_free_cmb(struct spdk_nvme_ctrlr *ctrlr, uint64_t offset, uint64_t length)
+{
+	if (offset + length == ctrlr->cmb_current_offset) {
+		ctrlr->cmb_current_offset = offset;
+	}
 }
 
 static void
@@ -228,9 +304,8 @@ ut_insert_cq_entry(struct spdk_nvme_qpair *qpair, uint32_t slot)
 	SPDK_CU_ASSERT_FATAL(req != NULL);
 	memset(req, 0, sizeof(*req));
 
-	tr = LIST_FIRST(&qpair->free_tr);
-	LIST_REMOVE(tr, list); /* remove tr from free_tr */
-	LIST_INSERT_HEAD(&qpair->outstanding_tr, tr, list);
+	SPDK_CU_ASSERT_FATAL(qpair->num_free_cids > 0);
+	tr = &qpair->tr[qpair->free_cids[--qpair->num_free_cids]];
 	req->cmd.cid = tr->cid;
 	tr->req = req;
 	qpair->tr[tr->cid].active = true;
@@ -321,6 +396,96 @@ test4(void)
 	cleanup_submit_request_test(&qpair);
 }
 
+static void
+test_contig_req_prp_list(void)
+{
+	struct spdk_nvme_qpair		qpair = {};
+	struct nvme_request		*req;
+	struct nvme_tracker		*tr;
+	struct spdk_nvme_ctrlr		ctrlr = {};
+	struct spdk_nvme_registers	regs = {};
+	uintptr_t			payload;
+	uint32_t			i, nseg;
+
+	prepare_submit_request_test(&qpair, &ctrlr, &regs);
+
+	/*
+	 * 1MB payload starting 4 pages and 0x200 bytes before a 2MB boundary.
+	 *  The payload is never dereferenced, so any address will do.
+	 */
+	payload = 0x40000000 + NVME_VTOPHYS_PAGE_SIZE - 4 * PAGE_SIZE - 0x200;
+	nseg = (1024 * 1024) / PAGE_SIZE + 1;
+	req = nvme_allocate_request_contig((void *)payload, 1024 * 1024, expected_success_callback, NULL);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+
+	g_vtophys_calls = 0;
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req) == 0);
+	tr = &qpair.tr[req->cmd.cid];
+	SPDK_CU_ASSERT_FATAL(tr->req == req);
+
+	/* One lookup for PRP1, one for the rest of the first 2MB page, one for the next. */
+	CU_ASSERT(g_vtophys_calls == 3);
+	CU_ASSERT(req->cmd.dptr.prp.prp1 == payload);
+	CU_ASSERT(req->cmd.dptr.prp.prp2 == tr->prp_sgl_bus_addr);
+	for (i = 0; i < nseg - 1; i++) {
+		CU_ASSERT(tr->u.prp[i] == (payload & ~(uintptr_t)(PAGE_SIZE - 1)) + (i + 1) * PAGE_SIZE);
+	}
+
+	nvme_qpair_manual_complete_tracker(&qpair, tr, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_SUCCESS, 0,
+					   false);
+	cleanup_submit_request_test(&qpair);
+}
+
+static void
+test_cmb_req(void)
+{
+	struct spdk_nvme_qpair		qpair = {};
+	struct nvme_request		*req;
+	struct nvme_tracker		*tr;
+	struct spdk_nvme_ctrlr		ctrlr = {};
+	struct spdk_nvme_registers	regs = {};
+	uintptr_t			cmb_virt = 0x80000000;
+	uint64_t			cmb_phys = 0xF0000000;
+	uint32_t			i;
+
+	prepare_submit_request_test(&qpair, &ctrlr, &regs);
+
+	ctrlr.cmb_bar_virt_addr = (void *)cmb_virt;
+	ctrlr.cmb_bar_phys_addr = cmb_phys;
+	ctrlr.cmb_current_offset = 0x100000;
+	ctrlr.cmb_io_data_used = true;
+
+	/* A payload in the CMB is translated from the BAR without vtophys. */
+	req = nvme_allocate_request_contig((void *)(cmb_virt + 0x1000), 4 * PAGE_SIZE,
+					   expected_success_callback, NULL);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+
+	g_vtophys_calls = 0;
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req) == 0);
+	tr = &qpair.tr[req->cmd.cid];
+	SPDK_CU_ASSERT_FATAL(tr->req == req);
+
+	CU_ASSERT(g_vtophys_calls == 0);
+	CU_ASSERT(req->cmd.dptr.prp.prp1 == cmb_phys + 0x1000);
+	for (i = 0; i < 3; i++) {
+		CU_ASSERT(tr->u.prp[i] == cmb_phys + 0x1000 + (i + 1) * PAGE_SIZE);
+	}
+	nvme_qpair_manual_complete_tracker(&qpair, tr, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_SUCCESS, 0,
+					   false);
+
+	/* Host memory payloads still go through vtophys. */
+	req = nvme_allocate_request_contig((void *)0x40000000, PAGE_SIZE, expected_success_callback, NULL);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req) == 0);
+	CU_ASSERT(g_vtophys_calls == 1);
+	CU_ASSERT(req->cmd.dptr.prp.prp1 == 0x40000000);
+	tr = &qpair.tr[req->cmd.cid];
+	SPDK_CU_ASSERT_FATAL(tr->req == req);
+	nvme_qpair_manual_complete_tracker(&qpair, tr, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_SUCCESS, 0,
+					   false);
+
+	cleanup_submit_request_test(&qpair);
+}
 
 static void
 test_sgl_req(void)
@@ -352,8 +517,6 @@ test_sgl_req(void)
 	CU_ASSERT(req->cmd.dptr.prp.prp1 == 7);
 	CU_ASSERT(req->cmd.dptr.prp.prp2 == 4096);
 
-	sgl_tr = LIST_FIRST(&qpair.outstanding_tr);
-	LIST_REMOVE(sgl_tr, list);
 	cleanup_submit_request_test(&qpair);
 	nvme_free_request(req);
 
@@ -395,13 +558,10 @@ test_sgl_req(void)
 
 	CU_ASSERT(req->cmd.dptr.prp.prp1 == 0);
 	CU_ASSERT(qpair.sq_tail == 1);
-	sgl_tr = LIST_FIRST(&qpair.outstanding_tr);
-	if (sgl_tr != NULL) {
-		for (i = 0; i < NVME_MAX_PRP_LIST_ENTRIES; i++) {
-			CU_ASSERT(sgl_tr->u.prp[i] == (PAGE_SIZE * (i + 1)));
-		}
-
-		LIST_REMOVE(sgl_tr, list);
+	sgl_tr = &qpair.tr[req->cmd.cid];
+	SPDK_CU_ASSERT_FATAL(sgl_tr->req == req);
+	for (i = 0; i < NVME_MAX_PRP_LIST_ENTRIES; i++) {
+		CU_ASSERT(sgl_tr->u.prp[i] == (PAGE_SIZE * (i + 1)));
 	}
 	cleanup_submit_request_test(&qpair);
 	nvme_free_request(req);
@@ -435,14 +595,13 @@ test_hw_sgl_req(void)
 
 	nvme_qpair_submit_request(&qpair, req);
 
-	sgl_tr = LIST_FIRST(&qpair.outstanding_tr);
-	CU_ASSERT(sgl_tr != NULL);
+	sgl_tr = &qpair.tr[req->cmd.cid];
+	SPDK_CU_ASSERT_FATAL(sgl_tr->req == req);
 	CU_ASSERT(sgl_tr->u.sgl[0].generic.type == SPDK_NVME_SGL_TYPE_DATA_BLOCK);
 	CU_ASSERT(sgl_tr->u.sgl[0].generic.subtype == 0);
 	CU_ASSERT(sgl_tr->u.sgl[0].unkeyed.length == 4096);
 	CU_ASSERT(sgl_tr->u.sgl[0].address == 0);
 	CU_ASSERT(req->cmd.dptr.sgl1.generic.type == SPDK_NVME_SGL_TYPE_DATA_BLOCK);
-	LIST_REMOVE(sgl_tr, list);
 	cleanup_submit_request_test(&qpair);
 	nvme_free_request(req);
 
@@ -457,8 +616,8 @@ test_hw_sgl_req(void)
 
 	nvme_qpair_submit_request(&qpair, req);
 
-	sgl_tr = LIST_FIRST(&qpair.outstanding_tr);
-	CU_ASSERT(sgl_tr != NULL);
+	sgl_tr = &qpair.tr[req->cmd.cid];
+	SPDK_CU_ASSERT_FATAL(sgl_tr->req == req);
 	for (i = 0; i < NVME_MAX_SGL_DESCRIPTORS; i++) {
 		CU_ASSERT(sgl_tr->u.sgl[i].generic.type == SPDK_NVME_SGL_TYPE_DATA_BLOCK);
 		CU_ASSERT(sgl_tr->u.sgl[i].generic.subtype == 0);
@@ -466,7 +625,6 @@ test_hw_sgl_req(void)
 		CU_ASSERT(sgl_tr->u.sgl[i].address == i * 4096);
 	}
 	CU_ASSERT(req->cmd.dptr.sgl1.generic.type == SPDK_NVME_SGL_TYPE_LAST_SEGMENT);
-	LIST_REMOVE(sgl_tr, list);
 	cleanup_submit_request_test(&qpair);
 	nvme_free_request(req);
 }
@@ -521,16 +679,15 @@ static void test_nvme_qpair_fail(void)
 
 	prepare_submit_request_test(&qpair, &ctrlr, &regs);
 
-	tr_temp = LIST_FIRST(&qpair.free_tr);
-	SPDK_CU_ASSERT_FATAL(tr_temp != NULL);
-	LIST_REMOVE(tr_temp, list);
+	SPDK_CU_ASSERT_FATAL(qpair.num_free_cids > 0);
+	tr_temp = &qpair.tr[qpair.free_cids[--qpair.num_free_cids]];
 	tr_temp->req = nvme_allocate_request_null(expected_failure_callback, NULL);
 	SPDK_CU_ASSERT_FATAL(tr_temp->req != NULL);
 	tr_temp->req->cmd.cid = tr_temp->cid;
 
-	LIST_INSERT_HEAD(&qpair.outstanding_tr, tr_temp, list);
 	nvme_qpair_fail(&qpair);
-	CU_ASSERT_TRUE(LIST_EMPTY(&qpair.outstanding_tr));
+	CU_ASSERT(tr_temp->req == NULL);
+	CU_ASSERT(qpair.num_free_cids == qpair.num_trackers);
 
 	req = nvme_allocate_request_null(expected_failure_callback, NULL);
 	SPDK_CU_ASSERT_FATAL(req != NULL);
@@ -588,6 +745,408 @@ test_nvme_qpair_process_completions_limit(void)
 	cleanup_submit_request_test(&qpair);
 }
 
+static void
+test_nvme_qpair_cid_reuse(void)
+{
+	struct spdk_nvme_qpair		qpair = {};
+	struct spdk_nvme_ctrlr		ctrlr = {};
+	struct spdk_nvme_registers	regs = {};
+	struct nvme_request		*req1, *req2, *req3;
+
+	prepare_submit_request_test(&qpair, &ctrlr, &regs);
+	CU_ASSERT(qpair.num_free_cids == qpair.num_trackers);
+
+	/* Command IDs are handed out lowest first. */
+	req1 = nvme_allocate_request_null(expected_success_callback, NULL);
+	SPDK_CU_ASSERT_FATAL(req1 != NULL);
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req1) == 0);
+	CU_ASSERT(req1->cmd.cid == 0);
+
+	req2 = nvme_allocate_request_null(expected_success_callback, NULL);
+	SPDK_CU_ASSERT_FATAL(req2 != NULL);
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req2) == 0);
+	CU_ASSERT(req2->cmd.cid == 1);
+	CU_ASSERT(qpair.num_free_cids == qpair.num_trackers - 2);
+
+	/* The most recently completed command ID is reused first. */
+	nvme_qpair_manual_complete_tracker(&qpair, &qpair.tr[0], SPDK_NVME_SCT_GENERIC,
+					   SPDK_NVME_SC_SUCCESS, 0, false);
+	CU_ASSERT(qpair.tr[0].req == NULL);
+	CU_ASSERT(qpair.num_free_cids == qpair.num_trackers - 1);
+
+	req3 = nvme_allocate_request_null(expected_success_callback, NULL);
+	SPDK_CU_ASSERT_FATAL(req3 != NULL);
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req3) == 0);
+	CU_ASSERT(req3->cmd.cid == 0);
+	CU_ASSERT(qpair.tr[0].req == req3);
+
+	nvme_qpair_manual_complete_tracker(&qpair, &qpair.tr[0], SPDK_NVME_SCT_GENERIC,
+					   SPDK_NVME_SC_SUCCESS, 0, false);
+	nvme_qpair_manual_complete_tracker(&qpair, &qpair.tr[1], SPDK_NVME_SCT_GENERIC,
+					   SPDK_NVME_SC_SUCCESS, 0, false);
+	CU_ASSERT(qpair.num_free_cids == qpair.num_trackers);
+
+	cleanup_submit_request_test(&qpair);
+}
+
+static void
+test_nvme_qpair_fused_request(void)
+{
+	struct spdk_nvme_qpair		qpair = {};
+	struct spdk_nvme_ctrlr		ctrlr = {};
+	struct spdk_nvme_registers	regs = {};
+	struct nvme_request		*parent, *first, *second, *other;
+	uint32_t			num_free_cids;
+
+	prepare_submit_request_test(&qpair, &ctrlr, &regs);
+
+	parent = nvme_allocate_request_null(NULL, NULL);
+	first = nvme_allocate_request_null(NULL, NULL);
+	second = nvme_allocate_request_null(NULL, NULL);
+	SPDK_CU_ASSERT_FATAL(parent != NULL && first != NULL && second != NULL);
+	first->cmd.opc = SPDK_NVME_OPC_COMPARE;
+	first->cmd.fuse = SPDK_NVME_CMD_FUSE_FIRST;
+	second->cmd.opc = SPDK_NVME_OPC_WRITE;
+	second->cmd.fuse = SPDK_NVME_CMD_FUSE_SECOND;
+	TAILQ_INIT(&parent->children);
+	TAILQ_INSERT_TAIL(&parent->children, first, child_tailq);
+	TAILQ_INSERT_TAIL(&parent->children, second, child_tailq);
+	parent->num_children = 2;
+
+	/* With a single free tracker the pair waits at the head of the queue. */
+	num_free_cids = qpair.num_free_cids;
+	qpair.num_free_cids = 1;
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, parent) == 0);
+	CU_ASSERT(STAILQ_FIRST(&qpair.queued_req) == parent);
+	CU_ASSERT(qpair.sq_tail == 0);
+
+	other = nvme_allocate_request_null(NULL, NULL);
+	SPDK_CU_ASSERT_FATAL(other != NULL);
+	qpair.num_free_cids = 0;
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, other) == 0);
+	CU_ASSERT(STAILQ_FIRST(&qpair.queued_req) == parent);
+	STAILQ_REMOVE_HEAD(&qpair.queued_req, stailq);
+	STAILQ_REMOVE_HEAD(&qpair.queued_req, stailq);
+	nvme_free_request(other);
+	qpair.num_free_cids = num_free_cids;
+
+	/* Both commands occupy adjacent submission queue slots. */
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, parent) == 0);
+	CU_ASSERT(qpair.sq_tail == 2);
+	CU_ASSERT(qpair.cmd[0].opc == SPDK_NVME_OPC_COMPARE);
+	CU_ASSERT(qpair.cmd[0].fuse == SPDK_NVME_CMD_FUSE_FIRST);
+	CU_ASSERT(qpair.cmd[1].opc == SPDK_NVME_OPC_WRITE);
+	CU_ASSERT(qpair.cmd[1].fuse == SPDK_NVME_CMD_FUSE_SECOND);
+	CU_ASSERT(qpair.num_free_cids == num_free_cids - 2);
+
+	nvme_qpair_manual_complete_tracker(&qpair, &qpair.tr[first->cmd.cid], SPDK_NVME_SCT_GENERIC,
+					   SPDK_NVME_SC_SUCCESS, 0, false);
+	nvme_qpair_manual_complete_tracker(&qpair, &qpair.tr[second->cmd.cid], SPDK_NVME_SCT_GENERIC,
+					   SPDK_NVME_SC_SUCCESS, 0, false);
+	CU_ASSERT(qpair.num_free_cids == num_free_cids);
+	nvme_free_request(parent);
+
+	cleanup_submit_request_test(&qpair);
+}
+
+static void
+test_nvme_qpair_trace(void)
+{
+	struct spdk_nvme_qpair		qpair = {};
+	struct spdk_nvme_ctrlr		ctrlr = {};
+	struct spdk_nvme_registers	regs = {};
+	struct nvme_request		*req;
+	struct nvme_tracker		*tr;
+	uint32_t			num_free_cids;
+
+	prepare_submit_request_test(&qpair, &ctrlr, &regs);
+	qpair.id = 1;
+
+	/* Submission starts a command object identified by its tracker. */
+	req = nvme_allocate_request_null(expected_success_callback, NULL);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req) == 0);
+	tr = &qpair.tr[req->cmd.cid];
+	CU_ASSERT(g_trace_tpoint_id == TRACE_NVME_SUBMIT);
+	CU_ASSERT(g_trace_poller_id == 1);
+	CU_ASSERT(g_trace_object_id == (uintptr_t)tr);
+	CU_ASSERT(g_trace_arg1 == tr->cid);
+
+	/* Completion ends the same object, giving the driver-level latency. */
+	g_trace_tpoint_id = 0;
+	nvme_qpair_manual_complete_tracker(&qpair, tr, SPDK_NVME_SCT_GENERIC,
+					   SPDK_NVME_SC_SUCCESS, 0, false);
+	CU_ASSERT(g_trace_tpoint_id == TRACE_NVME_COMPLETE);
+	CU_ASSERT(g_trace_object_id == (uintptr_t)tr);
+
+	/* A request that cannot get a tracker is traced as queued. */
+	num_free_cids = qpair.num_free_cids;
+	qpair.num_free_cids = 0;
+	req = nvme_allocate_request_null(NULL, NULL);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req) == 0);
+	CU_ASSERT(g_trace_tpoint_id == TRACE_NVME_QUEUED);
+	CU_ASSERT(g_trace_arg1 == (uintptr_t)req);
+	STAILQ_REMOVE_HEAD(&qpair.queued_req, stailq);
+	nvme_free_request(req);
+	qpair.num_free_cids = num_free_cids;
+
+	cleanup_submit_request_test(&qpair);
+}
+
+static uint32_t g_proc_cb_count;
+
+static void
+proc_cb(void *arg, const struct spdk_nvme_cpl *cpl)
+{
+	g_proc_cb_count++;
+}
+
+static void
+test_nvme_qpair_proc_admin_request(void)
+{
+	struct spdk_nvme_qpair		qpair = {};
+	struct spdk_nvme_ctrlr		ctrlr = {};
+	struct spdk_nvme_registers	regs = {};
+	struct nvme_request		*req;
+
+	prepare_submit_request_test(&qpair, &ctrlr, &regs);
+	qpair.id = 0;
+	g_proc_cb_count = 0;
+	g_proc_admin_request = NULL;
+
+	/* Admin requests of this process complete in place. */
+	req = nvme_allocate_request_null(proc_cb, NULL);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req) == 0);
+	nvme_qpair_manual_complete_tracker(&qpair, &qpair.tr[req->cmd.cid], SPDK_NVME_SCT_GENERIC,
+					   SPDK_NVME_SC_SUCCESS, 0, false);
+	CU_ASSERT(g_proc_cb_count == 1);
+	CU_ASSERT(g_proc_admin_request == NULL);
+
+	/* Admin requests of another process are handed back to it with their status. */
+	req = nvme_allocate_request_null(proc_cb, NULL);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+	req->pid = g_spdk_nvme_pid + 1;
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req) == 0);
+	nvme_qpair_manual_complete_tracker(&qpair, &qpair.tr[req->cmd.cid], SPDK_NVME_SCT_GENERIC,
+					   SPDK_NVME_SC_INVALID_FIELD, 0, false);
+	CU_ASSERT(g_proc_cb_count == 1);
+	CU_ASSERT(g_proc_admin_request == req);
+	CU_ASSERT(req->cpl.status.sc == SPDK_NVME_SC_INVALID_FIELD);
+	CU_ASSERT(qpair.num_free_cids == qpair.num_trackers);
+	nvme_free_request(req);
+	g_proc_admin_request = NULL;
+
+	/* I/O qpairs are only used by the process that allocated them. */
+	qpair.id = 1;
+	req = nvme_allocate_request_null(proc_cb, NULL);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+	req->pid = g_spdk_nvme_pid + 1;
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req) == 0);
+	nvme_qpair_manual_complete_tracker(&qpair, &qpair.tr[req->cmd.cid], SPDK_NVME_SCT_GENERIC,
+					   SPDK_NVME_SC_SUCCESS, 0, false);
+	CU_ASSERT(g_proc_cb_count == 2);
+	CU_ASSERT(g_proc_admin_request == NULL);
+
+	cleanup_submit_request_test(&qpair);
+}
+
+static uint32_t g_timeout_count;
+static uint16_t g_timeout_cid;
+static struct spdk_nvme_qpair *g_timeout_qpair;
+
+static void
+timeout_cb(void *cb_arg, struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_qpair *qpair,
+	   uint16_t cid)
+{
+	g_timeout_count++;
+	g_timeout_cid = cid;
+	g_timeout_qpair = qpair;
+}
+
+static void
+test_nvme_qpair_timeout(void)
+{
+	struct spdk_nvme_qpair		qpair = {};
+	struct spdk_nvme_ctrlr		ctrlr = {};
+	struct spdk_nvme_registers	regs = {};
+	struct nvme_request		*req1, *req2, *req3;
+	uint64_t			hz = nvme_get_tsc_hz();
+
+	prepare_submit_request_test(&qpair, &ctrlr, &regs);
+	g_timeout_count = 0;
+
+	/* Commands submitted while timeouts are disabled are never reported. */
+	g_ut_tsc = 1;
+	req1 = nvme_allocate_request_null(expected_success_callback, NULL);
+	SPDK_CU_ASSERT_FATAL(req1 != NULL);
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req1) == 0);
+
+	ctrlr.timeout_ticks = 10 * hz;
+	ctrlr.timeout_cb_fn = timeout_cb;
+
+	g_ut_tsc = 2 * hz;
+	req2 = nvme_allocate_request_null(expected_success_callback, NULL);
+	SPDK_CU_ASSERT_FATAL(req2 != NULL);
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req2) == 0);
+
+	g_ut_tsc = 4 * hz;
+	req3 = nvme_allocate_request_null(expected_success_callback, NULL);
+	SPDK_CU_ASSERT_FATAL(req3 != NULL);
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req3) == 0);
+
+	/* Nothing has expired yet. */
+	g_ut_tsc = 12 * hz - 1;
+	spdk_nvme_qpair_process_completions(&qpair, 0);
+	CU_ASSERT(g_timeout_count == 0);
+
+	/* Only req2 has expired. */
+	g_ut_tsc = 12 * hz;
+	spdk_nvme_qpair_process_completions(&qpair, 0);
+	CU_ASSERT(g_timeout_count == 1);
+	CU_ASSERT(g_timeout_cid == req2->cmd.cid);
+	CU_ASSERT(g_timeout_qpair == &qpair);
+
+	/* Each command is reported only once. */
+	spdk_nvme_qpair_process_completions(&qpair, 0);
+	CU_ASSERT(g_timeout_count == 1);
+
+	g_ut_tsc = 14 * hz;
+	spdk_nvme_qpair_process_completions(&qpair, 0);
+	CU_ASSERT(g_timeout_count == 2);
+	CU_ASSERT(g_timeout_cid == req3->cmd.cid);
+
+	nvme_free_request(req1);
+	nvme_free_request(req2);
+	nvme_free_request(req3);
+	cleanup_submit_request_test(&qpair);
+	g_ut_tsc = 0;
+}
+
+static void
+test_nvme_qpair_timeout_retry(void)
+{
+	struct spdk_nvme_qpair		qpair = {};
+	struct spdk_nvme_ctrlr		ctrlr = {};
+	struct spdk_nvme_registers	regs = {};
+	struct nvme_request		*req;
+	struct nvme_tracker		*tr;
+	uint64_t			hz = nvme_get_tsc_hz();
+
+	prepare_submit_request_test(&qpair, &ctrlr, &regs);
+	g_timeout_count = 0;
+	ctrlr.timeout_ticks = 10 * hz;
+	ctrlr.timeout_cb_fn = timeout_cb;
+
+	g_ut_tsc = 1 * hz;
+	req = nvme_allocate_request_null(expected_success_callback, NULL);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+	CU_ASSERT(nvme_qpair_submit_request(&qpair, req) == 0);
+	tr = &qpair.tr[req->cmd.cid];
+
+	/* The command fails with a retryable status and is resubmitted. */
+	g_ut_tsc = 8 * hz;
+	nvme_qpair_manual_complete_tracker(&qpair, tr, SPDK_NVME_SCT_GENERIC,
+					   SPDK_NVME_SC_NAMESPACE_NOT_READY, 0, false);
+	CU_ASSERT(tr->req == req);
+	CU_ASSERT(req->retries == 1);
+	CU_ASSERT(tr->submit_tick == 8 * hz);
+
+	/* The timeout restarts with the resubmission. */
+	g_ut_tsc = 11 * hz;
+	spdk_nvme_qpair_process_completions(&qpair, 0);
+	CU_ASSERT(g_timeout_count == 0);
+
+	g_ut_tsc = 18 * hz;
+	spdk_nvme_qpair_process_completions(&qpair, 0);
+	CU_ASSERT(g_timeout_count == 1);
+	CU_ASSERT(g_timeout_cid == req->cmd.cid);
+
+	nvme_qpair_manual_complete_tracker(&qpair, tr, SPDK_NVME_SCT_GENERIC,
+					   SPDK_NVME_SC_SUCCESS, 0, false);
+	cleanup_submit_request_test(&qpair);
+	g_ut_tsc = 0;
+}
+
+static void
+ut_complete_all_trackers(struct spdk_nvme_qpair *qpair)
+{
+	uint16_t i;
+
+	while (qpair->num_free_cids != qpair->num_trackers) {
+		for (i = 0; i < qpair->num_trackers; i++) {
+			if (qpair->tr[i].req != NULL) {
+				nvme_qpair_manual_complete_tracker(qpair, &qpair->tr[i], SPDK_NVME_SCT_GENERIC,
+								   SPDK_NVME_SC_SUCCESS, 0, false);
+			}
+		}
+	}
+}
+
+static void
+test_nvme_qpair_depth_limiter(void)
+{
+	struct spdk_nvme_qpair		qpair = {};
+	struct spdk_nvme_ctrlr		ctrlr = {};
+	struct spdk_nvme_registers	regs = {};
+	struct spdk_nvme_qpair_stats	stats;
+	struct nvme_request		*req;
+	uint16_t			i;
+
+	prepare_submit_request_test(&qpair, &ctrlr, &regs);
+	nvme_qpair_init_depth_limiter(&qpair, 10);
+	CU_ASSERT(qpair.limiter.latency_target_ticks == 10);
+	CU_ASSERT(qpair.limiter.depth_limit == qpair.num_trackers);
+	CU_ASSERT(qpair.min_free_cids == 0);
+
+	/* A full window that misses the latency target lowers the depth limit. */
+	g_ut_tsc = 1;
+	for (i = 0; i < qpair.num_trackers; i++) {
+		req = nvme_allocate_request_null(expected_success_callback, NULL);
+		SPDK_CU_ASSERT_FATAL(req != NULL);
+		CU_ASSERT(nvme_qpair_submit_request(&qpair, req) == 0);
+	}
+	CU_ASSERT(qpair.num_free_cids == 0);
+	CU_ASSERT(qpair.limiter.window_saturated == true);
+
+	g_ut_tsc = 101;
+	ut_complete_all_trackers(&qpair);
+	CU_ASSERT(qpair.limiter.depth_limit == 24);
+	CU_ASSERT(qpair.limiter.depth_decreases == 1);
+	CU_ASSERT(qpair.min_free_cids == qpair.num_trackers - 24);
+
+	/* Requests beyond the depth limit wait on the queue. */
+	g_ut_tsc = 200;
+	for (i = 0; i < 25; i++) {
+		req = nvme_allocate_request_null(expected_success_callback, NULL);
+		SPDK_CU_ASSERT_FATAL(req != NULL);
+		CU_ASSERT(nvme_qpair_submit_request(&qpair, req) == 0);
+	}
+	CU_ASSERT(qpair.num_free_cids == qpair.min_free_cids);
+	CU_ASSERT(STAILQ_FIRST(&qpair.queued_req) == req);
+	CU_ASSERT(qpair.limiter.throttled_requests == 1);
+
+	/* A saturated window that meets the target raises the limit by one. */
+	g_ut_tsc = 205;
+	ut_complete_all_trackers(&qpair);
+	CU_ASSERT(STAILQ_EMPTY(&qpair.queued_req));
+	CU_ASSERT(qpair.limiter.depth_limit == 25);
+	CU_ASSERT(qpair.limiter.depth_increases == 1);
+	CU_ASSERT(qpair.min_free_cids == qpair.num_trackers - 25);
+
+	spdk_nvme_qpair_get_stats(&qpair, &stats);
+	CU_ASSERT(stats.depth_limit == 25);
+	CU_ASSERT(stats.max_depth == qpair.num_trackers);
+	CU_ASSERT(stats.depth_increases == 1);
+	CU_ASSERT(stats.depth_decreases == 1);
+	CU_ASSERT(stats.throttled_requests == 1);
+	CU_ASSERT(stats.avg_latency_us == 5);
+
+	cleanup_submit_request_test(&qpair);
+	g_ut_tsc = 0;
+}
+
 static void test_nvme_qpair_destroy(void)
 {
 	struct spdk_nvme_qpair		qpair = {};
@@ -605,18 +1164,64 @@ static void test_nvme_qpair_destroy(void)
 
 
 	nvme_qpair_construct(&qpair, 0, 128, 32, &ctrlr);
-	tr_temp = LIST_FIRST(&qpair.free_tr);
-	SPDK_CU_ASSERT_FATAL(tr_temp != NULL);
-	LIST_REMOVE(tr_temp, list);
+	SPDK_CU_ASSERT_FATAL(qpair.num_free_cids > 0);
+	tr_temp = &qpair.tr[qpair.free_cids[--qpair.num_free_cids]];
 	tr_temp->req = nvme_allocate_request_null(expected_failure_callback, NULL);
 	SPDK_CU_ASSERT_FATAL(tr_temp->req != NULL);
 
 	tr_temp->req->cmd.opc = SPDK_NVME_OPC_ASYNC_EVENT_REQUEST;
 	tr_temp->req->cmd.cid = tr_temp->cid;
-	LIST_INSERT_HEAD(&qpair.outstanding_tr, tr_temp, list);
 
 	nvme_qpair_destroy(&qpair);
-	CU_ASSERT(LIST_EMPTY(&qpair.outstanding_tr));
+	CU_ASSERT(qpair.num_free_cids == qpair.num_trackers);
+}
+
+static void test_nvme_qpair_construct_cmb_sq(void)
+{
+	struct spdk_nvme_qpair		qpair = {};
+	struct spdk_nvme_ctrlr		ctrlr = {};
+	struct spdk_nvme_registers	regs = {};
+	static uint8_t			cmb[0x10000];
+	uint64_t			offset;
+
+	ctrlr.regs = &regs;
+	ctrlr.opts.use_cmb_sqs = true;
+	ctrlr.cmb_bar_virt_addr = cmb;
+	ctrlr.cmb_bar_phys_addr = 0x100000;
+	ctrlr.cmb_size = sizeof(cmb);
+	TAILQ_INIT(&ctrlr.free_io_qpairs);
+	TAILQ_INIT(&ctrlr.active_io_qpairs);
+
+	CU_ASSERT(nvme_qpair_construct(&qpair, 1, 128, 32, &ctrlr) == 0);
+	CU_ASSERT(qpair.sq_in_cmb == true);
+	CU_ASSERT((uint8_t *)qpair.cmd == cmb);
+	CU_ASSERT(qpair.cmd_bus_addr == 0x100000);
+	CU_ASSERT(ctrlr.cmb_current_offset == 128 * sizeof(struct spdk_nvme_cmd));
+
+	/* A smaller ring reuses the SQ space that is already reserved */
+	nvme_qpair_destroy(&qpair);
+	CU_ASSERT(nvme_qpair_construct(&qpair, 1, 64, 32, &ctrlr) == 0);
+	CU_ASSERT(qpair.sq_in_cmb == true);
+	CU_ASSERT((uint8_t *)qpair.cmd == cmb);
+	CU_ASSERT(qpair.cmb_sq_size == 128 * sizeof(struct spdk_nvme_cmd));
+	CU_ASSERT(ctrlr.cmb_current_offset == 128 * sizeof(struct spdk_nvme_cmd));
+
+	/* A larger ring gives back the old SQ space when it is the last reservation */
+	nvme_qpair_destroy(&qpair);
+	CU_ASSERT(nvme_qpair_construct(&qpair, 1, 256, 32, &ctrlr) == 0);
+	CU_ASSERT(qpair.sq_in_cmb == true);
+	CU_ASSERT((uint8_t *)qpair.cmd == cmb);
+	CU_ASSERT(ctrlr.cmb_current_offset == 256 * sizeof(struct spdk_nvme_cmd));
+
+	/* Without room for the larger ring the SQ falls back to host memory */
+	CU_ASSERT(nvme_ctrlr_alloc_cmb(&ctrlr, 0x1000, 0x1000, &offset) == 0);
+	nvme_qpair_destroy(&qpair);
+	CU_ASSERT(nvme_qpair_construct(&qpair, 1, 1024, 32, &ctrlr) == 0);
+	CU_ASSERT(qpair.sq_in_cmb == false);
+	CU_ASSERT((uint8_t *)qpair.cmd < cmb || (uint8_t *)qpair.cmd >= cmb + sizeof(cmb));
+	CU_ASSERT(ctrlr.cmb_current_offset == 256 * sizeof(struct spdk_nvme_cmd) + 0x1000);
+
+	nvme_qpair_destroy(&qpair);
 }
 
 static void test_nvme_completion_is_retry(void)
@@ -764,11 +1369,22 @@ int main(int argc, char **argv)
 			   test_nvme_qpair_process_completions) == NULL
 	    || CU_add_test(suite, "spdk_nvme_qpair_process_completions_limit",
 			   test_nvme_qpair_process_completions_limit) == NULL
+	    || CU_add_test(suite, "nvme_qpair_cid_reuse", test_nvme_qpair_cid_reuse) == NULL
+	    || CU_add_test(suite, "nvme_qpair_fused_request", test_nvme_qpair_fused_request) == NULL
+	    || CU_add_test(suite, "nvme_qpair_trace", test_nvme_qpair_trace) == NULL
+	    || CU_add_test(suite, "nvme_qpair_proc_admin_request",
+			   test_nvme_qpair_proc_admin_request) == NULL
+	    || CU_add_test(suite, "nvme_qpair_timeout", test_nvme_qpair_timeout) == NULL
+	    || CU_add_test(suite, "nvme_qpair_timeout_retry", test_nvme_qpair_timeout_retry) == NULL
+	    || CU_add_test(suite, "nvme_qpair_depth_limiter", test_nvme_qpair_depth_limiter) == NULL
 	    || CU_add_test(suite, "nvme_qpair_destroy", test_nvme_qpair_destroy) == NULL
+	    || CU_add_test(suite, "nvme_qpair_construct_cmb_sq", test_nvme_qpair_construct_cmb_sq) == NULL
 	    || CU_add_test(suite, "nvme_completion_is_retry", test_nvme_completion_is_retry) == NULL
 #ifdef DEBUG
 	    || CU_add_test(suite, "get_status_string", test_get_status_string) == NULL
 #endif
+	    || CU_add_test(suite, "contig_request_prp_list", test_contig_req_prp_list) == NULL
+	    || CU_add_test(suite, "cmb_request", test_cmb_req) == NULL
 	    || CU_add_test(suite, "sgl_request", test_sgl_req) == NULL
 	    || CU_add_test(suite, "hw_sgl_request", test_hw_sgl_req) == NULL
 	   ) {
@@ -0,0 +1,707 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "spdk_cunit.h"
+
+/* The socket calls of nvme_tcp.c are redirected to in-memory buffers */
+static ssize_t ut_recv(int sockfd, void *buf, size_t len, int flags);
+static ssize_t ut_writev(int fd, const struct iovec *iov, int iovcnt);
+#define recv(sockfd, buf, len, flags)	ut_recv(sockfd, buf, len, flags)
+#define writev(fd, iov, iovcnt)		ut_writev(fd, iov, iovcnt)
+
+#include "nvme/nvme_tcp.c"
+
+#undef recv
+#undef writev
+
+uint64_t g_ut_tsc = 0;
+
+/* Bytes the controller sent, consumed by recv() */
+static uint8_t g_recv_data[64 * 1024];
+static size_t g_recv_len;
+static size_t g_recv_offset;
+
+/* Bytes the host wrote, and how many more bytes writev() accepts */
+static uint8_t g_sent_data[64 * 1024];
+static size_t g_sent_len;
+static size_t g_writev_limit;
+
+/* Ticks that pass on every recv() that finds no data */
+static uint64_t g_tsc_per_idle_recv;
+
+static struct spdk_nvme_cpl g_cpl;
+static int g_completions;
+
+static ssize_t
+ut_recv(int sockfd, void *buf, size_t len, int flags)
+{
+	size_t avail = g_recv_len - g_recv_offset;
+
+	if (avail == 0) {
+		g_ut_tsc += g_tsc_per_idle_recv;
+		errno = EAGAIN;
+		return -1;
+	}
+
+	len = len < avail ? len : avail;
+	memcpy(buf, &g_recv_data[g_recv_offset], len);
+	g_recv_offset += len;
+	return len;
+}
+
+static ssize_t
+ut_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	size_t total = 0, len;
+	int i;
+
+	if (g_writev_limit == 0) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	for (i = 0; i < iovcnt && g_writev_limit > 0; i++) {
+		len = iov[i].iov_len < g_writev_limit ? iov[i].iov_len : g_writev_limit;
+		SPDK_CU_ASSERT_FATAL(g_sent_len + len <= sizeof(g_sent_data));
+		memcpy(&g_sent_data[g_sent_len], iov[i].iov_base, len);
+		g_sent_len += len;
+		g_writev_limit -= len;
+		total += len;
+	}
+
+	return total;
+}
+
+void
+nvme_qpair_complete_tracker(struct spdk_nvme_qpair *qpair, struct nvme_tracker *tr,
+			    struct spdk_nvme_cpl *cpl, bool print_on_error)
+{
+	g_cpl = *cpl;
+	g_completions++;
+	tr->active = 0;
+}
+
+static void
+ut_reset_sock(void)
+{
+	g_recv_len = 0;
+	g_recv_offset = 0;
+	g_sent_len = 0;
+	g_writev_limit = SIZE_MAX;
+	g_tsc_per_idle_recv = 0;
+	g_completions = 0;
+	memset(&g_cpl, 0, sizeof(g_cpl));
+}
+
+static void
+ut_push(const void *buf, size_t len)
+{
+	SPDK_CU_ASSERT_FATAL(g_recv_len + len <= sizeof(g_recv_data));
+	memcpy(&g_recv_data[g_recv_len], buf, len);
+	g_recv_len += len;
+}
+
+static void
+ut_push_c2h_data(uint16_t cid, uint32_t datao, const void *data, uint32_t datal, uint8_t flags)
+{
+	struct spdk_nvme_tcp_c2h_data_hdr c2h_data;
+
+	memset(&c2h_data, 0, sizeof(c2h_data));
+	c2h_data.common.pdu_type = SPDK_NVME_TCP_PDU_TYPE_C2H_DATA;
+	c2h_data.common.flags = flags;
+	c2h_data.common.hlen = sizeof(c2h_data);
+	c2h_data.common.pdo = sizeof(c2h_data);
+	c2h_data.common.plen = sizeof(c2h_data) + datal;
+	c2h_data.cccid = cid;
+	c2h_data.datao = datao;
+	c2h_data.datal = datal;
+	ut_push(&c2h_data, sizeof(c2h_data));
+	ut_push(data, datal);
+}
+
+static void
+ut_push_r2t(uint16_t cid, uint16_t ttag, uint32_t r2to, uint32_t r2tl)
+{
+	struct spdk_nvme_tcp_r2t_hdr r2t;
+
+	memset(&r2t, 0, sizeof(r2t));
+	r2t.common.pdu_type = SPDK_NVME_TCP_PDU_TYPE_R2T;
+	r2t.common.hlen = sizeof(r2t);
+	r2t.common.plen = sizeof(r2t);
+	r2t.cccid = cid;
+	r2t.ttag = ttag;
+	r2t.r2to = r2to;
+	r2t.r2tl = r2tl;
+	ut_push(&r2t, sizeof(r2t));
+}
+
+static void
+ut_push_capsule_resp(uint16_t cid)
+{
+	struct spdk_nvme_tcp_rsp rsp;
+
+	memset(&rsp, 0, sizeof(rsp));
+	rsp.common.pdu_type = SPDK_NVME_TCP_PDU_TYPE_CAPSULE_RESP;
+	rsp.common.hlen = sizeof(rsp);
+	rsp.common.plen = sizeof(rsp);
+	rsp.rccqe.cid = cid;
+	ut_push(&rsp, sizeof(rsp));
+}
+
+/* Set up a connected I/O qpair as if the ICReq/ICResp exchange had completed. */
+static void
+ut_qpair_init(struct spdk_nvme_qpair *qpair, uint16_t num_trackers)
+{
+	struct nvme_tcp_qpair *tqpair;
+
+	ut_reset_sock();
+
+	memset(qpair, 0, sizeof(*qpair));
+	qpair->id = 1;
+	qpair->num_trackers = num_trackers;
+	qpair->tr = calloc(num_trackers, sizeof(*qpair->tr));
+	SPDK_CU_ASSERT_FATAL(qpair->tr != NULL);
+
+	tqpair = calloc(1, sizeof(*tqpair));
+	SPDK_CU_ASSERT_FATAL(tqpair != NULL);
+	tqpair->sock = -1;
+	TAILQ_INIT(&tqpair->send_queue);
+	nvme_tcp_recv_next_pdu(&tqpair->recv_pdu);
+	tqpair->ic_done = true;
+	tqpair->cpda_bytes = 4;
+	tqpair->maxh2cdata = 4096;
+	tqpair->in_capsule_data_size = 0;
+	tqpair->num_reqs = num_trackers;
+	tqpair->reqs = calloc(num_trackers, sizeof(*tqpair->reqs));
+	tqpair->recv_buf = malloc(NVME_TCP_RECV_BUF_SIZE);
+	SPDK_CU_ASSERT_FATAL(tqpair->reqs != NULL && tqpair->recv_buf != NULL);
+
+	qpair->transport_ctx = tqpair;
+}
+
+static void
+ut_qpair_fini(struct spdk_nvme_qpair *qpair)
+{
+	nvme_tcp_qpair_disconnect(qpair);
+	free(qpair->tr);
+}
+
+/* Submit a command with a contiguous payload on the given command ID. */
+static void
+ut_submit(struct spdk_nvme_qpair *qpair, struct nvme_request *req, uint16_t cid, uint8_t opc,
+	  void *buf, uint32_t len)
+{
+	struct nvme_tracker *tr = &qpair->tr[cid];
+
+	memset(req, 0, sizeof(*req));
+	req->cmd.opc = opc;
+	req->payload.type = NVME_PAYLOAD_TYPE_CONTIG;
+	req->payload.u.contig = buf;
+	req->payload_size = len;
+
+	tr->req = req;
+	tr->cid = cid;
+	tr->active = 1;
+	nvme_tcp_qpair_queue_tracker(qpair, tr);
+}
+
+static void
+test_nvme_tcp_c2h_data(void)
+{
+	struct spdk_nvme_qpair	qpair;
+	struct nvme_tcp_qpair	*tqpair;
+	struct nvme_request	req;
+	uint8_t			buf[8192], data[8192];
+	int			rc;
+
+	memset(data, 0x5A, 4096);
+	memset(data + 4096, 0xA5, 4096);
+
+	/* Data in two PDUs, the last one completing the command without a CapsuleResp */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	memset(buf, 0, sizeof(buf));
+	ut_submit(&qpair, &req, 2, SPDK_NVME_OPC_READ, buf, sizeof(buf));
+	ut_push_c2h_data(2, 0, data, 4096, 0);
+	ut_push_c2h_data(2, 4096, data + 4096, 4096,
+			 SPDK_NVME_TCP_C2H_DATA_FLAGS_LAST_PDU |
+			 SPDK_NVME_TCP_C2H_DATA_FLAGS_SUCCESS);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 1);
+	CU_ASSERT(g_completions == 1);
+	CU_ASSERT(g_cpl.cid == 2);
+	CU_ASSERT(memcmp(buf, data, sizeof(buf)) == 0);
+	CU_ASSERT(tqpair->recv_pdu.state == NVME_TCP_RECV_STATE_CH);
+	CU_ASSERT(!tqpair->failed);
+	/* The CapsuleCmd was written out */
+	CU_ASSERT(g_sent_len == sizeof(struct spdk_nvme_tcp_cmd));
+	ut_qpair_fini(&qpair);
+
+	/* Data that does not start where the previous PDU ended */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 0, SPDK_NVME_OPC_READ, buf, sizeof(buf));
+	ut_push_c2h_data(0, 4096, data, 4096, 0);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	CU_ASSERT(g_completions == 0);
+	ut_qpair_fini(&qpair);
+
+	/* Data past the end of the payload */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 0, SPDK_NVME_OPC_READ, buf, 4096);
+	ut_push_c2h_data(0, 0, data, 8192, 0);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	ut_qpair_fini(&qpair);
+
+	/* DATAL that disagrees with the PDU length */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 0, SPDK_NVME_OPC_READ, buf, sizeof(buf));
+	ut_push_c2h_data(0, 0, data, 4096, 0);
+	((struct spdk_nvme_tcp_c2h_data_hdr *)g_recv_data)->datal = 2048;
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	ut_qpair_fini(&qpair);
+
+	/* Command ID that is not outstanding */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 0, SPDK_NVME_OPC_READ, buf, sizeof(buf));
+	ut_push_c2h_data(3, 0, data, 4096, 0);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	ut_qpair_fini(&qpair);
+
+	/* SUCCESS without LAST_PDU */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 0, SPDK_NVME_OPC_READ, buf, sizeof(buf));
+	ut_push_c2h_data(0, 0, data, 4096, SPDK_NVME_TCP_C2H_DATA_FLAGS_SUCCESS);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	ut_qpair_fini(&qpair);
+}
+
+static void
+test_nvme_tcp_r2t(void)
+{
+	struct spdk_nvme_qpair			qpair;
+	struct nvme_tcp_qpair			*tqpair;
+	struct nvme_request			req;
+	struct spdk_nvme_tcp_h2c_data_hdr	*h2c_data;
+	uint8_t					buf[8192], rbuf[4096];
+	size_t					off;
+	int					rc;
+
+	memset(buf, 0x3C, sizeof(buf));
+
+	/* One R2T for the whole payload, answered with two H2CData PDUs of MAXH2CDATA */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 1, SPDK_NVME_OPC_WRITE, buf, sizeof(buf));
+	ut_push_r2t(1, 0x77, 0, sizeof(buf));
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(!tqpair->failed);
+	CU_ASSERT(TAILQ_EMPTY(&tqpair->send_queue));
+
+	off = sizeof(struct spdk_nvme_tcp_cmd);
+	h2c_data = (struct spdk_nvme_tcp_h2c_data_hdr *)&g_sent_data[off];
+	CU_ASSERT(h2c_data->common.pdu_type == SPDK_NVME_TCP_PDU_TYPE_H2C_DATA);
+	CU_ASSERT(h2c_data->cccid == 1);
+	CU_ASSERT(h2c_data->ttag == 0x77);
+	CU_ASSERT(h2c_data->datao == 0);
+	CU_ASSERT(h2c_data->datal == 4096);
+	CU_ASSERT(!(h2c_data->common.flags & SPDK_NVME_TCP_H2C_DATA_FLAGS_LAST_PDU));
+	off += h2c_data->common.plen;
+	h2c_data = (struct spdk_nvme_tcp_h2c_data_hdr *)&g_sent_data[off];
+	CU_ASSERT(h2c_data->datao == 4096);
+	CU_ASSERT(h2c_data->datal == 4096);
+	CU_ASSERT(h2c_data->common.flags & SPDK_NVME_TCP_H2C_DATA_FLAGS_LAST_PDU);
+	off += h2c_data->common.plen;
+	CU_ASSERT(g_sent_len == off);
+
+	ut_push_capsule_resp(1);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 1);
+	CU_ASSERT(g_cpl.cid == 1);
+	ut_qpair_fini(&qpair);
+
+	/* R2T that does not start where the data sent so far ends */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 1, SPDK_NVME_OPC_WRITE, buf, sizeof(buf));
+	ut_push_r2t(1, 0, 4096, 4096);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	ut_qpair_fini(&qpair);
+
+	/* R2T past the end of the payload */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 1, SPDK_NVME_OPC_WRITE, buf, sizeof(buf));
+	ut_push_r2t(1, 0, 0, sizeof(buf) + 512);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	ut_qpair_fini(&qpair);
+
+	/* R2T of zero bytes */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 1, SPDK_NVME_OPC_WRITE, buf, sizeof(buf));
+	ut_push_r2t(1, 0, 0, 0);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	ut_qpair_fini(&qpair);
+
+	/* R2T for a read */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 1, SPDK_NVME_OPC_READ, rbuf, sizeof(rbuf));
+	ut_push_r2t(1, 0, 0, sizeof(rbuf));
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	ut_qpair_fini(&qpair);
+}
+
+static void
+test_nvme_tcp_early_capsule_resp(void)
+{
+	struct spdk_nvme_qpair	qpair;
+	struct nvme_tcp_qpair	*tqpair;
+	struct nvme_request	req;
+	struct nvme_tcp_pdu	*h2c_pdu;
+	uint8_t			buf[8192];
+	size_t			sent_len;
+	int			rc;
+
+	memset(buf, 0x3C, sizeof(buf));
+
+	/* The controller fails the command while the H2CData of its R2T is still queued */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 1, SPDK_NVME_OPC_WRITE, buf, sizeof(buf));
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 0);
+	sent_len = g_sent_len;
+	g_writev_limit = 0;
+	ut_push_r2t(1, 0, 0, sizeof(buf));
+	ut_push_capsule_resp(1);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 1);
+	CU_ASSERT(g_completions == 1);
+	CU_ASSERT(TAILQ_EMPTY(&tqpair->send_queue));
+	CU_ASSERT(!tqpair->failed);
+
+	/* Nothing more is written for the completed command */
+	g_writev_limit = SIZE_MAX;
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_sent_len == sent_len);
+	ut_qpair_fini(&qpair);
+
+	/* The completion arrives while the first H2CData PDU is partially written */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	h2c_pdu = &tqpair->reqs[1].h2c_pdu;
+	ut_submit(&qpair, &req, 1, SPDK_NVME_OPC_WRITE, buf, sizeof(buf));
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 0);
+	sent_len = g_sent_len;
+	g_writev_limit = 10;
+	ut_push_r2t(1, 0, 0, sizeof(buf));
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(h2c_pdu->written == 10);
+
+	g_writev_limit = 0;
+	ut_push_capsule_resp(1);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_completions == 0);
+	CU_ASSERT(TAILQ_FIRST(&tqpair->send_queue) == h2c_pdu);
+	CU_ASSERT(TAILQ_NEXT(h2c_pdu, link) == NULL);
+
+	/* The partial PDU is finished, the next one is not queued and the tracker completes */
+	g_writev_limit = SIZE_MAX;
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 1);
+	CU_ASSERT(g_completions == 1);
+	CU_ASSERT(g_cpl.cid == 1);
+	CU_ASSERT(TAILQ_EMPTY(&tqpair->send_queue));
+	CU_ASSERT(g_sent_len == sent_len + h2c_pdu->hdr_len + h2c_pdu->data_len);
+	CU_ASSERT(tqpair->num_deferred_cpls == 0);
+	CU_ASSERT(!tqpair->failed);
+	ut_qpair_fini(&qpair);
+}
+
+static void
+test_nvme_tcp_partial_writev(void)
+{
+	struct spdk_nvme_qpair	qpair;
+	struct nvme_tcp_qpair	*tqpair;
+	struct nvme_request	req1, req2;
+	struct nvme_tcp_pdu	*pdu1, *pdu2;
+	uint8_t			buf1[512], buf2[512];
+	uint32_t		len1, len2;
+	int			rc;
+
+	/* Two commands with in-capsule data */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	tqpair->in_capsule_data_size = 4096;
+	memset(buf1, 0x11, sizeof(buf1));
+	memset(buf2, 0x22, sizeof(buf2));
+	ut_submit(&qpair, &req1, 0, SPDK_NVME_OPC_WRITE, buf1, sizeof(buf1));
+	ut_submit(&qpair, &req2, 1, SPDK_NVME_OPC_WRITE, buf2, sizeof(buf2));
+	pdu1 = &tqpair->reqs[0].cmd_pdu;
+	pdu2 = &tqpair->reqs[1].cmd_pdu;
+	len1 = pdu1->hdr_len + pdu1->data_len;
+	len2 = pdu2->hdr_len + pdu2->data_len;
+	CU_ASSERT(pdu1->data_len == sizeof(buf1));
+
+	/* Part of the first header */
+	g_writev_limit = 10;
+	rc = nvme_tcp_qpair_flush_send_queue(tqpair);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(TAILQ_FIRST(&tqpair->send_queue) == pdu1);
+	CU_ASSERT(pdu1->written == 10);
+
+	/* The rest of the header and part of the first data */
+	g_writev_limit = pdu1->hdr_len;
+	rc = nvme_tcp_qpair_flush_send_queue(tqpair);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(TAILQ_FIRST(&tqpair->send_queue) == pdu1);
+	CU_ASSERT(pdu1->written == pdu1->hdr_len + 10);
+
+	/* The rest of the first PDU and part of the second retires only the first */
+	g_writev_limit = len1 - pdu1->written + 100;
+	rc = nvme_tcp_qpair_flush_send_queue(tqpair);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(TAILQ_FIRST(&tqpair->send_queue) == pdu2);
+	CU_ASSERT(pdu2->written == 100);
+
+	/* The socket is full */
+	g_writev_limit = 0;
+	rc = nvme_tcp_qpair_flush_send_queue(tqpair);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(pdu2->written == 100);
+
+	g_writev_limit = SIZE_MAX;
+	rc = nvme_tcp_qpair_flush_send_queue(tqpair);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(TAILQ_EMPTY(&tqpair->send_queue));
+
+	/* The bytes on the wire are both PDUs, in order and without gaps */
+	CU_ASSERT(g_sent_len == len1 + len2);
+	CU_ASSERT(memcmp(g_sent_data, pdu1->hdr, pdu1->hdr_len) == 0);
+	CU_ASSERT(memcmp(&g_sent_data[pdu1->hdr_len], buf1, sizeof(buf1)) == 0);
+	CU_ASSERT(memcmp(&g_sent_data[len1], pdu2->hdr, pdu2->hdr_len) == 0);
+	CU_ASSERT(memcmp(&g_sent_data[len1 + pdu2->hdr_len], buf2, sizeof(buf2)) == 0);
+	ut_qpair_fini(&qpair);
+}
+
+static void
+test_nvme_tcp_recv_ch(void)
+{
+	struct spdk_nvme_qpair		qpair;
+	struct nvme_tcp_qpair		*tqpair;
+	struct spdk_nvme_tcp_rsp	rsp;
+	struct nvme_request		req;
+	uint8_t				buf[512];
+	int				rc;
+
+	/* A CapsuleResp split across reads is reassembled */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_submit(&qpair, &req, 3, SPDK_NVME_OPC_READ, buf, sizeof(buf));
+	ut_push_capsule_resp(3);
+	g_recv_len = 5;
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(tqpair->recv_pdu.state == NVME_TCP_RECV_STATE_CH);
+	g_recv_len = sizeof(rsp);
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == 1);
+	CU_ASSERT(g_cpl.cid == 3);
+	ut_qpair_fini(&qpair);
+
+	/* Wrong HLEN */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_push_capsule_resp(0);
+	((struct spdk_nvme_tcp_rsp *)g_recv_data)->common.hlen = 16;
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	ut_qpair_fini(&qpair);
+
+	/* A digest that was not negotiated */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	ut_push_capsule_resp(0);
+	((struct spdk_nvme_tcp_rsp *)g_recv_data)->common.flags = SPDK_NVME_TCP_CH_FLAGS_HDGSTF;
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	ut_qpair_fini(&qpair);
+
+	/* A second ICResp */
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	memset(&rsp, 0, sizeof(rsp));
+	rsp.common.pdu_type = SPDK_NVME_TCP_PDU_TYPE_IC_RESP;
+	rsp.common.hlen = sizeof(struct spdk_nvme_tcp_ic_resp);
+	rsp.common.plen = sizeof(struct spdk_nvme_tcp_ic_resp);
+	ut_push(&rsp.common, sizeof(rsp.common));
+	rc = nvme_tcp_qpair_process_completions(&qpair, 0xFFFF);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	ut_qpair_fini(&qpair);
+}
+
+static void
+test_nvme_tcp_sync_cmd_timeout(void)
+{
+	struct spdk_nvme_qpair	qpair;
+	struct nvme_tcp_qpair	*tqpair;
+	struct spdk_nvme_cmd	cmd;
+	struct spdk_nvme_cpl	cpl;
+	int			rc;
+
+	ut_qpair_init(&qpair, 4);
+	tqpair = qpair.transport_ctx;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opc = SPDK_NVME_OPC_FABRIC;
+
+	/* Completed synchronous command */
+	ut_push_capsule_resp(NVME_TCP_SYNC_CID);
+	rc = nvme_tcp_qpair_sync_cmd(&qpair, &cmd, NULL, 0, &cpl);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(cpl.cid == NVME_TCP_SYNC_CID);
+	CU_ASSERT(!tqpair->failed);
+
+	/* The controller never answers, and the command is still queued when time runs out */
+	g_writev_limit = 0;
+	g_tsc_per_idle_recv = (uint64_t)NVME_TCP_SYNC_TIMEOUT_MS * nvme_get_tsc_hz() / 1000;
+	rc = nvme_tcp_qpair_sync_cmd(&qpair, &cmd, NULL, 0, &cpl);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(tqpair->failed);
+	CU_ASSERT(!tqpair->sync_busy);
+	CU_ASSERT(TAILQ_FIRST(&tqpair->send_queue) == &tqpair->sync_pdu);
+
+	/* The failed qpair does not queue the still linked PDU again */
+	rc = nvme_tcp_qpair_sync_cmd(&qpair, &cmd, NULL, 0, &cpl);
+	CU_ASSERT(rc == -1);
+	CU_ASSERT(TAILQ_FIRST(&tqpair->send_queue) == &tqpair->sync_pdu);
+	CU_ASSERT(TAILQ_NEXT(&tqpair->sync_pdu, link) == NULL);
+	CU_ASSERT(nvme_tcp_qpair_process_completions(&qpair, 0xFFFF) == -1);
+	ut_qpair_fini(&qpair);
+}
+
+static void
+test_nvme_tcp_check_request(void)
+{
+	struct nvme_request	req;
+	uint8_t			buf[512], md[8];
+
+	memset(&req, 0, sizeof(req));
+	CU_ASSERT(nvme_tcp_qpair_check_request(NULL, &req) == 0);
+
+	req.payload_size = sizeof(buf);
+	req.payload.type = NVME_PAYLOAD_TYPE_CONTIG;
+	req.payload.u.contig = buf;
+	CU_ASSERT(nvme_tcp_qpair_check_request(NULL, &req) == 0);
+
+	/* Separate metadata buffer */
+	req.payload.md = md;
+	CU_ASSERT(nvme_tcp_qpair_check_request(NULL, &req) == -EINVAL);
+
+	/* Scattered payload */
+	req.payload.md = NULL;
+	req.payload.type = NVME_PAYLOAD_TYPE_SGL;
+	CU_ASSERT(nvme_tcp_qpair_check_request(NULL, &req) == -EINVAL);
+}
+
+int main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("nvme_tcp", NULL, NULL);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (CU_add_test(suite, "nvme_tcp_c2h_data", test_nvme_tcp_c2h_data) == NULL
+	    || CU_add_test(suite, "nvme_tcp_r2t", test_nvme_tcp_r2t) == NULL
+	    || CU_add_test(suite, "nvme_tcp_early_capsule_resp",
+			   test_nvme_tcp_early_capsule_resp) == NULL
+	    || CU_add_test(suite, "nvme_tcp_partial_writev", test_nvme_tcp_partial_writev) == NULL
+	    || CU_add_test(suite, "nvme_tcp_recv_ch", test_nvme_tcp_recv_ch) == NULL
+	    || CU_add_test(suite, "nvme_tcp_sync_cmd_timeout",
+			   test_nvme_tcp_sync_cmd_timeout) == NULL
+	    || CU_add_test(suite, "nvme_tcp_check_request", test_nvme_tcp_check_request) == NULL
+	   ) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+	return num_failures;
+}
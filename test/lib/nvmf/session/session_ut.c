@@ -56,11 +56,44 @@ spdk_nvme_ctrlr_get_data(struct spdk_nvme_ctrlr *ctrlr)
 	return NULL;
 }
 
+static int g_conn_poll_count;
+
+static int
+test_conn_poll(struct spdk_nvmf_conn *conn)
+{
+	g_conn_poll_count++;
+	return 0;
+}
+
 static void
 test_foobar(void)
 {
 }
 
+static void
+test_session_poll_scheduled(void)
+{
+	struct spdk_nvmf_transport transport = { .conn_poll = test_conn_poll };
+	struct spdk_nvmf_session session = {};
+	struct spdk_nvmf_conn admin_conn = {}, io_conn = {};
+
+	TAILQ_INIT(&session.connections);
+	admin_conn.transport = &transport;
+	io_conn.transport = &transport;
+	TAILQ_INSERT_TAIL(&session.connections, &admin_conn, link);
+	TAILQ_INSERT_TAIL(&session.connections, &io_conn, link);
+
+	g_conn_poll_count = 0;
+	spdk_nvmf_session_poll(&session);
+	CU_ASSERT(g_conn_poll_count == 2);
+
+	/* A scheduled I/O queue is polled on its own core, not by the session */
+	io_conn.scheduled = true;
+	g_conn_poll_count = 0;
+	spdk_nvmf_session_poll(&session);
+	CU_ASSERT(g_conn_poll_count == 1);
+}
+
 int main(int argc, char **argv)
 {
 	CU_pSuite	suite = NULL;
@@ -77,7 +110,8 @@ int main(int argc, char **argv)
 	}
 
 	if (
-		CU_add_test(suite, "foobar", test_foobar) == NULL) {
+		CU_add_test(suite, "foobar", test_foobar) == NULL ||
+		CU_add_test(suite, "session_poll_scheduled", test_session_poll_scheduled) == NULL) {
 		CU_cleanup_registry();
 		return CU_get_error();
 	}
@@ -0,0 +1,586 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/socket.h>
+
+#include "spdk_cunit.h"
+
+#include "tcp.c"
+
+SPDK_LOG_REGISTER_TRACE_FLAG("nvmf", SPDK_TRACE_NVMF)
+
+struct spdk_nvmf_globals g_nvmf_tgt;
+
+/* Bytes the host sent, consumed by spdk_sock_recv() at most g_recv_chunk bytes at a time */
+static uint8_t g_recv_data[64 * 1024];
+static size_t g_recv_len;
+static size_t g_recv_offset;
+static size_t g_recv_chunk;
+
+/* Bytes the target wrote, and the offset of the next PDU not yet checked by the test */
+static uint8_t g_sent_data[64 * 1024];
+static size_t g_sent_len;
+static size_t g_sent_offset;
+
+static struct spdk_nvmf_request *g_exec_req;
+static int g_exec_count;
+
+/* rte_free() of this pointer sets g_watch_freed */
+static void *g_watch_ptr;
+static bool g_watch_freed;
+
+void *
+rte_calloc(const char *type, size_t num, size_t size, unsigned align)
+{
+	return calloc(num, size);
+}
+
+void
+rte_free(void *ptr)
+{
+	if (ptr != NULL && ptr == g_watch_ptr) {
+		g_watch_freed = true;
+	}
+	free(ptr);
+}
+
+uint64_t
+spdk_get_ticks(void)
+{
+	return 0;
+}
+
+void
+spdk_trace_record(uint16_t tpoint_id, uint16_t poller_id, uint32_t size,
+		  uint64_t object_id, uint64_t arg1)
+{
+}
+
+int
+spdk_sock_close(int sock)
+{
+	return close(sock);
+}
+
+int
+spdk_sock_accept(int sock)
+{
+	errno = EAGAIN;
+	return -1;
+}
+
+int
+spdk_sock_listen(const char *ip, int port)
+{
+	return -1;
+}
+
+int
+spdk_sock_getaddr(int sock, char *saddr, int slen, char *caddr, int clen)
+{
+	return -1;
+}
+
+ssize_t
+spdk_sock_recv(int sock, void *buf, size_t len)
+{
+	size_t avail = g_recv_len - g_recv_offset;
+
+	if (avail == 0) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	len = len < avail ? len : avail;
+	len = len < g_recv_chunk ? len : g_recv_chunk;
+	memcpy(buf, &g_recv_data[g_recv_offset], len);
+	g_recv_offset += len;
+	return len;
+}
+
+ssize_t
+spdk_sock_writev(int sock, struct iovec *iov, int iovcnt)
+{
+	size_t total = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		SPDK_CU_ASSERT_FATAL(g_sent_len + iov[i].iov_len <= sizeof(g_sent_data));
+		memcpy(&g_sent_data[g_sent_len], iov[i].iov_base, iov[i].iov_len);
+		g_sent_len += iov[i].iov_len;
+		total += iov[i].iov_len;
+	}
+
+	return total;
+}
+
+int
+spdk_nvmf_request_exec(struct spdk_nvmf_request *req)
+{
+	g_exec_req = req;
+	g_exec_count++;
+	return SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS;
+}
+
+int
+spdk_nvmf_request_complete(struct spdk_nvmf_request *req)
+{
+	req->rsp->nvme_cpl.cid = req->cmd->nvme_cmd.cid;
+	return req->conn->transport->req_complete(req);
+}
+
+static void
+ut_push(const void *buf, size_t len)
+{
+	SPDK_CU_ASSERT_FATAL(g_recv_len + len <= sizeof(g_recv_data));
+	memcpy(&g_recv_data[g_recv_len], buf, len);
+	g_recv_len += len;
+}
+
+static void
+ut_push_ic_req(bool hdgst, bool ddgst)
+{
+	struct spdk_nvme_tcp_ic_req ic_req;
+
+	memset(&ic_req, 0, sizeof(ic_req));
+	ic_req.common.pdu_type = SPDK_NVME_TCP_PDU_TYPE_IC_REQ;
+	ic_req.common.hlen = sizeof(ic_req);
+	ic_req.common.plen = sizeof(ic_req);
+	ic_req.dgst.bits.hdgst_enable = hdgst;
+	ic_req.dgst.bits.ddgst_enable = ddgst;
+	ut_push(&ic_req, sizeof(ic_req));
+}
+
+/* Push a PDU header, its data and the digests that flags ask for.  Bad digests are inverted. */
+static void
+ut_push_pdu(void *hdr, uint32_t hlen, const void *data, uint32_t data_len,
+	    bool bad_hdgst, bool bad_ddgst)
+{
+	struct spdk_nvme_tcp_common_pdu_hdr *common = hdr;
+	uint32_t hdgst_len, ddgst_len, crc;
+
+	hdgst_len = (common->flags & SPDK_NVME_TCP_CH_FLAGS_HDGSTF) ? SPDK_NVME_TCP_DIGEST_LEN : 0;
+	ddgst_len = (data_len && (common->flags & SPDK_NVME_TCP_CH_FLAGS_DDGSTF)) ?
+		    SPDK_NVME_TCP_DIGEST_LEN : 0;
+
+	common->hlen = hlen;
+	common->pdo = data_len ? hlen + hdgst_len : 0;
+	common->plen = hlen + hdgst_len + data_len + ddgst_len;
+	ut_push(hdr, hlen);
+
+	if (hdgst_len) {
+		crc = nvmf_tcp_digest(hdr, hlen);
+		if (bad_hdgst) {
+			crc = ~crc;
+		}
+		ut_push(&crc, sizeof(crc));
+	}
+
+	if (data_len) {
+		ut_push(data, data_len);
+	}
+
+	if (ddgst_len) {
+		crc = nvmf_tcp_digest(data, data_len);
+		if (bad_ddgst) {
+			crc = ~crc;
+		}
+		ut_push(&crc, sizeof(crc));
+	}
+}
+
+/* Push a write of len bytes, carried in the capsule when data is not NULL */
+static void
+ut_push_write(uint16_t cid, const void *data, uint32_t len, uint8_t flags,
+	      bool bad_hdgst, bool bad_ddgst)
+{
+	struct spdk_nvme_tcp_cmd capsule;
+	struct spdk_nvme_sgl_descriptor *sgl = &capsule.ccsqe.dptr.sgl1;
+
+	memset(&capsule, 0, sizeof(capsule));
+	capsule.common.pdu_type = SPDK_NVME_TCP_PDU_TYPE_CAPSULE_CMD;
+	capsule.common.flags = flags;
+	capsule.ccsqe.opc = SPDK_NVME_OPC_WRITE;
+	capsule.ccsqe.cid = cid;
+	sgl->unkeyed.length = len;
+	if (data != NULL) {
+		sgl->generic.type = SPDK_NVME_SGL_TYPE_DATA_BLOCK;
+		sgl->unkeyed.subtype = SPDK_NVME_SGL_SUBTYPE_OFFSET;
+	} else {
+		sgl->generic.type = SPDK_NVME_SGL_TYPE_TRANSPORT_DATA_BLOCK;
+		sgl->unkeyed.subtype = SPDK_NVME_SGL_SUBTYPE_TRANSPORT;
+	}
+
+	ut_push_pdu(&capsule, sizeof(capsule), data, data ? len : 0, bad_hdgst, bad_ddgst);
+}
+
+static void
+ut_push_h2c_data(uint16_t cid, uint16_t ttag, uint32_t datao, const void *data, uint32_t datal)
+{
+	struct spdk_nvme_tcp_h2c_data_hdr h2c_data;
+
+	memset(&h2c_data, 0, sizeof(h2c_data));
+	h2c_data.common.pdu_type = SPDK_NVME_TCP_PDU_TYPE_H2C_DATA;
+	h2c_data.cccid = cid;
+	h2c_data.ttag = ttag;
+	h2c_data.datao = datao;
+	h2c_data.datal = datal;
+	ut_push_pdu(&h2c_data, sizeof(h2c_data), data, datal, false, false);
+}
+
+/* Return the next PDU the target sent, or NULL if there is none. */
+static void *
+ut_next_sent_pdu(void)
+{
+	struct spdk_nvme_tcp_common_pdu_hdr *common;
+
+	if (g_sent_offset + sizeof(*common) > g_sent_len) {
+		return NULL;
+	}
+
+	common = (struct spdk_nvme_tcp_common_pdu_hdr *)&g_sent_data[g_sent_offset];
+	SPDK_CU_ASSERT_FATAL(g_sent_offset + common->plen <= g_sent_len);
+	g_sent_offset += common->plen;
+	return common;
+}
+
+/* Poll the connection until it has read everything the host sent. */
+static int
+ut_poll(struct spdk_nvmf_tcp_conn *tcp_conn)
+{
+	int rc, count = 0;
+
+	do {
+		rc = spdk_nvmf_tcp_poll(&tcp_conn->conn);
+		if (rc < 0) {
+			return rc;
+		}
+		count += rc;
+	} while (g_recv_offset < g_recv_len);
+
+	/* One more poll writes out anything queued by the last one */
+	rc = spdk_nvmf_tcp_poll(&tcp_conn->conn);
+	return rc < 0 ? rc : count + rc;
+}
+
+static struct spdk_nvmf_tcp_conn *
+ut_conn_create(size_t recv_chunk)
+{
+	struct spdk_nvmf_tcp_conn *tcp_conn;
+	int sv[2];
+
+	g_recv_len = 0;
+	g_recv_offset = 0;
+	g_recv_chunk = recv_chunk;
+	g_sent_len = 0;
+	g_sent_offset = 0;
+	g_exec_req = NULL;
+	g_exec_count = 0;
+
+	g_nvmf_tgt.sess_data_bufs = 2;
+	spdk_nvmf_tcp_init(4, 16384, 4096);
+
+	SPDK_CU_ASSERT_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+	close(sv[1]);
+	tcp_conn = spdk_nvmf_tcp_conn_create(sv[0]);
+	SPDK_CU_ASSERT_FATAL(tcp_conn != NULL);
+	tcp_conn->conn.type = CONN_TYPE_IOQ;
+
+	return tcp_conn;
+}
+
+static int
+ut_pool_count(struct spdk_nvmf_tcp_session *tcp_sess)
+{
+	struct spdk_nvmf_tcp_buf *buf;
+	int count = 0;
+
+	SLIST_FOREACH(buf, &tcp_sess->data_buf_pool, link) {
+		count++;
+	}
+
+	return count;
+}
+
+static void
+test_nvmf_tcp_pdu_parse(void)
+{
+	struct spdk_nvmf_tcp_conn *tcp_conn;
+	struct spdk_nvme_tcp_ic_resp *ic_resp;
+	struct spdk_nvme_tcp_rsp *capsule_resp;
+	struct spdk_nvme_tcp_term_req_hdr *term_req;
+	struct spdk_nvme_tcp_common_pdu_hdr bad = {};
+	uint8_t data[512];
+
+	/* The PDUs arrive a few bytes at a time */
+	tcp_conn = ut_conn_create(7);
+	memset(data, 0x5a, sizeof(data));
+	ut_push_ic_req(false, false);
+	ut_push_write(1, data, sizeof(data), 0, false, false);
+
+	CU_ASSERT(ut_poll(tcp_conn) == 1);
+	ic_resp = ut_next_sent_pdu();
+	SPDK_CU_ASSERT_FATAL(ic_resp != NULL);
+	CU_ASSERT(ic_resp->common.pdu_type == SPDK_NVME_TCP_PDU_TYPE_IC_RESP);
+	CU_ASSERT(ic_resp->common.plen == sizeof(*ic_resp));
+	CU_ASSERT(ic_resp->maxh2cdata == 16384);
+	CU_ASSERT(ut_next_sent_pdu() == NULL);
+
+	SPDK_CU_ASSERT_FATAL(g_exec_req != NULL);
+	CU_ASSERT(g_exec_req->cmd->nvme_cmd.cid == 1);
+	CU_ASSERT(g_exec_req->xfer == SPDK_NVME_DATA_HOST_TO_CONTROLLER);
+	CU_ASSERT(g_exec_req->length == sizeof(data));
+	CU_ASSERT(memcmp(g_exec_req->data, data, sizeof(data)) == 0);
+	CU_ASSERT(tcp_conn->cur_queue_depth == 1);
+
+	/* The response is written on the next poll and frees the request */
+	CU_ASSERT(spdk_nvmf_request_complete(g_exec_req) == 0);
+	CU_ASSERT(ut_poll(tcp_conn) == 0);
+	capsule_resp = ut_next_sent_pdu();
+	SPDK_CU_ASSERT_FATAL(capsule_resp != NULL);
+	CU_ASSERT(capsule_resp->common.pdu_type == SPDK_NVME_TCP_PDU_TYPE_CAPSULE_RESP);
+	CU_ASSERT(capsule_resp->rccqe.cid == 1);
+	CU_ASSERT(capsule_resp->rccqe.status.sc == SPDK_NVME_SC_SUCCESS);
+	CU_ASSERT(tcp_conn->cur_queue_depth == 0);
+	CU_ASSERT(tcp_conn->refcnt == 1);
+
+	/* An unknown PDU type terminates the connection */
+	bad.pdu_type = SPDK_NVME_TCP_PDU_TYPE_R2T;
+	bad.hlen = sizeof(bad);
+	bad.plen = sizeof(bad);
+	ut_push(&bad, sizeof(bad));
+	CU_ASSERT(ut_poll(tcp_conn) < 0);
+	term_req = ut_next_sent_pdu();
+	SPDK_CU_ASSERT_FATAL(term_req != NULL);
+	CU_ASSERT(term_req->common.pdu_type == SPDK_NVME_TCP_PDU_TYPE_C2H_TERM_REQ);
+	CU_ASSERT(term_req->fes == SPDK_NVME_TCP_TERM_REQ_FES_INVALID_HEADER_FIELD);
+	CU_ASSERT(term_req->fei == offsetof(struct spdk_nvme_tcp_common_pdu_hdr, pdu_type));
+
+	spdk_nvmf_tcp_conn_destroy(tcp_conn);
+}
+
+static void
+test_nvmf_tcp_digests(void)
+{
+	struct spdk_nvmf_tcp_conn *tcp_conn;
+	struct spdk_nvme_tcp_rsp *capsule_resp;
+	struct spdk_nvme_tcp_term_req_hdr *term_req;
+	uint8_t flags = SPDK_NVME_TCP_CH_FLAGS_HDGSTF | SPDK_NVME_TCP_CH_FLAGS_DDGSTF;
+	uint8_t data[256];
+	uint32_t crc;
+
+	tcp_conn = ut_conn_create(SIZE_MAX);
+	memset(data, 0xa5, sizeof(data));
+	ut_push_ic_req(true, true);
+	ut_push_write(1, data, sizeof(data), flags, false, false);
+	CU_ASSERT(ut_poll(tcp_conn) == 1);
+	CU_ASSERT(tcp_conn->hdgst_enable && tcp_conn->ddgst_enable);
+	CU_ASSERT(ut_next_sent_pdu() != NULL);
+	SPDK_CU_ASSERT_FATAL(g_exec_req != NULL);
+	CU_ASSERT(memcmp(g_exec_req->data, data, sizeof(data)) == 0);
+
+	/* Responses carry a valid header digest */
+	CU_ASSERT(spdk_nvmf_request_complete(g_exec_req) == 0);
+	CU_ASSERT(ut_poll(tcp_conn) == 0);
+	capsule_resp = ut_next_sent_pdu();
+	SPDK_CU_ASSERT_FATAL(capsule_resp != NULL);
+	CU_ASSERT(capsule_resp->common.flags & SPDK_NVME_TCP_CH_FLAGS_HDGSTF);
+	CU_ASSERT(capsule_resp->common.plen == sizeof(*capsule_resp) + SPDK_NVME_TCP_DIGEST_LEN);
+	memcpy(&crc, capsule_resp + 1, sizeof(crc));
+	CU_ASSERT(crc == nvmf_tcp_digest(capsule_resp, sizeof(*capsule_resp)));
+
+	/* A data digest error fails the command without executing it */
+	g_exec_count = 0;
+	ut_push_write(2, data, sizeof(data), flags, false, true);
+	CU_ASSERT(ut_poll(tcp_conn) == 0);
+	CU_ASSERT(g_exec_count == 0);
+	capsule_resp = ut_next_sent_pdu();
+	SPDK_CU_ASSERT_FATAL(capsule_resp != NULL);
+	CU_ASSERT(capsule_resp->rccqe.cid == 2);
+	CU_ASSERT(capsule_resp->rccqe.status.sc == SPDK_NVME_SC_DATA_TRANSFER_ERROR);
+	CU_ASSERT(tcp_conn->cur_queue_depth == 0);
+
+	/* A header digest error terminates the connection */
+	ut_push_write(3, data, sizeof(data), flags, true, false);
+	CU_ASSERT(ut_poll(tcp_conn) < 0);
+	CU_ASSERT(g_exec_count == 0);
+	term_req = ut_next_sent_pdu();
+	SPDK_CU_ASSERT_FATAL(term_req != NULL);
+	CU_ASSERT(term_req->common.pdu_type == SPDK_NVME_TCP_PDU_TYPE_C2H_TERM_REQ);
+	CU_ASSERT(term_req->fes == SPDK_NVME_TCP_TERM_REQ_FES_HDGST_ERROR);
+
+	spdk_nvmf_tcp_conn_destroy(tcp_conn);
+}
+
+static void
+test_nvmf_tcp_r2t_h2c(void)
+{
+	struct spdk_nvmf_tcp_conn *tcp_conn;
+	struct spdk_nvmf_session session = {};
+	struct spdk_nvme_tcp_r2t_hdr *r2t;
+	struct spdk_nvme_tcp_term_req_hdr *term_req;
+	struct spdk_nvmf_tcp_session *tcp_sess;
+	static uint8_t data[16384];
+	uint16_t ttag;
+
+	tcp_conn = ut_conn_create(SIZE_MAX);
+	CU_ASSERT(spdk_nvmf_tcp_session_init(&session, &tcp_conn->conn) == 0);
+	tcp_conn->conn.sess = &session;
+	tcp_sess = session.trctx;
+	memset(data, 0x3c, sizeof(data));
+
+	/* A write larger than the in-capsule buffer takes a pool buffer and asks for the data */
+	ut_push_ic_req(false, false);
+	ut_push_write(1, NULL, sizeof(data), 0, false, false);
+	CU_ASSERT(ut_poll(tcp_conn) == 0);
+	CU_ASSERT(ut_next_sent_pdu() != NULL);
+	r2t = ut_next_sent_pdu();
+	SPDK_CU_ASSERT_FATAL(r2t != NULL);
+	CU_ASSERT(r2t->common.pdu_type == SPDK_NVME_TCP_PDU_TYPE_R2T);
+	CU_ASSERT(r2t->cccid == 1);
+	CU_ASSERT(r2t->r2to == 0);
+	CU_ASSERT(r2t->r2tl == sizeof(data));
+	ttag = r2t->ttag;
+	CU_ASSERT(ut_pool_count(tcp_sess) == 1);
+
+	/* The command executes once all of its data has arrived */
+	ut_push_h2c_data(1, ttag, 0, data, 8192);
+	CU_ASSERT(ut_poll(tcp_conn) == 0);
+	CU_ASSERT(g_exec_count == 0);
+	ut_push_h2c_data(1, ttag, 8192, data + 8192, 8192);
+	CU_ASSERT(ut_poll(tcp_conn) == 1);
+	SPDK_CU_ASSERT_FATAL(g_exec_req != NULL);
+	CU_ASSERT(g_exec_req->length == sizeof(data));
+	CU_ASSERT(memcmp(g_exec_req->data, data, sizeof(data)) == 0);
+
+	/* The pool buffer is returned once the response has been written */
+	CU_ASSERT(spdk_nvmf_request_complete(g_exec_req) == 0);
+	CU_ASSERT(ut_poll(tcp_conn) == 0);
+	CU_ASSERT(ut_next_sent_pdu() != NULL);
+	CU_ASSERT(ut_pool_count(tcp_sess) == 2);
+
+	/* Data that does not match the R2T terminates the connection */
+	ut_push_write(2, NULL, sizeof(data), 0, false, false);
+	CU_ASSERT(ut_poll(tcp_conn) == 0);
+	r2t = ut_next_sent_pdu();
+	SPDK_CU_ASSERT_FATAL(r2t != NULL);
+	ut_push_h2c_data(2, r2t->ttag, 4096, data, 4096);
+	CU_ASSERT(ut_poll(tcp_conn) < 0);
+	term_req = ut_next_sent_pdu();
+	SPDK_CU_ASSERT_FATAL(term_req != NULL);
+	CU_ASSERT(term_req->fes == SPDK_NVME_TCP_TERM_REQ_FES_DATA_TRANSFER_OUT_OF_RANGE);
+
+	/* Closing the connection returns the buffer of the request waiting for data */
+	CU_ASSERT(ut_pool_count(tcp_sess) == 1);
+	spdk_nvmf_tcp_close_conn(&tcp_conn->conn);
+	CU_ASSERT(ut_pool_count(tcp_sess) == 2);
+	spdk_nvmf_tcp_session_fini(&session);
+}
+
+static void
+test_nvmf_tcp_close_conn_executing(void)
+{
+	struct spdk_nvmf_tcp_conn *tcp_conn;
+	struct spdk_nvmf_session session = {};
+	struct spdk_nvmf_tcp_session *tcp_sess;
+	struct spdk_nvmf_request *req;
+	static uint8_t data[16384];
+
+	tcp_conn = ut_conn_create(SIZE_MAX);
+	CU_ASSERT(spdk_nvmf_tcp_session_init(&session, &tcp_conn->conn) == 0);
+	tcp_conn->conn.sess = &session;
+	tcp_sess = session.trctx;
+
+	ut_push_ic_req(false, false);
+	ut_push_write(1, NULL, sizeof(data), 0, false, false);
+	CU_ASSERT(ut_poll(tcp_conn) == 0);
+	ut_push_h2c_data(1, tcp_conn->reqs[0].ttag, 0, data, sizeof(data));
+	CU_ASSERT(ut_poll(tcp_conn) == 1);
+	req = g_exec_req;
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+	CU_ASSERT(tcp_conn->refcnt == 2);
+	CU_ASSERT(ut_pool_count(tcp_sess) == 1);
+
+	/* The connection and the session outlive the request that is still executing */
+	spdk_nvmf_tcp_close_conn(&tcp_conn->conn);
+	CU_ASSERT(tcp_conn->closing);
+	CU_ASSERT(tcp_conn->refcnt == 1);
+	g_watch_ptr = tcp_sess->buf;
+	g_watch_freed = false;
+	spdk_nvmf_tcp_session_fini(&session);
+	CU_ASSERT(!g_watch_freed);
+	CU_ASSERT(ut_pool_count(tcp_sess) == 1);
+
+	/* Its completion frees the connection, returns the buffer and frees the session */
+	g_sent_len = 0;
+	CU_ASSERT(spdk_nvmf_request_complete(req) == 0);
+	CU_ASSERT(g_sent_len == 0);
+	CU_ASSERT(g_watch_freed);
+	g_watch_ptr = NULL;
+}
+
+int main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("nvmf_tcp", NULL, NULL);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (CU_add_test(suite, "nvmf_tcp_pdu_parse", test_nvmf_tcp_pdu_parse) == NULL
+	    || CU_add_test(suite, "nvmf_tcp_digests", test_nvmf_tcp_digests) == NULL
+	    || CU_add_test(suite, "nvmf_tcp_r2t_h2c", test_nvmf_tcp_r2t_h2c) == NULL
+	    || CU_add_test(suite, "nvmf_tcp_close_conn_executing",
+			   test_nvmf_tcp_close_conn_executing) == NULL
+	   ) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+	return num_failures;
+}
@@ -140,10 +140,11 @@ spdk_bdev_read(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 }
 
 struct spdk_bdev_io *
-spdk_bdev_writev(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
-		 struct iovec *iov, int iovcnt,
-		 uint64_t offset, uint64_t len,
-		 spdk_bdev_io_completion_cb cb, void *cb_arg)
+spdk_bdev_writev_with_hints(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+			    struct iovec *iov, int iovcnt,
+			    uint64_t offset, uint64_t len,
+			    const struct spdk_bdev_io_hints *hints,
+			    spdk_bdev_io_completion_cb cb, void *cb_arg)
 {
 	return NULL;
 }
@@ -0,0 +1,385 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spdk_cunit.h"
+
+#include "crc16.c"
+#include "dif.c"
+
+#define DATA_PATTERN(offset)	((uint8_t)(0xAB + (offset)))
+
+static uint16_t
+crc16_t10dif_bitwise(uint16_t crc, const uint8_t *buf, size_t len)
+{
+	size_t i;
+	int j;
+
+	for (i = 0; i < len; i++) {
+		crc ^= (uint16_t)buf[i] << 8;
+		for (j = 0; j < 8; j++) {
+			crc = (crc << 1) ^ ((crc & 0x8000) ? SPDK_T10DIF_CRC16_POLYNOMIAL : 0);
+		}
+	}
+
+	return crc;
+}
+
+/* Split buf into iovecs of iov_len bytes; the last iovec takes the remainder. */
+static int
+build_iovs(struct iovec *iovs, int max_iovs, uint8_t *buf, uint32_t len, uint32_t iov_len)
+{
+	int iovcnt = 0;
+
+	while (len != 0) {
+		SPDK_CU_ASSERT_FATAL(iovcnt < max_iovs);
+		iovs[iovcnt].iov_base = buf;
+		iovs[iovcnt].iov_len = (len < iov_len || iovcnt == max_iovs - 1) ? len : iov_len;
+		buf += iovs[iovcnt].iov_len;
+		len -= iovs[iovcnt].iov_len;
+		iovcnt++;
+	}
+
+	return iovcnt;
+}
+
+static void
+fill_data(uint8_t *buf, uint32_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++) {
+		buf[i] = DATA_PATTERN(i);
+	}
+}
+
+static void
+test_crc16_t10dif(void)
+{
+	uint8_t buf[4096 + 15];
+	uint16_t crc;
+	uint32_t len, offset;
+
+	CU_ASSERT(spdk_crc16_t10dif(0, "123456789", 9) == 0xD0DB);
+
+	for (len = 0; len < sizeof(buf); len++) {
+		buf[len] = rand();
+	}
+
+	/* Cover both the lookup table and the folding paths, with unaligned buffers. */
+	for (len = 0; len <= 4096; len += 13) {
+		offset = len % 16;
+		CU_ASSERT(spdk_crc16_t10dif(0x1234, buf + offset, len) ==
+			  crc16_t10dif_bitwise(0x1234, buf + offset, len));
+	}
+
+	/* A checksum may be continued across buffers. */
+	crc = spdk_crc16_t10dif(0, buf, 100);
+	crc = spdk_crc16_t10dif(crc, buf + 100, 3000);
+	CU_ASSERT(crc == spdk_crc16_t10dif(0, buf, 3100));
+}
+
+static void
+test_dif_ctx_init(void)
+{
+	struct spdk_dif_ctx ctx;
+
+	/* Metadata too small for protection information */
+	CU_ASSERT(spdk_dif_ctx_init(&ctx, 520, 4, true, false, SPDK_DIF_TYPE1,
+				    0, 0, 0, 0, 0) == -EINVAL);
+	/* Extended block no larger than its metadata */
+	CU_ASSERT(spdk_dif_ctx_init(&ctx, 8, 8, true, false, SPDK_DIF_TYPE1,
+				    0, 0, 0, 0, 0) == -EINVAL);
+	CU_ASSERT(spdk_dif_ctx_init(&ctx, 520, 8, true, false, SPDK_DIF_DISABLE,
+				    0, 0, 0, 0, 0) == -EINVAL);
+
+	CU_ASSERT(spdk_dif_ctx_init(&ctx, 520, 8, true, false, SPDK_DIF_TYPE1,
+				    0, 0, 0, 0, 0) == 0);
+	CU_ASSERT(ctx.guard_interval == 512);
+
+	/* The guard covers the metadata preceding protection information at the tail. */
+	CU_ASSERT(spdk_dif_ctx_init(&ctx, 4096 + 128, 128, true, false, SPDK_DIF_TYPE1,
+				    0, 0, 0, 0, 0) == 0);
+	CU_ASSERT(ctx.guard_interval == 4096 + 120);
+	CU_ASSERT(spdk_dif_ctx_init(&ctx, 4096 + 128, 128, true, true, SPDK_DIF_TYPE1,
+				    0, 0, 0, 0, 0) == 0);
+	CU_ASSERT(ctx.guard_interval == 4096);
+
+	CU_ASSERT(spdk_dif_ctx_init(&ctx, 4096, 128, false, false, SPDK_DIF_TYPE1,
+				    0, 0, 0, 0, 0) == 0);
+	CU_ASSERT(ctx.guard_interval == 4096 + 120);
+}
+
+#define DIF_FLAGS_ALL	(SPDK_DIF_FLAGS_GUARD_CHECK | SPDK_DIF_FLAGS_APPTAG_CHECK | \
+			 SPDK_DIF_FLAGS_REFTAG_CHECK)
+
+static void
+dif_generate_verify(uint32_t block_size, uint32_t md_size, bool dif_loc,
+		    enum spdk_dif_type dif_type, uint32_t iov_len)
+{
+	struct spdk_dif_ctx ctx;
+	struct spdk_dif_error err;
+	struct iovec iovs[64];
+	uint32_t num_blocks = 4, len = block_size * num_blocks;
+	uint8_t *buf;
+	int iovcnt;
+
+	buf = calloc(1, len);
+	SPDK_CU_ASSERT_FATAL(buf != NULL);
+	fill_data(buf, len);
+	iovcnt = build_iovs(iovs, 64, buf, len, iov_len);
+
+	SPDK_CU_ASSERT_FATAL(spdk_dif_ctx_init(&ctx, block_size, md_size, true, dif_loc, dif_type,
+					       DIF_FLAGS_ALL, 22, 0xFFFF, 0x88, 0) == 0);
+
+	CU_ASSERT(spdk_dif_generate(iovs, iovcnt, num_blocks, &ctx) == 0);
+	CU_ASSERT(spdk_dif_verify(iovs, iovcnt, num_blocks, &ctx, &err) == 0);
+
+	/* The generated protection information must not depend on the iovec layout. */
+	if (iovcnt > 1) {
+		iovcnt = build_iovs(iovs, 64, buf, len, len);
+		CU_ASSERT(spdk_dif_verify(iovs, iovcnt, num_blocks, &ctx, &err) == 0);
+	}
+
+	free(buf);
+}
+
+static void
+test_dif_generate_verify(void)
+{
+	enum spdk_dif_type dif_type;
+
+	for (dif_type = SPDK_DIF_TYPE1; dif_type <= SPDK_DIF_TYPE3; dif_type++) {
+		dif_generate_verify(512 + 8, 8, false, dif_type, 512 + 8);
+		dif_generate_verify(512 + 8, 8, false, dif_type, 4 * (512 + 8));
+		dif_generate_verify(4096 + 128, 128, false, dif_type, 4096 + 128);
+		dif_generate_verify(4096 + 128, 128, true, dif_type, 4096 + 128);
+		/* Blocks and protection information split across iovecs */
+		dif_generate_verify(512 + 8, 8, false, dif_type, 515);
+		dif_generate_verify(512 + 8, 8, false, dif_type, 100);
+		dif_generate_verify(4096 + 128, 128, true, dif_type, 4099);
+		dif_generate_verify(4096 + 128, 128, false, dif_type, 4100);
+	}
+}
+
+static void
+test_dif_verify_errors(void)
+{
+	struct spdk_dif_ctx ctx;
+	struct spdk_dif_error err;
+	struct spdk_dif *dif;
+	uint8_t buf[4 * 520];
+	struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+
+	fill_data(buf, sizeof(buf));
+	SPDK_CU_ASSERT_FATAL(spdk_dif_ctx_init(&ctx, 520, 8, true, false, SPDK_DIF_TYPE1,
+					       DIF_FLAGS_ALL, 100, 0xFF00, 0x1234, 0) == 0);
+	CU_ASSERT(spdk_dif_generate(&iov, 1, 4, &ctx) == 0);
+
+	/* Data corruption in block 2 */
+	buf[2 * 520 + 17] ^= 0x1;
+	CU_ASSERT(spdk_dif_verify(&iov, 1, 4, &ctx, &err) == -EIO);
+	CU_ASSERT(err.err_type == SPDK_DIF_GUARD_ERROR);
+	CU_ASSERT(err.err_offset == 2);
+	CU_ASSERT(err.actual != err.expected);
+	buf[2 * 520 + 17] ^= 0x1;
+	CU_ASSERT(spdk_dif_verify(&iov, 1, 4, &ctx, &err) == 0);
+
+	/* Only the masked bits of the application tag are compared. */
+	dif = (struct spdk_dif *)(buf + 512);
+	to_be16(&dif->app_tag, 0x12FF);
+	CU_ASSERT(spdk_dif_verify(&iov, 1, 4, &ctx, &err) == 0);
+	to_be16(&dif->app_tag, 0x13FF);
+	CU_ASSERT(spdk_dif_verify(&iov, 1, 4, &ctx, &err) == -EIO);
+	CU_ASSERT(err.err_type == SPDK_DIF_APPTAG_ERROR);
+	CU_ASSERT(err.err_offset == 0);
+	CU_ASSERT(err.expected == 0x1200);
+	CU_ASSERT(err.actual == 0x1300);
+	to_be16(&dif->app_tag, 0x1234);
+
+	/* Reference tag of block 3 */
+	dif = (struct spdk_dif *)(buf + 3 * 520 + 512);
+	CU_ASSERT(from_be32(&dif->ref_tag) == 103);
+	to_be32(&dif->ref_tag, 3);
+	CU_ASSERT(spdk_dif_verify(&iov, 1, 4, &ctx, &err) == -EIO);
+	CU_ASSERT(err.err_type == SPDK_DIF_REFTAG_ERROR);
+	CU_ASSERT(err.err_offset == 3);
+	CU_ASSERT(err.expected == 103);
+	CU_ASSERT(err.actual == 3);
+
+	/* Without the reference tag check flag, the mismatch is ignored. */
+	ctx.dif_flags &= ~SPDK_DIF_FLAGS_REFTAG_CHECK;
+	CU_ASSERT(spdk_dif_verify(&iov, 1, 4, &ctx, NULL) == 0);
+	ctx.dif_flags |= SPDK_DIF_FLAGS_REFTAG_CHECK;
+
+	/* An application tag of 0xFFFF disables checking of type 1 blocks... */
+	to_be16(&dif->app_tag, 0xFFFF);
+	CU_ASSERT(spdk_dif_verify(&iov, 1, 4, &ctx, &err) == 0);
+
+	/* ...but type 3 also requires a reference tag of 0xFFFFFFFF. */
+	ctx.dif_type = SPDK_DIF_TYPE3;
+	to_be16(&dif->guard, 0);
+	CU_ASSERT(spdk_dif_verify(&iov, 1, 4, &ctx, &err) == -EIO);
+	to_be32(&dif->ref_tag, 0xFFFFFFFF);
+	CU_ASSERT(spdk_dif_verify(&iov, 1, 4, &ctx, &err) == 0);
+
+	/* Buffer too short */
+	CU_ASSERT(spdk_dif_verify(&iov, 1, 5, &ctx, &err) == -EINVAL);
+	CU_ASSERT(spdk_dif_generate(&iov, 1, 5, &ctx) == -EINVAL);
+}
+
+static void
+test_dif_insert_strip(void)
+{
+	struct spdk_dif_ctx ctx;
+	struct spdk_dif_error err;
+	struct iovec src_iovs[16], ext_iovs[16], dst_iovs[16];
+	uint8_t src[4 * 4096], ext[4 * (4096 + 64)], dst[4 * 4096];
+	int src_iovcnt, ext_iovcnt, dst_iovcnt;
+
+	fill_data(src, sizeof(src));
+	memset(ext, 0, sizeof(ext));
+	memset(dst, 0, sizeof(dst));
+	src_iovcnt = build_iovs(src_iovs, 16, src, sizeof(src), 3000);
+	ext_iovcnt = build_iovs(ext_iovs, 16, ext, sizeof(ext), 4101);
+	dst_iovcnt = build_iovs(dst_iovs, 16, dst, sizeof(dst), 1024);
+
+	SPDK_CU_ASSERT_FATAL(spdk_dif_ctx_init(&ctx, 4096 + 64, 64, true, false, SPDK_DIF_TYPE2,
+					       DIF_FLAGS_ALL, 0, 0xFFFF, 0x5A5A, 0) == 0);
+
+	CU_ASSERT(spdk_dif_insert(src_iovs, src_iovcnt, ext_iovs, ext_iovcnt, 4, &ctx) == 0);
+	CU_ASSERT(memcmp(ext + 4096 + 64, src + 4096, 4096) == 0);
+	CU_ASSERT(spdk_dif_verify(ext_iovs, ext_iovcnt, 4, &ctx, &err) == 0);
+
+	CU_ASSERT(spdk_dif_strip(ext_iovs, ext_iovcnt, dst_iovs, dst_iovcnt, 4, &ctx, &err) == 0);
+	CU_ASSERT(memcmp(src, dst, sizeof(src)) == 0);
+
+	/* A failing block is not copied. */
+	memset(dst, 0, sizeof(dst));
+	ext[3 * (4096 + 64)] ^= 0x80;
+	CU_ASSERT(spdk_dif_strip(ext_iovs, ext_iovcnt, dst_iovs, dst_iovcnt, 4, &ctx, &err) == -EIO);
+	CU_ASSERT(err.err_type == SPDK_DIF_GUARD_ERROR);
+	CU_ASSERT(err.err_offset == 3);
+	CU_ASSERT(memcmp(src, dst, 3 * 4096) == 0);
+	CU_ASSERT(dst[3 * 4096] == 0);
+
+	CU_ASSERT(spdk_dif_insert(src_iovs, src_iovcnt, ext_iovs, ext_iovcnt, 5, &ctx) == -EINVAL);
+}
+
+static void
+test_dix_generate_verify(void)
+{
+	struct spdk_dif_ctx dix_ctx, dif_ctx;
+	struct spdk_dif_error err;
+	struct iovec iovs[16], md_iov, ext_iov;
+	uint8_t data[4 * 512], md[4 * 16], ext[4 * (512 + 16)];
+	uint32_t i;
+	int iovcnt;
+
+	fill_data(data, sizeof(data));
+	for (i = 0; i < sizeof(md); i++) {
+		md[i] = i;
+	}
+	iovcnt = build_iovs(iovs, 16, data, sizeof(data), 700);
+	md_iov.iov_base = md;
+	md_iov.iov_len = sizeof(md);
+
+	SPDK_CU_ASSERT_FATAL(spdk_dif_ctx_init(&dix_ctx, 512, 16, false, false, SPDK_DIF_TYPE1,
+					       DIF_FLAGS_ALL, 7, 0xFFFF, 0x42, 0) == 0);
+	CU_ASSERT(spdk_dix_generate(iovs, iovcnt, &md_iov, 4, &dix_ctx) == 0);
+	CU_ASSERT(spdk_dix_verify(iovs, iovcnt, &md_iov, 4, &dix_ctx, &err) == 0);
+
+	/* Separate metadata must produce the same protection information as interleaved. */
+	for (i = 0; i < 4; i++) {
+		memcpy(ext + i * 528, data + i * 512, 512);
+		memcpy(ext + i * 528 + 512, md + i * 16, 16);
+	}
+	ext_iov.iov_base = ext;
+	ext_iov.iov_len = sizeof(ext);
+	SPDK_CU_ASSERT_FATAL(spdk_dif_ctx_init(&dif_ctx, 528, 16, true, false, SPDK_DIF_TYPE1,
+					       DIF_FLAGS_ALL, 7, 0xFFFF, 0x42, 0) == 0);
+	CU_ASSERT(spdk_dif_verify(&ext_iov, 1, 4, &dif_ctx, &err) == 0);
+
+	/* The guard covers the metadata preceding the protection information. */
+	md[16 + 3] ^= 0x1;
+	CU_ASSERT(spdk_dix_verify(iovs, iovcnt, &md_iov, 4, &dix_ctx, &err) == -EIO);
+	CU_ASSERT(err.err_type == SPDK_DIF_GUARD_ERROR);
+	CU_ASSERT(err.err_offset == 1);
+
+	/* Interleaved functions reject a DIX context and vice versa. */
+	CU_ASSERT(spdk_dif_generate(iovs, iovcnt, 4, &dix_ctx) == -EINVAL);
+	CU_ASSERT(spdk_dix_generate(&ext_iov, 1, &md_iov, 4, &dif_ctx) == -EINVAL);
+
+	md_iov.iov_len = 3 * 16;
+	CU_ASSERT(spdk_dix_verify(iovs, iovcnt, &md_iov, 4, &dix_ctx, &err) == -EINVAL);
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("dif", NULL, NULL);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (
+		CU_add_test(suite, "test_crc16_t10dif", test_crc16_t10dif) == NULL ||
+		CU_add_test(suite, "test_dif_ctx_init", test_dif_ctx_init) == NULL ||
+		CU_add_test(suite, "test_dif_generate_verify", test_dif_generate_verify) == NULL ||
+		CU_add_test(suite, "test_dif_verify_errors", test_dif_verify_errors) == NULL ||
+		CU_add_test(suite, "test_dif_insert_strip", test_dif_insert_strip) == NULL ||
+		CU_add_test(suite, "test_dix_generate_verify", test_dix_generate_verify) == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+
+	CU_basic_run_tests();
+
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+
+	return num_failures;
+}
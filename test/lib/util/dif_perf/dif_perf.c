@@ -0,0 +1,228 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "spdk/crc16.h"
+#include "spdk/dif.h"
+
+#define DIF_PERF_FLAGS	(SPDK_DIF_FLAGS_GUARD_CHECK | SPDK_DIF_FLAGS_APPTAG_CHECK | \
+			 SPDK_DIF_FLAGS_REFTAG_CHECK)
+
+static uint32_t g_data_size = 4096;
+static uint32_t g_md_size = 8;
+static uint32_t g_num_blocks = 32;
+static uint32_t g_time_in_sec = 1;
+
+static struct iovec g_iov;
+static struct iovec g_data_iov;
+static struct iovec g_md_iov;
+static struct spdk_dif_ctx g_dif_ctx;
+static struct spdk_dif_ctx g_dix_ctx;
+
+static double
+get_time_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+run_crc16(void)
+{
+	volatile uint16_t crc;
+
+	crc = spdk_crc16_t10dif(0, g_data_iov.iov_base, g_data_iov.iov_len);
+	(void)crc;
+	return 0;
+}
+
+static int
+run_dif_generate(void)
+{
+	return spdk_dif_generate(&g_iov, 1, g_num_blocks, &g_dif_ctx);
+}
+
+static int
+run_dif_verify(void)
+{
+	return spdk_dif_verify(&g_iov, 1, g_num_blocks, &g_dif_ctx, NULL);
+}
+
+static int
+run_dix_generate(void)
+{
+	return spdk_dix_generate(&g_data_iov, 1, &g_md_iov, g_num_blocks, &g_dix_ctx);
+}
+
+static int
+run_dix_verify(void)
+{
+	return spdk_dix_verify(&g_data_iov, 1, &g_md_iov, g_num_blocks, &g_dix_ctx, NULL);
+}
+
+static int
+measure(const char *name, int (*fn)(void))
+{
+	uint64_t ops = 0;
+	double start, elapsed;
+	int rc;
+
+	start = get_time_sec();
+	do {
+		rc = fn();
+		if (rc != 0) {
+			fprintf(stderr, "%s failed: %d\n", name, rc);
+			return rc;
+		}
+		ops++;
+		elapsed = get_time_sec() - start;
+	} while (elapsed < g_time_in_sec);
+
+	printf("%-14s %10.1f MB/s %12.1f blocks/s\n", name,
+	       (double)ops * g_num_blocks * g_data_size / elapsed / (1024 * 1024),
+	       (double)ops * g_num_blocks / elapsed);
+	return 0;
+}
+
+static void usage(char *program_name)
+{
+	printf("%s options\n", program_name);
+	printf("\t[-s data size of each block in bytes (default: 4096)]\n");
+	printf("\t[-m metadata size of each block in bytes (default: 8)]\n");
+	printf("\t[-n number of blocks per operation (default: 32)]\n");
+	printf("\t[-t time in seconds for each measurement (default: 1)]\n");
+}
+
+static int
+parse_args(int argc, char **argv)
+{
+	int op;
+
+	while ((op = getopt(argc, argv, "s:m:n:t:")) != -1) {
+		switch (op) {
+		case 's':
+			g_data_size = atoi(optarg);
+			break;
+		case 'm':
+			g_md_size = atoi(optarg);
+			break;
+		case 'n':
+			g_num_blocks = atoi(optarg);
+			break;
+		case 't':
+			g_time_in_sec = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!g_data_size || !g_num_blocks || !g_time_in_sec) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	void *buf, *data, *md;
+	int rc;
+
+	rc = parse_args(argc, argv);
+	if (rc != 0) {
+		return rc;
+	}
+
+	if (spdk_dif_ctx_init(&g_dif_ctx, g_data_size + g_md_size, g_md_size, true, false,
+			      SPDK_DIF_TYPE1, DIF_PERF_FLAGS, 0, 0xFFFF, 0, 0) != 0 ||
+	    spdk_dif_ctx_init(&g_dix_ctx, g_data_size, g_md_size, false, false,
+			      SPDK_DIF_TYPE1, DIF_PERF_FLAGS, 0, 0xFFFF, 0, 0) != 0) {
+		fprintf(stderr, "invalid block format %u+%u\n", g_data_size, g_md_size);
+		return 1;
+	}
+
+	buf = calloc(g_num_blocks, g_data_size + g_md_size);
+	data = calloc(g_num_blocks, g_data_size);
+	md = calloc(g_num_blocks, g_md_size);
+	if (buf == NULL || data == NULL || md == NULL) {
+		fprintf(stderr, "buffer allocation failed\n");
+		free(buf);
+		free(data);
+		free(md);
+		return 1;
+	}
+
+	memset(buf, 0x5A, (size_t)g_num_blocks * (g_data_size + g_md_size));
+	memset(data, 0x5A, (size_t)g_num_blocks * g_data_size);
+	g_iov.iov_base = buf;
+	g_iov.iov_len = (size_t)g_num_blocks * (g_data_size + g_md_size);
+	g_data_iov.iov_base = data;
+	g_data_iov.iov_len = (size_t)g_num_blocks * g_data_size;
+	g_md_iov.iov_base = md;
+	g_md_iov.iov_len = (size_t)g_num_blocks * g_md_size;
+
+	printf("Block format %u+%u, %u blocks per operation\n", g_data_size, g_md_size,
+	       g_num_blocks);
+
+	rc = measure("crc16_t10dif", run_crc16);
+	if (rc == 0) {
+		rc = measure("dif_generate", run_dif_generate);
+	}
+	if (rc == 0) {
+		rc = measure("dif_verify", run_dif_verify);
+	}
+	if (rc == 0) {
+		rc = measure("dix_generate", run_dix_generate);
+	}
+	if (rc == 0) {
+		rc = measure("dix_verify", run_dix_verify);
+	}
+
+	free(buf);
+	free(data);
+	free(md);
+
+	return rc == 0 ? 0 : 1;
+}
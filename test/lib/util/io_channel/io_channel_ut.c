@@ -165,7 +165,7 @@ channel(void)
 	CU_ASSERT(ch1 == NULL);
 
 	/* Confirm failure if user specifies an invalid I/O priority. */
-	ch1 = spdk_get_io_channel(&device1, SPDK_IO_PRIORITY_DEFAULT + 1, false, NULL);
+	ch1 = spdk_get_io_channel(&device1, SPDK_IO_PRIORITY_LOW + 1, false, NULL);
 	CU_ASSERT(ch1 == NULL);
 
 	/* Confirm failure if user specifies non-NULL unique_ctx for a shared channel. */
@@ -180,6 +180,62 @@ channel(void)
 	spdk_free_thread();
 }
 
+static uint32_t g_create_priority;
+
+static int
+create_cb_priority(void *io_device, uint32_t priority, void *ctx_buf, void *unique_ctx)
+{
+	g_create_priority = priority;
+	*(uint32_t *)ctx_buf = priority;
+	return 0;
+}
+
+static void
+destroy_cb_priority(void *io_device, void *ctx_buf)
+{
+}
+
+static void
+priority(void)
+{
+	struct spdk_io_channel *ch1, *ch2, *ch3;
+	uint32_t prio;
+
+	spdk_allocate_thread();
+	spdk_io_device_register(&device1, create_cb_priority, destroy_cb_priority, sizeof(uint32_t));
+
+	ch1 = spdk_get_io_channel(&device1, SPDK_IO_PRIORITY_DEFAULT, false, NULL);
+	SPDK_CU_ASSERT_FATAL(ch1 != NULL);
+	CU_ASSERT(g_create_priority == SPDK_IO_PRIORITY_DEFAULT);
+
+	/* A different priority on the same device gets its own channel. */
+	ch2 = spdk_get_io_channel(&device1, SPDK_IO_PRIORITY_URGENT, false, NULL);
+	SPDK_CU_ASSERT_FATAL(ch2 != NULL);
+	CU_ASSERT(ch1 != ch2);
+	CU_ASSERT(g_create_priority == SPDK_IO_PRIORITY_URGENT);
+	CU_ASSERT(*(uint32_t *)spdk_io_channel_get_ctx(ch2) == SPDK_IO_PRIORITY_URGENT);
+
+	ch3 = spdk_get_io_channel(&device1, SPDK_IO_PRIORITY_URGENT, false, NULL);
+	CU_ASSERT(ch3 == ch2);
+
+	spdk_put_io_channel(ch3);
+	spdk_put_io_channel(ch2);
+	spdk_put_io_channel(ch1);
+	spdk_io_device_unregister(&device1);
+	CU_ASSERT(TAILQ_EMPTY(&g_io_channels));
+	spdk_free_thread();
+
+	CU_ASSERT(spdk_io_priority_parse("urgent", &prio) == 0);
+	CU_ASSERT(prio == SPDK_IO_PRIORITY_URGENT);
+	CU_ASSERT(spdk_io_priority_parse("High", &prio) == 0);
+	CU_ASSERT(prio == SPDK_IO_PRIORITY_HIGH);
+	CU_ASSERT(spdk_io_priority_parse("Default", &prio) == 0);
+	CU_ASSERT(prio == SPDK_IO_PRIORITY_DEFAULT);
+	CU_ASSERT(spdk_io_priority_parse("LOW", &prio) == 0);
+	CU_ASSERT(prio == SPDK_IO_PRIORITY_LOW);
+	CU_ASSERT(spdk_io_priority_parse("Medium", &prio) == -1);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -198,7 +254,8 @@ main(int argc, char **argv)
 
 	if (
 		CU_add_test(suite, "thread_alloc", thread_alloc) == NULL ||
-		CU_add_test(suite, "channel", channel) == NULL
+		CU_add_test(suite, "channel", channel) == NULL ||
+		CU_add_test(suite, "priority", priority) == NULL
 	) {
 		CU_cleanup_registry();
 		return CU_get_error();
@@ -9,6 +9,9 @@ source $rootdir/scripts/autotest_common.sh
 timing_enter util
 
 $valgrind $testdir/bit_array/bit_array_ut
+$valgrind $testdir/dif/dif_ut
 $valgrind $testdir/io_channel/io_channel_ut
 
+$testdir/dif_perf/dif_perf -t 1
+
 timing_exit util
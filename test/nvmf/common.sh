@@ -4,6 +4,7 @@ NVMF_PORT=4420
 NVMF_IP_PREFIX="192.168.100"
 NVMF_IP_LEAST_ADDR=8
 NVMF_FIRST_TARGET_IP=$NVMF_IP_PREFIX.$NVMF_IP_LEAST_ADDR
+NVMF_TCP_TARGET_IP=127.0.0.1
 RPC_PORT=5260
 
 function load_ib_rdma_modules()
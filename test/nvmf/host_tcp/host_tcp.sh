@@ -0,0 +1,39 @@
+#!/usr/bin/env bash
+
+testdir=$(readlink -f $(dirname $0))
+rootdir=$(readlink -f $testdir/../../..)
+source $rootdir/scripts/autotest_common.sh
+source $rootdir/test/nvmf/common.sh
+
+rpc_py="python $rootdir/scripts/rpc.py"
+perf="$rootdir/examples/nvme/perf/perf"
+
+set -e
+
+timing_enter host_tcp
+
+# Start up the NVMf target in another process
+$rootdir/app/nvmf_tgt/nvmf_tgt -c $testdir/../nvmf.conf &
+nvmfpid=$!
+
+trap "killprocess $nvmfpid; exit 1" SIGINT SIGTERM EXIT
+
+waitforlisten $nvmfpid ${RPC_PORT}
+
+$rpc_py construct_nvmf_subsystem Virtual nqn.2016-06.io.spdk:cnode1 "transport:TCP traddr:$NVMF_TCP_TARGET_IP trsvcid:$NVMF_PORT" All -s SPDK00000000000001 -n 'Malloc0 Malloc1'
+
+# Connect with the userspace TCP host driver over loopback and run I/O through it:
+#  in-capsule writes, writes that wait for an R2T, and reads of both sizes.
+trid="trtype:TCP traddr:$NVMF_TCP_TARGET_IP trsvcid:$NVMF_PORT subnqn:nqn.2016-06.io.spdk:cnode1"
+$perf -c 0x2 -r "$trid" -q 32 -s 4096 -w randwrite -t 5
+$perf -c 0x2 -r "$trid" -q 32 -s 131072 -w write -t 5
+$perf -c 0x2 -r "$trid" -q 32 -s 4096 -w randread -t 5
+$perf -c 0x2 -r "$trid" -q 32 -s 131072 -w read -t 5
+$perf -c 0x2 -r "$trid" -q 128 -s 4096 -w randrw -M 50 -t 5
+
+$rpc_py delete_nvmf_subsystem nqn.2016-06.io.spdk:cnode1
+
+trap - SIGINT SIGTERM EXIT
+
+killprocess $nvmfpid
+timing_exit host_tcp
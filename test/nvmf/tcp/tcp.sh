@@ -0,0 +1,66 @@
+#!/usr/bin/env bash
+
+testdir=$(readlink -f $(dirname $0))
+rootdir=$(readlink -f $testdir/../../..)
+source $rootdir/scripts/autotest_common.sh
+source $rootdir/test/nvmf/common.sh
+
+rpc_py="python $rootdir/scripts/rpc.py"
+fio_py="$rootdir/test/nvmf/fio/nvmf_fio.py"
+
+set -e
+
+if ! modprobe -n nvme-tcp 2>/dev/null; then
+	echo "nvme-tcp host driver not available"
+	exit 0
+fi
+
+timing_enter tcp
+
+# Start up the NVMf target in another process
+$rootdir/app/nvmf_tgt/nvmf_tgt -c $testdir/../nvmf.conf &
+nvmfpid=$!
+
+trap "killprocess $nvmfpid; exit 1" SIGINT SIGTERM EXIT
+
+waitforlisten $nvmfpid ${RPC_PORT}
+
+modprobe -v nvme-tcp
+
+if [ -e "/dev/nvme-fabrics" ]; then
+	chmod a+rw /dev/nvme-fabrics
+fi
+
+# The subsystem listens on TCP loopback and, when an RDMA NIC is present, on RDMA as well,
+# so that hosts of both transports are served at the same time.
+listen="transport:TCP traddr:$NVMF_TCP_TARGET_IP trsvcid:$NVMF_PORT"
+if rdma_nic_available; then
+	listen="$listen,transport:RDMA traddr:$NVMF_FIRST_TARGET_IP trsvcid:$NVMF_PORT"
+fi
+$rpc_py construct_nvmf_subsystem Virtual nqn.2016-06.io.spdk:cnode1 "$listen" All -s SPDK00000000000001 -n 'Malloc0 Malloc1'
+
+nvme connect -t tcp -n "nqn.2016-06.io.spdk:cnode1" -a "$NVMF_TCP_TARGET_IP" -s "$NVMF_PORT"
+
+$fio_py 4096 1 write 1 verify
+$fio_py 4096 128 randwrite 1 verify
+$fio_py 131072 32 write 1 verify
+
+# Loopback throughput and latency, reported by fio
+$fio_py 4096 128 randread 10
+$fio_py 131072 32 read 10
+
+sync
+nvme disconnect -n "nqn.2016-06.io.spdk:cnode1"
+
+$rpc_py delete_nvmf_subsystem nqn.2016-06.io.spdk:cnode1
+
+rm -f ./local-job0-0-verify.state
+rm -f ./local-job1-1-verify.state
+rm -f ./local-job2-2-verify.state
+
+trap - SIGINT SIGTERM EXIT
+
+sync
+rmmod nvme-tcp
+killprocess $nvmfpid
+timing_exit tcp